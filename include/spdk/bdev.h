@@ -140,6 +140,7 @@ enum spdk_bdev_io_type {
 	SPDK_BDEV_IO_TYPE_COMPARE,
 	SPDK_BDEV_IO_TYPE_COMPARE_AND_WRITE,
 	SPDK_BDEV_IO_TYPE_ABORT,
+	SPDK_BDEV_IO_TYPE_COPY,
 	SPDK_BDEV_NUM_IO_TYPES /* Keep last */
 };
 
@@ -187,6 +188,10 @@ struct spdk_bdev_opts {
 	uint32_t bdev_io_pool_size;
 	uint32_t bdev_io_cache_size;
 	bool bdev_auto_examine;
+	uint32_t small_buf_pool_size;
+	uint32_t large_buf_pool_size;
+	uint32_t small_buf_cache_size;
+	uint32_t large_buf_cache_size;
 };
 
 void spdk_bdev_get_opts(struct spdk_bdev_opts *opts);
@@ -685,6 +690,35 @@ uint64_t spdk_bdev_get_weighted_io_time(const struct spdk_bdev *bdev);
  */
 struct spdk_io_channel *spdk_bdev_get_io_channel(struct spdk_bdev_desc *desc);
 
+/** Maximum number of I/O held by a batch before it is flushed to the bdev module. */
+#define SPDK_BDEV_IO_BATCH_SIZE	32
+
+/**
+ * Start a batch of I/O on the given channel.
+ *
+ * I/O submitted on the channel afterwards is held by the bdev layer instead of
+ * being passed to the bdev module one by one. spdk_bdev_io_batch_flush() then
+ * passes all of it to the module in one call, which lets modules amortize per
+ * submission costs like doorbell writes. A batch holding SPDK_BDEV_IO_BATCH_SIZE
+ * I/O is flushed right away.
+ *
+ * Every call must be paired with a call to spdk_bdev_io_batch_flush() on the
+ * same channel, and so on the same thread, before returning to the thread's
+ * poller. I/O still held when the channel is destroyed is completed with
+ * SPDK_BDEV_IO_STATUS_ABORTED.
+ *
+ * \param ch I/O channel. Obtained by calling spdk_bdev_get_io_channel().
+ */
+void spdk_bdev_io_batch_start(struct spdk_io_channel *ch);
+
+/**
+ * Pass all I/O held by the batch on the given channel to the bdev module and
+ * stop batching.
+ *
+ * \param ch I/O channel. Obtained by calling spdk_bdev_get_io_channel().
+ */
+void spdk_bdev_io_batch_flush(struct spdk_io_channel *ch);
+
 /**
  * \defgroup bdev_io_submit_functions bdev I/O Submit Functions
  *
@@ -1268,6 +1302,36 @@ int spdk_bdev_write_zeroes_blocks(struct spdk_bdev_desc *desc, struct spdk_io_ch
 				  uint64_t offset_blocks, uint64_t num_blocks,
 				  spdk_bdev_io_completion_cb cb, void *cb_arg);
 
+/**
+ * Submit a copy request to the bdev on the given channel. This copies data from
+ * one range of blocks of the bdev to another one on the same bdev. The ranges
+ * must not overlap.
+ *
+ * Bdevs that don't support SPDK_BDEV_IO_TYPE_COPY natively get it emulated with
+ * reads and writes through bdev data buffers.
+ *
+ * \ingroup bdev_io_submit_functions
+ *
+ * \param desc Block device descriptor.
+ * \param ch I/O channel. Obtained by calling spdk_bdev_get_io_channel().
+ * \param dst_offset_blocks The offset, in blocks, to copy the data to.
+ * \param src_offset_blocks The offset, in blocks, to copy the data from.
+ * \param num_blocks The number of blocks to copy.
+ * \param cb Called when the request is complete.
+ * \param cb_arg Argument passed to cb.
+ *
+ * \return 0 on success. On success, the callback will always
+ * be called (even if the request ultimately failed). Return
+ * negated errno on failure, in which case the callback will not be called.
+ *   * -EINVAL - offsets and/or num_blocks are out of range, or the ranges overlap
+ *   * -ENOMEM - spdk_bdev_io buffer cannot be allocated
+ *   * -EBADF - desc not open for writing
+ *   * -ENOTSUP - the bdev supports neither copy nor reads and writes
+ */
+int spdk_bdev_copy_blocks(struct spdk_bdev_desc *desc, struct spdk_io_channel *ch,
+			  uint64_t dst_offset_blocks, uint64_t src_offset_blocks,
+			  uint64_t num_blocks, spdk_bdev_io_completion_cb cb, void *cb_arg);
+
 /**
  * Submit an unmap request to the block device. Unmap is sometimes also called trim or
  * deallocate. This notifies the device that the data in the blocks described is no
@@ -1684,6 +1748,43 @@ void spdk_bdev_histogram_get(struct spdk_bdev *bdev, struct spdk_histogram_data
 			     spdk_bdev_histogram_data_cb cb_fn,
 			     void *cb_arg);
 
+/**
+ * Number of I/O size buckets in the per I/O type histograms. Bucket 0 counts
+ * I/O smaller than 8KiB, bucket n counts I/O of at least 4KiB << n bytes and
+ * the last bucket also counts all larger I/O.
+ */
+#define SPDK_BDEV_HISTOGRAM_SIZE_BUCKETS	8
+
+/** Smallest I/O size in bytes counted in the given size bucket. */
+#define SPDK_BDEV_HISTOGRAM_SIZE_BUCKET_MIN(bucket)	((bucket) == 0 ? 0 : (4096ULL << (bucket)))
+
+/**
+ * Bucket shift of the per I/O type histograms. These are coarser than the
+ * histogram returned by spdk_bdev_histogram_get() to keep per channel memory
+ * small.
+ */
+#define SPDK_BDEV_HISTOGRAM_BY_TYPE_BUCKET_SHIFT	4
+
+typedef void (*spdk_bdev_histogram_by_type_cb)(void *cb_arg, int status,
+		struct spdk_histogram_data **histograms);
+
+/**
+ * Get aggregated histogram data for one I/O type from a bdev, split by I/O size.
+ * Histograms are collected whenever histograms are enabled with
+ * spdk_bdev_histogram_enable(). Only read, write and unmap are tracked.
+ *
+ * \param bdev Block device.
+ * \param io_type I/O type to get histograms for.
+ * \param histograms Array of SPDK_BDEV_HISTOGRAM_SIZE_BUCKETS histograms for
+ * aggregated data, one per size bucket, each allocated with
+ * spdk_histogram_data_alloc_sized(SPDK_BDEV_HISTOGRAM_BY_TYPE_BUCKET_SHIFT).
+ * \param cb_fn Callback function to be called with data collected on bdev.
+ * \param cb_arg Argument to pass to cb_fn.
+ */
+void spdk_bdev_histogram_get_by_type(struct spdk_bdev *bdev, enum spdk_bdev_io_type io_type,
+				     struct spdk_histogram_data **histograms,
+				     spdk_bdev_histogram_by_type_cb cb_fn, void *cb_arg);
+
 /**
  * Retrieves media events.  Can only be called from the context of
  * SPDK_BDEV_EVENT_MEDIA_MANAGEMENT event callback.  These events are sent by
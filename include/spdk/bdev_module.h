@@ -183,6 +183,13 @@ struct spdk_bdev_fn_table {
 	/** Process the IO. */
 	void (*submit_request)(struct spdk_io_channel *ch, struct spdk_bdev_io *);
 
+	/**
+	 * Process a batch of up to SPDK_BDEV_IO_BATCH_SIZE I/O, see spdk_bdev_io_batch_start().
+	 *  Optional - may be NULL, in which case submit_request is called for each I/O.
+	 */
+	void (*submit_request_batch)(struct spdk_io_channel *ch, struct spdk_bdev_io **bdev_ios,
+				     int num_ios);
+
 	/** Check if the block device supports a specific I/O type. */
 	bool (*io_type_supported)(void *ctx, enum spdk_bdev_io_type);
 
@@ -541,6 +548,13 @@ struct spdk_bdev_io {
 				 */
 				void *bio_cb_arg;
 			} abort;
+
+			struct {
+				/** Starting offset (in blocks) of the bdev to copy from. The
+				 *  destination is offset_blocks.
+				 */
+				uint64_t src_offset_blocks;
+			} copy;
 		} bdev;
 		struct {
 			/** Channel reference held while messages for this reset are in progress. */
@@ -512,6 +512,28 @@ int spdk_blob_get_clones(struct spdk_blob_store *bs, spdk_blob_id blobid, spdk_b
  */
 spdk_blob_id spdk_blob_get_parent_snapshot(struct spdk_blob_store *bs, spdk_blob_id blobid);
 
+/**
+ * Find the next cluster of a blob whose data may differ from a snapshot it
+ * depends on.
+ *
+ * A cluster is reported if it is allocated in the blob or in any snapshot in
+ * its chain between the blob and base_id. Clusters only allocated in base_id
+ * or its ancestors are not reported. If base_id is SPDK_BLOBID_INVALID, every
+ * cluster allocated anywhere in the chain is reported.
+ *
+ * Only the cluster maps are walked, no I/O is done.
+ *
+ * \param blob Blob to compare.
+ * \param base_id Blob id of a snapshot in the chain of blob, or SPDK_BLOBID_INVALID.
+ * \param cluster First cluster to check.
+ * \param next Filled with the first such cluster at or after cluster, or
+ * UINT64_MAX if there is none.
+ *
+ * \return 0 on success, -EINVAL if base_id is not in the chain of blob.
+ */
+int spdk_blob_get_next_changed_cluster(struct spdk_blob *blob, spdk_blob_id base_id,
+				       uint64_t cluster, uint64_t *next);
+
 /**
  * Check if blob is read only.
  *
@@ -592,6 +614,30 @@ void spdk_bs_inflate_blob(struct spdk_blob_store *bs, struct spdk_io_channel *ch
 void spdk_bs_blob_decouple_parent(struct spdk_blob_store *bs, struct spdk_io_channel *channel,
 				  spdk_blob_id blobid, spdk_blob_op_complete cb_fn, void *cb_arg);
 
+/**
+ * Remove dependency on the whole chain of snapshots.
+ *
+ * This call allocates and copies data for any clusters that are allocated in
+ * any of the ancestors of the blob, and then removes the parent of the blob.
+ * Clusters unallocated in the whole chain stay unallocated, so a thin
+ * provisioned blob remains thin provisioned.
+ *
+ * The blob stays available for I/O while clusters are copied. Copying can be
+ * throttled, to limit its impact on other I/O to the blobstore.
+ *
+ * If blob have no parent, nothing is done.
+ *
+ * \param bs blobstore.
+ * \param channel IO channel used to flatten blob.
+ * \param blobid The id of the blob.
+ * \param max_bytes_per_sec Maximum rate of copying clusters, 0 for unlimited.
+ * \param cb_fn Called when the operation is complete.
+ * \param cb_arg Argument passed to function cb_fn.
+ */
+void spdk_bs_blob_flatten(struct spdk_blob_store *bs, struct spdk_io_channel *channel,
+			  spdk_blob_id blobid, uint64_t max_bytes_per_sec,
+			  spdk_blob_op_complete cb_fn, void *cb_arg);
+
 struct spdk_blob_open_opts {
 	enum blob_clear_method  clear_method;
 };
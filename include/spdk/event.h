@@ -141,6 +141,9 @@ struct spdk_app_opts {
 	logfunc         *log;
 
 	uint64_t		base_virtaddr;
+
+	/* Let idle reactors wait for events instead of polling */
+	bool			interrupt_mode;
 };
 
 /**
@@ -0,0 +1,135 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation. All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+/** \file
+ * File descriptor group utility functions.
+ *
+ * An fd group waits for events on a set of file descriptors and calls the
+ * handler registered for each descriptor that became ready. It is built on
+ * epoll and is only supported on Linux.
+ *
+ * The fd group is not thread safe. It must be used from a single thread.
+ */
+
+#ifndef SPDK_FD_GROUP_H
+#define SPDK_FD_GROUP_H
+
+#include "spdk/stdinc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct spdk_fd_group;
+
+/**
+ * Callback function registered for a file descriptor of an fd group.
+ *
+ * \param ctx Context passed as arg to spdk_fd_group_add().
+ *
+ * \return a positive number if the handler did some work, 0 if not, or a negative
+ * errno on failure.
+ */
+typedef int (*spdk_fd_fn)(void *ctx);
+
+/**
+ * Create a new fd group.
+ *
+ * \param fgrp Output parameter for the new fd group.
+ *
+ * \return 0 on success, -ENOTSUP if fd groups aren't supported on this platform,
+ * or another negated errno on failure.
+ */
+int spdk_fd_group_create(struct spdk_fd_group **fgrp);
+
+/**
+ * Destroy an fd group. All file descriptors should be removed from the group
+ * before, the file descriptors themselves are not closed.
+ *
+ * \param fgrp The fd group to destroy.
+ */
+void spdk_fd_group_destroy(struct spdk_fd_group *fgrp);
+
+/**
+ * Add a file descriptor to the fd group. The handler is called by
+ * spdk_fd_group_wait() each time the descriptor is readable.
+ *
+ * \param fgrp The fd group.
+ * \param efd File descriptor to wait for.
+ * \param fn Handler called when the descriptor is readable.
+ * \param arg Context passed to fn.
+ * \param name Name of the handler used for debugging, may be NULL.
+ *
+ * \return 0 on success, -EEXIST if the descriptor is already in the group, or
+ * another negated errno on failure.
+ */
+int spdk_fd_group_add(struct spdk_fd_group *fgrp, int efd, spdk_fd_fn fn, void *arg,
+		      const char *name);
+
+/**
+ * Remove a file descriptor from the fd group. The descriptor may be removed
+ * from within a handler called by spdk_fd_group_wait(), its handler won't be
+ * called anymore once this function returns.
+ *
+ * \param fgrp The fd group.
+ * \param efd File descriptor to remove.
+ */
+void spdk_fd_group_remove(struct spdk_fd_group *fgrp, int efd);
+
+/**
+ * Wait until at least one file descriptor of the group is readable or the
+ * timeout expires, and call the handlers of all the ready descriptors.
+ *
+ * \param fgrp The fd group.
+ * \param timeout Timeout in milliseconds. 0 returns immediately, -1 waits
+ * without a timeout.
+ *
+ * \return the number of handlers called, or a negated errno on failure.
+ */
+int spdk_fd_group_wait(struct spdk_fd_group *fgrp, int timeout);
+
+/**
+ * Get the file descriptor of the fd group. It is readable whenever one of the
+ * descriptors of the group is readable, so an fd group can be waited on as
+ * part of another fd group.
+ *
+ * \param fgrp The fd group.
+ *
+ * \return the file descriptor of the fd group.
+ */
+int spdk_fd_group_get_fd(struct spdk_fd_group *fgrp);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SPDK_FD_GROUP_H */
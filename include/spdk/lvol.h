@@ -292,6 +292,20 @@ void spdk_lvol_inflate(struct spdk_lvol *lvol, spdk_lvol_op_complete cb_fn, void
  */
 void spdk_lvol_decouple_parent(struct spdk_lvol *lvol, spdk_lvol_op_complete cb_fn, void *cb_arg);
 
+/**
+ * Flatten lvol
+ *
+ * Copy data held by any snapshot in the chain of the lvol and remove its
+ * dependency on the chain. The lvol stays thin provisioned.
+ *
+ * \param lvol Handle to lvol
+ * \param max_bytes_per_sec Maximum rate of copying data, 0 for unlimited
+ * \param cb_fn Completion callback
+ * \param cb_arg Completion callback custom arguments
+ */
+void spdk_lvol_flatten(struct spdk_lvol *lvol, uint64_t max_bytes_per_sec,
+		       spdk_lvol_op_complete cb_fn, void *cb_arg);
+
 #ifdef __cplusplus
 }
 #endif
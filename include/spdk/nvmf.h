@@ -651,6 +651,75 @@ void spdk_nvmf_subsystem_allow_any_listener(
 bool spdk_nvmf_subsytem_any_listener_allowed(
 	struct spdk_nvmf_subsystem *subsystem);
 
+/**
+ * Set whether a subsystem reports Asymmetric Namespace Access (ANA) state to hosts.
+ *
+ * With ANA reporting enabled, each namespace of the subsystem is placed in its
+ * own ANA group, whose ANA group ID is the namespace ID, and the ANA state of
+ * the groups is taken from the listener the host connected through.
+ *
+ * May only be performed on subsystems in the INACTIVE state.
+ *
+ * \param subsystem Subsystem to modify.
+ * \param ana_reporting true to report ANA state, or false to not report it.
+ *
+ * \return 0 on success, or negated errno value on failure.
+ */
+int spdk_nvmf_subsystem_set_ana_reporting(struct spdk_nvmf_subsystem *subsystem,
+		bool ana_reporting);
+
+/**
+ * Check whether a subsystem reports Asymmetric Namespace Access (ANA) state to hosts.
+ *
+ * \param subsystem Subsystem to query.
+ *
+ * \return true if ANA reporting is enabled, or false otherwise.
+ */
+bool spdk_nvmf_subsystem_get_ana_reporting(const struct spdk_nvmf_subsystem *subsystem);
+
+/**
+ * Function to be called once the ANA state of a listener was updated.
+ *
+ * \param cb_arg Argument passed to the function.
+ * \param status 0 if it completed successfully, or negative errno if it failed.
+ */
+typedef void (*spdk_nvmf_subsystem_set_ana_state_done_fn)(void *cb_arg, int status);
+
+/**
+ * Set the Asymmetric Namespace Access (ANA) state of a listen address of a subsystem.
+ *
+ * All namespaces of the subsystem are reported in this state to controllers
+ * that connected through the listen address, and these controllers are sent
+ * an ANA change asynchronous event notice. I/O commands are failed with
+ * an asymmetric access path error while the state is inaccessible.
+ *
+ * ANA reporting must have been enabled on the subsystem with
+ * spdk_nvmf_subsystem_set_ana_reporting().
+ *
+ * \param subsystem Subsystem to modify.
+ * \param trid The listen address to update.
+ * \param ana_state The new ANA state. Only SPDK_NVME_ANA_OPTIMIZED_STATE,
+ * SPDK_NVME_ANA_NON_OPTIMIZED_STATE and SPDK_NVME_ANA_INACCESSIBLE_STATE
+ * are supported.
+ * \param cb_fn A callback that will be called once all controllers were notified,
+ * or right away if the state can't be set. Optional.
+ * \param cb_arg Argument passed to cb_fn.
+ */
+void spdk_nvmf_subsystem_set_ana_state(struct spdk_nvmf_subsystem *subsystem,
+				       const struct spdk_nvme_transport_id *trid,
+				       enum spdk_nvme_ana_state ana_state,
+				       spdk_nvmf_subsystem_set_ana_state_done_fn cb_fn, void *cb_arg);
+
+/**
+ * Get the Asymmetric Namespace Access (ANA) state of a listen address.
+ *
+ * \param listener This listener.
+ *
+ * \return the ANA state reported through this listener.
+ */
+enum spdk_nvme_ana_state spdk_nvmf_subsystem_listener_get_ana_state(
+	struct spdk_nvmf_subsystem_listener *listener);
+
 /** NVMe-oF target namespace creation options */
 struct spdk_nvmf_ns_opts {
 	/**
@@ -62,6 +62,11 @@ struct spdk_thread;
  */
 struct spdk_poller;
 
+/**
+ * A file descriptor event handler registered on an spdk_thread in interrupt mode.
+ */
+struct spdk_interrupt;
+
 struct spdk_io_channel_iter;
 
 /**
@@ -125,6 +130,15 @@ typedef void (*spdk_thread_pass_msg)(spdk_msg_fn fn, void *ctx,
  */
 typedef int (*spdk_poller_fn)(void *ctx);
 
+/**
+ * Callback function for an interrupt.
+ *
+ * \param ctx Context passed as arg to spdk_interrupt_register().
+ * \return 0 to indicate that no events were processed, positive to indicate that
+ * some events were processed, or negative errno on failure.
+ */
+typedef int (*spdk_interrupt_fn)(void *ctx);
+
 /**
  * Function to be called to start a poller for the thread.
  *
@@ -246,6 +260,25 @@ int spdk_thread_lib_init_ext(spdk_thread_op_fn thread_op_fn,
  */
 void spdk_thread_lib_fini(void);
 
+/**
+ * Enable interrupt mode. Must be called before spdk_thread_lib_init().
+ *
+ * In interrupt mode each thread gets a file descriptor which becomes readable
+ * when a message is sent to the thread, when its next timed poller expires or
+ * when one of its registered interrupts fires. An idle thread can then be waited
+ * on with epoll instead of being polled, see spdk_thread_arm_interrupt().
+ *
+ * \return 0 on success, -ENOTSUP if interrupt mode isn't supported on this platform.
+ */
+int spdk_interrupt_mode_enable(void);
+
+/**
+ * Check whether interrupt mode is enabled.
+ *
+ * \return true if interrupt mode is enabled, false otherwise.
+ */
+bool spdk_interrupt_mode_is_enabled(void);
+
 /**
  * Creates a new SPDK thread object.
  *
@@ -401,6 +434,34 @@ bool spdk_thread_has_pollers(struct spdk_thread *thread);
  */
 bool spdk_thread_is_idle(struct spdk_thread *thread);
 
+/**
+ * Get the interrupt file descriptor of the thread. Only available in interrupt mode.
+ *
+ * The descriptor is an epoll fd which becomes readable when the thread has work
+ * to do. It is meant to be waited on after spdk_thread_arm_interrupt() succeeded.
+ *
+ * \param thread The thread to get the descriptor of.
+ *
+ * \return the file descriptor, or -1 if interrupt mode is not enabled.
+ */
+int spdk_thread_get_interrupt_fd(struct spdk_thread *thread);
+
+/**
+ * Prepare an idle thread to be waited on instead of polled. Only available in
+ * interrupt mode.
+ *
+ * This arms the timer of the next timed poller of the thread and asks the senders
+ * of messages to signal the interrupt fd. It fails if the thread has work to do
+ * right away, or if it has active (non-timed) pollers which need to be polled.
+ * The thread goes back to polling mode at the next spdk_thread_poll().
+ *
+ * \param thread The thread to arm.
+ *
+ * \return true if the thread can be waited on through its interrupt fd, false
+ * if it has to be polled.
+ */
+bool spdk_thread_arm_interrupt(struct spdk_thread *thread);
+
 /**
  * Get count of allocated threads.
  */
@@ -483,6 +544,32 @@ uint64_t spdk_thread_get_last_tsc(struct spdk_thread *thread);
  */
 int spdk_thread_send_msg(const struct spdk_thread *thread, spdk_msg_fn fn, void *ctx);
 
+/**
+ * Maximum number of messages sent at once by spdk_thread_send_msg_batch().
+ */
+#define SPDK_THREAD_MSG_BATCH_MAX	64
+
+/**
+ * Send a batch of messages to the given thread.
+ *
+ * All messages are enqueued to the destination thread at once, which is
+ * cheaper than calling spdk_thread_send_msg() for each of them. Either all or
+ * none of the messages are sent. The messages are executed asynchronously, in
+ * the order of ctxs.
+ *
+ * \param thread The target thread.
+ * \param fn This function will be called on the given thread once per message.
+ * \param ctxs Array of contexts. Each message passes one of them to fn.
+ * \param count Number of messages, at most SPDK_THREAD_MSG_BATCH_MAX.
+ *
+ * \return 0 on success
+ * \return -EINVAL if count is 0 or larger than SPDK_THREAD_MSG_BATCH_MAX
+ * \return -ENOMEM if the messages could not be allocated
+ * \return -EIO if the messages could not be sent to the destination thread
+ */
+int spdk_thread_send_msg_batch(const struct spdk_thread *thread, spdk_msg_fn fn, void **ctxs,
+			       uint32_t count);
+
 /**
  * Send a message to the given thread. Only one critical message can be outstanding at the same
  * time. It's intended to use this function in any cases that might interrupt the execution of the
@@ -584,6 +671,32 @@ void spdk_poller_pause(struct spdk_poller *poller);
  */
 void spdk_poller_resume(struct spdk_poller *poller);
 
+/**
+ * Register an interrupt on the current thread. Only available in interrupt mode.
+ *
+ * The interrupt function is called on the current thread each time the file
+ * descriptor becomes readable. It's up to the function to consume the event,
+ * e.g. to read an eventfd. The thread checks its interrupts at each
+ * spdk_thread_poll(), so the events are also processed while the thread is polled.
+ *
+ * \param efd File descriptor of the interrupt.
+ * \param fn Called each time the file descriptor is readable.
+ * \param arg Function argument for fn.
+ * \param name Human readable name for the interrupt, may be NULL.
+ *
+ * \return a pointer to the interrupt registered on the current thread on success,
+ * or NULL on failure.
+ */
+struct spdk_interrupt *spdk_interrupt_register(int efd, spdk_interrupt_fn fn,
+		void *arg, const char *name);
+
+/**
+ * Unregister an interrupt on the current thread. The file descriptor is not closed.
+ *
+ * \param pintr The interrupt to unregister. It is set to NULL.
+ */
+void spdk_interrupt_unregister(struct spdk_interrupt **pintr);
+
 /**
  * Register the opaque io_device context as an I/O device.
  *
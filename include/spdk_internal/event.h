@@ -63,7 +63,13 @@ enum spdk_reactor_state {
 struct spdk_lw_thread {
 	TAILQ_ENTRY(spdk_lw_thread)	link;
 	bool				resched;
+	/* The interrupt fd of the thread is in the fd group of the reactor */
+	bool				intr_registered;
+	/* Core chosen by the scheduler for the next reschedule of the thread */
+	uint32_t			lcore;
 	uint64_t			tsc_start;
+	/* Thread stats at the last time the scheduler gathered metrics */
+	struct spdk_thread_stats	last_stats;
 };
 
 struct spdk_reactor {
@@ -89,6 +95,21 @@ struct spdk_reactor {
 
 	uint64_t					busy_tsc;
 	uint64_t					idle_tsc;
+
+	/*
+	 * Interrupt mode only. The fd group contains the eventfd signaled by
+	 *  spdk_event_call() and the interrupt fds of the threads on the reactor.
+	 */
+	struct spdk_fd_group				*fgrp;
+	int						events_fd;
+	/* Set while the reactor waits for its fd group. */
+	bool						in_interrupt;
+	/* The last time an event or a thread on this reactor did some work. */
+	uint64_t					last_busy_tsc;
+
+	/* Reactor busy and idle TSC at the last time the scheduler gathered metrics */
+	uint64_t					sched_busy_tsc;
+	uint64_t					sched_idle_tsc;
 } __attribute__((aligned(SPDK_CACHE_LINE_SIZE)));
 
 int spdk_reactors_init(void);
@@ -113,6 +134,128 @@ struct spdk_reactor *spdk_reactor_get(uint32_t lcore);
  */
 void spdk_for_each_reactor(spdk_event_fn fn, void *arg1, void *arg2, spdk_event_fn cpl);
 
+/**
+ * Get the app thread, which runs the start and shutdown callbacks of the
+ * application on the master reactor.
+ *
+ * \return the app thread, or NULL if the application isn't started.
+ */
+struct spdk_thread *spdk_app_get_thread(void);
+
+/**
+ * Metrics of a thread gathered for the scheduler.
+ */
+struct spdk_scheduler_thread_info {
+	uint64_t			thread_id;
+
+	/* Core the thread ran on when the metrics were gathered */
+	uint32_t			lcore;
+
+	/* Core the thread should be moved to, set by the scheduler */
+	uint32_t			target_lcore;
+
+	struct spdk_cpuset		cpumask;
+
+	/* The app thread, which schedulers must leave where it is */
+	bool				app_thread;
+
+	/* Busy and idle TSC of the thread over the last scheduling period */
+	struct spdk_thread_stats	stats;
+};
+
+/**
+ * Metrics of a reactor gathered for the scheduler.
+ */
+struct spdk_scheduler_core_info {
+	uint32_t				lcore;
+
+	/* Busy and idle TSC of the reactor over the last scheduling period */
+	uint64_t				busy_tsc;
+	uint64_t				idle_tsc;
+
+	uint32_t				threads_count;
+	struct spdk_scheduler_thread_info	*threads;
+};
+
+/**
+ * Thread scheduler. It's called periodically on the master reactor with the
+ * metrics of all reactors and decides which threads move to which reactor.
+ */
+struct spdk_scheduler {
+	const char *name;
+
+	/**
+	 * Called when the scheduler is selected. Optional.
+	 */
+	int (*init)(void);
+
+	/**
+	 * Called when another scheduler is selected or the framework stops. Optional.
+	 */
+	void (*deinit)(void);
+
+	/**
+	 * Balance threads across reactors. Set target_lcore of the threads that
+	 * should move. target_lcore is initialized to the current core of each
+	 * thread and must be part of the cpumask of the thread.
+	 *
+	 * A scheduler without balance never moves threads.
+	 *
+	 * \param cores Array of core metrics, indexed by position, not by lcore.
+	 * \param count Number of elements in cores.
+	 */
+	void (*balance)(struct spdk_scheduler_core_info *cores, uint32_t count);
+
+	TAILQ_ENTRY(spdk_scheduler) link;
+};
+
+/**
+ * Add a scheduler to the list of available schedulers.
+ *
+ * \param scheduler Scheduler to add.
+ */
+void spdk_scheduler_list_add(struct spdk_scheduler *scheduler);
+
+/**
+ * Select the scheduler. Must be called on the master reactor.
+ *
+ * \param name Name of the scheduler.
+ *
+ * \return 0 on success, -ENOENT if there's no scheduler with the given name,
+ * or the error returned by the init callback of the scheduler.
+ */
+int spdk_scheduler_set(const char *name);
+
+/**
+ * Get the current scheduler.
+ *
+ * \return the current scheduler.
+ */
+struct spdk_scheduler *spdk_scheduler_get(void);
+
+/**
+ * Set the period of the scheduler. Zero stops scheduling.
+ *
+ * \param period_us Period in microseconds.
+ */
+void spdk_scheduler_set_period(uint64_t period_us);
+
+/**
+ * Get the period of the scheduler.
+ *
+ * \return the period in microseconds.
+ */
+uint64_t spdk_scheduler_get_period(void);
+
+/**
+ * \brief Register a new scheduler
+ */
+#define SPDK_SCHEDULER_REGISTER(scheduler)					\
+	__attribute__((constructor)) static void scheduler ## _register(void)	\
+	{									\
+		spdk_scheduler_list_add(&scheduler);				\
+	}
+
 struct spdk_subsystem {
 	const char *name;
 	/* User must call spdk_subsystem_init_next() when they are done with their initialization. */
@@ -69,6 +69,11 @@ struct spdk_poller {
 
 	uint64_t			period_ticks;
 	uint64_t			next_run_tick;
+
+	/* Timed pollers only. Position in the timer heap of the thread and insertion order. */
+	uint32_t			timer_index;
+	uint64_t			timer_seq;
+
 	uint64_t			run_count;
 	uint64_t			busy_count;
 	spdk_poller_fn			fn;
@@ -102,9 +107,16 @@ struct spdk_thread {
 	 */
 	TAILQ_HEAD(active_pollers_head, spdk_poller)	active_pollers;
 	/**
-	 * Contains pollers running on this thread with a periodic timer.
+	 * Contains pollers running on this thread with a periodic timer, in a
+	 *  binary min-heap ordered by their next scheduled run time. The heap
+	 *  has room for all timed pollers of the thread, including paused ones,
+	 *  so inserting never fails.
 	 */
-	TAILQ_HEAD(timed_pollers_head, spdk_poller)	timed_pollers;
+	struct spdk_poller		**timed_pollers;
+	uint32_t			timed_pollers_count;
+	uint32_t			timed_pollers_size;
+	uint32_t			timed_pollers_reserved;
+	uint64_t			timed_pollers_seq;
 	/*
 	 * Contains paused pollers.  Pollers on this queue are waiting until
 	 * they are resumed (in which case they're put onto the active/timer
@@ -121,6 +133,18 @@ struct spdk_thread {
 	TAILQ_HEAD(, spdk_io_channel)	io_channels;
 	TAILQ_ENTRY(spdk_thread)	tailq;
 
+	/*
+	 * Interrupt mode only. The fd group contains an eventfd signaled by
+	 *  senders of messages, a timerfd expiring with the next timed poller
+	 *  and the fds of registered interrupts.
+	 */
+	struct spdk_fd_group		*fgrp;
+	int				msg_fd;
+	int				timer_fd;
+	uint32_t			num_interrupts;
+	/* Set while the thread waits for its fd group instead of being polled. */
+	bool				intr_armed;
+
 	char				name[SPDK_MAX_THREAD_NAME_LEN + 1];
 	struct spdk_cpuset		cpumask;
 	uint64_t			exit_timeout_tsc;
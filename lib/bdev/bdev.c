@@ -64,6 +64,9 @@ int __itt_init_ittlib(const char *, __itt_group_id);
 #define SPDK_BDEV_AUTO_EXAMINE			true
 #define BUF_SMALL_POOL_SIZE			8191
 #define BUF_LARGE_POOL_SIZE			1023
+#define BUF_SMALL_CACHE_SIZE			128
+#define BUF_LARGE_CACHE_SIZE			16
+#define BUF_CACHE_BULK_SIZE			32
 #define NOMEM_THRESHOLD_COUNT			8
 #define ZERO_BUFFER_SIZE			0x100000
 
@@ -100,6 +103,14 @@ struct spdk_bdev_mgr {
 	struct spdk_mempool *buf_small_pool;
 	struct spdk_mempool *buf_large_pool;
 
+	/* Per thread data buffer cache sizes, capped to what the pools can spare */
+	uint32_t buf_small_cache_size;
+	uint32_t buf_large_cache_size;
+
+	/* Number of threads with bdev_ios waiting for a data buffer from each pool */
+	uint32_t buf_small_waiting_threads;
+	uint32_t buf_large_waiting_threads;
+
 	void *zero_buffer;
 
 	TAILQ_HEAD(bdev_module_list, spdk_bdev_module) bdev_modules;
@@ -138,6 +149,10 @@ static struct spdk_bdev_opts	g_bdev_opts = {
 	.bdev_io_pool_size = SPDK_BDEV_IO_POOL_SIZE,
 	.bdev_io_cache_size = SPDK_BDEV_IO_CACHE_SIZE,
 	.bdev_auto_examine = SPDK_BDEV_AUTO_EXAMINE,
+	.small_buf_pool_size = BUF_SMALL_POOL_SIZE,
+	.large_buf_pool_size = BUF_LARGE_POOL_SIZE,
+	.small_buf_cache_size = BUF_SMALL_CACHE_SIZE,
+	.large_buf_cache_size = BUF_LARGE_CACHE_SIZE,
 };
 
 static spdk_bdev_init_cb	g_init_cb_fn = NULL;
@@ -194,10 +209,40 @@ struct spdk_bdev_qos {
 	struct spdk_poller *poller;
 };
 
+/* Placed at the start of a data buffer while it sits in a bdev_buf_cache */
+struct bdev_buf_cache_entry {
+	STAILQ_ENTRY(bdev_buf_cache_entry)	link;
+};
+
+struct bdev_buf_cache {
+	struct spdk_mempool			*pool;
+	STAILQ_HEAD(, bdev_buf_cache_entry)	bufs;
+	uint32_t				count;
+	uint32_t				size;
+
+	/* Global count of threads waiting for a buffer from the pool, and whether this one is */
+	uint32_t				*waiting_threads;
+	bool					waiting;
+};
+
 struct spdk_bdev_mgmt_channel {
 	bdev_io_stailq_t need_buf_small;
 	bdev_io_stailq_t need_buf_large;
 
+	/*
+	 * Data buffers are cached per thread as well, shared by all bdev channels
+	 *  on the thread.  The caches are refilled from and returned to the global
+	 *  buffer pools in bulk, so most buffer gets and puts don't touch the pools.
+	 */
+	struct bdev_buf_cache buf_small_cache;
+	struct bdev_buf_cache buf_large_cache;
+
+	/*
+	 * Buffers freed on other threads go back to the pools, not to this thread's
+	 *  need_buf queues, so this poller retries the queues while they aren't empty.
+	 */
+	struct spdk_poller *buf_retry_poller;
+
 	/*
 	 * Each thread keeps a cache of bdev_io - this allows
 	 *  bdev threads which are *not* DPDK threads to still
@@ -251,6 +296,14 @@ struct spdk_bdev_shared_resource {
 #define BDEV_CH_RESET_IN_PROGRESS	(1 << 0)
 #define BDEV_CH_QOS_ENABLED		(1 << 1)
 
+/* I/O types with per size latency histograms */
+enum bdev_histogram_io_type {
+	BDEV_HISTOGRAM_IO_TYPE_READ,
+	BDEV_HISTOGRAM_IO_TYPE_WRITE,
+	BDEV_HISTOGRAM_IO_TYPE_UNMAP,
+	BDEV_HISTOGRAM_NUM_IO_TYPES,
+};
+
 struct spdk_bdev_channel {
 	struct spdk_bdev	*bdev;
 
@@ -283,6 +336,15 @@ struct spdk_bdev_channel {
 
 	struct spdk_histogram_data *histogram;
 
+	/* Allocated and freed together with histogram */
+	struct spdk_histogram_data *type_histograms[BDEV_HISTOGRAM_NUM_IO_TYPES]
+	[SPDK_BDEV_HISTOGRAM_SIZE_BUCKETS];
+
+	/* I/O held between spdk_bdev_io_batch_start() and spdk_bdev_io_batch_flush() */
+	bool			batch_started;
+	uint32_t		batch_count;
+	struct spdk_bdev_io	*batch[SPDK_BDEV_IO_BATCH_SIZE];
+
 #ifdef SPDK_CONFIG_VTUNE
 	uint64_t		start_tsc;
 	uint64_t		interval_tsc;
@@ -346,6 +408,9 @@ struct set_qos_limit_ctx {
 static void bdev_write_zero_buffer_done(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg);
 static void bdev_write_zero_buffer_next(void *_bdev_io);
 
+static uint64_t bdev_copy_emulate_max_blocks(struct spdk_bdev *bdev);
+static void bdev_copy_emulate_next(void *_bdev_io);
+
 static void bdev_enable_qos_msg(struct spdk_io_channel_iter *i);
 static void bdev_enable_qos_done(struct spdk_io_channel_iter *i, int status);
 
@@ -383,6 +448,7 @@ spdk_bdev_get_opts(struct spdk_bdev_opts *opts)
 int
 spdk_bdev_set_opts(struct spdk_bdev_opts *opts)
 {
+	struct spdk_bdev_opts new_opts = *opts;
 	uint32_t min_pool_size;
 
 	/*
@@ -399,7 +465,25 @@ spdk_bdev_set_opts(struct spdk_bdev_opts *opts)
 		return -1;
 	}
 
-	g_bdev_opts = *opts;
+	/*
+	 * Callers that predate the data buffer options leave them zeroed, so 0 keeps the default.
+	 *  The cache sizes are checked against the pools in spdk_bdev_initialize(), once the
+	 *  number of cores sharing the pools is known.
+	 */
+	if (new_opts.small_buf_pool_size == 0) {
+		new_opts.small_buf_pool_size = BUF_SMALL_POOL_SIZE;
+	}
+	if (new_opts.large_buf_pool_size == 0) {
+		new_opts.large_buf_pool_size = BUF_LARGE_POOL_SIZE;
+	}
+	if (new_opts.small_buf_cache_size == 0) {
+		new_opts.small_buf_cache_size = BUF_SMALL_CACHE_SIZE;
+	}
+	if (new_opts.large_buf_cache_size == 0) {
+		new_opts.large_buf_cache_size = BUF_LARGE_CACHE_SIZE;
+	}
+
+	g_bdev_opts = new_opts;
 	return 0;
 }
 
@@ -744,11 +828,124 @@ _bdev_io_set_buf(struct spdk_bdev_io *bdev_io, void *buf, uint64_t len)
 	bdev_io_get_buf_complete(bdev_io, buf, true);
 }
 
+static void
+bdev_buf_cache_init(struct bdev_buf_cache *cache, struct spdk_mempool *pool, uint32_t size,
+		    uint32_t *waiting_threads)
+{
+	cache->pool = pool;
+	STAILQ_INIT(&cache->bufs);
+	cache->count = 0;
+	cache->size = size;
+	cache->waiting_threads = waiting_threads;
+	cache->waiting = false;
+}
+
+static inline bool
+bdev_buf_cache_others_waiting(struct bdev_buf_cache *cache)
+{
+	return __atomic_load_n(cache->waiting_threads, __ATOMIC_RELAXED) > (cache->waiting ? 1 : 0);
+}
+
+static void
+bdev_buf_cache_set_waiting(struct bdev_buf_cache *cache, bool waiting)
+{
+	if (cache->waiting == waiting) {
+		return;
+	}
+
+	cache->waiting = waiting;
+	if (waiting) {
+		__atomic_fetch_add(cache->waiting_threads, 1, __ATOMIC_RELAXED);
+	} else {
+		__atomic_fetch_sub(cache->waiting_threads, 1, __ATOMIC_RELAXED);
+	}
+}
+
+/* Return up to count cached buffers to the pool in one bulk put. */
+static void
+bdev_buf_cache_flush(struct bdev_buf_cache *cache, uint32_t count)
+{
+	void *bufs[BUF_CACHE_BULK_SIZE];
+	uint32_t i;
+
+	count = spdk_min(count, spdk_min(cache->count, BUF_CACHE_BULK_SIZE));
+	for (i = 0; i < count; i++) {
+		bufs[i] = STAILQ_FIRST(&cache->bufs);
+		STAILQ_REMOVE_HEAD(&cache->bufs, link);
+	}
+	cache->count -= count;
+
+	spdk_mempool_put_bulk(cache->pool, bufs, count);
+}
+
+static void
+bdev_buf_cache_fini(struct bdev_buf_cache *cache)
+{
+	while (cache->count > 0) {
+		bdev_buf_cache_flush(cache, BUF_CACHE_BULK_SIZE);
+	}
+}
+
+static void *
+bdev_buf_cache_get(struct bdev_buf_cache *cache)
+{
+	struct bdev_buf_cache_entry *entry;
+	void *bufs[BUF_CACHE_BULK_SIZE];
+	uint32_t i, count;
+
+	if (spdk_unlikely(cache->count == 0)) {
+		count = spdk_min(cache->size, BUF_CACHE_BULK_SIZE);
+		if (count == 0 || bdev_buf_cache_others_waiting(cache) ||
+		    spdk_mempool_get_bulk(cache->pool, bufs, count) != 0) {
+			/*
+			 * The cache is disabled, other threads need the pool's buffers more, or
+			 *  the pool can't refill the cache at once.
+			 */
+			return spdk_mempool_get(cache->pool);
+		}
+
+		for (i = 1; i < count; i++) {
+			entry = bufs[i];
+			STAILQ_INSERT_HEAD(&cache->bufs, entry, link);
+		}
+		cache->count = count - 1;
+
+		return bufs[0];
+	}
+
+	entry = STAILQ_FIRST(&cache->bufs);
+	STAILQ_REMOVE_HEAD(&cache->bufs, link);
+	cache->count--;
+
+	return entry;
+}
+
+static void
+bdev_buf_cache_put(struct bdev_buf_cache *cache, void *buf)
+{
+	struct bdev_buf_cache_entry *entry = buf;
+
+	if (spdk_unlikely(bdev_buf_cache_others_waiting(cache))) {
+		/* Don't keep buffers here while other threads wait for them. */
+		spdk_mempool_put(cache->pool, buf);
+		bdev_buf_cache_fini(cache);
+		return;
+	}
+
+	STAILQ_INSERT_HEAD(&cache->bufs, entry, link);
+	cache->count++;
+
+	if (spdk_unlikely(cache->count > cache->size)) {
+		/* Go down to half of the cache so the next puts don't flush right away. */
+		bdev_buf_cache_flush(cache, cache->count - cache->size / 2);
+	}
+}
+
 static void
 _bdev_io_put_buf(struct spdk_bdev_io *bdev_io, void *buf, uint64_t buf_len)
 {
 	struct spdk_bdev *bdev = bdev_io->bdev;
-	struct spdk_mempool *pool;
+	struct bdev_buf_cache *cache;
 	struct spdk_bdev_io *tmp;
 	bdev_io_stailq_t *stailq;
 	struct spdk_bdev_mgmt_channel *ch;
@@ -760,15 +957,15 @@ _bdev_io_put_buf(struct spdk_bdev_io *bdev_io, void *buf, uint64_t buf_len)
 
 	if (buf_len + alignment + md_len <= SPDK_BDEV_BUF_SIZE_WITH_MD(SPDK_BDEV_SMALL_BUF_MAX_SIZE) +
 	    SPDK_BDEV_POOL_ALIGNMENT) {
-		pool = g_bdev_mgr.buf_small_pool;
+		cache = &ch->buf_small_cache;
 		stailq = &ch->need_buf_small;
 	} else {
-		pool = g_bdev_mgr.buf_large_pool;
+		cache = &ch->buf_large_cache;
 		stailq = &ch->need_buf_large;
 	}
 
 	if (STAILQ_EMPTY(stailq)) {
-		spdk_mempool_put(pool, buf);
+		bdev_buf_cache_put(cache, buf);
 	} else {
 		tmp = STAILQ_FIRST(stailq);
 		STAILQ_REMOVE_HEAD(stailq, internal.buf_link);
@@ -836,11 +1033,54 @@ _bdev_io_unset_bounce_buf(struct spdk_bdev_io *bdev_io)
 	bdev_io_put_buf(bdev_io);
 }
 
+/* Hand buffers freed to the pool by other threads to the bdev_ios waiting on this one. */
+static int
+bdev_buf_retry(struct bdev_buf_cache *cache, bdev_io_stailq_t *stailq)
+{
+	struct spdk_bdev_io *bdev_io;
+	void *buf;
+	int count = 0;
+
+	while (!STAILQ_EMPTY(stailq)) {
+		buf = spdk_mempool_get(cache->pool);
+		if (buf == NULL) {
+			break;
+		}
+
+		bdev_io = STAILQ_FIRST(stailq);
+		STAILQ_REMOVE_HEAD(stailq, internal.buf_link);
+		_bdev_io_set_buf(bdev_io, buf, bdev_io->internal.buf_len);
+		count++;
+	}
+
+	if (STAILQ_EMPTY(stailq)) {
+		bdev_buf_cache_set_waiting(cache, false);
+	}
+
+	return count;
+}
+
+static int
+bdev_mgmt_channel_buf_retry(void *ctx)
+{
+	struct spdk_bdev_mgmt_channel *ch = ctx;
+	int count;
+
+	count = bdev_buf_retry(&ch->buf_small_cache, &ch->need_buf_small);
+	count += bdev_buf_retry(&ch->buf_large_cache, &ch->need_buf_large);
+
+	if (!ch->buf_small_cache.waiting && !ch->buf_large_cache.waiting) {
+		spdk_poller_unregister(&ch->buf_retry_poller);
+	}
+
+	return count > 0 ? SPDK_POLLER_BUSY : SPDK_POLLER_IDLE;
+}
+
 static void
 bdev_io_get_buf(struct spdk_bdev_io *bdev_io, uint64_t len)
 {
 	struct spdk_bdev *bdev = bdev_io->bdev;
-	struct spdk_mempool *pool;
+	struct bdev_buf_cache *cache;
 	bdev_io_stailq_t *stailq;
 	struct spdk_bdev_mgmt_channel *mgmt_ch;
 	uint64_t alignment, md_len;
@@ -863,16 +1103,21 @@ bdev_io_get_buf(struct spdk_bdev_io *bdev_io, uint64_t len)
 
 	if (len + alignment + md_len <= SPDK_BDEV_BUF_SIZE_WITH_MD(SPDK_BDEV_SMALL_BUF_MAX_SIZE) +
 	    SPDK_BDEV_POOL_ALIGNMENT) {
-		pool = g_bdev_mgr.buf_small_pool;
+		cache = &mgmt_ch->buf_small_cache;
 		stailq = &mgmt_ch->need_buf_small;
 	} else {
-		pool = g_bdev_mgr.buf_large_pool;
+		cache = &mgmt_ch->buf_large_cache;
 		stailq = &mgmt_ch->need_buf_large;
 	}
 
-	buf = spdk_mempool_get(pool);
+	buf = bdev_buf_cache_get(cache);
 	if (!buf) {
 		STAILQ_INSERT_TAIL(stailq, bdev_io, internal.buf_link);
+		bdev_buf_cache_set_waiting(cache, true);
+		if (mgmt_ch->buf_retry_poller == NULL) {
+			mgmt_ch->buf_retry_poller = SPDK_POLLER_REGISTER(bdev_mgmt_channel_buf_retry,
+						    mgmt_ch, 0);
+		}
 	} else {
 		_bdev_io_set_buf(bdev_io, buf, len);
 	}
@@ -981,6 +1226,10 @@ spdk_bdev_subsystem_config_json(struct spdk_json_write_ctx *w)
 	spdk_json_write_named_uint32(w, "bdev_io_pool_size", g_bdev_opts.bdev_io_pool_size);
 	spdk_json_write_named_uint32(w, "bdev_io_cache_size", g_bdev_opts.bdev_io_cache_size);
 	spdk_json_write_named_bool(w, "bdev_auto_examine", g_bdev_opts.bdev_auto_examine);
+	spdk_json_write_named_uint32(w, "small_buf_pool_size", g_bdev_opts.small_buf_pool_size);
+	spdk_json_write_named_uint32(w, "large_buf_pool_size", g_bdev_opts.large_buf_pool_size);
+	spdk_json_write_named_uint32(w, "small_buf_cache_size", g_bdev_opts.small_buf_cache_size);
+	spdk_json_write_named_uint32(w, "large_buf_cache_size", g_bdev_opts.large_buf_cache_size);
 	spdk_json_write_object_end(w);
 	spdk_json_write_object_end(w);
 
@@ -1015,6 +1264,12 @@ bdev_mgmt_channel_create(void *io_device, void *ctx_buf)
 	STAILQ_INIT(&ch->need_buf_small);
 	STAILQ_INIT(&ch->need_buf_large);
 
+	bdev_buf_cache_init(&ch->buf_small_cache, g_bdev_mgr.buf_small_pool,
+			    g_bdev_mgr.buf_small_cache_size, &g_bdev_mgr.buf_small_waiting_threads);
+	bdev_buf_cache_init(&ch->buf_large_cache, g_bdev_mgr.buf_large_pool,
+			    g_bdev_mgr.buf_large_cache_size, &g_bdev_mgr.buf_large_waiting_threads);
+	ch->buf_retry_poller = NULL;
+
 	STAILQ_INIT(&ch->per_thread_cache);
 	ch->bdev_io_cache_size = g_bdev_opts.bdev_io_cache_size;
 
@@ -1047,6 +1302,12 @@ bdev_mgmt_channel_destroy(void *io_device, void *ctx_buf)
 		SPDK_ERRLOG("Module channel list wasn't empty on mgmt channel free\n");
 	}
 
+	spdk_poller_unregister(&ch->buf_retry_poller);
+	bdev_buf_cache_set_waiting(&ch->buf_small_cache, false);
+	bdev_buf_cache_set_waiting(&ch->buf_large_cache, false);
+	bdev_buf_cache_fini(&ch->buf_small_cache);
+	bdev_buf_cache_fini(&ch->buf_large_cache);
+
 	while (!STAILQ_EMPTY(&ch->per_thread_cache)) {
 		bdev_io = STAILQ_FIRST(&ch->per_thread_cache);
 		STAILQ_REMOVE_HEAD(&ch->per_thread_cache, internal.buf_link);
@@ -1173,6 +1434,28 @@ bdev_modules_init(void)
 	return 0;
 }
 
+/*
+ * The per thread data buffer caches share what the mempool's per core caches leave of a pool.
+ *  Cap them to half of that, so that buffers sitting in caches can't starve the threads doing I/O.
+ */
+static uint32_t
+bdev_buf_cache_cap_size(const char *name, uint32_t cache_size, uint32_t pool_size,
+			uint32_t mempool_cache_size)
+{
+	uint32_t core_count = spdk_env_get_core_count();
+	uint32_t max_cache_size;
+
+	max_cache_size = (pool_size - mempool_cache_size * core_count) / (2 * core_count);
+	if (cache_size > max_cache_size) {
+		SPDK_NOTICELOG("%s_buf_cache_size %" PRIu32 " is too large for %s_buf_pool_size %" PRIu32
+			       " and %" PRIu32 " cores, using %" PRIu32 "\n", name, cache_size, name,
+			       pool_size, core_count, max_cache_size);
+		return max_cache_size;
+	}
+
+	return cache_size;
+}
+
 void
 spdk_bdev_initialize(spdk_bdev_init_cb cb_fn, void *cb_arg)
 {
@@ -1233,11 +1516,11 @@ spdk_bdev_initialize(spdk_bdev_init_cb cb_fn, void *cb_arg)
 	 *   using spdk_env_get_core_count() to determine how many local caches we need
 	 *   to account for.
 	 */
-	cache_size = BUF_SMALL_POOL_SIZE / (2 * spdk_env_get_core_count());
+	cache_size = g_bdev_opts.small_buf_pool_size / (2 * spdk_env_get_core_count());
 	snprintf(mempool_name, sizeof(mempool_name), "buf_small_pool_%d", getpid());
 
 	g_bdev_mgr.buf_small_pool = spdk_mempool_create(mempool_name,
-				    BUF_SMALL_POOL_SIZE,
+				    g_bdev_opts.small_buf_pool_size,
 				    SPDK_BDEV_BUF_SIZE_WITH_MD(SPDK_BDEV_SMALL_BUF_MAX_SIZE) +
 				    SPDK_BDEV_POOL_ALIGNMENT,
 				    cache_size,
@@ -1248,11 +1531,16 @@ spdk_bdev_initialize(spdk_bdev_init_cb cb_fn, void *cb_arg)
 		return;
 	}
 
-	cache_size = BUF_LARGE_POOL_SIZE / (2 * spdk_env_get_core_count());
+	g_bdev_mgr.buf_small_cache_size = bdev_buf_cache_cap_size("small",
+					  g_bdev_opts.small_buf_cache_size,
+					  g_bdev_opts.small_buf_pool_size,
+					  cache_size);
+
+	cache_size = g_bdev_opts.large_buf_pool_size / (2 * spdk_env_get_core_count());
 	snprintf(mempool_name, sizeof(mempool_name), "buf_large_pool_%d", getpid());
 
 	g_bdev_mgr.buf_large_pool = spdk_mempool_create(mempool_name,
-				    BUF_LARGE_POOL_SIZE,
+				    g_bdev_opts.large_buf_pool_size,
 				    SPDK_BDEV_BUF_SIZE_WITH_MD(SPDK_BDEV_LARGE_BUF_MAX_SIZE) +
 				    SPDK_BDEV_POOL_ALIGNMENT,
 				    cache_size,
@@ -1263,6 +1551,11 @@ spdk_bdev_initialize(spdk_bdev_init_cb cb_fn, void *cb_arg)
 		return;
 	}
 
+	g_bdev_mgr.buf_large_cache_size = bdev_buf_cache_cap_size("large",
+					  g_bdev_opts.large_buf_cache_size,
+					  g_bdev_opts.large_buf_pool_size,
+					  cache_size);
+
 	g_bdev_mgr.zero_buffer = spdk_zmalloc(ZERO_BUFFER_SIZE, ZERO_BUFFER_SIZE,
 					      NULL, SPDK_ENV_LCORE_ID_ANY, SPDK_MALLOC_DMA);
 	if (!g_bdev_mgr.zero_buffer) {
@@ -1306,10 +1599,10 @@ bdev_mgr_unregister_cb(void *io_device)
 	}
 
 	if (g_bdev_mgr.buf_small_pool) {
-		if (spdk_mempool_count(g_bdev_mgr.buf_small_pool) != BUF_SMALL_POOL_SIZE) {
+		if (spdk_mempool_count(g_bdev_mgr.buf_small_pool) != g_bdev_opts.small_buf_pool_size) {
 			SPDK_ERRLOG("Small buffer pool count is %zu but should be %u\n",
 				    spdk_mempool_count(g_bdev_mgr.buf_small_pool),
-				    BUF_SMALL_POOL_SIZE);
+				    g_bdev_opts.small_buf_pool_size);
 			assert(false);
 		}
 
@@ -1317,10 +1610,10 @@ bdev_mgr_unregister_cb(void *io_device)
 	}
 
 	if (g_bdev_mgr.buf_large_pool) {
-		if (spdk_mempool_count(g_bdev_mgr.buf_large_pool) != BUF_LARGE_POOL_SIZE) {
+		if (spdk_mempool_count(g_bdev_mgr.buf_large_pool) != g_bdev_opts.large_buf_pool_size) {
 			SPDK_ERRLOG("Large buffer pool count is %zu but should be %u\n",
 				    spdk_mempool_count(g_bdev_mgr.buf_large_pool),
-				    BUF_LARGE_POOL_SIZE);
+				    g_bdev_opts.large_buf_pool_size);
 			assert(false);
 		}
 
@@ -1733,6 +2026,39 @@ _bdev_io_complete_in_submit(struct spdk_bdev_channel *bdev_ch,
 	bdev_io->internal.in_submit_request = false;
 }
 
+static void
+bdev_channel_submit_batch(struct spdk_bdev_channel *bdev_ch)
+{
+	struct spdk_bdev *bdev = bdev_ch->bdev;
+	struct spdk_io_channel *ch = bdev_ch->channel;
+	struct spdk_bdev_io *batch[SPDK_BDEV_IO_BATCH_SIZE];
+	uint32_t i, count = bdev_ch->batch_count;
+
+	if (count == 0) {
+		return;
+	}
+
+	/* The module may complete I/O inline and completion callbacks may start a new batch. */
+	memcpy(batch, bdev_ch->batch, count * sizeof(batch[0]));
+	bdev_ch->batch_count = 0;
+
+	if (bdev->fn_table->submit_request_batch != NULL) {
+		for (i = 0; i < count; i++) {
+			batch[i]->internal.in_submit_request = true;
+		}
+		bdev->fn_table->submit_request_batch(ch, batch, count);
+		for (i = 0; i < count; i++) {
+			batch[i]->internal.in_submit_request = false;
+		}
+	} else {
+		for (i = 0; i < count; i++) {
+			batch[i]->internal.in_submit_request = true;
+			bdev->fn_table->submit_request(ch, batch[i]);
+			batch[i]->internal.in_submit_request = false;
+		}
+	}
+}
+
 static inline void
 bdev_io_do_submit(struct spdk_bdev_channel *bdev_ch, struct spdk_bdev_io *bdev_io)
 {
@@ -1756,6 +2082,13 @@ bdev_io_do_submit(struct spdk_bdev_channel *bdev_ch, struct spdk_bdev_io *bdev_i
 	if (spdk_likely(TAILQ_EMPTY(&shared_resource->nomem_io))) {
 		bdev_ch->io_outstanding++;
 		shared_resource->io_outstanding++;
+		if (spdk_unlikely(bdev_ch->batch_started)) {
+			bdev_ch->batch[bdev_ch->batch_count++] = bdev_io;
+			if (bdev_ch->batch_count == SPDK_BDEV_IO_BATCH_SIZE) {
+				bdev_channel_submit_batch(bdev_ch);
+			}
+			return;
+		}
 		bdev_io->internal.in_submit_request = true;
 		bdev->fn_table->submit_request(ch, bdev_io);
 		bdev_io->internal.in_submit_request = false;
@@ -1871,21 +2204,75 @@ _to_next_boundary(uint64_t offset, uint32_t boundary)
 static void
 bdev_io_split_done(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg);
 
+/* Child I/O built by _bdev_io_split() before it is submitted. */
+struct bdev_io_split_child {
+	struct iovec	*iov;
+	int		iovcnt;
+	void		*md_buf;
+	uint64_t	offset_blocks;
+	uint64_t	num_blocks;
+};
+
+/*
+ * Get up to count bdev_ios for child I/O.  The per thread cache is drained first and the
+ *  rest is taken from the global pool in a single bulk get.  Returns the number of bdev_ios
+ *  placed in bdev_ios.
+ */
+static uint32_t
+bdev_channel_get_io_bulk(struct spdk_bdev_channel *channel, struct spdk_bdev_io **bdev_ios,
+			 uint32_t count)
+{
+	struct spdk_bdev_mgmt_channel *ch = channel->shared_resource->mgmt_ch;
+	uint32_t i;
+
+	for (i = 0; i < count && ch->per_thread_cache_count > 0; i++) {
+		bdev_ios[i] = STAILQ_FIRST(&ch->per_thread_cache);
+		STAILQ_REMOVE_HEAD(&ch->per_thread_cache, internal.buf_link);
+		ch->per_thread_cache_count--;
+	}
+
+	if (i == count || spdk_unlikely(!TAILQ_EMPTY(&ch->io_wait_queue))) {
+		/* Same as bdev_channel_get_io(), don't jump the line of bdev_io waiters. */
+		return i;
+	}
+
+	if (spdk_mempool_get_bulk(g_bdev_mgr.bdev_io_pool, (void **)&bdev_ios[i], count - i) == 0) {
+		return count;
+	}
+
+	/* The pool can't satisfy the whole batch, so take what is left one at a time. */
+	for (; i < count; i++) {
+		bdev_ios[i] = spdk_mempool_get(g_bdev_mgr.bdev_io_pool);
+		if (bdev_ios[i] == NULL) {
+			break;
+		}
+	}
+
+	return i;
+}
+
 static void
 _bdev_io_split(void *_bdev_io)
 {
 	struct spdk_bdev_io *bdev_io = _bdev_io;
+	struct bdev_io_split_child children[BDEV_IO_NUM_CHILD_IOV];
+	struct spdk_bdev_io *child_ios[BDEV_IO_NUM_CHILD_IOV];
+	struct bdev_io_split_child *child;
+	struct spdk_bdev_io *child_io;
+	struct spdk_bdev_channel *channel = bdev_io->internal.ch;
+	struct spdk_bdev *bdev = bdev_io->bdev;
 	uint64_t current_offset, remaining;
 	uint32_t blocklen, to_next_boundary, to_next_boundary_bytes, to_last_block_bytes;
 	struct iovec *parent_iov, *iov;
 	uint64_t parent_iov_offset, iov_len;
 	uint32_t parent_iovpos, parent_iovcnt, child_iovcnt, iovcnt;
+	uint32_t num_children, num_child_ios, i;
+	bool batch_started;
 	void *md_buf = NULL;
-	int rc;
 
 	remaining = bdev_io->u.bdev.split_remaining_num_blocks;
 	current_offset = bdev_io->u.bdev.split_current_offset_blocks;
-	blocklen = bdev_io->bdev->blocklen;
+	blocklen = bdev->blocklen;
 	parent_iov_offset = (current_offset - bdev_io->u.bdev.offset_blocks) * blocklen;
 	parent_iovcnt = bdev_io->u.bdev.iovcnt;
 
@@ -1897,9 +2284,14 @@ _bdev_io_split(void *_bdev_io)
 		parent_iov_offset -= parent_iov->iov_len;
 	}
 
+	/*
+	 * Build the iovec windows of all child I/O that fit into child_iov first, so the
+	 *  bdev_ios for them can be taken in one go and submitted as a batch below.
+	 */
+	num_children = 0;
 	child_iovcnt = 0;
 	while (remaining > 0 && parent_iovpos < parent_iovcnt && child_iovcnt < BDEV_IO_NUM_CHILD_IOV) {
-		to_next_boundary = _to_next_boundary(current_offset, bdev_io->bdev->optimal_io_boundary);
+		to_next_boundary = _to_next_boundary(current_offset, bdev->optimal_io_boundary);
 		to_next_boundary = spdk_min(remaining, to_next_boundary);
 		to_next_boundary_bytes = to_next_boundary * blocklen;
 		iov = &bdev_io->child_iov[child_iovcnt];
@@ -1908,7 +2300,7 @@ _bdev_io_split(void *_bdev_io)
 		if (bdev_io->u.bdev.md_buf) {
 			assert((parent_iov_offset % blocklen) > 0);
 			md_buf = (char *)bdev_io->u.bdev.md_buf + (parent_iov_offset / blocklen) *
-				 spdk_bdev_get_md_size(bdev_io->bdev);
+				 spdk_bdev_get_md_size(bdev);
 		}
 
 		while (to_next_boundary_bytes > 0 && parent_iovpos < parent_iovcnt &&
@@ -1951,57 +2343,85 @@ _bdev_io_split(void *_bdev_io)
 					if (bdev_io->child_iov[child_iovpos].iov_len == 0) {
 						child_iovpos--;
 						if (--iovcnt == 0) {
-							return;
+							break;
 						}
 					}
 					to_last_block_bytes -= iov_len;
 				}
 
+				if (iovcnt == 0) {
+					/* Not even one block of this child fits, leave it for the next round. */
+					break;
+				}
+
 				assert(to_last_block_bytes == 0);
 			}
 			to_next_boundary -= to_next_boundary_bytes / blocklen;
 		}
 
-		bdev_io->u.bdev.split_outstanding++;
+		child = &children[num_children++];
+		child->iov = iov;
+		child->iovcnt = iovcnt;
+		child->md_buf = md_buf;
+		child->offset_blocks = current_offset;
+		child->num_blocks = to_next_boundary;
 
-		if (bdev_io->type == SPDK_BDEV_IO_TYPE_READ) {
-			rc = bdev_readv_blocks_with_md(bdev_io->internal.desc,
-						       spdk_io_channel_from_ctx(bdev_io->internal.ch),
-						       iov, iovcnt, md_buf, current_offset,
-						       to_next_boundary,
-						       bdev_io_split_done, bdev_io);
-		} else {
-			rc = bdev_writev_blocks_with_md(bdev_io->internal.desc,
-							spdk_io_channel_from_ctx(bdev_io->internal.ch),
-							iov, iovcnt, md_buf, current_offset,
-							to_next_boundary,
-							bdev_io_split_done, bdev_io);
-		}
+		current_offset += to_next_boundary;
+		remaining -= to_next_boundary;
+	}
 
-		if (rc == 0) {
-			current_offset += to_next_boundary;
-			remaining -= to_next_boundary;
-			bdev_io->u.bdev.split_current_offset_blocks = current_offset;
-			bdev_io->u.bdev.split_remaining_num_blocks = remaining;
-		} else {
-			bdev_io->u.bdev.split_outstanding--;
-			if (rc == -ENOMEM) {
-				if (bdev_io->u.bdev.split_outstanding == 0) {
-					/* No I/O is outstanding. Hence we should wait here. */
-					bdev_queue_io_wait_with_cb(bdev_io, _bdev_io_split);
-				}
-			} else {
-				bdev_io->internal.status = SPDK_BDEV_IO_STATUS_FAILED;
-				if (bdev_io->u.bdev.split_outstanding == 0) {
-					spdk_trace_record_tsc(spdk_get_ticks(), TRACE_BDEV_IO_DONE, 0, 0,
-							      (uintptr_t)bdev_io, 0);
-					TAILQ_REMOVE(&bdev_io->internal.ch->io_submitted, bdev_io, internal.ch_link);
-					bdev_io->internal.cb(bdev_io, false, bdev_io->internal.caller_ctx);
-				}
-			}
+	if (num_children == 0) {
+		return;
+	}
 
-			return;
+	num_child_ios = bdev_channel_get_io_bulk(channel, child_ios, num_children);
+	if (num_child_ios == 0) {
+		if (bdev_io->u.bdev.split_outstanding == 0) {
+			/* No I/O is outstanding. Hence we should wait here. */
+			bdev_queue_io_wait_with_cb(bdev_io, _bdev_io_split);
 		}
+		return;
+	}
+
+	/*
+	 * Account for the whole batch before submitting any child.  A child may complete
+	 *  inline, and the parent must not finish or split again until the last one is
+	 *  submitted.  The parent may be gone once that has happened, so it is not touched
+	 *  afterwards.
+	 */
+	child = &children[num_child_ios - 1];
+	bdev_io->u.bdev.split_current_offset_blocks = child->offset_blocks + child->num_blocks;
+	bdev_io->u.bdev.split_remaining_num_blocks = bdev_io->u.bdev.offset_blocks +
+			bdev_io->u.bdev.num_blocks - bdev_io->u.bdev.split_current_offset_blocks;
+	bdev_io->u.bdev.split_outstanding += num_child_ios;
+
+	/*
+	 * Children are within the parent's range, which was validated on submission, so
+	 *  they skip the checks of the public submit functions.  They are handed to the
+	 *  module as one batch unless the caller already started one on this channel.
+	 */
+	batch_started = channel->batch_started;
+	channel->batch_started = true;
+	for (i = 0; i < num_child_ios; i++) {
+		child = &children[i];
+		child_io = child_ios[i];
+
+		child_io->internal.ch = channel;
+		child_io->internal.desc = bdev_io->internal.desc;
+		child_io->type = bdev_io->type;
+		child_io->u.bdev.iovs = child->iov;
+		child_io->u.bdev.iovcnt = child->iovcnt;
+		child_io->u.bdev.md_buf = child->md_buf;
+		child_io->u.bdev.num_blocks = child->num_blocks;
+		child_io->u.bdev.offset_blocks = child->offset_blocks;
+		bdev_io_init(child_io, bdev, bdev_io, bdev_io_split_done);
+
+		bdev_io_submit(child_io);
+	}
+
+	if (!batch_started) {
+		channel->batch_started = false;
+		bdev_channel_submit_batch(channel);
 	}
 }
 
@@ -2150,6 +2570,7 @@ bdev_io_range_is_locked(struct spdk_bdev_io *bdev_io, struct lba_range *range)
 	case SPDK_BDEV_IO_TYPE_UNMAP:
 	case SPDK_BDEV_IO_TYPE_WRITE_ZEROES:
 	case SPDK_BDEV_IO_TYPE_ZCOPY:
+	case SPDK_BDEV_IO_TYPE_COPY:
 		r.offset = bdev_io->u.bdev.offset_blocks;
 		r.length = bdev_io->u.bdev.num_blocks;
 		if (!bdev_lba_range_overlapped(range, &r)) {
@@ -2272,6 +2693,12 @@ spdk_bdev_io_type_supported(struct spdk_bdev *bdev, enum spdk_bdev_io_type io_ty
 			supported = bdev_io_type_supported(bdev, SPDK_BDEV_IO_TYPE_READ) &&
 				    bdev_io_type_supported(bdev, SPDK_BDEV_IO_TYPE_WRITE);
 			break;
+		case SPDK_BDEV_IO_TYPE_COPY:
+			/* Copy is emulated with reads and writes of chunks that fit a data buffer */
+			supported = bdev_io_type_supported(bdev, SPDK_BDEV_IO_TYPE_READ) &&
+				    bdev_io_type_supported(bdev, SPDK_BDEV_IO_TYPE_WRITE) &&
+				    bdev_copy_emulate_max_blocks(bdev) != 0;
+			break;
 		default:
 			break;
 		}
@@ -2568,6 +2995,79 @@ spdk_bdev_set_timeout(struct spdk_bdev_desc *desc, uint64_t timeout_in_sec,
 	return 0;
 }
 
+static inline int
+bdev_histogram_io_type(enum spdk_bdev_io_type io_type)
+{
+	switch (io_type) {
+	case SPDK_BDEV_IO_TYPE_READ:
+		return BDEV_HISTOGRAM_IO_TYPE_READ;
+	case SPDK_BDEV_IO_TYPE_WRITE:
+		return BDEV_HISTOGRAM_IO_TYPE_WRITE;
+	case SPDK_BDEV_IO_TYPE_UNMAP:
+		return BDEV_HISTOGRAM_IO_TYPE_UNMAP;
+	default:
+		return -1;
+	}
+}
+
+static inline uint32_t
+bdev_histogram_size_bucket(uint64_t num_bytes)
+{
+	uint32_t bucket;
+
+	if (num_bytes < SPDK_BDEV_HISTOGRAM_SIZE_BUCKET_MIN(1)) {
+		return 0;
+	}
+
+	bucket = spdk_u64log2(num_bytes) - 12;
+
+	return spdk_min(bucket, SPDK_BDEV_HISTOGRAM_SIZE_BUCKETS - 1);
+}
+
+static void
+bdev_channel_free_histograms(struct spdk_bdev_channel *ch)
+{
+	uint32_t type, bucket;
+
+	spdk_histogram_data_free(ch->histogram);
+	ch->histogram = NULL;
+
+	for (type = 0; type < BDEV_HISTOGRAM_NUM_IO_TYPES; type++) {
+		for (bucket = 0; bucket < SPDK_BDEV_HISTOGRAM_SIZE_BUCKETS; bucket++) {
+			spdk_histogram_data_free(ch->type_histograms[type][bucket]);
+			ch->type_histograms[type][bucket] = NULL;
+		}
+	}
+}
+
+static int
+bdev_channel_alloc_histograms(struct spdk_bdev_channel *ch)
+{
+	uint32_t type, bucket;
+
+	if (ch->histogram != NULL) {
+		return 0;
+	}
+
+	ch->histogram = spdk_histogram_data_alloc();
+	if (ch->histogram == NULL) {
+		return -ENOMEM;
+	}
+
+	for (type = 0; type < BDEV_HISTOGRAM_NUM_IO_TYPES; type++) {
+		for (bucket = 0; bucket < SPDK_BDEV_HISTOGRAM_SIZE_BUCKETS; bucket++) {
+			ch->type_histograms[type][bucket] =
+				spdk_histogram_data_alloc_sized(SPDK_BDEV_HISTOGRAM_BY_TYPE_BUCKET_SHIFT);
+			if (ch->type_histograms[type][bucket] == NULL) {
+				bdev_channel_free_histograms(ch);
+				return -ENOMEM;
+			}
+		}
+	}
+
+	return 0;
+}
+
 static int
 bdev_channel_create(void *io_device, void *ctx_buf)
 {
@@ -2586,8 +3086,7 @@ bdev_channel_create(void *io_device, void *ctx_buf)
 
 	assert(ch->histogram == NULL);
 	if (bdev->internal.histogram_enabled) {
-		ch->histogram = spdk_histogram_data_alloc();
-		if (ch->histogram == NULL) {
+		if (bdev_channel_alloc_histograms(ch) != 0) {
 			SPDK_ERRLOG("Could not allocate histogram\n");
 		}
 	}
@@ -2727,6 +3226,32 @@ bdev_abort_all_queued_io(bdev_io_tailq_t *queue, struct spdk_bdev_channel *ch)
 	}
 }
 
+/*
+ * A batch that was started but never flushed is aborted.  Its I/O was accounted in
+ *  io_outstanding when it was held, so spdk_bdev_io_complete() needs no extra bump.
+ */
+static void
+bdev_abort_all_batch_io(struct spdk_bdev_channel *ch)
+{
+	struct spdk_bdev_io *batch[SPDK_BDEV_IO_BATCH_SIZE];
+	uint32_t i, count = ch->batch_count;
+
+	ch->batch_started = false;
+	if (count == 0) {
+		return;
+	}
+
+	SPDK_ERRLOG("Batch of %" PRIu32 " I/O wasn't flushed on bdev channel free\n", count);
+
+	/* Completion callbacks must not see the aborted I/O still held by the channel. */
+	memcpy(batch, ch->batch, count * sizeof(batch[0]));
+	ch->batch_count = 0;
+
+	for (i = 0; i < count; i++) {
+		spdk_bdev_io_complete(batch[i], SPDK_BDEV_IO_STATUS_ABORTED);
+	}
+}
+
 static bool
 bdev_abort_queued_io(bdev_io_tailq_t *queue, struct spdk_bdev_io *bio_to_abort)
 {
@@ -2865,10 +3390,9 @@ bdev_channel_destroy(void *io_device, void *ctx_buf)
 	bdev_abort_all_queued_io(&shared_resource->nomem_io, ch);
 	bdev_abort_all_buf_io(&mgmt_ch->need_buf_small, ch);
 	bdev_abort_all_buf_io(&mgmt_ch->need_buf_large, ch);
+	bdev_abort_all_batch_io(ch);
 
-	if (ch->histogram) {
-		spdk_histogram_data_free(ch->histogram);
-	}
+	bdev_channel_free_histograms(ch);
 
 	bdev_channel_destroy_resource(ch);
 }
@@ -2943,6 +3467,23 @@ spdk_bdev_get_io_channel(struct spdk_bdev_desc *desc)
 	return spdk_get_io_channel(__bdev_to_io_dev(spdk_bdev_desc_get_bdev(desc)));
 }
 
+void
+spdk_bdev_io_batch_start(struct spdk_io_channel *ch)
+{
+	struct spdk_bdev_channel *channel = spdk_io_channel_get_ctx(ch);
+
+	channel->batch_started = true;
+}
+
+void
+spdk_bdev_io_batch_flush(struct spdk_io_channel *ch)
+{
+	struct spdk_bdev_channel *channel = spdk_io_channel_get_ctx(ch);
+
+	channel->batch_started = false;
+	bdev_channel_submit_batch(channel);
+}
+
 const char *
 spdk_bdev_get_name(const struct spdk_bdev *bdev)
 {
@@ -4140,6 +4681,70 @@ spdk_bdev_write_zeroes_blocks(struct spdk_bdev_desc *desc, struct spdk_io_channe
 	return 0;
 }
 
+int
+spdk_bdev_copy_blocks(struct spdk_bdev_desc *desc, struct spdk_io_channel *ch,
+		      uint64_t dst_offset_blocks, uint64_t src_offset_blocks,
+		      uint64_t num_blocks, spdk_bdev_io_completion_cb cb, void *cb_arg)
+{
+	struct spdk_bdev *bdev = spdk_bdev_desc_get_bdev(desc);
+	struct spdk_bdev_io *bdev_io;
+	struct spdk_bdev_channel *channel = spdk_io_channel_get_ctx(ch);
+
+	if (!desc->write) {
+		return -EBADF;
+	}
+
+	if (!bdev_io_valid_blocks(bdev, dst_offset_blocks, num_blocks) ||
+	    !bdev_io_valid_blocks(bdev, src_offset_blocks, num_blocks)) {
+		return -EINVAL;
+	}
+
+	if (num_blocks == 0) {
+		SPDK_ERRLOG("Can't copy 0 blocks\n");
+		return -EINVAL;
+	}
+
+	if (src_offset_blocks < dst_offset_blocks + num_blocks &&
+	    dst_offset_blocks < src_offset_blocks + num_blocks) {
+		SPDK_ERRLOG("Source and destination of the copy overlap\n");
+		return -EINVAL;
+	}
+
+	if (!bdev_io_type_supported(bdev, SPDK_BDEV_IO_TYPE_COPY) &&
+	    (!bdev_io_type_supported(bdev, SPDK_BDEV_IO_TYPE_READ) ||
+	     !bdev_io_type_supported(bdev, SPDK_BDEV_IO_TYPE_WRITE) ||
+	     bdev_copy_emulate_max_blocks(bdev) == 0)) {
+		return -ENOTSUP;
+	}
+
+	bdev_io = bdev_channel_get_io(channel);
+	if (!bdev_io) {
+		return -ENOMEM;
+	}
+
+	bdev_io->internal.ch = channel;
+	bdev_io->internal.desc = desc;
+	bdev_io->type = SPDK_BDEV_IO_TYPE_COPY;
+	bdev_io->u.bdev.iovs = NULL;
+	bdev_io->u.bdev.iovcnt = 0;
+	bdev_io->u.bdev.md_buf = NULL;
+	bdev_io->u.bdev.offset_blocks = dst_offset_blocks;
+	bdev_io->u.bdev.num_blocks = num_blocks;
+	bdev_io->u.bdev.copy.src_offset_blocks = src_offset_blocks;
+	bdev_io_init(bdev_io, bdev, cb_arg, cb);
+
+	if (bdev_io_type_supported(bdev, SPDK_BDEV_IO_TYPE_COPY)) {
+		bdev_io_submit(bdev_io);
+		return 0;
+	}
+
+	bdev_io->u.bdev.split_remaining_num_blocks = num_blocks;
+	bdev_io->u.bdev.split_current_offset_blocks = dst_offset_blocks;
+	bdev_copy_emulate_next(bdev_io);
+
+	return 0;
+}
+
 int
 spdk_bdev_unmap(struct spdk_bdev_desc *desc, struct spdk_io_channel *ch,
 		uint64_t offset, uint64_t nbytes,
@@ -4843,7 +5448,14 @@ bdev_io_complete(void *ctx)
 	TAILQ_REMOVE(&bdev_ch->io_submitted, bdev_io, internal.ch_link);
 
 	if (bdev_io->internal.ch->histogram) {
+		int type = bdev_histogram_io_type(bdev_io->type);
+
 		spdk_histogram_data_tally(bdev_io->internal.ch->histogram, tsc_diff);
+		if (type >= 0) {
+			spdk_histogram_data_tally(bdev_io->internal.ch->type_histograms[type]
+						  [bdev_histogram_size_bucket(bdev_io->u.bdev.num_blocks * bdev_io->bdev->blocklen)],
+						  tsc_diff);
+		}
 	}
 
 	if (bdev_io->internal.status == SPDK_BDEV_IO_STATUS_SUCCESS) {
@@ -5929,6 +6541,115 @@ bdev_write_zero_buffer_done(struct spdk_bdev_io *bdev_io, bool success, void *cb
 	bdev_write_zero_buffer_next(parent_io);
 }
 
+/* Chunks of an emulated copy are read into buffers from the bdev buffer pools */
+static uint64_t
+bdev_copy_emulate_max_blocks(struct spdk_bdev *bdev)
+{
+	uint64_t alignment = spdk_bdev_get_buf_align(bdev);
+
+	if (alignment >= SPDK_BDEV_LARGE_BUF_MAX_SIZE) {
+		return 0;
+	}
+
+	return (SPDK_BDEV_LARGE_BUF_MAX_SIZE - alignment) / spdk_bdev_get_block_size(bdev);
+}
+
+static void
+bdev_copy_emulate_complete(struct spdk_bdev_io *parent_io, bool success)
+{
+	parent_io->internal.status = success ? SPDK_BDEV_IO_STATUS_SUCCESS : SPDK_BDEV_IO_STATUS_FAILED;
+	parent_io->internal.cb(parent_io, success, parent_io->internal.caller_ctx);
+}
+
+static void
+bdev_copy_emulate_write_done(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct spdk_bdev_io *read_io = cb_arg;
+	struct spdk_bdev_io *parent_io = read_io->internal.caller_ctx;
+
+	spdk_bdev_free_io(bdev_io);
+	spdk_bdev_free_io(read_io);
+
+	if (!success) {
+		bdev_copy_emulate_complete(parent_io, false);
+		return;
+	}
+
+	if (parent_io->u.bdev.split_remaining_num_blocks == 0) {
+		bdev_copy_emulate_complete(parent_io, true);
+		return;
+	}
+
+	bdev_copy_emulate_next(parent_io);
+}
+
+/* Write out the data of a completed read, its buffer is released with the read */
+static void
+bdev_copy_emulate_write(void *_read_io)
+{
+	struct spdk_bdev_io *read_io = _read_io;
+	struct spdk_bdev_io *parent_io = read_io->internal.caller_ctx;
+	uint64_t dst_offset_blocks;
+	int rc;
+
+	dst_offset_blocks = parent_io->u.bdev.offset_blocks +
+			    (read_io->u.bdev.offset_blocks - parent_io->u.bdev.copy.src_offset_blocks);
+
+	rc = bdev_writev_blocks_with_md(parent_io->internal.desc,
+					spdk_io_channel_from_ctx(parent_io->internal.ch),
+					read_io->u.bdev.iovs, read_io->u.bdev.iovcnt,
+					read_io->u.bdev.md_buf, dst_offset_blocks,
+					read_io->u.bdev.num_blocks,
+					bdev_copy_emulate_write_done, read_io);
+	if (rc == -ENOMEM) {
+		bdev_queue_io_wait_with_cb(read_io, bdev_copy_emulate_write);
+	} else if (rc != 0) {
+		spdk_bdev_free_io(read_io);
+		bdev_copy_emulate_complete(parent_io, false);
+	}
+}
+
+static void
+bdev_copy_emulate_read_done(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct spdk_bdev_io *parent_io = cb_arg;
+
+	if (!success) {
+		spdk_bdev_free_io(bdev_io);
+		bdev_copy_emulate_complete(parent_io, false);
+		return;
+	}
+
+	bdev_copy_emulate_write(bdev_io);
+}
+
+static void
+bdev_copy_emulate_next(void *_bdev_io)
+{
+	struct spdk_bdev_io *bdev_io = _bdev_io;
+	uint64_t src_offset_blocks, num_blocks;
+	int rc;
+
+	num_blocks = spdk_min(bdev_io->u.bdev.split_remaining_num_blocks,
+			      bdev_copy_emulate_max_blocks(bdev_io->bdev));
+	src_offset_blocks = bdev_io->u.bdev.copy.src_offset_blocks +
+			    (bdev_io->u.bdev.split_current_offset_blocks - bdev_io->u.bdev.offset_blocks);
+
+	/* No buffer given, so the bdev module gets one for the read */
+	rc = bdev_read_blocks_with_md(bdev_io->internal.desc,
+				      spdk_io_channel_from_ctx(bdev_io->internal.ch),
+				      NULL, NULL, src_offset_blocks, num_blocks,
+				      bdev_copy_emulate_read_done, bdev_io);
+	if (rc == 0) {
+		bdev_io->u.bdev.split_remaining_num_blocks -= num_blocks;
+		bdev_io->u.bdev.split_current_offset_blocks += num_blocks;
+	} else if (rc == -ENOMEM) {
+		bdev_queue_io_wait_with_cb(bdev_io, bdev_copy_emulate_next);
+	} else {
+		bdev_copy_emulate_complete(bdev_io, false);
+	}
+}
+
 static void
 bdev_set_qos_limit_done(struct set_qos_limit_ctx *ctx, int status)
 {
@@ -6202,10 +6923,7 @@ bdev_histogram_disable_channel(struct spdk_io_channel_iter *i)
 	struct spdk_io_channel *_ch = spdk_io_channel_iter_get_channel(i);
 	struct spdk_bdev_channel *ch = spdk_io_channel_get_ctx(_ch);
 
-	if (ch->histogram != NULL) {
-		spdk_histogram_data_free(ch->histogram);
-		ch->histogram = NULL;
-	}
+	bdev_channel_free_histograms(ch);
 	spdk_for_each_channel_continue(i, 0);
 }
 
@@ -6233,14 +6951,9 @@ bdev_histogram_enable_channel(struct spdk_io_channel_iter *i)
 {
 	struct spdk_io_channel *_ch = spdk_io_channel_iter_get_channel(i);
 	struct spdk_bdev_channel *ch = spdk_io_channel_get_ctx(_ch);
-	int status = 0;
+	int status;
 
-	if (ch->histogram == NULL) {
-		ch->histogram = spdk_histogram_data_alloc();
-		if (ch->histogram == NULL) {
-			status = -ENOMEM;
-		}
-	}
+	status = bdev_channel_alloc_histograms(ch);
 
 	spdk_for_each_channel_continue(i, status);
 }
@@ -6342,6 +7055,84 @@ spdk_bdev_histogram_get(struct spdk_bdev *bdev, struct spdk_histogram_data *hist
 			      bdev_histogram_get_channel_cb);
 }
 
+struct spdk_bdev_histogram_by_type_ctx {
+	spdk_bdev_histogram_by_type_cb cb_fn;
+	void *cb_arg;
+	struct spdk_bdev *bdev;
+	int type;
+	/** merged histogram data from all channels, one per size bucket */
+	struct spdk_histogram_data	**histograms;
+};
+
+static void
+bdev_histogram_get_by_type_channel_cb(struct spdk_io_channel_iter *i, int status)
+{
+	struct spdk_bdev_histogram_by_type_ctx *ctx = spdk_io_channel_iter_get_ctx(i);
+
+	ctx->cb_fn(ctx->cb_arg, status, ctx->histograms);
+	free(ctx);
+}
+
+static void
+bdev_histogram_get_by_type_channel(struct spdk_io_channel_iter *i)
+{
+	struct spdk_io_channel *_ch = spdk_io_channel_iter_get_channel(i);
+	struct spdk_bdev_channel *ch = spdk_io_channel_get_ctx(_ch);
+	struct spdk_bdev_histogram_by_type_ctx *ctx = spdk_io_channel_iter_get_ctx(i);
+	uint32_t bucket;
+	int status = 0;
+
+	if (ch->histogram == NULL) {
+		status = -EFAULT;
+	} else {
+		for (bucket = 0; bucket < SPDK_BDEV_HISTOGRAM_SIZE_BUCKETS; bucket++) {
+			spdk_histogram_data_merge(ctx->histograms[bucket],
+						  ch->type_histograms[ctx->type][bucket]);
+		}
+	}
+
+	spdk_for_each_channel_continue(i, status);
+}
+
+void
+spdk_bdev_histogram_get_by_type(struct spdk_bdev *bdev, enum spdk_bdev_io_type io_type,
+				struct spdk_histogram_data **histograms,
+				spdk_bdev_histogram_by_type_cb cb_fn, void *cb_arg)
+{
+	struct spdk_bdev_histogram_by_type_ctx *ctx;
+	int type;
+	uint32_t bucket;
+
+	type = bdev_histogram_io_type(io_type);
+	if (type < 0) {
+		cb_fn(cb_arg, -EINVAL, NULL);
+		return;
+	}
+
+	for (bucket = 0; bucket < SPDK_BDEV_HISTOGRAM_SIZE_BUCKETS; bucket++) {
+		if (histograms[bucket] == NULL ||
+		    histograms[bucket]->bucket_shift != SPDK_BDEV_HISTOGRAM_BY_TYPE_BUCKET_SHIFT) {
+			cb_fn(cb_arg, -EINVAL, NULL);
+			return;
+		}
+	}
+
+	ctx = calloc(1, sizeof(struct spdk_bdev_histogram_by_type_ctx));
+	if (ctx == NULL) {
+		cb_fn(cb_arg, -ENOMEM, NULL);
+		return;
+	}
+
+	ctx->bdev = bdev;
+	ctx->cb_fn = cb_fn;
+	ctx->cb_arg = cb_arg;
+	ctx->type = type;
+	ctx->histograms = histograms;
+
+	spdk_for_each_channel(__bdev_to_io_dev(bdev), bdev_histogram_get_by_type_channel, ctx,
+			      bdev_histogram_get_by_type_channel_cb);
+}
+
 size_t
 spdk_bdev_get_media_events(struct spdk_bdev_desc *desc, struct spdk_bdev_media_event *events,
 			   size_t max_events)
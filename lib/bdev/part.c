@@ -377,6 +377,12 @@ spdk_bdev_part_submit_request(struct spdk_bdev_part_channel *ch, struct spdk_bde
 					   bdev_io->u.bdev.num_blocks, bdev_io->u.bdev.zcopy.populate,
 					   bdev_part_complete_zcopy_io, bdev_io);
 		break;
+	case SPDK_BDEV_IO_TYPE_COPY:
+		rc = spdk_bdev_copy_blocks(base_desc, base_ch, remapped_offset,
+					   bdev_io->u.bdev.copy.src_offset_blocks + part->internal.offset_blocks,
+					   bdev_io->u.bdev.num_blocks, bdev_part_complete_io,
+					   bdev_io);
+		break;
 	default:
 		SPDK_ERRLOG("unknown I/O type %d\n", bdev_io->type);
 		return SPDK_BDEV_IO_STATUS_FAILED;
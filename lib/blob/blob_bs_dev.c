@@ -34,6 +34,7 @@
 #include "spdk/stdinc.h"
 #include "spdk/blob.h"
 #include "spdk/log.h"
+#include "spdk/likely.h"
 #include "blobstore.h"
 
 static void
@@ -81,13 +82,128 @@ blob_bs_dev_read_cpl(void *cb_arg, int bserrno)
 	cb_args->cb_fn(cb_args->channel, cb_args->cb_arg, bserrno);
 }
 
+/*
+ * Reads of a cluster unallocated in the snapshot are not passed down the
+ * snapshot chain one level at a time. Instead the snapshot actually holding
+ * the cluster is looked up and read directly.
+ *
+ * The number of levels to that snapshot is cached per cluster. Each entry is
+ * tagged with bs->snapshot_chain_gen, so any change to the chain invalidates it
+ * without touching the cache. Entries are single words updated atomically, as
+ * reads come from all threads.
+ */
+#define BLOB_BS_DEV_OWNER_DEPTH_BITS	8
+#define BLOB_BS_DEV_OWNER_DEPTH_MASK	((1ULL << BLOB_BS_DEV_OWNER_DEPTH_BITS) - 1)
+
+static inline struct spdk_blob *
+blob_bs_dev_parent(struct spdk_blob *blob)
+{
+	if (blob->parent_id == SPDK_BLOBID_INVALID || blob->back_bs_dev == NULL ||
+	    blob->frozen_refcnt != 0) {
+		/* The end of the chain, or I/O to this snapshot has to wait */
+		return NULL;
+	}
+
+	return ((struct spdk_blob_bs_dev *)blob->back_bs_dev)->blob;
+}
+
+static struct spdk_blob *
+blob_bs_dev_find_owner(struct spdk_blob *blob, uint64_t cluster, uint64_t *depth)
+{
+	struct spdk_blob *parent;
+
+	*depth = 0;
+	while (cluster < blob->active.num_clusters && blob->active.clusters[cluster] == 0) {
+		parent = blob_bs_dev_parent(blob);
+		if (parent == NULL) {
+			break;
+		}
+		blob = parent;
+		(*depth)++;
+	}
+
+	return blob;
+}
+
+static uint64_t *
+blob_bs_dev_get_owner_cache(struct spdk_blob_bs_dev *b)
+{
+	uint64_t *cache, *expected = NULL;
+
+	cache = __atomic_load_n(&b->owner_cache, __ATOMIC_ACQUIRE);
+	if (spdk_likely(cache != NULL)) {
+		return cache;
+	}
+
+	cache = calloc(b->owner_cache_size, sizeof(*cache));
+	if (cache == NULL) {
+		return NULL;
+	}
+
+	if (!__atomic_compare_exchange_n(&b->owner_cache, &expected, cache, false,
+					 __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+		/* Another thread allocated the cache first */
+		free(cache);
+		cache = expected;
+	}
+
+	return cache;
+}
+
+static struct spdk_blob *
+blob_bs_dev_get_owner(struct spdk_blob_bs_dev *b, uint64_t lba, uint32_t lba_count)
+{
+	struct spdk_blob *blob = b->blob;
+	struct spdk_blob *owner, *parent;
+	uint64_t *cache;
+	uint64_t cluster, gen, entry, depth;
+
+	if (lba_count > bs_num_io_units_to_cluster_boundary(blob, lba)) {
+		/* Spans clusters, so may be held by different snapshots */
+		return blob;
+	}
+
+	cluster = bs_io_unit_to_cluster_number(blob, lba);
+	if (cluster >= b->owner_cache_size) {
+		return blob;
+	}
+
+	cache = blob_bs_dev_get_owner_cache(b);
+	if (cache == NULL) {
+		return blob_bs_dev_find_owner(blob, cluster, &depth);
+	}
+
+	gen = __atomic_load_n(&blob->bs->snapshot_chain_gen, __ATOMIC_ACQUIRE);
+	entry = __atomic_load_n(&cache[cluster], __ATOMIC_RELAXED);
+	if (entry != 0 && (entry >> BLOB_BS_DEV_OWNER_DEPTH_BITS) == gen) {
+		owner = blob;
+		for (depth = entry & BLOB_BS_DEV_OWNER_DEPTH_MASK; depth > 0; depth--) {
+			parent = blob_bs_dev_parent(owner);
+			if (parent == NULL) {
+				/* A snapshot on the way is frozen */
+				break;
+			}
+			owner = parent;
+		}
+		return owner;
+	}
+
+	owner = blob_bs_dev_find_owner(blob, cluster, &depth);
+	if (depth <= BLOB_BS_DEV_OWNER_DEPTH_MASK && owner->frozen_refcnt == 0) {
+		entry = (gen << BLOB_BS_DEV_OWNER_DEPTH_BITS) | depth;
+		__atomic_store_n(&cache[cluster], entry, __ATOMIC_RELAXED);
+	}
+
+	return owner;
+}
+
 static inline void
 blob_bs_dev_read(struct spdk_bs_dev *dev, struct spdk_io_channel *channel, void *payload,
 		 uint64_t lba, uint32_t lba_count, struct spdk_bs_dev_cb_args *cb_args)
 {
 	struct spdk_blob_bs_dev *b = (struct spdk_blob_bs_dev *)dev;
 
-	spdk_blob_io_read(b->blob, channel, payload, lba, lba_count,
+	spdk_blob_io_read(blob_bs_dev_get_owner(b, lba, lba_count), channel, payload, lba, lba_count,
 			  blob_bs_dev_read_cpl, cb_args);
 }
 
@@ -98,19 +214,22 @@ blob_bs_dev_readv(struct spdk_bs_dev *dev, struct spdk_io_channel *channel,
 {
 	struct spdk_blob_bs_dev *b = (struct spdk_blob_bs_dev *)dev;
 
-	spdk_blob_io_readv(b->blob, channel, iov, iovcnt, lba, lba_count,
-			   blob_bs_dev_read_cpl, cb_args);
+	spdk_blob_io_readv(blob_bs_dev_get_owner(b, lba, lba_count), channel, iov, iovcnt, lba,
+			   lba_count, blob_bs_dev_read_cpl, cb_args);
 }
 
 static void
 blob_bs_dev_destroy_cpl(void *cb_arg, int bserrno)
 {
+	struct spdk_blob_bs_dev *b = cb_arg;
+
 	if (bserrno != 0) {
 		SPDK_ERRLOG("Error on blob_bs_dev destroy: %d", bserrno);
 	}
 
 	/* Free blob_bs_dev */
-	free(cb_arg);
+	free(b->owner_cache);
+	free(b);
 }
 
 static void
@@ -145,6 +264,7 @@ bs_create_blob_bs_dev(struct spdk_blob *blob)
 	b->bs_dev.write_zeroes = blob_bs_dev_write_zeroes;
 	b->bs_dev.unmap = blob_bs_dev_unmap;
 	b->blob = blob;
+	b->owner_cache_size = blob->active.num_clusters;
 
 	return &b->bs_dev;
 }
@@ -87,6 +87,71 @@ bs_get_snapshot_entry(struct spdk_blob_store *bs, spdk_blob_id blobid)
 	return snapshot_entry;
 }
 
+/*
+ * The allocation journal
+ *
+ * A blobstore that was not shut down cleanly used to rebuild its allocation masks
+ * from all of its metadata. Instead, the masks are now checkpointed to their
+ * regions on disk from time to time, and what changed them since is logged in the
+ * allocation journal:
+ *
+ *  - a blob is logged once per epoch, before md pages referencing clusters or md
+ *    pages claimed for it are written, so recovery can read its md again,
+ *  - md pages and clusters are logged as they are released, after the md that no
+ *    longer references them was written.
+ *
+ * The journal consists of two halves, and epoch N is logged in half N % 2.
+ * A checkpoint starts epoch N + 1 and then writes out the masks, so recovery
+ * applies the last two epochs found on disk on top of the masks. Epoch N + 2
+ * isn't started before the checkpoint of epoch N + 1 completed.
+ *
+ * A release logged after the journal filled up, or not yet flushed on a crash,
+ * leaks the released space until the blobstore is recovered with a full metadata
+ * replay. It never makes space in use look free.
+ *
+ * Returns the position of the entry in the journal, that has to be flushed before
+ * anything relying on it is written, or UINT64_MAX if the journal is full.
+ */
+static uint64_t
+bs_journal_append(struct spdk_blob_store *bs, uint32_t type, uint32_t index, uint32_t count)
+{
+	struct spdk_bs_journal *journal = &bs->journal;
+	struct spdk_bs_journal_page *page;
+	struct spdk_bs_journal_entry *entry;
+	uint64_t tail;
+
+	if (journal->pages == NULL) {
+		return 0;
+	}
+
+	pthread_mutex_lock(&journal->mutex);
+	if (journal->full) {
+		pthread_mutex_unlock(&journal->mutex);
+		return UINT64_MAX;
+	}
+
+	page = &journal->pages[journal->cur_page];
+	entry = page->num_entries > 0 ? &page->entries[page->num_entries - 1] : NULL;
+	if (entry != NULL && type != SPDK_BS_JOURNAL_ENTRY_BLOB && entry->type == type &&
+	    entry->index + entry->count == index) {
+		/* Extend the previous release */
+		entry->count += count;
+	} else {
+		entry = &page->entries[page->num_entries++];
+		entry->type = type;
+		entry->index = index;
+		entry->count = count;
+		if (page->num_entries == SPDK_BS_JOURNAL_ENTRIES_PER_PAGE) {
+			journal->cur_page++;
+			journal->full = (journal->cur_page == journal->half_pages);
+		}
+	}
+	tail = ++journal->tail;
+	pthread_mutex_unlock(&journal->mutex);
+
+	return tail;
+}
+
 static void
 bs_claim_md_page(struct spdk_blob_store *bs, uint32_t page)
 {
@@ -103,6 +168,93 @@ bs_release_md_page(struct spdk_blob_store *bs, uint32_t page)
 	assert(spdk_bit_array_get(bs->used_md_pages, page) == true);
 
 	spdk_bit_array_clear(bs->used_md_pages, page);
+	bs_journal_append(bs, SPDK_BS_JOURNAL_ENTRY_RELEASE_MD_PAGES, page, 1);
+}
+
+/*
+ * Find the first free cluster at or after start within start's group. Only the
+ * group's own bits are looked at, so a full group costs at most 64 tests instead
+ * of a scan to the end of used_clusters.
+ */
+static uint32_t
+bs_find_free_cluster_in_group(struct spdk_blob_store *bs, uint32_t start)
+{
+	uint32_t group = start >> SPDK_BS_CLUSTER_GROUP_SHIFT;
+	uint32_t group_end, i;
+
+	group_end = spdk_min((group + 1) << SPDK_BS_CLUSTER_GROUP_SHIFT,
+			     spdk_bit_array_capacity(bs->used_clusters));
+	for (i = start; i < group_end; i++) {
+		if (!spdk_bit_array_get(bs->used_clusters, i)) {
+			return i;
+		}
+	}
+
+	return UINT32_MAX;
+}
+
+static void
+bs_update_cluster_group(struct spdk_blob_store *bs, uint32_t cluster_num)
+{
+	uint32_t group = cluster_num >> SPDK_BS_CLUSTER_GROUP_SHIFT;
+
+	if (bs_find_free_cluster_in_group(bs, group << SPDK_BS_CLUSTER_GROUP_SHIFT) == UINT32_MAX) {
+		spdk_bit_array_set(bs->full_cluster_groups, group);
+	} else {
+		spdk_bit_array_clear(bs->full_cluster_groups, group);
+	}
+}
+
+static int
+bs_rebuild_cluster_groups(struct spdk_blob_store *bs)
+{
+	uint32_t num_groups, group;
+	int rc;
+
+	num_groups = spdk_divide_round_up(spdk_bit_array_capacity(bs->used_clusters),
+					  1U << SPDK_BS_CLUSTER_GROUP_SHIFT);
+	rc = spdk_bit_array_resize(&bs->full_cluster_groups, num_groups);
+	if (rc < 0) {
+		return rc;
+	}
+
+	for (group = 0; group < num_groups; group++) {
+		bs_update_cluster_group(bs, group << SPDK_BS_CLUSTER_GROUP_SHIFT);
+	}
+
+	return 0;
+}
+
+/*
+ * Find the first free cluster at or after start. The full_cluster_groups summary
+ * lets the search skip 64 used clusters per bit, so it doesn't slow down as the
+ * blobstore fills up.
+ */
+static uint32_t
+bs_find_free_cluster(struct spdk_blob_store *bs, uint32_t start)
+{
+	uint32_t group, cluster;
+
+	group = spdk_bit_array_find_first_clear(bs->full_cluster_groups,
+						start >> SPDK_BS_CLUSTER_GROUP_SHIFT);
+	if (group == UINT32_MAX) {
+		return UINT32_MAX;
+	}
+
+	if (group == start >> SPDK_BS_CLUSTER_GROUP_SHIFT) {
+		/* The group has a free cluster, but maybe only before start */
+		cluster = bs_find_free_cluster_in_group(bs, start);
+		if (cluster != UINT32_MAX) {
+			return cluster;
+		}
+
+		group = spdk_bit_array_find_first_clear(bs->full_cluster_groups, group + 1);
+		if (group == UINT32_MAX) {
+			return UINT32_MAX;
+		}
+	}
+
+	return bs_find_free_cluster_in_group(bs, group << SPDK_BS_CLUSTER_GROUP_SHIFT);
 }
 
 static void
@@ -115,7 +267,65 @@ bs_claim_cluster(struct spdk_blob_store *bs, uint32_t cluster_num)
 	SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Claiming cluster %u\n", cluster_num);
 
 	spdk_bit_array_set(bs->used_clusters, cluster_num);
-	bs->num_free_clusters--;
+	bs_update_cluster_group(bs, cluster_num);
+	__atomic_fetch_sub(&bs->num_free_clusters, 1, __ATOMIC_RELAXED);
+}
+
+/*
+ * Refill the channel's reserved clusters. The reserved clusters are marked as used,
+ * so no other channel takes them, but they're still counted as free until the
+ * channel gives them to a blob.
+ */
+static void
+bs_channel_reserve_clusters(struct spdk_bs_channel *ch)
+{
+	struct spdk_blob_store *bs = ch->bs;
+	uint32_t cluster = 0;
+
+	assert(ch->next_reserved_cluster == ch->num_reserved_clusters);
+
+	ch->num_reserved_clusters = 0;
+	ch->next_reserved_cluster = 0;
+
+	if (__atomic_load_n(&bs->num_free_clusters, __ATOMIC_RELAXED) < SPDK_BS_CLUSTER_RESERVE_MIN_FREE) {
+		return;
+	}
+
+	pthread_mutex_lock(&bs->used_clusters_mutex);
+	while (ch->num_reserved_clusters < SPDK_BS_CHANNEL_RESERVED_CLUSTERS) {
+		cluster = bs_find_free_cluster(bs, cluster);
+		if (cluster == UINT32_MAX) {
+			break;
+		}
+
+		spdk_bit_array_set(bs->used_clusters, cluster);
+		spdk_bit_array_set(bs->reserved_clusters, cluster);
+		bs_update_cluster_group(bs, cluster);
+		ch->reserved_clusters[ch->num_reserved_clusters++] = cluster;
+		cluster++;
+	}
+	pthread_mutex_unlock(&bs->used_clusters_mutex);
+}
+
+static void
+bs_channel_release_reserved_clusters(struct spdk_bs_channel *ch)
+{
+	struct spdk_blob_store *bs = ch->bs;
+	uint32_t cluster;
+
+	if (ch->next_reserved_cluster == ch->num_reserved_clusters) {
+		return;
+	}
+
+	pthread_mutex_lock(&bs->used_clusters_mutex);
+	for (; ch->next_reserved_cluster < ch->num_reserved_clusters; ch->next_reserved_cluster++) {
+		cluster = ch->reserved_clusters[ch->next_reserved_cluster];
+		assert(spdk_bit_array_get(bs->used_clusters, cluster) == true);
+		spdk_bit_array_clear(bs->used_clusters, cluster);
+		spdk_bit_array_clear(bs->reserved_clusters, cluster);
+		spdk_bit_array_clear(bs->full_cluster_groups, cluster >> SPDK_BS_CLUSTER_GROUP_SHIFT);
+	}
+	pthread_mutex_unlock(&bs->used_clusters_mutex);
 }
 
 static int
@@ -133,25 +343,44 @@ blob_insert_cluster(struct spdk_blob *blob, uint32_t cluster_num, uint64_t clust
 	return 0;
 }
 
+/*
+ * Allocate a cluster for the blob. If ch is not NULL, the cluster is taken from
+ * the clusters reserved by the channel whenever possible, which doesn't need
+ * used_clusters_mutex unless an extent page has to be claimed as well.
+ */
 static int
-bs_allocate_cluster(struct spdk_blob *blob, uint32_t cluster_num,
+bs_allocate_cluster(struct spdk_blob *blob, struct spdk_bs_channel *ch, uint32_t cluster_num,
 		    uint64_t *lowest_free_cluster, uint32_t *lowest_free_md_page, bool update_map)
 {
 	uint32_t *extent_page = 0;
-
-	pthread_mutex_lock(&blob->bs->used_clusters_mutex);
-	*lowest_free_cluster = spdk_bit_array_find_first_clear(blob->bs->used_clusters,
-			       *lowest_free_cluster);
-	if (*lowest_free_cluster == UINT32_MAX) {
-		/* No more free clusters. Cannot satisfy the request */
-		pthread_mutex_unlock(&blob->bs->used_clusters_mutex);
-		return -ENOSPC;
-	}
+	bool reserved = false;
+	bool need_md_page = false;
 
 	if (blob->use_extent_table) {
 		extent_page = bs_cluster_to_extent_page(blob, cluster_num);
-		if (*extent_page == 0) {
-			/* No extent_page is allocated for the cluster */
+		/* No extent_page is allocated for the cluster */
+		need_md_page = (*extent_page == 0);
+	}
+
+	if (ch != NULL) {
+		if (ch->next_reserved_cluster == ch->num_reserved_clusters) {
+			bs_channel_reserve_clusters(ch);
+		}
+		reserved = ch->next_reserved_cluster < ch->num_reserved_clusters;
+	}
+
+	if (!reserved || need_md_page) {
+		pthread_mutex_lock(&blob->bs->used_clusters_mutex);
+		if (!reserved) {
+			*lowest_free_cluster = bs_find_free_cluster(blob->bs, *lowest_free_cluster);
+			if (*lowest_free_cluster == UINT32_MAX) {
+				/* No more free clusters. Cannot satisfy the request */
+				pthread_mutex_unlock(&blob->bs->used_clusters_mutex);
+				return -ENOSPC;
+			}
+		}
+
+		if (need_md_page) {
 			*lowest_free_md_page = spdk_bit_array_find_first_clear(blob->bs->used_md_pages,
 					       *lowest_free_md_page);
 			if (*lowest_free_md_page == UINT32_MAX) {
@@ -161,12 +390,26 @@ bs_allocate_cluster(struct spdk_blob *blob, uint32_t cluster_num,
 			}
 			bs_claim_md_page(blob->bs, *lowest_free_md_page);
 		}
-	}
 
-	SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Claiming cluster %lu for blob %lu\n", *lowest_free_cluster, blob->id);
-	bs_claim_cluster(blob->bs, *lowest_free_cluster);
+		if (!reserved) {
+			SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Claiming cluster %lu for blob %lu\n", *lowest_free_cluster,
+				      blob->id);
+			bs_claim_cluster(blob->bs, *lowest_free_cluster);
+			if (ch != NULL) {
+				/* Inserted into the blob later on the md thread */
+				spdk_bit_array_set(blob->bs->reserved_clusters, *lowest_free_cluster);
+			}
+		}
 
-	pthread_mutex_unlock(&blob->bs->used_clusters_mutex);
+		pthread_mutex_unlock(&blob->bs->used_clusters_mutex);
+	}
+
+	if (reserved) {
+		*lowest_free_cluster = ch->reserved_clusters[ch->next_reserved_cluster++];
+		SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Using reserved cluster %lu for blob %lu\n", *lowest_free_cluster,
+			      blob->id);
+		__atomic_fetch_sub(&blob->bs->num_free_clusters, 1, __ATOMIC_RELAXED);
+	}
 
 	if (update_map) {
 		blob_insert_cluster(blob, cluster_num, *lowest_free_cluster);
@@ -189,141 +432,639 @@ bs_release_cluster(struct spdk_blob_store *bs, uint32_t cluster_num)
 
 	pthread_mutex_lock(&bs->used_clusters_mutex);
 	spdk_bit_array_clear(bs->used_clusters, cluster_num);
-	bs->num_free_clusters++;
+	spdk_bit_array_clear(bs->reserved_clusters, cluster_num);
+	spdk_bit_array_clear(bs->full_cluster_groups, cluster_num >> SPDK_BS_CLUSTER_GROUP_SHIFT);
+	__atomic_fetch_add(&bs->num_free_clusters, 1, __ATOMIC_RELAXED);
 	pthread_mutex_unlock(&bs->used_clusters_mutex);
+
+	bs_journal_append(bs, SPDK_BS_JOURNAL_ENTRY_RELEASE_CLUSTERS, cluster_num, 1);
 }
 
+struct spdk_bs_journal_waiter {
+	/* Blob to log again if the epoch changes, or NULL when waiting for releases */
+	struct spdk_blob		*blob;
+	uint64_t			epoch;
+	uint64_t			tail;
+	int				rc;
+	spdk_bs_sequence_t		*seq;
+	spdk_bs_sequence_cpl		cb_fn;
+	void				*cb_arg;
+	TAILQ_ENTRY(spdk_bs_journal_waiter) link;
+};
+
+struct spdk_bs_journal_checkpoint_ctx {
+	struct spdk_blob_store		*bs;
+	struct spdk_bs_md_mask		*used_pages;
+	struct spdk_bs_md_mask		*used_clusters;
+	struct spdk_bs_md_mask		*used_blobids;
+};
+
+static uint32_t blob_md_page_calc_crc(void *page);
+static void bs_set_mask(struct spdk_bit_array *array, struct spdk_bs_md_mask *mask);
+static void bs_journal_checkpoint(struct spdk_blob_store *bs);
+
 static void
-blob_xattrs_init(struct spdk_blob_xattr_opts *xattrs)
+bs_journal_check_stopped(struct spdk_blob_store *bs)
 {
-	xattrs->count = 0;
-	xattrs->names = NULL;
-	xattrs->ctx = NULL;
-	xattrs->get_value = NULL;
-}
+	struct spdk_bs_journal *journal = &bs->journal;
+	spdk_msg_fn cb_fn = journal->stop_cb_fn;
 
-void
-spdk_blob_opts_init(struct spdk_blob_opts *opts)
-{
-	opts->num_clusters = 0;
-	opts->thin_provision = false;
-	opts->clear_method = BLOB_CLEAR_WITH_DEFAULT;
-	blob_xattrs_init(&opts->xattrs);
-	opts->use_extent_table = true;
-}
+	if (cb_fn == NULL || journal->flushing || journal->checkpointing) {
+		return;
+	}
 
-void
-spdk_blob_open_opts_init(struct spdk_blob_open_opts *opts)
-{
-	opts->clear_method = BLOB_CLEAR_WITH_DEFAULT;
+	journal->stop_cb_fn = NULL;
+	cb_fn(journal->stop_cb_arg);
 }
 
-static struct spdk_blob *
-blob_alloc(struct spdk_blob_store *bs, spdk_blob_id id)
+/*
+ * Complete the waiters whose entries are durable, either flushed in the current
+ * epoch or left in an older epoch that a completed checkpoint made redundant.
+ * If a flush failed, the waiters for its entries fail with it.
+ */
+static void
+bs_journal_complete_waiters(struct spdk_blob_store *bs, int bserrno)
 {
-	struct spdk_blob *blob;
+	struct spdk_bs_journal *journal = &bs->journal;
+	struct spdk_bs_journal_waiter *waiter, *tmp;
+	TAILQ_HEAD(, spdk_bs_journal_waiter) completed = TAILQ_HEAD_INITIALIZER(completed);
 
-	blob = calloc(1, sizeof(*blob));
-	if (!blob) {
-		return NULL;
+	TAILQ_FOREACH_SAFE(waiter, &journal->waiters, link, tmp) {
+		if (waiter->epoch != journal->epoch) {
+			if (journal->masks_stale) {
+				continue;
+			}
+			waiter->rc = 0;
+		} else if (waiter->tail <= journal->durable_tail) {
+			waiter->rc = 0;
+		} else if (bserrno != 0 && waiter->tail <= journal->flushing_tail) {
+			waiter->rc = bserrno;
+		} else {
+			continue;
+		}
+		TAILQ_REMOVE(&journal->waiters, waiter, link);
+		TAILQ_INSERT_TAIL(&completed, waiter, link);
 	}
 
-	blob->id = id;
-	blob->bs = bs;
+	TAILQ_FOREACH_SAFE(waiter, &completed, link, tmp) {
+		TAILQ_REMOVE(&completed, waiter, link);
+		waiter->cb_fn(waiter->seq, waiter->cb_arg, waiter->rc);
+		free(waiter);
+	}
+}
 
-	blob->parent_id = SPDK_BLOBID_INVALID;
+static void bs_journal_flush(struct spdk_blob_store *bs);
 
-	blob->state = SPDK_BLOB_STATE_DIRTY;
-	blob->extent_rle_found = false;
-	blob->extent_table_found = false;
-	blob->active.num_pages = 1;
-	blob->active.pages = calloc(1, sizeof(*blob->active.pages));
-	if (!blob->active.pages) {
-		free(blob);
-		return NULL;
+static void
+bs_journal_flush_cpl(void *cb_arg, int bserrno)
+{
+	struct spdk_blob_store *bs = cb_arg;
+	struct spdk_bs_journal *journal = &bs->journal;
+
+	journal->flushing = false;
+	if (bserrno == 0) {
+		journal->durable_tail = journal->flushing_tail;
+		journal->flush_page = journal->next_flush_page;
+	} else {
+		SPDK_ERRLOG("Failed to write the allocation journal: %d\n", bserrno);
 	}
 
-	blob->active.pages[0] = bs_blobid_to_page(id);
+	bs_journal_complete_waiters(bs, bserrno);
 
-	TAILQ_INIT(&blob->xattrs);
-	TAILQ_INIT(&blob->xattrs_internal);
-	TAILQ_INIT(&blob->pending_persists);
+	if (journal->checkpoint_pending) {
+		bs_journal_checkpoint(bs);
+	} else if (!TAILQ_EMPTY(&journal->waiters)) {
+		bs_journal_flush(bs);
+	}
 
-	return blob;
+	bs_journal_check_stopped(bs);
 }
 
+/* Write out the journal pages that got entries since the last flush. */
 static void
-xattrs_free(struct spdk_xattr_tailq *xattrs)
+bs_journal_flush(struct spdk_blob_store *bs)
 {
-	struct spdk_xattr	*xattr, *xattr_tmp;
+	struct spdk_bs_journal *journal = &bs->journal;
+	struct spdk_bs_journal_page *page;
+	struct spdk_bs_cpl cpl;
+	spdk_bs_batch_t *batch;
+	uint32_t first, last, i;
+	uint64_t lba;
 
-	TAILQ_FOREACH_SAFE(xattr, xattrs, link, xattr_tmp) {
-		TAILQ_REMOVE(xattrs, xattr, link);
-		free(xattr->name);
-		free(xattr->value);
-		free(xattr);
+	if (journal->pages == NULL || journal->flushing || journal->stopping) {
+		return;
 	}
-}
 
-static void
-blob_free(struct spdk_blob *blob)
-{
-	assert(blob != NULL);
-	assert(TAILQ_EMPTY(&blob->pending_persists));
+	pthread_mutex_lock(&journal->mutex);
+	first = journal->flush_page;
+	if (journal->tail == journal->durable_tail || first == journal->half_pages) {
+		pthread_mutex_unlock(&journal->mutex);
+		return;
+	}
 
-	free(blob->active.extent_pages);
-	free(blob->clean.extent_pages);
-	free(blob->active.clusters);
-	free(blob->clean.clusters);
-	free(blob->active.pages);
-	free(blob->clean.pages);
+	last = spdk_min(journal->cur_page, journal->half_pages - 1);
+	if (last > first && journal->pages[last].num_entries == 0) {
+		last--;
+	}
+	memcpy(&journal->write_pages[first], &journal->pages[first],
+	       (last - first + 1) * sizeof(*journal->pages));
+	journal->flushing_tail = journal->tail;
+	pthread_mutex_unlock(&journal->mutex);
 
-	xattrs_free(&blob->xattrs);
-	xattrs_free(&blob->xattrs_internal);
+	/* Full pages won't change anymore, but the last one may still get more entries */
+	journal->next_flush_page = last;
+	if (journal->write_pages[last].num_entries == SPDK_BS_JOURNAL_ENTRIES_PER_PAGE) {
+		journal->next_flush_page++;
+	}
 
-	if (blob->back_bs_dev) {
-		blob->back_bs_dev->destroy(blob->back_bs_dev);
+	for (i = first; i <= last; i++) {
+		page = &journal->write_pages[i];
+		page->epoch = journal->epoch;
+		page->page_idx = i;
+		page->crc = blob_md_page_calc_crc(page);
 	}
 
-	free(blob);
-}
+	cpl.type = SPDK_BS_CPL_TYPE_BLOB_BASIC;
+	cpl.u.blob_basic.cb_fn = bs_journal_flush_cpl;
+	cpl.u.blob_basic.cb_arg = bs;
 
-struct freeze_io_ctx {
-	struct spdk_bs_cpl cpl;
-	struct spdk_blob *blob;
-};
+	batch = bs_batch_open(bs->md_channel, &cpl);
+	if (batch == NULL) {
+		/* The poller tries again later */
+		return;
+	}
 
-static void
-blob_io_sync(struct spdk_io_channel_iter *i)
-{
-	spdk_for_each_channel_continue(i, 0);
+	journal->flushing = true;
+	lba = bs_page_to_lba(bs, journal->start + (journal->epoch % 2) * journal->half_pages + first);
+	bs_batch_write_dev(batch, &journal->write_pages[first], lba,
+			   bs_page_to_lba(bs, last - first + 1));
+	bs_batch_close(batch);
 }
 
+/*
+ * Make sure the blob is logged in the current epoch of the journal and the entry
+ * is durable, before md pages referencing its newly claimed clusters and md pages
+ * are written.
+ */
 static void
-blob_execute_queued_io(struct spdk_io_channel_iter *i)
+bs_journal_blob(spdk_bs_sequence_t *seq, struct spdk_blob *blob,
+		spdk_bs_sequence_cpl cb_fn, void *cb_arg)
 {
-	struct spdk_io_channel *_ch = spdk_io_channel_iter_get_channel(i);
-	struct spdk_bs_channel *ch = spdk_io_channel_get_ctx(_ch);
-	struct freeze_io_ctx *ctx = spdk_io_channel_iter_get_ctx(i);
-	struct spdk_bs_request_set	*set;
-	struct spdk_bs_user_op_args	*args;
-	spdk_bs_user_op_t *op, *tmp;
+	struct spdk_bs_journal *journal = &blob->bs->journal;
+	struct spdk_bs_journal_waiter *waiter;
 
-	TAILQ_FOREACH_SAFE(op, &ch->queued_io, link, tmp) {
-		set = (struct spdk_bs_request_set *)op;
-		args = &set->u.user_op;
+	if (blob->journal_epoch != journal->epoch) {
+		blob->journal_epoch = journal->epoch;
+		blob->journal_tail = bs_journal_append(blob->bs, SPDK_BS_JOURNAL_ENTRY_BLOB,
+						       bs_blobid_to_page(blob->id), 1);
+	}
 
-		if (args->blob == ctx->blob) {
-			TAILQ_REMOVE(&ch->queued_io, op, link);
-			bs_user_op_execute(op);
-		}
+	if (blob->journal_tail <= journal->durable_tail) {
+		cb_fn(seq, cb_arg, 0);
+		return;
 	}
 
-	spdk_for_each_channel_continue(i, 0);
+	waiter = calloc(1, sizeof(*waiter));
+	if (waiter == NULL) {
+		cb_fn(seq, cb_arg, -ENOMEM);
+		return;
+	}
+
+	waiter->blob = blob;
+	waiter->epoch = journal->epoch;
+	waiter->tail = blob->journal_tail;
+	waiter->seq = seq;
+	waiter->cb_fn = cb_fn;
+	waiter->cb_arg = cb_arg;
+	TAILQ_INSERT_TAIL(&journal->waiters, waiter, link);
+
+	if (blob->journal_tail == UINT64_MAX) {
+		/* The journal is full, the blob is logged again in the next epoch */
+		bs_journal_checkpoint(blob->bs);
+	} else {
+		bs_journal_flush(blob->bs);
+	}
 }
 
+/* Wait until the releases logged so far are durable. */
 static void
-blob_io_cpl(struct spdk_io_channel_iter *i, int status)
+bs_journal_sync(spdk_bs_sequence_t *seq, struct spdk_blob_store *bs,
+		spdk_bs_sequence_cpl cb_fn, void *cb_arg)
+{
+	struct spdk_bs_journal *journal = &bs->journal;
+	struct spdk_bs_journal_waiter *waiter;
+	uint64_t tail;
+
+	pthread_mutex_lock(&journal->mutex);
+	tail = journal->tail;
+	pthread_mutex_unlock(&journal->mutex);
+
+	if (tail <= journal->durable_tail) {
+		cb_fn(seq, cb_arg, 0);
+		return;
+	}
+
+	waiter = calloc(1, sizeof(*waiter));
+	if (waiter == NULL) {
+		cb_fn(seq, cb_arg, -ENOMEM);
+		return;
+	}
+
+	waiter->epoch = journal->epoch;
+	waiter->tail = tail;
+	waiter->seq = seq;
+	waiter->cb_fn = cb_fn;
+	waiter->cb_arg = cb_arg;
+	TAILQ_INSERT_TAIL(&journal->waiters, waiter, link);
+
+	bs_journal_flush(bs);
+}
+
+static void
+bs_journal_checkpoint_cpl(void *cb_arg, int bserrno)
+{
+	struct spdk_bs_journal_checkpoint_ctx *ctx = cb_arg;
+	struct spdk_blob_store *bs = ctx->bs;
+	struct spdk_bs_journal *journal = &bs->journal;
+
+	spdk_free(ctx->used_pages);
+	spdk_free(ctx->used_clusters);
+	spdk_free(ctx->used_blobids);
+	free(ctx);
+
+	journal->checkpointing = false;
+	journal->checkpoint_tsc = spdk_get_ticks();
+	if (bserrno != 0) {
+		/* The next epoch isn't started before the masks are written out */
+		SPDK_ERRLOG("Failed to checkpoint the allocation masks: %d\n", bserrno);
+	} else {
+		journal->masks_stale = false;
+		bs_journal_complete_waiters(bs, 0);
+		if (journal->full) {
+			bs_journal_checkpoint(bs);
+		}
+	}
+
+	bs_journal_check_stopped(bs);
+}
+
+static struct spdk_bs_md_mask *
+bs_journal_alloc_mask(uint32_t len, uint8_t type, uint32_t length)
+{
+	struct spdk_bs_md_mask *mask;
+
+	mask = spdk_zmalloc(len * SPDK_BS_PAGE_SIZE, 0x1000, NULL,
+			    SPDK_ENV_SOCKET_ID_ANY, SPDK_MALLOC_DMA);
+	if (mask != NULL) {
+		mask->type = type;
+		mask->length = length;
+	}
+
+	return mask;
+}
+
+static void
+bs_journal_switch_epoch(struct spdk_blob_store *bs)
+{
+	struct spdk_bs_journal *journal = &bs->journal;
+	struct spdk_bs_journal_waiter *waiter;
+
+	pthread_mutex_lock(&journal->mutex);
+	journal->epoch++;
+	memset(journal->pages, 0, journal->half_pages * sizeof(*journal->pages));
+	journal->cur_page = 0;
+	journal->full = false;
+	journal->durable_tail = journal->tail;
+	journal->flush_page = 0;
+	pthread_mutex_unlock(&journal->mutex);
+
+	/* Blobs that were not logged yet are logged in the new epoch instead */
+	TAILQ_FOREACH(waiter, &journal->waiters, link) {
+		if (waiter->blob == NULL) {
+			continue;
+		}
+		waiter->epoch = journal->epoch;
+		waiter->blob->journal_epoch = journal->epoch;
+		waiter->blob->journal_tail = bs_journal_append(bs, SPDK_BS_JOURNAL_ENTRY_BLOB,
+					     bs_blobid_to_page(waiter->blob->id), 1);
+		waiter->tail = waiter->blob->journal_tail;
+	}
+}
+
+/*
+ * Start a new epoch of the journal and write out the allocation masks, so the
+ * entries of the epoch before the previous one aren't needed anymore.
+ */
+static void
+bs_journal_checkpoint(struct spdk_blob_store *bs)
+{
+	struct spdk_bs_journal *journal = &bs->journal;
+	struct spdk_bs_journal_checkpoint_ctx *ctx;
+	struct spdk_bs_cpl cpl;
+	spdk_bs_batch_t *batch;
+	uint8_t *reserved;
+	uint32_t i, reserved_len;
+
+	if (journal->pages == NULL || journal->checkpointing || journal->stopping) {
+		return;
+	}
+
+	if (journal->flushing) {
+		journal->checkpoint_pending = true;
+		return;
+	}
+	journal->checkpoint_pending = false;
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (ctx == NULL) {
+		return;
+	}
+
+	ctx->bs = bs;
+	ctx->used_pages = bs_journal_alloc_mask(journal->used_page_mask_len,
+						SPDK_MD_MASK_TYPE_USED_PAGES, bs->md_len);
+	ctx->used_clusters = bs_journal_alloc_mask(journal->used_cluster_mask_len,
+			     SPDK_MD_MASK_TYPE_USED_CLUSTERS, bs->total_clusters);
+	ctx->used_blobids = bs_journal_alloc_mask(journal->used_blobid_mask_len,
+			    SPDK_MD_MASK_TYPE_USED_BLOBIDS, bs->md_len);
+
+	cpl.type = SPDK_BS_CPL_TYPE_BLOB_BASIC;
+	cpl.u.blob_basic.cb_fn = bs_journal_checkpoint_cpl;
+	cpl.u.blob_basic.cb_arg = ctx;
+
+	reserved_len = spdk_divide_round_up(bs->total_clusters, 8);
+	reserved = calloc(reserved_len, 1);
+
+	batch = NULL;
+	if (ctx->used_pages != NULL && ctx->used_clusters != NULL && ctx->used_blobids != NULL &&
+	    reserved != NULL) {
+		batch = bs_batch_open(bs->md_channel, &cpl);
+	}
+	if (batch == NULL) {
+		/* The poller tries again later */
+		free(reserved);
+		spdk_free(ctx->used_pages);
+		spdk_free(ctx->used_clusters);
+		spdk_free(ctx->used_blobids);
+		free(ctx);
+		return;
+	}
+
+	if (!journal->masks_stale) {
+		bs_journal_switch_epoch(bs);
+		journal->masks_stale = true;
+	}
+	journal->checkpointing = true;
+
+	/*
+	 * Other threads claim clusters and extent pages under the mutex, so only copy
+	 * the arrays while holding it and do the rest outside.
+	 */
+	assert(spdk_bit_array_capacity(bs->used_md_pages) == ctx->used_pages->length);
+	assert(spdk_bit_array_capacity(bs->used_clusters) == ctx->used_clusters->length);
+	assert(spdk_bit_array_capacity(bs->reserved_clusters) == bs->total_clusters);
+	pthread_mutex_lock(&bs->used_clusters_mutex);
+	spdk_bit_array_store_mask(bs->used_md_pages, ctx->used_pages->mask);
+	spdk_bit_array_store_mask(bs->used_clusters, ctx->used_clusters->mask);
+	spdk_bit_array_store_mask(bs->reserved_clusters, reserved);
+	pthread_mutex_unlock(&bs->used_clusters_mutex);
+
+	bs_set_mask(bs->used_blobids, ctx->used_blobids);
+	/* Clusters not inserted into a blob yet are free again after a crash */
+	for (i = 0; i < reserved_len; i++) {
+		ctx->used_clusters->mask[i] &= ~reserved[i];
+	}
+	free(reserved);
+
+	bs_batch_write_dev(batch, ctx->used_pages, bs_page_to_lba(bs, journal->used_page_mask_start),
+			   bs_page_to_lba(bs, journal->used_page_mask_len));
+	bs_batch_write_dev(batch, ctx->used_clusters, bs_page_to_lba(bs, journal->used_cluster_mask_start),
+			   bs_page_to_lba(bs, journal->used_cluster_mask_len));
+	bs_batch_write_dev(batch, ctx->used_blobids, bs_page_to_lba(bs, journal->used_blobid_mask_start),
+			   bs_page_to_lba(bs, journal->used_blobid_mask_len));
+	bs_batch_close(batch);
+
+	/* Blobs waiting for the journal were logged again in the new epoch */
+	bs_journal_flush(bs);
+}
+
+static int
+bs_journal_poll(void *arg)
+{
+	struct spdk_blob_store *bs = arg;
+	struct spdk_bs_journal *journal = &bs->journal;
+	uint64_t interval = SPDK_BS_JOURNAL_CHECKPOINT_US * spdk_get_ticks_hz() / SPDK_SEC_TO_USEC;
+	bool full, empty;
+	uint64_t tail;
+
+	pthread_mutex_lock(&journal->mutex);
+	full = journal->full;
+	empty = journal->cur_page == 0 && journal->pages[0].num_entries == 0;
+	tail = journal->tail;
+	pthread_mutex_unlock(&journal->mutex);
+
+	if (!journal->checkpointing &&
+	    (full || journal->masks_stale ||
+	     (!empty && spdk_get_ticks() - journal->checkpoint_tsc >= interval))) {
+		bs_journal_checkpoint(bs);
+		return SPDK_POLLER_BUSY;
+	}
+
+	if (tail != journal->durable_tail && !journal->flushing) {
+		bs_journal_flush(bs);
+		return SPDK_POLLER_BUSY;
+	}
+
+	return SPDK_POLLER_IDLE;
+}
+
+static int
+bs_journal_init(struct spdk_blob_store *bs, struct spdk_bs_super_block *super, uint64_t epoch)
+{
+	struct spdk_bs_journal *journal = &bs->journal;
+
+	if (super->journal_len == 0) {
+		/* Pre-v4 on-disk format without the journal */
+		return 0;
+	}
+
+	journal->half_pages = super->journal_len / 2;
+	journal->pages = spdk_zmalloc(journal->half_pages * sizeof(*journal->pages), 0x1000, NULL,
+				      SPDK_ENV_SOCKET_ID_ANY, SPDK_MALLOC_DMA);
+	journal->write_pages = spdk_zmalloc(journal->half_pages * sizeof(*journal->pages), 0x1000, NULL,
+					    SPDK_ENV_SOCKET_ID_ANY, SPDK_MALLOC_DMA);
+	if (journal->pages == NULL || journal->write_pages == NULL) {
+		spdk_free(journal->pages);
+		spdk_free(journal->write_pages);
+		journal->pages = NULL;
+		journal->write_pages = NULL;
+		return -ENOMEM;
+	}
+
+	journal->start = super->journal_start;
+	journal->epoch = epoch;
+	journal->used_page_mask_start = super->used_page_mask_start;
+	journal->used_page_mask_len = super->used_page_mask_len;
+	journal->used_cluster_mask_start = super->used_cluster_mask_start;
+	journal->used_cluster_mask_len = super->used_cluster_mask_len;
+	journal->used_blobid_mask_start = super->used_blobid_mask_start;
+	journal->used_blobid_mask_len = super->used_blobid_mask_len;
+	journal->checkpoint_tsc = spdk_get_ticks();
+	journal->poller = SPDK_POLLER_REGISTER(bs_journal_poll, bs, SPDK_BS_JOURNAL_POLL_US);
+
+	return 0;
+}
+
+/* Stop flushing and checkpointing the journal, before the blobstore is unloaded. */
+static void
+bs_journal_stop(struct spdk_blob_store *bs, spdk_msg_fn cb_fn, void *cb_arg)
+{
+	struct spdk_bs_journal *journal = &bs->journal;
+
+	assert(TAILQ_EMPTY(&journal->waiters));
+
+	spdk_poller_unregister(&journal->poller);
+	journal->stopping = true;
+	journal->stop_cb_fn = cb_fn;
+	journal->stop_cb_arg = cb_arg;
+	bs_journal_check_stopped(bs);
+}
+
+static void
+blob_xattrs_init(struct spdk_blob_xattr_opts *xattrs)
+{
+	xattrs->count = 0;
+	xattrs->names = NULL;
+	xattrs->ctx = NULL;
+	xattrs->get_value = NULL;
+}
+
+void
+spdk_blob_opts_init(struct spdk_blob_opts *opts)
+{
+	opts->num_clusters = 0;
+	opts->thin_provision = false;
+	opts->clear_method = BLOB_CLEAR_WITH_DEFAULT;
+	blob_xattrs_init(&opts->xattrs);
+	opts->use_extent_table = true;
+}
+
+void
+spdk_blob_open_opts_init(struct spdk_blob_open_opts *opts)
+{
+	opts->clear_method = BLOB_CLEAR_WITH_DEFAULT;
+}
+
+static struct spdk_blob *
+blob_alloc(struct spdk_blob_store *bs, spdk_blob_id id)
+{
+	struct spdk_blob *blob;
+
+	blob = calloc(1, sizeof(*blob));
+	if (!blob) {
+		return NULL;
+	}
+
+	blob->id = id;
+	blob->bs = bs;
+
+	blob->parent_id = SPDK_BLOBID_INVALID;
+
+	blob->state = SPDK_BLOB_STATE_DIRTY;
+	blob->extent_rle_found = false;
+	blob->extent_table_found = false;
+	blob->active.num_pages = 1;
+	blob->active.pages = calloc(1, sizeof(*blob->active.pages));
+	if (!blob->active.pages) {
+		free(blob);
+		return NULL;
+	}
+
+	blob->active.pages[0] = bs_blobid_to_page(id);
+
+	TAILQ_INIT(&blob->xattrs);
+	TAILQ_INIT(&blob->xattrs_internal);
+	TAILQ_INIT(&blob->pending_persists);
+	TAILQ_INIT(&blob->queued_cluster_inserts);
+	TAILQ_INIT(&blob->committing_cluster_inserts);
+
+	return blob;
+}
+
+static void
+xattrs_free(struct spdk_xattr_tailq *xattrs)
+{
+	struct spdk_xattr	*xattr, *xattr_tmp;
+
+	TAILQ_FOREACH_SAFE(xattr, xattrs, link, xattr_tmp) {
+		TAILQ_REMOVE(xattrs, xattr, link);
+		free(xattr->name);
+		free(xattr->value);
+		free(xattr);
+	}
+}
+
+static void
+blob_free(struct spdk_blob *blob)
+{
+	assert(blob != NULL);
+	assert(TAILQ_EMPTY(&blob->pending_persists));
+	assert(TAILQ_EMPTY(&blob->queued_cluster_inserts));
+	assert(TAILQ_EMPTY(&blob->committing_cluster_inserts));
+
+	free(blob->active.extent_pages);
+	free(blob->clean.extent_pages);
+	free(blob->active.clusters);
+	free(blob->clean.clusters);
+	free(blob->active.pages);
+	free(blob->clean.pages);
+
+	xattrs_free(&blob->xattrs);
+	xattrs_free(&blob->xattrs_internal);
+
+	if (blob->back_bs_dev) {
+		blob->back_bs_dev->destroy(blob->back_bs_dev);
+	}
+
+	free(blob);
+}
+
+struct freeze_io_ctx {
+	struct spdk_bs_cpl cpl;
+	struct spdk_blob *blob;
+};
+
+static void
+blob_io_sync(struct spdk_io_channel_iter *i)
+{
+	spdk_for_each_channel_continue(i, 0);
+}
+
+static void
+blob_execute_queued_io(struct spdk_io_channel_iter *i)
+{
+	struct spdk_io_channel *_ch = spdk_io_channel_iter_get_channel(i);
+	struct spdk_bs_channel *ch = spdk_io_channel_get_ctx(_ch);
+	struct freeze_io_ctx *ctx = spdk_io_channel_iter_get_ctx(i);
+	struct spdk_bs_request_set	*set;
+	struct spdk_bs_user_op_args	*args;
+	spdk_bs_user_op_t *op, *tmp;
+
+	TAILQ_FOREACH_SAFE(op, &ch->queued_io, link, tmp) {
+		set = (struct spdk_bs_request_set *)op;
+		args = &set->u.user_op;
+
+		if (args->blob == ctx->blob) {
+			TAILQ_REMOVE(&ch->queued_io, op, link);
+			bs_user_op_execute(op);
+		}
+	}
+
+	spdk_for_each_channel_continue(i, 0);
+}
+
+static void
+blob_io_cpl(struct spdk_io_channel_iter *i, int status)
 {
 	struct freeze_io_ctx *ctx = spdk_io_channel_iter_get_ctx(i);
 
@@ -1524,8 +2265,6 @@ blob_load(spdk_bs_sequence_t *seq, struct spdk_blob *blob,
 struct spdk_blob_persist_ctx {
 	struct spdk_blob		*blob;
 
-	struct spdk_bs_super_block	*super;
-
 	struct spdk_blob_md_page	*pages;
 	uint32_t			next_extent_page;
 	struct spdk_blob_md_page	*extent_page;
@@ -1629,7 +2368,7 @@ blob_persist_clear_clusters_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserr
 	}
 
 	/* TODO: Add path to persist clear extent pages. */
-	blob_persist_complete(seq, ctx, bserrno);
+	bs_journal_sync(seq, bs, blob_persist_complete, ctx);
 }
 
 static void
@@ -1883,7 +2622,7 @@ blob_resize(struct spdk_blob *blob, uint64_t sz)
 	if (spdk_blob_is_thin_provisioned(blob) == false) {
 		lfc = 0;
 		for (i = num_clusters; i < sz; i++) {
-			lfc = spdk_bit_array_find_first_clear(bs->used_clusters, lfc);
+			lfc = bs_find_free_cluster(bs, lfc);
 			if (lfc == UINT32_MAX) {
 				/* No more free clusters. Cannot satisfy the request */
 				return -ENOSPC;
@@ -1932,7 +2671,7 @@ blob_resize(struct spdk_blob *blob, uint64_t sz)
 		lfc = 0;
 		lfmd = 0;
 		for (i = num_clusters; i < sz; i++) {
-			bs_allocate_cluster(blob, i, &lfc, &lfmd, true);
+			bs_allocate_cluster(blob, NULL, i, &lfc, &lfmd, true);
 			lfc++;
 			lfmd++;
 		}
@@ -1999,9 +2738,10 @@ blob_persist_generate_new_md(struct spdk_blob_persist_ctx *ctx)
 		page_num++;
 	}
 	ctx->pages[i - 1].crc = blob_md_page_calc_crc(&ctx->pages[i - 1]);
-	/* Start writing the metadata from last page to first */
+	/* Start writing the metadata from last page to first, once the claims are
+	 * recorded in the allocation journal */
 	blob->state = SPDK_BLOB_STATE_CLEAN;
-	blob_persist_write_page_chain(seq, ctx, 0);
+	bs_journal_blob(seq, blob, blob_persist_write_page_chain, ctx);
 }
 
 static void
@@ -2060,11 +2800,16 @@ blob_persist_write_extent_pages(spdk_bs_sequence_t *seq, void *cb_arg, int bserr
 }
 
 static void
-blob_persist_start(struct spdk_blob_persist_ctx *ctx)
+blob_persist_start(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 {
-	spdk_bs_sequence_t *seq = ctx->seq;
+	struct spdk_blob_persist_ctx *ctx = cb_arg;
 	struct spdk_blob *blob = ctx->blob;
 
+	if (bserrno != 0) {
+		blob_persist_complete(seq, ctx, bserrno);
+		return;
+	}
+
 	if (blob->active.num_pages == 0) {
 		/* This is the signal that the blob should be deleted.
 		 * Immediately jump to the clean up routine. */
@@ -2078,64 +2823,88 @@ blob_persist_start(struct spdk_blob_persist_ctx *ctx)
 	blob_persist_write_extent_pages(seq, ctx, 0);
 }
 
-static void
-blob_persist_dirty_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
-{
-	struct spdk_blob_persist_ctx *ctx = cb_arg;
-
-	spdk_free(ctx->super);
+struct spdk_bs_mark_dirty_ctx {
+	struct spdk_blob_store		*bs;
+	struct spdk_bs_super_block	*super;
+	spdk_bs_sequence_cpl		cb_fn;
+	void				*cb_arg;
+};
 
-	if (bserrno != 0) {
-		blob_persist_complete(seq, ctx, bserrno);
-		return;
+static void
+bs_mark_dirty_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	struct spdk_bs_mark_dirty_ctx *ctx = cb_arg;
+
+	if (bserrno == 0) {
+		ctx->bs->clean = 0;
 	}
 
-	ctx->blob->bs->clean = 0;
+	ctx->cb_fn(seq, ctx->cb_arg, bserrno);
 
-	blob_persist_start(ctx);
+	spdk_free(ctx->super);
+	free(ctx);
 }
 
 static void
 bs_write_super(spdk_bs_sequence_t *seq, struct spdk_blob_store *bs,
 	       struct spdk_bs_super_block *super, spdk_bs_sequence_cpl cb_fn, void *cb_arg);
 
-
 static void
-blob_persist_dirty(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+bs_mark_dirty_write(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 {
-	struct spdk_blob_persist_ctx *ctx = cb_arg;
+	struct spdk_bs_mark_dirty_ctx *ctx = cb_arg;
 
 	if (bserrno != 0) {
-		spdk_free(ctx->super);
-		blob_persist_complete(seq, ctx, bserrno);
+		bs_mark_dirty_cpl(seq, ctx, bserrno);
 		return;
 	}
 
 	ctx->super->clean = 0;
 	if (ctx->super->size == 0) {
-		ctx->super->size = ctx->blob->bs->dev->blockcnt * ctx->blob->bs->dev->blocklen;
+		ctx->super->size = ctx->bs->dev->blockcnt * ctx->bs->dev->blocklen;
 	}
 
-	bs_write_super(seq, ctx->blob->bs, ctx->super, blob_persist_dirty_cpl, ctx);
+	bs_write_super(seq, ctx->bs, ctx->super, bs_mark_dirty_cpl, ctx);
 }
 
+/* Clear the clean flag in the super block, before any metadata is changed on disk. */
 static void
-blob_persist_check_dirty(struct spdk_blob_persist_ctx *ctx)
+bs_mark_dirty(spdk_bs_sequence_t *seq, struct spdk_blob_store *bs,
+	      spdk_bs_sequence_cpl cb_fn, void *cb_arg)
 {
-	if (ctx->blob->bs->clean) {
-		ctx->super = spdk_zmalloc(sizeof(*ctx->super), 0x1000, NULL,
-					  SPDK_ENV_SOCKET_ID_ANY, SPDK_MALLOC_DMA);
-		if (!ctx->super) {
-			blob_persist_complete(ctx->seq, ctx, -ENOMEM);
-			return;
-		}
+	struct spdk_bs_mark_dirty_ctx *ctx;
 
-		bs_sequence_read_dev(ctx->seq, ctx->super, bs_page_to_lba(ctx->blob->bs, 0),
-				     bs_byte_to_lba(ctx->blob->bs, sizeof(*ctx->super)),
-				     blob_persist_dirty, ctx);
-	} else {
-		blob_persist_start(ctx);
+	if (!bs->clean) {
+		cb_fn(seq, cb_arg, 0);
+		return;
+	}
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (!ctx) {
+		cb_fn(seq, cb_arg, -ENOMEM);
+		return;
+	}
+	ctx->bs = bs;
+	ctx->cb_fn = cb_fn;
+	ctx->cb_arg = cb_arg;
+
+	ctx->super = spdk_zmalloc(sizeof(*ctx->super), 0x1000, NULL,
+				  SPDK_ENV_SOCKET_ID_ANY, SPDK_MALLOC_DMA);
+	if (!ctx->super) {
+		free(ctx);
+		cb_fn(seq, cb_arg, -ENOMEM);
+		return;
 	}
+
+	bs_sequence_read_dev(seq, ctx->super, bs_page_to_lba(bs, 0),
+			     bs_byte_to_lba(bs, sizeof(*ctx->super)),
+			     bs_mark_dirty_write, ctx);
+}
+
+static void
+blob_persist_check_dirty(struct spdk_blob_persist_ctx *ctx)
+{
+	bs_mark_dirty(ctx->seq, ctx->blob->bs, blob_persist_start, ctx);
 }
 
 /* Write a blob to disk */
@@ -2273,11 +3042,14 @@ bs_allocate_and_copy_cluster(struct spdk_blob *blob,
 	struct spdk_bs_cpl cpl;
 	struct spdk_bs_channel *ch;
 	struct spdk_blob_copy_cluster_ctx *ctx;
+	struct spdk_bs_user_op_args *args;
 	uint32_t cluster_start_page;
 	uint32_t cluster_number;
+	bool copy;
 	int rc;
 
 	ch = spdk_io_channel_get_ctx(_ch);
+	args = &((struct spdk_bs_request_set *)op)->u.user_op;
 
 	if (!TAILQ_EMPTY(&ch->need_cluster_alloc)) {
 		/* There are already operations pending. Queue this user op
@@ -2305,7 +3077,13 @@ bs_allocate_and_copy_cluster(struct spdk_blob *blob,
 	ctx->blob = blob;
 	ctx->page = cluster_start_page;
 
-	if (blob->parent_id != SPDK_BLOBID_INVALID) {
+	/* The user op overwrites the whole cluster once it is allocated, so there
+	 * is nothing to preserve from the parent. Writes spanning multiple clusters
+	 * are split per cluster, so aligned multi-cluster writes end up here too. */
+	copy = blob->parent_id != SPDK_BLOBID_INVALID &&
+	       !bs_io_units_cover_cluster(blob, args->offset, args->length);
+
+	if (copy) {
 		ctx->buf = spdk_malloc(blob->bs->cluster_sz, blob->back_bs_dev->blocklen,
 				       NULL, SPDK_ENV_SOCKET_ID_ANY, SPDK_MALLOC_DMA);
 		if (!ctx->buf) {
@@ -2317,7 +3095,7 @@ bs_allocate_and_copy_cluster(struct spdk_blob *blob,
 		}
 	}
 
-	rc = bs_allocate_cluster(blob, cluster_number, &ctx->new_cluster, &ctx->new_extent_page,
+	rc = bs_allocate_cluster(blob, ch, cluster_number, &ctx->new_cluster, &ctx->new_extent_page,
 				 false);
 	if (rc != 0) {
 		spdk_free(ctx->buf);
@@ -2342,7 +3120,7 @@ bs_allocate_and_copy_cluster(struct spdk_blob *blob,
 	/* Queue the user op to block other incoming operations */
 	TAILQ_INSERT_TAIL(&ch->need_cluster_alloc, op, link);
 
-	if (blob->parent_id != SPDK_BLOBID_INVALID) {
+	if (copy) {
 		/* Read cluster from backing device */
 		bs_sequence_read_bs_dev(ctx->seq, blob->back_bs_dev, ctx->buf,
 					bs_dev_page_to_lba(blob->back_bs_dev, cluster_start_page),
@@ -2433,6 +3211,97 @@ blob_request_submit_op_split_next(void *cb_arg, int bserrno)
 	}
 }
 
+/*
+ * Returns true if a request that crosses cluster boundaries can be issued as a single batch,
+ *  with every piece going straight to a device.  Reads and unmaps always can, writes only when
+ *  none of the pieces need a cluster allocated first.  Frozen blobs queue each piece instead.
+ */
+static bool
+blob_request_can_batch(struct spdk_blob *blob, uint64_t offset, uint64_t length,
+		       enum spdk_blob_op_type op_type)
+{
+	uint64_t op_length;
+
+	if (blob->frozen_refcnt) {
+		return false;
+	}
+
+	if (op_type == SPDK_BLOB_READ || op_type == SPDK_BLOB_READV || op_type == SPDK_BLOB_UNMAP) {
+		return true;
+	}
+
+	while (length > 0) {
+		if (!bs_io_unit_is_allocated(blob, offset)) {
+			return false;
+		}
+		op_length = spdk_min(length, bs_num_io_units_to_cluster_boundary(blob, offset));
+		offset += op_length;
+		length -= op_length;
+	}
+
+	return true;
+}
+
+static void
+blob_request_submit_op_split_batch(struct spdk_io_channel *ch, struct spdk_blob *blob,
+				   void *payload, uint64_t offset, uint64_t length,
+				   spdk_blob_op_complete cb_fn, void *cb_arg, enum spdk_blob_op_type op_type)
+{
+	struct spdk_bs_cpl	cpl;
+	spdk_bs_batch_t		*batch;
+	uint8_t			*buf = payload;
+	uint64_t		op_length, lba;
+	uint32_t		lba_count;
+
+	cpl.type = SPDK_BS_CPL_TYPE_BLOB_BASIC;
+	cpl.u.blob_basic.cb_fn = cb_fn;
+	cpl.u.blob_basic.cb_arg = cb_arg;
+
+	batch = bs_batch_open(ch, &cpl);
+	if (!batch) {
+		cb_fn(cb_arg, -ENOMEM);
+		return;
+	}
+
+	while (length > 0) {
+		op_length = spdk_min(length, bs_num_io_units_to_cluster_boundary(blob, offset));
+		blob_calculate_lba_and_lba_count(blob, offset, op_length, &lba, &lba_count);
+
+		switch (op_type) {
+		case SPDK_BLOB_READ:
+			if (bs_io_unit_is_allocated(blob, offset)) {
+				bs_batch_read_dev(batch, buf, lba, lba_count);
+			} else {
+				bs_batch_read_bs_dev(batch, blob->back_bs_dev, buf, lba, lba_count);
+			}
+			break;
+		case SPDK_BLOB_WRITE:
+			bs_batch_write_dev(batch, buf, lba, lba_count);
+			break;
+		case SPDK_BLOB_UNMAP:
+			if (bs_io_unit_is_allocated(blob, offset)) {
+				bs_batch_unmap_dev(batch, lba, lba_count);
+			}
+			break;
+		case SPDK_BLOB_WRITE_ZEROES:
+			bs_batch_write_zeroes_dev(batch, lba, lba_count);
+			break;
+		case SPDK_BLOB_READV:
+		case SPDK_BLOB_WRITEV:
+			assert(false);
+			break;
+		}
+
+		if (op_type == SPDK_BLOB_WRITE || op_type == SPDK_BLOB_READ) {
+			buf += op_length * blob->bs->io_unit_size;
+		}
+		offset += op_length;
+		length -= op_length;
+	}
+
+	bs_batch_close(batch);
+}
+
 static void
 blob_request_submit_op_split(struct spdk_io_channel *ch, struct spdk_blob *blob,
 			     void *payload, uint64_t offset, uint64_t length,
@@ -2444,6 +3313,12 @@ blob_request_submit_op_split(struct spdk_io_channel *ch, struct spdk_blob *blob,
 
 	assert(blob != NULL);
 
+	if (blob_request_can_batch(blob, offset, length, op_type)) {
+		blob_request_submit_op_split_batch(ch, blob, payload, offset, length,
+						   cb_fn, cb_arg, op_type);
+		return;
+	}
+
 	ctx = calloc(1, sizeof(struct op_split_ctx));
 	if (ctx == NULL) {
 		cb_fn(cb_arg, -ENOMEM);
@@ -2619,81 +3494,163 @@ struct rw_iov_ctx {
 	spdk_blob_op_complete cb_fn;
 	void *cb_arg;
 	bool read;
-	int iovcnt;
+	int iov_capacity;
+	/* Current position in the original iov array */
 	struct iovec *orig_iov;
+	size_t orig_iovoff;
 	uint64_t io_unit_offset;
 	uint64_t io_units_remaining;
-	uint64_t io_units_done;
+	TAILQ_ENTRY(rw_iov_ctx) link;
 	struct iovec iov[0];
 };
 
+static struct rw_iov_ctx *
+rw_iov_ctx_get(struct spdk_bs_channel *channel, int iovcnt)
+{
+	struct rw_iov_ctx *ctx;
+
+	if (iovcnt <= SPDK_BS_RW_IOV_CTX_IOVCNT) {
+		ctx = TAILQ_FIRST(&channel->rw_iov_ctxs);
+		if (ctx != NULL) {
+			TAILQ_REMOVE(&channel->rw_iov_ctxs, ctx, link);
+			channel->num_rw_iov_ctxs--;
+			return ctx;
+		}
+		iovcnt = SPDK_BS_RW_IOV_CTX_IOVCNT;
+	}
+
+	ctx = calloc(1, sizeof(struct rw_iov_ctx) + iovcnt * sizeof(struct iovec));
+	if (ctx != NULL) {
+		ctx->iov_capacity = iovcnt;
+	}
+
+	return ctx;
+}
+
 static void
-rw_iov_done(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+rw_iov_ctx_put(struct spdk_bs_channel *channel, struct rw_iov_ctx *ctx)
 {
-	assert(cb_arg == NULL);
-	bs_sequence_finish(seq, bserrno);
+	if (ctx->iov_capacity == SPDK_BS_RW_IOV_CTX_IOVCNT &&
+	    channel->num_rw_iov_ctxs < SPDK_BS_CHANNEL_RW_IOV_CTXS) {
+		TAILQ_INSERT_HEAD(&channel->rw_iov_ctxs, ctx, link);
+		channel->num_rw_iov_ctxs++;
+		return;
+	}
+
+	free(ctx);
 }
 
 static void
-rw_iov_split_next(void *cb_arg, int bserrno)
+rw_iov_ctx_complete(struct rw_iov_ctx *ctx, int bserrno)
+{
+	spdk_blob_op_complete cb_fn = ctx->cb_fn;
+	void *cb_arg = ctx->cb_arg;
+
+	rw_iov_ctx_put(spdk_io_channel_get_ctx(ctx->channel), ctx);
+	cb_fn(cb_arg, bserrno);
+}
+
+/*
+ * Fill iov with the next io_units_count worth of the original iov array, starting at the
+ *  current position, and advance the position past it.  Returns the number of iovs used.
+ */
+static int
+rw_iov_ctx_build_iov(struct rw_iov_ctx *ctx, struct iovec *iov, uint64_t io_units_count)
+{
+	uint64_t byte_count = io_units_count * ctx->blob->bs->io_unit_size;
+	size_t len;
+	int iovcnt = 0;
+
+	while (byte_count > 0) {
+		assert(iov + iovcnt < ctx->iov + ctx->iov_capacity);
+		len = spdk_min(byte_count, ctx->orig_iov->iov_len - ctx->orig_iovoff);
+		iov[iovcnt].iov_base = ctx->orig_iov->iov_base + ctx->orig_iovoff;
+		iov[iovcnt].iov_len = len;
+		byte_count -= len;
+		ctx->orig_iovoff += len;
+		if (ctx->orig_iovoff == ctx->orig_iov->iov_len) {
+			ctx->orig_iov++;
+			ctx->orig_iovoff = 0;
+		}
+		iovcnt++;
+	}
+
+	ctx->io_unit_offset += io_units_count;
+	ctx->io_units_remaining -= io_units_count;
+
+	return iovcnt;
+}
+
+static void
+rw_iov_batch_done(void *cb_arg, int bserrno)
+{
+	rw_iov_ctx_complete(cb_arg, bserrno);
+}
+
+/*
+ * Pre-build the iov arrays for all of the pieces up front, back to back in ctx->iov, and
+ *  submit them in parallel.  Each cluster boundary can split at most one original iov, so
+ *  iovcnt + num_pieces - 1 iovs are always enough.
+ */
+static void
+rw_iov_split_batch(struct rw_iov_ctx *ctx)
 {
-	struct rw_iov_ctx *ctx = cb_arg;
 	struct spdk_blob *blob = ctx->blob;
-	struct iovec *iov, *orig_iov;
+	struct spdk_bs_cpl cpl;
+	spdk_bs_batch_t *batch;
+	struct iovec *iov = &ctx->iov[0];
+	uint64_t io_unit_offset, io_units_count, lba;
+	uint32_t lba_count;
 	int iovcnt;
-	size_t orig_iovoff;
-	uint64_t io_units_count, io_units_to_boundary, io_unit_offset;
-	uint64_t byte_count;
 
-	if (bserrno != 0 || ctx->io_units_remaining == 0) {
-		ctx->cb_fn(ctx->cb_arg, bserrno);
-		free(ctx);
+	cpl.type = SPDK_BS_CPL_TYPE_BLOB_BASIC;
+	cpl.u.blob_basic.cb_fn = rw_iov_batch_done;
+	cpl.u.blob_basic.cb_arg = ctx;
+
+	batch = bs_batch_open(ctx->channel, &cpl);
+	if (!batch) {
+		rw_iov_ctx_complete(ctx, -ENOMEM);
 		return;
 	}
 
-	io_unit_offset = ctx->io_unit_offset;
-	io_units_to_boundary = bs_num_io_units_to_cluster_boundary(blob, io_unit_offset);
-	io_units_count = spdk_min(ctx->io_units_remaining, io_units_to_boundary);
-	/*
-	 * Get index and offset into the original iov array for our current position in the I/O sequence.
-	 *  byte_count will keep track of how many bytes remaining until orig_iov and orig_iovoff will
-	 *  point to the current position in the I/O sequence.
-	 */
-	byte_count = ctx->io_units_done * blob->bs->io_unit_size;
-	orig_iov = &ctx->orig_iov[0];
-	orig_iovoff = 0;
-	while (byte_count > 0) {
-		if (byte_count >= orig_iov->iov_len) {
-			byte_count -= orig_iov->iov_len;
-			orig_iov++;
+	while (ctx->io_units_remaining > 0) {
+		io_unit_offset = ctx->io_unit_offset;
+		io_units_count = spdk_min(ctx->io_units_remaining,
+					  bs_num_io_units_to_cluster_boundary(blob, io_unit_offset));
+		iovcnt = rw_iov_ctx_build_iov(ctx, iov, io_units_count);
+
+		blob_calculate_lba_and_lba_count(blob, io_unit_offset, io_units_count, &lba, &lba_count);
+		if (!ctx->read) {
+			bs_batch_writev_dev(batch, iov, iovcnt, lba, lba_count);
+		} else if (bs_io_unit_is_allocated(blob, io_unit_offset)) {
+			bs_batch_readv_dev(batch, iov, iovcnt, lba, lba_count);
 		} else {
-			orig_iovoff = byte_count;
-			byte_count = 0;
+			bs_batch_readv_bs_dev(batch, blob->back_bs_dev, iov, iovcnt, lba, lba_count);
 		}
+
+		iov += iovcnt;
 	}
 
-	/*
-	 * Build an iov array for the next I/O in the sequence.  byte_count will keep track of how many
-	 *  bytes of this next I/O remain to be accounted for in the new iov array.
-	 */
-	byte_count = io_units_count * blob->bs->io_unit_size;
-	iov = &ctx->iov[0];
-	iovcnt = 0;
-	while (byte_count > 0) {
-		assert(iovcnt < ctx->iovcnt);
-		iov->iov_len = spdk_min(byte_count, orig_iov->iov_len - orig_iovoff);
-		iov->iov_base = orig_iov->iov_base + orig_iovoff;
-		byte_count -= iov->iov_len;
-		orig_iovoff = 0;
-		orig_iov++;
-		iov++;
-		iovcnt++;
+	bs_batch_close(batch);
+}
+
+static void
+rw_iov_split_next(void *cb_arg, int bserrno)
+{
+	struct rw_iov_ctx *ctx = cb_arg;
+	struct iovec *iov = &ctx->iov[0];
+	int iovcnt;
+	uint64_t io_units_count, io_unit_offset;
+
+	if (bserrno != 0 || ctx->io_units_remaining == 0) {
+		rw_iov_ctx_complete(ctx, bserrno);
+		return;
 	}
 
-	ctx->io_unit_offset += io_units_count;
-	ctx->io_units_remaining -= io_units_count;
-	ctx->io_units_done += io_units_count;
-	iov = &ctx->iov[0];
+	io_unit_offset = ctx->io_unit_offset;
+	io_units_count = spdk_min(ctx->io_units_remaining,
+				  bs_num_io_units_to_cluster_boundary(ctx->blob, io_unit_offset));
+	iovcnt = rw_iov_ctx_build_iov(ctx, iov, io_units_count);
 
 	if (ctx->read) {
 		spdk_blob_io_readv(ctx->blob, ctx->channel, iov, iovcnt, io_unit_offset,
@@ -2729,18 +3686,14 @@ blob_request_submit_rw_iov(struct spdk_blob *blob, struct spdk_io_channel *_chan
 	}
 
 	/*
-	 * For now, we implement readv/writev using a sequence (instead of a batch) to account for having
-	 *  to split a request that spans a cluster boundary.  For I/O that do not span a cluster boundary,
-	 *  there will be no noticeable difference compared to using a batch.  For I/O that do span a cluster
-	 *  boundary, the target LBAs (after blob offset to LBA translation) may not be contiguous, so we need
-	 *  to allocate a separate iov array and split the I/O such that none of the resulting
-	 *  smaller I/O cross a cluster boundary.  These smaller I/O will be issued in sequence (not in parallel)
-	 *  but since this case happens very infrequently, any performance impact will be negligible.
-	 *
-	 * This could be optimized in the future to allocate a big enough iov array to account for all of the iovs
-	 *  for all of the smaller I/Os, pre-build all of the iov arrays for the smaller I/Os, then issue them
-	 *  in a batch.  That would also require creating an intermediate spdk_bs_cpl that would get called
-	 *  when the batch was completed, to allow for freeing the memory for the iov arrays.
+	 * I/O that does not span a cluster boundary is passed down with the caller's iov array as is.
+	 *  For I/O that does span a cluster boundary, the target LBAs (after blob offset to LBA translation)
+	 *  may not be contiguous, so we need a separate iov array and split the I/O such that none of the
+	 *  resulting smaller I/O cross a cluster boundary.  The iov arrays come from a context cached on the
+	 *  channel.  When every piece can go straight to a device, the iov arrays for all of them are built
+	 *  up front and the pieces are issued in parallel as one batch.  Otherwise (a write needs a cluster
+	 *  allocated, or the blob is frozen) the pieces are issued in sequence through the regular
+	 *  readv/writev path.
 	 */
 	if (spdk_likely(length <= bs_num_io_units_to_cluster_boundary(blob, offset))) {
 		uint32_t lba_count;
@@ -2771,31 +3724,33 @@ blob_request_submit_rw_iov(struct spdk_blob *blob, struct spdk_io_channel *_chan
 		blob_calculate_lba_and_lba_count(blob, offset, length, &lba, &lba_count);
 
 		if (read) {
-			spdk_bs_sequence_t *seq;
+			spdk_bs_batch_t *batch;
 
-			seq = bs_sequence_start(_channel, &cpl);
-			if (!seq) {
+			batch = bs_batch_open(_channel, &cpl);
+			if (!batch) {
 				cb_fn(cb_arg, -ENOMEM);
 				return;
 			}
 
 			if (bs_io_unit_is_allocated(blob, offset)) {
-				bs_sequence_readv_dev(seq, iov, iovcnt, lba, lba_count, rw_iov_done, NULL);
+				bs_batch_readv_dev(batch, iov, iovcnt, lba, lba_count);
 			} else {
-				bs_sequence_readv_bs_dev(seq, blob->back_bs_dev, iov, iovcnt, lba, lba_count,
-							 rw_iov_done, NULL);
+				bs_batch_readv_bs_dev(batch, blob->back_bs_dev, iov, iovcnt, lba, lba_count);
 			}
+
+			bs_batch_close(batch);
 		} else {
 			if (bs_io_unit_is_allocated(blob, offset)) {
-				spdk_bs_sequence_t *seq;
+				spdk_bs_batch_t *batch;
 
-				seq = bs_sequence_start(_channel, &cpl);
-				if (!seq) {
+				batch = bs_batch_open(_channel, &cpl);
+				if (!batch) {
 					cb_fn(cb_arg, -ENOMEM);
 					return;
 				}
 
-				bs_sequence_writev_dev(seq, iov, iovcnt, lba, lba_count, rw_iov_done, NULL);
+				bs_batch_writev_dev(batch, iov, iovcnt, lba, lba_count);
+				bs_batch_close(batch);
 			} else {
 				/* Queue this operation and allocate the cluster */
 				spdk_bs_user_op_t *op;
@@ -2812,8 +3767,19 @@ blob_request_submit_rw_iov(struct spdk_blob *blob, struct spdk_io_channel *_chan
 		}
 	} else {
 		struct rw_iov_ctx *ctx;
-
-		ctx = calloc(1, sizeof(struct rw_iov_ctx) + iovcnt * sizeof(struct iovec));
+		uint64_t first, num_pieces;
+		bool batch;
+
+		batch = blob_request_can_batch(blob, offset, length, read ? SPDK_BLOB_READV : SPDK_BLOB_WRITEV);
+		if (batch) {
+			/* The first piece ends at the next cluster boundary, the rest are whole clusters */
+			first = bs_num_io_units_to_cluster_boundary(blob, offset);
+			num_pieces = 1 + spdk_divide_round_up(length - first,
+							      bs_num_io_units_to_cluster_boundary(blob, offset + first));
+			ctx = rw_iov_ctx_get(spdk_io_channel_get_ctx(_channel), iovcnt + num_pieces - 1);
+		} else {
+			ctx = rw_iov_ctx_get(spdk_io_channel_get_ctx(_channel), iovcnt);
+		}
 		if (ctx == NULL) {
 			cb_fn(cb_arg, -ENOMEM);
 			return;
@@ -2825,12 +3791,15 @@ blob_request_submit_rw_iov(struct spdk_blob *blob, struct spdk_io_channel *_chan
 		ctx->cb_arg = cb_arg;
 		ctx->read = read;
 		ctx->orig_iov = iov;
-		ctx->iovcnt = iovcnt;
+		ctx->orig_iovoff = 0;
 		ctx->io_unit_offset = offset;
 		ctx->io_units_remaining = length;
-		ctx->io_units_done = 0;
 
-		rw_iov_split_next(ctx, 0);
+		if (batch) {
+			rw_iov_split_batch(ctx);
+		} else {
+			rw_iov_split_next(ctx, 0);
+		}
 	}
 }
 
@@ -2916,6 +3885,12 @@ bs_channel_create(void *io_device, void *ctx_buf)
 	TAILQ_INIT(&channel->need_cluster_alloc);
 	TAILQ_INIT(&channel->queued_io);
 
+	channel->num_reserved_clusters = 0;
+	channel->next_reserved_cluster = 0;
+
+	TAILQ_INIT(&channel->rw_iov_ctxs);
+	channel->num_rw_iov_ctxs = 0;
+
 	return 0;
 }
 
@@ -2924,6 +3899,7 @@ bs_channel_destroy(void *io_device, void *ctx_buf)
 {
 	struct spdk_bs_channel *channel = ctx_buf;
 	spdk_bs_user_op_t *op;
+	struct rw_iov_ctx *ctx;
 
 	while (!TAILQ_EMPTY(&channel->need_cluster_alloc)) {
 		op = TAILQ_FIRST(&channel->need_cluster_alloc);
@@ -2937,6 +3913,14 @@ bs_channel_destroy(void *io_device, void *ctx_buf)
 		bs_user_op_abort(op);
 	}
 
+	bs_channel_release_reserved_clusters(channel);
+
+	while (!TAILQ_EMPTY(&channel->rw_iov_ctxs)) {
+		ctx = TAILQ_FIRST(&channel->rw_iov_ctxs);
+		TAILQ_REMOVE(&channel->rw_iov_ctxs, ctx, link);
+		free(ctx);
+	}
+
 	free(channel->req_mem);
 	channel->dev->destroy_channel(channel->dev, channel->dev_channel);
 }
@@ -2956,11 +3940,16 @@ bs_dev_destroy(void *io_device)
 	}
 
 	pthread_mutex_destroy(&bs->used_clusters_mutex);
+	pthread_mutex_destroy(&bs->journal.mutex);
+	spdk_free(bs->journal.pages);
+	spdk_free(bs->journal.write_pages);
 
 	spdk_bit_array_free(&bs->open_blobids);
 	spdk_bit_array_free(&bs->used_blobids);
 	spdk_bit_array_free(&bs->used_md_pages);
 	spdk_bit_array_free(&bs->used_clusters);
+	spdk_bit_array_free(&bs->reserved_clusters);
+	spdk_bit_array_free(&bs->full_cluster_groups);
 	/*
 	 * If this function is called for any reason except a successful unload,
 	 * the unload_cpl type will be NONE and this will be a nop.
@@ -3017,6 +4006,12 @@ bs_blob_list_add(struct spdk_blob *blob)
 	return 0;
 }
 
+static void
+bs_snapshot_chain_changed(struct spdk_blob_store *bs)
+{
+	__atomic_add_fetch(&bs->snapshot_chain_gen, 1, __ATOMIC_RELEASE);
+}
+
 static void
 bs_blob_list_remove(struct spdk_blob *blob)
 {
@@ -3029,6 +4024,8 @@ bs_blob_list_remove(struct spdk_blob *blob)
 		return;
 	}
 
+	bs_snapshot_chain_changed(blob->bs);
+
 	blob->parent_id = SPDK_BLOBID_INVALID;
 	TAILQ_REMOVE(&snapshot_entry->clones, clone_entry, link);
 	free(clone_entry);
@@ -3061,6 +4058,7 @@ bs_free(struct spdk_blob_store *bs)
 {
 	bs_blob_list_free(bs);
 
+	spdk_poller_unregister(&bs->journal.poller);
 	bs_unregister_md_thread(bs);
 	spdk_io_device_unregister(bs, bs_dev_destroy);
 }
@@ -3117,6 +4115,8 @@ bs_alloc(struct spdk_bs_dev *dev, struct spdk_bs_opts *opts, struct spdk_blob_st
 
 	TAILQ_INIT(&bs->blobs);
 	TAILQ_INIT(&bs->snapshots);
+	/* Owner cache entries of generation 0 mean not cached */
+	bs->snapshot_chain_gen = 1;
 	bs->dev = dev;
 	bs->md_thread = spdk_get_thread();
 	assert(bs->md_thread != NULL);
@@ -3139,6 +4139,17 @@ bs_alloc(struct spdk_bs_dev *dev, struct spdk_bs_opts *opts, struct spdk_blob_st
 		return -ENOMEM;
 	}
 
+	bs->full_cluster_groups = spdk_bit_array_create(spdk_divide_round_up(bs->total_clusters,
+				  1U << SPDK_BS_CLUSTER_GROUP_SHIFT));
+	bs->reserved_clusters = spdk_bit_array_create(bs->total_clusters);
+	if (bs->full_cluster_groups == NULL || bs->reserved_clusters == NULL) {
+		spdk_bit_array_free(&bs->used_clusters);
+		spdk_bit_array_free(&bs->full_cluster_groups);
+		spdk_bit_array_free(&bs->reserved_clusters);
+		free(bs);
+		return -ENOMEM;
+	}
+
 	bs->max_channel_ops = opts->max_channel_ops;
 	bs->super_blob = SPDK_BLOBID_INVALID;
 	memcpy(&bs->bstype, &opts->bstype, sizeof(opts->bstype));
@@ -3149,6 +4160,8 @@ bs_alloc(struct spdk_bs_dev *dev, struct spdk_bs_opts *opts, struct spdk_blob_st
 	bs->open_blobids = spdk_bit_array_create(0);
 
 	pthread_mutex_init(&bs->used_clusters_mutex, NULL);
+	pthread_mutex_init(&bs->journal.mutex, NULL);
+	TAILQ_INIT(&bs->journal.waiters);
 
 	spdk_io_device_register(bs, bs_channel_create, bs_channel_destroy,
 				sizeof(struct spdk_bs_channel), "blobstore");
@@ -3156,10 +4169,13 @@ bs_alloc(struct spdk_bs_dev *dev, struct spdk_bs_opts *opts, struct spdk_blob_st
 	if (rc == -1) {
 		spdk_io_device_unregister(bs, NULL);
 		pthread_mutex_destroy(&bs->used_clusters_mutex);
+		pthread_mutex_destroy(&bs->journal.mutex);
 		spdk_bit_array_free(&bs->open_blobids);
 		spdk_bit_array_free(&bs->used_blobids);
 		spdk_bit_array_free(&bs->used_md_pages);
 		spdk_bit_array_free(&bs->used_clusters);
+		spdk_bit_array_free(&bs->reserved_clusters);
+		spdk_bit_array_free(&bs->full_cluster_groups);
 		free(bs);
 		/* FIXME: this is a lie but don't know how to get a proper error code here */
 		return -ENOMEM;
@@ -3176,20 +4192,15 @@ struct spdk_bs_load_ctx {
 	struct spdk_bs_super_block	*super;
 
 	struct spdk_bs_md_mask		*mask;
-	bool				in_page_chain;
-	uint32_t			page_index;
-	uint32_t			cur_page;
-	struct spdk_blob_md_page	*page;
-
-	uint64_t			num_extent_pages;
-	uint32_t			*extent_page_num;
-	struct spdk_blob_md_page	*extent_pages;
 
 	spdk_bs_sequence_t			*seq;
 	spdk_blob_op_with_handle_complete	iter_cb_fn;
 	void					*iter_cb_arg;
 	struct spdk_blob			*blob;
 	spdk_blob_id				blobid;
+
+	/* Epoch the allocation journal continues with */
+	uint64_t				journal_epoch;
 };
 
 static void
@@ -3523,9 +4534,26 @@ bs_load_iter(void *arg, struct spdk_blob *blob, int bserrno)
 static void
 bs_load_complete(struct spdk_bs_load_ctx *ctx)
 {
+	int rc;
+
+	/* The used clusters were loaded or recovered in bulk, without keeping the summary */
+	rc = bs_rebuild_cluster_groups(ctx->bs);
+	if (rc < 0) {
+		bs_load_ctx_fail(ctx, -ENOMEM);
+		return;
+	}
+
+	rc = bs_journal_init(ctx->bs, ctx->super, ctx->journal_epoch);
+	if (rc < 0) {
+		bs_load_ctx_fail(ctx, rc);
+		return;
+	}
+
 	spdk_bs_iter_first(ctx->bs, bs_load_iter, ctx);
 }
 
+static void bs_load_read_journal(struct spdk_bs_load_ctx *ctx);
+
 static void
 bs_load_used_blobids_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 {
@@ -3550,7 +4578,7 @@ bs_load_used_blobids_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 		return;
 	}
 
-	bs_load_complete(ctx);
+	bs_load_read_journal(ctx);
 }
 
 static void
@@ -3662,10 +4690,80 @@ bs_load_read_used_pages(struct spdk_bs_load_ctx *ctx)
 			     bs_load_used_pages_cpl, ctx);
 }
 
+/*
+ * Recovery after an unclean shutdown replays every metadata page. Pages are read in
+ * windows of SPDK_BS_LOAD_REPLAY_WINDOW_PAGES with several windows in flight, and the
+ * windows are parsed on up to SPDK_BS_LOAD_REPLAY_MAX_WORKERS threads, each of them
+ * gathering the clusters it finds in a private bit array that is merged at the end.
+ *
+ * The replay runs in three passes: the first one validates all pages and records their
+ * headers, after which the metadata thread walks the chains. The second one parses the
+ * claimed chain pages, and the third one parses the extent pages they reference.
+ */
+#define SPDK_BS_LOAD_REPLAY_WINDOW_PAGES	32
+#define SPDK_BS_LOAD_REPLAY_QUEUE_DEPTH		16
+#define SPDK_BS_LOAD_REPLAY_MAX_WORKERS		8
+
+#define SPDK_BS_LOAD_REPLAY_PAGE_MD_VALID	(1 << 0)
+#define SPDK_BS_LOAD_REPLAY_PAGE_EXTENT_VALID	(1 << 1)
+
+enum spdk_bs_load_replay_pass {
+	SPDK_BS_LOAD_REPLAY_PASS_SCAN,
+	SPDK_BS_LOAD_REPLAY_PASS_CHAINS,
+	SPDK_BS_LOAD_REPLAY_PASS_EXTENTS,
+};
+
+struct spdk_bs_load_replay_page {
+	uint32_t			next;
+	uint32_t			sequence_num;
+	uint8_t				flags;
+};
+
+struct spdk_bs_load_replay_worker {
+	struct spdk_thread		*thread;
+	struct spdk_bit_array		*used_clusters;
+	uint64_t			num_used_clusters;
+	uint64_t			total_clusters;
+
+	uint64_t			num_extent_pages;
+	uint32_t			*extent_page_num;
+	int				rc;
+};
+
+struct spdk_bs_load_replay_window {
+	struct spdk_bs_load_replay		*replay;
+	struct spdk_bs_load_replay_worker	*worker;
+	struct spdk_blob_md_page		*pages;
+	uint32_t				start_page;
+	uint32_t				num_pages;
+	bool					busy;
+};
+
+struct spdk_bs_load_replay {
+	struct spdk_bs_load_ctx			*ctx;
+	struct spdk_thread			*md_thread;
+	uint32_t				md_len;
+
+	enum spdk_bs_load_replay_pass		pass;
+	/* Pages of interest for the current pass, or NULL for all of them */
+	struct spdk_bit_array			*filter;
+	uint32_t				next_page;
+	uint32_t				outstanding;
+	int					rc;
+
+	struct spdk_bs_load_replay_page		*page_info;
+	struct spdk_bit_array			*extent_pages;
+
+	uint32_t				num_workers;
+	uint32_t				next_worker;
+	struct spdk_bs_load_replay_worker	workers[SPDK_BS_LOAD_REPLAY_MAX_WORKERS];
+	struct spdk_bs_load_replay_window	windows[SPDK_BS_LOAD_REPLAY_QUEUE_DEPTH];
+};
+
 static int
-bs_load_replay_md_parse_page(struct spdk_bs_load_ctx *ctx, struct spdk_blob_md_page *page)
+bs_load_replay_md_parse_page(struct spdk_bs_load_replay_worker *worker,
+			     struct spdk_blob_md_page *page)
 {
-	struct spdk_blob_store *bs = ctx->bs;
 	struct spdk_blob_md_descriptor *desc;
 	size_t	cur_desc = 0;
 
@@ -3692,11 +4790,11 @@ bs_load_replay_md_parse_page(struct spdk_bs_load_ctx *ctx, struct spdk_blob_md_p
 					 * in the used cluster map.
 					 */
 					if (cluster_idx != 0) {
-						spdk_bit_array_set(bs->used_clusters, cluster_idx + j);
-						if (bs->num_free_clusters == 0) {
+						spdk_bit_array_set(worker->used_clusters, cluster_idx + j);
+						if (worker->num_used_clusters == worker->total_clusters) {
 							return -ENOSPC;
 						}
-						bs->num_free_clusters--;
+						worker->num_used_clusters++;
 					}
 					cluster_count++;
 				}
@@ -3730,11 +4828,11 @@ bs_load_replay_md_parse_page(struct spdk_bs_load_ctx *ctx, struct spdk_blob_md_p
 					    cluster_idx >= desc_extent->start_cluster_idx + cluster_count) {
 						return -EINVAL;
 					}
-					spdk_bit_array_set(bs->used_clusters, cluster_idx);
-					if (bs->num_free_clusters == 0) {
+					spdk_bit_array_set(worker->used_clusters, cluster_idx);
+					if (worker->num_used_clusters == worker->total_clusters) {
 						return -ENOSPC;
 					}
-					bs->num_free_clusters--;
+					worker->num_used_clusters++;
 				}
 				cluster_count++;
 			}
@@ -3750,7 +4848,7 @@ bs_load_replay_md_parse_page(struct spdk_bs_load_ctx *ctx, struct spdk_blob_md_p
 			/* Skip this item */
 		} else if (desc->type == SPDK_MD_DESCRIPTOR_TYPE_EXTENT_TABLE) {
 			struct spdk_blob_md_descriptor_extent_table *desc_extent_table;
-			uint32_t num_extent_pages = ctx->num_extent_pages;
+			uint32_t num_extent_pages = worker->num_extent_pages;
 			uint32_t i;
 			size_t extent_pages_length;
 			void *tmp;
@@ -3773,19 +4871,19 @@ bs_load_replay_md_parse_page(struct spdk_bs_load_ctx *ctx, struct spdk_blob_md_p
 			}
 
 			if (num_extent_pages > 0) {
-				tmp = realloc(ctx->extent_page_num, num_extent_pages * sizeof(uint32_t));
+				tmp = realloc(worker->extent_page_num, num_extent_pages * sizeof(uint32_t));
 				if (tmp == NULL) {
 					return -ENOMEM;
 				}
-				ctx->extent_page_num = tmp;
+				worker->extent_page_num = tmp;
 
 				/* Extent table entries contain md page numbers for extent pages.
 				 * Zeroes represent unallocated extent pages, those are run-length-encoded.
 				 */
 				for (i = 0; i < extent_pages_length / sizeof(desc_extent_table->extent_page[0]); i++) {
 					if (desc_extent_table->extent_page[i].page_idx != 0) {
-						ctx->extent_page_num[ctx->num_extent_pages] = desc_extent_table->extent_page[i].page_idx;
-						ctx->num_extent_pages += 1;
+						worker->extent_page_num[worker->num_extent_pages] = desc_extent_table->extent_page[i].page_idx;
+						worker->num_extent_pages += 1;
 					}
 				}
 			}
@@ -3841,29 +4939,31 @@ static bool bs_load_cur_extent_page_valid(struct spdk_blob_md_page *page)
 	return true;
 }
 
-static bool bs_load_cur_md_page_valid(struct spdk_bs_load_ctx *ctx)
+/*
+ * Classify a metadata page read during recovery. A page is either a valid extent
+ * page, a valid page of a metadata chain, or neither. As in the sequential replay,
+ * the first page of a chain has to match the blobid of its own page index.
+ */
+static uint8_t
+bs_load_replay_page_flags(struct spdk_blob_md_page *page, uint32_t page_num)
 {
-	uint32_t crc;
-	struct spdk_blob_md_page *page = ctx->page;
+	if (bs_load_cur_extent_page_valid(page) == true) {
+		return SPDK_BS_LOAD_REPLAY_PAGE_EXTENT_VALID;
+	}
 
-	crc = blob_md_page_calc_crc(page);
-	if (crc != page->crc) {
-		return false;
+	if (blob_md_page_calc_crc(page) != page->crc) {
+		return 0;
 	}
 
 	/* First page of a sequence should match the blobid. */
 	if (page->sequence_num == 0 &&
-	    bs_page_to_blobid(ctx->cur_page) != page->id) {
-		return false;
+	    bs_page_to_blobid(page_num) != page->id) {
+		return 0;
 	}
-	assert(bs_load_cur_extent_page_valid(page) == false);
 
-	return true;
+	return SPDK_BS_LOAD_REPLAY_PAGE_MD_VALID;
 }
 
-static void
-bs_load_replay_cur_md_page(struct spdk_bs_load_ctx *ctx);
-
 static void
 bs_load_write_used_clusters_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 {
@@ -3915,195 +5015,738 @@ bs_load_write_used_md(struct spdk_bs_load_ctx *ctx)
 	bs_write_used_md(ctx->seq, ctx, bs_load_write_used_pages_cpl);
 }
 
+static void bs_load_replay_pass_start(struct spdk_bs_load_replay *replay,
+				      enum spdk_bs_load_replay_pass pass,
+				      struct spdk_bit_array *filter);
+static void bs_load_replay_window_done(void *arg);
+
 static void
-bs_load_replay_md_chain_cpl(struct spdk_bs_load_ctx *ctx)
+bs_load_replay_free(struct spdk_bs_load_replay *replay)
 {
-	uint64_t num_md_clusters;
-	uint64_t i;
+	struct spdk_bs_load_replay_worker *worker;
+	uint32_t i;
 
-	ctx->in_page_chain = false;
+	for (i = 0; i < replay->num_workers; i++) {
+		worker = &replay->workers[i];
+		spdk_bit_array_free(&worker->used_clusters);
+		free(worker->extent_page_num);
+	}
 
-	do {
-		ctx->page_index++;
-	} while (spdk_bit_array_get(ctx->bs->used_md_pages, ctx->page_index) == true);
+	for (i = 0; i < SPDK_BS_LOAD_REPLAY_QUEUE_DEPTH; i++) {
+		spdk_free(replay->windows[i].pages);
+	}
 
-	if (ctx->page_index < ctx->super->md_len) {
-		ctx->cur_page = ctx->page_index;
-		bs_load_replay_cur_md_page(ctx);
-	} else {
-		/* Claim all of the clusters used by the metadata */
-		num_md_clusters = spdk_divide_round_up(ctx->super->md_len, ctx->bs->pages_per_cluster);
-		for (i = 0; i < num_md_clusters; i++) {
-			bs_claim_cluster(ctx->bs, i);
+	spdk_bit_array_free(&replay->extent_pages);
+	free(replay->page_info);
+	free(replay);
+}
+
+static void
+bs_load_replay_fail(struct spdk_bs_load_replay *replay, int bserrno)
+{
+	struct spdk_bs_load_ctx *ctx = replay->ctx;
+
+	bs_load_replay_free(replay);
+	bs_load_ctx_fail(ctx, bserrno);
+}
+
+static void
+bs_load_replay_window_process(void *arg)
+{
+	struct spdk_bs_load_replay_window *window = arg;
+	struct spdk_bs_load_replay *replay = window->replay;
+	struct spdk_bs_load_replay_worker *worker = window->worker;
+	struct spdk_bs_load_replay_page *info;
+	struct spdk_blob_md_page *page;
+	uint32_t i, page_num;
+
+	for (i = 0; i < window->num_pages; i++) {
+		page_num = window->start_page + i;
+		page = &window->pages[i];
+
+		if (replay->pass == SPDK_BS_LOAD_REPLAY_PASS_SCAN) {
+			info = &replay->page_info[page_num];
+			info->flags = bs_load_replay_page_flags(page, page_num);
+			info->sequence_num = page->sequence_num;
+			info->next = page->next;
+			continue;
 		}
-		spdk_free(ctx->page);
-		bs_load_write_used_md(ctx);
+
+		if (spdk_bit_array_get(replay->filter, page_num) == false || worker->rc != 0) {
+			continue;
+		}
+
+		worker->rc = bs_load_replay_md_parse_page(worker, page);
 	}
+
+	spdk_thread_send_msg(replay->md_thread, bs_load_replay_window_done, window);
 }
 
 static void
-bs_load_replay_extent_page_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+bs_load_replay_window_read_cpl(void *cb_arg, int bserrno)
 {
-	struct spdk_bs_load_ctx *ctx = cb_arg;
-	uint32_t page_num;
-	uint64_t i;
+	struct spdk_bs_load_replay_window *window = cb_arg;
+	struct spdk_bs_load_replay *replay = window->replay;
 
 	if (bserrno != 0) {
-		spdk_free(ctx->extent_pages);
-		bs_load_ctx_fail(ctx, bserrno);
+		replay->rc = bserrno;
+		bs_load_replay_window_done(window);
 		return;
 	}
 
-	for (i = 0; i < ctx->num_extent_pages; i++) {
-		/* Extent pages are only read when present within in chain md.
-		 * Integrity of md is not right if that page was not a valid extent page. */
-		if (bs_load_cur_extent_page_valid(&ctx->extent_pages[i]) != true) {
-			spdk_free(ctx->extent_pages);
-			bs_load_ctx_fail(ctx, -EILSEQ);
+	window->worker = &replay->workers[replay->next_worker];
+	replay->next_worker = (replay->next_worker + 1) % replay->num_workers;
+
+	if (spdk_thread_send_msg(window->worker->thread, bs_load_replay_window_process, window) != 0) {
+		/* The worker went away, so parse on the metadata thread instead. */
+		bs_load_replay_window_process(window);
+	}
+}
+
+/*
+ * Keep up to SPDK_BS_LOAD_REPLAY_QUEUE_DEPTH window reads in flight. Windows without
+ * any page of interest for the current pass are not read at all.
+ */
+static void
+bs_load_replay_pump(struct spdk_bs_load_replay *replay)
+{
+	struct spdk_blob_store *bs = replay->ctx->bs;
+	struct spdk_bs_load_replay_window *window;
+	struct spdk_bs_cpl cpl;
+	spdk_bs_batch_t *batch;
+	uint32_t i, start;
+
+	for (i = 0; i < SPDK_BS_LOAD_REPLAY_QUEUE_DEPTH; i++) {
+		window = &replay->windows[i];
+		if (window->busy) {
+			continue;
+		}
+
+		if (replay->rc != 0 || replay->next_page >= replay->md_len) {
 			return;
 		}
 
-		page_num = ctx->extent_page_num[i];
-		spdk_bit_array_set(ctx->bs->used_md_pages, page_num);
-		if (bs_load_replay_md_parse_page(ctx, &ctx->extent_pages[i])) {
-			spdk_free(ctx->extent_pages);
-			bs_load_ctx_fail(ctx, -EILSEQ);
+		start = replay->next_page;
+		if (replay->filter != NULL) {
+			start = spdk_bit_array_find_first_set(replay->filter, start);
+			if (start == UINT32_MAX || start >= replay->md_len) {
+				replay->next_page = replay->md_len;
+				return;
+			}
+		}
+
+		window->start_page = start;
+		window->num_pages = spdk_min(SPDK_BS_LOAD_REPLAY_WINDOW_PAGES, replay->md_len - start);
+		replay->next_page = start + window->num_pages;
+
+		cpl.type = SPDK_BS_CPL_TYPE_BLOB_BASIC;
+		cpl.u.blob_basic.cb_fn = bs_load_replay_window_read_cpl;
+		cpl.u.blob_basic.cb_arg = window;
+
+		batch = bs_batch_open(bs->md_channel, &cpl);
+		if (batch == NULL) {
+			replay->rc = -ENOMEM;
 			return;
 		}
+
+		window->busy = true;
+		replay->outstanding++;
+		bs_batch_read_dev(batch, window->pages, bs_md_page_to_lba(bs, start),
+				  bs_byte_to_lba(bs, (uint64_t)window->num_pages * SPDK_BS_PAGE_SIZE));
+		bs_batch_close(batch);
 	}
+}
+
+/*
+ * Walk the metadata chains the same way the sequential replay did, in page index
+ * order, but on the page headers gathered by the scan pass rather than on pages
+ * read one at a time.
+ */
+static void
+bs_load_replay_claim_chains(struct spdk_bs_load_replay *replay)
+{
+	struct spdk_blob_store *bs = replay->ctx->bs;
+	struct spdk_bs_load_replay_page *info = replay->page_info;
+	uint32_t i, page_num;
 
-	spdk_free(ctx->extent_pages);
-	free(ctx->extent_page_num);
-	ctx->extent_page_num = NULL;
-	ctx->num_extent_pages = 0;
+	for (i = 0; i < replay->md_len; i++) {
+		if (spdk_bit_array_get(bs->used_md_pages, i) == true ||
+		    (info[i].flags & SPDK_BS_LOAD_REPLAY_PAGE_MD_VALID) == 0 ||
+		    info[i].sequence_num != 0) {
+			continue;
+		}
 
-	bs_load_replay_md_chain_cpl(ctx);
+		page_num = i;
+		do {
+			bs_claim_md_page(bs, page_num);
+			if (info[page_num].sequence_num == 0) {
+				spdk_bit_array_set(bs->used_blobids, page_num);
+			}
+			page_num = info[page_num].next;
+		} while (page_num < replay->md_len &&
+			 spdk_bit_array_get(bs->used_md_pages, page_num) == false &&
+			 (info[page_num].flags & SPDK_BS_LOAD_REPLAY_PAGE_MD_VALID) != 0);
+	}
+}
+
+static int
+bs_load_replay_claim_extent_pages(struct spdk_bs_load_replay *replay)
+{
+	struct spdk_blob_store *bs = replay->ctx->bs;
+	struct spdk_bs_load_replay_worker *worker;
+	uint32_t i, j, page_num;
+
+	for (i = 0; i < replay->num_workers; i++) {
+		worker = &replay->workers[i];
+		for (j = 0; j < worker->num_extent_pages; j++) {
+			page_num = worker->extent_page_num[j];
+			/* Extent pages are only read when present within in chain md.
+			 * Integrity of md is not right if that page was not a valid extent page. */
+			if (page_num >= replay->md_len ||
+			    (replay->page_info[page_num].flags & SPDK_BS_LOAD_REPLAY_PAGE_EXTENT_VALID) == 0) {
+				return -EILSEQ;
+			}
+			spdk_bit_array_set(replay->extent_pages, page_num);
+			spdk_bit_array_set(bs->used_md_pages, page_num);
+		}
+
+		free(worker->extent_page_num);
+		worker->extent_page_num = NULL;
+		worker->num_extent_pages = 0;
+	}
+
+	return 0;
 }
 
 static void
-bs_load_replay_extent_pages(struct spdk_bs_load_ctx *ctx)
+bs_load_replay_finish(struct spdk_bs_load_replay *replay)
 {
-	spdk_bs_batch_t *batch;
-	uint32_t page;
-	uint64_t lba;
+	struct spdk_bs_load_ctx *ctx = replay->ctx;
+	struct spdk_blob_store *bs = ctx->bs;
+	struct spdk_bs_load_replay_worker *worker;
+	uint64_t num_used_clusters = 0;
+	uint64_t num_md_clusters;
+	uint32_t cluster_num;
 	uint64_t i;
 
-	ctx->extent_pages = spdk_zmalloc(SPDK_BS_PAGE_SIZE * ctx->num_extent_pages, SPDK_BS_PAGE_SIZE,
-					 NULL, SPDK_ENV_SOCKET_ID_ANY, SPDK_MALLOC_DMA);
-	if (!ctx->extent_pages) {
+	for (i = 0; i < replay->num_workers; i++) {
+		worker = &replay->workers[i];
+		if (worker->rc != 0) {
+			bs_load_replay_fail(replay, -EILSEQ);
+			return;
+		}
+		num_used_clusters += worker->num_used_clusters;
+	}
+
+	if (num_used_clusters > bs->total_clusters) {
+		bs_load_replay_fail(replay, -EILSEQ);
+		return;
+	}
+
+	for (i = 0; i < replay->num_workers; i++) {
+		worker = &replay->workers[i];
+		cluster_num = spdk_bit_array_find_first_set(worker->used_clusters, 0);
+		while (cluster_num != UINT32_MAX) {
+			spdk_bit_array_set(bs->used_clusters, cluster_num);
+			cluster_num = spdk_bit_array_find_first_set(worker->used_clusters, cluster_num + 1);
+		}
+	}
+	bs->num_free_clusters = bs->total_clusters - num_used_clusters;
+
+	/* Claim all of the clusters used by the metadata */
+	num_md_clusters = spdk_divide_round_up(ctx->super->md_len, bs->pages_per_cluster);
+	for (i = 0; i < num_md_clusters; i++) {
+		bs_claim_cluster(bs, i);
+	}
+
+	bs_load_replay_free(replay);
+	bs_load_write_used_md(ctx);
+}
+
+static void
+bs_load_replay_pass_done(struct spdk_bs_load_replay *replay)
+{
+	int rc;
+
+	if (replay->rc != 0) {
+		bs_load_replay_fail(replay, replay->rc);
+		return;
+	}
+
+	switch (replay->pass) {
+	case SPDK_BS_LOAD_REPLAY_PASS_SCAN:
+		bs_load_replay_claim_chains(replay);
+		bs_load_replay_pass_start(replay, SPDK_BS_LOAD_REPLAY_PASS_CHAINS,
+					  replay->ctx->bs->used_md_pages);
+		break;
+	case SPDK_BS_LOAD_REPLAY_PASS_CHAINS:
+		rc = bs_load_replay_claim_extent_pages(replay);
+		if (rc != 0) {
+			bs_load_replay_fail(replay, rc);
+			return;
+		}
+		bs_load_replay_pass_start(replay, SPDK_BS_LOAD_REPLAY_PASS_EXTENTS,
+					  replay->extent_pages);
+		break;
+	case SPDK_BS_LOAD_REPLAY_PASS_EXTENTS:
+		bs_load_replay_finish(replay);
+		break;
+	}
+}
+
+static void
+bs_load_replay_window_done(void *arg)
+{
+	struct spdk_bs_load_replay_window *window = arg;
+	struct spdk_bs_load_replay *replay = window->replay;
+
+	window->busy = false;
+	assert(replay->outstanding > 0);
+	replay->outstanding--;
+
+	bs_load_replay_pump(replay);
+	if (replay->outstanding == 0) {
+		bs_load_replay_pass_done(replay);
+	}
+}
+
+static void
+bs_load_replay_pass_start(struct spdk_bs_load_replay *replay, enum spdk_bs_load_replay_pass pass,
+			  struct spdk_bit_array *filter)
+{
+	replay->pass = pass;
+	replay->filter = filter;
+	replay->next_page = 0;
+
+	bs_load_replay_pump(replay);
+	if (replay->outstanding == 0) {
+		bs_load_replay_pass_done(replay);
+	}
+}
+
+static void
+bs_load_replay_add_worker(void *arg)
+{
+	struct spdk_bs_load_replay *replay = arg;
+
+	if (replay->num_workers < SPDK_BS_LOAD_REPLAY_MAX_WORKERS) {
+		replay->workers[replay->num_workers++].thread = spdk_get_thread();
+	}
+}
+
+static void
+bs_load_replay_workers_ready(void *arg)
+{
+	struct spdk_bs_load_replay *replay = arg;
+	struct spdk_blob_store *bs = replay->ctx->bs;
+	struct spdk_bs_load_replay_worker *worker;
+	uint32_t i;
+
+	if (replay->num_workers == 0) {
+		replay->workers[replay->num_workers++].thread = replay->md_thread;
+	}
+
+	for (i = 0; i < replay->num_workers; i++) {
+		worker = &replay->workers[i];
+		worker->total_clusters = bs->total_clusters;
+		worker->used_clusters = spdk_bit_array_create(bs->total_clusters);
+		if (worker->used_clusters == NULL) {
+			bs_load_replay_fail(replay, -ENOMEM);
+			return;
+		}
+	}
+
+	SPDK_DEBUGLOG(SPDK_LOG_BLOB, "Replaying %" PRIu32 " md pages on %" PRIu32 " threads\n",
+		      replay->md_len, replay->num_workers);
+
+	bs_load_replay_pass_start(replay, SPDK_BS_LOAD_REPLAY_PASS_SCAN, NULL);
+}
+
+static void
+bs_load_replay_md(struct spdk_bs_load_ctx *ctx)
+{
+	struct spdk_bs_load_replay *replay;
+	uint32_t i;
+
+	replay = calloc(1, sizeof(*replay));
+	if (replay == NULL) {
 		bs_load_ctx_fail(ctx, -ENOMEM);
 		return;
 	}
 
-	batch = bs_sequence_to_batch(ctx->seq, bs_load_replay_extent_page_cpl, ctx);
+	replay->ctx = ctx;
+	replay->md_thread = spdk_get_thread();
+	replay->md_len = ctx->super->md_len;
 
-	for (i = 0; i < ctx->num_extent_pages; i++) {
-		page = ctx->extent_page_num[i];
-		assert(page < ctx->super->md_len);
-		lba = bs_md_page_to_lba(ctx->bs, page);
-		bs_batch_read_dev(batch, &ctx->extent_pages[i], lba,
-				  bs_byte_to_lba(ctx->bs, SPDK_BS_PAGE_SIZE));
+	replay->page_info = calloc(replay->md_len, sizeof(*replay->page_info));
+	replay->extent_pages = spdk_bit_array_create(replay->md_len);
+	if (replay->page_info == NULL || replay->extent_pages == NULL) {
+		bs_load_replay_fail(replay, -ENOMEM);
+		return;
 	}
 
-	bs_batch_close(batch);
+	for (i = 0; i < SPDK_BS_LOAD_REPLAY_QUEUE_DEPTH; i++) {
+		replay->windows[i].replay = replay;
+		replay->windows[i].pages = spdk_zmalloc(SPDK_BS_LOAD_REPLAY_WINDOW_PAGES * SPDK_BS_PAGE_SIZE,
+							SPDK_BS_PAGE_SIZE, NULL, SPDK_ENV_SOCKET_ID_ANY,
+							SPDK_MALLOC_DMA);
+		if (replay->windows[i].pages == NULL) {
+			bs_load_replay_fail(replay, -ENOMEM);
+			return;
+		}
+	}
+
+	spdk_for_each_thread(bs_load_replay_add_worker, replay, bs_load_replay_workers_ready);
 }
 
 static void
-bs_load_replay_md_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+bs_recover(struct spdk_bs_load_ctx *ctx)
 {
-	struct spdk_bs_load_ctx *ctx = cb_arg;
+	int		rc;
+
+	rc = spdk_bit_array_resize(&ctx->bs->used_md_pages, ctx->super->md_len);
+	if (rc < 0) {
+		bs_load_ctx_fail(ctx, -ENOMEM);
+		return;
+	}
+
+	rc = spdk_bit_array_resize(&ctx->bs->used_blobids, ctx->super->md_len);
+	if (rc < 0) {
+		bs_load_ctx_fail(ctx, -ENOMEM);
+		return;
+	}
+
+	rc = spdk_bit_array_resize(&ctx->bs->used_clusters, ctx->bs->total_clusters);
+	if (rc < 0) {
+		bs_load_ctx_fail(ctx, -ENOMEM);
+		return;
+	}
+
+	rc = spdk_bit_array_resize(&ctx->bs->open_blobids, ctx->super->md_len);
+	if (rc < 0) {
+		bs_load_ctx_fail(ctx, -ENOMEM);
+		return;
+	}
+
+	ctx->bs->num_free_clusters = ctx->bs->total_clusters;
+	bs_load_replay_md(ctx);
+}
+
+/*
+ * Recovery with the allocation journal. The newest epoch found in the journal and
+ * the one before it are applied on top of the masks loaded from disk. All of the
+ * releases are applied first, and then the md of every logged blob is read again
+ * to claim its md pages and clusters.
+ */
+struct spdk_bs_load_journal {
+	struct spdk_bs_load_ctx			*ctx;
+	struct spdk_bs_journal_page		*pages;
+	/* First md page of every logged blob */
+	struct spdk_bit_array			*blobs;
+
+	uint32_t				cur_blob;
+	uint32_t				cur_page;
+	uint32_t				chain_len;
+	uint64_t				next_extent_page;
+	struct spdk_blob_md_page		*page;
+	struct spdk_bs_load_replay_worker	worker;
+};
+
+static void
+bs_load_journal_free(struct spdk_bs_load_journal *lj)
+{
+	spdk_free(lj->pages);
+	spdk_free(lj->page);
+	spdk_bit_array_free(&lj->blobs);
+	free(lj->worker.extent_page_num);
+	free(lj);
+}
+
+static void
+bs_load_journal_fail(struct spdk_bs_load_journal *lj, int bserrno)
+{
+	struct spdk_bs_load_ctx *ctx = lj->ctx;
+
+	bs_load_journal_free(lj);
+	bs_load_ctx_fail(ctx, bserrno);
+}
+
+/* Number of pages of the given half that belong to one epoch, starting at its first page. */
+static uint32_t
+bs_load_journal_half_len(struct spdk_bs_load_journal *lj, uint32_t half, uint64_t *epoch)
+{
+	uint32_t half_pages = lj->ctx->super->journal_len / 2;
+	struct spdk_bs_journal_page *page;
+	uint32_t i;
+
+	*epoch = 0;
+	for (i = 0; i < half_pages; i++) {
+		page = &lj->pages[half * half_pages + i];
+		if (page->crc != blob_md_page_calc_crc(page) || page->epoch == 0 ||
+		    page->epoch % 2 != half || page->page_idx != i ||
+		    page->num_entries > SPDK_BS_JOURNAL_ENTRIES_PER_PAGE) {
+			break;
+		}
+		if (i == 0) {
+			*epoch = page->epoch;
+		} else if (page->epoch != *epoch) {
+			break;
+		}
+	}
+
+	return i;
+}
+
+static int
+bs_load_journal_apply(struct spdk_bs_load_journal *lj, struct spdk_bs_journal_entry *entry)
+{
+	struct spdk_blob_store *bs = lj->ctx->bs;
+	uint64_t end = (uint64_t)entry->index + entry->count;
+	uint32_t i;
+
+	switch (entry->type) {
+	case SPDK_BS_JOURNAL_ENTRY_BLOB:
+		if (entry->index >= bs->md_len) {
+			return -EILSEQ;
+		}
+		spdk_bit_array_set(lj->blobs, entry->index);
+		break;
+	case SPDK_BS_JOURNAL_ENTRY_RELEASE_MD_PAGES:
+		if (end > bs->md_len) {
+			return -EILSEQ;
+		}
+		for (i = entry->index; i < end; i++) {
+			spdk_bit_array_clear(bs->used_md_pages, i);
+			spdk_bit_array_clear(bs->used_blobids, i);
+		}
+		break;
+	case SPDK_BS_JOURNAL_ENTRY_RELEASE_CLUSTERS:
+		if (end > bs->total_clusters) {
+			return -EILSEQ;
+		}
+		for (i = entry->index; i < end; i++) {
+			spdk_bit_array_clear(bs->used_clusters, i);
+		}
+		break;
+	default:
+		return -EILSEQ;
+	}
+
+	return 0;
+}
+
+static void bs_load_journal_read_blob(struct spdk_bs_load_journal *lj);
+
+static void
+bs_load_journal_read_page(struct spdk_bs_load_journal *lj, uint32_t page_num,
+			  spdk_bs_sequence_cpl cb_fn)
+{
+	struct spdk_blob_store *bs = lj->ctx->bs;
+
+	lj->cur_page = page_num;
+	bs_sequence_read_dev(lj->ctx->seq, lj->page, bs_md_page_to_lba(bs, page_num),
+			     bs_byte_to_lba(bs, SPDK_BS_PAGE_SIZE), cb_fn, lj);
+}
+
+static void
+bs_load_journal_next_blob(struct spdk_bs_load_journal *lj)
+{
+	lj->cur_blob = spdk_bit_array_find_first_set(lj->blobs, lj->cur_blob + 1);
+	bs_load_journal_read_blob(lj);
+}
+
+static void
+bs_load_journal_extent_page_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	struct spdk_bs_load_journal *lj = cb_arg;
+	struct spdk_blob_store *bs = lj->ctx->bs;
 	uint32_t page_num;
-	struct spdk_blob_md_page *page;
+	int rc;
 
 	if (bserrno != 0) {
-		bs_load_ctx_fail(ctx, bserrno);
+		bs_load_journal_fail(lj, bserrno);
 		return;
 	}
 
-	page_num = ctx->cur_page;
-	page = ctx->page;
-	if (bs_load_cur_md_page_valid(ctx) == true) {
-		if (page->sequence_num == 0 || ctx->in_page_chain == true) {
-			bs_claim_md_page(ctx->bs, page_num);
-			if (page->sequence_num == 0) {
-				spdk_bit_array_set(ctx->bs->used_blobids, page_num);
-			}
-			if (bs_load_replay_md_parse_page(ctx, page)) {
-				bs_load_ctx_fail(ctx, -EILSEQ);
-				return;
-			}
-			if (page->next != SPDK_INVALID_MD_PAGE) {
-				ctx->in_page_chain = true;
-				ctx->cur_page = page->next;
-				bs_load_replay_cur_md_page(ctx);
-				return;
-			}
-			if (ctx->num_extent_pages != 0) {
-				bs_load_replay_extent_pages(ctx);
-				return;
-			}
+	if (lj->next_extent_page > 0) {
+		if ((bs_load_replay_page_flags(lj->page, lj->cur_page) &
+		     SPDK_BS_LOAD_REPLAY_PAGE_EXTENT_VALID) == 0) {
+			bs_load_journal_fail(lj, -EILSEQ);
+			return;
+		}
+		spdk_bit_array_set(bs->used_md_pages, lj->cur_page);
+		rc = bs_load_replay_md_parse_page(&lj->worker, lj->page);
+		if (rc < 0) {
+			bs_load_journal_fail(lj, rc);
+			return;
 		}
 	}
-	bs_load_replay_md_chain_cpl(ctx);
+
+	if (lj->next_extent_page == lj->worker.num_extent_pages) {
+		bs_load_journal_next_blob(lj);
+		return;
+	}
+
+	page_num = lj->worker.extent_page_num[lj->next_extent_page++];
+	if (page_num >= bs->md_len) {
+		bs_load_journal_fail(lj, -EILSEQ);
+		return;
+	}
+	bs_load_journal_read_page(lj, page_num, bs_load_journal_extent_page_cpl);
 }
 
 static void
-bs_load_replay_cur_md_page(struct spdk_bs_load_ctx *ctx)
+bs_load_journal_blob_page_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 {
-	uint64_t lba;
+	struct spdk_bs_load_journal *lj = cb_arg;
+	struct spdk_blob_store *bs = lj->ctx->bs;
+	struct spdk_blob_md_page *page = lj->page;
+	bool valid;
+	int rc;
 
-	assert(ctx->cur_page < ctx->super->md_len);
-	lba = bs_md_page_to_lba(ctx->bs, ctx->cur_page);
-	bs_sequence_read_dev(ctx->seq, ctx->page, lba,
-			     bs_byte_to_lba(ctx->bs, SPDK_BS_PAGE_SIZE),
-			     bs_load_replay_md_cpl, ctx);
+	if (bserrno != 0) {
+		bs_load_journal_fail(lj, bserrno);
+		return;
+	}
+
+	valid = (bs_load_replay_page_flags(page, lj->cur_page) & SPDK_BS_LOAD_REPLAY_PAGE_MD_VALID) &&
+		page->id == bs_page_to_blobid(lj->cur_blob) && page->sequence_num == lj->chain_len;
+	if (lj->chain_len == 0) {
+		if (!valid) {
+			/* The blob was deleted since it was logged */
+			bs_load_journal_next_blob(lj);
+			return;
+		}
+		spdk_bit_array_set(bs->used_blobids, lj->cur_page);
+	} else if (!valid) {
+		bs_load_journal_fail(lj, -EILSEQ);
+		return;
+	}
+
+	spdk_bit_array_set(bs->used_md_pages, lj->cur_page);
+	rc = bs_load_replay_md_parse_page(&lj->worker, page);
+	if (rc < 0) {
+		bs_load_journal_fail(lj, rc);
+		return;
+	}
+
+	lj->chain_len++;
+	if (page->next != SPDK_INVALID_MD_PAGE) {
+		if (page->next >= bs->md_len || lj->chain_len >= bs->md_len) {
+			bs_load_journal_fail(lj, -EILSEQ);
+			return;
+		}
+		bs_load_journal_read_page(lj, page->next, bs_load_journal_blob_page_cpl);
+		return;
+	}
+
+	lj->next_extent_page = 0;
+	bs_load_journal_extent_page_cpl(seq, lj, 0);
 }
 
 static void
-bs_load_replay_md(struct spdk_bs_load_ctx *ctx)
+bs_load_journal_read_blob(struct spdk_bs_load_journal *lj)
 {
-	ctx->page_index = 0;
-	ctx->cur_page = 0;
-	ctx->page = spdk_zmalloc(SPDK_BS_PAGE_SIZE, SPDK_BS_PAGE_SIZE,
-				 NULL, SPDK_ENV_SOCKET_ID_ANY, SPDK_MALLOC_DMA);
-	if (!ctx->page) {
-		bs_load_ctx_fail(ctx, -ENOMEM);
+	struct spdk_bs_load_ctx *ctx = lj->ctx;
+	struct spdk_blob_store *bs = ctx->bs;
+
+	if (lj->cur_blob == UINT32_MAX) {
+		bs_load_journal_free(lj);
+		bs->num_free_clusters = spdk_bit_array_count_clear(bs->used_clusters);
+		bs_load_write_used_md(ctx);
+		return;
+	}
+
+	lj->chain_len = 0;
+	lj->worker.num_extent_pages = 0;
+	bs_load_journal_read_page(lj, lj->cur_blob, bs_load_journal_blob_page_cpl);
+}
+
+static void
+bs_load_journal_read_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	struct spdk_bs_load_journal *lj = cb_arg;
+	struct spdk_bs_load_ctx *ctx = lj->ctx;
+	uint32_t half_pages = ctx->super->journal_len / 2;
+	uint32_t num_pages[2];
+	uint64_t epoch[2], last;
+	struct spdk_bs_journal_page *page;
+	uint32_t half, i, j;
+	int rc;
+
+	if (bserrno != 0) {
+		bs_load_journal_fail(lj, bserrno);
+		return;
+	}
+
+	num_pages[0] = bs_load_journal_half_len(lj, 0, &epoch[0]);
+	num_pages[1] = bs_load_journal_half_len(lj, 1, &epoch[1]);
+	last = spdk_max(epoch[0], epoch[1]);
+	ctx->journal_epoch = last + 1;
+
+	if (ctx->super->clean == 1) {
+		bs_load_journal_free(lj);
+		bs_load_complete(ctx);
 		return;
 	}
-	bs_load_replay_cur_md_page(ctx);
+
+	SPDK_NOTICELOG("Recovering the blobstore from allocation journal epoch %" PRIu64 "\n", last);
+
+	for (half = 0; half < 2; half++) {
+		if (num_pages[half] == 0 || epoch[half] + 1 < last) {
+			continue;
+		}
+		for (i = 0; i < num_pages[half]; i++) {
+			page = &lj->pages[half * half_pages + i];
+			for (j = 0; j < page->num_entries; j++) {
+				rc = bs_load_journal_apply(lj, &page->entries[j]);
+				if (rc < 0) {
+					bs_load_journal_fail(lj, rc);
+					return;
+				}
+			}
+		}
+	}
+
+	lj->cur_blob = spdk_bit_array_find_first_set(lj->blobs, 0);
+	bs_load_journal_read_blob(lj);
 }
 
 static void
-bs_recover(struct spdk_bs_load_ctx *ctx)
+bs_load_read_journal(struct spdk_bs_load_ctx *ctx)
 {
-	int		rc;
+	struct spdk_bs_load_journal *lj;
 
-	rc = spdk_bit_array_resize(&ctx->bs->used_md_pages, ctx->super->md_len);
-	if (rc < 0) {
-		bs_load_ctx_fail(ctx, -ENOMEM);
-		return;
-	}
+	/* The used blobids mask was already loaded */
+	spdk_free(ctx->mask);
+	ctx->mask = NULL;
 
-	rc = spdk_bit_array_resize(&ctx->bs->used_blobids, ctx->super->md_len);
-	if (rc < 0) {
-		bs_load_ctx_fail(ctx, -ENOMEM);
+	if (ctx->super->journal_len == 0) {
+		bs_load_complete(ctx);
 		return;
 	}
 
-	rc = spdk_bit_array_resize(&ctx->bs->used_clusters, ctx->bs->total_clusters);
-	if (rc < 0) {
+	lj = calloc(1, sizeof(*lj));
+	if (lj == NULL) {
 		bs_load_ctx_fail(ctx, -ENOMEM);
 		return;
 	}
-
-	rc = spdk_bit_array_resize(&ctx->bs->open_blobids, ctx->super->md_len);
-	if (rc < 0) {
-		bs_load_ctx_fail(ctx, -ENOMEM);
+	lj->ctx = ctx;
+	lj->worker.used_clusters = ctx->bs->used_clusters;
+	lj->worker.total_clusters = UINT64_MAX;
+	lj->pages = spdk_zmalloc(ctx->super->journal_len * SPDK_BS_PAGE_SIZE, 0x1000, NULL,
+				 SPDK_ENV_SOCKET_ID_ANY, SPDK_MALLOC_DMA);
+	lj->page = spdk_zmalloc(SPDK_BS_PAGE_SIZE, 0x1000, NULL,
+				SPDK_ENV_SOCKET_ID_ANY, SPDK_MALLOC_DMA);
+	lj->blobs = spdk_bit_array_create(ctx->super->md_len);
+	if (lj->pages == NULL || lj->page == NULL || lj->blobs == NULL) {
+		bs_load_journal_fail(lj, -ENOMEM);
 		return;
 	}
 
-	ctx->bs->num_free_clusters = ctx->bs->total_clusters;
-	bs_load_replay_md(ctx);
+	bs_sequence_read_dev(ctx->seq, lj->pages, bs_page_to_lba(ctx->bs, ctx->super->journal_start),
+			     bs_page_to_lba(ctx->bs, ctx->super->journal_len),
+			     bs_load_journal_read_cpl, lj);
 }
 
 static void
@@ -4173,6 +5816,11 @@ bs_load_super_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 		bs_load_ctx_fail(ctx, -ENOMEM);
 		return;
 	}
+	rc = spdk_bit_array_resize(&ctx->bs->reserved_clusters, ctx->bs->total_clusters);
+	if (rc < 0) {
+		bs_load_ctx_fail(ctx, -ENOMEM);
+		return;
+	}
 	ctx->bs->md_start = ctx->super->md_start;
 	ctx->bs->md_len = ctx->super->md_len;
 	ctx->bs->total_data_clusters = ctx->bs->total_clusters - spdk_divide_round_up(
@@ -4180,7 +5828,17 @@ bs_load_super_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 	ctx->bs->super_blob = ctx->super->super_blob;
 	memcpy(&ctx->bs->bstype, &ctx->super->bstype, sizeof(ctx->super->bstype));
 
-	if (ctx->super->used_blobid_mask_len == 0 || ctx->super->clean == 0) {
+	if (ctx->super->journal_len != 0 &&
+	    (ctx->super->journal_len % 2 != 0 || ctx->super->journal_start == 0 ||
+	     (uint64_t)ctx->super->journal_start + ctx->super->journal_len > ctx->super->md_start)) {
+		SPDK_ERRLOG("Invalid allocation journal location\n");
+		bs_load_ctx_fail(ctx, -EILSEQ);
+		return;
+	}
+
+	if (ctx->super->used_blobid_mask_len == 0 ||
+	    (ctx->super->clean == 0 && ctx->super->journal_len == 0)) {
+		/* Without the journal, the masks can only be rebuilt from all of the md */
 		bs_recover(ctx);
 	} else {
 		bs_load_read_used_pages(ctx);
@@ -4471,6 +6129,8 @@ bs_dump_super_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 	fprintf(ctx->fp, "Used Cluster Mask Length: %" PRIu32 "\n", ctx->super->used_cluster_mask_len);
 	fprintf(ctx->fp, "Used Blob ID Mask Start: %" PRIu32 "\n", ctx->super->used_blobid_mask_start);
 	fprintf(ctx->fp, "Used Blob ID Mask Length: %" PRIu32 "\n", ctx->super->used_blobid_mask_len);
+	fprintf(ctx->fp, "Allocation Journal Start: %" PRIu32 "\n", ctx->super->journal_start);
+	fprintf(ctx->fp, "Allocation Journal Length: %" PRIu32 "\n", ctx->super->journal_len);
 	fprintf(ctx->fp, "Metadata Start: %" PRIu32 "\n", ctx->super->md_start);
 	fprintf(ctx->fp, "Metadata Length: %" PRIu32 "\n", ctx->super->md_len);
 
@@ -4553,6 +6213,11 @@ spdk_bs_dump(struct spdk_bs_dev *dev, FILE *fp, spdk_bs_dump_print_xattr print_x
 struct spdk_bs_init_ctx {
 	struct spdk_blob_store		*bs;
 	struct spdk_bs_super_block	*super;
+	spdk_bs_sequence_t		*seq;
+
+	struct spdk_bs_md_mask		*used_pages;
+	struct spdk_bs_md_mask		*used_clusters;
+	struct spdk_bs_md_mask		*used_blobids;
 };
 
 static void
@@ -4567,16 +6232,58 @@ bs_init_persist_super_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 }
 
 static void
-bs_init_trim_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+bs_init_write_masks_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 {
 	struct spdk_bs_init_ctx *ctx = cb_arg;
 
+	spdk_free(ctx->used_pages);
+	spdk_free(ctx->used_clusters);
+	spdk_free(ctx->used_blobids);
+
+	if (bserrno != 0) {
+		bs_init_persist_super_cpl(seq, ctx, bserrno);
+		return;
+	}
+
 	/* Write super block */
 	bs_sequence_write_dev(seq, ctx->super, bs_page_to_lba(ctx->bs, 0),
 			      bs_byte_to_lba(ctx->bs, sizeof(*ctx->super)),
 			      bs_init_persist_super_cpl, ctx);
 }
 
+static void
+bs_init_trim_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	struct spdk_bs_init_ctx *ctx = cb_arg;
+	struct spdk_bs_super_block *super = ctx->super;
+	struct spdk_blob_store *bs = ctx->bs;
+	spdk_bs_batch_t *batch;
+
+	/* The masks are written out at init, so a blobstore recovered with the
+	 * allocation journal can load them even before the first checkpoint. */
+	ctx->used_pages = bs_journal_alloc_mask(super->used_page_mask_len,
+						SPDK_MD_MASK_TYPE_USED_PAGES, bs->md_len);
+	ctx->used_clusters = bs_journal_alloc_mask(super->used_cluster_mask_len,
+			     SPDK_MD_MASK_TYPE_USED_CLUSTERS, bs->total_clusters);
+	ctx->used_blobids = bs_journal_alloc_mask(super->used_blobid_mask_len,
+			    SPDK_MD_MASK_TYPE_USED_BLOBIDS, bs->md_len);
+	if (ctx->used_pages == NULL || ctx->used_clusters == NULL || ctx->used_blobids == NULL) {
+		bs_init_write_masks_cpl(seq, ctx, -ENOMEM);
+		return;
+	}
+
+	bs_set_mask(bs->used_clusters, ctx->used_clusters);
+
+	batch = bs_sequence_to_batch(seq, bs_init_write_masks_cpl, ctx);
+	bs_batch_write_dev(batch, ctx->used_pages, bs_page_to_lba(bs, super->used_page_mask_start),
+			   bs_page_to_lba(bs, super->used_page_mask_len));
+	bs_batch_write_dev(batch, ctx->used_clusters, bs_page_to_lba(bs, super->used_cluster_mask_start),
+			   bs_page_to_lba(bs, super->used_cluster_mask_len));
+	bs_batch_write_dev(batch, ctx->used_blobids, bs_page_to_lba(bs, super->used_blobid_mask_start),
+			   bs_page_to_lba(bs, super->used_blobid_mask_len));
+	bs_batch_close(batch);
+}
+
 void
 spdk_bs_init(struct spdk_bs_dev *dev, struct spdk_bs_opts *o,
 	     spdk_bs_op_with_handle_complete cb_fn, void *cb_arg)
@@ -4716,6 +6423,11 @@ spdk_bs_init(struct spdk_bs_dev *dev, struct spdk_bs_opts *o,
 					   SPDK_BS_PAGE_SIZE);
 	num_md_pages += ctx->super->used_blobid_mask_len;
 
+	/* The allocation journal has a fixed size */
+	ctx->super->journal_start = num_md_pages;
+	ctx->super->journal_len = 2 * SPDK_BS_JOURNAL_HALF_PAGES;
+	num_md_pages += ctx->super->journal_len;
+
 	/* The metadata region size was chosen above */
 	ctx->super->md_start = bs->md_start = num_md_pages;
 	ctx->super->md_len = bs->md_len;
@@ -4745,6 +6457,15 @@ spdk_bs_init(struct spdk_bs_dev *dev, struct spdk_bs_opts *o,
 
 	bs->total_data_clusters = bs->num_free_clusters;
 
+	rc = bs_journal_init(bs, ctx->super, 1);
+	if (rc < 0) {
+		spdk_free(ctx->super);
+		free(ctx);
+		bs_free(bs);
+		cb_fn(cb_arg, NULL, rc);
+		return;
+	}
+
 	cpl.type = SPDK_BS_CPL_TYPE_BS_HANDLE;
 	cpl.u.bs_handle.cb_fn = cb_fn;
 	cpl.u.bs_handle.cb_arg = cb_arg;
@@ -4805,6 +6526,18 @@ bs_destroy_trim_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 	free(ctx);
 }
 
+static void
+bs_destroy_journal_stopped(void *arg)
+{
+	struct spdk_bs_init_ctx *ctx = arg;
+
+	/* Write zeroes to the super block */
+	bs_sequence_write_zeroes_dev(ctx->seq,
+				     bs_page_to_lba(ctx->bs, 0),
+				     bs_byte_to_lba(ctx->bs, sizeof(struct spdk_bs_super_block)),
+				     bs_destroy_trim_cpl, ctx);
+}
+
 void
 spdk_bs_destroy(struct spdk_blob_store *bs, spdk_bs_op_complete cb_fn,
 		void *cb_arg)
@@ -4839,12 +6572,9 @@ spdk_bs_destroy(struct spdk_blob_store *bs, spdk_bs_op_complete cb_fn,
 		cb_fn(cb_arg, -ENOMEM);
 		return;
 	}
+	ctx->seq = seq;
 
-	/* Write zeroes to the super block */
-	bs_sequence_write_zeroes_dev(seq,
-				     bs_page_to_lba(bs, 0),
-				     bs_byte_to_lba(bs, sizeof(struct spdk_bs_super_block)),
-				     bs_destroy_trim_cpl, ctx);
+	bs_journal_stop(bs, bs_destroy_journal_stopped, ctx);
 }
 
 /* END spdk_bs_destroy */
@@ -4929,6 +6659,33 @@ bs_unload_write_used_pages_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrn
 	bs_write_used_blobids(seq, ctx, bs_unload_write_used_blobids_cpl);
 }
 
+static void
+bs_unload_release_reserved_clusters_done(struct spdk_io_channel_iter *i, int status)
+{
+	struct spdk_bs_load_ctx	*ctx = spdk_io_channel_iter_get_ctx(i);
+
+	bs_write_used_md(ctx->seq, ctx, bs_unload_write_used_pages_cpl);
+}
+
+static void
+bs_unload_release_reserved_clusters(struct spdk_io_channel_iter *i)
+{
+	struct spdk_io_channel *_ch = spdk_io_channel_iter_get_channel(i);
+
+	bs_channel_release_reserved_clusters(spdk_io_channel_get_ctx(_ch));
+	spdk_for_each_channel_continue(i, 0);
+}
+
+static void
+bs_unload_journal_stopped(void *arg)
+{
+	struct spdk_bs_load_ctx	*ctx = arg;
+
+	/* Clusters reserved by channels that are still open must not be persisted as used */
+	spdk_for_each_channel(ctx->bs, bs_unload_release_reserved_clusters, ctx,
+			      bs_unload_release_reserved_clusters_done);
+}
+
 static void
 bs_unload_read_super_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 {
@@ -4939,7 +6696,8 @@ bs_unload_read_super_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 		return;
 	}
 
-	bs_write_used_md(seq, cb_arg, bs_unload_write_used_pages_cpl);
+	/* The masks written out below replace the journal */
+	bs_journal_stop(ctx->bs, bs_unload_journal_stopped, ctx);
 }
 
 void
@@ -5111,7 +6869,7 @@ spdk_bs_get_io_unit_size(struct spdk_blob_store *bs)
 uint64_t
 spdk_bs_free_cluster_count(struct spdk_blob_store *bs)
 {
-	return bs->num_free_clusters;
+	return __atomic_load_n(&bs->num_free_clusters, __ATOMIC_RELAXED);
 }
 
 uint64_t
@@ -5341,6 +7099,15 @@ struct spdk_clone_snapshot_ctx {
 	 * thin-provisioning. Otherwise only decouple parent and keep clone thin. */
 	bool allocate_all;
 
+	/* For flattening copy clusters held by any snapshot in the chain, then
+	 * detach the blob from the whole chain and keep it thin. */
+	bool flatten;
+
+	/* Pacing of the copy, zero when not throttled */
+	uint64_t ticks_per_cluster;
+	uint64_t next_cluster_tsc;
+	struct spdk_poller *poller;
+
 	struct {
 		spdk_blob_id id;
 		struct spdk_blob *blob;
@@ -5865,7 +7632,14 @@ bs_inflate_blob_done(void *cb_arg, int bserrno)
 		return;
 	}
 
-	if (ctx->allocate_all) {
+	if (ctx->flatten) {
+		/* All data from the snapshot chain was copied, detach from it */
+		bs_blob_list_remove(_blob);
+		blob_remove_xattr(_blob, BLOB_SNAPSHOT, true);
+		_blob->parent_id = SPDK_BLOBID_INVALID;
+		_blob->back_bs_dev->destroy(_blob->back_bs_dev);
+		_blob->back_bs_dev = bs_create_zeroes_dev();
+	} else if (ctx->allocate_all) {
 		/* remove thin provisioning */
 		bs_blob_list_remove(_blob);
 		blob_remove_xattr(_blob, BLOB_SNAPSHOT, true);
@@ -5893,9 +7667,27 @@ bs_inflate_blob_done(void *cb_arg, int bserrno)
 	spdk_blob_sync_md(_blob, bs_clone_snapshot_origblob_cleanup, ctx);
 }
 
+/* Check if any snapshot in the chain of blob holds the cluster */
+static bool
+bs_cluster_allocated_in_chain(struct spdk_blob *blob, uint64_t cluster)
+{
+	while (blob->parent_id != SPDK_BLOBID_INVALID) {
+		blob = ((struct spdk_blob_bs_dev *)blob->back_bs_dev)->blob;
+		if (cluster >= blob->active.num_clusters) {
+			return false;
+		}
+		if (blob->active.clusters[cluster] != 0) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
 /* Check if cluster needs allocation */
 static inline bool
-bs_cluster_needs_allocation(struct spdk_blob *blob, uint64_t cluster, bool allocate_all)
+bs_cluster_needs_allocation(struct spdk_clone_snapshot_ctx *ctx, struct spdk_blob *blob,
+			    uint64_t cluster)
 {
 	struct spdk_blob_bs_dev *b;
 
@@ -5908,11 +7700,28 @@ bs_cluster_needs_allocation(struct spdk_blob *blob, uint64_t cluster, bool alloc
 
 	if (blob->parent_id == SPDK_BLOBID_INVALID) {
 		/* Blob have no parent blob */
-		return allocate_all;
+		return ctx->allocate_all;
+	}
+
+	if (ctx->flatten) {
+		return bs_cluster_allocated_in_chain(blob, cluster);
 	}
 
 	b = (struct spdk_blob_bs_dev *)blob->back_bs_dev;
-	return (allocate_all || b->blob->active.clusters[cluster] != 0);
+	return (ctx->allocate_all || b->blob->active.clusters[cluster] != 0);
+}
+
+static void bs_inflate_blob_touch_next(void *cb_arg, int bserrno);
+
+static int
+bs_inflate_blob_throttle_poll(void *arg)
+{
+	struct spdk_clone_snapshot_ctx *ctx = arg;
+
+	spdk_poller_unregister(&ctx->poller);
+	bs_inflate_blob_touch_next(ctx, 0);
+
+	return SPDK_POLLER_BUSY;
 }
 
 static void
@@ -5921,6 +7730,7 @@ bs_inflate_blob_touch_next(void *cb_arg, int bserrno)
 	struct spdk_clone_snapshot_ctx *ctx = (struct spdk_clone_snapshot_ctx *)cb_arg;
 	struct spdk_blob *_blob = ctx->original.blob;
 	uint64_t offset;
+	uint64_t now;
 
 	if (bserrno != 0) {
 		bs_clone_snapshot_origblob_cleanup(ctx, bserrno);
@@ -5928,12 +7738,24 @@ bs_inflate_blob_touch_next(void *cb_arg, int bserrno)
 	}
 
 	for (; ctx->cluster < _blob->active.num_clusters; ctx->cluster++) {
-		if (bs_cluster_needs_allocation(_blob, ctx->cluster, ctx->allocate_all)) {
+		if (bs_cluster_needs_allocation(ctx, _blob, ctx->cluster)) {
 			break;
 		}
 	}
 
 	if (ctx->cluster < _blob->active.num_clusters) {
+		if (ctx->ticks_per_cluster != 0) {
+			now = spdk_get_ticks();
+			if (now < ctx->next_cluster_tsc) {
+				/* Copied too fast, wait until the next cluster is due */
+				ctx->poller = SPDK_POLLER_REGISTER(bs_inflate_blob_throttle_poll, ctx,
+								   (ctx->next_cluster_tsc - now) * SPDK_SEC_TO_USEC /
+								   spdk_get_ticks_hz());
+				return;
+			}
+			ctx->next_cluster_tsc = spdk_max(now, ctx->next_cluster_tsc) + ctx->ticks_per_cluster;
+		}
+
 		offset = bs_cluster_to_lba(_blob->bs, ctx->cluster);
 
 		/* We may safely increment a cluster before write */
@@ -5970,6 +7792,12 @@ bs_inflate_blob_open_cpl(void *cb_arg, struct spdk_blob *_blob, int bserrno)
 
 	_blob->locked_operation_in_progress = true;
 
+	if (ctx->flatten && _blob->parent_id == SPDK_BLOBID_INVALID) {
+		/* Nothing to flatten */
+		bs_clone_snapshot_origblob_cleanup(ctx, 0);
+		return;
+	}
+
 	if (!ctx->allocate_all && _blob->parent_id == SPDK_BLOBID_INVALID) {
 		/* This blob have no parent, so we cannot decouple it. */
 		SPDK_ERRLOG("Cannot decouple parent of blob with no parent.\n");
@@ -5988,8 +7816,8 @@ bs_inflate_blob_open_cpl(void *cb_arg, struct spdk_blob *_blob, int bserrno)
 	 */
 	lfc = 0;
 	for (i = 0; i < _blob->active.num_clusters; i++) {
-		if (bs_cluster_needs_allocation(_blob, i, ctx->allocate_all)) {
-			lfc = spdk_bit_array_find_first_clear(_blob->bs->used_clusters, lfc);
+		if (bs_cluster_needs_allocation(ctx, _blob, i)) {
+			lfc = bs_find_free_cluster(_blob->bs, lfc);
 			if (lfc == UINT32_MAX) {
 				/* No more free clusters. Cannot satisfy the request */
 				bs_clone_snapshot_origblob_cleanup(ctx, -ENOSPC);
@@ -6005,7 +7833,8 @@ bs_inflate_blob_open_cpl(void *cb_arg, struct spdk_blob *_blob, int bserrno)
 
 static void
 bs_inflate_blob(struct spdk_blob_store *bs, struct spdk_io_channel *channel,
-		spdk_blob_id blobid, bool allocate_all, spdk_blob_op_complete cb_fn, void *cb_arg)
+		spdk_blob_id blobid, bool allocate_all, bool flatten, uint64_t max_bytes_per_sec,
+		spdk_blob_op_complete cb_fn, void *cb_arg)
 {
 	struct spdk_clone_snapshot_ctx *ctx = calloc(1, sizeof(*ctx));
 
@@ -6020,6 +7849,10 @@ bs_inflate_blob(struct spdk_blob_store *bs, struct spdk_io_channel *channel,
 	ctx->original.id = blobid;
 	ctx->channel = channel;
 	ctx->allocate_all = allocate_all;
+	ctx->flatten = flatten;
+	if (max_bytes_per_sec != 0) {
+		ctx->ticks_per_cluster = spdk_max(spdk_get_ticks_hz() * bs->cluster_sz / max_bytes_per_sec, 1);
+	}
 
 	spdk_bs_open_blob(bs, ctx->original.id, bs_inflate_blob_open_cpl, ctx);
 }
@@ -6028,14 +7861,22 @@ void
 spdk_bs_inflate_blob(struct spdk_blob_store *bs, struct spdk_io_channel *channel,
 		     spdk_blob_id blobid, spdk_blob_op_complete cb_fn, void *cb_arg)
 {
-	bs_inflate_blob(bs, channel, blobid, true, cb_fn, cb_arg);
+	bs_inflate_blob(bs, channel, blobid, true, false, 0, cb_fn, cb_arg);
 }
 
 void
 spdk_bs_blob_decouple_parent(struct spdk_blob_store *bs, struct spdk_io_channel *channel,
 			     spdk_blob_id blobid, spdk_blob_op_complete cb_fn, void *cb_arg)
 {
-	bs_inflate_blob(bs, channel, blobid, false, cb_fn, cb_arg);
+	bs_inflate_blob(bs, channel, blobid, false, false, 0, cb_fn, cb_arg);
+}
+
+void
+spdk_bs_blob_flatten(struct spdk_blob_store *bs, struct spdk_io_channel *channel,
+		     spdk_blob_id blobid, uint64_t max_bytes_per_sec,
+		     spdk_blob_op_complete cb_fn, void *cb_arg)
+{
+	bs_inflate_blob(bs, channel, blobid, false, true, max_bytes_per_sec, cb_fn, cb_arg);
 }
 /* END spdk_bs_inflate_blob */
 
@@ -6357,6 +8198,8 @@ delete_snapshot_sync_snapshot_xattr_cpl(void *cb_arg, int bserrno)
 		return;
 	}
 
+	bs_snapshot_chain_changed(ctx->snapshot->bs);
+
 	/* Copy snapshot map to clone map (only unallocated clusters in clone) */
 	for (i = 0; i < ctx->snapshot->active.num_clusters && i < ctx->clone->active.num_clusters; i++) {
 		if (ctx->clone->active.clusters[i] == 0) {
@@ -6805,8 +8648,11 @@ struct spdk_blob_insert_cluster_ctx {
 	int			rc;
 	spdk_blob_op_complete	cb_fn;
 	void			*cb_arg;
+	TAILQ_ENTRY(spdk_blob_insert_cluster_ctx) link;
 };
 
+static void blob_commit_cluster_inserts(struct spdk_blob *blob);
+
 static void
 blob_insert_cluster_msg_cpl(void *arg)
 {
@@ -6816,28 +8662,55 @@ blob_insert_cluster_msg_cpl(void *arg)
 	free(ctx);
 }
 
+struct spdk_blob_insert_extent_ctx {
+	struct spdk_blob		*blob;
+	struct spdk_blob_md_page	*page;
+	uint32_t			extent;
+};
+
 static void
-blob_insert_cluster_msg_cb(void *arg, int bserrno)
+blob_persist_extent_page_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 {
-	struct spdk_blob_insert_cluster_ctx *ctx = arg;
+	struct spdk_blob_insert_extent_ctx *ctx = cb_arg;
 
-	ctx->rc = bserrno;
-	spdk_thread_send_msg(ctx->thread, blob_insert_cluster_msg_cpl, ctx);
+	bs_sequence_finish(seq, bserrno);
+	spdk_free(ctx->page);
+	free(ctx);
 }
 
 static void
-blob_persist_extent_page_cpl(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+blob_insert_extent_write(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
 {
-	struct spdk_blob_md_page        *page = cb_arg;
+	struct spdk_blob_insert_extent_ctx *ctx = cb_arg;
 
-	bs_sequence_finish(seq, bserrno);
-	spdk_free(page);
+	if (bserrno != 0) {
+		blob_persist_extent_page_cpl(seq, ctx, bserrno);
+		return;
+	}
+
+	bs_sequence_write_dev(seq, ctx->page, bs_md_page_to_lba(ctx->blob->bs, ctx->extent),
+			      bs_byte_to_lba(ctx->blob->bs, SPDK_BS_PAGE_SIZE),
+			      blob_persist_extent_page_cpl, ctx);
+}
+
+static void
+blob_insert_extent_journal(spdk_bs_sequence_t *seq, void *cb_arg, int bserrno)
+{
+	struct spdk_blob_insert_extent_ctx *ctx = cb_arg;
+
+	if (bserrno != 0) {
+		blob_persist_extent_page_cpl(seq, ctx, bserrno);
+		return;
+	}
+
+	bs_journal_blob(seq, ctx->blob, blob_insert_extent_write, ctx);
 }
 
 static void
 blob_insert_extent(struct spdk_blob *blob, uint32_t extent, uint64_t cluster_num,
 		   spdk_blob_op_complete cb_fn, void *cb_arg)
 {
+	struct spdk_blob_insert_extent_ctx *ctx;
 	spdk_bs_sequence_t		*seq;
 	struct spdk_bs_cpl		cpl;
 	struct spdk_blob_md_page	*page = NULL;
@@ -6865,53 +8738,170 @@ blob_insert_extent(struct spdk_blob *blob, uint32_t extent, uint64_t cluster_num
 
 	assert(spdk_bit_array_get(blob->bs->used_md_pages, extent) == true);
 
-	bs_sequence_write_dev(seq, page, bs_md_page_to_lba(blob->bs, extent),
-			      bs_byte_to_lba(blob->bs, SPDK_BS_PAGE_SIZE),
-			      blob_persist_extent_page_cpl, page);
+	ctx = calloc(1, sizeof(*ctx));
+	if (!ctx) {
+		spdk_free(page);
+		bs_sequence_finish(seq, -ENOMEM);
+		return;
+	}
+	ctx->blob = blob;
+	ctx->page = page;
+	ctx->extent = extent;
+
+	/* The extent page references the new cluster, so the same rules apply as
+	 * for a blob md update. */
+	bs_mark_dirty(seq, blob->bs, blob_insert_extent_journal, ctx);
+}
+
+static void
+blob_commit_cluster_inserts_cpl(void *cb_arg, int bserrno)
+{
+	struct spdk_blob *blob = cb_arg;
+	struct spdk_blob_insert_cluster_ctx *ctx;
+
+	if (bserrno != 0 && blob->cluster_inserts_rc == 0) {
+		blob->cluster_inserts_rc = bserrno;
+	}
+
+	assert(blob->cluster_inserts_outstanding > 0);
+	if (--blob->cluster_inserts_outstanding > 0) {
+		return;
+	}
+
+	while (!TAILQ_EMPTY(&blob->committing_cluster_inserts)) {
+		ctx = TAILQ_FIRST(&blob->committing_cluster_inserts);
+		TAILQ_REMOVE(&blob->committing_cluster_inserts, ctx, link);
+		ctx->rc = blob->cluster_inserts_rc;
+		spdk_thread_send_msg(ctx->thread, blob_insert_cluster_msg_cpl, ctx);
+	}
+
+	/* Insertions that arrived while this group was persisted form the next group. */
+	if (!TAILQ_EMPTY(&blob->queued_cluster_inserts) && !blob->cluster_inserts_commit_scheduled) {
+		blob_commit_cluster_inserts(blob);
+	}
+}
+
+static bool
+blob_extent_page_is_persisted(struct spdk_blob *blob, uint64_t extent_page_idx)
+{
+	return extent_page_idx < blob->clean.num_extent_pages &&
+	       blob->clean.extent_pages[extent_page_idx] != 0;
+}
+
+static void
+blob_commit_cluster_inserts(struct spdk_blob *blob)
+{
+	struct spdk_blob_insert_cluster_ctx *ctx, *prev;
+	uint64_t extent_page_idx;
+	bool sync_md = false;
+	bool written;
+
+	assert(TAILQ_EMPTY(&blob->committing_cluster_inserts));
+	TAILQ_SWAP(&blob->queued_cluster_inserts, &blob->committing_cluster_inserts,
+		   spdk_blob_insert_cluster_ctx, link);
+
+	/* Hold a reference for the submission loop so the group cannot complete early. */
+	blob->cluster_inserts_outstanding = 1;
+	blob->cluster_inserts_rc = 0;
+
+	TAILQ_FOREACH(ctx, &blob->committing_cluster_inserts, link) {
+		if (blob->use_extent_table == false || ctx->extent_page != 0) {
+			/* Either only extents_rle is used or a new extent page was added
+			 * to the extent table. Both require a sync of the blob md. */
+			sync_md = true;
+			continue;
+		}
+
+		/* The extent page is already in the extent table. Write it out once per
+		 * group, unless it is new and will be written out by the md sync. */
+		extent_page_idx = ctx->cluster_num / SPDK_EXTENTS_PER_EP;
+		if (!blob_extent_page_is_persisted(blob, extent_page_idx)) {
+			sync_md = true;
+			continue;
+		}
+
+		written = false;
+		for (prev = TAILQ_FIRST(&blob->committing_cluster_inserts); prev != ctx;
+		     prev = TAILQ_NEXT(prev, link)) {
+			if (prev->extent_page == 0 && prev->cluster_num / SPDK_EXTENTS_PER_EP == extent_page_idx) {
+				written = true;
+				break;
+			}
+		}
+		if (written) {
+			continue;
+		}
+
+		blob->cluster_inserts_outstanding++;
+		blob_insert_extent(blob, blob->active.extent_pages[extent_page_idx], ctx->cluster_num,
+				   blob_commit_cluster_inserts_cpl, blob);
+	}
+
+	if (sync_md) {
+		blob->cluster_inserts_outstanding++;
+		blob->state = SPDK_BLOB_STATE_DIRTY;
+		blob_sync_md(blob, blob_commit_cluster_inserts_cpl, blob);
+	}
+
+	blob_commit_cluster_inserts_cpl(blob, 0);
+}
+
+static void
+blob_commit_cluster_inserts_msg(void *arg)
+{
+	struct spdk_blob *blob = arg;
+
+	blob->cluster_inserts_commit_scheduled = false;
+	if (TAILQ_EMPTY(&blob->committing_cluster_inserts)) {
+		blob_commit_cluster_inserts(blob);
+	}
 }
 
 static void
 blob_insert_cluster_msg(void *arg)
 {
 	struct spdk_blob_insert_cluster_ctx *ctx = arg;
+	struct spdk_blob *blob = ctx->blob;
 	uint32_t *extent_page;
 
-	ctx->rc = blob_insert_cluster(ctx->blob, ctx->cluster_num, ctx->cluster);
+	ctx->rc = blob_insert_cluster(blob, ctx->cluster_num, ctx->cluster);
 	if (ctx->rc != 0) {
 		spdk_thread_send_msg(ctx->thread, blob_insert_cluster_msg_cpl, ctx);
 		return;
 	}
 
-	if (ctx->blob->use_extent_table == false) {
-		/* Extent table is not used, proceed with sync of md that will only use extents_rle. */
-		ctx->blob->state = SPDK_BLOB_STATE_DIRTY;
-		blob_sync_md(ctx->blob, blob_insert_cluster_msg_cb, ctx);
-		return;
-	}
+	/* Checkpoints of the allocation masks include the cluster from now on */
+	pthread_mutex_lock(&blob->bs->used_clusters_mutex);
+	spdk_bit_array_clear(blob->bs->reserved_clusters, ctx->cluster);
+	pthread_mutex_unlock(&blob->bs->used_clusters_mutex);
 
-	extent_page = bs_cluster_to_extent_page(ctx->blob, ctx->cluster_num);
-	if (*extent_page == 0) {
-		/* Extent page requires allocation.
-		 * It was already claimed in the used_md_pages map and placed in ctx.
-		 * Blob persist will take care of writing out new extent page on disk. */
-		assert(ctx->extent_page != 0);
-		assert(spdk_bit_array_get(ctx->blob->bs->used_md_pages, ctx->extent_page) == true);
-		*extent_page = ctx->extent_page;
-		ctx->blob->state = SPDK_BLOB_STATE_DIRTY;
-		blob_sync_md(ctx->blob, blob_insert_cluster_msg_cb, ctx);
-	} else {
-		/* It is possible for original thread to allocate extent page for
-		 * different cluster in the same extent page. In such case proceed with
-		 * updating the existing extent page, but release the additional one. */
-		if (ctx->extent_page != 0) {
-			assert(spdk_bit_array_get(ctx->blob->bs->used_md_pages, ctx->extent_page) == true);
-			bs_release_md_page(ctx->blob->bs, ctx->extent_page);
+	if (blob->use_extent_table == true) {
+		extent_page = bs_cluster_to_extent_page(blob, ctx->cluster_num);
+		if (*extent_page == 0) {
+			/* Extent page requires allocation.
+			 * It was already claimed in the used_md_pages map and placed in ctx.
+			 * Blob persist will take care of writing out new extent page on disk. */
+			assert(ctx->extent_page != 0);
+			assert(spdk_bit_array_get(blob->bs->used_md_pages, ctx->extent_page) == true);
+			*extent_page = ctx->extent_page;
+		} else if (ctx->extent_page != 0) {
+			/* It is possible for original thread to allocate extent page for
+			 * different cluster in the same extent page. In such case proceed with
+			 * updating the existing extent page, but release the additional one. */
+			assert(spdk_bit_array_get(blob->bs->used_md_pages, ctx->extent_page) == true);
+			bs_release_md_page(blob->bs, ctx->extent_page);
 			ctx->extent_page = 0;
 		}
-		/* Extent page already allocated.
-		 * Every cluster allocation, requires just an update of single extent page. */
-		blob_insert_extent(ctx->blob, *extent_page, ctx->cluster_num,
-				   blob_insert_cluster_msg_cb, ctx);
+	}
+
+	/* The cluster is now part of the in-memory metadata. Persisting it is deferred
+	 * so that insertions from other channels already queued to the md thread,
+	 * or arriving while a previous group is written out, share a single
+	 * metadata update. */
+	TAILQ_INSERT_TAIL(&blob->queued_cluster_inserts, ctx, link);
+	if (TAILQ_EMPTY(&blob->committing_cluster_inserts) && !blob->cluster_inserts_commit_scheduled) {
+		blob->cluster_inserts_commit_scheduled = true;
+		spdk_thread_send_msg(blob->bs->md_thread, blob_commit_cluster_inserts_msg, blob);
 	}
 }
 
@@ -7458,4 +9448,44 @@ spdk_blob_get_clones(struct spdk_blob_store *bs, spdk_blob_id blobid, spdk_blob_
 	return 0;
 }
 
+static inline struct spdk_blob *
+blob_get_parent(struct spdk_blob *blob)
+{
+	if (blob->parent_id == SPDK_BLOBID_INVALID) {
+		return NULL;
+	}
+
+	return ((struct spdk_blob_bs_dev *)blob->back_bs_dev)->blob;
+}
+
+int
+spdk_blob_get_next_changed_cluster(struct spdk_blob *blob, spdk_blob_id base_id,
+				   uint64_t cluster, uint64_t *next)
+{
+	struct spdk_blob *b;
+
+	assert(blob != NULL);
+
+	for (b = blob; b->id != base_id; b = blob_get_parent(b)) {
+		if (blob_get_parent(b) == NULL) {
+			if (base_id != SPDK_BLOBID_INVALID) {
+				return -EINVAL;
+			}
+			break;
+		}
+	}
+
+	for (; cluster < blob->active.num_clusters; cluster++) {
+		for (b = blob; b != NULL && b->id != base_id; b = blob_get_parent(b)) {
+			if (cluster < b->active.num_clusters && b->active.clusters[cluster] != 0) {
+				*next = cluster;
+				return 0;
+			}
+		}
+	}
+
+	*next = UINT64_MAX;
+	return 0;
+}
+
 SPDK_LOG_REGISTER_COMPONENT("blob", SPDK_LOG_BLOB)
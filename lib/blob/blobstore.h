@@ -37,6 +37,7 @@
 #include "spdk/assert.h"
 #include "spdk/blob.h"
 #include "spdk/queue.h"
+#include "spdk/thread.h"
 #include "spdk/util.h"
 
 #include "request.h"
@@ -52,6 +53,31 @@
 #define SPDK_BLOB_OPTS_DEFAULT_CHANNEL_OPS 512
 #define SPDK_BLOB_BLOBID_HIGH_BIT (1ULL << 32)
 
+/* Clusters are tracked in groups of 64 (one word of the used_clusters array)
+ * by the full_cluster_groups summary. */
+#define SPDK_BS_CLUSTER_GROUP_SHIFT 6
+
+/* Number of clusters an I/O channel reserves at once, so that first writes to
+ * thin provisioned blobs don't need used_clusters_mutex for each cluster. */
+#define SPDK_BS_CHANNEL_RESERVED_CLUSTERS 16
+
+/* Channels stop reserving clusters when fewer than this many are free, so that
+ * clusters left in reservations can't make allocations fail early. */
+#define SPDK_BS_CLUSTER_RESERVE_MIN_FREE (SPDK_BS_CHANNEL_RESERVED_CLUSTERS * 64)
+
+/* readv/writev split contexts kept on each channel for reuse, and the number of
+ * iovs each cached context can hold. Larger requests allocate a one-off context. */
+#define SPDK_BS_CHANNEL_RW_IOV_CTXS 16
+#define SPDK_BS_RW_IOV_CTX_IOVCNT 32
+
+/* Number of pages in each of the two halves of the allocation journal */
+#define SPDK_BS_JOURNAL_HALF_PAGES 16
+
+/* How often the allocation journal is flushed, and how often the allocation
+ * masks are checkpointed if the journal has any entries. */
+#define SPDK_BS_JOURNAL_POLL_US (100 * 1000)
+#define SPDK_BS_JOURNAL_CHECKPOINT_US (5 * 1000 * 1000)
+
 struct spdk_xattr {
 	uint32_t	index;
 	uint16_t	value_len;
@@ -169,11 +195,70 @@ struct spdk_blob {
 	/* A list of pending metadata pending_persists */
 	TAILQ_HEAD(, spdk_blob_persist_ctx) pending_persists;
 
+	/* Cluster insertions already applied to the in-memory metadata that are
+	 * waiting to be persisted, and the group currently being persisted.
+	 * Insertions queued while a group is persisted are committed together. */
+	TAILQ_HEAD(, spdk_blob_insert_cluster_ctx) queued_cluster_inserts;
+	TAILQ_HEAD(, spdk_blob_insert_cluster_ctx) committing_cluster_inserts;
+	uint32_t	cluster_inserts_outstanding;
+	int		cluster_inserts_rc;
+	bool		cluster_inserts_commit_scheduled;
+
+	/* Epoch of the allocation journal the blob was last logged in, and the
+	 * journal position that has to be durable before its md is written. */
+	uint64_t	journal_epoch;
+	uint64_t	journal_tail;
+
 	/* Number of data clusters retrived from extent table,
 	 * that many have to be read from extent pages. */
 	uint64_t	remaining_clusters_in_et;
 };
 
+struct spdk_bs_journal_waiter;
+
+/*
+ * The allocation journal lets a blobstore that was not shut down cleanly be
+ * recovered from the last checkpoint of the allocation masks, instead of from
+ * all of its metadata. See the comment above bs_journal_append() for details.
+ */
+struct spdk_bs_journal {
+	/* Protects the fields up to full. Entries are appended from any thread. */
+	pthread_mutex_t			mutex;
+	uint64_t			epoch;
+	struct spdk_bs_journal_page	*pages;
+	uint32_t			cur_page;
+	uint64_t			tail;
+	bool				full;
+
+	/* The remaining fields are only accessed on the md thread */
+	struct spdk_bs_journal_page	*write_pages;
+	uint32_t			start;
+	uint32_t			half_pages;
+	uint32_t			flush_page;
+	uint32_t			next_flush_page;
+	uint64_t			flushing_tail;
+	uint64_t			durable_tail;
+	bool				flushing;
+	bool				checkpointing;
+	bool				checkpoint_pending;
+	/* Set from the start of an epoch until its checkpoint has been written */
+	bool				masks_stale;
+	bool				stopping;
+	uint64_t			checkpoint_tsc;
+	struct spdk_poller		*poller;
+	TAILQ_HEAD(, spdk_bs_journal_waiter) waiters;
+	spdk_msg_fn			stop_cb_fn;
+	void				*stop_cb_arg;
+
+	/* Location of the allocation masks written out by checkpoints */
+	uint32_t			used_page_mask_start;
+	uint32_t			used_page_mask_len;
+	uint32_t			used_cluster_mask_start;
+	uint32_t			used_cluster_mask_len;
+	uint32_t			used_blobid_mask_start;
+	uint32_t			used_blobid_mask_len;
+};
+
 struct spdk_blob_store {
 	uint64_t			md_start; /* Offset from beginning of disk, in pages */
 	uint32_t			md_len; /* Count, in pages */
@@ -187,6 +272,10 @@ struct spdk_blob_store {
 
 	struct spdk_bit_array		*used_md_pages;
 	struct spdk_bit_array		*used_clusters;
+	/* One bit per group of clusters, set when the whole group is used */
+	struct spdk_bit_array		*full_cluster_groups;
+	/* Clusters reserved by I/O channels but not inserted into any blob yet */
+	struct spdk_bit_array		*reserved_clusters;
 	struct spdk_bit_array		*used_blobids;
 	struct spdk_bit_array		*open_blobids;
 
@@ -195,6 +284,8 @@ struct spdk_blob_store {
 	uint32_t			cluster_sz;
 	uint64_t			total_clusters;
 	uint64_t			total_data_clusters;
+	/* Clusters reserved by I/O channels are still counted as free. Updated atomically,
+	 * since channels consume their reserved clusters without used_clusters_mutex. */
 	uint64_t			num_free_clusters;
 	uint64_t			pages_per_cluster;
 	uint8_t				pages_per_cluster_shift;
@@ -208,6 +299,11 @@ struct spdk_blob_store {
 
 	TAILQ_HEAD(, spdk_blob)		blobs;
 	TAILQ_HEAD(, spdk_blob_list)	snapshots;
+	/* Incremented whenever a snapshot chain or a snapshot's cluster map changes.
+	 * Invalidates the cluster owner caches of the blob bs_devs. */
+	uint64_t			snapshot_chain_gen;
+
+	struct spdk_bs_journal		journal;
 
 	bool                            clean;
 };
@@ -223,6 +319,14 @@ struct spdk_bs_channel {
 
 	TAILQ_HEAD(, spdk_bs_request_set) need_cluster_alloc;
 	TAILQ_HEAD(, spdk_bs_request_set) queued_io;
+
+	/* Clusters marked as used in bs->used_clusters, but not given to any blob yet */
+	uint32_t			reserved_clusters[SPDK_BS_CHANNEL_RESERVED_CLUSTERS];
+	uint32_t			num_reserved_clusters;
+	uint32_t			next_reserved_cluster;
+
+	TAILQ_HEAD(, rw_iov_ctx)	rw_iov_ctxs;
+	uint32_t			num_rw_iov_ctxs;
 };
 
 /** operation type */
@@ -244,6 +348,11 @@ enum spdk_blob_op_type {
 struct spdk_blob_bs_dev {
 	struct spdk_bs_dev bs_dev;
 	struct spdk_blob *blob;
+
+	/* Per cluster cache of how many levels below blob the snapshot holding the
+	 * cluster data is. Allocated on first read, see blob_bs_dev.c. */
+	uint64_t *owner_cache;
+	uint64_t owner_cache_size;
 };
 
 /* On-Disk Data Structures
@@ -251,7 +360,7 @@ struct spdk_blob_bs_dev {
  * The following data structures exist on disk.
  */
 #define SPDK_BS_INITIAL_VERSION 1
-#define SPDK_BS_VERSION 3 /* current version */
+#define SPDK_BS_VERSION 4 /* current version */
 
 #pragma pack(push, 1)
 
@@ -426,11 +535,38 @@ struct spdk_bs_super_block {
 	uint64_t        size; /* size of blobstore in bytes */
 	uint32_t        io_unit_size; /* Size of io unit in bytes */
 
-	uint8_t         reserved[4000];
+	uint32_t	journal_start; /* Offset from beginning of disk, in pages */
+	uint32_t	journal_len; /* Count, in pages. 0 for pre-v4 on-disk format. */
+
+	uint8_t         reserved[3992];
 	uint32_t	crc;
 };
 SPDK_STATIC_ASSERT(sizeof(struct spdk_bs_super_block) == 0x1000, "Invalid super block size");
 
+#define SPDK_BS_JOURNAL_ENTRY_BLOB		1 /* index is the first md page of a blob */
+#define SPDK_BS_JOURNAL_ENTRY_RELEASE_MD_PAGES	2
+#define SPDK_BS_JOURNAL_ENTRY_RELEASE_CLUSTERS	3
+
+struct spdk_bs_journal_entry {
+	uint32_t	type;
+	uint32_t	index;
+	uint32_t	count;
+};
+
+#define SPDK_BS_JOURNAL_ENTRIES_PER_PAGE 339
+
+struct spdk_bs_journal_page {
+	uint64_t	epoch;
+	uint32_t	page_idx; /* Index of the page within its half of the journal */
+	uint32_t	num_entries;
+
+	struct spdk_bs_journal_entry	entries[SPDK_BS_JOURNAL_ENTRIES_PER_PAGE];
+
+	uint8_t		reserved[8];
+	uint32_t	crc;
+};
+SPDK_STATIC_ASSERT(sizeof(struct spdk_bs_journal_page) == 0x1000, "Invalid journal page size");
+
 #pragma pack(pop)
 
 struct spdk_bs_dev *bs_create_zeroes_dev(void);
@@ -641,6 +777,17 @@ bs_num_pages_to_cluster_boundary(struct spdk_blob *blob, uint64_t page)
 	return pages_per_cluster - (page % pages_per_cluster);
 }
 
+/* Given an io_unit offset and length, check whether the I/O covers a whole cluster.
+ */
+static inline bool
+bs_io_units_cover_cluster(struct spdk_blob *blob, uint64_t io_unit, uint64_t length)
+{
+	uint32_t	io_units_to_boundary = bs_num_io_units_to_cluster_boundary(blob, io_unit);
+
+	return io_units_to_boundary == bs_io_unit_per_page(blob->bs) * blob->bs->pages_per_cluster &&
+	       length >= io_units_to_boundary;
+}
+
 /* Given an io_unit offset into a blob, look up the number of pages into blob to beginning of current cluster */
 static inline uint32_t
 bs_io_unit_to_cluster_start(struct spdk_blob *blob, uint64_t io_unit)
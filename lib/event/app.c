@@ -75,6 +75,12 @@ static bool g_shutdown_sig_received = false;
 static char *g_executable_name;
 static struct spdk_app_opts g_default_opts;
 
+struct spdk_thread *
+spdk_app_get_thread(void)
+{
+	return g_app_thread;
+}
+
 int
 spdk_app_get_shm_id(void)
 {
@@ -135,6 +141,8 @@ static const struct option g_cmdline_options[] = {
 	{"iova-mode",			required_argument,	NULL, IOVA_MODE_OPT_IDX},
 #define BASE_VIRTADDR_OPT_IDX	265
 	{"base-virtaddr",		required_argument,	NULL, BASE_VIRTADDR_OPT_IDX},
+#define INTERRUPT_MODE_OPT_IDX	266
+	{"interrupt-mode",		no_argument,		NULL, INTERRUPT_MODE_OPT_IDX},
 };
 
 /* Global section */
@@ -665,6 +673,14 @@ spdk_app_start(struct spdk_app_opts *opts, spdk_msg_fn start_fn,
 	spdk_log_open(opts->log);
 	SPDK_NOTICELOG("Total cores available: %d\n", spdk_env_get_core_count());
 
+	if (opts->interrupt_mode) {
+		rc = spdk_interrupt_mode_enable();
+		if (rc != 0) {
+			SPDK_ERRLOG("Unable to enable interrupt mode: %s\n", spdk_strerror(-rc));
+			return 1;
+		}
+	}
+
 	/*
 	 * If mask not specified on command line or in configuration file,
 	 *  reactor_mask will be 0x1 which will enable core 0 to run one
@@ -777,6 +793,7 @@ usage(void (*app_usage)(void))
 	printf("     --silence-noticelog   disable notice level logging to stderr\n");
 	printf(" -u, --no-pci              disable PCI access\n");
 	printf("     --wait-for-rpc        wait for RPCs to initialize subsystems\n");
+	printf("     --interrupt-mode      let idle reactors wait for events instead of polling\n");
 	printf("     --max-delay <num>     maximum reactor delay (in microseconds)\n");
 	printf(" -B, --pci-blacklist <bdf>\n");
 	printf("                           pci addr to blacklist (can be used more than once)\n");
@@ -946,6 +963,9 @@ spdk_app_parse_args(int argc, char **argv, struct spdk_app_opts *opts,
 		case WAIT_FOR_RPC_OPT_IDX:
 			opts->delay_subsystem_init = true;
 			break;
+		case INTERRUPT_MODE_OPT_IDX:
+			opts->interrupt_mode = true;
+			break;
 		case PCI_BLACKLIST_OPT_IDX:
 			if (opts->pci_whitelist) {
 				free(opts->pci_whitelist);
@@ -41,10 +41,13 @@
 #include "spdk/log.h"
 #include "spdk/thread.h"
 #include "spdk/env.h"
+#include "spdk/fd_group.h"
+#include "spdk/string.h"
 #include "spdk/util.h"
 
 #ifdef __linux__
 #include <sys/prctl.h>
+#include <sys/eventfd.h>
 #endif
 
 #ifdef __FreeBSD__
@@ -53,6 +56,12 @@
 
 #define SPDK_EVENT_BATCH_SIZE		8
 
+/* In interrupt mode, keep polling for this long after the last work was done. */
+#define SPDK_REACTOR_INTERRUPT_IDLE_USEC	1000
+
+/* 1s */
+#define SPDK_SCHEDULER_PERIOD_USEC_DEFAULT	1000000
+
 static struct spdk_reactor *g_reactors;
 static struct spdk_cpuset g_reactor_core_mask;
 static enum spdk_reactor_state	g_reactor_state = SPDK_REACTOR_STATE_UNINITIALIZED;
@@ -61,6 +70,23 @@ static bool g_framework_context_switch_monitor_enabled = true;
 
 static struct spdk_mempool *g_spdk_event_mempool = NULL;
 
+static TAILQ_HEAD(, spdk_scheduler) g_scheduler_list = TAILQ_HEAD_INITIALIZER(g_scheduler_list);
+
+/* The static scheduler leaves threads where they were first placed. */
+static struct spdk_scheduler scheduler_static = {
+	.name = "static",
+};
+SPDK_SCHEDULER_REGISTER(scheduler_static);
+
+static struct spdk_scheduler *g_scheduler = &scheduler_static;
+static struct spdk_reactor *g_scheduling_reactor;
+static uint64_t g_scheduler_period_us = SPDK_SCHEDULER_PERIOD_USEC_DEFAULT;
+static uint64_t g_scheduler_period;
+static uint64_t g_scheduler_last_tsc;
+static bool g_scheduling_in_progress;
+static struct spdk_scheduler_core_info *g_core_infos;
+static uint32_t g_core_infos_count;
+
 static void
 reactor_construct(struct spdk_reactor *reactor, uint32_t lcore)
 {
@@ -72,6 +98,90 @@ reactor_construct(struct spdk_reactor *reactor, uint32_t lcore)
 
 	reactor->events = spdk_ring_create(SPDK_RING_TYPE_MP_SC, 65536, SPDK_ENV_SOCKET_ID_ANY);
 	assert(reactor->events != NULL);
+
+	reactor->events_fd = -1;
+}
+
+static int
+reactor_events_fd_drain(void *arg)
+{
+	struct spdk_reactor *reactor = arg;
+	uint64_t val;
+
+	/* The events are run by the reactor loop, it's enough to consume the notification. */
+	if (read(reactor->events_fd, &val, sizeof(val)) < 0 && errno != EAGAIN) {
+		return -errno;
+	}
+
+	return 0;
+}
+
+static void
+reactor_interrupt_fini(struct spdk_reactor *reactor)
+{
+	if (reactor->fgrp == NULL) {
+		return;
+	}
+
+	if (reactor->events_fd >= 0) {
+		spdk_fd_group_remove(reactor->fgrp, reactor->events_fd);
+		close(reactor->events_fd);
+		reactor->events_fd = -1;
+	}
+
+	spdk_fd_group_destroy(reactor->fgrp);
+	reactor->fgrp = NULL;
+}
+
+static int
+reactor_interrupt_init(struct spdk_reactor *reactor)
+{
+#ifdef __linux__
+	int rc;
+
+	rc = spdk_fd_group_create(&reactor->fgrp);
+	if (rc != 0) {
+		return rc;
+	}
+
+	reactor->events_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (reactor->events_fd < 0) {
+		rc = -errno;
+		reactor_interrupt_fini(reactor);
+		return rc;
+	}
+
+	rc = spdk_fd_group_add(reactor->fgrp, reactor->events_fd, reactor_events_fd_drain,
+			       reactor, "events");
+	if (rc != 0) {
+		close(reactor->events_fd);
+		reactor->events_fd = -1;
+		reactor_interrupt_fini(reactor);
+		return rc;
+	}
+
+	return 0;
+#else
+	return -ENOTSUP;
+#endif
+}
+
+/*
+ * Wake up the reactor if it waits for interrupts, or unconditionally if force
+ * is set. Only called in interrupt mode.
+ */
+static void
+reactor_interrupt_notify(struct spdk_reactor *reactor, bool force)
+{
+	uint64_t notify = 1;
+
+	/* Pairs with the barrier in reactor_interrupt_run(). */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (force || __atomic_load_n(&reactor->in_interrupt, __ATOMIC_RELAXED)) {
+		if (write(reactor->events_fd, &notify, sizeof(notify)) < 0) {
+			SPDK_ERRLOG("Failed to notify reactor %u: %s\n", reactor->lcore, spdk_strerror(errno));
+		}
+	}
 }
 
 struct spdk_reactor *
@@ -128,6 +238,15 @@ spdk_reactors_init(void)
 
 	memset(g_reactors, 0, (last_core + 1) * sizeof(struct spdk_reactor));
 
+	g_core_infos = calloc(spdk_env_get_core_count(), sizeof(*g_core_infos));
+	if (g_core_infos == NULL) {
+		SPDK_ERRLOG("Could not allocate scheduler core infos\n");
+		free(g_reactors);
+		g_reactors = NULL;
+		spdk_mempool_free(g_spdk_event_mempool);
+		return -ENOMEM;
+	}
+
 	spdk_thread_lib_init_ext(reactor_thread_op, reactor_thread_op_supported,
 				 sizeof(struct spdk_lw_thread));
 
@@ -137,6 +256,18 @@ spdk_reactors_init(void)
 
 	g_reactor_state = SPDK_REACTOR_STATE_INITIALIZED;
 
+	if (spdk_interrupt_mode_is_enabled()) {
+		SPDK_ENV_FOREACH_CORE(i) {
+			rc = reactor_interrupt_init(&g_reactors[i]);
+			if (rc != 0) {
+				SPDK_ERRLOG("Failed to prepare reactor %u for interrupt mode: %s\n",
+					    i, spdk_strerror(-rc));
+				spdk_reactors_fini();
+				return rc;
+			}
+		}
+	}
+
 	return 0;
 }
 
@@ -156,6 +287,7 @@ spdk_reactors_fini(void)
 		reactor = spdk_reactor_get(i);
 		assert(reactor != NULL);
 		assert(reactor->thread_count == 0);
+		reactor_interrupt_fini(reactor);
 		if (reactor->events != NULL) {
 			spdk_ring_free(reactor->events);
 		}
@@ -163,8 +295,22 @@ spdk_reactors_fini(void)
 
 	spdk_mempool_free(g_spdk_event_mempool);
 
+	for (i = 0; i < spdk_env_get_core_count(); i++) {
+		free(g_core_infos[i].threads);
+	}
+	free(g_core_infos);
+	g_core_infos = NULL;
+	g_core_infos_count = 0;
+	g_scheduling_in_progress = false;
+
+	if (g_scheduler->deinit != NULL) {
+		g_scheduler->deinit();
+	}
+	g_scheduler = &scheduler_static;
+
 	free(g_reactors);
 	g_reactors = NULL;
+	g_reactor_state = SPDK_REACTOR_STATE_UNINITIALIZED;
 }
 
 struct spdk_event *
@@ -207,6 +353,10 @@ spdk_event_call(struct spdk_event *event)
 	if (rc != 1) {
 		assert(false);
 	}
+
+	if (spdk_unlikely(reactor->fgrp != NULL)) {
+		reactor_interrupt_notify(reactor, false);
+	}
 }
 
 static inline uint32_t
@@ -310,6 +460,57 @@ _set_thread_name(const char *thread_name)
 
 static int _reactor_schedule_thread(struct spdk_thread *thread);
 static uint64_t g_rusage_period;
+static uint64_t g_reactor_interrupt_idle_tsc;
+
+static int
+reactor_thread_interrupt(void *arg)
+{
+	/*
+	 * Nothing to do here, the interrupt fd of the thread stays readable until
+	 * the events are consumed by the next spdk_thread_poll() of the thread.
+	 */
+	return 0;
+}
+
+static void
+reactor_add_lw_thread(struct spdk_reactor *reactor, struct spdk_lw_thread *lw_thread)
+{
+	struct spdk_thread *thread = spdk_thread_get_from_ctx(lw_thread);
+	int rc;
+
+	TAILQ_INSERT_TAIL(&reactor->threads, lw_thread, link);
+	reactor->thread_count++;
+
+	if (reactor->fgrp == NULL) {
+		return;
+	}
+
+	rc = spdk_fd_group_add(reactor->fgrp, spdk_thread_get_interrupt_fd(thread),
+			       reactor_thread_interrupt, thread, spdk_thread_get_name(thread));
+	if (rc != 0) {
+		/* The reactor keeps polling while the thread is on it. */
+		SPDK_ERRLOG("Failed to add interrupt fd of thread %s to reactor %u: %s\n",
+			    spdk_thread_get_name(thread), reactor->lcore, spdk_strerror(-rc));
+		return;
+	}
+
+	lw_thread->intr_registered = true;
+}
+
+static void
+reactor_remove_lw_thread(struct spdk_reactor *reactor, struct spdk_lw_thread *lw_thread)
+{
+	struct spdk_thread *thread = spdk_thread_get_from_ctx(lw_thread);
+
+	TAILQ_REMOVE(&reactor->threads, lw_thread, link);
+	assert(reactor->thread_count > 0);
+	reactor->thread_count--;
+
+	if (lw_thread->intr_registered) {
+		spdk_fd_group_remove(reactor->fgrp, spdk_thread_get_interrupt_fd(thread));
+		lw_thread->intr_registered = false;
+	}
+}
 
 static void
 _reactor_run(struct spdk_reactor *reactor)
@@ -319,7 +520,9 @@ _reactor_run(struct spdk_reactor *reactor)
 	uint64_t		now;
 	int			rc;
 
-	event_queue_run_batch(reactor);
+	if (event_queue_run_batch(reactor) > 0) {
+		reactor->last_busy_tsc = reactor->tsc_last;
+	}
 
 	TAILQ_FOREACH_SAFE(lw_thread, &reactor->threads, link, tmp) {
 		thread = spdk_thread_get_from_ctx(lw_thread);
@@ -330,23 +533,20 @@ _reactor_run(struct spdk_reactor *reactor)
 			reactor->idle_tsc += now - reactor->tsc_last;
 		} else if (rc > 0) {
 			reactor->busy_tsc += now - reactor->tsc_last;
+			reactor->last_busy_tsc = now;
 		}
 		reactor->tsc_last = now;
 
 		if (spdk_unlikely(lw_thread->resched)) {
 			lw_thread->resched = false;
-			TAILQ_REMOVE(&reactor->threads, lw_thread, link);
-			assert(reactor->thread_count > 0);
-			reactor->thread_count--;
+			reactor_remove_lw_thread(reactor, lw_thread);
 			_reactor_schedule_thread(thread);
 			continue;
 		}
 
 		if (spdk_unlikely(spdk_thread_is_exited(thread) &&
 				  spdk_thread_is_idle(thread))) {
-			TAILQ_REMOVE(&reactor->threads, lw_thread, link);
-			assert(reactor->thread_count > 0);
-			reactor->thread_count--;
+			reactor_remove_lw_thread(reactor, lw_thread);
 			spdk_thread_destroy(thread);
 			continue;
 		}
@@ -360,6 +560,251 @@ _reactor_run(struct spdk_reactor *reactor)
 	}
 }
 
+static bool
+reactor_scheduler_active(void)
+{
+	return g_scheduler->balance != NULL && g_scheduler_period != 0 && !g_scheduling_in_progress;
+}
+
+/*
+ * Milliseconds until the scheduling reactor has to run the scheduler, or -1 if
+ * the reactor doesn't need to wake up for it.
+ */
+static int
+reactor_scheduler_timeout(struct spdk_reactor *reactor)
+{
+	uint64_t elapsed, timeout;
+
+	if (reactor != g_scheduling_reactor || !reactor_scheduler_active()) {
+		return -1;
+	}
+
+	elapsed = reactor->tsc_last - g_scheduler_last_tsc;
+	if (elapsed >= g_scheduler_period) {
+		return 0;
+	}
+
+	timeout = spdk_divide_round_up((g_scheduler_period - elapsed) * 1000, spdk_get_ticks_hz());
+	return (int)spdk_min(timeout, INT_MAX);
+}
+
+/*
+ * In interrupt mode, wait for events instead of polling once the reactor and
+ * its threads have been idle for a while. As soon as there is work to do again
+ * the reactor goes back to polling. Threads with active pollers need to be
+ * polled, so they keep the reactor in polling mode. The scheduling reactor only
+ * waits until the next scheduler period.
+ */
+static void
+reactor_interrupt_run(struct spdk_reactor *reactor)
+{
+	struct spdk_thread	*thread;
+	struct spdk_lw_thread	*lw_thread;
+	uint64_t		now;
+
+	if (reactor->tsc_last - reactor->last_busy_tsc < g_reactor_interrupt_idle_tsc) {
+		return;
+	}
+
+	TAILQ_FOREACH(lw_thread, &reactor->threads, link) {
+		thread = spdk_thread_get_from_ctx(lw_thread);
+		if (!lw_thread->intr_registered || spdk_thread_has_active_pollers(thread)) {
+			return;
+		}
+	}
+
+	__atomic_store_n(&reactor->in_interrupt, true, __ATOMIC_RELAXED);
+
+	/*
+	 * Pairs with the barrier in reactor_interrupt_notify(): either the sender
+	 * of an event sees in_interrupt set, or we see the event here.
+	 */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (spdk_ring_count(reactor->events) == 0) {
+		TAILQ_FOREACH(lw_thread, &reactor->threads, link) {
+			thread = spdk_thread_get_from_ctx(lw_thread);
+			if (!spdk_thread_arm_interrupt(thread)) {
+				break;
+			}
+		}
+
+		/* The armed threads go back to polling mode at their next poll. */
+		if (lw_thread == NULL) {
+			spdk_fd_group_wait(reactor->fgrp, reactor_scheduler_timeout(reactor));
+		}
+	}
+
+	__atomic_store_n(&reactor->in_interrupt, false, __ATOMIC_RELAXED);
+
+	now = spdk_get_ticks();
+	reactor->idle_tsc += now - reactor->tsc_last;
+	reactor->tsc_last = now;
+}
+
+static struct spdk_scheduler_core_info *
+scheduler_core_info_get(uint32_t lcore)
+{
+	uint32_t i;
+
+	for (i = 0; i < g_core_infos_count; i++) {
+		if (g_core_infos[i].lcore == lcore) {
+			return &g_core_infos[i];
+		}
+	}
+
+	return NULL;
+}
+
+static void
+_reactors_scheduler_fini(void *arg1, void *arg2)
+{
+	g_scheduling_in_progress = false;
+}
+
+static void
+_reactors_scheduler_move_threads(void *arg1, void *arg2)
+{
+	struct spdk_reactor *reactor;
+	struct spdk_scheduler_core_info *core_info;
+	struct spdk_scheduler_thread_info *thread_info;
+	struct spdk_lw_thread *lw_thread;
+	struct spdk_thread *thread;
+	uint64_t thread_id;
+	uint32_t i;
+
+	reactor = spdk_reactor_get(spdk_env_get_current_core());
+	assert(reactor != NULL);
+
+	core_info = scheduler_core_info_get(reactor->lcore);
+	if (core_info == NULL) {
+		return;
+	}
+
+	/*
+	 * Threads created or destroyed since the metrics were gathered are
+	 * matched by id and simply skipped.
+	 */
+	TAILQ_FOREACH(lw_thread, &reactor->threads, link) {
+		thread = spdk_thread_get_from_ctx(lw_thread);
+		if (spdk_thread_is_exited(thread)) {
+			continue;
+		}
+
+		thread_id = spdk_thread_get_id(thread);
+		for (i = 0; i < core_info->threads_count; i++) {
+			thread_info = &core_info->threads[i];
+			if (thread_info->thread_id != thread_id) {
+				continue;
+			}
+
+			if (thread_info->target_lcore != reactor->lcore &&
+			    thread_info->target_lcore <= spdk_env_get_last_core() &&
+			    spdk_cpuset_get_cpu(spdk_thread_get_cpumask(thread), thread_info->target_lcore) &&
+			    spdk_reactor_get(thread_info->target_lcore) != NULL) {
+				SPDK_DEBUGLOG(SPDK_LOG_REACTOR, "Moving thread %s from core %u to core %u\n",
+					      spdk_thread_get_name(thread), reactor->lcore,
+					      thread_info->target_lcore);
+				lw_thread->lcore = thread_info->target_lcore;
+				lw_thread->resched = true;
+			}
+			break;
+		}
+	}
+}
+
+static void
+_reactors_scheduler_balance(void *arg1, void *arg2)
+{
+	if (g_reactor_state != SPDK_REACTOR_STATE_RUNNING || g_scheduler->balance == NULL) {
+		g_scheduling_in_progress = false;
+		return;
+	}
+
+	g_scheduler->balance(g_core_infos, g_core_infos_count);
+
+	spdk_for_each_reactor(_reactors_scheduler_move_threads, NULL, NULL,
+			      _reactors_scheduler_fini);
+}
+
+static void
+_reactors_scheduler_gather_metrics(void *arg1, void *arg2)
+{
+	struct spdk_reactor *reactor;
+	struct spdk_scheduler_core_info *core_info;
+	struct spdk_scheduler_thread_info *thread_info;
+	struct spdk_lw_thread *lw_thread;
+	struct spdk_thread *thread;
+	uint32_t i = 0;
+
+	reactor = spdk_reactor_get(spdk_env_get_current_core());
+	assert(reactor != NULL);
+
+	/* The reactors are visited one after another, so no locking is needed. */
+	assert(g_core_infos_count < spdk_env_get_core_count());
+	core_info = &g_core_infos[g_core_infos_count++];
+
+	core_info->lcore = reactor->lcore;
+	core_info->busy_tsc = reactor->busy_tsc - reactor->sched_busy_tsc;
+	core_info->idle_tsc = reactor->idle_tsc - reactor->sched_idle_tsc;
+	reactor->sched_busy_tsc = reactor->busy_tsc;
+	reactor->sched_idle_tsc = reactor->idle_tsc;
+
+	core_info->threads_count = 0;
+	free(core_info->threads);
+	core_info->threads = NULL;
+
+	if (reactor->thread_count == 0) {
+		return;
+	}
+
+	core_info->threads = calloc(reactor->thread_count, sizeof(*core_info->threads));
+	if (core_info->threads == NULL) {
+		SPDK_ERRLOG("Could not allocate scheduler thread infos for core %u\n", reactor->lcore);
+		return;
+	}
+
+	TAILQ_FOREACH(lw_thread, &reactor->threads, link) {
+		thread = spdk_thread_get_from_ctx(lw_thread);
+
+		assert(i < reactor->thread_count);
+		thread_info = &core_info->threads[i++];
+		thread_info->thread_id = spdk_thread_get_id(thread);
+		thread_info->lcore = reactor->lcore;
+		thread_info->target_lcore = reactor->lcore;
+		thread_info->app_thread = thread == spdk_app_get_thread();
+		spdk_cpuset_copy(&thread_info->cpumask, spdk_thread_get_cpumask(thread));
+		thread_info->stats.busy_tsc = thread->stats.busy_tsc - lw_thread->last_stats.busy_tsc;
+		thread_info->stats.idle_tsc = thread->stats.idle_tsc - lw_thread->last_stats.idle_tsc;
+		lw_thread->last_stats = thread->stats;
+	}
+
+	core_info->threads_count = i;
+}
+
+/*
+ * Called by the master reactor on every iteration. Once per scheduler period,
+ * gather the metrics of all reactors, let the scheduler balance the threads
+ * and move them to their new reactors.
+ */
+static void
+reactor_scheduler_poll(struct spdk_reactor *reactor)
+{
+	if (!reactor_scheduler_active()) {
+		return;
+	}
+
+	if (reactor->tsc_last - g_scheduler_last_tsc < g_scheduler_period) {
+		return;
+	}
+
+	g_scheduling_in_progress = true;
+	g_scheduler_last_tsc = reactor->tsc_last;
+	g_core_infos_count = 0;
+
+	spdk_for_each_reactor(_reactors_scheduler_gather_metrics, NULL, NULL,
+			      _reactors_scheduler_balance);
+}
+
 static int
 reactor_run(void *arg)
 {
@@ -377,6 +822,7 @@ reactor_run(void *arg)
 	_set_thread_name(thread_name);
 
 	reactor->tsc_last = spdk_get_ticks();
+	reactor->last_busy_tsc = reactor->tsc_last;
 
 	while (1) {
 		_reactor_run(reactor);
@@ -384,6 +830,14 @@ reactor_run(void *arg)
 		if (g_reactor_state != SPDK_REACTOR_STATE_RUNNING) {
 			break;
 		}
+
+		if (spdk_unlikely(reactor == g_scheduling_reactor)) {
+			reactor_scheduler_poll(reactor);
+		}
+
+		if (spdk_unlikely(reactor->fgrp != NULL)) {
+			reactor_interrupt_run(reactor);
+		}
 	}
 
 	TAILQ_FOREACH(lw_thread, &reactor->threads, link) {
@@ -397,9 +851,7 @@ reactor_run(void *arg)
 			thread = spdk_thread_get_from_ctx(lw_thread);
 			spdk_set_thread(thread);
 			if (spdk_thread_is_exited(thread)) {
-				TAILQ_REMOVE(&reactor->threads, lw_thread, link);
-				assert(reactor->thread_count > 0);
-				reactor->thread_count--;
+				reactor_remove_lw_thread(reactor, lw_thread);
 				spdk_thread_destroy(thread);
 			} else {
 				spdk_thread_poll(thread, 0, 0);
@@ -443,9 +895,14 @@ spdk_reactors_start(void)
 	char thread_name[32];
 
 	g_rusage_period = (CONTEXT_SWITCH_MONITOR_PERIOD * spdk_get_ticks_hz()) / SPDK_SEC_TO_USEC;
+	g_reactor_interrupt_idle_tsc = (SPDK_REACTOR_INTERRUPT_IDLE_USEC * spdk_get_ticks_hz()) /
+				       SPDK_SEC_TO_USEC;
+	g_scheduler_period = (g_scheduler_period_us * spdk_get_ticks_hz()) / SPDK_SEC_TO_USEC;
+	g_scheduler_last_tsc = spdk_get_ticks();
 	g_reactor_state = SPDK_REACTOR_STATE_RUNNING;
 
 	current_core = spdk_env_get_current_core();
+	g_scheduling_reactor = spdk_reactor_get(current_core);
 	SPDK_ENV_FOREACH_CORE(i) {
 		if (i != current_core) {
 			reactor = spdk_reactor_get(i);
@@ -478,13 +935,104 @@ spdk_reactors_start(void)
 
 	spdk_env_thread_wait_all();
 
+	g_scheduling_reactor = NULL;
 	g_reactor_state = SPDK_REACTOR_STATE_SHUTDOWN;
 }
 
 void
 spdk_reactors_stop(void *arg1)
 {
+	struct spdk_reactor *reactor;
+	uint32_t i;
+
 	g_reactor_state = SPDK_REACTOR_STATE_EXITING;
+
+	if (spdk_interrupt_mode_is_enabled()) {
+		SPDK_ENV_FOREACH_CORE(i) {
+			reactor = spdk_reactor_get(i);
+			assert(reactor != NULL);
+			reactor_interrupt_notify(reactor, true);
+		}
+	}
+}
+
+static struct spdk_scheduler *
+scheduler_find(const char *name)
+{
+	struct spdk_scheduler *scheduler;
+
+	TAILQ_FOREACH(scheduler, &g_scheduler_list, link) {
+		if (strcmp(name, scheduler->name) == 0) {
+			return scheduler;
+		}
+	}
+
+	return NULL;
+}
+
+void
+spdk_scheduler_list_add(struct spdk_scheduler *scheduler)
+{
+	if (scheduler_find(scheduler->name)) {
+		SPDK_ERRLOG("scheduler named '%s' already registered.\n", scheduler->name);
+		assert(false);
+		return;
+	}
+
+	TAILQ_INSERT_TAIL(&g_scheduler_list, scheduler, link);
+}
+
+int
+spdk_scheduler_set(const char *name)
+{
+	struct spdk_scheduler *scheduler;
+	int rc;
+
+	scheduler = scheduler_find(name);
+	if (scheduler == NULL) {
+		SPDK_ERRLOG("Requested scheduler %s is missing\n", name);
+		return -ENOENT;
+	}
+
+	if (scheduler == g_scheduler) {
+		return 0;
+	}
+
+	if (scheduler->init != NULL) {
+		rc = scheduler->init();
+		if (rc != 0) {
+			SPDK_ERRLOG("Could not initialize scheduler %s: %s\n", name, spdk_strerror(-rc));
+			return rc;
+		}
+	}
+
+	if (g_scheduler->deinit != NULL) {
+		g_scheduler->deinit();
+	}
+
+	SPDK_NOTICELOG("Using scheduler %s\n", name);
+	g_scheduler = scheduler;
+
+	return 0;
+}
+
+struct spdk_scheduler *
+spdk_scheduler_get(void)
+{
+	return g_scheduler;
+}
+
+void
+spdk_scheduler_set_period(uint64_t period_us)
+{
+	g_scheduler_period_us = period_us;
+	g_scheduler_period = (period_us * spdk_get_ticks_hz()) / SPDK_SEC_TO_USEC;
+}
+
+uint64_t
+spdk_scheduler_get_period(void)
+{
+	return g_scheduler_period_us;
 }
 
 static pthread_mutex_t g_scheduler_mtx = PTHREAD_MUTEX_INITIALIZER;
@@ -511,8 +1059,7 @@ _schedule_thread(void *arg1, void *arg2)
 	reactor = spdk_reactor_get(current_core);
 	assert(reactor != NULL);
 
-	TAILQ_INSERT_TAIL(&reactor->threads, lw_thread, link);
-	reactor->thread_count++;
+	reactor_add_lw_thread(reactor, lw_thread);
 }
 
 static int
@@ -528,22 +1075,29 @@ _reactor_schedule_thread(struct spdk_thread *thread)
 
 	lw_thread = spdk_thread_get_ctx(thread);
 	assert(lw_thread != NULL);
-	memset(lw_thread, 0, sizeof(*lw_thread));
 
-	pthread_mutex_lock(&g_scheduler_mtx);
-	for (i = 0; i < spdk_env_get_core_count(); i++) {
-		if (g_next_core > spdk_env_get_last_core()) {
-			g_next_core = spdk_env_get_first_core();
-		}
-		core = g_next_core;
-		g_next_core = spdk_env_get_next_core(g_next_core);
+	/* Use the core chosen by the scheduler, if it's still allowed by the cpumask. */
+	core = lw_thread->lcore;
+	lw_thread->lcore = SPDK_ENV_LCORE_ID_ANY;
+	if (core <= spdk_env_get_last_core() && spdk_cpuset_get_cpu(cpumask, core) &&
+	    spdk_reactor_get(core) != NULL) {
+		evt = spdk_event_allocate(core, _schedule_thread, lw_thread, NULL);
+	} else {
+		pthread_mutex_lock(&g_scheduler_mtx);
+		for (i = 0; i < spdk_env_get_core_count(); i++) {
+			if (g_next_core > spdk_env_get_last_core()) {
+				g_next_core = spdk_env_get_first_core();
+			}
+			core = g_next_core;
+			g_next_core = spdk_env_get_next_core(g_next_core);
 
-		if (spdk_cpuset_get_cpu(cpumask, core)) {
-			evt = spdk_event_allocate(core, _schedule_thread, lw_thread, NULL);
-			break;
+			if (spdk_cpuset_get_cpu(cpumask, core)) {
+				evt = spdk_event_allocate(core, _schedule_thread, lw_thread, NULL);
+				break;
+			}
 		}
+		pthread_mutex_unlock(&g_scheduler_mtx);
 	}
-	pthread_mutex_unlock(&g_scheduler_mtx);
 
 	assert(evt != NULL);
 	if (evt == NULL) {
@@ -575,8 +1129,13 @@ _reactor_request_thread_reschedule(struct spdk_thread *thread)
 static int
 reactor_thread_op(struct spdk_thread *thread, enum spdk_thread_op op)
 {
+	struct spdk_lw_thread *lw_thread;
+
 	switch (op) {
 	case SPDK_THREAD_OP_NEW:
+		lw_thread = spdk_thread_get_ctx(thread);
+		memset(lw_thread, 0, sizeof(*lw_thread));
+		lw_thread->lcore = SPDK_ENV_LCORE_ID_ANY;
 		return _reactor_schedule_thread(thread);
 	case SPDK_THREAD_OP_RESCHED:
 		_reactor_request_thread_reschedule(thread);
@@ -0,0 +1,285 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "spdk/stdinc.h"
+
+#include "spdk/env.h"
+
+#include "spdk_internal/event.h"
+
+/* Threads busy for less than this percentage of their time are considered idle. */
+#define SCHEDULER_THREAD_IDLE_PCT	10
+
+/* The consolidating scheduler fills cores up to this percentage of the period. */
+#define SCHEDULER_CORE_LIMIT_PCT	95
+
+/*
+ * The balancing scheduler only moves a busy thread if its core is loaded more
+ * than the least loaded core by this percentage of the period.
+ */
+#define SCHEDULER_HYSTERESIS_PCT	10
+
+struct scheduler_ctx {
+	struct spdk_scheduler_core_info		*cores;
+	uint32_t				cores_count;
+
+	/* Busy TSC of the threads assigned to each core so far */
+	uint64_t				*core_load;
+
+	/* All threads, busiest first */
+	struct spdk_scheduler_thread_info	**threads;
+	uint32_t				threads_count;
+
+	/* Length of the scheduling period in TSC */
+	uint64_t				period;
+};
+
+static int
+thread_info_cmp(const void *a, const void *b)
+{
+	const struct spdk_scheduler_thread_info *ta = *(struct spdk_scheduler_thread_info * const *)a;
+	const struct spdk_scheduler_thread_info *tb = *(struct spdk_scheduler_thread_info * const *)b;
+
+	if (ta->stats.busy_tsc != tb->stats.busy_tsc) {
+		return ta->stats.busy_tsc > tb->stats.busy_tsc ? -1 : 1;
+	}
+
+	/* Keep the order stable between periods. */
+	if (ta->thread_id != tb->thread_id) {
+		return ta->thread_id < tb->thread_id ? -1 : 1;
+	}
+
+	return 0;
+}
+
+static bool
+thread_is_idle(struct spdk_scheduler_thread_info *thread_info)
+{
+	uint64_t total = thread_info->stats.busy_tsc + thread_info->stats.idle_tsc;
+
+	return thread_info->stats.busy_tsc * 100 <= total * SCHEDULER_THREAD_IDLE_PCT;
+}
+
+static bool
+thread_core_allowed(struct scheduler_ctx *ctx, struct spdk_scheduler_thread_info *thread_info,
+		    uint32_t i)
+{
+	return spdk_cpuset_get_cpu(&thread_info->cpumask, ctx->cores[i].lcore);
+}
+
+static uint32_t
+thread_core_index(struct scheduler_ctx *ctx, struct spdk_scheduler_thread_info *thread_info)
+{
+	uint32_t i;
+
+	for (i = 0; i < ctx->cores_count; i++) {
+		if (ctx->cores[i].lcore == thread_info->lcore) {
+			break;
+		}
+	}
+
+	assert(i < ctx->cores_count);
+	return i;
+}
+
+static void
+thread_assign(struct scheduler_ctx *ctx, struct spdk_scheduler_thread_info *thread_info,
+	      uint32_t i)
+{
+	thread_info->target_lcore = ctx->cores[i].lcore;
+	ctx->core_load[i] += thread_info->stats.busy_tsc;
+}
+
+static void
+scheduler_ctx_fini(struct scheduler_ctx *ctx)
+{
+	free(ctx->core_load);
+	free(ctx->threads);
+}
+
+static int
+scheduler_ctx_init(struct scheduler_ctx *ctx, struct spdk_scheduler_core_info *cores,
+		   uint32_t count)
+{
+	uint32_t i, j, n = 0;
+
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->cores = cores;
+	ctx->cores_count = count;
+
+	for (i = 0; i < count; i++) {
+		ctx->period = spdk_max(ctx->period, cores[i].busy_tsc + cores[i].idle_tsc);
+		ctx->threads_count += cores[i].threads_count;
+	}
+
+	if (ctx->period == 0 || ctx->threads_count == 0) {
+		return -EAGAIN;
+	}
+
+	ctx->core_load = calloc(count, sizeof(*ctx->core_load));
+	ctx->threads = calloc(ctx->threads_count, sizeof(*ctx->threads));
+	if (ctx->core_load == NULL || ctx->threads == NULL) {
+		scheduler_ctx_fini(ctx);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < count; i++) {
+		for (j = 0; j < cores[i].threads_count; j++) {
+			ctx->threads[n++] = &cores[i].threads[j];
+		}
+	}
+
+	qsort(ctx->threads, ctx->threads_count, sizeof(*ctx->threads), thread_info_cmp);
+
+	return 0;
+}
+
+/*
+ * Spread busy threads across all allowed cores, busiest first, each to the
+ * least loaded core. Idle threads are packed together on the first core they
+ * are allowed to run on, out of the way of the busy ones. The app thread stays
+ * on its core, but its load is still accounted for.
+ */
+static void
+balance_balanced(struct spdk_scheduler_core_info *cores, uint32_t count)
+{
+	struct scheduler_ctx ctx;
+	struct spdk_scheduler_thread_info *thread_info;
+	uint32_t i, j, cur, target;
+
+	if (scheduler_ctx_init(&ctx, cores, count) != 0) {
+		return;
+	}
+
+	for (i = 0; i < ctx.threads_count; i++) {
+		thread_info = ctx.threads[i];
+		cur = thread_core_index(&ctx, thread_info);
+		target = cur;
+
+		if (thread_info->app_thread) {
+			thread_assign(&ctx, thread_info, cur);
+			continue;
+		}
+
+		if (thread_is_idle(thread_info)) {
+			for (j = 0; j < count; j++) {
+				if (thread_core_allowed(&ctx, thread_info, j)) {
+					target = j;
+					break;
+				}
+			}
+		} else {
+			for (j = 0; j < count; j++) {
+				if (thread_core_allowed(&ctx, thread_info, j) &&
+				    ctx.core_load[j] < ctx.core_load[target]) {
+					target = j;
+				}
+			}
+
+			/* Don't move threads back and forth for small differences. */
+			if (ctx.core_load[cur] - ctx.core_load[target] <=
+			    ctx.period * SCHEDULER_HYSTERESIS_PCT / 100) {
+				target = cur;
+			}
+		}
+
+		thread_assign(&ctx, thread_info, target);
+	}
+
+	scheduler_ctx_fini(&ctx);
+}
+
+static struct spdk_scheduler scheduler_balanced = {
+	.name = "balanced",
+	.balance = balance_balanced,
+};
+SPDK_SCHEDULER_REGISTER(scheduler_balanced);
+
+/*
+ * Pack threads on as few cores as possible, busiest first, each to the first
+ * allowed core that has room for it. The remaining cores are left without
+ * threads, which lets them sleep in interrupt mode. The app thread isn't moved.
+ */
+static void
+balance_consolidate(struct spdk_scheduler_core_info *cores, uint32_t count)
+{
+	struct scheduler_ctx ctx;
+	struct spdk_scheduler_thread_info *thread_info;
+	uint64_t capacity;
+	uint32_t i, j, target;
+
+	if (scheduler_ctx_init(&ctx, cores, count) != 0) {
+		return;
+	}
+
+	capacity = ctx.period * SCHEDULER_CORE_LIMIT_PCT / 100;
+
+	for (i = 0; i < ctx.threads_count; i++) {
+		thread_info = ctx.threads[i];
+		target = count;
+
+		if (thread_info->app_thread) {
+			thread_assign(&ctx, thread_info, thread_core_index(&ctx, thread_info));
+			continue;
+		}
+
+		for (j = 0; j < count; j++) {
+			if (thread_core_allowed(&ctx, thread_info, j) &&
+			    ctx.core_load[j] + thread_info->stats.busy_tsc <= capacity) {
+				target = j;
+				break;
+			}
+		}
+
+		/* No core has room left, fall back to the least loaded one. */
+		if (target == count) {
+			target = thread_core_index(&ctx, thread_info);
+			for (j = 0; j < count; j++) {
+				if (thread_core_allowed(&ctx, thread_info, j) &&
+				    ctx.core_load[j] < ctx.core_load[target]) {
+					target = j;
+				}
+			}
+		}
+
+		thread_assign(&ctx, thread_info, target);
+	}
+
+	scheduler_ctx_fini(&ctx);
+}
+
+static struct spdk_scheduler scheduler_consolidate = {
+	.name = "consolidate",
+	.balance = balance_consolidate,
+};
+SPDK_SCHEDULER_REGISTER(scheduler_consolidate);
@@ -2217,6 +2217,9 @@ nvme_ctrlr_configure_aer(struct spdk_nvme_ctrlr *ctrlr)
 	if (ctrlr->vs.raw >= SPDK_NVME_VERSION(1, 3, 0) && ctrlr->cdata.lpa.telemetry) {
 		config.bits.telemetry_log_notice = 1;
 	}
+	if (ctrlr->cdata.oaes.ana_change_notices) {
+		config.bits.ana_change_notice = 1;
+	}
 
 	nvme_ctrlr_set_state(ctrlr, NVME_CTRLR_STATE_WAIT_FOR_CONFIGURE_AER,
 			     ctrlr->opts.admin_timeout_ms);
@@ -404,6 +404,9 @@ static const struct nvme_string media_error_status[] = {
 
 static const struct nvme_string path_status[] = {
 	{ SPDK_NVME_SC_INTERNAL_PATH_ERROR, "INTERNAL PATH ERROR" },
+	{ SPDK_NVME_SC_ASYMMETRIC_ACCESS_PERSISTENT_LOSS, "ASYMMETRIC ACCESS PERSISTENT LOSS" },
+	{ SPDK_NVME_SC_ASYMMETRIC_ACCESS_INACCESSIBLE, "ASYMMETRIC ACCESS INACCESSIBLE" },
+	{ SPDK_NVME_SC_ASYMMETRIC_ACCESS_TRANSITION, "ASYMMETRIC ACCESS TRANSITION" },
 	{ SPDK_NVME_SC_CONTROLLER_PATH_ERROR, "CONTROLLER PATH ERROR" },
 	{ SPDK_NVME_SC_HOST_PATH_ERROR, "HOST PATH ERROR" },
 	{ SPDK_NVME_SC_ABORTED_BY_HOST, "ABORTED BY HOST" },
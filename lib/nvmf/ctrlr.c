@@ -298,6 +298,7 @@ nvmf_ctrlr_create(struct spdk_nvmf_subsystem *subsystem,
 {
 	struct spdk_nvmf_ctrlr	*ctrlr;
 	struct spdk_nvmf_transport *transport;
+	struct spdk_nvme_transport_id listen_trid = {};
 
 	ctrlr = calloc(1, sizeof(*ctrlr));
 	if (ctrlr == NULL) {
@@ -330,8 +331,14 @@ nvmf_ctrlr_create(struct spdk_nvmf_subsystem *subsystem,
 	}
 
 	ctrlr->feat.async_event_configuration.bits.ns_attr_notice = 1;
+	ctrlr->feat.async_event_configuration.bits.ana_change_notice = subsystem->ana_reporting;
 	ctrlr->feat.volatile_write_cache.bits.wce = 1;
 
+	/* The listen address was already checked in nvmf_qpair_access_allowed() */
+	if (spdk_nvmf_qpair_get_listen_trid(req->qpair, &listen_trid) == 0) {
+		ctrlr->listener = nvmf_subsystem_find_listener(subsystem, &listen_trid);
+	}
+
 	if (ctrlr->subsys->subtype == SPDK_NVMF_SUBTYPE_DISCOVERY) {
 		/*
 		 * If keep-alive timeout is not set, discovery controllers use some
@@ -1503,10 +1510,11 @@ nvmf_ctrlr_async_event_request(struct spdk_nvmf_request *req)
 		return SPDK_NVMF_REQUEST_EXEC_STATUS_COMPLETE;
 	}
 
-	if (ctrlr->notice_event.bits.async_event_type ==
-	    SPDK_NVME_ASYNC_EVENT_TYPE_NOTICE) {
-		rsp->cdw0 = ctrlr->notice_event.raw;
-		ctrlr->notice_event.raw = 0;
+	if (ctrlr->nr_pending_notices > 0) {
+		rsp->cdw0 = ctrlr->pending_notices[0].raw;
+		ctrlr->nr_pending_notices--;
+		memmove(&ctrlr->pending_notices[0], &ctrlr->pending_notices[1],
+			ctrlr->nr_pending_notices * sizeof(ctrlr->pending_notices[0]));
 		return SPDK_NVMF_REQUEST_EXEC_STATUS_COMPLETE;
 	}
 
@@ -1591,6 +1599,75 @@ nvmf_get_changed_ns_list_log_page(struct spdk_nvmf_ctrlr *ctrlr,
 	memset(&ctrlr->changed_ns_list, 0, sizeof(ctrlr->changed_ns_list));
 }
 
+static enum spdk_nvme_ana_state
+nvmf_ctrlr_get_ana_state(struct spdk_nvmf_ctrlr *ctrlr)
+{
+	if (!ctrlr->subsys->ana_reporting) {
+		return SPDK_NVME_ANA_OPTIMIZED_STATE;
+	}
+
+	/* The path is gone once the listener was removed from the subsystem. */
+	if (spdk_unlikely(ctrlr->listener == NULL)) {
+		return SPDK_NVME_ANA_INACCESSIBLE_STATE;
+	}
+
+	return ctrlr->listener->ana_state;
+}
+
+/* Copy the part of src that falls into the requested range of the log page. */
+static void
+nvmf_copy_log_page_chunk(void *data, uint64_t offset, uint32_t length, uint64_t *pos,
+			 const void *src, size_t src_len)
+{
+	uint64_t start, end;
+
+	start = spdk_max(offset, *pos);
+	end = spdk_min(offset + length, *pos + src_len);
+	if (start < end) {
+		memcpy((char *)data + (start - offset), (const char *)src + (start - *pos), end - start);
+	}
+
+	*pos += src_len;
+}
+
+static void
+nvmf_get_ana_log_page(struct spdk_nvmf_ctrlr *ctrlr, void *data, uint64_t offset,
+		      uint32_t length, bool rgo)
+{
+	struct spdk_nvmf_subsystem *subsystem = ctrlr->subsys;
+	struct spdk_nvme_ana_page ana_hdr = {};
+	struct spdk_nvme_ana_group_descriptor ana_desc = {};
+	struct spdk_nvmf_ns *ns;
+	uint64_t change_count = 0;
+	uint64_t pos = 0;
+
+	if (ctrlr->listener != NULL) {
+		change_count = ctrlr->listener->ana_state_change_count;
+	}
+
+	/* Each namespace is reported in its own ANA group, whose ID is the NSID. */
+	for (ns = spdk_nvmf_subsystem_get_first_ns(subsystem); ns != NULL;
+	     ns = spdk_nvmf_subsystem_get_next_ns(subsystem, ns)) {
+		ana_hdr.num_ana_group_desc++;
+	}
+	ana_hdr.change_count = change_count;
+	nvmf_copy_log_page_chunk(data, offset, length, &pos, &ana_hdr, sizeof(ana_hdr));
+
+	ana_desc.num_of_nsid = rgo ? 0 : 1;
+	ana_desc.change_count = change_count;
+	ana_desc.ana_state = nvmf_ctrlr_get_ana_state(ctrlr);
+
+	for (ns = spdk_nvmf_subsystem_get_first_ns(subsystem); ns != NULL;
+	     ns = spdk_nvmf_subsystem_get_next_ns(subsystem, ns)) {
+		ana_desc.ana_group_id = ns->opts.nsid;
+		nvmf_copy_log_page_chunk(data, offset, length, &pos, &ana_desc, sizeof(ana_desc));
+		if (!rgo) {
+			nvmf_copy_log_page_chunk(data, offset, length, &pos, &ns->opts.nsid,
+						 sizeof(ns->opts.nsid));
+		}
+	}
+}
+
 /* The structure can be modified if we provide support for other commands in future */
 static const struct spdk_nvme_cmds_and_effect_log_page g_cmds_and_effect_log_page = {
 	.admin_cmds_supported = {
@@ -1752,6 +1829,14 @@ nvmf_ctrlr_get_log_page(struct spdk_nvmf_request *req)
 		case SPDK_NVME_LOG_CHANGED_NS_LIST:
 			nvmf_get_changed_ns_list_log_page(ctrlr, req->data, offset, len);
 			return SPDK_NVMF_REQUEST_EXEC_STATUS_COMPLETE;
+		case SPDK_NVME_LOG_ASYMMETRIC_NAMESPACE_ACCESS:
+			if (!subsystem->ana_reporting) {
+				goto invalid_log_page;
+			}
+			/* Bit 0 of the log specific field is Return Groups Only */
+			nvmf_get_ana_log_page(ctrlr, req->data, offset, len,
+					      cmd->cdw10_bits.get_log_page.lsp & 0x1);
+			return SPDK_NVMF_REQUEST_EXEC_STATUS_COMPLETE;
 		case SPDK_NVME_LOG_RESERVATION_NOTIFICATION:
 			nvmf_get_reservation_notification_log_page(ctrlr, req->data, offset, len);
 			return SPDK_NVMF_REQUEST_EXEC_STATUS_COMPLETE;
@@ -1799,6 +1884,10 @@ spdk_nvmf_ctrlr_identify_ns(struct spdk_nvmf_ctrlr *ctrlr,
 
 	nvmf_bdev_ctrlr_identify_ns(ns, nsdata, ctrlr->dif_insert_or_strip);
 
+	if (subsystem->ana_reporting) {
+		nsdata->anagrpid = ns->opts.nsid;
+	}
+
 	/* Due to bug in the Linux kernel NVMe driver we have to set noiob no larger than mdts */
 	max_num_blocks = ctrlr->admin_qpair->transport->opts.max_io_size /
 			 (1U << nsdata->lbaf[nsdata->flbas.format].lbads);
@@ -1873,6 +1962,19 @@ spdk_nvmf_ctrlr_identify_ctrlr(struct spdk_nvmf_ctrlr *ctrlr, struct spdk_nvme_c
 		cdata->cmic.multi_host = 1;
 		cdata->oaes.ns_attribute_notices = 1;
 		cdata->ctratt.host_id_exhid_supported = 1;
+		if (subsystem->ana_reporting) {
+			cdata->cmic.ana_reporting = 1;
+			cdata->oaes.ana_change_notices = 1;
+			/* The change state is never reported, so this is only an upper bound */
+			cdata->anatt = 10;
+			cdata->anacap.ana_optimized_state = 1;
+			cdata->anacap.ana_non_optimized_state = 1;
+			cdata->anacap.ana_inaccessible_state = 1;
+			cdata->anacap.no_change_anagrpid = 1;
+			/* One ANA group per namespace, the ANA group ID is the NSID */
+			cdata->anagrpmax = subsystem->max_nsid;
+			cdata->nanagrpid = subsystem->max_nsid;
+		}
 		/* TODO: Concurrent execution of multiple abort commands. */
 		cdata->acl = 0;
 		cdata->aerl = 0;
@@ -2454,6 +2556,29 @@ nvmf_ctrlr_async_event_notification(struct spdk_nvmf_ctrlr *ctrlr,
 	return 0;
 }
 
+/*
+ * Queue a notice until the host submits an AER. A notice already pending isn't
+ * queued again, the host reads the whole log page in response to it anyway.
+ */
+static void
+nvmf_ctrlr_queue_notice(struct spdk_nvmf_ctrlr *ctrlr, union spdk_nvme_async_event_completion *event)
+{
+	uint8_t i;
+
+	for (i = 0; i < ctrlr->nr_pending_notices; i++) {
+		if (ctrlr->pending_notices[i].raw == event->raw) {
+			return;
+		}
+	}
+
+	if (ctrlr->nr_pending_notices == NVMF_MAX_PENDING_NOTICES) {
+		SPDK_ERRLOG("Too many pending notices, dropping notice 0x%x\n", event->raw);
+		return;
+	}
+
+	ctrlr->pending_notices[ctrlr->nr_pending_notices++].raw = event->raw;
+}
+
 int
 nvmf_ctrlr_async_event_ns_notice(struct spdk_nvmf_ctrlr *ctrlr)
 {
@@ -2473,12 +2598,33 @@ nvmf_ctrlr_async_event_ns_notice(struct spdk_nvmf_ctrlr *ctrlr)
 	 * response.
 	 */
 	if (ctrlr->nr_aer_reqs == 0) {
-		if (ctrlr->notice_event.bits.async_event_type ==
-		    SPDK_NVME_ASYNC_EVENT_TYPE_NOTICE) {
-			return 0;
-		}
+		nvmf_ctrlr_queue_notice(ctrlr, &event);
+		return 0;
+	}
 
-		ctrlr->notice_event.raw = event.raw;
+	return nvmf_ctrlr_async_event_notification(ctrlr, &event);
+}
+
+int
+nvmf_ctrlr_async_event_ana_change_notice(struct spdk_nvmf_ctrlr *ctrlr)
+{
+	union spdk_nvme_async_event_completion event = {0};
+
+	/* Users may disable the event notification */
+	if (!ctrlr->feat.async_event_configuration.bits.ana_change_notice) {
+		return 0;
+	}
+
+	event.bits.async_event_type = SPDK_NVME_ASYNC_EVENT_TYPE_NOTICE;
+	event.bits.async_event_info = SPDK_NVME_ASYNC_EVENT_ANA_CHANGE;
+	event.bits.log_page_identifier = SPDK_NVME_LOG_ASYMMETRIC_NAMESPACE_ACCESS;
+
+	/* If there is no outstanding AER request, queue the event.  Then
+	 * if an AER is later submitted, this event can be sent as a
+	 * response.
+	 */
+	if (ctrlr->nr_aer_reqs == 0) {
+		nvmf_ctrlr_queue_notice(ctrlr, &event);
 		return 0;
 	}
 
@@ -2809,6 +2955,7 @@ nvmf_ctrlr_process_io_cmd(struct spdk_nvmf_request *req)
 	struct spdk_nvme_cmd *cmd = &req->cmd->nvme_cmd;
 	struct spdk_nvme_cpl *response = &req->rsp->nvme_cpl;
 	struct spdk_nvmf_subsystem_pg_ns_info *ns_info;
+	enum spdk_nvme_ana_state ana_state;
 
 	/* pre-set response details for this command */
 	response->status.sc = SPDK_NVME_SC_SUCCESS;
@@ -2836,6 +2983,14 @@ nvmf_ctrlr_process_io_cmd(struct spdk_nvmf_request *req)
 		return SPDK_NVMF_REQUEST_EXEC_STATUS_COMPLETE;
 	}
 
+	ana_state = nvmf_ctrlr_get_ana_state(ctrlr);
+	if (spdk_unlikely(ana_state == SPDK_NVME_ANA_INACCESSIBLE_STATE)) {
+		SPDK_DEBUGLOG(SPDK_LOG_NVMF, "nsid %u is inaccessible through this controller\n", nsid);
+		response->status.sct = SPDK_NVME_SCT_PATH;
+		response->status.sc = SPDK_NVME_SC_ASYMMETRIC_ACCESS_INACCESSIBLE;
+		return SPDK_NVMF_REQUEST_EXEC_STATUS_COMPLETE;
+	}
+
 	/* scan-build falsely reporting dereference of null pointer */
 	assert(group != NULL && group->sgroups != NULL);
 	ns_info = &group->sgroups[ctrlr->subsys->id].ns_info[nsid - 1];
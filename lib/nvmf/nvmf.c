@@ -389,6 +389,7 @@ nvmf_write_subsystem_config_json(struct spdk_json_write_ctx *w,
 	uint32_t max_namespaces;
 	char uuid_str[SPDK_UUID_STRING_LEN];
 	const char *adrfam;
+	enum spdk_nvme_ana_state ana_state;
 
 	if (spdk_nvmf_subsystem_get_type(subsystem) != SPDK_NVMF_SUBTYPE_NVME) {
 		return;
@@ -402,6 +403,9 @@ nvmf_write_subsystem_config_json(struct spdk_json_write_ctx *w,
 	spdk_json_write_named_object_begin(w, "params");
 	spdk_json_write_named_string(w, "nqn", spdk_nvmf_subsystem_get_nqn(subsystem));
 	spdk_json_write_named_bool(w, "allow_any_host", spdk_nvmf_subsystem_get_allow_any_host(subsystem));
+	if (spdk_nvmf_subsystem_get_ana_reporting(subsystem)) {
+		spdk_json_write_named_bool(w, "ana_reporting", true);
+	}
 	spdk_json_write_named_string(w, "serial_number", spdk_nvmf_subsystem_get_sn(subsystem));
 	spdk_json_write_named_string(w, "model_number", spdk_nvmf_subsystem_get_mn(subsystem));
 
@@ -448,6 +452,41 @@ nvmf_write_subsystem_config_json(struct spdk_json_write_ctx *w,
 
 		/* } */
 		spdk_json_write_object_end(w);
+
+		ana_state = spdk_nvmf_subsystem_listener_get_ana_state(listener);
+		if (!spdk_nvmf_subsystem_get_ana_reporting(subsystem) ||
+		    ana_state == SPDK_NVME_ANA_OPTIMIZED_STATE) {
+			continue;
+		}
+
+		spdk_json_write_object_begin(w);
+		spdk_json_write_named_string(w, "method", "nvmf_subsystem_listener_set_ana_state");
+
+		/*     "params" : { */
+		spdk_json_write_named_object_begin(w, "params");
+
+		spdk_json_write_named_string(w, "nqn", spdk_nvmf_subsystem_get_nqn(subsystem));
+
+		/*     "listen_address" : { */
+		spdk_json_write_named_object_begin(w, "listen_address");
+
+		spdk_json_write_named_string(w, "trtype", trid->trstring);
+		if (adrfam) {
+			spdk_json_write_named_string(w, "adrfam", adrfam);
+		}
+
+		spdk_json_write_named_string(w, "traddr", trid->traddr);
+		spdk_json_write_named_string(w, "trsvcid", trid->trsvcid);
+		/*     } "listen_address" */
+		spdk_json_write_object_end(w);
+
+		spdk_json_write_named_string(w, "ana_state", nvmf_ana_state_to_str(ana_state));
+
+		/*     } "params" */
+		spdk_json_write_object_end(w);
+
+		/* } */
+		spdk_json_write_object_end(w);
 	}
 
 	for (host = spdk_nvmf_subsystem_get_first_host(subsystem); host != NULL;
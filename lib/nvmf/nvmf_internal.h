@@ -48,6 +48,8 @@
 #include "spdk/thread.h"
 
 #define NVMF_MAX_ASYNC_EVENTS	(4)
+/* Each kind of notice is pending at most once */
+#define NVMF_MAX_PENDING_NOTICES	(4)
 
 enum spdk_nvmf_subsystem_state {
 	SPDK_NVMF_SUBSYSTEM_INACTIVE = 0,
@@ -94,6 +96,8 @@ struct spdk_nvmf_subsystem_listener {
 	void						*cb_arg;
 	struct spdk_nvme_transport_id			*trid;
 	struct spdk_nvmf_transport			*transport;
+	enum spdk_nvme_ana_state			ana_state;
+	uint64_t					ana_state_change_count;
 	TAILQ_ENTRY(spdk_nvmf_subsystem_listener)	link;
 };
 
@@ -205,6 +209,9 @@ struct spdk_nvmf_ctrlr {
 	char				hostnqn[SPDK_NVMF_NQN_MAX_LEN + 1];
 	struct spdk_nvmf_subsystem	*subsys;
 
+	/* Listener the admin queue connected through, NULL once it was removed */
+	struct spdk_nvmf_subsystem_listener	*listener;
+
 	struct spdk_nvmf_ctrlr_data	cdata;
 
 	struct spdk_nvmf_registers	vcprop;
@@ -216,7 +223,9 @@ struct spdk_nvmf_ctrlr {
 	struct spdk_bit_array	*qpair_mask;
 
 	struct spdk_nvmf_request *aer_req[NVMF_MAX_ASYNC_EVENTS];
-	union spdk_nvme_async_event_completion notice_event;
+	/* Notices waiting for an AER, oldest first */
+	union spdk_nvme_async_event_completion pending_notices[NVMF_MAX_PENDING_NOTICES];
+	uint8_t nr_pending_notices;
 	union spdk_nvme_async_event_completion reservation_event;
 	uint8_t nr_aer_reqs;
 	struct spdk_uuid  hostid;
@@ -246,6 +255,7 @@ struct spdk_nvmf_subsystem {
 	uint16_t next_cntlid;
 	bool allow_any_host;
 	bool allow_any_listener;
+	bool ana_reporting;
 
 	struct spdk_nvmf_tgt			*tgt;
 
@@ -327,7 +337,10 @@ struct spdk_nvmf_listener *nvmf_transport_find_listener(
 	struct spdk_nvmf_transport *transport,
 	const struct spdk_nvme_transport_id *trid);
 
+const char *nvmf_ana_state_to_str(enum spdk_nvme_ana_state ana_state);
+
 int nvmf_ctrlr_async_event_ns_notice(struct spdk_nvmf_ctrlr *ctrlr);
+int nvmf_ctrlr_async_event_ana_change_notice(struct spdk_nvmf_ctrlr *ctrlr);
 void nvmf_ctrlr_async_event_reservation_notification(struct spdk_nvmf_ctrlr *ctrlr);
 void nvmf_ns_reservation_request(void *ctx);
 void nvmf_ctrlr_reservation_notice_log(struct spdk_nvmf_ctrlr *ctrlr,
@@ -228,12 +228,18 @@ dump_nvmf_subsystem(struct spdk_json_write_ctx *w, struct spdk_nvmf_subsystem *s
 		spdk_json_write_named_string(w, "adrfam", adrfam);
 		spdk_json_write_named_string(w, "traddr", trid->traddr);
 		spdk_json_write_named_string(w, "trsvcid", trid->trsvcid);
+		if (spdk_nvmf_subsystem_get_ana_reporting(subsystem)) {
+			spdk_json_write_named_string(w, "ana_state",
+						     nvmf_ana_state_to_str(spdk_nvmf_subsystem_listener_get_ana_state(listener)));
+		}
 		spdk_json_write_object_end(w);
 	}
 	spdk_json_write_array_end(w);
 
 	spdk_json_write_named_bool(w, "allow_any_host",
 				   spdk_nvmf_subsystem_get_allow_any_host(subsystem));
+	spdk_json_write_named_bool(w, "ana_reporting",
+				   spdk_nvmf_subsystem_get_ana_reporting(subsystem));
 
 	spdk_json_write_named_array_begin(w, "hosts");
 
@@ -343,6 +349,7 @@ struct rpc_subsystem_create {
 	char *tgt_name;
 	uint32_t max_namespaces;
 	bool allow_any_host;
+	bool ana_reporting;
 };
 
 static const struct spdk_json_object_decoder rpc_subsystem_create_decoders[] = {
@@ -352,6 +359,7 @@ static const struct spdk_json_object_decoder rpc_subsystem_create_decoders[] = {
 	{"tgt_name", offsetof(struct rpc_subsystem_create, tgt_name), spdk_json_decode_string, true},
 	{"max_namespaces", offsetof(struct rpc_subsystem_create, max_namespaces), spdk_json_decode_uint32, true},
 	{"allow_any_host", offsetof(struct rpc_subsystem_create, allow_any_host), spdk_json_decode_bool, true},
+	{"ana_reporting", offsetof(struct rpc_subsystem_create, ana_reporting), spdk_json_decode_bool, true},
 };
 
 static void
@@ -433,6 +441,7 @@ rpc_nvmf_create_subsystem(struct spdk_jsonrpc_request *request,
 	}
 
 	spdk_nvmf_subsystem_set_allow_any_host(subsystem, req->allow_any_host);
+	spdk_nvmf_subsystem_set_ana_reporting(subsystem, req->ana_reporting);
 
 	rc = spdk_nvmf_subsystem_start(subsystem,
 				       rpc_nvmf_subsystem_started,
@@ -867,6 +876,125 @@ rpc_nvmf_subsystem_remove_listener(struct spdk_jsonrpc_request *request,
 SPDK_RPC_REGISTER("nvmf_subsystem_remove_listener", rpc_nvmf_subsystem_remove_listener,
 		  SPDK_RPC_RUNTIME);
 
+struct nvmf_rpc_set_ana_state_ctx {
+	char				*nqn;
+	char				*tgt_name;
+	struct rpc_listen_address	address;
+	enum spdk_nvme_ana_state	ana_state;
+
+	struct spdk_jsonrpc_request	*request;
+};
+
+static int
+rpc_decode_ana_state(const struct spdk_json_val *val, void *out)
+{
+	enum spdk_nvme_ana_state *ana_state = out;
+
+	if (spdk_json_strequal(val, "optimized") == true) {
+		*ana_state = SPDK_NVME_ANA_OPTIMIZED_STATE;
+	} else if (spdk_json_strequal(val, "non_optimized") == true) {
+		*ana_state = SPDK_NVME_ANA_NON_OPTIMIZED_STATE;
+	} else if (spdk_json_strequal(val, "inaccessible") == true) {
+		*ana_state = SPDK_NVME_ANA_INACCESSIBLE_STATE;
+	} else {
+		SPDK_ERRLOG("Invalid ANA state\n");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static const struct spdk_json_object_decoder nvmf_rpc_set_ana_state_decoder[] = {
+	{"nqn", offsetof(struct nvmf_rpc_set_ana_state_ctx, nqn), spdk_json_decode_string},
+	{"listen_address", offsetof(struct nvmf_rpc_set_ana_state_ctx, address), decode_rpc_listen_address},
+	{"ana_state", offsetof(struct nvmf_rpc_set_ana_state_ctx, ana_state), rpc_decode_ana_state},
+	{"tgt_name", offsetof(struct nvmf_rpc_set_ana_state_ctx, tgt_name), spdk_json_decode_string, true},
+};
+
+static void
+nvmf_rpc_set_ana_state_ctx_free(struct nvmf_rpc_set_ana_state_ctx *ctx)
+{
+	free(ctx->nqn);
+	free(ctx->tgt_name);
+	free_rpc_listen_address(&ctx->address);
+	free(ctx);
+}
+
+static void
+nvmf_rpc_set_ana_state_done(void *cb_arg, int status)
+{
+	struct nvmf_rpc_set_ana_state_ctx *ctx = cb_arg;
+	struct spdk_jsonrpc_request *request = ctx->request;
+	struct spdk_json_write_ctx *w;
+
+	nvmf_rpc_set_ana_state_ctx_free(ctx);
+
+	if (status != 0) {
+		spdk_jsonrpc_send_error_response(request, status, spdk_strerror(-status));
+		return;
+	}
+
+	w = spdk_jsonrpc_begin_result(request);
+	spdk_json_write_bool(w, true);
+	spdk_jsonrpc_end_result(request, w);
+}
+
+static void
+rpc_nvmf_subsystem_listener_set_ana_state(struct spdk_jsonrpc_request *request,
+		const struct spdk_json_val *params)
+{
+	struct nvmf_rpc_set_ana_state_ctx *ctx;
+	struct spdk_nvmf_subsystem *subsystem;
+	struct spdk_nvmf_tgt *tgt;
+	struct spdk_nvme_transport_id trid;
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (!ctx) {
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INTERNAL_ERROR, "Out of memory");
+		return;
+	}
+
+	ctx->request = request;
+
+	if (spdk_json_decode_object(params, nvmf_rpc_set_ana_state_decoder,
+				    SPDK_COUNTOF(nvmf_rpc_set_ana_state_decoder),
+				    ctx)) {
+		SPDK_ERRLOG("spdk_json_decode_object failed\n");
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS, "Invalid parameters");
+		nvmf_rpc_set_ana_state_ctx_free(ctx);
+		return;
+	}
+
+	tgt = spdk_nvmf_get_tgt(ctx->tgt_name);
+	if (!tgt) {
+		SPDK_ERRLOG("Unable to find a target object.\n");
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INTERNAL_ERROR,
+						 "Unable to find a target.");
+		nvmf_rpc_set_ana_state_ctx_free(ctx);
+		return;
+	}
+
+	subsystem = spdk_nvmf_tgt_find_subsystem(tgt, ctx->nqn);
+	if (!subsystem) {
+		SPDK_ERRLOG("Unable to find subsystem with NQN %s\n", ctx->nqn);
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS, "Invalid parameters");
+		nvmf_rpc_set_ana_state_ctx_free(ctx);
+		return;
+	}
+
+	if (rpc_listen_address_to_trid(&ctx->address, &trid)) {
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS,
+						 "Invalid parameters");
+		nvmf_rpc_set_ana_state_ctx_free(ctx);
+		return;
+	}
+
+	spdk_nvmf_subsystem_set_ana_state(subsystem, &trid, ctx->ana_state,
+					  nvmf_rpc_set_ana_state_done, ctx);
+}
+SPDK_RPC_REGISTER("nvmf_subsystem_listener_set_ana_state",
+		  rpc_nvmf_subsystem_listener_set_ana_state, SPDK_RPC_RUNTIME);
+
 struct spdk_nvmf_ns_params {
 	char *bdev_name;
 	char *ptpl_file;
@@ -317,6 +317,7 @@ _nvmf_subsystem_remove_listener(struct spdk_nvmf_subsystem *subsystem,
 				bool stop)
 {
 	struct spdk_nvmf_transport *transport;
+	struct spdk_nvmf_ctrlr *ctrlr;
 
 	if (stop) {
 		transport = spdk_nvmf_tgt_get_transport(subsystem->tgt, listener->trid->trstring);
@@ -325,6 +326,12 @@ _nvmf_subsystem_remove_listener(struct spdk_nvmf_subsystem *subsystem,
 		}
 	}
 
+	TAILQ_FOREACH(ctrlr, &subsystem->ctrlrs, link) {
+		if (ctrlr->listener == listener) {
+			ctrlr->listener = NULL;
+		}
+	}
+
 	TAILQ_REMOVE(&subsystem->listeners, listener, link);
 	free(listener);
 }
@@ -817,6 +824,7 @@ spdk_nvmf_subsystem_add_listener(struct spdk_nvmf_subsystem *subsystem,
 	listener->cb_fn = cb_fn;
 	listener->cb_arg = cb_arg;
 	listener->subsystem = subsystem;
+	listener->ana_state = SPDK_NVME_ANA_OPTIMIZED_STATE;
 
 	if (transport->ops->listen_associate != NULL) {
 		transport->ops->listen_associate(transport, subsystem, trid,
@@ -910,6 +918,153 @@ spdk_nvmf_subsytem_any_listener_allowed(struct spdk_nvmf_subsystem *subsystem)
 	return subsystem->allow_any_listener;
 }
 
+int
+spdk_nvmf_subsystem_set_ana_reporting(struct spdk_nvmf_subsystem *subsystem,
+				      bool ana_reporting)
+{
+	if (subsystem->state != SPDK_NVMF_SUBSYSTEM_INACTIVE) {
+		return -EAGAIN;
+	}
+
+	subsystem->ana_reporting = ana_reporting;
+
+	return 0;
+}
+
+bool
+spdk_nvmf_subsystem_get_ana_reporting(const struct spdk_nvmf_subsystem *subsystem)
+{
+	return subsystem->ana_reporting;
+}
+
+enum spdk_nvme_ana_state
+spdk_nvmf_subsystem_listener_get_ana_state(struct spdk_nvmf_subsystem_listener *listener)
+{
+	return listener->ana_state;
+}
+
+const char *
+nvmf_ana_state_to_str(enum spdk_nvme_ana_state ana_state)
+{
+	switch (ana_state) {
+	case SPDK_NVME_ANA_OPTIMIZED_STATE:
+		return "optimized";
+	case SPDK_NVME_ANA_NON_OPTIMIZED_STATE:
+		return "non_optimized";
+	case SPDK_NVME_ANA_INACCESSIBLE_STATE:
+		return "inaccessible";
+	case SPDK_NVME_ANA_PERSISTENT_LOSS_STATE:
+		return "persistent_loss";
+	case SPDK_NVME_ANA_CHANGE_STATE:
+		return "change";
+	default:
+		return NULL;
+	}
+}
+
+struct subsystem_set_ana_state_ctx {
+	struct spdk_nvmf_subsystem		*subsystem;
+	struct spdk_nvmf_subsystem_listener	*listener;
+
+	spdk_nvmf_subsystem_set_ana_state_done_fn cb_fn;
+	void					*cb_arg;
+};
+
+static void
+subsystem_set_ana_state_done(struct spdk_io_channel_iter *i, int status)
+{
+	struct subsystem_set_ana_state_ctx *ctx = spdk_io_channel_iter_get_ctx(i);
+
+	if (ctx->cb_fn) {
+		ctx->cb_fn(ctx->cb_arg, status);
+	}
+	free(ctx);
+}
+
+static void
+subsystem_set_ana_state_on_pg(struct spdk_io_channel_iter *i)
+{
+	struct subsystem_set_ana_state_ctx *ctx;
+	struct spdk_nvmf_poll_group *group;
+	struct spdk_nvmf_ctrlr *ctrlr;
+
+	ctx = spdk_io_channel_iter_get_ctx(i);
+	group = spdk_io_channel_get_ctx(spdk_io_channel_iter_get_channel(i));
+
+	TAILQ_FOREACH(ctrlr, &ctx->subsystem->ctrlrs, link) {
+		if (ctrlr->admin_qpair->group == group && ctrlr->listener == ctx->listener) {
+			nvmf_ctrlr_async_event_ana_change_notice(ctrlr);
+		}
+	}
+
+	spdk_for_each_channel_continue(i, 0);
+}
+
+void
+spdk_nvmf_subsystem_set_ana_state(struct spdk_nvmf_subsystem *subsystem,
+				  const struct spdk_nvme_transport_id *trid,
+				  enum spdk_nvme_ana_state ana_state,
+				  spdk_nvmf_subsystem_set_ana_state_done_fn cb_fn, void *cb_arg)
+{
+	struct spdk_nvmf_subsystem_listener *listener;
+	struct subsystem_set_ana_state_ctx *ctx;
+	int rc = 0;
+
+	if (!subsystem->ana_reporting) {
+		SPDK_ERRLOG("ANA reporting is disabled on subsystem %s\n", subsystem->subnqn);
+		rc = -EINVAL;
+		goto done;
+	}
+
+	switch (ana_state) {
+	case SPDK_NVME_ANA_OPTIMIZED_STATE:
+	case SPDK_NVME_ANA_NON_OPTIMIZED_STATE:
+	case SPDK_NVME_ANA_INACCESSIBLE_STATE:
+		break;
+	default:
+		SPDK_ERRLOG("ANA state %d is not supported\n", ana_state);
+		rc = -EINVAL;
+		goto done;
+	}
+
+	listener = nvmf_subsystem_find_listener(subsystem, trid);
+	if (listener == NULL) {
+		SPDK_ERRLOG("Unable to find listener %s on subsystem %s\n", trid->traddr,
+			    subsystem->subnqn);
+		rc = -EINVAL;
+		goto done;
+	}
+
+	if (listener->ana_state == ana_state) {
+		goto done;
+	}
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (ctx == NULL) {
+		rc = -ENOMEM;
+		goto done;
+	}
+
+	ctx->subsystem = subsystem;
+	ctx->listener = listener;
+	ctx->cb_fn = cb_fn;
+	ctx->cb_arg = cb_arg;
+
+	listener->ana_state = ana_state;
+	listener->ana_state_change_count++;
+
+	spdk_for_each_channel(subsystem->tgt,
+			      subsystem_set_ana_state_on_pg,
+			      ctx,
+			      subsystem_set_ana_state_done);
+	return;
+
+done:
+	if (cb_fn) {
+		cb_fn(cb_arg, rc);
+	}
+}
+
 
 struct subsystem_update_ns_ctx {
 	struct spdk_nvmf_subsystem *subsystem;
@@ -34,6 +34,7 @@
 #include "spdk/stdinc.h"
 
 #include "spdk/env.h"
+#include "spdk/fd_group.h"
 #include "spdk/likely.h"
 #include "spdk/queue.h"
 #include "spdk/string.h"
@@ -43,6 +44,11 @@
 #include "spdk_internal/log.h"
 #include "spdk_internal/thread.h"
 
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#endif
+
 #define SPDK_MSG_BATCH_SIZE		8
 #define SPDK_MAX_DEVICE_NAME_LEN	256
 #define SPDK_THREAD_EXIT_TIMEOUT_SEC	5
@@ -59,6 +65,14 @@ static size_t g_ctx_sz = 0;
  */
 static uint64_t g_thread_id = 1;
 
+static bool g_interrupt_mode = false;
+
+struct spdk_interrupt {
+	int			efd;
+	struct spdk_thread	*thread;
+	char			name[SPDK_MAX_POLLER_NAME_LEN + 1];
+};
+
 struct io_device {
 	void				*io_device;
 	char				name[SPDK_MAX_DEVICE_NAME_LEN + 1];
@@ -85,6 +99,8 @@ struct spdk_msg {
 };
 
 #define SPDK_MSG_MEMPOOL_CACHE_SIZE	1024
+/* Number of messages taken from the mempool at once when a thread's cache runs empty. */
+#define SPDK_MSG_CACHE_REFILL_SIZE	64
 static struct spdk_mempool *g_spdk_msg_mempool = NULL;
 
 static TAILQ_HEAD(, spdk_thread) g_threads = TAILQ_HEAD_INITIALIZER(g_threads);
@@ -176,6 +192,134 @@ spdk_thread_lib_fini(void)
 	g_thread_op_fn = NULL;
 	g_thread_op_supported_fn = NULL;
 	g_ctx_sz = 0;
+	g_interrupt_mode = false;
+}
+
+int
+spdk_interrupt_mode_enable(void)
+{
+#ifdef __linux__
+	if (g_spdk_msg_mempool) {
+		SPDK_ERRLOG("Interrupt mode must be enabled before the thread library is initialized\n");
+		return -EBUSY;
+	}
+
+	SPDK_NOTICELOG("Set SPDK running in interrupt mode.\n");
+	g_interrupt_mode = true;
+	return 0;
+#else
+	SPDK_ERRLOG("SPDK interrupt mode supports only Linux platform now.\n");
+	return -ENOTSUP;
+#endif
+}
+
+bool
+spdk_interrupt_mode_is_enabled(void)
+{
+	return g_interrupt_mode;
+}
+
+static int
+thread_interrupt_fd_drain(void *arg)
+{
+	int *fd = arg;
+	uint64_t val;
+
+	/*
+	 * The messages and timed pollers are processed by spdk_thread_poll(), it's
+	 * enough to consume the event here.
+	 */
+	if (read(*fd, &val, sizeof(val)) < 0 && errno != EAGAIN) {
+		return -errno;
+	}
+
+	return 0;
+}
+
+static void
+thread_interrupt_destroy(struct spdk_thread *thread)
+{
+	if (thread->fgrp == NULL) {
+		return;
+	}
+
+	if (thread->msg_fd >= 0) {
+		spdk_fd_group_remove(thread->fgrp, thread->msg_fd);
+		close(thread->msg_fd);
+	}
+	if (thread->timer_fd >= 0) {
+		spdk_fd_group_remove(thread->fgrp, thread->timer_fd);
+		close(thread->timer_fd);
+	}
+
+	spdk_fd_group_destroy(thread->fgrp);
+	thread->fgrp = NULL;
+}
+
+static int
+thread_interrupt_create(struct spdk_thread *thread)
+{
+#ifdef __linux__
+	int rc;
+
+	rc = spdk_fd_group_create(&thread->fgrp);
+	if (rc != 0) {
+		return rc;
+	}
+
+	thread->msg_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (thread->msg_fd < 0) {
+		rc = -errno;
+		goto err;
+	}
+
+	rc = spdk_fd_group_add(thread->fgrp, thread->msg_fd, thread_interrupt_fd_drain,
+			       &thread->msg_fd, "msg");
+	if (rc != 0) {
+		close(thread->msg_fd);
+		thread->msg_fd = -1;
+		goto err;
+	}
+
+	thread->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (thread->timer_fd < 0) {
+		rc = -errno;
+		goto err;
+	}
+
+	rc = spdk_fd_group_add(thread->fgrp, thread->timer_fd, thread_interrupt_fd_drain,
+			       &thread->timer_fd, "timer");
+	if (rc != 0) {
+		close(thread->timer_fd);
+		thread->timer_fd = -1;
+		goto err;
+	}
+
+	return 0;
+err:
+	thread_interrupt_destroy(thread);
+	return rc;
+#else
+	return -ENOTSUP;
+#endif
+}
+
+/*
+ * Wake up the thread if it waits on its interrupt fd. Only called in interrupt
+ * mode. It may be called from a signal handler, so it must not log anything.
+ */
+static void
+thread_interrupt_notify(const struct spdk_thread *thread)
+{
+	uint64_t notify = 1;
+	ssize_t rc __attribute__((unused));
+
+	/* Order the enqueue of the message before the check of intr_armed. It pairs
+	 * with the barrier in spdk_thread_arm_interrupt(). */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(&thread->intr_armed, __ATOMIC_RELAXED)) {
+		rc = write(thread->msg_fd, &notify, sizeof(notify));
+	}
 }
 
 static void
@@ -184,6 +328,7 @@ _free_thread(struct spdk_thread *thread)
 	struct spdk_io_channel *ch;
 	struct spdk_msg *msg;
 	struct spdk_poller *poller, *ptmp;
+	uint32_t i;
 
 	TAILQ_FOREACH(ch, &thread->io_channels, tailq) {
 		SPDK_ERRLOG("thread %s still has channel for io_device %s\n",
@@ -199,14 +344,15 @@ _free_thread(struct spdk_thread *thread)
 		free(poller);
 	}
 
-	TAILQ_FOREACH_SAFE(poller, &thread->timed_pollers, tailq, ptmp) {
+	for (i = 0; i < thread->timed_pollers_count; i++) {
+		poller = thread->timed_pollers[i];
 		if (poller->state != SPDK_POLLER_STATE_UNREGISTERED) {
 			SPDK_WARNLOG("poller %s still registered at thread exit\n",
 				     poller->name);
 		}
-		TAILQ_REMOVE(&thread->timed_pollers, poller, tailq);
 		free(poller);
 	}
+	free(thread->timed_pollers);
 
 	TAILQ_FOREACH_SAFE(poller, &thread->paused_pollers, tailq, ptmp) {
 		SPDK_WARNLOG("poller %s still registered at thread exit\n", poller->name);
@@ -233,6 +379,7 @@ _free_thread(struct spdk_thread *thread)
 
 	assert(thread->msg_cache_count == 0);
 
+	thread_interrupt_destroy(thread);
 	spdk_ring_free(thread->messages);
 	free(thread);
 }
@@ -258,10 +405,11 @@ spdk_thread_create(const char *name, struct spdk_cpuset *cpumask)
 
 	TAILQ_INIT(&thread->io_channels);
 	TAILQ_INIT(&thread->active_pollers);
-	TAILQ_INIT(&thread->timed_pollers);
 	TAILQ_INIT(&thread->paused_pollers);
 	SLIST_INIT(&thread->msg_cache);
 	thread->msg_cache_count = 0;
+	thread->msg_fd = -1;
+	thread->timer_fd = -1;
 
 	thread->tsc_last = spdk_get_ticks();
 
@@ -304,6 +452,16 @@ spdk_thread_create(const char *name, struct spdk_cpuset *cpumask)
 	SPDK_DEBUGLOG(SPDK_LOG_THREAD, "Allocating new thread (%" PRIu64 ", %s)\n",
 		      thread->id, thread->name);
 
+	if (g_interrupt_mode) {
+		rc = thread_interrupt_create(thread);
+		if (rc != 0) {
+			SPDK_ERRLOG("Unable to create interrupt fds for thread %s: %s\n",
+				    thread->name, spdk_strerror(-rc));
+			_free_thread(thread);
+			return NULL;
+		}
+	}
+
 	if (g_new_thread_fn) {
 		rc = g_new_thread_fn(thread);
 	} else if (g_thread_op_supported_fn && g_thread_op_supported_fn(SPDK_THREAD_OP_NEW)) {
@@ -331,6 +489,7 @@ thread_exit(struct spdk_thread *thread, uint64_t now)
 {
 	struct spdk_poller *poller;
 	struct spdk_io_channel *ch;
+	uint32_t i;
 
 	if (now >= thread->exit_timeout_tsc) {
 		SPDK_ERRLOG("thread %s got timeout, and move it to the exited state forcefully\n",
@@ -347,7 +506,8 @@ thread_exit(struct spdk_thread *thread, uint64_t now)
 		}
 	}
 
-	TAILQ_FOREACH(poller, &thread->timed_pollers, tailq) {
+	for (i = 0; i < thread->timed_pollers_count; i++) {
+		poller = thread->timed_pollers[i];
 		if (poller->state != SPDK_POLLER_STATE_UNREGISTERED) {
 			SPDK_INFOLOG(SPDK_LOG_THREAD,
 				     "thread %s still has active timed poller %s\n",
@@ -370,6 +530,13 @@ thread_exit(struct spdk_thread *thread, uint64_t now)
 		return;
 	}
 
+	if (thread->num_interrupts > 0) {
+		SPDK_INFOLOG(SPDK_LOG_THREAD,
+			     "thread %s still has %u registered interrupts\n",
+			     thread->name, thread->num_interrupts);
+		return;
+	}
+
 exited:
 	thread->state = SPDK_THREAD_STATE_EXITED;
 }
@@ -472,6 +639,80 @@ spdk_thread_get_from_ctx(void *ctx)
 	return SPDK_CONTAINEROF(ctx, struct spdk_thread, ctx);
 }
 
+static void
+thread_msg_cache_refill(struct spdk_thread *thread)
+{
+	struct spdk_msg *msgs[SPDK_MSG_CACHE_REFILL_SIZE];
+	uint32_t i;
+
+	if (thread->msg_cache_count + SPDK_MSG_CACHE_REFILL_SIZE > SPDK_MSG_MEMPOOL_CACHE_SIZE) {
+		return;
+	}
+
+	if (spdk_mempool_get_bulk(g_spdk_msg_mempool, (void **)msgs, SPDK_MSG_CACHE_REFILL_SIZE) != 0) {
+		return;
+	}
+
+	for (i = 0; i < SPDK_MSG_CACHE_REFILL_SIZE; i++) {
+		SLIST_INSERT_HEAD(&thread->msg_cache, msgs[i], link);
+	}
+	thread->msg_cache_count += SPDK_MSG_CACHE_REFILL_SIZE;
+}
+
+/*
+ * Return messages to the message cache of the thread, or to the mempool once
+ * the cache is full. thread is NULL for non-SPDK threads.
+ */
+static void
+thread_msgs_put(struct spdk_thread *thread, struct spdk_msg **msgs, uint32_t count)
+{
+	uint32_t i = 0;
+
+	if (thread != NULL) {
+		/* Insert the messages at the head. We want to re-use the hot ones. */
+		for (; i < count && thread->msg_cache_count < SPDK_MSG_MEMPOOL_CACHE_SIZE; i++) {
+			SLIST_INSERT_HEAD(&thread->msg_cache, msgs[i], link);
+			thread->msg_cache_count++;
+		}
+	}
+
+	if (i < count) {
+		spdk_mempool_put_bulk(g_spdk_msg_mempool, (void **)&msgs[i], count - i);
+	}
+}
+
+/*
+ * Get messages from the message cache of the thread, refilling the cache from
+ * the mempool in bulk when it runs empty. thread is NULL for non-SPDK threads,
+ * which get the messages from the mempool directly.
+ */
+static int
+thread_msgs_get(struct spdk_thread *thread, struct spdk_msg **msgs, uint32_t count)
+{
+	uint32_t i = 0;
+
+	if (thread != NULL) {
+		if (spdk_unlikely(thread->msg_cache_count < count)) {
+			thread_msg_cache_refill(thread);
+		}
+
+		for (; i < count && thread->msg_cache_count > 0; i++) {
+			msgs[i] = SLIST_FIRST(&thread->msg_cache);
+			assert(msgs[i] != NULL);
+			SLIST_REMOVE_HEAD(&thread->msg_cache, link);
+			thread->msg_cache_count--;
+		}
+	}
+
+	if (i < count &&
+	    spdk_mempool_get_bulk(g_spdk_msg_mempool, (void **)&msgs[i], count - i) != 0) {
+		thread_msgs_put(thread, msgs, i);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
 static inline uint32_t
 msg_queue_run_batch(struct spdk_thread *thread, uint32_t max_msgs)
 {
@@ -503,40 +744,153 @@ msg_queue_run_batch(struct spdk_thread *thread, uint32_t max_msgs)
 
 		assert(msg != NULL);
 		msg->fn(msg->arg);
+	}
 
-		if (thread->msg_cache_count < SPDK_MSG_MEMPOOL_CACHE_SIZE) {
-			/* Insert the messages at the head. We want to re-use the hot
-			 * ones. */
-			SLIST_INSERT_HEAD(&thread->msg_cache, msg, link);
-			thread->msg_cache_count++;
-		} else {
-			spdk_mempool_put(g_spdk_msg_mempool, msg);
+	thread_msgs_put(thread, (struct spdk_msg **)messages, count);
+
+	return count;
+}
+
+/*
+ * Timed pollers are kept in a binary min-heap. Pollers with the same next run
+ * time run in the order they were (re)inserted.
+ */
+static inline bool
+timed_poller_before(const struct spdk_poller *a, const struct spdk_poller *b)
+{
+	if (a->next_run_tick != b->next_run_tick) {
+		return a->next_run_tick < b->next_run_tick;
+	}
+
+	return a->timer_seq < b->timer_seq;
+}
+
+static inline void
+timed_poller_set(struct spdk_thread *thread, uint32_t index, struct spdk_poller *poller)
+{
+	thread->timed_pollers[index] = poller;
+	poller->timer_index = index;
+}
+
+static void
+timed_pollers_sift_up(struct spdk_thread *thread, uint32_t index)
+{
+	struct spdk_poller *poller = thread->timed_pollers[index];
+	uint32_t parent;
+
+	while (index > 0) {
+		parent = (index - 1) / 2;
+		if (!timed_poller_before(poller, thread->timed_pollers[parent])) {
+			break;
 		}
+		timed_poller_set(thread, index, thread->timed_pollers[parent]);
+		index = parent;
 	}
 
-	return count;
+	timed_poller_set(thread, index, poller);
 }
 
 static void
-poller_insert_timer(struct spdk_thread *thread, struct spdk_poller *poller, uint64_t now)
+timed_pollers_sift_down(struct spdk_thread *thread, uint32_t index)
 {
-	struct spdk_poller *iter;
+	struct spdk_poller *poller = thread->timed_pollers[index];
+	uint32_t child;
 
-	poller->next_run_tick = now + poller->period_ticks;
+	while ((child = 2 * index + 1) < thread->timed_pollers_count) {
+		if (child + 1 < thread->timed_pollers_count &&
+		    timed_poller_before(thread->timed_pollers[child + 1], thread->timed_pollers[child])) {
+			child++;
+		}
+		if (!timed_poller_before(thread->timed_pollers[child], poller)) {
+			break;
+		}
+		timed_poller_set(thread, index, thread->timed_pollers[child]);
+		index = child;
+	}
 
-	/*
-	 * Insert poller in the thread's timed_pollers list in sorted order by next scheduled
-	 * run time.
-	 */
-	TAILQ_FOREACH_REVERSE(iter, &thread->timed_pollers, timed_pollers_head, tailq) {
-		if (iter->next_run_tick <= poller->next_run_tick) {
-			TAILQ_INSERT_AFTER(&thread->timed_pollers, iter, poller, tailq);
-			return;
+	timed_poller_set(thread, index, poller);
+}
+
+static inline struct spdk_poller *
+timed_pollers_first(struct spdk_thread *thread)
+{
+	return thread->timed_pollers_count > 0 ? thread->timed_pollers[0] : NULL;
+}
+
+static void
+timed_pollers_remove(struct spdk_thread *thread, struct spdk_poller *poller)
+{
+	uint32_t index = poller->timer_index;
+	struct spdk_poller *last;
+
+	assert(index < thread->timed_pollers_count);
+	assert(thread->timed_pollers[index] == poller);
+
+	last = thread->timed_pollers[--thread->timed_pollers_count];
+	if (last == poller) {
+		return;
+	}
+
+	timed_poller_set(thread, index, last);
+	if (index > 0 && timed_poller_before(last, thread->timed_pollers[(index - 1) / 2])) {
+		timed_pollers_sift_up(thread, index);
+	} else {
+		timed_pollers_sift_down(thread, index);
+	}
+}
+
+/*
+ * Make room in the timer heap for one more timed poller. Called when a timed
+ * poller is registered, so that (re)inserting timed pollers never fails.
+ */
+static int
+timed_pollers_reserve(struct spdk_thread *thread)
+{
+	struct spdk_poller **timed_pollers;
+	uint32_t size;
+
+	if (thread->timed_pollers_reserved == thread->timed_pollers_size) {
+		size = spdk_max(thread->timed_pollers_size * 2, 32);
+		timed_pollers = realloc(thread->timed_pollers, size * sizeof(*timed_pollers));
+		if (timed_pollers == NULL) {
+			return -ENOMEM;
 		}
+		thread->timed_pollers = timed_pollers;
+		thread->timed_pollers_size = size;
 	}
 
-	/* No earlier pollers were found, so this poller must be the new head */
-	TAILQ_INSERT_HEAD(&thread->timed_pollers, poller, tailq);
+	thread->timed_pollers_reserved++;
+
+	return 0;
+}
+
+static inline void
+timed_pollers_release(struct spdk_thread *thread)
+{
+	assert(thread->timed_pollers_reserved > thread->timed_pollers_count);
+	thread->timed_pollers_reserved--;
+}
+
+static void
+poller_insert_timer(struct spdk_thread *thread, struct spdk_poller *poller, uint64_t now)
+{
+	poller->next_run_tick = now + poller->period_ticks;
+	poller->timer_seq = thread->timed_pollers_seq++;
+
+	assert(thread->timed_pollers_count < thread->timed_pollers_reserved);
+	timed_poller_set(thread, thread->timed_pollers_count++, poller);
+	timed_pollers_sift_up(thread, poller->timer_index);
+}
+
+/* Move a timed poller that just ran to its next run time. */
+static void
+poller_update_timer(struct spdk_thread *thread, struct spdk_poller *poller, uint64_t now)
+{
+	poller->next_run_tick = now + poller->period_ticks;
+	poller->timer_seq = thread->timed_pollers_seq++;
+
+	/* The poller can only move later. */
+	timed_pollers_sift_down(thread, poller->timer_index);
 }
 
 static void
@@ -624,20 +978,13 @@ thread_poll(struct spdk_thread *thread, uint32_t max_msgs, uint64_t now)
 		}
 	}
 
-	TAILQ_FOREACH_SAFE(poller, &thread->timed_pollers, tailq, tmp) {
+	/*
+	 * Run the expired timed pollers. A poller that ran is rescheduled after now,
+	 * so every poller runs at most once.
+	 */
+	while ((poller = timed_pollers_first(thread)) != NULL) {
 		int timer_rc = 0;
 
-		if (poller->state == SPDK_POLLER_STATE_UNREGISTERED) {
-			TAILQ_REMOVE(&thread->timed_pollers, poller, tailq);
-			free(poller);
-			continue;
-		} else if (poller->state == SPDK_POLLER_STATE_PAUSING) {
-			TAILQ_REMOVE(&thread->timed_pollers, poller, tailq);
-			TAILQ_INSERT_TAIL(&thread->paused_pollers, poller, tailq);
-			poller->state = SPDK_POLLER_STATE_PAUSED;
-			continue;
-		}
-
 		if (now < poller->next_run_tick) {
 			break;
 		}
@@ -657,12 +1004,12 @@ thread_poll(struct spdk_thread *thread, uint32_t max_msgs, uint64_t now)
 #endif
 
 		if (poller->state == SPDK_POLLER_STATE_UNREGISTERED) {
-			TAILQ_REMOVE(&thread->timed_pollers, poller, tailq);
+			timed_pollers_remove(thread, poller);
+			timed_pollers_release(thread);
 			free(poller);
 		} else if (poller->state != SPDK_POLLER_STATE_PAUSED) {
 			poller->state = SPDK_POLLER_STATE_WAITING;
-			TAILQ_REMOVE(&thread->timed_pollers, poller, tailq);
-			poller_insert_timer(thread, poller, now);
+			poller_update_timer(thread, poller, now);
 		}
 
 		if (timer_rc > rc) {
@@ -686,6 +1033,15 @@ spdk_thread_poll(struct spdk_thread *thread, uint32_t max_msgs, uint64_t now)
 		now = spdk_get_ticks();
 	}
 
+	/*
+	 * Go back to polling mode if the thread was waited on, and process the
+	 * interrupts registered on the thread.
+	 */
+	if (spdk_unlikely(thread->intr_armed || thread->num_interrupts > 0)) {
+		__atomic_store_n(&thread->intr_armed, false, __ATOMIC_RELAXED);
+		spdk_fd_group_wait(thread->fgrp, 0);
+	}
+
 	rc = thread_poll(thread, max_msgs, now);
 
 	if (spdk_unlikely(thread->state == SPDK_THREAD_STATE_EXITING)) {
@@ -704,7 +1060,7 @@ spdk_thread_next_poller_expiration(struct spdk_thread *thread)
 {
 	struct spdk_poller *poller;
 
-	poller = TAILQ_FIRST(&thread->timed_pollers);
+	poller = timed_pollers_first(thread);
 	if (poller) {
 		return poller->next_run_tick;
 	}
@@ -718,11 +1074,88 @@ spdk_thread_has_active_pollers(struct spdk_thread *thread)
 	return !TAILQ_EMPTY(&thread->active_pollers);
 }
 
+int
+spdk_thread_get_interrupt_fd(struct spdk_thread *thread)
+{
+	if (thread->fgrp == NULL) {
+		return -1;
+	}
+
+	return spdk_fd_group_get_fd(thread->fgrp);
+}
+
+static bool
+thread_interrupt_arm_timer(struct spdk_thread *thread)
+{
+#ifdef __linux__
+	struct spdk_poller *poller;
+	struct itimerspec its = {};
+	uint64_t now, delta, ticks_hz;
+
+	poller = timed_pollers_first(thread);
+	if (poller != NULL) {
+		now = spdk_get_ticks();
+		if (poller->next_run_tick <= now) {
+			return false;
+		}
+
+		delta = poller->next_run_tick - now;
+		ticks_hz = spdk_get_ticks_hz();
+		its.it_value.tv_sec = delta / ticks_hz;
+		its.it_value.tv_nsec = spdk_max((delta % ticks_hz) * SPDK_SEC_TO_NSEC / ticks_hz, 1);
+	}
+
+	/* A zero it_value disarms the timer. Setting the timer also clears its expirations. */
+	if (timerfd_settime(thread->timer_fd, 0, &its, NULL) < 0) {
+		SPDK_ERRLOG("Failed to arm the timer of thread %s: %s\n", thread->name,
+			    spdk_strerror(errno));
+		return false;
+	}
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool
+spdk_thread_arm_interrupt(struct spdk_thread *thread)
+{
+	if (thread->fgrp == NULL) {
+		return false;
+	}
+
+	/* Exiting threads and active pollers need to be polled. */
+	if (thread->state != SPDK_THREAD_STATE_RUNNING ||
+	    !TAILQ_EMPTY(&thread->active_pollers)) {
+		return false;
+	}
+
+	if (!thread_interrupt_arm_timer(thread)) {
+		return false;
+	}
+
+	__atomic_store_n(&thread->intr_armed, true, __ATOMIC_RELAXED);
+
+	/*
+	 * Senders enqueue a message and then check intr_armed, we set intr_armed and
+	 * then check the message queue. The full barriers on both sides guarantee
+	 * that either the sender signals msg_fd or we see the message here.
+	 */
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (spdk_ring_count(thread->messages) || thread->critical_msg != NULL) {
+		__atomic_store_n(&thread->intr_armed, false, __ATOMIC_RELAXED);
+		return false;
+	}
+
+	return true;
+}
+
 static bool
 thread_has_unpaused_pollers(struct spdk_thread *thread)
 {
 	if (TAILQ_EMPTY(&thread->active_pollers) &&
-	    TAILQ_EMPTY(&thread->timed_pollers)) {
+	    thread->timed_pollers_count == 0) {
 		return false;
 	}
 
@@ -841,22 +1274,10 @@ spdk_thread_send_msg(const struct spdk_thread *thread, spdk_msg_fn fn, void *ctx
 
 	local_thread = _get_thread();
 
-	msg = NULL;
-	if (local_thread != NULL) {
-		if (local_thread->msg_cache_count > 0) {
-			msg = SLIST_FIRST(&local_thread->msg_cache);
-			assert(msg != NULL);
-			SLIST_REMOVE_HEAD(&local_thread->msg_cache, link);
-			local_thread->msg_cache_count--;
-		}
-	}
-
-	if (msg == NULL) {
-		msg = spdk_mempool_get(g_spdk_msg_mempool);
-		if (!msg) {
-			SPDK_ERRLOG("msg could not be allocated\n");
-			return -ENOMEM;
-		}
+	rc = thread_msgs_get(local_thread, &msg, 1);
+	if (rc != 0) {
+		SPDK_ERRLOG("msg could not be allocated\n");
+		return rc;
 	}
 
 	msg->fn = fn;
@@ -865,10 +1286,61 @@ spdk_thread_send_msg(const struct spdk_thread *thread, spdk_msg_fn fn, void *ctx
 	rc = spdk_ring_enqueue(thread->messages, (void **)&msg, 1, NULL);
 	if (rc != 1) {
 		SPDK_ERRLOG("msg could not be enqueued\n");
-		spdk_mempool_put(g_spdk_msg_mempool, msg);
+		thread_msgs_put(local_thread, &msg, 1);
+		return -EIO;
+	}
+
+	if (spdk_unlikely(g_interrupt_mode)) {
+		thread_interrupt_notify(thread);
+	}
+
+	return 0;
+}
+
+int
+spdk_thread_send_msg_batch(const struct spdk_thread *thread, spdk_msg_fn fn, void **ctxs,
+			   uint32_t count)
+{
+	struct spdk_thread *local_thread;
+	struct spdk_msg *msgs[SPDK_THREAD_MSG_BATCH_MAX];
+	uint32_t i;
+	int rc;
+
+	assert(thread != NULL);
+
+	if (count == 0 || count > SPDK_THREAD_MSG_BATCH_MAX) {
+		return -EINVAL;
+	}
+
+	if (spdk_unlikely(thread->state == SPDK_THREAD_STATE_EXITED)) {
+		SPDK_ERRLOG("Thread %s is marked as exited.\n", thread->name);
+		return -EIO;
+	}
+
+	local_thread = _get_thread();
+
+	rc = thread_msgs_get(local_thread, msgs, count);
+	if (rc != 0) {
+		SPDK_ERRLOG("msgs could not be allocated\n");
+		return rc;
+	}
+
+	for (i = 0; i < count; i++) {
+		msgs[i]->fn = fn;
+		msgs[i]->arg = ctxs[i];
+	}
+
+	/* The ring enqueues either all or none of the messages. */
+	if (spdk_ring_enqueue(thread->messages, (void **)msgs, count, NULL) != count) {
+		SPDK_ERRLOG("msgs could not be enqueued\n");
+		thread_msgs_put(local_thread, msgs, count);
 		return -EIO;
 	}
 
+	if (spdk_unlikely(g_interrupt_mode)) {
+		thread_interrupt_notify(thread);
+	}
+
 	return 0;
 }
 
@@ -879,6 +1351,9 @@ spdk_thread_send_critical_msg(struct spdk_thread *thread, spdk_msg_fn fn)
 
 	if (__atomic_compare_exchange_n(&thread->critical_msg, &expected, fn, false, __ATOMIC_SEQ_CST,
 					__ATOMIC_SEQ_CST)) {
+		if (spdk_unlikely(g_interrupt_mode)) {
+			thread_interrupt_notify(thread);
+		}
 		return 0;
 	}
 
@@ -933,6 +1408,12 @@ poller_register(spdk_poller_fn fn,
 		poller->period_ticks = 0;
 	}
 
+	if (poller->period_ticks > 0 && timed_pollers_reserve(thread) != 0) {
+		SPDK_ERRLOG("Timed poller memory allocation failed\n");
+		free(poller);
+		return NULL;
+	}
+
 	thread_insert_poller(thread, poller);
 
 	return poller;
@@ -986,7 +1467,20 @@ spdk_poller_unregister(struct spdk_poller **ppoller)
 	if (poller->state == SPDK_POLLER_STATE_PAUSED) {
 		TAILQ_REMOVE(&thread->paused_pollers, poller, tailq);
 		TAILQ_INSERT_TAIL(&thread->active_pollers, poller, tailq);
+		if (poller->period_ticks > 0) {
+			timed_pollers_release(thread);
+		}
 		poller->period_ticks = 0;
+	} else if (poller->period_ticks > 0 && poller->state == SPDK_POLLER_STATE_WAITING) {
+		/*
+		 * A waiting timed poller isn't referenced by spdk_thread_poll(), so
+		 * it can be freed right away instead of staying in the timer heap
+		 * until it expires.
+		 */
+		timed_pollers_remove(thread, poller);
+		timed_pollers_release(thread);
+		free(poller);
+		return;
 	}
 
 	/* Simply set the state to unregistered. The poller will get cleaned up
@@ -1001,7 +1495,8 @@ spdk_poller_pause(struct spdk_poller *poller)
 	struct spdk_thread *thread;
 
 	if (poller->state == SPDK_POLLER_STATE_PAUSED ||
-	    poller->state == SPDK_POLLER_STATE_PAUSING) {
+	    poller->state == SPDK_POLLER_STATE_PAUSING ||
+	    poller->state == SPDK_POLLER_STATE_UNREGISTERED) {
 		return;
 	}
 
@@ -1017,11 +1512,12 @@ spdk_poller_pause(struct spdk_poller *poller)
 	 * allows a poller to be paused from another one's context without
 	 * breaking the TAILQ_FOREACH_REVERSE_SAFE iteration.
 	 */
-	if (poller->state != SPDK_POLLER_STATE_RUNNING) {
+	if (poller->state != SPDK_POLLER_STATE_RUNNING && poller->period_ticks == 0) {
 		poller->state = SPDK_POLLER_STATE_PAUSING;
 	} else {
+		/* Timed pollers aren't iterated over, they can always be paused right away. */
 		if (poller->period_ticks > 0) {
-			TAILQ_REMOVE(&thread->timed_pollers, poller, tailq);
+			timed_pollers_remove(thread, poller);
 		} else {
 			TAILQ_REMOVE(&thread->active_pollers, poller, tailq);
 		}
@@ -1080,6 +1576,88 @@ spdk_poller_state_str(enum spdk_poller_state state)
 	}
 }
 
+struct spdk_interrupt *
+spdk_interrupt_register(int efd, spdk_interrupt_fn fn,
+			void *arg, const char *name)
+{
+	struct spdk_thread *thread;
+	struct spdk_interrupt *intr;
+	int rc;
+
+	thread = spdk_get_thread();
+	if (!thread) {
+		assert(false);
+		return NULL;
+	}
+
+	if (spdk_unlikely(thread->state != SPDK_THREAD_STATE_RUNNING)) {
+		SPDK_ERRLOG("thread %s is marked as exited\n", thread->name);
+		return NULL;
+	}
+
+	if (thread->fgrp == NULL) {
+		SPDK_ERRLOG("Interrupts can be registered only in interrupt mode\n");
+		return NULL;
+	}
+
+	intr = calloc(1, sizeof(*intr));
+	if (intr == NULL) {
+		SPDK_ERRLOG("Interrupt handler allocation failed\n");
+		return NULL;
+	}
+
+	if (name) {
+		snprintf(intr->name, sizeof(intr->name), "%s", name);
+	} else {
+		snprintf(intr->name, sizeof(intr->name), "%p", fn);
+	}
+
+	intr->efd = efd;
+	intr->thread = thread;
+
+	rc = spdk_fd_group_add(thread->fgrp, efd, fn, arg, intr->name);
+	if (rc != 0) {
+		SPDK_ERRLOG("Failed to register interrupt %s: %s\n", intr->name, spdk_strerror(-rc));
+		free(intr);
+		return NULL;
+	}
+
+	thread->num_interrupts++;
+
+	return intr;
+}
+
+void
+spdk_interrupt_unregister(struct spdk_interrupt **pintr)
+{
+	struct spdk_thread *thread;
+	struct spdk_interrupt *intr;
+
+	intr = *pintr;
+	if (intr == NULL) {
+		return;
+	}
+
+	*pintr = NULL;
+
+	thread = spdk_get_thread();
+	if (!thread) {
+		assert(false);
+		return;
+	}
+
+	if (intr->thread != thread) {
+		SPDK_ERRLOG("different from the thread that called spdk_interrupt_register()\n");
+		assert(false);
+		return;
+	}
+
+	spdk_fd_group_remove(thread->fgrp, intr->efd);
+	assert(thread->num_interrupts > 0);
+	thread->num_interrupts--;
+	free(intr);
+}
+
 struct call_thread {
 	struct spdk_thread *cur_thread;
 	spdk_msg_fn fn;
@@ -0,0 +1,281 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation. All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "spdk/stdinc.h"
+
+#include "spdk/fd_group.h"
+#include "spdk/log.h"
+#include "spdk/queue.h"
+#include "spdk/string.h"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+
+#define SPDK_FD_GROUP_MAX_EVENTS	32
+#define SPDK_FD_GROUP_MAX_NAME_LEN	64
+
+struct event_handler {
+	TAILQ_ENTRY(event_handler)	link;
+	int				fd;
+	spdk_fd_fn			fn;
+	void				*arg;
+	/* Set when the handler is removed while its event is being processed */
+	bool				removed;
+	char				name[SPDK_FD_GROUP_MAX_NAME_LEN + 1];
+};
+
+struct spdk_fd_group {
+	int				epfd;
+	int				num_fds;
+	/* Non-zero while the handlers returned by epoll_wait() are being called */
+	int				in_wait;
+	TAILQ_HEAD(, event_handler)	event_handlers;
+};
+
+#ifdef __linux__
+
+int
+spdk_fd_group_create(struct spdk_fd_group **_fgrp)
+{
+	struct spdk_fd_group *fgrp;
+	int epfd;
+
+	if (_fgrp == NULL) {
+		return -EINVAL;
+	}
+
+	fgrp = calloc(1, sizeof(*fgrp));
+	if (fgrp == NULL) {
+		return -ENOMEM;
+	}
+
+	epfd = epoll_create1(EPOLL_CLOEXEC);
+	if (epfd < 0) {
+		free(fgrp);
+		return -errno;
+	}
+
+	fgrp->epfd = epfd;
+	TAILQ_INIT(&fgrp->event_handlers);
+
+	*_fgrp = fgrp;
+
+	return 0;
+}
+
+void
+spdk_fd_group_destroy(struct spdk_fd_group *fgrp)
+{
+	struct event_handler *ehdlr, *tmp;
+
+	if (fgrp == NULL) {
+		return;
+	}
+
+	assert(fgrp->in_wait == 0);
+
+	TAILQ_FOREACH_SAFE(ehdlr, &fgrp->event_handlers, link, tmp) {
+		SPDK_ERRLOG("fd %d (%s) still registered in the fd group\n", ehdlr->fd, ehdlr->name);
+		TAILQ_REMOVE(&fgrp->event_handlers, ehdlr, link);
+		free(ehdlr);
+	}
+
+	close(fgrp->epfd);
+	free(fgrp);
+}
+
+int
+spdk_fd_group_add(struct spdk_fd_group *fgrp, int efd, spdk_fd_fn fn, void *arg,
+		  const char *name)
+{
+	struct event_handler *ehdlr;
+	struct epoll_event epevent = {};
+	int rc;
+
+	if (fgrp == NULL || efd < 0 || fn == NULL) {
+		return -EINVAL;
+	}
+
+	TAILQ_FOREACH(ehdlr, &fgrp->event_handlers, link) {
+		if (ehdlr->fd == efd && !ehdlr->removed) {
+			return -EEXIST;
+		}
+	}
+
+	ehdlr = calloc(1, sizeof(*ehdlr));
+	if (ehdlr == NULL) {
+		return -ENOMEM;
+	}
+
+	ehdlr->fd = efd;
+	ehdlr->fn = fn;
+	ehdlr->arg = arg;
+	snprintf(ehdlr->name, sizeof(ehdlr->name), "%s", name ? name : "unnamed");
+
+	epevent.events = EPOLLIN;
+	epevent.data.ptr = ehdlr;
+	rc = epoll_ctl(fgrp->epfd, EPOLL_CTL_ADD, efd, &epevent);
+	if (rc < 0) {
+		rc = -errno;
+		free(ehdlr);
+		return rc;
+	}
+
+	TAILQ_INSERT_TAIL(&fgrp->event_handlers, ehdlr, link);
+	fgrp->num_fds++;
+
+	return 0;
+}
+
+void
+spdk_fd_group_remove(struct spdk_fd_group *fgrp, int efd)
+{
+	struct event_handler *ehdlr;
+
+	TAILQ_FOREACH(ehdlr, &fgrp->event_handlers, link) {
+		if (ehdlr->fd == efd && !ehdlr->removed) {
+			break;
+		}
+	}
+
+	if (ehdlr == NULL) {
+		SPDK_ERRLOG("fd %d is not in the fd group\n", efd);
+		assert(false);
+		return;
+	}
+
+	if (epoll_ctl(fgrp->epfd, EPOLL_CTL_DEL, efd, NULL) < 0) {
+		SPDK_ERRLOG("Failed to remove fd %d from the fd group: %s\n", efd, spdk_strerror(errno));
+	}
+
+	fgrp->num_fds--;
+
+	/*
+	 * The handler may still be referenced by the events returned by the
+	 * epoll_wait() in progress. Let spdk_fd_group_wait() free it.
+	 */
+	if (fgrp->in_wait) {
+		ehdlr->removed = true;
+		return;
+	}
+
+	TAILQ_REMOVE(&fgrp->event_handlers, ehdlr, link);
+	free(ehdlr);
+}
+
+int
+spdk_fd_group_wait(struct spdk_fd_group *fgrp, int timeout)
+{
+	struct epoll_event events[SPDK_FD_GROUP_MAX_EVENTS];
+	struct event_handler *ehdlr, *tmp;
+	int nfds, i, rc;
+
+	nfds = epoll_wait(fgrp->epfd, events, SPDK_FD_GROUP_MAX_EVENTS, timeout);
+	if (nfds < 0) {
+		if (errno == EINTR) {
+			return 0;
+		}
+		return -errno;
+	}
+
+	fgrp->in_wait++;
+	for (i = 0; i < nfds; i++) {
+		ehdlr = events[i].data.ptr;
+		if (ehdlr->removed) {
+			continue;
+		}
+
+		rc = ehdlr->fn(ehdlr->arg);
+		if (rc < 0 && rc != -EAGAIN) {
+			SPDK_ERRLOG("Handler of fd %d (%s) failed: %s\n", ehdlr->fd, ehdlr->name,
+				    spdk_strerror(-rc));
+		}
+	}
+	fgrp->in_wait--;
+
+	if (fgrp->in_wait == 0) {
+		TAILQ_FOREACH_SAFE(ehdlr, &fgrp->event_handlers, link, tmp) {
+			if (ehdlr->removed) {
+				TAILQ_REMOVE(&fgrp->event_handlers, ehdlr, link);
+				free(ehdlr);
+			}
+		}
+	}
+
+	return nfds;
+}
+
+int
+spdk_fd_group_get_fd(struct spdk_fd_group *fgrp)
+{
+	return fgrp->epfd;
+}
+
+#else /* !__linux__ */
+
+int
+spdk_fd_group_create(struct spdk_fd_group **fgrp)
+{
+	return -ENOTSUP;
+}
+
+void
+spdk_fd_group_destroy(struct spdk_fd_group *fgrp)
+{
+}
+
+int
+spdk_fd_group_add(struct spdk_fd_group *fgrp, int efd, spdk_fd_fn fn, void *arg,
+		  const char *name)
+{
+	return -ENOTSUP;
+}
+
+void
+spdk_fd_group_remove(struct spdk_fd_group *fgrp, int efd)
+{
+}
+
+int
+spdk_fd_group_wait(struct spdk_fd_group *fgrp, int timeout)
+{
+	return -ENOTSUP;
+}
+
+int
+spdk_fd_group_get_fd(struct spdk_fd_group *fgrp)
+{
+	return -1;
+}
+
+#endif
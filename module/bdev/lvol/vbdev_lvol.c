@@ -31,9 +31,11 @@
  *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include "spdk/bit_array.h"
 #include "spdk/blob_bdev.h"
 #include "spdk/rpc.h"
 #include "spdk/bdev_module.h"
+#include "spdk/env.h"
 #include "spdk_internal/log.h"
 #include "spdk/string.h"
 #include "spdk/uuid.h"
@@ -57,6 +59,123 @@ static struct spdk_bdev_module g_lvol_if = {
 
 SPDK_BDEV_MODULE_REGISTER(lvol, &g_lvol_if)
 
+/* Only one in this many I/Os of a channel is counted in the heatmap */
+#define VBDEV_LVOL_HEATMAP_SAMPLE_RATE	16
+
+struct vbdev_lvol_io_channel {
+	/* lvol I/O is submitted to, switched over at the end of a migration */
+	struct spdk_lvol	*lvol;
+	struct spdk_io_channel	*bs_ch;
+	uint64_t		io_outstanding;
+
+	/* Sampled per cluster I/O counters, allocated on first sample */
+	uint32_t		*heatmap_reads;
+	uint32_t		*heatmap_writes;
+	uint64_t		heatmap_clusters;
+	uint32_t		sample_count;
+
+	/* Clusters written on this channel while the lvol is migrated */
+	struct spdk_bit_array	*dirty;
+
+	/* New I/O is queued while frozen, until the migration cut over */
+	bool			frozen;
+	TAILQ_HEAD(, spdk_bdev_io) frozen_ios;
+	struct spdk_io_channel_iter *drain_iter;
+	/* Channel of the destination lvol store, taken when frozen */
+	struct spdk_io_channel	*dst_bs_ch;
+};
+
+struct vbdev_lvol_io {
+	struct vbdev_lvol_io_channel *lvol_ch;
+};
+
+struct vbdev_lvol_migrate;
+
+struct vbdev_lvol_migrate_io {
+	struct vbdev_lvol_migrate	*ctx;
+	void				*buf;
+	uint64_t			offset;
+	uint64_t			length;
+};
+
+struct vbdev_lvol_migrate {
+	struct spdk_lvol		*lvol;
+	struct spdk_lvol		*dst;
+	struct spdk_lvol_store		*dst_lvs;
+	struct spdk_bdev		*bdev;
+	struct spdk_io_channel		*src_ch;
+	struct spdk_io_channel		*dst_ch;
+
+	/* Clusters left to copy in the current pass */
+	struct spdk_bit_array		*pending;
+	uint64_t			num_clusters;
+	uint64_t			cluster_size;
+	uint64_t			chunk_size;
+	uint32_t			io_unit_size;
+	uint64_t			cluster;
+	uint64_t			offset;
+	uint32_t			pass;
+
+	/* Channels record written clusters */
+	bool				tracking;
+	/* Channels queue new I/O */
+	bool				frozen;
+	/* The source dropped its persistent uuid for the destination to take */
+	bool				released;
+
+	uint32_t			outstanding;
+	int				rc;
+	spdk_lvol_op_complete		cb_fn;
+	void				*cb_arg;
+	TAILQ_ENTRY(vbdev_lvol_migrate)	link;
+
+	uint32_t			queue_depth;
+	struct vbdev_lvol_migrate_io	ios[0];
+};
+
+static TAILQ_HEAD(, vbdev_lvol_migrate) g_lvol_migrations = TAILQ_HEAD_INITIALIZER(
+			g_lvol_migrations);
+
+static struct vbdev_lvol_migrate *
+vbdev_lvol_find_migrate(struct spdk_bdev *bdev)
+{
+	struct vbdev_lvol_migrate *migrate;
+
+	TAILQ_FOREACH(migrate, &g_lvol_migrations, link) {
+		if (migrate->bdev == bdev) {
+			return migrate;
+		}
+	}
+
+	return NULL;
+}
+
+static bool
+vbdev_lvol_is_migrating(struct spdk_lvol *lvol)
+{
+	if (lvol->bdev != NULL && vbdev_lvol_find_migrate(lvol->bdev) != NULL) {
+		SPDK_ERRLOG("lvol %s is being migrated\n", lvol->name);
+		return true;
+	}
+
+	return false;
+}
+
+static bool
+vbdev_lvs_is_migrating(struct spdk_lvol_store *lvs)
+{
+	struct vbdev_lvol_migrate *migrate;
+
+	TAILQ_FOREACH(migrate, &g_lvol_migrations, link) {
+		if (migrate->lvol->lvol_store == lvs || migrate->dst_lvs == lvs) {
+			SPDK_ERRLOG("lvol store %s has an lvol being migrated\n", lvs->name);
+			return true;
+		}
+	}
+
+	return false;
+}
+
 struct lvol_store_bdev *
 vbdev_get_lvs_bdev_by_lvs(struct spdk_lvol_store *lvs_orig)
 {
@@ -402,6 +521,13 @@ _vbdev_lvs_remove(struct spdk_lvol_store *lvs, spdk_lvs_op_complete cb_fn, void
 		return;
 	}
 
+	if (vbdev_lvs_is_migrating(lvs)) {
+		if (cb_fn != NULL) {
+			cb_fn(cb_arg, -EBUSY);
+		}
+		return;
+	}
+
 	req = calloc(1, sizeof(*req));
 	if (!req) {
 		SPDK_ERRLOG("Cannot alloc memory for vbdev lvol store request pointer\n");
@@ -548,6 +674,7 @@ vbdev_lvol_unregister(void *ctx)
 
 	assert(lvol != NULL);
 
+	spdk_io_device_unregister(lvol->bdev, NULL);
 	spdk_bdev_alias_del_all(lvol->bdev);
 	spdk_lvol_close(lvol, _vbdev_lvol_unregister_cb, lvol->bdev);
 
@@ -584,6 +711,11 @@ vbdev_lvol_destroy(struct spdk_lvol *lvol, spdk_lvol_op_complete cb_fn, void *cb
 	assert(lvol != NULL);
 	assert(cb_fn != NULL);
 
+	if (vbdev_lvol_is_migrating(lvol)) {
+		cb_fn(cb_arg, -EBUSY);
+		return;
+	}
+
 	/* Check if it is possible to delete lvol */
 	spdk_blob_get_clones(lvol->lvol_store->blobstore, lvol->blob_id, NULL, &count);
 	if (count > 1) {
@@ -723,7 +855,121 @@ vbdev_lvol_get_io_channel(void *ctx)
 {
 	struct spdk_lvol *lvol = ctx;
 
-	return spdk_lvol_get_io_channel(lvol);
+	return spdk_get_io_channel(lvol->bdev);
+}
+
+static int
+vbdev_lvol_channel_create_cb(void *io_device, void *ctx_buf)
+{
+	struct spdk_bdev *bdev = io_device;
+	struct vbdev_lvol_io_channel *lvol_ch = ctx_buf;
+	struct vbdev_lvol_migrate *migrate;
+
+	lvol_ch->lvol = bdev->ctxt;
+	TAILQ_INIT(&lvol_ch->frozen_ios);
+
+	migrate = vbdev_lvol_find_migrate(bdev);
+	if (migrate != NULL && migrate->tracking) {
+		lvol_ch->dirty = spdk_bit_array_create(migrate->num_clusters);
+		if (lvol_ch->dirty == NULL) {
+			return -ENOMEM;
+		}
+	}
+
+	if (migrate != NULL && migrate->frozen) {
+		lvol_ch->dst_bs_ch = spdk_lvol_get_io_channel(migrate->dst);
+		if (lvol_ch->dst_bs_ch == NULL) {
+			goto err;
+		}
+		lvol_ch->frozen = true;
+	}
+
+	lvol_ch->bs_ch = spdk_lvol_get_io_channel(lvol_ch->lvol);
+	if (lvol_ch->bs_ch == NULL) {
+		goto err;
+	}
+
+	return 0;
+
+err:
+	if (lvol_ch->dst_bs_ch != NULL) {
+		spdk_put_io_channel(lvol_ch->dst_bs_ch);
+	}
+	spdk_bit_array_free(&lvol_ch->dirty);
+	return -ENOMEM;
+}
+
+static void
+vbdev_lvol_channel_destroy_cb(void *io_device, void *ctx_buf)
+{
+	struct vbdev_lvol_io_channel *lvol_ch = ctx_buf;
+
+	assert(TAILQ_EMPTY(&lvol_ch->frozen_ios));
+
+	spdk_put_io_channel(lvol_ch->bs_ch);
+	if (lvol_ch->dst_bs_ch != NULL) {
+		spdk_put_io_channel(lvol_ch->dst_bs_ch);
+	}
+	free(lvol_ch->heatmap_reads);
+	free(lvol_ch->heatmap_writes);
+	spdk_bit_array_free(&lvol_ch->dirty);
+}
+
+/*
+ * Count one in VBDEV_LVOL_HEATMAP_SAMPLE_RATE I/Os of the channel in the per cluster
+ * heatmap. I/O is split on cluster boundaries, so each one touches a single cluster.
+ * The counters are only touched from the channel's thread and are summed up lazily
+ * when the heatmap is read.
+ */
+static void
+vbdev_lvol_heatmap_sample(struct vbdev_lvol_io_channel *lvol_ch, struct spdk_bdev_io *bdev_io,
+			  bool write)
+{
+	struct spdk_bdev *bdev = bdev_io->bdev;
+	uint64_t cluster, num_clusters;
+	uint32_t *reads, *writes;
+
+	if (++lvol_ch->sample_count < VBDEV_LVOL_HEATMAP_SAMPLE_RATE) {
+		return;
+	}
+	lvol_ch->sample_count = 0;
+
+	if (bdev->optimal_io_boundary == 0) {
+		return;
+	}
+
+	cluster = bdev_io->u.bdev.offset_blocks / bdev->optimal_io_boundary;
+	if (cluster >= lvol_ch->heatmap_clusters) {
+		/* First sample on this channel, or the lvol was resized */
+		num_clusters = spdk_divide_round_up(bdev->blockcnt, bdev->optimal_io_boundary);
+		if (cluster >= num_clusters) {
+			return;
+		}
+
+		reads = realloc(lvol_ch->heatmap_reads, num_clusters * sizeof(*reads));
+		if (reads == NULL) {
+			return;
+		}
+		lvol_ch->heatmap_reads = reads;
+
+		writes = realloc(lvol_ch->heatmap_writes, num_clusters * sizeof(*writes));
+		if (writes == NULL) {
+			return;
+		}
+		lvol_ch->heatmap_writes = writes;
+
+		memset(&reads[lvol_ch->heatmap_clusters], 0,
+		       (num_clusters - lvol_ch->heatmap_clusters) * sizeof(*reads));
+		memset(&writes[lvol_ch->heatmap_clusters], 0,
+		       (num_clusters - lvol_ch->heatmap_clusters) * sizeof(*writes));
+		lvol_ch->heatmap_clusters = num_clusters;
+	}
+
+	if (write) {
+		lvol_ch->heatmap_writes[cluster]++;
+	} else {
+		lvol_ch->heatmap_reads[cluster]++;
+	}
 }
 
 static bool
@@ -744,10 +990,39 @@ vbdev_lvol_io_type_supported(void *ctx, enum spdk_bdev_io_type io_type)
 	}
 }
 
+static void
+lvol_mark_dirty(struct vbdev_lvol_io_channel *lvol_ch, struct spdk_bdev_io *bdev_io)
+{
+	uint64_t boundary = bdev_io->bdev->optimal_io_boundary;
+	uint64_t cluster, last;
+
+	cluster = bdev_io->u.bdev.offset_blocks / boundary;
+	last = (bdev_io->u.bdev.offset_blocks + bdev_io->u.bdev.num_blocks - 1) / boundary;
+	for (; cluster <= last; cluster++) {
+		spdk_bit_array_set(lvol_ch->dirty, cluster);
+	}
+}
+
+/* Called for every I/O counted in io_outstanding once it was completed */
+static void
+lvol_io_done(struct vbdev_lvol_io_channel *lvol_ch)
+{
+	struct spdk_io_channel_iter *drain_iter;
+
+	assert(lvol_ch->io_outstanding > 0);
+	if (--lvol_ch->io_outstanding == 0 && lvol_ch->drain_iter != NULL) {
+		drain_iter = lvol_ch->drain_iter;
+		lvol_ch->drain_iter = NULL;
+		spdk_for_each_channel_continue(drain_iter, 0);
+	}
+}
+
 static void
 lvol_op_comp(void *cb_arg, int bserrno)
 {
 	struct spdk_bdev_io *bdev_io = cb_arg;
+	struct vbdev_lvol_io *lvol_io = (struct vbdev_lvol_io *)bdev_io->driver_ctx;
+	struct vbdev_lvol_io_channel *lvol_ch = lvol_io->lvol_ch;
 	enum spdk_bdev_io_status status = SPDK_BDEV_IO_STATUS_SUCCESS;
 
 	if (bserrno != 0) {
@@ -758,16 +1033,33 @@ lvol_op_comp(void *cb_arg, int bserrno)
 		}
 	}
 
+	/* Mark the clusters only once the data is in place, so a copy started after
+	 * this is guaranteed to see it */
+	if (lvol_ch->dirty != NULL && bdev_io->type != SPDK_BDEV_IO_TYPE_READ) {
+		lvol_mark_dirty(lvol_ch, bdev_io);
+	}
+
 	SPDK_INFOLOG(SPDK_LOG_VBDEV_LVOL, "Vbdev processing callback on device %s with type %d\n",
 		     bdev_io->bdev->name, bdev_io->type);
 	spdk_bdev_io_complete(bdev_io, status);
+	lvol_io_done(lvol_ch);
+}
+
+static struct spdk_blob *
+lvol_io_start(struct vbdev_lvol_io_channel *lvol_ch, struct spdk_bdev_io *bdev_io)
+{
+	struct vbdev_lvol_io *lvol_io = (struct vbdev_lvol_io *)bdev_io->driver_ctx;
+
+	lvol_io->lvol_ch = lvol_ch;
+
+	return lvol_ch->lvol->blob;
 }
 
 static void
-lvol_unmap(struct spdk_lvol *lvol, struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io)
+lvol_unmap(struct vbdev_lvol_io_channel *lvol_ch, struct spdk_bdev_io *bdev_io)
 {
 	uint64_t start_page, num_pages;
-	struct spdk_blob *blob = lvol->blob;
+	struct spdk_blob *blob = lvol_io_start(lvol_ch, bdev_io);
 
 	start_page = bdev_io->u.bdev.offset_blocks;
 	num_pages = bdev_io->u.bdev.num_blocks;
@@ -775,14 +1067,14 @@ lvol_unmap(struct spdk_lvol *lvol, struct spdk_io_channel *ch, struct spdk_bdev_
 	SPDK_INFOLOG(SPDK_LOG_VBDEV_LVOL,
 		     "Vbdev doing unmap at offset %" PRIu64 " using %" PRIu64 " pages on device %s\n", start_page,
 		     num_pages, bdev_io->bdev->name);
-	spdk_blob_io_unmap(blob, ch, start_page, num_pages, lvol_op_comp, bdev_io);
+	spdk_blob_io_unmap(blob, lvol_ch->bs_ch, start_page, num_pages, lvol_op_comp, bdev_io);
 }
 
 static void
-lvol_write_zeroes(struct spdk_lvol *lvol, struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io)
+lvol_write_zeroes(struct vbdev_lvol_io_channel *lvol_ch, struct spdk_bdev_io *bdev_io)
 {
 	uint64_t start_page, num_pages;
-	struct spdk_blob *blob = lvol->blob;
+	struct spdk_blob *blob = lvol_io_start(lvol_ch, bdev_io);
 
 	start_page = bdev_io->u.bdev.offset_blocks;
 	num_pages = bdev_io->u.bdev.num_blocks;
@@ -790,15 +1082,14 @@ lvol_write_zeroes(struct spdk_lvol *lvol, struct spdk_io_channel *ch, struct spd
 	SPDK_INFOLOG(SPDK_LOG_VBDEV_LVOL,
 		     "Vbdev doing write zeros at offset %" PRIu64 " using %" PRIu64 " pages on device %s\n", start_page,
 		     num_pages, bdev_io->bdev->name);
-	spdk_blob_io_write_zeroes(blob, ch, start_page, num_pages, lvol_op_comp, bdev_io);
+	spdk_blob_io_write_zeroes(blob, lvol_ch->bs_ch, start_page, num_pages, lvol_op_comp, bdev_io);
 }
 
 static void
-lvol_read(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io)
+lvol_read(struct vbdev_lvol_io_channel *lvol_ch, struct spdk_bdev_io *bdev_io)
 {
 	uint64_t start_page, num_pages;
-	struct spdk_lvol *lvol = bdev_io->bdev->ctxt;
-	struct spdk_blob *blob = lvol->blob;
+	struct spdk_blob *blob = lvol_io_start(lvol_ch, bdev_io);
 
 	start_page = bdev_io->u.bdev.offset_blocks;
 	num_pages = bdev_io->u.bdev.num_blocks;
@@ -806,15 +1097,15 @@ lvol_read(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io)
 	SPDK_INFOLOG(SPDK_LOG_VBDEV_LVOL,
 		     "Vbdev doing read at offset %" PRIu64 " using %" PRIu64 " pages on device %s\n", start_page,
 		     num_pages, bdev_io->bdev->name);
-	spdk_blob_io_readv(blob, ch, bdev_io->u.bdev.iovs, bdev_io->u.bdev.iovcnt, start_page,
-			   num_pages, lvol_op_comp, bdev_io);
+	spdk_blob_io_readv(blob, lvol_ch->bs_ch, bdev_io->u.bdev.iovs, bdev_io->u.bdev.iovcnt,
+			   start_page, num_pages, lvol_op_comp, bdev_io);
 }
 
 static void
-lvol_write(struct spdk_lvol *lvol, struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io)
+lvol_write(struct vbdev_lvol_io_channel *lvol_ch, struct spdk_bdev_io *bdev_io)
 {
 	uint64_t start_page, num_pages;
-	struct spdk_blob *blob = lvol->blob;
+	struct spdk_blob *blob = lvol_io_start(lvol_ch, bdev_io);
 
 	start_page = bdev_io->u.bdev.offset_blocks;
 	num_pages = bdev_io->u.bdev.num_blocks;
@@ -822,8 +1113,8 @@ lvol_write(struct spdk_lvol *lvol, struct spdk_io_channel *ch, struct spdk_bdev_
 	SPDK_INFOLOG(SPDK_LOG_VBDEV_LVOL,
 		     "Vbdev doing write at offset %" PRIu64 " using %" PRIu64 " pages on device %s\n", start_page,
 		     num_pages, bdev_io->bdev->name);
-	spdk_blob_io_writev(blob, ch, bdev_io->u.bdev.iovs, bdev_io->u.bdev.iovcnt, start_page,
-			    num_pages, lvol_op_comp, bdev_io);
+	spdk_blob_io_writev(blob, lvol_ch->bs_ch, bdev_io->u.bdev.iovs, bdev_io->u.bdev.iovcnt,
+			    start_page, num_pages, lvol_op_comp, bdev_io);
 }
 
 static int
@@ -837,37 +1128,54 @@ lvol_reset(struct spdk_bdev_io *bdev_io)
 static void
 lvol_get_buf_cb(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io, bool success)
 {
+	struct vbdev_lvol_io_channel *lvol_ch = spdk_io_channel_get_ctx(ch);
+
 	if (!success) {
 		spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_FAILED);
+		lvol_io_done(lvol_ch);
 		return;
 	}
 
-	lvol_read(ch, bdev_io);
+	lvol_read(lvol_ch, bdev_io);
 }
 
 static void
 vbdev_lvol_submit_request(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io)
 {
-	struct spdk_lvol *lvol = bdev_io->bdev->ctxt;
+	struct vbdev_lvol_io_channel *lvol_ch = spdk_io_channel_get_ctx(ch);
 
 	SPDK_INFOLOG(SPDK_LOG_VBDEV_LVOL, "Vbdev request type %d submitted\n", bdev_io->type);
 
+	if (lvol_ch->frozen) {
+		TAILQ_INSERT_TAIL(&lvol_ch->frozen_ios, bdev_io, module_link);
+		return;
+	}
+
 	switch (bdev_io->type) {
 	case SPDK_BDEV_IO_TYPE_READ:
+		/* Counted from here, as it may wait for a buffer before it reaches the blob */
+		lvol_ch->io_outstanding++;
+		vbdev_lvol_heatmap_sample(lvol_ch, bdev_io, false);
 		spdk_bdev_io_get_buf(bdev_io, lvol_get_buf_cb,
 				     bdev_io->u.bdev.num_blocks * bdev_io->bdev->blocklen);
 		break;
 	case SPDK_BDEV_IO_TYPE_WRITE:
-		lvol_write(lvol, ch, bdev_io);
+		lvol_ch->io_outstanding++;
+		vbdev_lvol_heatmap_sample(lvol_ch, bdev_io, true);
+		lvol_write(lvol_ch, bdev_io);
 		break;
 	case SPDK_BDEV_IO_TYPE_RESET:
 		lvol_reset(bdev_io);
 		break;
 	case SPDK_BDEV_IO_TYPE_UNMAP:
-		lvol_unmap(lvol, ch, bdev_io);
+		lvol_ch->io_outstanding++;
+		vbdev_lvol_heatmap_sample(lvol_ch, bdev_io, true);
+		lvol_unmap(lvol_ch, bdev_io);
 		break;
 	case SPDK_BDEV_IO_TYPE_WRITE_ZEROES:
-		lvol_write_zeroes(lvol, ch, bdev_io);
+		lvol_ch->io_outstanding++;
+		vbdev_lvol_heatmap_sample(lvol_ch, bdev_io, true);
+		lvol_write_zeroes(lvol_ch, bdev_io);
 		break;
 	default:
 		SPDK_INFOLOG(SPDK_LOG_VBDEV_LVOL, "lvol: unsupported I/O type %d\n", bdev_io->type);
@@ -957,8 +1265,13 @@ _create_lvol_disk(struct spdk_lvol *lvol, bool destroy)
 	bdev->fn_table = &vbdev_lvol_fn_table;
 	bdev->module = &g_lvol_if;
 
+	/* The bdev is the io_device, it stays the same when the lvol behind it is migrated */
+	spdk_io_device_register(bdev, vbdev_lvol_channel_create_cb, vbdev_lvol_channel_destroy_cb,
+				sizeof(struct vbdev_lvol_io_channel), lvol->unique_id);
+
 	rc = spdk_bdev_register(bdev);
 	if (rc) {
+		spdk_io_device_unregister(bdev, NULL);
 		free(bdev);
 		return rc;
 	}
@@ -1029,6 +1342,11 @@ vbdev_lvol_create_snapshot(struct spdk_lvol *lvol, const char *snapshot_name,
 {
 	struct spdk_lvol_with_handle_req *req;
 
+	if (vbdev_lvol_is_migrating(lvol)) {
+		cb_fn(cb_arg, NULL, -EBUSY);
+		return;
+	}
+
 	req = calloc(1, sizeof(*req));
 	if (req == NULL) {
 		cb_fn(cb_arg, NULL, -ENOMEM);
@@ -1047,6 +1365,11 @@ vbdev_lvol_create_clone(struct spdk_lvol *lvol, const char *clone_name,
 {
 	struct spdk_lvol_with_handle_req *req;
 
+	if (vbdev_lvol_is_migrating(lvol)) {
+		cb_fn(cb_arg, NULL, -EBUSY);
+		return;
+	}
+
 	req = calloc(1, sizeof(*req));
 	if (req == NULL) {
 		cb_fn(cb_arg, NULL, -ENOMEM);
@@ -1079,6 +1402,11 @@ vbdev_lvol_rename(struct spdk_lvol *lvol, const char *new_lvol_name,
 	struct spdk_lvol_req *req;
 	int rc;
 
+	if (vbdev_lvol_is_migrating(lvol)) {
+		cb_fn(cb_arg, -EBUSY);
+		return;
+	}
+
 	rc = _vbdev_lvol_change_bdev_alias(lvol, new_lvol_name);
 	if (rc != 0) {
 		SPDK_ERRLOG("renaming lvol to '%s' does not succeed\n", new_lvol_name);
@@ -1138,6 +1466,11 @@ vbdev_lvol_resize(struct spdk_lvol *lvol, uint64_t sz, spdk_lvol_op_complete cb_
 
 	assert(lvol->bdev != NULL);
 
+	if (vbdev_lvol_is_migrating(lvol)) {
+		cb_fn(cb_arg, -EBUSY);
+		return;
+	}
+
 	req = calloc(1, sizeof(*req));
 	if (req == NULL) {
 		cb_fn(cb_arg, -ENOMEM);
@@ -1179,6 +1512,11 @@ vbdev_lvol_set_read_only(struct spdk_lvol *lvol, spdk_lvol_op_complete cb_fn, vo
 
 	assert(lvol->bdev != NULL);
 
+	if (vbdev_lvol_is_migrating(lvol)) {
+		cb_fn(cb_arg, -EBUSY);
+		return;
+	}
+
 	req = calloc(1, sizeof(*req));
 	if (req == NULL) {
 		cb_fn(cb_arg, -ENOMEM);
@@ -1192,18 +1530,1134 @@ vbdev_lvol_set_read_only(struct spdk_lvol *lvol, spdk_lvol_op_complete cb_fn, vo
 	spdk_lvol_set_read_only(lvol, _vbdev_lvol_set_read_only_cb, req);
 }
 
-static int
-vbdev_lvs_init(void)
+/* Data is copied to another bdev in chunks of at most this size */
+#define VBDEV_LVOL_COPY_CHUNK_SIZE		(1024 * 1024)
+#define VBDEV_LVOL_COPY_DEFAULT_QUEUE_DEPTH	8
+#define VBDEV_LVOL_COPY_MAX_QUEUE_DEPTH		256
+
+struct vbdev_lvol_copy_ctx;
+
+struct vbdev_lvol_copy_io {
+	struct vbdev_lvol_copy_ctx	*ctx;
+	void				*buf;
+	uint64_t			offset;
+	uint64_t			length;
+	bool				write;
+	struct spdk_bdev_io_wait_entry	bdev_io_wait;
+};
+
+struct vbdev_lvol_copy_ctx {
+	struct spdk_lvol		*lvol;
+	spdk_blob_id			base_id;
+
+	struct spdk_bdev_desc		*src_desc;
+	struct spdk_bdev_desc		*dst_desc;
+	struct spdk_io_channel		*src_ch;
+	struct spdk_io_channel		*dst_ch;
+	bool				dst_claimed;
+
+	uint64_t			cluster_size;
+	uint64_t			chunk_size;
+
+	/* Next chunk to copy */
+	uint64_t			cluster;
+	uint64_t			cluster_offset;
+
+	uint64_t			copied_clusters;
+	uint32_t			queue_depth;
+	uint32_t			outstanding;
+	int				rc;
+
+	spdk_lvol_op_complete		cb_fn;
+	void				*cb_arg;
+
+	struct vbdev_lvol_copy_io	ios[0];
+};
+
+static void
+vbdev_lvol_copy_event_cb(enum spdk_bdev_event_type type, struct spdk_bdev *bdev, void *event_ctx)
 {
-	return 0;
+	struct vbdev_lvol_copy_ctx *ctx = event_ctx;
+
+	if (type == SPDK_BDEV_EVENT_REMOVE) {
+		/* Stop issuing new chunks, the descriptors are closed once all I/O is done */
+		SPDK_NOTICELOG("bdev %s removed while copying lvol %s\n", spdk_bdev_get_name(bdev),
+			       ctx->lvol->name);
+		ctx->rc = -ENODEV;
+	}
+}
+
+static void
+vbdev_lvol_copy_finish(struct vbdev_lvol_copy_ctx *ctx)
+{
+	uint32_t i;
+
+	for (i = 0; i < ctx->queue_depth; i++) {
+		spdk_dma_free(ctx->ios[i].buf);
+	}
+	if (ctx->src_ch != NULL) {
+		spdk_put_io_channel(ctx->src_ch);
+	}
+	if (ctx->dst_ch != NULL) {
+		spdk_put_io_channel(ctx->dst_ch);
+	}
+	if (ctx->dst_claimed) {
+		spdk_bdev_module_release_bdev(spdk_bdev_desc_get_bdev(ctx->dst_desc));
+	}
+	if (ctx->dst_desc != NULL) {
+		spdk_bdev_close(ctx->dst_desc);
+	}
+	if (ctx->src_desc != NULL) {
+		spdk_bdev_close(ctx->src_desc);
+	}
+
+	if (ctx->rc == 0) {
+		SPDK_INFOLOG(SPDK_LOG_VBDEV_LVOL, "Copied %" PRIu64 " clusters of lvol %s\n",
+			     ctx->copied_clusters, ctx->lvol->name);
+	} else {
+		SPDK_ERRLOG("Copying lvol %s failed: %s\n", ctx->lvol->name, spdk_strerror(-ctx->rc));
+	}
+
+	ctx->cb_fn(ctx->cb_arg, ctx->rc);
+	free(ctx);
+}
+
+/*
+ * Get the offset and length of the next chunk to copy, false when all changed clusters
+ * were copied. The last chunk of a cluster is shorter if the cluster size isn't a
+ * multiple of the chunk size.
+ */
+static bool
+vbdev_lvol_copy_next_chunk(struct vbdev_lvol_copy_ctx *ctx, uint64_t *offset, uint64_t *length)
+{
+	if (ctx->cluster != UINT64_MAX && ctx->cluster_offset >= ctx->cluster_size) {
+		spdk_blob_get_next_changed_cluster(ctx->lvol->blob, ctx->base_id, ctx->cluster + 1,
+						   &ctx->cluster);
+		ctx->cluster_offset = 0;
+	}
+
+	if (ctx->cluster == UINT64_MAX) {
+		return false;
+	}
+
+	if (ctx->cluster_offset == 0) {
+		ctx->copied_clusters++;
+	}
+
+	*offset = ctx->cluster * ctx->cluster_size + ctx->cluster_offset;
+	*length = spdk_min(ctx->chunk_size, ctx->cluster_size - ctx->cluster_offset);
+	ctx->cluster_offset += *length;
+
+	return true;
+}
+
+static void vbdev_lvol_copy_submit(void *arg);
+
+static void
+vbdev_lvol_copy_io_next(struct vbdev_lvol_copy_io *io)
+{
+	struct vbdev_lvol_copy_ctx *ctx = io->ctx;
+
+	if (ctx->rc == 0 && vbdev_lvol_copy_next_chunk(ctx, &io->offset, &io->length)) {
+		io->write = false;
+		vbdev_lvol_copy_submit(io);
+		return;
+	}
+
+	if (--ctx->outstanding == 0) {
+		vbdev_lvol_copy_finish(ctx);
+	}
+}
+
+static void
+vbdev_lvol_copy_write_cpl(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct vbdev_lvol_copy_io *io = cb_arg;
+
+	spdk_bdev_free_io(bdev_io);
+
+	if (!success) {
+		io->ctx->rc = -EIO;
+	}
+
+	vbdev_lvol_copy_io_next(io);
+}
+
+static void
+vbdev_lvol_copy_read_cpl(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct vbdev_lvol_copy_io *io = cb_arg;
+
+	spdk_bdev_free_io(bdev_io);
+
+	if (!success) {
+		io->ctx->rc = -EIO;
+		vbdev_lvol_copy_io_next(io);
+		return;
+	}
+
+	io->write = true;
+	vbdev_lvol_copy_submit(io);
+}
+
+static void
+vbdev_lvol_copy_submit(void *arg)
+{
+	struct vbdev_lvol_copy_io *io = arg;
+	struct vbdev_lvol_copy_ctx *ctx = io->ctx;
+	struct spdk_bdev_desc *desc;
+	struct spdk_io_channel *ch;
+	int rc;
+
+	if (io->write) {
+		desc = ctx->dst_desc;
+		ch = ctx->dst_ch;
+		rc = spdk_bdev_write(desc, ch, io->buf, io->offset, io->length,
+				     vbdev_lvol_copy_write_cpl, io);
+	} else {
+		desc = ctx->src_desc;
+		ch = ctx->src_ch;
+		rc = spdk_bdev_read(desc, ch, io->buf, io->offset, io->length,
+				    vbdev_lvol_copy_read_cpl, io);
+	}
+
+	if (rc == -ENOMEM) {
+		io->bdev_io_wait.bdev = spdk_bdev_desc_get_bdev(desc);
+		io->bdev_io_wait.cb_fn = vbdev_lvol_copy_submit;
+		io->bdev_io_wait.cb_arg = io;
+		spdk_bdev_queue_io_wait(io->bdev_io_wait.bdev, ch, &io->bdev_io_wait);
+	} else if (rc != 0) {
+		ctx->rc = rc;
+		vbdev_lvol_copy_io_next(io);
+	}
 }
 
 static int
-vbdev_lvs_get_ctx_size(void)
+vbdev_lvol_copy_open(struct vbdev_lvol_copy_ctx *ctx, const char *bdev_name)
 {
+	struct spdk_bdev *src, *dst;
+	size_t align;
+	uint32_t i;
+	int rc;
+
+	rc = spdk_bdev_open_ext(spdk_bdev_get_name(ctx->lvol->bdev), false, vbdev_lvol_copy_event_cb,
+				ctx, &ctx->src_desc);
+	if (rc != 0) {
+		return rc;
+	}
+	src = spdk_bdev_desc_get_bdev(ctx->src_desc);
+
+	rc = spdk_bdev_open_ext(bdev_name, true, vbdev_lvol_copy_event_cb, ctx, &ctx->dst_desc);
+	if (rc != 0) {
+		SPDK_ERRLOG("Could not open bdev %s\n", bdev_name);
+		return rc;
+	}
+	dst = spdk_bdev_desc_get_bdev(ctx->dst_desc);
+
+	if (dst == src) {
+		SPDK_ERRLOG("Cannot copy lvol %s to itself\n", ctx->lvol->name);
+		return -EINVAL;
+	}
+
+	if ((uint64_t)spdk_bdev_get_block_size(dst) * spdk_bdev_get_num_blocks(dst) <
+	    (uint64_t)spdk_bdev_get_block_size(src) * spdk_bdev_get_num_blocks(src)) {
+		SPDK_ERRLOG("bdev %s is smaller than lvol %s\n", bdev_name, ctx->lvol->name);
+		return -EINVAL;
+	}
+
+	if (ctx->chunk_size % spdk_bdev_get_block_size(dst) != 0 ||
+	    ctx->cluster_size % spdk_bdev_get_block_size(dst) != 0) {
+		SPDK_ERRLOG("Block size of bdev %s is not supported\n", bdev_name);
+		return -EINVAL;
+	}
+
+	rc = spdk_bdev_module_claim_bdev(dst, ctx->dst_desc, &g_lvol_if);
+	if (rc != 0) {
+		SPDK_ERRLOG("Could not claim bdev %s\n", bdev_name);
+		return rc;
+	}
+	ctx->dst_claimed = true;
+
+	ctx->src_ch = spdk_bdev_get_io_channel(ctx->src_desc);
+	ctx->dst_ch = spdk_bdev_get_io_channel(ctx->dst_desc);
+	if (ctx->src_ch == NULL || ctx->dst_ch == NULL) {
+		return -ENOMEM;
+	}
+
+	align = spdk_max(spdk_bdev_get_buf_align(src), spdk_bdev_get_buf_align(dst));
+	for (i = 0; i < ctx->queue_depth; i++) {
+		ctx->ios[i].ctx = ctx;
+		ctx->ios[i].buf = spdk_dma_malloc(ctx->chunk_size, align, NULL);
+		if (ctx->ios[i].buf == NULL) {
+			return -ENOMEM;
+		}
+	}
+
 	return 0;
 }
 
+void
+vbdev_lvol_shallow_copy(struct spdk_lvol *lvol, struct spdk_lvol *base, const char *bdev_name,
+			uint32_t queue_depth, spdk_lvol_op_complete cb_fn, void *cb_arg)
+{
+	struct vbdev_lvol_copy_ctx *ctx;
+	struct spdk_blob_store *bs;
+	spdk_blob_id base_id;
+	uint32_t i;
+	int rc;
+
+	if (lvol == NULL) {
+		SPDK_ERRLOG("lvol does not exist\n");
+		cb_fn(cb_arg, -EINVAL);
+		return;
+	}
+
+	assert(lvol->bdev != NULL);
+	bs = lvol->lvol_store->blobstore;
+
+	if (!spdk_blob_is_read_only(lvol->blob)) {
+		SPDK_ERRLOG("lvol %s must be read only to be copied\n", lvol->name);
+		cb_fn(cb_arg, -EPERM);
+		return;
+	}
+
+	if (queue_depth == 0) {
+		queue_depth = VBDEV_LVOL_COPY_DEFAULT_QUEUE_DEPTH;
+	} else if (queue_depth > VBDEV_LVOL_COPY_MAX_QUEUE_DEPTH) {
+		SPDK_ERRLOG("Queue depth %" PRIu32 " is above the maximum of %d\n", queue_depth,
+			    VBDEV_LVOL_COPY_MAX_QUEUE_DEPTH);
+		cb_fn(cb_arg, -EINVAL);
+		return;
+	}
+
+	/* Without a base, copy only the clusters the lvol itself holds */
+	if (base != NULL) {
+		base_id = base->blob_id;
+	} else {
+		base_id = spdk_blob_get_parent_snapshot(bs, lvol->blob_id);
+	}
+
+	ctx = calloc(1, sizeof(*ctx) + queue_depth * sizeof(struct vbdev_lvol_copy_io));
+	if (ctx == NULL) {
+		cb_fn(cb_arg, -ENOMEM);
+		return;
+	}
+
+	ctx->lvol = lvol;
+	ctx->base_id = base_id;
+	ctx->cluster_size = spdk_bs_get_cluster_size(bs);
+	ctx->chunk_size = spdk_min(ctx->cluster_size, VBDEV_LVOL_COPY_CHUNK_SIZE);
+	ctx->queue_depth = queue_depth;
+	ctx->cb_fn = cb_fn;
+	ctx->cb_arg = cb_arg;
+
+	rc = spdk_blob_get_next_changed_cluster(lvol->blob, base_id, 0, &ctx->cluster);
+	if (rc != 0) {
+		SPDK_ERRLOG("lvol %s is not a snapshot in the chain of lvol %s\n", base->name, lvol->name);
+		ctx->rc = rc;
+		vbdev_lvol_copy_finish(ctx);
+		return;
+	}
+
+	rc = vbdev_lvol_copy_open(ctx, bdev_name);
+	if (rc != 0) {
+		ctx->rc = rc;
+		vbdev_lvol_copy_finish(ctx);
+		return;
+	}
+
+	/* Hold one extra reference, so the copy can't complete while still starting up */
+	ctx->outstanding = queue_depth + 1;
+	for (i = 0; i < queue_depth; i++) {
+		vbdev_lvol_copy_io_next(&ctx->ios[i]);
+	}
+	if (--ctx->outstanding == 0) {
+		vbdev_lvol_copy_finish(ctx);
+	}
+}
+
+struct vbdev_lvol_heatmap_ctx {
+	struct spdk_lvol		*lvol;
+	struct spdk_bdev_desc		*desc;
+	bool				reset;
+	struct vbdev_lvol_heatmap	heatmap;
+	vbdev_lvol_heatmap_cb		cb_fn;
+	void				*cb_arg;
+};
+
+static void
+vbdev_lvol_heatmap_event_cb(enum spdk_bdev_event_type type, struct spdk_bdev *bdev,
+			    void *event_ctx)
+{
+}
+
+static void
+vbdev_lvol_heatmap_channel(struct spdk_io_channel_iter *i)
+{
+	struct vbdev_lvol_heatmap_ctx *ctx = spdk_io_channel_iter_get_ctx(i);
+	struct spdk_io_channel *ch = spdk_io_channel_iter_get_channel(i);
+	struct vbdev_lvol_io_channel *lvol_ch = spdk_io_channel_get_ctx(ch);
+	uint64_t cluster, num_clusters;
+
+	num_clusters = spdk_min(lvol_ch->heatmap_clusters, ctx->heatmap.num_clusters);
+	for (cluster = 0; cluster < num_clusters; cluster++) {
+		ctx->heatmap.reads[cluster] += lvol_ch->heatmap_reads[cluster];
+		ctx->heatmap.writes[cluster] += lvol_ch->heatmap_writes[cluster];
+	}
+
+	if (ctx->reset && lvol_ch->heatmap_clusters > 0) {
+		memset(lvol_ch->heatmap_reads, 0, lvol_ch->heatmap_clusters * sizeof(uint32_t));
+		memset(lvol_ch->heatmap_writes, 0, lvol_ch->heatmap_clusters * sizeof(uint32_t));
+	}
+
+	spdk_for_each_channel_continue(i, 0);
+}
+
+static void
+vbdev_lvol_heatmap_done(struct spdk_io_channel_iter *i, int status)
+{
+	struct vbdev_lvol_heatmap_ctx *ctx = spdk_io_channel_iter_get_ctx(i);
+
+	spdk_bdev_close(ctx->desc);
+	ctx->cb_fn(ctx->cb_arg, status == 0 ? &ctx->heatmap : NULL, status);
+
+	free(ctx->heatmap.reads);
+	free(ctx->heatmap.writes);
+	free(ctx);
+}
+
+void
+vbdev_lvol_get_heatmap(struct spdk_lvol *lvol, bool reset, vbdev_lvol_heatmap_cb cb_fn,
+		       void *cb_arg)
+{
+	struct vbdev_lvol_heatmap_ctx *ctx;
+	int rc;
+
+	if (lvol == NULL || lvol->bdev == NULL) {
+		SPDK_ERRLOG("lvol does not exist\n");
+		cb_fn(cb_arg, NULL, -EINVAL);
+		return;
+	}
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (ctx == NULL) {
+		cb_fn(cb_arg, NULL, -ENOMEM);
+		return;
+	}
+
+	ctx->lvol = lvol;
+	ctx->reset = reset;
+	ctx->cb_fn = cb_fn;
+	ctx->cb_arg = cb_arg;
+	ctx->heatmap.num_clusters = spdk_blob_get_num_clusters(lvol->blob);
+	ctx->heatmap.sample_rate = VBDEV_LVOL_HEATMAP_SAMPLE_RATE;
+	ctx->heatmap.reads = calloc(spdk_max(ctx->heatmap.num_clusters, 1), sizeof(uint64_t));
+	ctx->heatmap.writes = calloc(spdk_max(ctx->heatmap.num_clusters, 1), sizeof(uint64_t));
+	if (ctx->heatmap.reads == NULL || ctx->heatmap.writes == NULL) {
+		rc = -ENOMEM;
+		goto err;
+	}
+
+	/* Keep the bdev, and so the io_device, around until all channels were visited */
+	rc = spdk_bdev_open_ext(spdk_bdev_get_name(lvol->bdev), false, vbdev_lvol_heatmap_event_cb,
+				NULL, &ctx->desc);
+	if (rc != 0) {
+		goto err;
+	}
+
+	spdk_for_each_channel(lvol->bdev, vbdev_lvol_heatmap_channel, ctx, vbdev_lvol_heatmap_done);
+	return;
+
+err:
+	free(ctx->heatmap.reads);
+	free(ctx->heatmap.writes);
+	free(ctx);
+	cb_fn(cb_arg, NULL, rc);
+}
+
+/* Freeze and cut over once a pass leaves no more than this many clusters to copy */
+#define VBDEV_LVOL_MIGRATE_CUTOVER_CLUSTERS	16
+/* Give up on converging and cut over anyway after this many passes */
+#define VBDEV_LVOL_MIGRATE_MAX_PASSES		8
+
+static void vbdev_lvol_migrate_pass(struct vbdev_lvol_migrate *ctx);
+static void vbdev_lvol_migrate_io_next(struct vbdev_lvol_migrate_io *io);
+
+static void
+vbdev_lvol_migrate_finish(struct vbdev_lvol_migrate *ctx)
+{
+	uint32_t i;
+
+	TAILQ_REMOVE(&g_lvol_migrations, ctx, link);
+
+	for (i = 0; i < ctx->queue_depth; i++) {
+		spdk_dma_free(ctx->ios[i].buf);
+	}
+	spdk_bit_array_free(&ctx->pending);
+
+	ctx->cb_fn(ctx->cb_arg, ctx->rc);
+	free(ctx);
+}
+
+static void
+vbdev_lvol_migrate_put_channels(struct vbdev_lvol_migrate *ctx)
+{
+	if (ctx->src_ch != NULL) {
+		spdk_put_io_channel(ctx->src_ch);
+		ctx->src_ch = NULL;
+	}
+	if (ctx->dst_ch != NULL) {
+		spdk_put_io_channel(ctx->dst_ch);
+		ctx->dst_ch = NULL;
+	}
+}
+
+static void
+vbdev_lvol_migrate_resubmit(struct spdk_io_channel *ch, struct vbdev_lvol_io_channel *lvol_ch)
+{
+	struct spdk_bdev_io *bdev_io;
+	TAILQ_HEAD(, spdk_bdev_io) ios;
+
+	TAILQ_INIT(&ios);
+	TAILQ_SWAP(&ios, &lvol_ch->frozen_ios, spdk_bdev_io, module_link);
+
+	while ((bdev_io = TAILQ_FIRST(&ios)) != NULL) {
+		TAILQ_REMOVE(&ios, bdev_io, module_link);
+		vbdev_lvol_submit_request(ch, bdev_io);
+	}
+}
+
+static void
+vbdev_lvol_migrate_dst_destroy_cb(void *cb_arg, int lvolerrno)
+{
+	struct vbdev_lvol_migrate *ctx = cb_arg;
+
+	if (lvolerrno != 0) {
+		SPDK_ERRLOG("Could not delete lvol %s left over from failed migration\n", ctx->lvol->name);
+	}
+
+	vbdev_lvol_migrate_finish(ctx);
+}
+
+static void
+vbdev_lvol_migrate_dst_close_cb(void *cb_arg, int lvolerrno)
+{
+	struct vbdev_lvol_migrate *ctx = cb_arg;
+
+	if (lvolerrno != 0) {
+		vbdev_lvol_migrate_dst_destroy_cb(ctx, lvolerrno);
+		return;
+	}
+
+	spdk_lvol_destroy(ctx->dst, vbdev_lvol_migrate_dst_destroy_cb, ctx);
+}
+
+static void
+vbdev_lvol_migrate_abort_channel(struct spdk_io_channel_iter *i)
+{
+	struct spdk_io_channel *ch = spdk_io_channel_iter_get_channel(i);
+	struct vbdev_lvol_io_channel *lvol_ch = spdk_io_channel_get_ctx(ch);
+
+	spdk_bit_array_free(&lvol_ch->dirty);
+	if (lvol_ch->dst_bs_ch != NULL) {
+		spdk_put_io_channel(lvol_ch->dst_bs_ch);
+		lvol_ch->dst_bs_ch = NULL;
+	}
+	lvol_ch->frozen = false;
+	vbdev_lvol_migrate_resubmit(ch, lvol_ch);
+
+	spdk_for_each_channel_continue(i, 0);
+}
+
+static void
+vbdev_lvol_migrate_abort_done(struct spdk_io_channel_iter *i, int status)
+{
+	struct vbdev_lvol_migrate *ctx = spdk_io_channel_iter_get_ctx(i);
+
+	vbdev_lvol_migrate_put_channels(ctx);
+
+	if (ctx->dst != NULL) {
+		spdk_lvol_close(ctx->dst, vbdev_lvol_migrate_dst_close_cb, ctx);
+	} else {
+		vbdev_lvol_migrate_finish(ctx);
+	}
+}
+
+/* Thaw and stop tracking on all channels, leaving I/O on the source lvol */
+static void
+vbdev_lvol_migrate_abort(struct vbdev_lvol_migrate *ctx)
+{
+	SPDK_ERRLOG("Migration of lvol %s failed: %s\n", ctx->lvol->name, spdk_strerror(-ctx->rc));
+
+	ctx->tracking = false;
+	ctx->frozen = false;
+	spdk_for_each_channel(ctx->bdev, vbdev_lvol_migrate_abort_channel, ctx,
+			      vbdev_lvol_migrate_abort_done);
+}
+
+static void
+vbdev_lvol_migrate_src_destroy_cb(void *cb_arg, int lvolerrno)
+{
+	struct vbdev_lvol_migrate *ctx = cb_arg;
+
+	/* Data is already served from the destination, don't fail the migration for this */
+	if (lvolerrno != 0) {
+		SPDK_ERRLOG("Could not delete migrated lvol %s from its old lvol store\n", ctx->dst->name);
+	}
+
+	vbdev_lvol_migrate_finish(ctx);
+}
+
+static void
+vbdev_lvol_migrate_src_close_cb(void *cb_arg, int lvolerrno)
+{
+	struct vbdev_lvol_migrate *ctx = cb_arg;
+
+	if (lvolerrno != 0) {
+		vbdev_lvol_migrate_src_destroy_cb(ctx, lvolerrno);
+		return;
+	}
+
+	spdk_lvol_destroy(ctx->lvol, vbdev_lvol_migrate_src_destroy_cb, ctx);
+}
+
+static void
+vbdev_lvol_migrate_switch_channel(struct spdk_io_channel_iter *i)
+{
+	struct vbdev_lvol_migrate *ctx = spdk_io_channel_iter_get_ctx(i);
+	struct spdk_io_channel *ch = spdk_io_channel_iter_get_channel(i);
+	struct vbdev_lvol_io_channel *lvol_ch = spdk_io_channel_get_ctx(ch);
+
+	if (lvol_ch->lvol != ctx->dst) {
+		assert(lvol_ch->frozen && lvol_ch->io_outstanding == 0);
+
+		spdk_put_io_channel(lvol_ch->bs_ch);
+		lvol_ch->bs_ch = lvol_ch->dst_bs_ch;
+		lvol_ch->dst_bs_ch = NULL;
+		lvol_ch->lvol = ctx->dst;
+
+		/* Cluster numbers change with the cluster size of the new lvol store */
+		free(lvol_ch->heatmap_reads);
+		free(lvol_ch->heatmap_writes);
+		lvol_ch->heatmap_reads = NULL;
+		lvol_ch->heatmap_writes = NULL;
+		lvol_ch->heatmap_clusters = 0;
+	}
+
+	spdk_bit_array_free(&lvol_ch->dirty);
+	lvol_ch->frozen = false;
+	vbdev_lvol_migrate_resubmit(ch, lvol_ch);
+
+	spdk_for_each_channel_continue(i, 0);
+}
+
+static void
+vbdev_lvol_migrate_switch_done(struct spdk_io_channel_iter *i, int status)
+{
+	struct vbdev_lvol_migrate *ctx = spdk_io_channel_iter_get_ctx(i);
+
+	SPDK_NOTICELOG("lvol %s migrated to lvol store %s\n", ctx->dst->name, ctx->dst_lvs->name);
+
+	vbdev_lvol_migrate_put_channels(ctx);
+	spdk_lvol_close(ctx->lvol, vbdev_lvol_migrate_src_close_cb, ctx);
+}
+
+static void
+vbdev_lvol_migrate_restore_identity_cb(void *cb_arg, int bserrno)
+{
+	struct vbdev_lvol_migrate *ctx = cb_arg;
+
+	if (bserrno != 0) {
+		SPDK_ERRLOG("Could not restore uuid of lvol %s: %s\n", ctx->lvol->name,
+			    spdk_strerror(-bserrno));
+	}
+
+	vbdev_lvol_migrate_abort(ctx);
+}
+
+static void
+vbdev_lvol_migrate_cutover(void *cb_arg, int bserrno)
+{
+	struct vbdev_lvol_migrate *ctx = cb_arg;
+	struct spdk_lvol *lvol = ctx->lvol, *dst = ctx->dst;
+	struct spdk_bdev *bdev = ctx->bdev;
+	int rc;
+
+	if (bserrno != 0) {
+		ctx->rc = bserrno;
+		if (!ctx->released) {
+			vbdev_lvol_migrate_abort(ctx);
+			return;
+		}
+
+		/* The source keeps the lvol, give it its uuid back */
+		rc = spdk_blob_set_xattr(lvol->blob, "uuid", lvol->uuid_str, sizeof(lvol->uuid_str));
+		if (rc != 0) {
+			vbdev_lvol_migrate_restore_identity_cb(ctx, rc);
+			return;
+		}
+		spdk_blob_sync_md(lvol->blob, vbdev_lvol_migrate_restore_identity_cb, ctx);
+		return;
+	}
+
+	/* The destination took over the identity of the source, point the bdev at it. */
+	dst->uuid = lvol->uuid;
+	memcpy(dst->uuid_str, lvol->uuid_str, sizeof(dst->uuid_str));
+	memcpy(dst->unique_id, lvol->unique_id, sizeof(dst->unique_id));
+	bdev->name = dst->unique_id;
+	bdev->ctxt = dst;
+	bdev->optimal_io_boundary = spdk_bs_get_cluster_size(ctx->dst_lvs->blobstore) / bdev->blocklen;
+	dst->bdev = bdev;
+	lvol->bdev = NULL;
+
+	if (_vbdev_lvol_change_bdev_alias(dst, dst->name) != 0) {
+		SPDK_ERRLOG("Could not update alias of migrated lvol %s\n", dst->name);
+	}
+
+	/* Channels created from now on go straight to the destination */
+	ctx->tracking = false;
+	ctx->frozen = false;
+	spdk_for_each_channel(bdev, vbdev_lvol_migrate_switch_channel, ctx,
+			      vbdev_lvol_migrate_switch_done);
+}
+
+static void
+vbdev_lvol_migrate_claim_identity(void *cb_arg, int bserrno)
+{
+	struct vbdev_lvol_migrate *ctx = cb_arg;
+	int rc;
+
+	if (bserrno != 0) {
+		vbdev_lvol_migrate_cutover(ctx, bserrno);
+		return;
+	}
+
+	rc = spdk_blob_set_xattr(ctx->dst->blob, "uuid", ctx->lvol->uuid_str,
+				 sizeof(ctx->lvol->uuid_str));
+	if (rc != 0) {
+		vbdev_lvol_migrate_cutover(ctx, rc);
+		return;
+	}
+
+	spdk_blob_sync_md(ctx->dst->blob, vbdev_lvol_migrate_cutover, ctx);
+}
+
+/* All I/O is frozen and the destination is in sync, make its identity persistent.
+ * The source drops its uuid first, so a crash before the source is deleted never
+ * leaves two lvols with the same uuid. Without one it loads under a name derived
+ * from its blob id. */
+static void
+vbdev_lvol_migrate_sync_identity(struct vbdev_lvol_migrate *ctx)
+{
+	int rc;
+
+	rc = spdk_blob_remove_xattr(ctx->lvol->blob, "uuid");
+	if (rc == -ENOENT) {
+		/* Nothing for the destination to clash with */
+		vbdev_lvol_migrate_claim_identity(ctx, 0);
+		return;
+	} else if (rc != 0) {
+		vbdev_lvol_migrate_cutover(ctx, rc);
+		return;
+	}
+
+	ctx->released = true;
+	spdk_blob_sync_md(ctx->lvol->blob, vbdev_lvol_migrate_claim_identity, ctx);
+}
+
+static void
+vbdev_lvol_migrate_harvest_channel(struct spdk_io_channel_iter *i)
+{
+	struct vbdev_lvol_migrate *ctx = spdk_io_channel_iter_get_ctx(i);
+	struct spdk_io_channel *ch = spdk_io_channel_iter_get_channel(i);
+	struct vbdev_lvol_io_channel *lvol_ch = spdk_io_channel_get_ctx(ch);
+	uint32_t cluster;
+
+	if (lvol_ch->dirty != NULL) {
+		cluster = spdk_bit_array_find_first_set(lvol_ch->dirty, 0);
+		while (cluster != UINT32_MAX) {
+			spdk_bit_array_set(ctx->pending, cluster);
+			spdk_bit_array_clear(lvol_ch->dirty, cluster);
+			cluster = spdk_bit_array_find_first_set(lvol_ch->dirty, cluster + 1);
+		}
+	}
+
+	spdk_for_each_channel_continue(i, 0);
+}
+
+static void
+vbdev_lvol_migrate_harvest_done(struct spdk_io_channel_iter *i, int status)
+{
+	struct vbdev_lvol_migrate *ctx = spdk_io_channel_iter_get_ctx(i);
+
+	vbdev_lvol_migrate_pass(ctx);
+}
+
+static void
+vbdev_lvol_migrate_freeze_channel(struct spdk_io_channel_iter *i)
+{
+	struct vbdev_lvol_migrate *ctx = spdk_io_channel_iter_get_ctx(i);
+	struct spdk_io_channel *ch = spdk_io_channel_iter_get_channel(i);
+	struct vbdev_lvol_io_channel *lvol_ch = spdk_io_channel_get_ctx(ch);
+
+	if (!lvol_ch->frozen) {
+		lvol_ch->dst_bs_ch = spdk_lvol_get_io_channel(ctx->dst);
+		if (lvol_ch->dst_bs_ch == NULL) {
+			spdk_for_each_channel_continue(i, -ENOMEM);
+			return;
+		}
+		lvol_ch->frozen = true;
+	}
+
+	/* Move on once the I/O already submitted to the source has completed */
+	if (lvol_ch->io_outstanding > 0) {
+		lvol_ch->drain_iter = i;
+		return;
+	}
+
+	spdk_for_each_channel_continue(i, 0);
+}
+
+static void
+vbdev_lvol_migrate_freeze_done(struct spdk_io_channel_iter *i, int status)
+{
+	struct vbdev_lvol_migrate *ctx = spdk_io_channel_iter_get_ctx(i);
+
+	if (status != 0) {
+		ctx->rc = status;
+		vbdev_lvol_migrate_abort(ctx);
+		return;
+	}
+
+	/* Pick up what was written since the last pass, for the final copy */
+	spdk_for_each_channel(ctx->bdev, vbdev_lvol_migrate_harvest_channel, ctx,
+			      vbdev_lvol_migrate_harvest_done);
+}
+
+static void
+vbdev_lvol_migrate_copy_done(struct vbdev_lvol_migrate *ctx)
+{
+	if (ctx->rc != 0) {
+		vbdev_lvol_migrate_abort(ctx);
+		return;
+	}
+
+	if (ctx->frozen) {
+		vbdev_lvol_migrate_sync_identity(ctx);
+		return;
+	}
+
+	spdk_for_each_channel(ctx->bdev, vbdev_lvol_migrate_harvest_channel, ctx,
+			      vbdev_lvol_migrate_harvest_done);
+}
+
+static void
+vbdev_lvol_migrate_io_done(struct vbdev_lvol_migrate_io *io, int rc)
+{
+	struct vbdev_lvol_migrate *ctx = io->ctx;
+
+	if (rc != 0 && ctx->rc == 0) {
+		ctx->rc = rc;
+	}
+
+	if (--ctx->outstanding == 0) {
+		vbdev_lvol_migrate_copy_done(ctx);
+	}
+}
+
+static void
+vbdev_lvol_migrate_write_cpl(void *cb_arg, int bserrno)
+{
+	struct vbdev_lvol_migrate_io *io = cb_arg;
+
+	if (bserrno != 0) {
+		vbdev_lvol_migrate_io_done(io, bserrno);
+		return;
+	}
+
+	vbdev_lvol_migrate_io_next(io);
+}
+
+static void
+vbdev_lvol_migrate_read_cpl(void *cb_arg, int bserrno)
+{
+	struct vbdev_lvol_migrate_io *io = cb_arg;
+	struct vbdev_lvol_migrate *ctx = io->ctx;
+
+	if (bserrno != 0) {
+		vbdev_lvol_migrate_io_done(io, bserrno);
+		return;
+	}
+
+	spdk_blob_io_write(ctx->dst->blob, ctx->dst_ch, io->buf, io->offset / ctx->io_unit_size,
+			   io->length / ctx->io_unit_size, vbdev_lvol_migrate_write_cpl, io);
+}
+
+static void
+vbdev_lvol_migrate_io_next(struct vbdev_lvol_migrate_io *io)
+{
+	struct vbdev_lvol_migrate *ctx = io->ctx;
+	uint32_t cluster;
+
+	if (ctx->rc != 0) {
+		vbdev_lvol_migrate_io_done(io, 0);
+		return;
+	}
+
+	if (ctx->offset == 0) {
+		cluster = spdk_bit_array_find_first_set(ctx->pending, ctx->cluster);
+		if (cluster == UINT32_MAX) {
+			vbdev_lvol_migrate_io_done(io, 0);
+			return;
+		}
+		spdk_bit_array_clear(ctx->pending, cluster);
+		ctx->cluster = cluster;
+	}
+
+	io->offset = ctx->cluster * ctx->cluster_size + ctx->offset;
+	io->length = spdk_min(ctx->chunk_size, ctx->cluster_size - ctx->offset);
+	ctx->offset += io->length;
+	if (ctx->offset >= ctx->cluster_size) {
+		ctx->offset = 0;
+		ctx->cluster++;
+	}
+
+	spdk_blob_io_read(ctx->lvol->blob, ctx->src_ch, io->buf, io->offset / ctx->io_unit_size,
+			  io->length / ctx->io_unit_size, vbdev_lvol_migrate_read_cpl, io);
+}
+
+/* Copy every cluster in ctx->pending, then harvest clusters written meanwhile */
+static void
+vbdev_lvol_migrate_copy(struct vbdev_lvol_migrate *ctx)
+{
+	uint32_t i;
+
+	ctx->cluster = 0;
+	ctx->offset = 0;
+
+	/* Hold one extra reference, so the pass can't complete while still starting up */
+	ctx->outstanding = ctx->queue_depth + 1;
+	for (i = 0; i < ctx->queue_depth; i++) {
+		vbdev_lvol_migrate_io_next(&ctx->ios[i]);
+	}
+	if (--ctx->outstanding == 0) {
+		vbdev_lvol_migrate_copy_done(ctx);
+	}
+}
+
+static void
+vbdev_lvol_migrate_pass(struct vbdev_lvol_migrate *ctx)
+{
+	uint32_t dirty = spdk_bit_array_count_set(ctx->pending);
+
+	if (ctx->frozen) {
+		SPDK_INFOLOG(SPDK_LOG_VBDEV_LVOL, "Migrating lvol %s: final copy of %" PRIu32 " clusters\n",
+			     ctx->lvol->name, dirty);
+		vbdev_lvol_migrate_copy(ctx);
+		return;
+	}
+
+	if (ctx->pass > 0 &&
+	    (dirty <= VBDEV_LVOL_MIGRATE_CUTOVER_CLUSTERS || ctx->pass >= VBDEV_LVOL_MIGRATE_MAX_PASSES)) {
+		ctx->frozen = true;
+		spdk_for_each_channel(ctx->bdev, vbdev_lvol_migrate_freeze_channel, ctx,
+				      vbdev_lvol_migrate_freeze_done);
+		return;
+	}
+
+	SPDK_INFOLOG(SPDK_LOG_VBDEV_LVOL, "Migrating lvol %s: pass %" PRIu32 " copies %" PRIu32 " clusters\n",
+		     ctx->lvol->name, ctx->pass, dirty);
+	ctx->pass++;
+	vbdev_lvol_migrate_copy(ctx);
+}
+
+static void
+vbdev_lvol_migrate_track_channel(struct spdk_io_channel_iter *i)
+{
+	struct vbdev_lvol_migrate *ctx = spdk_io_channel_iter_get_ctx(i);
+	struct spdk_io_channel *ch = spdk_io_channel_iter_get_channel(i);
+	struct vbdev_lvol_io_channel *lvol_ch = spdk_io_channel_get_ctx(ch);
+
+	if (lvol_ch->dirty == NULL) {
+		lvol_ch->dirty = spdk_bit_array_create(ctx->num_clusters);
+		if (lvol_ch->dirty == NULL) {
+			spdk_for_each_channel_continue(i, -ENOMEM);
+			return;
+		}
+	}
+
+	spdk_for_each_channel_continue(i, 0);
+}
+
+static void
+vbdev_lvol_migrate_track_done(struct spdk_io_channel_iter *i, int status)
+{
+	struct vbdev_lvol_migrate *ctx = spdk_io_channel_iter_get_ctx(i);
+	uint64_t cluster;
+
+	if (status != 0) {
+		ctx->rc = status;
+		vbdev_lvol_migrate_abort(ctx);
+		return;
+	}
+
+	/* Writes are tracked from here on, so the first pass may copy whatever is there
+	 * now. It starts with every cluster allocated anywhere in the snapshot chain. */
+	spdk_blob_get_next_changed_cluster(ctx->lvol->blob, SPDK_BLOBID_INVALID, 0, &cluster);
+	while (cluster != UINT64_MAX) {
+		spdk_bit_array_set(ctx->pending, cluster);
+		spdk_blob_get_next_changed_cluster(ctx->lvol->blob, SPDK_BLOBID_INVALID, cluster + 1,
+						   &cluster);
+	}
+
+	vbdev_lvol_migrate_pass(ctx);
+}
+
+static void
+vbdev_lvol_migrate_create_cb(void *cb_arg, struct spdk_lvol *dst, int lvolerrno)
+{
+	struct vbdev_lvol_migrate *ctx = cb_arg;
+
+	if (lvolerrno != 0) {
+		SPDK_ERRLOG("Could not create lvol %s in lvol store %s\n", ctx->lvol->name,
+			    ctx->dst_lvs->name);
+		ctx->rc = lvolerrno;
+		vbdev_lvol_migrate_finish(ctx);
+		return;
+	}
+
+	ctx->dst = dst;
+	ctx->src_ch = spdk_lvol_get_io_channel(ctx->lvol);
+	ctx->dst_ch = spdk_lvol_get_io_channel(dst);
+	if (ctx->src_ch == NULL || ctx->dst_ch == NULL) {
+		ctx->rc = -ENOMEM;
+		vbdev_lvol_migrate_abort(ctx);
+		return;
+	}
+
+	ctx->tracking = true;
+	spdk_for_each_channel(ctx->bdev, vbdev_lvol_migrate_track_channel, ctx,
+			      vbdev_lvol_migrate_track_done);
+}
+
+void
+vbdev_lvol_migrate(struct spdk_lvol *lvol, struct spdk_lvol_store *dst_lvs, uint32_t queue_depth,
+		   spdk_lvol_op_complete cb_fn, void *cb_arg)
+{
+	struct vbdev_lvol_migrate *ctx;
+	struct lvol_store_bdev *dst_lvs_bdev;
+	struct spdk_blob_store *bs;
+	size_t align;
+	uint32_t i;
+	int rc;
+
+	if (lvol == NULL || lvol->bdev == NULL) {
+		SPDK_ERRLOG("lvol does not exist\n");
+		cb_fn(cb_arg, -EINVAL);
+		return;
+	}
+
+	bs = lvol->lvol_store->blobstore;
+
+	if (dst_lvs == lvol->lvol_store) {
+		SPDK_ERRLOG("lvol %s is already in lvol store %s\n", lvol->name, dst_lvs->name);
+		cb_fn(cb_arg, -EINVAL);
+		return;
+	}
+
+	if (vbdev_lvol_is_migrating(lvol)) {
+		cb_fn(cb_arg, -EBUSY);
+		return;
+	}
+
+	/* The source is deleted once it was migrated */
+	if (!spdk_lvol_deletable(lvol)) {
+		SPDK_ERRLOG("lvol %s has clones and can't be migrated\n", lvol->name);
+		cb_fn(cb_arg, -EPERM);
+		return;
+	}
+
+	/* The bdev block size stays the same */
+	if (spdk_bs_get_io_unit_size(dst_lvs->blobstore) != spdk_bs_get_io_unit_size(bs)) {
+		SPDK_ERRLOG("lvol store %s has a different io unit size\n", dst_lvs->name);
+		cb_fn(cb_arg, -EINVAL);
+		return;
+	}
+
+	dst_lvs_bdev = vbdev_get_lvs_bdev_by_lvs(dst_lvs);
+	if (dst_lvs_bdev == NULL) {
+		SPDK_ERRLOG("No spdk lvs-bdev pair found for lvol store %s\n", dst_lvs->name);
+		cb_fn(cb_arg, -ENODEV);
+		return;
+	}
+
+	if (queue_depth == 0) {
+		queue_depth = VBDEV_LVOL_COPY_DEFAULT_QUEUE_DEPTH;
+	} else if (queue_depth > VBDEV_LVOL_COPY_MAX_QUEUE_DEPTH) {
+		SPDK_ERRLOG("Queue depth %" PRIu32 " is above the maximum of %d\n", queue_depth,
+			    VBDEV_LVOL_COPY_MAX_QUEUE_DEPTH);
+		cb_fn(cb_arg, -EINVAL);
+		return;
+	}
+
+	ctx = calloc(1, sizeof(*ctx) + queue_depth * sizeof(struct vbdev_lvol_migrate_io));
+	if (ctx == NULL) {
+		cb_fn(cb_arg, -ENOMEM);
+		return;
+	}
+
+	ctx->lvol = lvol;
+	ctx->dst_lvs = dst_lvs;
+	ctx->bdev = lvol->bdev;
+	ctx->num_clusters = spdk_blob_get_num_clusters(lvol->blob);
+	ctx->cluster_size = spdk_bs_get_cluster_size(bs);
+	ctx->chunk_size = spdk_min(ctx->cluster_size, VBDEV_LVOL_COPY_CHUNK_SIZE);
+	ctx->io_unit_size = spdk_bs_get_io_unit_size(bs);
+	ctx->queue_depth = queue_depth;
+	ctx->cb_fn = cb_fn;
+	ctx->cb_arg = cb_arg;
+	TAILQ_INSERT_TAIL(&g_lvol_migrations, ctx, link);
+
+	ctx->pending = spdk_bit_array_create(ctx->num_clusters);
+	if (ctx->pending == NULL) {
+		ctx->rc = -ENOMEM;
+		vbdev_lvol_migrate_finish(ctx);
+		return;
+	}
+
+	align = spdk_max(spdk_bdev_get_buf_align(lvol->bdev), spdk_bdev_get_buf_align(dst_lvs_bdev->bdev));
+	for (i = 0; i < queue_depth; i++) {
+		ctx->ios[i].ctx = ctx;
+		ctx->ios[i].buf = spdk_dma_malloc(ctx->chunk_size, align, NULL);
+		if (ctx->ios[i].buf == NULL) {
+			ctx->rc = -ENOMEM;
+			vbdev_lvol_migrate_finish(ctx);
+			return;
+		}
+	}
+
+	/* A thin source only gets clusters holding data allocated, a thick one keeps its
+	 * space reserved in the destination lvol store as well */
+	rc = spdk_lvol_create(dst_lvs, lvol->name, ctx->num_clusters * ctx->cluster_size,
+			      spdk_blob_is_thin_provisioned(lvol->blob), LVOL_CLEAR_WITH_DEFAULT,
+			      vbdev_lvol_migrate_create_cb, ctx);
+	if (rc != 0) {
+		vbdev_lvol_migrate_create_cb(ctx, NULL, rc);
+	}
+}
+
+static int
+vbdev_lvs_init(void)
+{
+	return 0;
+}
+
+static int
+vbdev_lvs_get_ctx_size(void)
+{
+	return sizeof(struct vbdev_lvol_io);
+}
+
 static void
 _vbdev_lvs_examine_failed(void *cb_arg, int lvserrno)
 {
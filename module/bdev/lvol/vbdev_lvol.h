@@ -82,6 +82,68 @@ void vbdev_lvol_resize(struct spdk_lvol *lvol, uint64_t sz, spdk_lvol_op_complet
  */
 void vbdev_lvol_set_read_only(struct spdk_lvol *lvol, spdk_lvol_op_complete cb_fn, void *cb_arg);
 
+/**
+ * \brief Copy the data of a read only lvol that differs from a base snapshot to another bdev
+ *
+ * Only clusters allocated in the lvol, or in a snapshot between the lvol and the base, are
+ * read and written at the same offset of the destination bdev. Everything else on the
+ * destination bdev is left untouched, so applying the copy on top of a copy of the base
+ * gives a copy of the lvol.
+ *
+ * \param lvol Handle to lvol, must be read only
+ * \param base Snapshot in the chain of lvol, or NULL to copy only the clusters of lvol itself
+ * \param bdev_name Name of the destination bdev
+ * \param queue_depth Number of chunks copied in parallel, 0 for the default
+ * \param cb_fn Completion callback
+ * \param cb_arg Completion callback custom arguments
+ */
+void vbdev_lvol_shallow_copy(struct spdk_lvol *lvol, struct spdk_lvol *base, const char *bdev_name,
+			     uint32_t queue_depth, spdk_lvol_op_complete cb_fn, void *cb_arg);
+
+/**
+ * \brief Move an lvol to another lvol store while it stays online
+ *
+ * The data is copied to a new lvol in dst_lvs while I/O continues. Clusters written
+ * meanwhile are copied again in further passes. Once few enough are left, I/O to the
+ * lvol bdev is briefly queued for a final copy and the bdev is switched over to the new
+ * lvol, which takes the UUID of the source. The source lvol is deleted afterwards.
+ *
+ * \param lvol Handle to lvol, must not have clones
+ * \param dst_lvs Lvol store to move the lvol to
+ * \param queue_depth Number of chunks copied in parallel, 0 for the default
+ * \param cb_fn Completion callback
+ * \param cb_arg Completion callback custom arguments
+ */
+void vbdev_lvol_migrate(struct spdk_lvol *lvol, struct spdk_lvol_store *dst_lvs,
+			uint32_t queue_depth, spdk_lvol_op_complete cb_fn, void *cb_arg);
+
+struct vbdev_lvol_heatmap {
+	/* Number of clusters of the lvol */
+	uint64_t	num_clusters;
+	/* One in sample_rate I/Os of each channel is counted */
+	uint32_t	sample_rate;
+	/* Sampled number of reads and writes of each cluster */
+	uint64_t	*reads;
+	uint64_t	*writes;
+};
+
+typedef void (*vbdev_lvol_heatmap_cb)(void *cb_arg, const struct vbdev_lvol_heatmap *heatmap,
+				      int rc);
+
+/**
+ * \brief Get the sampled per cluster I/O heatmap of an lvol
+ *
+ * Counters are kept per I/O channel and summed up over all channels of the lvol.
+ * Writes include unmap and write zeroes.
+ *
+ * \param lvol Handle to lvol
+ * \param reset Clear the counters once they have been read
+ * \param cb_fn Completion callback, heatmap is only valid for the duration of the call
+ * \param cb_arg Completion callback custom arguments
+ */
+void vbdev_lvol_get_heatmap(struct spdk_lvol *lvol, bool reset, vbdev_lvol_heatmap_cb cb_fn,
+			    void *cb_arg);
+
 void vbdev_lvol_rename(struct spdk_lvol *lvol, const char *new_lvol_name,
 		       spdk_lvol_op_complete cb_fn, void *cb_arg);
 
@@ -764,6 +764,357 @@ cleanup:
 SPDK_RPC_REGISTER("bdev_lvol_decouple_parent", rpc_bdev_lvol_decouple_parent, SPDK_RPC_RUNTIME)
 SPDK_RPC_REGISTER_ALIAS_DEPRECATED(bdev_lvol_decouple_parent, decouple_parent_lvol_bdev)
 
+struct rpc_bdev_lvol_flatten {
+	char *name;
+	uint64_t max_mbytes_per_sec;
+};
+
+static void
+free_rpc_bdev_lvol_flatten(struct rpc_bdev_lvol_flatten *req)
+{
+	free(req->name);
+}
+
+static const struct spdk_json_object_decoder rpc_bdev_lvol_flatten_decoders[] = {
+	{"name", offsetof(struct rpc_bdev_lvol_flatten, name), spdk_json_decode_string},
+	{"max_mbytes_per_sec", offsetof(struct rpc_bdev_lvol_flatten, max_mbytes_per_sec), spdk_json_decode_uint64, true},
+};
+
+static void
+rpc_bdev_lvol_flatten(struct spdk_jsonrpc_request *request,
+		      const struct spdk_json_val *params)
+{
+	struct rpc_bdev_lvol_flatten req = {};
+	struct spdk_bdev *bdev;
+	struct spdk_lvol *lvol;
+
+	SPDK_INFOLOG(SPDK_LOG_LVOL_RPC, "Flattening lvol\n");
+
+	if (spdk_json_decode_object(params, rpc_bdev_lvol_flatten_decoders,
+				    SPDK_COUNTOF(rpc_bdev_lvol_flatten_decoders),
+				    &req)) {
+		SPDK_INFOLOG(SPDK_LOG_LVOL_RPC, "spdk_json_decode_object failed\n");
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INTERNAL_ERROR,
+						 "spdk_json_decode_object failed");
+		goto cleanup;
+	}
+
+	bdev = spdk_bdev_get_by_name(req.name);
+	if (bdev == NULL) {
+		SPDK_ERRLOG("bdev '%s' does not exist\n", req.name);
+		spdk_jsonrpc_send_error_response(request, -ENODEV, spdk_strerror(ENODEV));
+		goto cleanup;
+	}
+
+	lvol = vbdev_lvol_get_from_bdev(bdev);
+	if (lvol == NULL) {
+		SPDK_ERRLOG("lvol does not exist\n");
+		spdk_jsonrpc_send_error_response(request, -ENODEV, spdk_strerror(ENODEV));
+		goto cleanup;
+	}
+
+	spdk_lvol_flatten(lvol, req.max_mbytes_per_sec * 1024 * 1024, rpc_bdev_lvol_inflate_cb,
+			  request);
+
+cleanup:
+	free_rpc_bdev_lvol_flatten(&req);
+}
+
+SPDK_RPC_REGISTER("bdev_lvol_flatten", rpc_bdev_lvol_flatten, SPDK_RPC_RUNTIME)
+
+struct rpc_bdev_lvol_shallow_copy {
+	char *name;
+	char *dst_bdev_name;
+	char *base_snapshot;
+	uint32_t queue_depth;
+};
+
+static void
+free_rpc_bdev_lvol_shallow_copy(struct rpc_bdev_lvol_shallow_copy *req)
+{
+	free(req->name);
+	free(req->dst_bdev_name);
+	free(req->base_snapshot);
+}
+
+static const struct spdk_json_object_decoder rpc_bdev_lvol_shallow_copy_decoders[] = {
+	{"name", offsetof(struct rpc_bdev_lvol_shallow_copy, name), spdk_json_decode_string},
+	{"dst_bdev_name", offsetof(struct rpc_bdev_lvol_shallow_copy, dst_bdev_name), spdk_json_decode_string},
+	{"base_snapshot", offsetof(struct rpc_bdev_lvol_shallow_copy, base_snapshot), spdk_json_decode_string, true},
+	{"queue_depth", offsetof(struct rpc_bdev_lvol_shallow_copy, queue_depth), spdk_json_decode_uint32, true},
+};
+
+static void
+rpc_bdev_lvol_shallow_copy_cb(void *cb_arg, int lvolerrno)
+{
+	struct spdk_json_write_ctx *w;
+	struct spdk_jsonrpc_request *request = cb_arg;
+
+	if (lvolerrno != 0) {
+		spdk_jsonrpc_send_error_response(request, lvolerrno, spdk_strerror(-lvolerrno));
+		return;
+	}
+
+	w = spdk_jsonrpc_begin_result(request);
+	spdk_json_write_bool(w, true);
+	spdk_jsonrpc_end_result(request, w);
+}
+
+static void
+rpc_bdev_lvol_shallow_copy(struct spdk_jsonrpc_request *request,
+			   const struct spdk_json_val *params)
+{
+	struct rpc_bdev_lvol_shallow_copy req = {};
+	struct spdk_bdev *bdev;
+	struct spdk_lvol *lvol, *base = NULL;
+
+	SPDK_INFOLOG(SPDK_LOG_LVOL_RPC, "Copying lvol\n");
+
+	if (spdk_json_decode_object(params, rpc_bdev_lvol_shallow_copy_decoders,
+				    SPDK_COUNTOF(rpc_bdev_lvol_shallow_copy_decoders),
+				    &req)) {
+		SPDK_INFOLOG(SPDK_LOG_LVOL_RPC, "spdk_json_decode_object failed\n");
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INTERNAL_ERROR,
+						 "spdk_json_decode_object failed");
+		goto cleanup;
+	}
+
+	bdev = spdk_bdev_get_by_name(req.name);
+	if (bdev == NULL) {
+		SPDK_ERRLOG("bdev '%s' does not exist\n", req.name);
+		spdk_jsonrpc_send_error_response(request, -ENODEV, spdk_strerror(ENODEV));
+		goto cleanup;
+	}
+
+	lvol = vbdev_lvol_get_from_bdev(bdev);
+	if (lvol == NULL) {
+		SPDK_ERRLOG("lvol does not exist\n");
+		spdk_jsonrpc_send_error_response(request, -ENODEV, spdk_strerror(ENODEV));
+		goto cleanup;
+	}
+
+	if (req.base_snapshot != NULL) {
+		bdev = spdk_bdev_get_by_name(req.base_snapshot);
+		if (bdev == NULL) {
+			SPDK_ERRLOG("bdev '%s' does not exist\n", req.base_snapshot);
+			spdk_jsonrpc_send_error_response(request, -ENODEV, spdk_strerror(ENODEV));
+			goto cleanup;
+		}
+
+		base = vbdev_lvol_get_from_bdev(bdev);
+		if (base == NULL || base->lvol_store != lvol->lvol_store) {
+			SPDK_ERRLOG("bdev '%s' is not an lvol in the same lvol store\n", req.base_snapshot);
+			spdk_jsonrpc_send_error_response(request, -EINVAL, spdk_strerror(EINVAL));
+			goto cleanup;
+		}
+	}
+
+	vbdev_lvol_shallow_copy(lvol, base, req.dst_bdev_name, req.queue_depth,
+				rpc_bdev_lvol_shallow_copy_cb, request);
+
+cleanup:
+	free_rpc_bdev_lvol_shallow_copy(&req);
+}
+
+SPDK_RPC_REGISTER("bdev_lvol_shallow_copy", rpc_bdev_lvol_shallow_copy, SPDK_RPC_RUNTIME)
+
+struct rpc_bdev_lvol_migrate {
+	char *name;
+	char *uuid;
+	char *lvs_name;
+	uint32_t queue_depth;
+};
+
+static void
+free_rpc_bdev_lvol_migrate(struct rpc_bdev_lvol_migrate *req)
+{
+	free(req->name);
+	free(req->uuid);
+	free(req->lvs_name);
+}
+
+static const struct spdk_json_object_decoder rpc_bdev_lvol_migrate_decoders[] = {
+	{"name", offsetof(struct rpc_bdev_lvol_migrate, name), spdk_json_decode_string},
+	{"uuid", offsetof(struct rpc_bdev_lvol_migrate, uuid), spdk_json_decode_string, true},
+	{"lvs_name", offsetof(struct rpc_bdev_lvol_migrate, lvs_name), spdk_json_decode_string, true},
+	{"queue_depth", offsetof(struct rpc_bdev_lvol_migrate, queue_depth), spdk_json_decode_uint32, true},
+};
+
+static void
+rpc_bdev_lvol_migrate_cb(void *cb_arg, int lvolerrno)
+{
+	struct spdk_json_write_ctx *w;
+	struct spdk_jsonrpc_request *request = cb_arg;
+
+	if (lvolerrno != 0) {
+		spdk_jsonrpc_send_error_response(request, lvolerrno, spdk_strerror(-lvolerrno));
+		return;
+	}
+
+	w = spdk_jsonrpc_begin_result(request);
+	spdk_json_write_bool(w, true);
+	spdk_jsonrpc_end_result(request, w);
+}
+
+static void
+rpc_bdev_lvol_migrate(struct spdk_jsonrpc_request *request,
+		      const struct spdk_json_val *params)
+{
+	struct rpc_bdev_lvol_migrate req = {};
+	struct spdk_lvol_store *lvs = NULL;
+	struct spdk_bdev *bdev;
+	struct spdk_lvol *lvol;
+	int rc;
+
+	SPDK_INFOLOG(SPDK_LOG_LVOL_RPC, "Migrating lvol\n");
+
+	if (spdk_json_decode_object(params, rpc_bdev_lvol_migrate_decoders,
+				    SPDK_COUNTOF(rpc_bdev_lvol_migrate_decoders),
+				    &req)) {
+		SPDK_INFOLOG(SPDK_LOG_LVOL_RPC, "spdk_json_decode_object failed\n");
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INTERNAL_ERROR,
+						 "spdk_json_decode_object failed");
+		goto cleanup;
+	}
+
+	rc = vbdev_get_lvol_store_by_uuid_xor_name(req.uuid, req.lvs_name, &lvs);
+	if (rc != 0) {
+		spdk_jsonrpc_send_error_response(request, rc, spdk_strerror(-rc));
+		goto cleanup;
+	}
+
+	bdev = spdk_bdev_get_by_name(req.name);
+	if (bdev == NULL) {
+		SPDK_ERRLOG("bdev '%s' does not exist\n", req.name);
+		spdk_jsonrpc_send_error_response(request, -ENODEV, spdk_strerror(ENODEV));
+		goto cleanup;
+	}
+
+	lvol = vbdev_lvol_get_from_bdev(bdev);
+	if (lvol == NULL) {
+		SPDK_ERRLOG("lvol does not exist\n");
+		spdk_jsonrpc_send_error_response(request, -ENODEV, spdk_strerror(ENODEV));
+		goto cleanup;
+	}
+
+	vbdev_lvol_migrate(lvol, lvs, req.queue_depth, rpc_bdev_lvol_migrate_cb, request);
+
+cleanup:
+	free_rpc_bdev_lvol_migrate(&req);
+}
+
+SPDK_RPC_REGISTER("bdev_lvol_migrate", rpc_bdev_lvol_migrate, SPDK_RPC_RUNTIME)
+
+struct rpc_bdev_lvol_get_heatmap {
+	char *name;
+	bool reset;
+};
+
+static void
+free_rpc_bdev_lvol_get_heatmap(struct rpc_bdev_lvol_get_heatmap *req)
+{
+	free(req->name);
+}
+
+static const struct spdk_json_object_decoder rpc_bdev_lvol_get_heatmap_decoders[] = {
+	{"name", offsetof(struct rpc_bdev_lvol_get_heatmap, name), spdk_json_decode_string},
+	{"reset", offsetof(struct rpc_bdev_lvol_get_heatmap, reset), spdk_json_decode_bool, true},
+};
+
+struct rpc_bdev_lvol_get_heatmap_ctx {
+	struct spdk_jsonrpc_request *request;
+	struct spdk_lvol *lvol;
+};
+
+static void
+rpc_bdev_lvol_get_heatmap_cb(void *cb_arg, const struct vbdev_lvol_heatmap *heatmap,
+			     int lvolerrno)
+{
+	struct rpc_bdev_lvol_get_heatmap_ctx *ctx = cb_arg;
+	struct spdk_json_write_ctx *w;
+	uint64_t cluster;
+
+	if (lvolerrno != 0) {
+		spdk_jsonrpc_send_error_response(ctx->request, lvolerrno, spdk_strerror(-lvolerrno));
+		free(ctx);
+		return;
+	}
+
+	w = spdk_jsonrpc_begin_result(ctx->request);
+	spdk_json_write_object_begin(w);
+	spdk_json_write_named_string(w, "name", spdk_bdev_get_name(ctx->lvol->bdev));
+	spdk_json_write_named_uint64(w, "cluster_size",
+				     spdk_bs_get_cluster_size(ctx->lvol->lvol_store->blobstore));
+	spdk_json_write_named_uint32(w, "sample_rate", heatmap->sample_rate);
+
+	/* Only list clusters that were hit */
+	spdk_json_write_named_array_begin(w, "clusters");
+	for (cluster = 0; cluster < heatmap->num_clusters; cluster++) {
+		if (heatmap->reads[cluster] == 0 && heatmap->writes[cluster] == 0) {
+			continue;
+		}
+
+		spdk_json_write_object_begin(w);
+		spdk_json_write_named_uint64(w, "cluster", cluster);
+		spdk_json_write_named_uint64(w, "reads", heatmap->reads[cluster]);
+		spdk_json_write_named_uint64(w, "writes", heatmap->writes[cluster]);
+		spdk_json_write_object_end(w);
+	}
+	spdk_json_write_array_end(w);
+
+	spdk_json_write_object_end(w);
+	spdk_jsonrpc_end_result(ctx->request, w);
+	free(ctx);
+}
+
+static void
+rpc_bdev_lvol_get_heatmap(struct spdk_jsonrpc_request *request,
+			  const struct spdk_json_val *params)
+{
+	struct rpc_bdev_lvol_get_heatmap req = {};
+	struct rpc_bdev_lvol_get_heatmap_ctx *ctx;
+	struct spdk_bdev *bdev;
+	struct spdk_lvol *lvol;
+
+	if (spdk_json_decode_object(params, rpc_bdev_lvol_get_heatmap_decoders,
+				    SPDK_COUNTOF(rpc_bdev_lvol_get_heatmap_decoders),
+				    &req)) {
+		SPDK_INFOLOG(SPDK_LOG_LVOL_RPC, "spdk_json_decode_object failed\n");
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INTERNAL_ERROR,
+						 "spdk_json_decode_object failed");
+		goto cleanup;
+	}
+
+	bdev = spdk_bdev_get_by_name(req.name);
+	if (bdev == NULL) {
+		SPDK_ERRLOG("bdev '%s' does not exist\n", req.name);
+		spdk_jsonrpc_send_error_response(request, -ENODEV, spdk_strerror(ENODEV));
+		goto cleanup;
+	}
+
+	lvol = vbdev_lvol_get_from_bdev(bdev);
+	if (lvol == NULL) {
+		SPDK_ERRLOG("lvol does not exist\n");
+		spdk_jsonrpc_send_error_response(request, -ENODEV, spdk_strerror(ENODEV));
+		goto cleanup;
+	}
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (ctx == NULL) {
+		spdk_jsonrpc_send_error_response(request, -ENOMEM, spdk_strerror(ENOMEM));
+		goto cleanup;
+	}
+	ctx->request = request;
+	ctx->lvol = lvol;
+
+	vbdev_lvol_get_heatmap(lvol, req.reset, rpc_bdev_lvol_get_heatmap_cb, ctx);
+
+cleanup:
+	free_rpc_bdev_lvol_get_heatmap(&req);
+}
+
+SPDK_RPC_REGISTER("bdev_lvol_get_heatmap", rpc_bdev_lvol_get_heatmap, SPDK_RPC_RUNTIME)
+
 struct rpc_bdev_lvol_resize {
 	char *name;
 	uint64_t size;
@@ -218,6 +218,21 @@ bdev_malloc_unmap(struct malloc_disk *mdisk,
 				      byte_count, malloc_done, task);
 }
 
+static int
+bdev_malloc_copy(struct malloc_disk *mdisk, struct spdk_io_channel *ch,
+		 struct malloc_task *task,
+		 uint64_t dst_offset, uint64_t src_offset, size_t len)
+{
+	SPDK_DEBUGLOG(SPDK_LOG_BDEV_MALLOC, "copy %zu bytes from offset %#" PRIx64 " to offset %#" PRIx64 "\n",
+		      len, src_offset, dst_offset);
+
+	task->status = SPDK_BDEV_IO_STATUS_SUCCESS;
+	task->num_outstanding = 1;
+
+	return spdk_accel_submit_copy(ch, mdisk->malloc_buf + dst_offset,
+				      mdisk->malloc_buf + src_offset, len, malloc_done, task);
+}
+
 static int64_t
 bdev_malloc_flush(struct malloc_disk *mdisk, struct malloc_task *task,
 		  uint64_t offset, uint64_t nbytes)
@@ -311,6 +326,13 @@ static int _bdev_malloc_submit_request(struct spdk_io_channel *ch, struct spdk_b
 	case SPDK_BDEV_IO_TYPE_ABORT:
 		spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_FAILED);
 		return 0;
+	case SPDK_BDEV_IO_TYPE_COPY:
+		return bdev_malloc_copy((struct malloc_disk *)bdev_io->bdev->ctxt,
+					ch,
+					(struct malloc_task *)bdev_io->driver_ctx,
+					bdev_io->u.bdev.offset_blocks * block_size,
+					bdev_io->u.bdev.copy.src_offset_blocks * block_size,
+					bdev_io->u.bdev.num_blocks * block_size);
 	default:
 		return -1;
 	}
@@ -336,6 +358,7 @@ bdev_malloc_io_type_supported(void *ctx, enum spdk_bdev_io_type io_type)
 	case SPDK_BDEV_IO_TYPE_WRITE_ZEROES:
 	case SPDK_BDEV_IO_TYPE_ZCOPY:
 	case SPDK_BDEV_IO_TYPE_ABORT:
+	case SPDK_BDEV_IO_TYPE_COPY:
 		return true;
 
 	default:
@@ -89,6 +89,12 @@ struct nvme_bdev_io {
 
 	/** Keeps track if first of fused commands was submitted */
 	bool first_fused_submitted;
+
+	/** I/O path the request was submitted through */
+	struct nvme_io_path *io_path;
+
+	/** Number of times the request was resubmitted after a path error */
+	uint32_t num_failovers;
 };
 
 struct nvme_probe_ctx {
@@ -138,33 +144,37 @@ static void nvme_ctrlr_populate_namespaces(struct nvme_bdev_ctrlr *nvme_bdev_ctr
 static void nvme_ctrlr_populate_namespaces_done(struct nvme_async_probe_ctx *ctx);
 static int bdev_nvme_library_init(void);
 static void bdev_nvme_library_fini(void);
-static int bdev_nvme_readv(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
+static int bdev_nvme_readv(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
 			   struct nvme_bdev_io *bio,
-			   struct iovec *iov, int iovcnt, void *md, uint64_t lba_count, uint64_t lba);
-static int bdev_nvme_no_pi_readv(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
+			   struct iovec *iov, int iovcnt, void *md, uint64_t lba_count, uint64_t lba,
+			   uint32_t flags);
+static int bdev_nvme_no_pi_readv(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
 				 struct nvme_bdev_io *bio,
 				 struct iovec *iov, int iovcnt, void *md, uint64_t lba_count, uint64_t lba);
-static int bdev_nvme_writev(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
+static int bdev_nvme_writev(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
 			    struct nvme_bdev_io *bio,
-			    struct iovec *iov, int iovcnt, void *md, uint64_t lba_count, uint64_t lba);
-static int bdev_nvme_comparev(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
+			    struct iovec *iov, int iovcnt, void *md, uint64_t lba_count, uint64_t lba,
+			    uint32_t flags);
+static int bdev_nvme_comparev(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
 			      struct nvme_bdev_io *bio,
-			      struct iovec *iov, int iovcnt, void *md, uint64_t lba_count, uint64_t lba);
-static int bdev_nvme_comparev_and_writev(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
+			      struct iovec *iov, int iovcnt, void *md, uint64_t lba_count, uint64_t lba,
+			      uint32_t flags);
+static int bdev_nvme_comparev_and_writev(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
 		struct nvme_bdev_io *bio, struct iovec *cmp_iov, int cmp_iovcnt, struct iovec *write_iov,
-		int write_iovcnt, void *md, uint64_t lba_count, uint64_t lba);
+		int write_iovcnt, void *md, uint64_t lba_count, uint64_t lba, uint32_t flags);
 static int bdev_nvme_admin_passthru(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
 				    struct nvme_bdev_io *bio,
 				    struct spdk_nvme_cmd *cmd, void *buf, size_t nbytes);
-static int bdev_nvme_io_passthru(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
+static int bdev_nvme_io_passthru(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
 				 struct nvme_bdev_io *bio,
 				 struct spdk_nvme_cmd *cmd, void *buf, size_t nbytes);
-static int bdev_nvme_io_passthru_md(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
+static int bdev_nvme_io_passthru_md(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
 				    struct nvme_bdev_io *bio,
 				    struct spdk_nvme_cmd *cmd, void *buf, size_t nbytes, void *md_buf, size_t md_len);
 static int bdev_nvme_reset(struct nvme_bdev_ctrlr *nvme_bdev_ctrlr, struct nvme_bdev_io *bio);
 static int bdev_nvme_abort(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
 			   struct nvme_bdev_io *bio, struct nvme_bdev_io *bio_to_abort);
+static void bdev_nvme_read_ana_log_page(struct nvme_bdev_ctrlr *nvme_bdev_ctrlr);
 
 typedef void (*populate_namespace_fn)(struct nvme_bdev_ctrlr *nvme_bdev_ctrlr,
 				      struct nvme_bdev_ns *nvme_ns, struct nvme_async_probe_ctx *ctx);
@@ -266,15 +276,14 @@ static int
 bdev_nvme_poll_adminq(void *arg)
 {
 	int32_t rc;
-	struct spdk_nvme_ctrlr *ctrlr = arg;
-	struct nvme_bdev_ctrlr *nvme_bdev_ctrlr;
+	struct nvme_bdev_ctrlr *nvme_bdev_ctrlr = arg;
 
-	rc = spdk_nvme_ctrlr_process_admin_completions(ctrlr);
+	rc = spdk_nvme_ctrlr_process_admin_completions(nvme_bdev_ctrlr->ctrlr);
 
 	if (rc < 0) {
-		nvme_bdev_ctrlr = nvme_bdev_ctrlr_get(spdk_nvme_ctrlr_get_transport_id(ctrlr));
-		assert(nvme_bdev_ctrlr != NULL);
 		bdev_nvme_reset(nvme_bdev_ctrlr, NULL);
+	} else if (spdk_unlikely(nvme_bdev_ctrlr->ana_log_page_stale)) {
+		bdev_nvme_read_ana_log_page(nvme_bdev_ctrlr);
 	}
 
 	return rc == 0 ? SPDK_POLLER_IDLE : SPDK_POLLER_BUSY;
@@ -495,15 +504,225 @@ bdev_nvme_reset(struct nvme_bdev_ctrlr *nvme_bdev_ctrlr, struct nvme_bdev_io *bi
 }
 
 static int
-bdev_nvme_unmap(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
+bdev_nvme_unmap(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
 		struct nvme_bdev_io *bio,
 		uint64_t offset_blocks,
 		uint64_t num_blocks);
 
+static inline struct spdk_nvme_ns *
+bdev_nvme_io_path_get_ns(struct nvme_io_path *io_path, struct nvme_bdev *nbdev)
+{
+	return io_path->ctrlr->namespaces[nbdev->nvme_ns->id - 1]->ns;
+}
+
+static inline bool
+bdev_nvme_io_path_is_usable(struct nvme_io_path *io_path, struct nvme_bdev *nbdev,
+			    bool *optimized)
+{
+	struct nvme_bdev_ctrlr *nvme_bdev_ctrlr = io_path->ctrlr;
+	struct nvme_bdev_ns *nvme_ns;
+	uint32_t nsid = nbdev->nvme_ns->id;
+
+	if (spdk_unlikely(io_path->nvme_ch->qpair == NULL || nsid > nvme_bdev_ctrlr->num_ns)) {
+		/* The controller of this path is resetting or doesn't know the namespace. */
+		return false;
+	}
+
+	nvme_ns = nvme_bdev_ctrlr->namespaces[nsid - 1];
+	if (spdk_unlikely(nvme_ns->ns == NULL)) {
+		return false;
+	}
+
+	if (nvme_bdev_ctrlr->ana_log_page == NULL) {
+		*optimized = true;
+		return true;
+	}
+
+	switch (nvme_ns->ana_state) {
+	case SPDK_NVME_ANA_OPTIMIZED_STATE:
+		*optimized = true;
+		return true;
+	case SPDK_NVME_ANA_NON_OPTIMIZED_STATE:
+		*optimized = false;
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* Check whether an I/O to the bdev could be submitted on any path, without selecting one. */
+static bool
+bdev_nvme_has_io_path(struct nvme_bdev *nbdev, struct nvme_io_channel *nvme_ch)
+{
+	struct nvme_io_path *io_path;
+	bool optimized;
+
+	TAILQ_FOREACH(io_path, &nvme_ch->io_paths, tailq) {
+		if (bdev_nvme_io_path_is_usable(io_path, nbdev, &optimized)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Select the path for an I/O to the bdev. Optimized paths are always
+ * preferred over non-optimized ones, the multipath policy of the bdev's
+ * controller decides between the paths in the same ANA state.
+ */
+static struct nvme_io_path *
+bdev_nvme_find_io_path(struct nvme_bdev *nbdev, struct nvme_io_channel *nvme_ch,
+		       struct nvme_io_path *exclude)
+{
+	enum nvme_bdev_multipath_policy policy = nbdev->nvme_bdev_ctrlr->mp_policy;
+	struct nvme_io_path *io_path, *start, *best = NULL;
+	bool optimized, best_optimized = false;
+
+	start = TAILQ_FIRST(&nvme_ch->io_paths);
+	if (policy == NVME_BDEV_MP_POLICY_ROUND_ROBIN && nvme_ch->last_path != NULL &&
+	    TAILQ_NEXT(nvme_ch->last_path, tailq) != NULL) {
+		start = TAILQ_NEXT(nvme_ch->last_path, tailq);
+	}
+
+	io_path = start;
+	do {
+		if (io_path != exclude && bdev_nvme_io_path_is_usable(io_path, nbdev, &optimized)) {
+			if (best == NULL || (optimized && !best_optimized) ||
+			    (optimized == best_optimized && policy == NVME_BDEV_MP_POLICY_QUEUE_DEPTH &&
+			     io_path->num_outstanding < best->num_outstanding)) {
+				best = io_path;
+				best_optimized = optimized;
+			}
+
+			if (best_optimized && policy != NVME_BDEV_MP_POLICY_QUEUE_DEPTH) {
+				break;
+			}
+		}
+
+		io_path = TAILQ_NEXT(io_path, tailq);
+		if (io_path == NULL) {
+			io_path = TAILQ_FIRST(&nvme_ch->io_paths);
+		}
+	} while (io_path != start);
+
+	if (best != NULL && policy == NVME_BDEV_MP_POLICY_ROUND_ROBIN) {
+		nvme_ch->last_path = best;
+	}
+
+	return best;
+}
+
+static int
+bdev_nvme_submit_io_on_path(struct nvme_io_path *io_path, struct spdk_bdev_io *bdev_io)
+{
+	struct nvme_bdev *nbdev = (struct nvme_bdev *)bdev_io->bdev->ctxt;
+	struct nvme_bdev_io *nbdev_io = (struct nvme_bdev_io *)bdev_io->driver_ctx;
+	struct spdk_nvme_ns *ns = bdev_nvme_io_path_get_ns(io_path, nbdev);
+	struct spdk_nvme_qpair *qpair = io_path->nvme_ch->qpair;
+	int rc;
+
+	nbdev_io->io_path = io_path;
+	io_path->num_outstanding++;
+
+	switch (bdev_io->type) {
+	case SPDK_BDEV_IO_TYPE_READ:
+		rc = bdev_nvme_readv(ns,
+				     qpair,
+				     nbdev_io,
+				     bdev_io->u.bdev.iovs,
+				     bdev_io->u.bdev.iovcnt,
+				     bdev_io->u.bdev.md_buf,
+				     bdev_io->u.bdev.num_blocks,
+				     bdev_io->u.bdev.offset_blocks,
+				     nbdev->disk.dif_check_flags);
+		break;
+
+	case SPDK_BDEV_IO_TYPE_WRITE:
+		rc = bdev_nvme_writev(ns,
+				      qpair,
+				      nbdev_io,
+				      bdev_io->u.bdev.iovs,
+				      bdev_io->u.bdev.iovcnt,
+				      bdev_io->u.bdev.md_buf,
+				      bdev_io->u.bdev.num_blocks,
+				      bdev_io->u.bdev.offset_blocks,
+				      nbdev->disk.dif_check_flags);
+		break;
+
+	case SPDK_BDEV_IO_TYPE_COMPARE:
+		rc = bdev_nvme_comparev(ns,
+					qpair,
+					nbdev_io,
+					bdev_io->u.bdev.iovs,
+					bdev_io->u.bdev.iovcnt,
+					bdev_io->u.bdev.md_buf,
+					bdev_io->u.bdev.num_blocks,
+					bdev_io->u.bdev.offset_blocks,
+					nbdev->disk.dif_check_flags);
+		break;
+
+	case SPDK_BDEV_IO_TYPE_COMPARE_AND_WRITE:
+		rc = bdev_nvme_comparev_and_writev(ns,
+						   qpair,
+						   nbdev_io,
+						   bdev_io->u.bdev.iovs,
+						   bdev_io->u.bdev.iovcnt,
+						   bdev_io->u.bdev.fused_iovs,
+						   bdev_io->u.bdev.fused_iovcnt,
+						   bdev_io->u.bdev.md_buf,
+						   bdev_io->u.bdev.num_blocks,
+						   bdev_io->u.bdev.offset_blocks,
+						   nbdev->disk.dif_check_flags);
+		break;
+
+	case SPDK_BDEV_IO_TYPE_WRITE_ZEROES:
+	case SPDK_BDEV_IO_TYPE_UNMAP:
+		rc = bdev_nvme_unmap(ns,
+				     qpair,
+				     nbdev_io,
+				     bdev_io->u.bdev.offset_blocks,
+				     bdev_io->u.bdev.num_blocks);
+		break;
+
+	case SPDK_BDEV_IO_TYPE_NVME_IO:
+		rc = bdev_nvme_io_passthru(ns,
+					   qpair,
+					   nbdev_io,
+					   &bdev_io->u.nvme_passthru.cmd,
+					   bdev_io->u.nvme_passthru.buf,
+					   bdev_io->u.nvme_passthru.nbytes);
+		break;
+
+	case SPDK_BDEV_IO_TYPE_NVME_IO_MD:
+		rc = bdev_nvme_io_passthru_md(ns,
+					      qpair,
+					      nbdev_io,
+					      &bdev_io->u.nvme_passthru.cmd,
+					      bdev_io->u.nvme_passthru.buf,
+					      bdev_io->u.nvme_passthru.nbytes,
+					      bdev_io->u.nvme_passthru.md_buf,
+					      bdev_io->u.nvme_passthru.md_len);
+		break;
+
+	default:
+		rc = -EINVAL;
+		break;
+	}
+
+	if (spdk_unlikely(rc != 0)) {
+		nbdev_io->io_path = NULL;
+		nvme_io_path_put(io_path);
+	}
+
+	return rc;
+}
+
 static void
 bdev_nvme_get_buf_cb(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io,
 		     bool success)
 {
+	struct nvme_io_path *io_path;
 	int ret;
 
 	if (!success) {
@@ -511,14 +730,15 @@ bdev_nvme_get_buf_cb(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io,
 		return;
 	}
 
-	ret = bdev_nvme_readv((struct nvme_bdev *)bdev_io->bdev->ctxt,
-			      ch,
-			      (struct nvme_bdev_io *)bdev_io->driver_ctx,
-			      bdev_io->u.bdev.iovs,
-			      bdev_io->u.bdev.iovcnt,
-			      bdev_io->u.bdev.md_buf,
-			      bdev_io->u.bdev.num_blocks,
-			      bdev_io->u.bdev.offset_blocks);
+	/* Paths may have changed while waiting for the buffer. */
+	io_path = bdev_nvme_find_io_path((struct nvme_bdev *)bdev_io->bdev->ctxt,
+					 spdk_io_channel_get_ctx(ch), NULL);
+	if (spdk_unlikely(io_path == NULL)) {
+		spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_FAILED);
+		return;
+	}
+
+	ret = bdev_nvme_submit_io_on_path(io_path, bdev_io);
 
 	if (spdk_likely(ret == 0)) {
 		return;
@@ -536,63 +756,52 @@ _bdev_nvme_submit_request(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_
 	struct nvme_bdev *nbdev = (struct nvme_bdev *)bdev_io->bdev->ctxt;
 	struct nvme_bdev_io *nbdev_io = (struct nvme_bdev_io *)bdev_io->driver_ctx;
 	struct nvme_bdev_io *nbdev_io_to_abort;
-
-	if (nvme_ch->qpair == NULL) {
-		/* The device is currently resetting */
-		return -1;
-	}
+	struct nvme_io_path *io_path;
 
 	switch (bdev_io->type) {
 	case SPDK_BDEV_IO_TYPE_READ:
-		spdk_bdev_io_get_buf(bdev_io, bdev_nvme_get_buf_cb,
-				     bdev_io->u.bdev.num_blocks * bdev_io->bdev->blocklen);
-		return 0;
-
 	case SPDK_BDEV_IO_TYPE_WRITE:
-		return bdev_nvme_writev(nbdev,
-					ch,
-					nbdev_io,
-					bdev_io->u.bdev.iovs,
-					bdev_io->u.bdev.iovcnt,
-					bdev_io->u.bdev.md_buf,
-					bdev_io->u.bdev.num_blocks,
-					bdev_io->u.bdev.offset_blocks);
-
 	case SPDK_BDEV_IO_TYPE_COMPARE:
-		return bdev_nvme_comparev(nbdev,
-					  ch,
-					  nbdev_io,
-					  bdev_io->u.bdev.iovs,
-					  bdev_io->u.bdev.iovcnt,
-					  bdev_io->u.bdev.md_buf,
-					  bdev_io->u.bdev.num_blocks,
-					  bdev_io->u.bdev.offset_blocks);
+	case SPDK_BDEV_IO_TYPE_WRITE_ZEROES:
+	case SPDK_BDEV_IO_TYPE_UNMAP:
+	case SPDK_BDEV_IO_TYPE_NVME_IO:
+	case SPDK_BDEV_IO_TYPE_NVME_IO_MD:
+		if (bdev_io->type == SPDK_BDEV_IO_TYPE_READ) {
+			/*
+			 * The path is selected once the buffer is there, so only check for
+			 *  one here.  Selecting it twice would skip every other path with
+			 *  the round_robin policy.
+			 */
+			if (!bdev_nvme_has_io_path(nbdev, nvme_ch)) {
+				return -1;
+			}
+			spdk_bdev_io_get_buf(bdev_io, bdev_nvme_get_buf_cb,
+					     bdev_io->u.bdev.num_blocks * bdev_io->bdev->blocklen);
+			return 0;
+		}
+		io_path = bdev_nvme_find_io_path(nbdev, nvme_ch, NULL);
+		if (io_path == NULL) {
+			/* All paths are currently resetting or inaccessible */
+			return -1;
+		}
+		return bdev_nvme_submit_io_on_path(io_path, bdev_io);
 
-	case SPDK_BDEV_IO_TYPE_COMPARE_AND_WRITE:
-		return bdev_nvme_comparev_and_writev(nbdev,
-						     ch,
-						     nbdev_io,
-						     bdev_io->u.bdev.iovs,
-						     bdev_io->u.bdev.iovcnt,
-						     bdev_io->u.bdev.fused_iovs,
-						     bdev_io->u.bdev.fused_iovcnt,
-						     bdev_io->u.bdev.md_buf,
-						     bdev_io->u.bdev.num_blocks,
-						     bdev_io->u.bdev.offset_blocks);
+	default:
+		break;
+	}
 
-	case SPDK_BDEV_IO_TYPE_WRITE_ZEROES:
-		return bdev_nvme_unmap(nbdev,
-				       ch,
-				       nbdev_io,
-				       bdev_io->u.bdev.offset_blocks,
-				       bdev_io->u.bdev.num_blocks);
+	if (nvme_ch->qpair == NULL) {
+		/* The device is currently resetting */
+		return -1;
+	}
 
-	case SPDK_BDEV_IO_TYPE_UNMAP:
-		return bdev_nvme_unmap(nbdev,
-				       ch,
-				       nbdev_io,
-				       bdev_io->u.bdev.offset_blocks,
-				       bdev_io->u.bdev.num_blocks);
+	switch (bdev_io->type) {
+	case SPDK_BDEV_IO_TYPE_COMPARE_AND_WRITE:
+		/* Both fused commands have to be submitted to the same qpair, even
+		 * when the first one is resubmitted after -ENOMEM, so always use the
+		 * channel's own qpair.
+		 */
+		return bdev_nvme_submit_io_on_path(&nvme_ch->local_path, bdev_io);
 
 	case SPDK_BDEV_IO_TYPE_RESET:
 		return bdev_nvme_reset(nbdev->nvme_bdev_ctrlr, nbdev_io);
@@ -611,24 +820,6 @@ _bdev_nvme_submit_request(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_
 						bdev_io->u.nvme_passthru.buf,
 						bdev_io->u.nvme_passthru.nbytes);
 
-	case SPDK_BDEV_IO_TYPE_NVME_IO:
-		return bdev_nvme_io_passthru(nbdev,
-					     ch,
-					     nbdev_io,
-					     &bdev_io->u.nvme_passthru.cmd,
-					     bdev_io->u.nvme_passthru.buf,
-					     bdev_io->u.nvme_passthru.nbytes);
-
-	case SPDK_BDEV_IO_TYPE_NVME_IO_MD:
-		return bdev_nvme_io_passthru_md(nbdev,
-						ch,
-						nbdev_io,
-						&bdev_io->u.nvme_passthru.cmd,
-						bdev_io->u.nvme_passthru.buf,
-						bdev_io->u.nvme_passthru.nbytes,
-						bdev_io->u.nvme_passthru.md_buf,
-						bdev_io->u.nvme_passthru.md_len);
-
 	case SPDK_BDEV_IO_TYPE_ABORT:
 		nbdev_io_to_abort = (struct nvme_bdev_io *)bdev_io->u.abort.bio_to_abort->driver_ctx;
 		return bdev_nvme_abort(nbdev,
@@ -645,8 +836,13 @@ _bdev_nvme_submit_request(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_
 static void
 bdev_nvme_submit_request(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io)
 {
-	int rc = _bdev_nvme_submit_request(ch, bdev_io);
+	struct nvme_bdev_io *nbdev_io = (struct nvme_bdev_io *)bdev_io->driver_ctx;
+	int rc;
+
+	nbdev_io->io_path = NULL;
+	nbdev_io->num_failovers = 0;
 
+	rc = _bdev_nvme_submit_request(ch, bdev_io);
 	if (spdk_unlikely(rc != 0)) {
 		if (rc == -ENOMEM) {
 			spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_NOMEM);
@@ -719,6 +915,7 @@ bdev_nvme_create_cb(void *io_device, void *ctx_buf)
 	struct nvme_io_channel *ch = ctx_buf;
 	struct spdk_nvme_io_qpair_opts opts;
 	struct spdk_io_channel *pg_ch = NULL;
+	struct nvme_bdev_ctrlr *path_ctrlr;
 	int rc;
 
 	spdk_nvme_ctrlr_get_default_io_qpair_opts(nvme_bdev_ctrlr->ctrlr, &opts, sizeof(opts));
@@ -762,6 +959,24 @@ bdev_nvme_create_cb(void *io_device, void *ctx_buf)
 #endif
 
 	TAILQ_INIT(&ch->pending_resets);
+
+	ch->local_path.ctrlr = nvme_bdev_ctrlr;
+	ch->local_path.nvme_ch = ch;
+	TAILQ_INIT(&ch->io_paths);
+	TAILQ_INSERT_TAIL(&ch->io_paths, &ch->local_path, tailq);
+	ch->num_io_paths = 1;
+
+	/* Secondary controllers are only used through the channels of their primary. */
+	if (!nvme_bdev_ctrlr->secondary) {
+		pthread_mutex_lock(&g_bdev_nvme_mutex);
+		TAILQ_FOREACH(path_ctrlr, &nvme_bdev_ctrlr->paths, path_tailq) {
+			if (nvme_io_channel_add_path(ch, path_ctrlr) != 0) {
+				SPDK_ERRLOG("Unable to add path %s to NVMe channel.\n", path_ctrlr->trid->traddr);
+			}
+		}
+		pthread_mutex_unlock(&g_bdev_nvme_mutex);
+	}
+
 	return 0;
 
 err:
@@ -778,10 +993,17 @@ bdev_nvme_destroy_cb(void *io_device, void *ctx_buf)
 	struct nvme_bdev_ctrlr *nvme_bdev_ctrlr = io_device;
 	struct nvme_io_channel *ch = ctx_buf;
 	struct nvme_bdev_poll_group *group;
+	struct nvme_io_path *io_path, *tmp;
 
 	group = ch->group;
 	assert(group != NULL);
 
+	TAILQ_FOREACH_SAFE(io_path, &ch->io_paths, tailq, tmp) {
+		if (io_path != &ch->local_path) {
+			nvme_io_channel_remove_path(ch, io_path->ctrlr);
+		}
+	}
+
 	if (spdk_nvme_ctrlr_is_ocssd_supported(nvme_bdev_ctrlr->ctrlr)) {
 		bdev_ocssd_destroy_io_channel(ch);
 	}
@@ -834,6 +1056,57 @@ bdev_nvme_get_io_channel(void *ctx)
 	return spdk_get_io_channel(nvme_bdev->nvme_bdev_ctrlr);
 }
 
+const char *
+bdev_nvme_multipath_policy_str(enum nvme_bdev_multipath_policy policy)
+{
+	switch (policy) {
+	case NVME_BDEV_MP_POLICY_ACTIVE_PASSIVE:
+		return "active_passive";
+	case NVME_BDEV_MP_POLICY_ROUND_ROBIN:
+		return "round_robin";
+	case NVME_BDEV_MP_POLICY_QUEUE_DEPTH:
+		return "queue_depth";
+	default:
+		return NULL;
+	}
+}
+
+static const char *
+bdev_nvme_ana_state_str(enum spdk_nvme_ana_state ana_state)
+{
+	switch (ana_state) {
+	case SPDK_NVME_ANA_OPTIMIZED_STATE:
+		return "optimized";
+	case SPDK_NVME_ANA_NON_OPTIMIZED_STATE:
+		return "non_optimized";
+	case SPDK_NVME_ANA_INACCESSIBLE_STATE:
+		return "inaccessible";
+	case SPDK_NVME_ANA_PERSISTENT_LOSS_STATE:
+		return "persistent_loss";
+	case SPDK_NVME_ANA_CHANGE_STATE:
+		return "change";
+	default:
+		return "unknown";
+	}
+}
+
+static void
+bdev_nvme_dump_path_json(struct nvme_bdev_ctrlr *nvme_bdev_ctrlr, uint32_t nsid,
+			 struct spdk_json_write_ctx *w)
+{
+	struct nvme_bdev_ns *ns = nvme_bdev_ctrlr->namespaces[nsid - 1];
+
+	spdk_json_write_object_begin(w);
+
+	spdk_json_write_named_object_begin(w, "trid");
+	nvme_bdev_dump_trid_json(nvme_bdev_ctrlr->trid, w);
+	spdk_json_write_object_end(w);
+
+	spdk_json_write_named_string(w, "ana_state", bdev_nvme_ana_state_str(ns->ana_state));
+
+	spdk_json_write_object_end(w);
+}
+
 static int
 bdev_nvme_dump_info_json(void *ctx, struct spdk_json_write_ctx *w)
 {
@@ -862,6 +1135,26 @@ bdev_nvme_dump_info_json(void *ctx, struct spdk_json_write_ctx *w)
 
 	spdk_json_write_object_end(w);
 
+	pthread_mutex_lock(&g_bdev_nvme_mutex);
+	if (!TAILQ_EMPTY(&nvme_bdev_ctrlr->paths)) {
+		struct nvme_bdev_ctrlr *path_ctrlr;
+		uint32_t nsid = nvme_bdev->nvme_ns->id;
+
+		spdk_json_write_named_object_begin(w, "multipath");
+		spdk_json_write_named_string(w, "policy",
+					     bdev_nvme_multipath_policy_str(nvme_bdev_ctrlr->mp_policy));
+		spdk_json_write_named_array_begin(w, "paths");
+		bdev_nvme_dump_path_json(nvme_bdev_ctrlr, nsid, w);
+		TAILQ_FOREACH(path_ctrlr, &nvme_bdev_ctrlr->paths, path_tailq) {
+			if (nsid <= path_ctrlr->num_ns) {
+				bdev_nvme_dump_path_json(path_ctrlr, nsid, w);
+			}
+		}
+		spdk_json_write_array_end(w);
+		spdk_json_write_object_end(w);
+	}
+	pthread_mutex_unlock(&g_bdev_nvme_mutex);
+
 #ifdef SPDK_CONFIG_NVME_CUSE
 	size_t cuse_name_size = 128;
 	char cuse_name[cuse_name_size];
@@ -1332,6 +1625,141 @@ nvme_ctrlr_populate_namespaces(struct nvme_bdev_ctrlr *nvme_bdev_ctrlr,
 
 }
 
+static void
+nvme_ctrlr_update_path_namespaces(struct nvme_bdev_ctrlr *nvme_bdev_ctrlr)
+{
+	struct spdk_nvme_ctrlr	*ctrlr = nvme_bdev_ctrlr->ctrlr;
+	struct nvme_bdev_ns	*ns;
+	uint32_t		i, nsid;
+
+	assert(nvme_bdev_ctrlr->secondary);
+
+	for (i = 0; i < nvme_bdev_ctrlr->num_ns; i++) {
+		nsid = i + 1;
+		ns = nvme_bdev_ctrlr->namespaces[i];
+		ns->id = nsid;
+		ns->ctrlr = nvme_bdev_ctrlr;
+		if (spdk_nvme_ctrlr_is_active_ns(ctrlr, nsid)) {
+			ns->ns = spdk_nvme_ctrlr_get_ns(ctrlr, nsid);
+		} else {
+			ns->ns = NULL;
+		}
+	}
+}
+
+static void
+bdev_nvme_parse_ana_log_page(struct nvme_bdev_ctrlr *nvme_bdev_ctrlr)
+{
+	struct spdk_nvme_ana_page *ana_page = nvme_bdev_ctrlr->ana_log_page;
+	struct spdk_nvme_ana_group_descriptor desc;
+	struct nvme_bdev_ns *ns;
+	uint8_t *buf = (uint8_t *)ana_page;
+	size_t offset = sizeof(*ana_page);
+	uint32_t i, j, nsid;
+
+	for (i = 0; i < ana_page->num_ana_group_desc; i++) {
+		if (offset + sizeof(desc) > nvme_bdev_ctrlr->ana_log_page_size) {
+			break;
+		}
+
+		/* Descriptors are only guaranteed to be dword aligned. */
+		memcpy(&desc, buf + offset, sizeof(desc));
+		offset += sizeof(desc);
+
+		if (offset + (size_t)desc.num_of_nsid * sizeof(uint32_t) > nvme_bdev_ctrlr->ana_log_page_size) {
+			SPDK_ERRLOG("ANA log page of %s is truncated\n", nvme_bdev_ctrlr->name);
+			break;
+		}
+
+		for (j = 0; j < desc.num_of_nsid; j++) {
+			memcpy(&nsid, buf + offset, sizeof(nsid));
+			offset += sizeof(nsid);
+
+			if (nsid == 0 || nsid > nvme_bdev_ctrlr->num_ns) {
+				continue;
+			}
+
+			ns = nvme_bdev_ctrlr->namespaces[nsid - 1];
+			ns->ana_group_id = desc.ana_group_id;
+			ns->ana_state = desc.ana_state;
+		}
+	}
+}
+
+static void
+bdev_nvme_read_ana_log_page_done(void *ctx, const struct spdk_nvme_cpl *cpl)
+{
+	struct nvme_bdev_ctrlr *nvme_bdev_ctrlr = ctx;
+
+	nvme_bdev_ctrlr->ana_log_page_updating = false;
+
+	if (spdk_nvme_cpl_is_error(cpl)) {
+		SPDK_ERRLOG("Failed to read ANA log page of %s (sct=%d, sc=%d)\n", nvme_bdev_ctrlr->name,
+			    cpl->status.sct, cpl->status.sc);
+		return;
+	}
+
+	bdev_nvme_parse_ana_log_page(nvme_bdev_ctrlr);
+}
+
+static void
+bdev_nvme_read_ana_log_page(struct nvme_bdev_ctrlr *nvme_bdev_ctrlr)
+{
+	int rc;
+
+	if (nvme_bdev_ctrlr->ana_log_page == NULL || nvme_bdev_ctrlr->ana_log_page_updating) {
+		return;
+	}
+
+	nvme_bdev_ctrlr->ana_log_page_stale = false;
+
+	rc = spdk_nvme_ctrlr_cmd_get_log_page(nvme_bdev_ctrlr->ctrlr,
+					      SPDK_NVME_LOG_ASYMMETRIC_NAMESPACE_ACCESS,
+					      SPDK_NVME_GLOBAL_NS_TAG,
+					      nvme_bdev_ctrlr->ana_log_page,
+					      nvme_bdev_ctrlr->ana_log_page_size, 0,
+					      bdev_nvme_read_ana_log_page_done, nvme_bdev_ctrlr);
+	if (rc != 0) {
+		/* Try again on the next admin queue poll. */
+		nvme_bdev_ctrlr->ana_log_page_stale = true;
+		return;
+	}
+
+	nvme_bdev_ctrlr->ana_log_page_updating = true;
+}
+
+static void
+bdev_nvme_init_ana_log_page(struct nvme_bdev_ctrlr *nvme_bdev_ctrlr)
+{
+	struct spdk_nvme_ctrlr *ctrlr = nvme_bdev_ctrlr->ctrlr;
+	const struct spdk_nvme_ctrlr_data *cdata = spdk_nvme_ctrlr_get_data(ctrlr);
+	uint64_t size;
+
+	if (!cdata->cmic.ana_reporting) {
+		return;
+	}
+
+	size = sizeof(struct spdk_nvme_ana_page) +
+	       (uint64_t)cdata->nanagrpid * sizeof(struct spdk_nvme_ana_group_descriptor) +
+	       (uint64_t)nvme_bdev_ctrlr->num_ns * sizeof(uint32_t);
+	if (size > spdk_nvme_ctrlr_get_max_xfer_size(ctrlr)) {
+		SPDK_WARNLOG("ANA log page of %s is too large (%" PRIu64 " bytes), ignoring ANA states\n",
+			     nvme_bdev_ctrlr->name, size);
+		return;
+	}
+
+	nvme_bdev_ctrlr->ana_log_page = calloc(1, size);
+	if (nvme_bdev_ctrlr->ana_log_page == NULL) {
+		SPDK_ERRLOG("Failed to allocate ANA log page of %s, ignoring ANA states\n",
+			    nvme_bdev_ctrlr->name);
+		return;
+	}
+
+	nvme_bdev_ctrlr->ana_log_page_size = size;
+	/* Let the admin queue poller read it for the first time. */
+	nvme_bdev_ctrlr->ana_log_page_stale = true;
+}
+
 static void
 aer_cb(void *arg, const struct spdk_nvme_cpl *cpl)
 {
@@ -1346,7 +1774,20 @@ aer_cb(void *arg, const struct spdk_nvme_cpl *cpl)
 	event.raw = cpl->cdw0;
 	if ((event.bits.async_event_type == SPDK_NVME_ASYNC_EVENT_TYPE_NOTICE) &&
 	    (event.bits.async_event_info == SPDK_NVME_ASYNC_EVENT_NS_ATTR_CHANGED)) {
-		nvme_ctrlr_populate_namespaces(nvme_bdev_ctrlr, NULL);
+		if (nvme_bdev_ctrlr->secondary) {
+			nvme_ctrlr_update_path_namespaces(nvme_bdev_ctrlr);
+		} else {
+			nvme_ctrlr_populate_namespaces(nvme_bdev_ctrlr, NULL);
+		}
+		/* Newly attached namespaces are reported in the ANA log page as well. */
+		if (nvme_bdev_ctrlr->ana_log_page != NULL) {
+			nvme_bdev_ctrlr->ana_log_page_stale = true;
+		}
+	} else if ((event.bits.async_event_type == SPDK_NVME_ASYNC_EVENT_TYPE_NOTICE) &&
+		   (event.bits.async_event_info == SPDK_NVME_ASYNC_EVENT_ANA_CHANGE)) {
+		if (nvme_bdev_ctrlr->ana_log_page != NULL) {
+			nvme_bdev_ctrlr->ana_log_page_stale = true;
+		}
 	} else if ((event.bits.async_event_type == SPDK_NVME_ASYNC_EVENT_TYPE_VENDOR) &&
 		   (event.bits.log_page_identifier == SPDK_OCSSD_LOG_CHUNK_NOTIFICATION) &&
 		   spdk_nvme_ctrlr_is_ocssd_supported(nvme_bdev_ctrlr->ctrlr)) {
@@ -1398,6 +1839,8 @@ create_ctrlr(struct spdk_nvme_ctrlr *ctrlr,
 			free(nvme_bdev_ctrlr);
 			return -ENOMEM;
 		}
+		/* Until the ANA log page is read, if the controller reports it at all */
+		nvme_bdev_ctrlr->namespaces[i]->ana_state = SPDK_NVME_ANA_OPTIMIZED_STATE;
 	}
 
 	nvme_bdev_ctrlr->thread = spdk_get_thread();
@@ -1426,12 +1869,16 @@ create_ctrlr(struct spdk_nvme_ctrlr *ctrlr,
 	}
 
 	nvme_bdev_ctrlr->prchk_flags = prchk_flags;
+	nvme_bdev_ctrlr->mp_policy = NVME_BDEV_MP_POLICY_ACTIVE_PASSIVE;
+	TAILQ_INIT(&nvme_bdev_ctrlr->paths);
+
+	bdev_nvme_init_ana_log_page(nvme_bdev_ctrlr);
 
 	spdk_io_device_register(nvme_bdev_ctrlr, bdev_nvme_create_cb, bdev_nvme_destroy_cb,
 				sizeof(struct nvme_io_channel),
 				name);
 
-	nvme_bdev_ctrlr->adminq_timer_poller = SPDK_POLLER_REGISTER(bdev_nvme_poll_adminq, ctrlr,
+	nvme_bdev_ctrlr->adminq_timer_poller = SPDK_POLLER_REGISTER(bdev_nvme_poll_adminq, nvme_bdev_ctrlr,
 					       g_opts.nvme_adminq_poll_period_us);
 
 	TAILQ_INSERT_TAIL(&g_nvme_bdev_ctrlrs, nvme_bdev_ctrlr, tailq);
@@ -1499,7 +1946,7 @@ static void
 remove_cb(void *cb_ctx, struct spdk_nvme_ctrlr *ctrlr)
 {
 	uint32_t i;
-	struct nvme_bdev_ctrlr *nvme_bdev_ctrlr;
+	struct nvme_bdev_ctrlr *nvme_bdev_ctrlr, *path_ctrlr, *tmp;
 	struct nvme_bdev_ns *ns;
 
 	pthread_mutex_lock(&g_bdev_nvme_mutex);
@@ -1511,6 +1958,12 @@ remove_cb(void *cb_ctx, struct spdk_nvme_ctrlr *ctrlr)
 				return;
 			}
 			pthread_mutex_unlock(&g_bdev_nvme_mutex);
+
+			/* Secondary paths have no bdevs of their own, so they go along with the primary */
+			TAILQ_FOREACH_SAFE(path_ctrlr, &nvme_bdev_ctrlr->paths, path_tailq, tmp) {
+				remove_cb(cb_ctx, path_ctrlr->ctrlr);
+			}
+
 			for (i = 0; i < nvme_bdev_ctrlr->num_ns; i++) {
 				uint32_t	nsid = i + 1;
 
@@ -1653,6 +2106,11 @@ nvme_ctrlr_populate_namespaces_done(struct nvme_async_probe_ctx *ctx)
 	nvme_bdev_ctrlr = nvme_bdev_ctrlr_get(&ctx->trid);
 	assert(nvme_bdev_ctrlr != NULL);
 
+	/* A new path reports the bdevs it leads to */
+	if (nvme_bdev_ctrlr->primary != NULL) {
+		nvme_bdev_ctrlr = nvme_bdev_ctrlr->primary;
+	}
+
 	/*
 	 * Report the new bdevs that were created in this call.
 	 * There can be more than one bdev per NVMe controller.
@@ -1681,12 +2139,97 @@ nvme_ctrlr_populate_namespaces_done(struct nvme_async_probe_ctx *ctx)
 	populate_namespaces_cb(ctx, j, 0);
 }
 
+static int
+bdev_nvme_check_path(struct nvme_bdev_ctrlr *primary, struct spdk_nvme_ctrlr *ctrlr)
+{
+	const struct spdk_nvme_ctrlr_data *cdata, *primary_cdata;
+	const struct spdk_uuid *uuid, *primary_uuid;
+	struct spdk_nvme_ns *ns;
+	struct nvme_bdev_ns *primary_ns;
+	uint32_t i, nsid;
+
+	cdata = spdk_nvme_ctrlr_get_data(ctrlr);
+	primary_cdata = spdk_nvme_ctrlr_get_data(primary->ctrlr);
+
+	if (strncmp((const char *)cdata->subnqn, (const char *)primary_cdata->subnqn,
+		    sizeof(cdata->subnqn)) != 0) {
+		SPDK_ERRLOG("New path doesn't lead to the subsystem of controller %s\n", primary->name);
+		return -EINVAL;
+	}
+
+	for (i = 0; i < primary->num_ns; i++) {
+		nsid = i + 1;
+		primary_ns = primary->namespaces[i];
+		if (!primary_ns->populated || !spdk_nvme_ctrlr_is_active_ns(ctrlr, nsid)) {
+			continue;
+		}
+
+		ns = spdk_nvme_ctrlr_get_ns(ctrlr, nsid);
+		uuid = spdk_nvme_ns_get_uuid(ns);
+		primary_uuid = spdk_nvme_ns_get_uuid(primary_ns->ns);
+		if (uuid != NULL && primary_uuid != NULL && spdk_uuid_compare(uuid, primary_uuid) != 0) {
+			SPDK_ERRLOG("Namespace %u of the new path differs from the one of controller %s\n",
+				    nsid, primary->name);
+			return -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+static void
+bdev_nvme_add_path_done(struct spdk_io_channel_iter *i, int status)
+{
+	struct nvme_async_probe_ctx *ctx = spdk_io_channel_iter_get_ctx(i);
+
+	nvme_ctrlr_populate_namespaces_done(ctx);
+}
+
+static void
+_bdev_nvme_add_path(struct spdk_io_channel_iter *i)
+{
+	struct spdk_io_channel *ch = spdk_io_channel_iter_get_channel(i);
+	struct nvme_io_channel *nvme_ch = spdk_io_channel_get_ctx(ch);
+	struct nvme_async_probe_ctx *ctx = spdk_io_channel_iter_get_ctx(i);
+	struct nvme_bdev_ctrlr *path_ctrlr;
+	int rc;
+
+	path_ctrlr = nvme_bdev_ctrlr_get(&ctx->trid);
+	assert(path_ctrlr != NULL);
+
+	rc = nvme_io_channel_add_path(nvme_ch, path_ctrlr);
+	if (rc != 0) {
+		SPDK_ERRLOG("Failed to add path %s to an I/O channel of %s\n",
+			    path_ctrlr->trid->traddr, path_ctrlr->name);
+	}
+
+	spdk_for_each_channel_continue(i, 0);
+}
+
+static void
+bdev_nvme_add_path(struct nvme_bdev_ctrlr *primary, struct nvme_bdev_ctrlr *nvme_bdev_ctrlr,
+		   struct nvme_async_probe_ctx *ctx)
+{
+	nvme_ctrlr_update_path_namespaces(nvme_bdev_ctrlr);
+
+	pthread_mutex_lock(&g_bdev_nvme_mutex);
+	nvme_bdev_ctrlr->primary = primary;
+	TAILQ_INSERT_TAIL(&primary->paths, nvme_bdev_ctrlr, path_tailq);
+	pthread_mutex_unlock(&g_bdev_nvme_mutex);
+
+	SPDK_NOTICELOG("Added path (traddr: %s) to controller %s\n", nvme_bdev_ctrlr->trid->traddr,
+		       primary->name);
+
+	/* Channels created from now on pick the path up in bdev_nvme_create_cb */
+	spdk_for_each_channel(primary, _bdev_nvme_add_path, ctx, bdev_nvme_add_path_done);
+}
+
 static void
 connect_attach_cb(void *cb_ctx, const struct spdk_nvme_transport_id *trid,
 		  struct spdk_nvme_ctrlr *ctrlr, const struct spdk_nvme_ctrlr_opts *opts)
 {
 	struct spdk_nvme_ctrlr_opts *user_opts = cb_ctx;
-	struct nvme_bdev_ctrlr	*nvme_bdev_ctrlr;
+	struct nvme_bdev_ctrlr	*nvme_bdev_ctrlr, *primary = NULL;
 	struct nvme_async_probe_ctx *ctx;
 	int rc;
 
@@ -1694,6 +2237,18 @@ connect_attach_cb(void *cb_ctx, const struct spdk_nvme_transport_id *trid,
 
 	spdk_poller_unregister(&ctx->poller);
 
+	if (ctx->multipath) {
+		primary = nvme_bdev_ctrlr_get_by_name(ctx->base_name);
+		if (primary != NULL) {
+			rc = primary->destruct ? -ENODEV : bdev_nvme_check_path(primary, ctrlr);
+			if (rc != 0) {
+				spdk_nvme_detach(ctrlr);
+				populate_namespaces_cb(ctx, 0, rc);
+				return;
+			}
+		}
+	}
+
 	rc = create_ctrlr(ctrlr, ctx->base_name, &ctx->trid, ctx->prchk_flags);
 	if (rc) {
 		SPDK_ERRLOG("Failed to create new device\n");
@@ -1704,6 +2259,12 @@ connect_attach_cb(void *cb_ctx, const struct spdk_nvme_transport_id *trid,
 	nvme_bdev_ctrlr = nvme_bdev_ctrlr_get(&ctx->trid);
 	assert(nvme_bdev_ctrlr != NULL);
 
+	if (primary != NULL) {
+		nvme_bdev_ctrlr->secondary = true;
+		bdev_nvme_add_path(primary, nvme_bdev_ctrlr, ctx);
+		return;
+	}
+
 	nvme_ctrlr_populate_namespaces(nvme_bdev_ctrlr, ctx);
 }
 
@@ -1730,20 +2291,38 @@ bdev_nvme_create(struct spdk_nvme_transport_id *trid,
 		 uint32_t count,
 		 const char *hostnqn,
 		 uint32_t prchk_flags,
+		 bool multipath,
 		 spdk_bdev_create_nvme_fn cb_fn,
 		 void *cb_ctx)
 {
 	struct nvme_probe_skip_entry	*entry, *tmp;
 	struct nvme_async_probe_ctx	*ctx;
+	struct nvme_bdev_ctrlr		*primary;
 
 	if (nvme_bdev_ctrlr_get(trid) != NULL) {
 		SPDK_ERRLOG("A controller with the provided trid (traddr: %s) already exists.\n", trid->traddr);
 		return -EEXIST;
 	}
 
-	if (nvme_bdev_ctrlr_get_by_name(base_name)) {
-		SPDK_ERRLOG("A controller with the provided name (%s) already exists.\n", base_name);
-		return -EEXIST;
+	primary = nvme_bdev_ctrlr_get_by_name(base_name);
+	if (primary != NULL) {
+		if (!multipath) {
+			SPDK_ERRLOG("A controller with the provided name (%s) already exists.\n", base_name);
+			return -EEXIST;
+		}
+
+		if (trid->trtype == SPDK_NVME_TRANSPORT_PCIE ||
+		    primary->trid->trtype == SPDK_NVME_TRANSPORT_PCIE ||
+		    primary->ocssd_ctrlr != NULL) {
+			SPDK_ERRLOG("Multipath is only supported for NVMe-oF controllers (%s).\n", base_name);
+			return -EINVAL;
+		}
+
+		if (strcmp(trid->subnqn, primary->trid->subnqn) != 0) {
+			SPDK_ERRLOG("Subsystem NQN %s doesn't match the one of controller %s.\n",
+				    trid->subnqn, base_name);
+			return -EINVAL;
+		}
 	}
 
 	if (trid->trtype == SPDK_NVME_TRANSPORT_PCIE) {
@@ -1766,6 +2345,7 @@ bdev_nvme_create(struct spdk_nvme_transport_id *trid,
 	ctx->cb_fn = cb_fn;
 	ctx->cb_ctx = cb_ctx;
 	ctx->prchk_flags = prchk_flags;
+	ctx->multipath = multipath;
 	ctx->trid = *trid;
 
 	spdk_nvme_ctrlr_get_default_ctrlr_opts(&ctx->opts, sizeof(ctx->opts));
@@ -1823,6 +2403,26 @@ bdev_nvme_delete(const char *name)
 	return 0;
 }
 
+int
+bdev_nvme_set_multipath_policy(const char *name, enum nvme_bdev_multipath_policy policy)
+{
+	struct nvme_bdev_ctrlr *nvme_bdev_ctrlr;
+
+	if (name == NULL || bdev_nvme_multipath_policy_str(policy) == NULL) {
+		return -EINVAL;
+	}
+
+	nvme_bdev_ctrlr = nvme_bdev_ctrlr_get_by_name(name);
+	if (nvme_bdev_ctrlr == NULL) {
+		SPDK_ERRLOG("Failed to find NVMe controller\n");
+		return -ENODEV;
+	}
+
+	/* I/O channels read the policy on each submission, so there is nothing to propagate */
+	nvme_bdev_ctrlr->mp_policy = policy;
+	return 0;
+}
+
 static int
 bdev_nvme_library_init(void)
 {
@@ -2133,6 +2733,104 @@ bdev_nvme_verify_pi_error(struct spdk_bdev_io *bdev_io)
 	}
 }
 
+static bool
+bdev_nvme_cpl_is_path_error(const struct spdk_nvme_cpl *cpl)
+{
+	if (cpl->status.dnr) {
+		return false;
+	}
+
+	return cpl->status.sct == SPDK_NVME_SCT_PATH ||
+	       (cpl->status.sct == SPDK_NVME_SCT_GENERIC &&
+		cpl->status.sc == SPDK_NVME_SC_ABORTED_SQ_DELETION);
+}
+
+static void
+bdev_nvme_io_path_error(struct nvme_io_path *io_path, struct nvme_bdev *nbdev,
+			const struct spdk_nvme_cpl *cpl)
+{
+	struct nvme_bdev_ctrlr *nvme_bdev_ctrlr = io_path->ctrlr;
+	struct nvme_bdev_ns *nvme_ns;
+
+	if (cpl->status.sct != SPDK_NVME_SCT_PATH || nvme_bdev_ctrlr->ana_log_page == NULL) {
+		return;
+	}
+
+	switch (cpl->status.sc) {
+	case SPDK_NVME_SC_ASYMMETRIC_ACCESS_PERSISTENT_LOSS:
+	case SPDK_NVME_SC_ASYMMETRIC_ACCESS_INACCESSIBLE:
+	case SPDK_NVME_SC_ASYMMETRIC_ACCESS_TRANSITION:
+		/* Stop using this path for the namespace until the ANA log page
+		 * of its controller tells otherwise.
+		 */
+		nvme_ns = nvme_bdev_ctrlr->namespaces[nbdev->nvme_ns->id - 1];
+		nvme_ns->ana_state = SPDK_NVME_ANA_INACCESSIBLE_STATE;
+		nvme_bdev_ctrlr->ana_log_page_stale = true;
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * Resubmit an I/O through another path. Returns 0 if it was resubmitted,
+ * -ENOMEM if the other path is out of requests for now, or another negated
+ * errno if it can't be failed over.
+ */
+static int
+bdev_nvme_failover_io(struct spdk_bdev_io *bdev_io, struct nvme_io_path *failed_path)
+{
+	struct nvme_bdev_io *bio = (struct nvme_bdev_io *)bdev_io->driver_ctx;
+	struct nvme_io_channel *nvme_ch = spdk_io_channel_get_ctx(spdk_bdev_io_get_io_channel(bdev_io));
+	struct nvme_io_path *io_path;
+
+	if (bdev_io->type == SPDK_BDEV_IO_TYPE_COMPARE_AND_WRITE ||
+	    bio->num_failovers >= nvme_ch->num_io_paths) {
+		return -EINVAL;
+	}
+
+	io_path = bdev_nvme_find_io_path((struct nvme_bdev *)bdev_io->bdev->ctxt, nvme_ch, failed_path);
+	if (io_path == NULL) {
+		return -ENODEV;
+	}
+
+	SPDK_DEBUGLOG(SPDK_LOG_BDEV_NVME, "Resubmitting I/O %p on path %s\n", bdev_io,
+		      io_path->ctrlr->trid->traddr);
+	bio->num_failovers++;
+
+	return bdev_nvme_submit_io_on_path(io_path, bdev_io);
+}
+
+/*
+ * Complete an I/O submitted through an I/O path. An I/O failed with a
+ * path related error is resubmitted through another path, if there is one.
+ */
+static void
+bdev_nvme_io_complete_nvme_status(struct nvme_bdev_io *bio, const struct spdk_nvme_cpl *cpl)
+{
+	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(bio);
+	struct nvme_io_path *io_path = bio->io_path;
+	int rc = -EIO;
+
+	if (spdk_likely(io_path != NULL)) {
+		bio->io_path = NULL;
+		if (spdk_unlikely(bdev_nvme_cpl_is_path_error(cpl))) {
+			bdev_nvme_io_path_error(io_path, (struct nvme_bdev *)bdev_io->bdev->ctxt, cpl);
+			rc = bdev_nvme_failover_io(bdev_io, io_path);
+		}
+		nvme_io_path_put(io_path);
+		if (rc == 0) {
+			return;
+		} else if (rc == -ENOMEM) {
+			/* The bdev layer submits it again once some I/O completes */
+			spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_NOMEM);
+			return;
+		}
+	}
+
+	spdk_bdev_io_complete_nvme_status(bdev_io, cpl->cdw0, cpl->status.sct, cpl->status.sc);
+}
+
 static void
 bdev_nvme_no_pi_readv_done(void *ref, const struct spdk_nvme_cpl *cpl)
 {
@@ -2145,8 +2843,7 @@ bdev_nvme_no_pi_readv_done(void *ref, const struct spdk_nvme_cpl *cpl)
 	}
 
 	/* Return original completion status */
-	spdk_bdev_io_complete_nvme_status(bdev_io, bio->cpl.cdw0, bio->cpl.status.sct,
-					  bio->cpl.status.sc);
+	bdev_nvme_io_complete_nvme_status(bio, &bio->cpl);
 }
 
 static void
@@ -2154,18 +2851,20 @@ bdev_nvme_readv_done(void *ref, const struct spdk_nvme_cpl *cpl)
 {
 	struct nvme_bdev_io *bio = ref;
 	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(bio);
+	struct nvme_io_path *io_path = bio->io_path;
 	int ret;
 
-	if (spdk_unlikely(spdk_nvme_cpl_is_pi_error(cpl))) {
+	if (spdk_unlikely(spdk_nvme_cpl_is_pi_error(cpl)) && io_path != NULL &&
+	    io_path->nvme_ch != NULL && io_path->nvme_ch->qpair != NULL) {
 		SPDK_ERRLOG("readv completed with PI error (sct=%d, sc=%d)\n",
 			    cpl->status.sct, cpl->status.sc);
 
 		/* Save completion status to use after verifying PI error. */
 		bio->cpl = *cpl;
 
-		/* Read without PI checking to verify PI error. */
-		ret = bdev_nvme_no_pi_readv((struct nvme_bdev *)bdev_io->bdev->ctxt,
-					    spdk_bdev_io_get_io_channel(bdev_io),
+		/* Read without PI checking to verify PI error on the same path. */
+		ret = bdev_nvme_no_pi_readv(bdev_nvme_io_path_get_ns(io_path, bdev_io->bdev->ctxt),
+					    io_path->nvme_ch->qpair,
 					    bio,
 					    bdev_io->u.bdev.iovs,
 					    bdev_io->u.bdev.iovcnt,
@@ -2177,13 +2876,14 @@ bdev_nvme_readv_done(void *ref, const struct spdk_nvme_cpl *cpl)
 		}
 	}
 
-	spdk_bdev_io_complete_nvme_status(bdev_io, cpl->cdw0, cpl->status.sct, cpl->status.sc);
+	bdev_nvme_io_complete_nvme_status(bio, cpl);
 }
 
 static void
 bdev_nvme_writev_done(void *ref, const struct spdk_nvme_cpl *cpl)
 {
-	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx((struct nvme_bdev_io *)ref);
+	struct nvme_bdev_io *bio = ref;
+	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(bio);
 
 	if (spdk_nvme_cpl_is_pi_error(cpl)) {
 		SPDK_ERRLOG("writev completed with PI error (sct=%d, sc=%d)\n",
@@ -2192,13 +2892,14 @@ bdev_nvme_writev_done(void *ref, const struct spdk_nvme_cpl *cpl)
 		bdev_nvme_verify_pi_error(bdev_io);
 	}
 
-	spdk_bdev_io_complete_nvme_status(bdev_io, cpl->cdw0, cpl->status.sct, cpl->status.sc);
+	bdev_nvme_io_complete_nvme_status(bio, cpl);
 }
 
 static void
 bdev_nvme_comparev_done(void *ref, const struct spdk_nvme_cpl *cpl)
 {
-	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx((struct nvme_bdev_io *)ref);
+	struct nvme_bdev_io *bio = ref;
+	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(bio);
 
 	if (spdk_nvme_cpl_is_pi_error(cpl)) {
 		SPDK_ERRLOG("comparev completed with PI error (sct=%d, sc=%d)\n",
@@ -2207,14 +2908,13 @@ bdev_nvme_comparev_done(void *ref, const struct spdk_nvme_cpl *cpl)
 		bdev_nvme_verify_pi_error(bdev_io);
 	}
 
-	spdk_bdev_io_complete_nvme_status(bdev_io, cpl->cdw0, cpl->status.sct, cpl->status.sc);
+	bdev_nvme_io_complete_nvme_status(bio, cpl);
 }
 
 static void
 bdev_nvme_comparev_and_writev_done(void *ref, const struct spdk_nvme_cpl *cpl)
 {
 	struct nvme_bdev_io *bio = ref;
-	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(bio);
 
 	/* Compare operation completion */
 	if ((cpl->cdw0 & 0xFF) == SPDK_NVME_OPC_COMPARE) {
@@ -2232,18 +2932,16 @@ bdev_nvme_comparev_and_writev_done(void *ref, const struct spdk_nvme_cpl *cpl)
 			SPDK_ERRLOG("Unexpected write success after compare failure.\n");
 		}
 
-		spdk_bdev_io_complete_nvme_status(bdev_io, bio->cpl.cdw0, bio->cpl.status.sct, bio->cpl.status.sc);
+		bdev_nvme_io_complete_nvme_status(bio, &bio->cpl);
 	} else {
-		spdk_bdev_io_complete_nvme_status(bdev_io, cpl->cdw0, cpl->status.sct, cpl->status.sc);
+		bdev_nvme_io_complete_nvme_status(bio, cpl);
 	}
 }
 
 static void
 bdev_nvme_queued_done(void *ref, const struct spdk_nvme_cpl *cpl)
 {
-	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx((struct nvme_bdev_io *)ref);
-
-	spdk_bdev_io_complete_nvme_status(bdev_io, cpl->cdw0, cpl->status.sct, cpl->status.sc);
+	bdev_nvme_io_complete_nvme_status((struct nvme_bdev_io *)ref, cpl);
 }
 
 static void
@@ -2378,11 +3076,10 @@ bdev_nvme_queued_next_fused_sge(void *ref, void **address, uint32_t *length)
 }
 
 static int
-bdev_nvme_no_pi_readv(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
+bdev_nvme_no_pi_readv(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
 		      struct nvme_bdev_io *bio, struct iovec *iov, int iovcnt,
 		      void *md, uint64_t lba_count, uint64_t lba)
 {
-	struct nvme_io_channel *nvme_ch = spdk_io_channel_get_ctx(ch);
 	int rc;
 
 	SPDK_DEBUGLOG(SPDK_LOG_BDEV_NVME, "read %lu blocks with offset %#lx without PI check\n",
@@ -2393,7 +3090,7 @@ bdev_nvme_no_pi_readv(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
 	bio->iovpos = 0;
 	bio->iov_offset = 0;
 
-	rc = spdk_nvme_ns_cmd_readv_with_md(nbdev->nvme_ns->ns, nvme_ch->qpair, lba, lba_count,
+	rc = spdk_nvme_ns_cmd_readv_with_md(ns, qpair, lba, lba_count,
 					    bdev_nvme_no_pi_readv_done, bio, 0,
 					    bdev_nvme_queued_reset_sgl, bdev_nvme_queued_next_sge,
 					    md, 0, 0);
@@ -2405,11 +3102,10 @@ bdev_nvme_no_pi_readv(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
 }
 
 static int
-bdev_nvme_readv(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
+bdev_nvme_readv(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
 		struct nvme_bdev_io *bio, struct iovec *iov, int iovcnt,
-		void *md, uint64_t lba_count, uint64_t lba)
+		void *md, uint64_t lba_count, uint64_t lba, uint32_t flags)
 {
-	struct nvme_io_channel *nvme_ch = spdk_io_channel_get_ctx(ch);
 	int rc;
 
 	SPDK_DEBUGLOG(SPDK_LOG_BDEV_NVME, "read %lu blocks with offset %#lx\n",
@@ -2420,8 +3116,8 @@ bdev_nvme_readv(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
 	bio->iovpos = 0;
 	bio->iov_offset = 0;
 
-	rc = spdk_nvme_ns_cmd_readv_with_md(nbdev->nvme_ns->ns, nvme_ch->qpair, lba, lba_count,
-					    bdev_nvme_readv_done, bio, nbdev->disk.dif_check_flags,
+	rc = spdk_nvme_ns_cmd_readv_with_md(ns, qpair, lba, lba_count,
+					    bdev_nvme_readv_done, bio, flags,
 					    bdev_nvme_queued_reset_sgl, bdev_nvme_queued_next_sge,
 					    md, 0, 0);
 
@@ -2432,11 +3128,11 @@ bdev_nvme_readv(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
 }
 
 static int
-bdev_nvme_writev(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
+bdev_nvme_writev(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
 		 struct nvme_bdev_io *bio,
-		 struct iovec *iov, int iovcnt, void *md, uint64_t lba_count, uint64_t lba)
+		 struct iovec *iov, int iovcnt, void *md, uint64_t lba_count, uint64_t lba,
+		 uint32_t flags)
 {
-	struct nvme_io_channel *nvme_ch = spdk_io_channel_get_ctx(ch);
 	int rc;
 
 	SPDK_DEBUGLOG(SPDK_LOG_BDEV_NVME, "write %lu blocks with offset %#lx\n",
@@ -2447,8 +3143,8 @@ bdev_nvme_writev(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
 	bio->iovpos = 0;
 	bio->iov_offset = 0;
 
-	rc = spdk_nvme_ns_cmd_writev_with_md(nbdev->nvme_ns->ns, nvme_ch->qpair, lba, lba_count,
-					     bdev_nvme_writev_done, bio, nbdev->disk.dif_check_flags,
+	rc = spdk_nvme_ns_cmd_writev_with_md(ns, qpair, lba, lba_count,
+					     bdev_nvme_writev_done, bio, flags,
 					     bdev_nvme_queued_reset_sgl, bdev_nvme_queued_next_sge,
 					     md, 0, 0);
 
@@ -2459,11 +3155,11 @@ bdev_nvme_writev(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
 }
 
 static int
-bdev_nvme_comparev(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
+bdev_nvme_comparev(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
 		   struct nvme_bdev_io *bio,
-		   struct iovec *iov, int iovcnt, void *md, uint64_t lba_count, uint64_t lba)
+		   struct iovec *iov, int iovcnt, void *md, uint64_t lba_count, uint64_t lba,
+		   uint32_t flags)
 {
-	struct nvme_io_channel *nvme_ch = spdk_io_channel_get_ctx(ch);
 	int rc;
 
 	SPDK_DEBUGLOG(SPDK_LOG_BDEV_NVME, "compare %lu blocks with offset %#lx\n",
@@ -2474,8 +3170,8 @@ bdev_nvme_comparev(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
 	bio->iovpos = 0;
 	bio->iov_offset = 0;
 
-	rc = spdk_nvme_ns_cmd_comparev_with_md(nbdev->nvme_ns->ns, nvme_ch->qpair, lba, lba_count,
-					       bdev_nvme_comparev_done, bio, nbdev->disk.dif_check_flags,
+	rc = spdk_nvme_ns_cmd_comparev_with_md(ns, qpair, lba, lba_count,
+					       bdev_nvme_comparev_done, bio, flags,
 					       bdev_nvme_queued_reset_sgl, bdev_nvme_queued_next_sge,
 					       md, 0, 0);
 
@@ -2486,13 +3182,11 @@ bdev_nvme_comparev(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
 }
 
 static int
-bdev_nvme_comparev_and_writev(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
+bdev_nvme_comparev_and_writev(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
 			      struct nvme_bdev_io *bio, struct iovec *cmp_iov, int cmp_iovcnt, struct iovec *write_iov,
-			      int write_iovcnt, void *md, uint64_t lba_count, uint64_t lba)
+			      int write_iovcnt, void *md, uint64_t lba_count, uint64_t lba, uint32_t flags)
 {
-	struct nvme_io_channel *nvme_ch = spdk_io_channel_get_ctx(ch);
 	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(bio);
-	uint32_t flags = nbdev->disk.dif_check_flags;
 	int rc;
 
 	SPDK_DEBUGLOG(SPDK_LOG_BDEV_NVME, "compare and write %lu blocks with offset %#lx\n",
@@ -2515,7 +3209,7 @@ bdev_nvme_comparev_and_writev(struct nvme_bdev *nbdev, struct spdk_io_channel *c
 		flags |= SPDK_NVME_IO_FLAGS_FUSE_FIRST;
 		memset(&bio->cpl, 0, sizeof(bio->cpl));
 
-		rc = spdk_nvme_ns_cmd_comparev_with_md(nbdev->nvme_ns->ns, nvme_ch->qpair, lba, lba_count,
+		rc = spdk_nvme_ns_cmd_comparev_with_md(ns, qpair, lba, lba_count,
 						       bdev_nvme_comparev_and_writev_done, bio, flags,
 						       bdev_nvme_queued_reset_sgl, bdev_nvme_queued_next_sge, md, 0, 0);
 		if (rc == 0) {
@@ -2531,7 +3225,7 @@ bdev_nvme_comparev_and_writev(struct nvme_bdev *nbdev, struct spdk_io_channel *c
 
 	flags |= SPDK_NVME_IO_FLAGS_FUSE_SECOND;
 
-	rc = spdk_nvme_ns_cmd_writev_with_md(nbdev->nvme_ns->ns, nvme_ch->qpair, lba, lba_count,
+	rc = spdk_nvme_ns_cmd_writev_with_md(ns, qpair, lba, lba_count,
 					     bdev_nvme_comparev_and_writev_done, bio, flags,
 					     bdev_nvme_queued_reset_fused_sgl, bdev_nvme_queued_next_fused_sge, md, 0, 0);
 	if (rc != 0 && rc != -ENOMEM) {
@@ -2543,12 +3237,11 @@ bdev_nvme_comparev_and_writev(struct nvme_bdev *nbdev, struct spdk_io_channel *c
 }
 
 static int
-bdev_nvme_unmap(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
+bdev_nvme_unmap(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
 		struct nvme_bdev_io *bio,
 		uint64_t offset_blocks,
 		uint64_t num_blocks)
 {
-	struct nvme_io_channel *nvme_ch = spdk_io_channel_get_ctx(ch);
 	struct spdk_nvme_dsm_range dsm_ranges[SPDK_NVME_DATASET_MANAGEMENT_MAX_RANGES];
 	struct spdk_nvme_dsm_range *range;
 	uint64_t offset, remaining;
@@ -2584,7 +3277,7 @@ bdev_nvme_unmap(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
 	range->length = remaining;
 	range->starting_lba = offset;
 
-	rc = spdk_nvme_ns_cmd_dataset_management(nbdev->nvme_ns->ns, nvme_ch->qpair,
+	rc = spdk_nvme_ns_cmd_dataset_management(ns, qpair,
 			SPDK_NVME_DSM_ATTR_DEALLOCATE,
 			dsm_ranges, num_ranges,
 			bdev_nvme_queued_done, bio);
@@ -2611,12 +3304,12 @@ bdev_nvme_admin_passthru(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
 }
 
 static int
-bdev_nvme_io_passthru(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
+bdev_nvme_io_passthru(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
 		      struct nvme_bdev_io *bio,
 		      struct spdk_nvme_cmd *cmd, void *buf, size_t nbytes)
 {
-	struct nvme_io_channel *nvme_ch = spdk_io_channel_get_ctx(ch);
-	uint32_t max_xfer_size = spdk_nvme_ctrlr_get_max_xfer_size(nbdev->nvme_bdev_ctrlr->ctrlr);
+	struct spdk_nvme_ctrlr *ctrlr = spdk_nvme_ns_get_ctrlr(ns);
+	uint32_t max_xfer_size = spdk_nvme_ctrlr_get_max_xfer_size(ctrlr);
 
 	if (nbytes > max_xfer_size) {
 		SPDK_ERRLOG("nbytes is greater than MDTS %" PRIu32 ".\n", max_xfer_size);
@@ -2627,27 +3320,27 @@ bdev_nvme_io_passthru(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
 	 * Each NVMe bdev is a specific namespace, and all NVMe I/O commands require a nsid,
 	 * so fill it out automatically.
 	 */
-	cmd->nsid = spdk_nvme_ns_get_id(nbdev->nvme_ns->ns);
+	cmd->nsid = spdk_nvme_ns_get_id(ns);
 
-	return spdk_nvme_ctrlr_cmd_io_raw(nbdev->nvme_bdev_ctrlr->ctrlr, nvme_ch->qpair, cmd, buf,
+	return spdk_nvme_ctrlr_cmd_io_raw(ctrlr, qpair, cmd, buf,
 					  (uint32_t)nbytes, bdev_nvme_queued_done, bio);
 }
 
 static int
-bdev_nvme_io_passthru_md(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
+bdev_nvme_io_passthru_md(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
 			 struct nvme_bdev_io *bio,
 			 struct spdk_nvme_cmd *cmd, void *buf, size_t nbytes, void *md_buf, size_t md_len)
 {
-	struct nvme_io_channel *nvme_ch = spdk_io_channel_get_ctx(ch);
-	size_t nr_sectors = nbytes / spdk_nvme_ns_get_extended_sector_size(nbdev->nvme_ns->ns);
-	uint32_t max_xfer_size = spdk_nvme_ctrlr_get_max_xfer_size(nbdev->nvme_bdev_ctrlr->ctrlr);
+	struct spdk_nvme_ctrlr *ctrlr = spdk_nvme_ns_get_ctrlr(ns);
+	size_t nr_sectors = nbytes / spdk_nvme_ns_get_extended_sector_size(ns);
+	uint32_t max_xfer_size = spdk_nvme_ctrlr_get_max_xfer_size(ctrlr);
 
 	if (nbytes > max_xfer_size) {
 		SPDK_ERRLOG("nbytes is greater than MDTS %" PRIu32 ".\n", max_xfer_size);
 		return -EINVAL;
 	}
 
-	if (md_len != nr_sectors * spdk_nvme_ns_get_md_size(nbdev->nvme_ns->ns)) {
+	if (md_len != nr_sectors * spdk_nvme_ns_get_md_size(ns)) {
 		SPDK_ERRLOG("invalid meta data buffer size\n");
 		return -EINVAL;
 	}
@@ -2656,9 +3349,9 @@ bdev_nvme_io_passthru_md(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
 	 * Each NVMe bdev is a specific namespace, and all NVMe I/O commands require a nsid,
 	 * so fill it out automatically.
 	 */
-	cmd->nsid = spdk_nvme_ns_get_id(nbdev->nvme_ns->ns);
+	cmd->nsid = spdk_nvme_ns_get_id(ns);
 
-	return spdk_nvme_ctrlr_cmd_io_raw_with_md(nbdev->nvme_bdev_ctrlr->ctrlr, nvme_ch->qpair, cmd, buf,
+	return spdk_nvme_ctrlr_cmd_io_raw_with_md(ctrlr, qpair, cmd, buf,
 			(uint32_t)nbytes, md_buf, bdev_nvme_queued_done, bio);
 }
 
@@ -2695,14 +3388,23 @@ bdev_nvme_abort(struct nvme_bdev *nbdev, struct spdk_io_channel *ch,
 		struct nvme_bdev_io *bio, struct nvme_bdev_io *bio_to_abort)
 {
 	struct nvme_io_channel *nvme_ch = spdk_io_channel_get_ctx(ch);
+	struct nvme_io_path *io_path = bio_to_abort->io_path;
 	int rc;
 
 	bio->orig_thread = spdk_io_channel_get_thread(ch);
 
-	rc = spdk_nvme_ctrlr_cmd_abort_ext(nbdev->nvme_bdev_ctrlr->ctrlr,
-					   nvme_ch->qpair,
-					   bio_to_abort,
-					   bdev_nvme_abort_done, bio);
+	if (io_path != NULL && io_path->nvme_ch != NULL && io_path->nvme_ch->qpair != NULL) {
+		/* The I/O to abort was submitted through a path of another controller. */
+		rc = spdk_nvme_ctrlr_cmd_abort_ext(io_path->ctrlr->ctrlr,
+						   io_path->nvme_ch->qpair,
+						   bio_to_abort,
+						   bdev_nvme_abort_done, bio);
+	} else {
+		rc = spdk_nvme_ctrlr_cmd_abort_ext(nbdev->nvme_bdev_ctrlr->ctrlr,
+						   nvme_ch->qpair,
+						   bio_to_abort,
+						   bdev_nvme_abort_done, bio);
+	}
 	if (rc == -ENOENT) {
 		/* If no command was found in I/O qpair, the target command may be
 		 * admin command. Only a single thread tries aborting admin command
@@ -2735,6 +3437,11 @@ bdev_nvme_get_spdk_running_config(FILE *fp)
 		const char *trtype;
 		const char *prchk_flags;
 
+		/* Multipath can only be configured through RPC */
+		if (nvme_bdev_ctrlr->secondary) {
+			continue;
+		}
+
 		trtype = spdk_nvme_transport_id_trtype_str(nvme_bdev_ctrlr->trid->trtype);
 		if (!trtype) {
 			continue;
@@ -2880,11 +3587,28 @@ bdev_nvme_config_json(struct spdk_json_write_ctx *w)
 					   (nvme_bdev_ctrlr->prchk_flags & SPDK_NVME_IO_FLAGS_PRCHK_REFTAG) != 0);
 		spdk_json_write_named_bool(w, "prchk_guard",
 					   (nvme_bdev_ctrlr->prchk_flags & SPDK_NVME_IO_FLAGS_PRCHK_GUARD) != 0);
+		if (nvme_bdev_ctrlr->secondary) {
+			/* Secondaries follow their primary in the list */
+			spdk_json_write_named_bool(w, "multipath", true);
+		}
 
 		spdk_json_write_object_end(w);
 
 		spdk_json_write_object_end(w);
 
+		if (nvme_bdev_ctrlr->mp_policy != NVME_BDEV_MP_POLICY_ACTIVE_PASSIVE) {
+			spdk_json_write_object_begin(w);
+			spdk_json_write_named_string(w, "method", "bdev_nvme_set_multipath_policy");
+
+			spdk_json_write_named_object_begin(w, "params");
+			spdk_json_write_named_string(w, "name", nvme_bdev_ctrlr->name);
+			spdk_json_write_named_string(w, "policy",
+						     bdev_nvme_multipath_policy_str(nvme_bdev_ctrlr->mp_policy));
+			spdk_json_write_object_end(w);
+
+			spdk_json_write_object_end(w);
+		}
+
 		for (nsid = 0; nsid < nvme_bdev_ctrlr->num_ns; ++nsid) {
 			if (!nvme_bdev_ctrlr->namespaces[nsid]->populated) {
 				continue;
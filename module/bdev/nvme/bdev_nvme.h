@@ -74,6 +74,7 @@ int bdev_nvme_create(struct spdk_nvme_transport_id *trid,
 		     uint32_t count,
 		     const char *hostnqn,
 		     uint32_t prchk_flags,
+		     bool multipath,
 		     spdk_bdev_create_nvme_fn cb_fn,
 		     void *cb_ctx);
 struct spdk_nvme_ctrlr *bdev_nvme_get_ctrlr(struct spdk_bdev *bdev);
@@ -87,4 +88,15 @@ struct spdk_nvme_ctrlr *bdev_nvme_get_ctrlr(struct spdk_bdev *bdev);
  */
 int bdev_nvme_delete(const char *name);
 
+/**
+ * Select how I/O is spread over the paths of a multipath NVMe controller.
+ *
+ * \param name NVMe controller name
+ * \param policy I/O path selection policy
+ * \return zero on success, -EINVAL on wrong parameters or -ENODEV if controller is not found
+ */
+int bdev_nvme_set_multipath_policy(const char *name, enum nvme_bdev_multipath_policy policy);
+
+const char *bdev_nvme_multipath_policy_str(enum nvme_bdev_multipath_policy policy);
+
 #endif /* SPDK_BDEV_NVME_H */
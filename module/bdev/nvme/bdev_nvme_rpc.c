@@ -180,6 +180,7 @@ struct rpc_bdev_nvme_attach_controller {
 	char *hostsvcid;
 	bool prchk_reftag;
 	bool prchk_guard;
+	bool multipath;
 };
 
 static void
@@ -211,7 +212,8 @@ static const struct spdk_json_object_decoder rpc_bdev_nvme_attach_controller_dec
 	{"hostsvcid", offsetof(struct rpc_bdev_nvme_attach_controller, hostsvcid), spdk_json_decode_string, true},
 
 	{"prchk_reftag", offsetof(struct rpc_bdev_nvme_attach_controller, prchk_reftag), spdk_json_decode_bool, true},
-	{"prchk_guard", offsetof(struct rpc_bdev_nvme_attach_controller, prchk_guard), spdk_json_decode_bool, true}
+	{"prchk_guard", offsetof(struct rpc_bdev_nvme_attach_controller, prchk_guard), spdk_json_decode_bool, true},
+	{"multipath", offsetof(struct rpc_bdev_nvme_attach_controller, multipath), spdk_json_decode_bool, true}
 };
 
 #define NVME_MAX_BDEVS_PER_RPC 128
@@ -335,7 +337,7 @@ rpc_bdev_nvme_attach_controller(struct spdk_jsonrpc_request *request,
 	ctx->request = request;
 	ctx->count = NVME_MAX_BDEVS_PER_RPC;
 	rc = bdev_nvme_create(&trid, &hostid, ctx->req.name, ctx->names, ctx->count, ctx->req.hostnqn,
-			      prchk_flags, rpc_bdev_nvme_attach_controller_done, ctx);
+			      prchk_flags, ctx->req.multipath, rpc_bdev_nvme_attach_controller_done, ctx);
 	if (rc) {
 		spdk_jsonrpc_send_error_response(request, rc, spdk_strerror(-rc));
 		goto cleanup;
@@ -376,6 +378,10 @@ rpc_dump_nvme_controller_info(struct spdk_json_write_ctx *w,
 	nvme_bdev_dump_trid_json(trid, w);
 	spdk_json_write_object_end(w);
 
+	if (nvme_bdev_ctrlr->secondary) {
+		spdk_json_write_named_bool(w, "multipath", true);
+	}
+
 	spdk_json_write_object_end(w);
 }
 
@@ -423,7 +429,12 @@ rpc_bdev_nvme_get_controllers(struct spdk_jsonrpc_request *request,
 	spdk_json_write_array_begin(w);
 
 	if (ctrlr != NULL) {
+		struct nvme_bdev_ctrlr *path_ctrlr;
+
 		rpc_dump_nvme_controller_info(w, ctrlr);
+		TAILQ_FOREACH(path_ctrlr, &ctrlr->paths, path_tailq) {
+			rpc_dump_nvme_controller_info(w, path_ctrlr);
+		}
 	} else {
 		for (ctrlr = nvme_bdev_first_ctrlr(); ctrlr; ctrlr = nvme_bdev_next_ctrlr(ctrlr))  {
 			rpc_dump_nvme_controller_info(w, ctrlr);
@@ -487,6 +498,73 @@ SPDK_RPC_REGISTER("bdev_nvme_detach_controller", rpc_bdev_nvme_detach_controller
 		  SPDK_RPC_RUNTIME)
 SPDK_RPC_REGISTER_ALIAS_DEPRECATED(bdev_nvme_detach_controller, delete_nvme_controller)
 
+struct rpc_bdev_nvme_set_multipath_policy {
+	char *name;
+	enum nvme_bdev_multipath_policy policy;
+};
+
+static void
+free_rpc_bdev_nvme_set_multipath_policy(struct rpc_bdev_nvme_set_multipath_policy *req)
+{
+	free(req->name);
+}
+
+static int
+rpc_decode_multipath_policy(const struct spdk_json_val *val, void *out)
+{
+	enum nvme_bdev_multipath_policy *policy = out;
+
+	if (spdk_json_strequal(val, "active_passive") == true) {
+		*policy = NVME_BDEV_MP_POLICY_ACTIVE_PASSIVE;
+	} else if (spdk_json_strequal(val, "round_robin") == true) {
+		*policy = NVME_BDEV_MP_POLICY_ROUND_ROBIN;
+	} else if (spdk_json_strequal(val, "queue_depth") == true) {
+		*policy = NVME_BDEV_MP_POLICY_QUEUE_DEPTH;
+	} else {
+		SPDK_NOTICELOG("Invalid parameter value: policy\n");
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static const struct spdk_json_object_decoder rpc_bdev_nvme_set_multipath_policy_decoders[] = {
+	{"name", offsetof(struct rpc_bdev_nvme_set_multipath_policy, name), spdk_json_decode_string},
+	{"policy", offsetof(struct rpc_bdev_nvme_set_multipath_policy, policy), rpc_decode_multipath_policy},
+};
+
+static void
+rpc_bdev_nvme_set_multipath_policy(struct spdk_jsonrpc_request *request,
+				   const struct spdk_json_val *params)
+{
+	struct rpc_bdev_nvme_set_multipath_policy req = {NULL};
+	struct spdk_json_write_ctx *w;
+	int rc;
+
+	if (spdk_json_decode_object(params, rpc_bdev_nvme_set_multipath_policy_decoders,
+				    SPDK_COUNTOF(rpc_bdev_nvme_set_multipath_policy_decoders),
+				    &req)) {
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS,
+						 "spdk_json_decode_object failed");
+		goto cleanup;
+	}
+
+	rc = bdev_nvme_set_multipath_policy(req.name, req.policy);
+	if (rc != 0) {
+		spdk_jsonrpc_send_error_response(request, rc, spdk_strerror(-rc));
+		goto cleanup;
+	}
+
+	w = spdk_jsonrpc_begin_result(request);
+	spdk_json_write_bool(w, true);
+	spdk_jsonrpc_end_result(request, w);
+
+cleanup:
+	free_rpc_bdev_nvme_set_multipath_policy(&req);
+}
+SPDK_RPC_REGISTER("bdev_nvme_set_multipath_policy", rpc_bdev_nvme_set_multipath_policy,
+		  SPDK_RPC_RUNTIME)
+
 struct rpc_apply_firmware {
 	char *filename;
 	char *bdev_name;
@@ -63,6 +63,10 @@ nvme_bdev_ctrlr_get_by_name(const char *name)
 	}
 
 	TAILQ_FOREACH(nvme_bdev_ctrlr, &g_nvme_bdev_ctrlrs, tailq) {
+		/* Secondary paths share the name of their primary controller */
+		if (nvme_bdev_ctrlr->secondary) {
+			continue;
+		}
 		if (strcmp(name, nvme_bdev_ctrlr->name) == 0) {
 			return nvme_bdev_ctrlr;
 		}
@@ -116,13 +120,20 @@ static void
 nvme_bdev_unregister_cb(void *io_device)
 {
 	struct nvme_bdev_ctrlr *nvme_bdev_ctrlr = io_device;
+	struct nvme_bdev_ctrlr *path_ctrlr, *tmp;
 	uint32_t i;
 
 	pthread_mutex_lock(&g_bdev_nvme_mutex);
 	TAILQ_REMOVE(&g_nvme_bdev_ctrlrs, nvme_bdev_ctrlr, tailq);
+	/* No channel of this controller is left, so its secondaries can simply be unlinked */
+	TAILQ_FOREACH_SAFE(path_ctrlr, &nvme_bdev_ctrlr->paths, path_tailq, tmp) {
+		TAILQ_REMOVE(&nvme_bdev_ctrlr->paths, path_ctrlr, path_tailq);
+		path_ctrlr->primary = NULL;
+	}
 	pthread_mutex_unlock(&g_bdev_nvme_mutex);
 	spdk_nvme_detach(nvme_bdev_ctrlr->ctrlr);
 	spdk_poller_unregister(&nvme_bdev_ctrlr->adminq_timer_poller);
+	free(nvme_bdev_ctrlr->ana_log_page);
 	free(nvme_bdev_ctrlr->name);
 	for (i = 0; i < nvme_bdev_ctrlr->num_ns; i++) {
 		free(nvme_bdev_ctrlr->namespaces[i]);
@@ -142,9 +153,41 @@ nvme_bdev_unregister_cb(void *io_device)
 	pthread_mutex_unlock(&g_bdev_nvme_mutex);
 }
 
+static void
+nvme_bdev_ctrlr_remove_path_done(struct spdk_io_channel_iter *i, int status)
+{
+	struct nvme_bdev_ctrlr *nvme_bdev_ctrlr = spdk_io_channel_iter_get_ctx(i);
+	struct nvme_bdev_ctrlr *primary = spdk_io_channel_iter_get_io_device(i);
+
+	spdk_io_device_unregister(nvme_bdev_ctrlr, nvme_bdev_unregister_cb);
+
+	pthread_mutex_lock(&g_bdev_nvme_mutex);
+	primary->ref--;
+
+	if (primary->ref == 0 && primary->destruct) {
+		pthread_mutex_unlock(&g_bdev_nvme_mutex);
+		nvme_bdev_ctrlr_destruct(primary);
+		return;
+	}
+
+	pthread_mutex_unlock(&g_bdev_nvme_mutex);
+}
+
+static void
+nvme_bdev_ctrlr_remove_path(struct spdk_io_channel_iter *i)
+{
+	struct spdk_io_channel *ch = spdk_io_channel_iter_get_channel(i);
+	struct nvme_io_channel *nvme_ch = spdk_io_channel_get_ctx(ch);
+
+	nvme_io_channel_remove_path(nvme_ch, spdk_io_channel_iter_get_ctx(i));
+	spdk_for_each_channel_continue(i, 0);
+}
+
 int
 nvme_bdev_ctrlr_destruct(struct nvme_bdev_ctrlr *nvme_bdev_ctrlr)
 {
+	struct nvme_bdev_ctrlr *primary;
+
 	assert(nvme_bdev_ctrlr->destruct);
 	pthread_mutex_lock(&g_bdev_nvme_mutex);
 
@@ -172,6 +215,23 @@ nvme_bdev_ctrlr_destruct(struct nvme_bdev_ctrlr *nvme_bdev_ctrlr)
 		bdev_ocssd_fini_ctrlr(nvme_bdev_ctrlr);
 	}
 
+	pthread_mutex_lock(&g_bdev_nvme_mutex);
+	primary = nvme_bdev_ctrlr->primary;
+	if (primary != NULL) {
+		TAILQ_REMOVE(&primary->paths, nvme_bdev_ctrlr, path_tailq);
+		nvme_bdev_ctrlr->primary = NULL;
+		/* Keep the primary registered until its channels are walked */
+		primary->ref++;
+	}
+	pthread_mutex_unlock(&g_bdev_nvme_mutex);
+
+	if (primary != NULL) {
+		/* Release the channels held by the primary's channels before unregistering */
+		spdk_for_each_channel(primary, nvme_bdev_ctrlr_remove_path, nvme_bdev_ctrlr,
+				      nvme_bdev_ctrlr_remove_path_done);
+		return SPDK_POLLER_BUSY;
+	}
+
 	spdk_io_device_unregister(nvme_bdev_ctrlr, nvme_bdev_unregister_cb);
 	return SPDK_POLLER_BUSY;
 }
@@ -202,3 +262,75 @@ nvme_bdev_detach_bdev_from_ns(struct nvme_bdev *nvme_disk)
 
 	pthread_mutex_unlock(&g_bdev_nvme_mutex);
 }
+
+int
+nvme_io_channel_add_path(struct nvme_io_channel *nvme_ch, struct nvme_bdev_ctrlr *path_ctrlr)
+{
+	struct nvme_io_path *io_path;
+
+	TAILQ_FOREACH(io_path, &nvme_ch->io_paths, tailq) {
+		if (io_path->ctrlr == path_ctrlr) {
+			return 0;
+		}
+	}
+
+	io_path = calloc(1, sizeof(*io_path));
+	if (io_path == NULL) {
+		return -ENOMEM;
+	}
+
+	io_path->ch = spdk_get_io_channel(path_ctrlr);
+	if (io_path->ch == NULL) {
+		free(io_path);
+		return -ENODEV;
+	}
+
+	io_path->ctrlr = path_ctrlr;
+	io_path->nvme_ch = spdk_io_channel_get_ctx(io_path->ch);
+	TAILQ_INSERT_TAIL(&nvme_ch->io_paths, io_path, tailq);
+	nvme_ch->num_io_paths++;
+
+	return 0;
+}
+
+void
+nvme_io_channel_remove_path(struct nvme_io_channel *nvme_ch, struct nvme_bdev_ctrlr *path_ctrlr)
+{
+	struct nvme_io_path *io_path;
+
+	TAILQ_FOREACH(io_path, &nvme_ch->io_paths, tailq) {
+		if (io_path->ctrlr == path_ctrlr && io_path != &nvme_ch->local_path) {
+			break;
+		}
+	}
+
+	if (io_path == NULL) {
+		return;
+	}
+
+	TAILQ_REMOVE(&nvme_ch->io_paths, io_path, tailq);
+	nvme_ch->num_io_paths--;
+	if (nvme_ch->last_path == io_path) {
+		nvme_ch->last_path = NULL;
+	}
+
+	io_path->removed = true;
+	spdk_put_io_channel(io_path->ch);
+	io_path->ch = NULL;
+	io_path->nvme_ch = NULL;
+
+	if (io_path->num_outstanding == 0) {
+		free(io_path);
+	}
+}
+
+void
+nvme_io_path_put(struct nvme_io_path *io_path)
+{
+	assert(io_path->num_outstanding > 0);
+	io_path->num_outstanding--;
+
+	if (io_path->removed && io_path->num_outstanding == 0) {
+		free(io_path);
+	}
+}
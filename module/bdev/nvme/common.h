@@ -51,6 +51,15 @@ enum nvme_bdev_ns_type {
 	NVME_BDEV_NS_OCSSD	= 2,
 };
 
+enum nvme_bdev_multipath_policy {
+	/** Use the first usable path until it fails. */
+	NVME_BDEV_MP_POLICY_ACTIVE_PASSIVE	= 0,
+	/** Rotate among the usable paths in the best ANA state. */
+	NVME_BDEV_MP_POLICY_ROUND_ROBIN		= 1,
+	/** Use the path in the best ANA state with the fewest outstanding I/O. */
+	NVME_BDEV_MP_POLICY_QUEUE_DEPTH		= 2,
+};
+
 struct nvme_bdev_ns {
 	uint32_t		id;
 	enum nvme_bdev_ns_type	type;
@@ -65,6 +74,10 @@ struct nvme_bdev_ns {
 	struct nvme_bdev_ctrlr	*ctrlr;
 	TAILQ_HEAD(, nvme_bdev)	bdevs;
 	void			*type_ctx;
+
+	/** ANA state of the namespace as reported by its controller */
+	enum spdk_nvme_ana_state	ana_state;
+	uint32_t			ana_group_id;
 };
 
 struct ocssd_bdev_ctrlr;
@@ -99,6 +112,26 @@ struct nvme_bdev_ctrlr {
 
 	struct ocssd_bdev_ctrlr		*ocssd_ctrlr;
 
+	/** ANA log page buffer, NULL if the controller doesn't report ANA */
+	struct spdk_nvme_ana_page	*ana_log_page;
+	uint32_t			ana_log_page_size;
+	bool				ana_log_page_updating;
+	/** Set from any thread to have the admin queue poller re-read the ANA log page */
+	bool				ana_log_page_stale;
+
+	/**
+	 * Multipath: a controller attached with the name of an existing one is
+	 * marked as secondary and becomes an additional I/O path to the
+	 * namespaces of that primary controller. It doesn't create bdevs on its own.
+	 */
+	bool					secondary;
+	/** Primary controller of a secondary, NULL once unlinked */
+	struct nvme_bdev_ctrlr			*primary;
+	/** Secondary controllers of a primary */
+	TAILQ_HEAD(, nvme_bdev_ctrlr)		paths;
+	TAILQ_ENTRY(nvme_bdev_ctrlr)		path_tailq;
+	enum nvme_bdev_multipath_policy		mp_policy;
+
 	/** linked list pointer for device list */
 	TAILQ_ENTRY(nvme_bdev_ctrlr)	tailq;
 };
@@ -127,6 +160,7 @@ struct nvme_async_probe_ctx {
 	const char **names;
 	uint32_t count;
 	uint32_t prchk_flags;
+	bool multipath;
 	struct spdk_poller *poller;
 	struct spdk_nvme_transport_id trid;
 	struct spdk_nvme_ctrlr_opts opts;
@@ -136,12 +170,33 @@ struct nvme_async_probe_ctx {
 };
 
 struct ocssd_io_channel;
+struct nvme_io_channel;
+
+/** An I/O path of a channel, i.e. the qpair of one of the controllers backing a bdev */
+struct nvme_io_path {
+	struct nvme_bdev_ctrlr		*ctrlr;
+	/** I/O channel of a secondary controller, NULL for the channel's own qpair */
+	struct spdk_io_channel		*ch;
+	struct nvme_io_channel		*nvme_ch;
+	/** Number of I/O submitted through this path and not completed yet */
+	uint32_t			num_outstanding;
+	/** The path was removed from its channel and is freed by its last completion */
+	bool				removed;
+	TAILQ_ENTRY(nvme_io_path)	tailq;
+};
 
 struct nvme_io_channel {
 	struct spdk_nvme_qpair		*qpair;
 	struct nvme_bdev_poll_group	*group;
 	TAILQ_HEAD(, spdk_bdev_io)	pending_resets;
 	struct ocssd_io_channel		*ocssd_ioch;
+
+	/** Own qpair as an I/O path, always the first entry in io_paths */
+	struct nvme_io_path		local_path;
+	TAILQ_HEAD(, nvme_io_path)	io_paths;
+	uint32_t			num_io_paths;
+	/** Last path used by the round-robin policy */
+	struct nvme_io_path		*last_path;
 };
 
 void nvme_ctrlr_populate_namespace_done(struct nvme_async_probe_ctx *ctx,
@@ -160,4 +215,8 @@ int nvme_bdev_ctrlr_destruct(struct nvme_bdev_ctrlr *nvme_bdev_ctrlr);
 void nvme_bdev_attach_bdev_to_ns(struct nvme_bdev_ns *nvme_ns, struct nvme_bdev *nvme_disk);
 void nvme_bdev_detach_bdev_from_ns(struct nvme_bdev *nvme_disk);
 
+int nvme_io_channel_add_path(struct nvme_io_channel *nvme_ch, struct nvme_bdev_ctrlr *path_ctrlr);
+void nvme_io_channel_remove_path(struct nvme_io_channel *nvme_ch, struct nvme_bdev_ctrlr *path_ctrlr);
+void nvme_io_path_put(struct nvme_io_path *io_path);
+
 #endif /* SPDK_COMMON_BDEV_NVME_H */
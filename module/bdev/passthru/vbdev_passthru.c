@@ -358,6 +358,13 @@ vbdev_passthru_submit_request(struct spdk_io_channel *ch, struct spdk_bdev_io *b
 		rc = spdk_bdev_abort(pt_node->base_desc, pt_ch->base_ch, bdev_io->u.abort.bio_to_abort,
 				     _pt_complete_io, bdev_io);
 		break;
+	case SPDK_BDEV_IO_TYPE_COPY:
+		rc = spdk_bdev_copy_blocks(pt_node->base_desc, pt_ch->base_ch,
+					   bdev_io->u.bdev.offset_blocks,
+					   bdev_io->u.bdev.copy.src_offset_blocks,
+					   bdev_io->u.bdev.num_blocks,
+					   _pt_complete_io, bdev_io);
+		break;
 	default:
 		SPDK_ERRLOG("passthru: unknown I/O type %d\n", bdev_io->type);
 		spdk_bdev_io_complete(bdev_io, SPDK_BDEV_IO_STATUS_FAILED);
@@ -375,6 +382,23 @@ vbdev_passthru_submit_request(struct spdk_io_channel *ch, struct spdk_bdev_io *b
 	}
 }
 
+/* Called when a batch of IO is submitted to this pt vbdev. We pass the IO on as a batch
+ * to the base bdev too, so it can still make use of submitting them together.
+ */
+static void
+vbdev_passthru_submit_request_batch(struct spdk_io_channel *ch, struct spdk_bdev_io **bdev_ios,
+				    int num_ios)
+{
+	struct pt_io_channel *pt_ch = spdk_io_channel_get_ctx(ch);
+	int i;
+
+	spdk_bdev_io_batch_start(pt_ch->base_ch);
+	for (i = 0; i < num_ios; i++) {
+		vbdev_passthru_submit_request(ch, bdev_ios[i]);
+	}
+	spdk_bdev_io_batch_flush(pt_ch->base_ch);
+}
+
 /* We'll just call the base bdev and let it answer however if we were more
  * restrictive for some reason (or less) we could get the response back
  * and modify according to our purposes.
@@ -608,6 +632,7 @@ vbdev_passthru_write_config_json(struct spdk_bdev *bdev, struct spdk_json_write_
 static const struct spdk_bdev_fn_table vbdev_passthru_fn_table = {
 	.destruct		= vbdev_passthru_destruct,
 	.submit_request		= vbdev_passthru_submit_request,
+	.submit_request_batch	= vbdev_passthru_submit_request_batch,
 	.io_type_supported	= vbdev_passthru_io_type_supported,
 	.get_io_channel		= vbdev_passthru_get_io_channel,
 	.dump_info_json		= vbdev_passthru_dump_info_json,
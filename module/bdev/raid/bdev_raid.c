@@ -92,12 +92,105 @@ void raid_bdev_module_list_add(struct raid_bdev_module *raid_module)
 	}
 }
 
+/* Size of a rebuild request, rounded up to the alignment required by the raid module */
+#define RAID_BDEV_REBUILD_UNIT_SIZE		(1024 * 1024)
+/* Number of rebuild requests in a window, the rebuild locks two windows at a time */
+#define RAID_BDEV_REBUILD_WINDOW_UNITS		4
+#define RAID_BDEV_REBUILD_MAX_REQUESTS		(2 * RAID_BDEV_REBUILD_WINDOW_UNITS)
+#define RAID_BDEV_REBUILD_QOS_TIMESLICE_US	1000
+#define RAID_BDEV_REBUILD_LOCK_POLL_US		100
+
+/*
+ * raid_bdev_rebuild tracks the rebuild of a replacement base bdev. The raid
+ * bdev is rebuilt in windows from the beginning. The windows below
+ * rebuilt_offset are done and are served by the replacement base bdev like
+ * by any other base bdev. The two windows above it are locked on all raid bdev
+ * io channels, so that foreground writes don't race with the rebuild. The
+ * lock is moved forward every time the lowest locked window is done, while
+ * the rebuild requests keep going in the other one.
+ */
+struct raid_bdev_rebuild {
+	/* The raid bdev being rebuilt */
+	struct raid_bdev		*raid_bdev;
+
+	/* Index of the base bdev being rebuilt */
+	uint8_t				target_idx;
+
+	/* Raid bdev io channel used by the rebuild requests */
+	struct spdk_io_channel		*ch;
+
+	/* Size of a rebuild request and of a window in raid bdev blocks */
+	uint64_t			unit_blocks;
+	uint64_t			window_blocks;
+
+	/* The raid bdev is rebuilt below this offset */
+	uint64_t			rebuilt_offset;
+
+	/* Offset of the next rebuild request */
+	uint64_t			submit_offset;
+
+	/* End of the range locked on all raid bdev io channels */
+	uint64_t			lock_end;
+
+	/* Number of rebuilt blocks in the two locked windows */
+	uint64_t			window_completed[2];
+
+	/* Rebuilt offset and lock end being applied to the raid bdev io channels */
+	uint64_t			update_offset;
+	uint64_t			update_lock_end;
+	bool				updating_channels;
+	bool				update_pending;
+
+	struct raid_bdev_rebuild_request *requests;
+	TAILQ_HEAD(, raid_bdev_rebuild_request) free_requests;
+	uint32_t			num_outstanding;
+	bool				submitting;
+
+	/* Bandwidth limit of the rebuild, 0 means unlimited */
+	uint64_t			mbytes_per_sec;
+	uint64_t			bytes_per_timeslice;
+	int64_t				remaining_bytes;
+	struct spdk_poller		*qos_poller;
+
+	/* First error of the rebuild, the rebuild is stopped when it's set */
+	int				status;
+
+	/* Set when the rebuild state is being cleared, with the final status */
+	bool				finishing;
+	int				finish_status;
+};
+
+/*
+ * brief:
+ * raid_bdev_rebuild_target returns the base bdev being rebuilt.
+ * params:
+ * raid_bdev - pointer to raid bdev
+ * returns:
+ * pointer to the base bdev info of the rebuilt base bdev, NULL if no rebuild is running
+ */
+static inline struct raid_base_bdev_info *
+raid_bdev_rebuild_target(struct raid_bdev *raid_bdev)
+{
+	if (raid_bdev->rebuild == NULL) {
+		return NULL;
+	}
+
+	return &raid_bdev->base_bdev_info[raid_bdev->rebuild->target_idx];
+}
+
 /* Function declarations */
 static void	raid_bdev_examine(struct spdk_bdev *bdev);
 static int	raid_bdev_init(void);
 static void	raid_bdev_deconfigure(struct raid_bdev *raid_bdev,
 				      raid_bdev_destruct_cb cb_fn, void *cb_arg);
 static void	raid_bdev_remove_base_bdev(void *ctx);
+static void	raid_bdev_rebuild_stop(struct raid_bdev_rebuild *rebuild, int status);
+static void	raid_bdev_rebuild_init_channel(struct raid_bdev_rebuild *rebuild,
+		struct raid_bdev_io_channel *raid_ch);
+static void	raid_bdev_rebuild_dump_info_json(struct raid_bdev_rebuild *rebuild,
+		struct spdk_json_write_ctx *w);
+static int	raid_bdev_start_rebuild(struct raid_bdev *raid_bdev, struct spdk_bdev *bdev,
+					uint8_t slot, uint64_t rebuild_mbytes_per_sec);
 
 /*
  * brief:
@@ -123,6 +216,8 @@ raid_bdev_create_cb(void *io_device, void *ctx_buf)
 	assert(raid_bdev->state == RAID_BDEV_STATE_ONLINE);
 
 	raid_ch->num_channels = raid_bdev->num_base_bdevs;
+	TAILQ_INIT(&raid_ch->submitted_ios);
+	TAILQ_INIT(&raid_ch->rebuild_waiting_ios);
 
 	raid_ch->base_channel = calloc(raid_ch->num_channels,
 				       sizeof(struct spdk_io_channel *));
@@ -131,6 +226,14 @@ raid_bdev_create_cb(void *io_device, void *ctx_buf)
 		return -ENOMEM;
 	}
 	for (i = 0; i < raid_ch->num_channels; i++) {
+		/*
+		 * Base bdevs removed from a degraded raid bdev don't have a descriptor
+		 * and their channel is left NULL.
+		 */
+		if (raid_bdev->base_bdev_info[i].desc == NULL) {
+			continue;
+		}
+
 		/*
 		 * Get the spdk_io_channel for all the base bdevs. This is used during
 		 * split logic to send the respective child bdev ios to respective base
@@ -139,19 +242,33 @@ raid_bdev_create_cb(void *io_device, void *ctx_buf)
 		raid_ch->base_channel[i] = spdk_bdev_get_io_channel(
 						   raid_bdev->base_bdev_info[i].desc);
 		if (!raid_ch->base_channel[i]) {
-			uint8_t j;
-
-			for (j = 0; j < i; j++) {
-				spdk_put_io_channel(raid_ch->base_channel[j]);
-			}
-			free(raid_ch->base_channel);
-			raid_ch->base_channel = NULL;
 			SPDK_ERRLOG("Unable to create io channel for base bdev\n");
-			return -ENOMEM;
+			goto err;
 		}
 	}
 
+	if (raid_bdev->module->get_io_channel) {
+		raid_ch->module_channel = raid_bdev->module->get_io_channel(raid_bdev);
+		if (!raid_ch->module_channel) {
+			SPDK_ERRLOG("Unable to create io channel for raid module\n");
+			goto err;
+		}
+	}
+
+	if (raid_bdev->rebuild != NULL) {
+		raid_bdev_rebuild_init_channel(raid_bdev->rebuild, raid_ch);
+	}
+
 	return 0;
+err:
+	for (i = 0; i < raid_ch->num_channels; i++) {
+		if (raid_ch->base_channel[i] != NULL) {
+			spdk_put_io_channel(raid_ch->base_channel[i]);
+		}
+	}
+	free(raid_ch->base_channel);
+	raid_ch->base_channel = NULL;
+	return -ENOMEM;
 }
 
 /*
@@ -174,10 +291,19 @@ raid_bdev_destroy_cb(void *io_device, void *ctx_buf)
 
 	assert(raid_ch != NULL);
 	assert(raid_ch->base_channel);
+	assert(TAILQ_EMPTY(&raid_ch->submitted_ios));
+	assert(TAILQ_EMPTY(&raid_ch->rebuild_waiting_ios));
+	assert(raid_ch->rebuild_lock_poller == NULL);
+
+	if (raid_ch->module_channel) {
+		spdk_put_io_channel(raid_ch->module_channel);
+	}
+
 	for (i = 0; i < raid_ch->num_channels; i++) {
 		/* Free base bdev channels */
-		assert(raid_ch->base_channel[i] != NULL);
-		spdk_put_io_channel(raid_ch->base_channel[i]);
+		if (raid_ch->base_channel[i] != NULL) {
+			spdk_put_io_channel(raid_ch->base_channel[i]);
+		}
 	}
 	free(raid_ch->base_channel);
 	raid_ch->base_channel = NULL;
@@ -259,30 +385,26 @@ raid_bdev_free_base_bdev_resource(struct raid_bdev *raid_bdev,
 
 /*
  * brief:
- * raid_bdev_destruct is the destruct function table pointer for raid bdev
+ * _raid_bdev_destruct closes the base bdevs of the unregistered raid bdev and
+ * frees the raid bdev if no base bdev is left.
  * params:
- * ctxt - pointer to raid_bdev
+ * raid_bdev - pointer to raid_bdev
  * returns:
- * 0 - success
- * non zero - failure
+ * none
  */
-static int
-raid_bdev_destruct(void *ctxt)
+static void
+_raid_bdev_destruct(struct raid_bdev *raid_bdev)
 {
-	struct raid_bdev *raid_bdev = ctxt;
 	struct raid_base_bdev_info *base_info;
 
-	SPDK_DEBUGLOG(SPDK_LOG_BDEV_RAID, "raid_bdev_destruct\n");
-
-	raid_bdev->destruct_called = true;
 	RAID_FOR_EACH_BASE_BDEV(raid_bdev, base_info) {
 		/*
 		 * Close all base bdev descriptors for which call has come from below
 		 * layers.  Also close the descriptors if we have started shutdown.
+		 * Base bdevs missing from a degraded raid bdev are already closed.
 		 */
-		if (g_shutdown_started ||
-		    ((base_info->remove_scheduled == true) &&
-		     (base_info->bdev != NULL))) {
+		if (base_info->bdev != NULL &&
+		    (g_shutdown_started || base_info->remove_scheduled == true)) {
 			raid_bdev_free_base_bdev_resource(raid_bdev, base_info);
 		}
 	}
@@ -303,6 +425,33 @@ raid_bdev_destruct(void *ctxt)
 		SPDK_DEBUGLOG(SPDK_LOG_BDEV_RAID, "raid bdev base bdevs is 0, going to free all in destruct\n");
 		raid_bdev_cleanup(raid_bdev);
 	}
+}
+
+/*
+ * brief:
+ * raid_bdev_destruct is the destruct function table pointer for raid bdev
+ * params:
+ * ctxt - pointer to raid_bdev
+ * returns:
+ * 0 - success
+ * 1 - destruct is completed asynchronously after the running rebuild is stopped
+ */
+static int
+raid_bdev_destruct(void *ctxt)
+{
+	struct raid_bdev *raid_bdev = ctxt;
+
+	SPDK_DEBUGLOG(SPDK_LOG_BDEV_RAID, "raid_bdev_destruct\n");
+
+	raid_bdev->destruct_called = true;
+
+	if (raid_bdev->rebuild != NULL) {
+		raid_bdev->destruct_pending = true;
+		raid_bdev_rebuild_stop(raid_bdev->rebuild, -ECANCELED);
+		return 1;
+	}
+
+	_raid_bdev_destruct(raid_bdev);
 
 	return 0;
 }
@@ -312,6 +461,7 @@ raid_bdev_io_complete(struct raid_bdev_io *raid_io, enum spdk_bdev_io_status sta
 {
 	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(raid_io);
 
+	TAILQ_REMOVE(&raid_io->raid_ch->submitted_ios, raid_io, link);
 	spdk_bdev_io_complete(bdev_io, status);
 }
 
@@ -468,25 +618,48 @@ raid_bdev_get_buf_cb(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io,
 
 /*
  * brief:
- * raid_bdev_submit_request function is the submit_request function pointer of
- * raid bdev function table. This is used to submit the io on raid_bdev to below
- * layers.
+ * raid_bdev_io_overlaps_rebuild_lock checks if the raid bdev io modifies the
+ * range locked by the rebuild on the raid bdev io channel. Reads don't need to
+ * wait for the rebuild because they are not served by the rebuilt base bdev
+ * in the locked range.
  * params:
- * ch - pointer to raid bdev io channel
+ * raid_ch - pointer to raid bdev io channel
  * bdev_io - pointer to parent bdev_io on raid bdev device
  * returns:
+ * true - if the io has to wait for the rebuild to leave the locked range
+ * false - otherwise
+ */
+static bool
+raid_bdev_io_overlaps_rebuild_lock(struct raid_bdev_io_channel *raid_ch,
+				   struct spdk_bdev_io *bdev_io)
+{
+	if (!raid_ch->rebuild_active) {
+		return false;
+	}
+
+	if (bdev_io->type != SPDK_BDEV_IO_TYPE_WRITE &&
+	    bdev_io->type != SPDK_BDEV_IO_TYPE_UNMAP) {
+		return false;
+	}
+
+	return bdev_io->u.bdev.offset_blocks < raid_ch->rebuild_lock_end &&
+	       bdev_io->u.bdev.offset_blocks + bdev_io->u.bdev.num_blocks > raid_ch->rebuild_offset;
+}
+
+/*
+ * brief:
+ * _raid_bdev_submit_request dispatches the raid bdev io to the raid module.
+ * params:
+ * raid_io - pointer to raid_bdev_io
+ * returns:
  * none
  */
 static void
-raid_bdev_submit_request(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io)
+_raid_bdev_submit_request(struct raid_bdev_io *raid_io)
 {
-	struct raid_bdev_io *raid_io = (struct raid_bdev_io *)bdev_io->driver_ctx;
+	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(raid_io);
 
-	raid_io->raid_bdev = bdev_io->bdev->ctxt;
-	raid_io->raid_ch = spdk_io_channel_get_ctx(ch);
-	raid_io->base_bdev_io_remaining = 0;
-	raid_io->base_bdev_io_submitted = 0;
-	raid_io->base_bdev_io_status = SPDK_BDEV_IO_STATUS_SUCCESS;
+	TAILQ_INSERT_TAIL(&raid_io->raid_ch->submitted_ios, raid_io, link);
 
 	switch (bdev_io->type) {
 	case SPDK_BDEV_IO_TYPE_READ:
@@ -513,6 +686,36 @@ raid_bdev_submit_request(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_i
 	}
 }
 
+/*
+ * brief:
+ * raid_bdev_submit_request function is the submit_request function pointer of
+ * raid bdev function table. This is used to submit the io on raid_bdev to below
+ * layers.
+ * params:
+ * ch - pointer to raid bdev io channel
+ * bdev_io - pointer to parent bdev_io on raid bdev device
+ * returns:
+ * none
+ */
+static void
+raid_bdev_submit_request(struct spdk_io_channel *ch, struct spdk_bdev_io *bdev_io)
+{
+	struct raid_bdev_io *raid_io = (struct raid_bdev_io *)bdev_io->driver_ctx;
+
+	raid_io->raid_bdev = bdev_io->bdev->ctxt;
+	raid_io->raid_ch = spdk_io_channel_get_ctx(ch);
+	raid_io->base_bdev_io_remaining = 0;
+	raid_io->base_bdev_io_submitted = 0;
+	raid_io->base_bdev_io_status = SPDK_BDEV_IO_STATUS_SUCCESS;
+
+	if (raid_bdev_io_overlaps_rebuild_lock(raid_io->raid_ch, bdev_io)) {
+		TAILQ_INSERT_TAIL(&raid_io->raid_ch->rebuild_waiting_ios, raid_io, link);
+		return;
+	}
+
+	_raid_bdev_submit_request(raid_io);
+}
+
 /*
  * brief:
  * _raid_bdev_io_type_supported checks whether io_type is supported in
@@ -540,7 +743,7 @@ _raid_bdev_io_type_supported(struct raid_bdev *raid_bdev, enum spdk_bdev_io_type
 
 	RAID_FOR_EACH_BASE_BDEV(raid_bdev, base_info) {
 		if (base_info->bdev == NULL) {
-			assert(false);
+			/* Base bdev removed from a degraded raid bdev */
 			continue;
 		}
 
@@ -603,25 +806,20 @@ raid_bdev_get_io_channel(void *ctxt)
 
 /*
  * brief:
- * raid_bdev_dump_info_json is the function table pointer for raid bdev
+ * raid_bdev_write_info_json writes the state of the raid bdev into the
+ * current json object. It is shared by the bdev info dump and the
+ * bdev_raid_get_bdevs RPC.
  * params:
- * ctx - pointer to raid_bdev
+ * raid_bdev - pointer to raid_bdev
  * w - pointer to json context
  * returns:
- * 0 - success
- * non zero - failure
+ * none
  */
-static int
-raid_bdev_dump_info_json(void *ctx, struct spdk_json_write_ctx *w)
+void
+raid_bdev_write_info_json(struct raid_bdev *raid_bdev, struct spdk_json_write_ctx *w)
 {
-	struct raid_bdev *raid_bdev = ctx;
 	struct raid_base_bdev_info *base_info;
 
-	SPDK_DEBUGLOG(SPDK_LOG_BDEV_RAID, "raid_bdev_dump_config_json\n");
-	assert(raid_bdev != NULL);
-
-	/* Dump the raid bdev configuration related information */
-	spdk_json_write_named_object_begin(w, "raid");
 	spdk_json_write_named_uint32(w, "strip_size", raid_bdev->strip_size);
 	spdk_json_write_named_uint32(w, "strip_size_kb", raid_bdev->strip_size_kb);
 	spdk_json_write_named_uint32(w, "state", raid_bdev->state);
@@ -639,6 +837,32 @@ raid_bdev_dump_info_json(void *ctx, struct spdk_json_write_ctx *w)
 		}
 	}
 	spdk_json_write_array_end(w);
+	if (raid_bdev->rebuild != NULL) {
+		raid_bdev_rebuild_dump_info_json(raid_bdev->rebuild, w);
+	}
+}
+
+/*
+ * brief:
+ * raid_bdev_dump_info_json is the function table pointer for raid bdev
+ * params:
+ * ctx - pointer to raid_bdev
+ * w - pointer to json context
+ * returns:
+ * 0 - success
+ * non zero - failure
+ */
+static int
+raid_bdev_dump_info_json(void *ctx, struct spdk_json_write_ctx *w)
+{
+	struct raid_bdev *raid_bdev = ctx;
+
+	SPDK_DEBUGLOG(SPDK_LOG_BDEV_RAID, "raid_bdev_dump_config_json\n");
+	assert(raid_bdev != NULL);
+
+	/* Dump the raid bdev configuration related information */
+	spdk_json_write_named_object_begin(w, "raid");
+	raid_bdev_write_info_json(raid_bdev, w);
 	spdk_json_write_object_end(w);
 
 	return 0;
@@ -869,8 +1093,12 @@ static struct {
 } g_raid_level_names[] = {
 	{ "raid0", RAID0 },
 	{ "0", RAID0 },
+	{ "raid1", RAID1 },
+	{ "1", RAID1 },
 	{ "raid5", RAID5 },
 	{ "5", RAID5 },
+	{ "raid10", RAID10 },
+	{ "10", RAID10 },
 	{ }
 };
 
@@ -1331,7 +1559,8 @@ raid_bdev_alloc_base_bdev_resource(struct raid_bdev *raid_bdev, struct spdk_bdev
 
 	SPDK_DEBUGLOG(SPDK_LOG_BDEV_RAID, "bdev %s is claimed\n", bdev->name);
 
-	assert(raid_bdev->state != RAID_BDEV_STATE_ONLINE);
+	/* Only replacement base bdevs are added to an online raid bdev */
+	assert(raid_bdev->state != RAID_BDEV_STATE_ONLINE || raid_bdev->rebuild != NULL);
 	assert(base_bdev_slot < raid_bdev->num_base_bdevs);
 
 	raid_bdev->base_bdev_info[base_bdev_slot].thread = spdk_get_thread();
@@ -1358,6 +1587,7 @@ static int
 raid_bdev_configure(struct raid_bdev *raid_bdev)
 {
 	uint32_t blocklen = 0;
+	uint64_t min_blockcnt = UINT64_MAX;
 	struct spdk_bdev *raid_bdev_gen;
 	struct raid_base_bdev_info *base_info;
 	int rc = 0;
@@ -1366,6 +1596,8 @@ raid_bdev_configure(struct raid_bdev *raid_bdev)
 	assert(raid_bdev->num_base_bdevs_discovered == raid_bdev->num_base_bdevs);
 
 	RAID_FOR_EACH_BASE_BDEV(raid_bdev, base_info) {
+		min_blockcnt = spdk_min(min_blockcnt, base_info->bdev->blockcnt);
+
 		/* Check blocklen for all base bdevs that it should be same */
 		if (blocklen == 0) {
 			blocklen = base_info->bdev->blocklen;
@@ -1386,6 +1618,7 @@ raid_bdev_configure(struct raid_bdev *raid_bdev)
 	raid_bdev->strip_size = (raid_bdev->strip_size_kb * 1024) / blocklen;
 	raid_bdev->strip_size_shift = spdk_u32log2(raid_bdev->strip_size);
 	raid_bdev->blocklen_shift = spdk_u32log2(blocklen);
+	raid_bdev->min_base_bdev_blockcnt = min_blockcnt;
 
 	raid_bdev_gen = &raid_bdev->bdev;
 	raid_bdev_gen->blocklen = blocklen;
@@ -1437,14 +1670,30 @@ static void
 raid_bdev_deconfigure(struct raid_bdev *raid_bdev, raid_bdev_destruct_cb cb_fn,
 		      void *cb_arg)
 {
-	if (raid_bdev->state != RAID_BDEV_STATE_ONLINE) {
+	if (raid_bdev->state != RAID_BDEV_STATE_ONLINE || raid_bdev->destruct_pending) {
 		if (cb_fn) {
 			cb_fn(cb_arg, 0);
 		}
 		return;
 	}
 
-	assert(raid_bdev->num_base_bdevs == raid_bdev->num_base_bdevs_discovered);
+	if (raid_bdev->rebuild != NULL) {
+		/* The raid bdev is deconfigured once the rebuild stops */
+		if (raid_bdev->deconfigure_pending && raid_bdev->deconfigure_cb_fn != NULL) {
+			if (cb_fn) {
+				cb_fn(cb_arg, -EBUSY);
+			}
+			return;
+		}
+		raid_bdev->deconfigure_pending = true;
+		raid_bdev->deconfigure_cb_fn = cb_fn;
+		raid_bdev->deconfigure_cb_arg = cb_arg;
+		raid_bdev_rebuild_stop(raid_bdev->rebuild, -ECANCELED);
+		return;
+	}
+
+	assert(raid_bdev->num_base_bdevs - raid_bdev->num_base_bdevs_discovered <=
+	       raid_bdev->module->base_bdevs_max_degraded);
 	TAILQ_REMOVE(&g_raid_bdev_configured_list, raid_bdev, state_link);
 	if (raid_bdev->module->stop != NULL) {
 		raid_bdev->module->stop(raid_bdev);
@@ -1489,6 +1738,76 @@ raid_bdev_find_by_base_bdev(struct spdk_bdev *base_bdev, struct raid_bdev **_rai
 	return false;
 }
 
+/*
+ * brief:
+ * raid_bdev_channel_remove_base_bdev releases the io channel of the removed
+ * base bdev on each raid bdev io channel.
+ * params:
+ * i - io channel iterator, the context is the removed base bdev info
+ * returns:
+ * none
+ */
+static void
+raid_bdev_channel_remove_base_bdev(struct spdk_io_channel_iter *i)
+{
+	struct raid_bdev *raid_bdev = spdk_io_channel_iter_get_io_device(i);
+	struct raid_base_bdev_info *base_info = spdk_io_channel_iter_get_ctx(i);
+	struct spdk_io_channel *ch = spdk_io_channel_iter_get_channel(i);
+	struct raid_bdev_io_channel *raid_ch = spdk_io_channel_get_ctx(ch);
+	uint8_t idx = base_info - raid_bdev->base_bdev_info;
+
+	SPDK_DEBUGLOG(SPDK_LOG_BDEV_RAID, "slot: %u raid_ch: %p\n", idx, raid_ch);
+
+	if (raid_ch->base_channel[idx] != NULL) {
+		spdk_put_io_channel(raid_ch->base_channel[idx]);
+		raid_ch->base_channel[idx] = NULL;
+	}
+
+	spdk_for_each_channel_continue(i, 0);
+}
+
+static void
+raid_bdev_channels_remove_base_bdev_done(struct spdk_io_channel_iter *i, int status)
+{
+	struct raid_bdev *raid_bdev = spdk_io_channel_iter_get_io_device(i);
+	struct raid_base_bdev_info *base_info = spdk_io_channel_iter_get_ctx(i);
+
+	/* The descriptor might have been already closed by raid_bdev_destruct() */
+	if (base_info->desc != NULL) {
+		raid_bdev_free_base_bdev_resource(raid_bdev, base_info);
+	}
+}
+
+/*
+ * brief:
+ * raid_bdev_can_degrade checks if the online raid bdev can keep working
+ * without the base bdevs scheduled for removal.
+ * params:
+ * raid_bdev - pointer to raid bdev
+ * returns:
+ * true - if the raid bdev can continue in degraded state
+ * false - otherwise
+ */
+static bool
+raid_bdev_can_degrade(struct raid_bdev *raid_bdev)
+{
+	struct raid_base_bdev_info *base_info;
+	uint8_t num_missing = 0;
+
+	RAID_FOR_EACH_BASE_BDEV(raid_bdev, base_info) {
+		/* The base bdev being rebuilt doesn't provide redundancy yet */
+		if (base_info->bdev == NULL || base_info->remove_scheduled ||
+		    raid_bdev_rebuild_target(raid_bdev) == base_info) {
+			num_missing++;
+		}
+	}
+
+	return raid_bdev->state == RAID_BDEV_STATE_ONLINE &&
+	       !raid_bdev->destroy_started &&
+	       num_missing < raid_bdev->num_base_bdevs &&
+	       num_missing <= raid_bdev->module->base_bdevs_max_degraded;
+}
+
 /*
  * brief:
  * raid_bdev_remove_base_bdev function is called by below layers when base_bdev
@@ -1517,6 +1836,14 @@ raid_bdev_remove_base_bdev(void *ctx)
 	assert(base_info->desc);
 	base_info->remove_scheduled = true;
 
+	if (raid_bdev_rebuild_target(raid_bdev) == base_info) {
+		/* The base bdev is closed when the rebuild stops */
+		SPDK_NOTICELOG("base bdev %s being rebuilt was removed from raid bdev %s\n",
+			       base_bdev->name, raid_bdev->bdev.name);
+		raid_bdev_rebuild_stop(raid_bdev->rebuild, -ENODEV);
+		return;
+	}
+
 	if (raid_bdev->destruct_called == true ||
 	    raid_bdev->state == RAID_BDEV_STATE_CONFIGURING) {
 		/*
@@ -1529,6 +1856,16 @@ raid_bdev_remove_base_bdev(void *ctx)
 			raid_bdev_cleanup(raid_bdev);
 			return;
 		}
+	} else if (raid_bdev_can_degrade(raid_bdev)) {
+		/*
+		 * The raid level has enough redundancy to keep serving I/O without this
+		 * base bdev. Release its io channels and close the descriptor.
+		 */
+		SPDK_NOTICELOG("raid bdev %s continues in degraded state without base bdev %s\n",
+			       raid_bdev->bdev.name, base_bdev->name);
+		spdk_for_each_channel(raid_bdev, raid_bdev_channel_remove_base_bdev, base_info,
+				      raid_bdev_channels_remove_base_bdev_done);
+		return;
 	}
 
 	raid_bdev_deconfigure(raid_bdev, NULL, NULL);
@@ -1603,28 +1940,779 @@ raid_bdev_remove_base_devices(struct raid_bdev_config *raid_cfg,
 
 /*
  * brief:
- * raid_bdev_add_base_device function is the actual function which either adds
- * the nvme base device to existing raid bdev or create a new raid bdev. It also claims
- * the base device and keep the open descriptor.
+ * raid_bdev_channel_resubmit_rebuild_waiting_ios submits the raid bdev ios
+ * that were waiting for the rebuild and don't overlap the locked range anymore.
  * params:
- * raid_cfg - pointer to raid bdev config
- * bdev - pointer to base bdev
- * base_bdev_slot - position to add base bdev
+ * raid_ch - pointer to raid bdev io channel
  * returns:
- * 0 - success
- * non zero - failure
+ * none
  */
-static int
-raid_bdev_add_base_device(struct raid_bdev_config *raid_cfg, struct spdk_bdev *bdev,
-			  uint8_t base_bdev_slot)
+static void
+raid_bdev_channel_resubmit_rebuild_waiting_ios(struct raid_bdev_io_channel *raid_ch)
 {
-	struct raid_bdev	*raid_bdev;
-	int			rc;
+	TAILQ_HEAD(, raid_bdev_io) waiting_ios;
+	struct raid_bdev_io *raid_io;
 
-	raid_bdev = raid_cfg->raid_bdev;
-	if (!raid_bdev) {
-		SPDK_ERRLOG("Raid bdev '%s' is not created yet\n", raid_cfg->name);
-		return -ENODEV;
+	TAILQ_INIT(&waiting_ios);
+	TAILQ_SWAP(&waiting_ios, &raid_ch->rebuild_waiting_ios, raid_bdev_io, link);
+
+	while ((raid_io = TAILQ_FIRST(&waiting_ios)) != NULL) {
+		TAILQ_REMOVE(&waiting_ios, raid_io, link);
+		if (raid_bdev_io_overlaps_rebuild_lock(raid_ch, spdk_bdev_io_from_ctx(raid_io))) {
+			TAILQ_INSERT_TAIL(&raid_ch->rebuild_waiting_ios, raid_io, link);
+		} else {
+			_raid_bdev_submit_request(raid_io);
+		}
+	}
+}
+
+/*
+ * brief:
+ * raid_bdev_channel_rebuild_lock_busy checks if any raid bdev io submitted
+ * on the channel before the rebuild lock was moved modifies the locked range.
+ * params:
+ * raid_ch - pointer to raid bdev io channel
+ * returns:
+ * true - if the rebuild has to wait for submitted ios
+ * false - otherwise
+ */
+static bool
+raid_bdev_channel_rebuild_lock_busy(struct raid_bdev_io_channel *raid_ch)
+{
+	struct raid_bdev_io *raid_io;
+
+	TAILQ_FOREACH(raid_io, &raid_ch->submitted_ios, link) {
+		if (raid_bdev_io_overlaps_rebuild_lock(raid_ch, spdk_bdev_io_from_ctx(raid_io))) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static int
+raid_bdev_channel_rebuild_lock_poll(void *arg)
+{
+	struct raid_bdev_io_channel *raid_ch = arg;
+	struct spdk_io_channel_iter *i;
+
+	if (raid_bdev_channel_rebuild_lock_busy(raid_ch)) {
+		return SPDK_POLLER_IDLE;
+	}
+
+	spdk_poller_unregister(&raid_ch->rebuild_lock_poller);
+	i = raid_ch->rebuild_lock_iter;
+	raid_ch->rebuild_lock_iter = NULL;
+	spdk_for_each_channel_continue(i, 0);
+
+	return SPDK_POLLER_BUSY;
+}
+
+/*
+ * brief:
+ * raid_bdev_rebuild_init_channel sets up the rebuild state of a raid bdev io
+ * channel created while the rebuild is running.
+ * params:
+ * rebuild - pointer to raid bdev rebuild
+ * raid_ch - pointer to raid bdev io channel
+ * returns:
+ * none
+ */
+static void
+raid_bdev_rebuild_init_channel(struct raid_bdev_rebuild *rebuild,
+			       struct raid_bdev_io_channel *raid_ch)
+{
+	uint8_t idx = rebuild->target_idx;
+
+	if (rebuild->finishing) {
+		if (rebuild->finish_status != 0 && raid_ch->base_channel[idx] != NULL) {
+			spdk_put_io_channel(raid_ch->base_channel[idx]);
+			raid_ch->base_channel[idx] = NULL;
+		}
+		return;
+	}
+
+	raid_ch->rebuild_active = true;
+	raid_ch->rebuild_idx = idx;
+	if (rebuild->updating_channels) {
+		raid_ch->rebuild_offset = rebuild->update_offset;
+		raid_ch->rebuild_lock_end = rebuild->update_lock_end;
+	} else {
+		raid_ch->rebuild_offset = rebuild->rebuilt_offset;
+		raid_ch->rebuild_lock_end = rebuild->lock_end;
+	}
+}
+
+static void raid_bdev_rebuild_submit(struct raid_bdev_rebuild *rebuild);
+
+/*
+ * brief:
+ * raid_bdev_channel_rebuild_update applies the new rebuilt offset and locked
+ * range to a raid bdev io channel. The iteration continues once the ios
+ * submitted on the channel are out of the locked range.
+ * params:
+ * i - io channel iterator, the context is the raid bdev rebuild
+ * returns:
+ * none
+ */
+static void
+raid_bdev_channel_rebuild_update(struct spdk_io_channel_iter *i)
+{
+	struct raid_bdev_rebuild *rebuild = spdk_io_channel_iter_get_ctx(i);
+	struct spdk_io_channel *ch = spdk_io_channel_iter_get_channel(i);
+	struct raid_bdev_io_channel *raid_ch = spdk_io_channel_get_ctx(ch);
+	struct raid_base_bdev_info *base_info = raid_bdev_rebuild_target(rebuild->raid_bdev);
+	uint8_t idx = rebuild->target_idx;
+
+	if (raid_ch->base_channel[idx] == NULL) {
+		raid_ch->base_channel[idx] = spdk_bdev_get_io_channel(base_info->desc);
+		if (raid_ch->base_channel[idx] == NULL) {
+			SPDK_ERRLOG("Unable to create io channel for base bdev\n");
+			spdk_for_each_channel_continue(i, -ENOMEM);
+			return;
+		}
+	}
+
+	raid_ch->rebuild_active = true;
+	raid_ch->rebuild_idx = idx;
+	raid_ch->rebuild_offset = rebuild->update_offset;
+	raid_ch->rebuild_lock_end = rebuild->update_lock_end;
+
+	raid_bdev_channel_resubmit_rebuild_waiting_ios(raid_ch);
+
+	if (raid_bdev_channel_rebuild_lock_busy(raid_ch)) {
+		raid_ch->rebuild_lock_iter = i;
+		raid_ch->rebuild_lock_poller = SPDK_POLLER_REGISTER(raid_bdev_channel_rebuild_lock_poll,
+					       raid_ch, RAID_BDEV_REBUILD_LOCK_POLL_US);
+		return;
+	}
+
+	spdk_for_each_channel_continue(i, 0);
+}
+
+static void raid_bdev_rebuild_update_channels(struct raid_bdev_rebuild *rebuild);
+
+static void
+raid_bdev_rebuild_update_channels_done(struct spdk_io_channel_iter *i, int status)
+{
+	struct raid_bdev_rebuild *rebuild = spdk_io_channel_iter_get_ctx(i);
+
+	rebuild->updating_channels = false;
+
+	if (status != 0) {
+		if (rebuild->status == 0) {
+			rebuild->status = status;
+		}
+	} else {
+		rebuild->lock_end = rebuild->update_lock_end;
+		if (rebuild->update_pending) {
+			raid_bdev_rebuild_update_channels(rebuild);
+		}
+	}
+
+	raid_bdev_rebuild_submit(rebuild);
+}
+
+/*
+ * brief:
+ * raid_bdev_rebuild_update_channels moves the rebuilt offset and the locked
+ * range on all raid bdev io channels to the current progress of the rebuild.
+ * params:
+ * rebuild - pointer to raid bdev rebuild
+ * returns:
+ * none
+ */
+static void
+raid_bdev_rebuild_update_channels(struct raid_bdev_rebuild *rebuild)
+{
+	if (rebuild->updating_channels) {
+		rebuild->update_pending = true;
+		return;
+	}
+
+	rebuild->updating_channels = true;
+	rebuild->update_pending = false;
+	rebuild->update_offset = rebuild->rebuilt_offset;
+	rebuild->update_lock_end = spdk_min(rebuild->rebuilt_offset + 2 * rebuild->window_blocks,
+					    rebuild->raid_bdev->bdev.blockcnt);
+
+	spdk_for_each_channel(rebuild->raid_bdev, raid_bdev_channel_rebuild_update, rebuild,
+			      raid_bdev_rebuild_update_channels_done);
+}
+
+static void
+raid_bdev_rebuild_free(struct raid_bdev_rebuild *rebuild)
+{
+	uint32_t i;
+
+	if (rebuild->requests != NULL) {
+		for (i = 0; i < RAID_BDEV_REBUILD_MAX_REQUESTS; i++) {
+			spdk_dma_free(rebuild->requests[i].buf);
+		}
+		free(rebuild->requests);
+	}
+	free(rebuild);
+}
+
+/*
+ * brief:
+ * raid_bdev_channel_rebuild_finish clears the rebuild state of a raid bdev io
+ * channel. If the rebuild failed, the channel of the replacement base bdev is
+ * released.
+ * params:
+ * i - io channel iterator, the context is the raid bdev rebuild
+ * returns:
+ * none
+ */
+static void
+raid_bdev_channel_rebuild_finish(struct spdk_io_channel_iter *i)
+{
+	struct raid_bdev_rebuild *rebuild = spdk_io_channel_iter_get_ctx(i);
+	struct spdk_io_channel *ch = spdk_io_channel_iter_get_channel(i);
+	struct raid_bdev_io_channel *raid_ch = spdk_io_channel_get_ctx(ch);
+	uint8_t idx = rebuild->target_idx;
+
+	assert(raid_ch->rebuild_lock_poller == NULL);
+
+	raid_ch->rebuild_active = false;
+	raid_ch->rebuild_offset = 0;
+	raid_ch->rebuild_lock_end = 0;
+
+	if (rebuild->finish_status != 0 && raid_ch->base_channel[idx] != NULL) {
+		spdk_put_io_channel(raid_ch->base_channel[idx]);
+		raid_ch->base_channel[idx] = NULL;
+	}
+
+	raid_bdev_channel_resubmit_rebuild_waiting_ios(raid_ch);
+
+	spdk_for_each_channel_continue(i, 0);
+}
+
+static void
+raid_bdev_rebuild_finish_done(struct spdk_io_channel_iter *i, int status)
+{
+	struct raid_bdev_rebuild *rebuild = spdk_io_channel_iter_get_ctx(i);
+	struct raid_bdev *raid_bdev = rebuild->raid_bdev;
+	struct raid_base_bdev_info *base_info = raid_bdev_rebuild_target(raid_bdev);
+	int finish_status = rebuild->finish_status;
+
+	spdk_poller_unregister(&rebuild->qos_poller);
+	spdk_put_io_channel(rebuild->ch);
+	raid_bdev->rebuild = NULL;
+	raid_bdev_rebuild_free(rebuild);
+
+	if (finish_status == 0) {
+		SPDK_NOTICELOG("rebuild of base bdev %s of raid bdev %s completed\n",
+			       base_info->bdev->name, raid_bdev->bdev.name);
+	} else {
+		SPDK_ERRLOG("rebuild of base bdev %s of raid bdev %s stopped: %s\n",
+			    base_info->bdev->name, raid_bdev->bdev.name,
+			    spdk_strerror(-finish_status));
+		raid_bdev_free_base_bdev_resource(raid_bdev, base_info);
+	}
+
+	if (raid_bdev->destruct_pending) {
+		raid_bdev->destruct_pending = false;
+		_raid_bdev_destruct(raid_bdev);
+		spdk_bdev_destruct_done(&raid_bdev->bdev, 0);
+	} else if (raid_bdev->deconfigure_pending) {
+		raid_bdev->deconfigure_pending = false;
+		raid_bdev_deconfigure(raid_bdev, raid_bdev->deconfigure_cb_fn,
+				      raid_bdev->deconfigure_cb_arg);
+	} else if (finish_status == 0 && base_info->remove_scheduled) {
+		/* The rebuilt base bdev was removed while the rebuild was finishing */
+		raid_bdev_remove_base_bdev(base_info->bdev);
+	}
+}
+
+/*
+ * brief:
+ * raid_bdev_rebuild_check_done finishes the rebuild if it is complete or
+ * stopped and no request or channel update is in progress.
+ * params:
+ * rebuild - pointer to raid bdev rebuild
+ * returns:
+ * none
+ */
+static void
+raid_bdev_rebuild_check_done(struct raid_bdev_rebuild *rebuild)
+{
+	if (rebuild->finishing || rebuild->num_outstanding > 0 || rebuild->updating_channels) {
+		return;
+	}
+
+	if (rebuild->status == 0 && rebuild->rebuilt_offset < rebuild->raid_bdev->bdev.blockcnt) {
+		return;
+	}
+
+	rebuild->finishing = true;
+	rebuild->finish_status = rebuild->status;
+	spdk_for_each_channel(rebuild->raid_bdev, raid_bdev_channel_rebuild_finish, rebuild,
+			      raid_bdev_rebuild_finish_done);
+}
+
+/*
+ * brief:
+ * raid_bdev_rebuild_submit submits rebuild requests for the locked range
+ * until the request limit or the bandwidth limit is reached.
+ * params:
+ * rebuild - pointer to raid bdev rebuild
+ * returns:
+ * none
+ */
+static void
+raid_bdev_rebuild_submit(struct raid_bdev_rebuild *rebuild)
+{
+	struct raid_bdev *raid_bdev = rebuild->raid_bdev;
+	struct raid_bdev_rebuild_request *rebuild_req;
+	int rc;
+
+	/* Requests completed inline are picked up by the outer loop */
+	if (rebuild->submitting) {
+		return;
+	}
+	rebuild->submitting = true;
+
+	while (rebuild->status == 0 && rebuild->submit_offset < rebuild->lock_end) {
+		if (rebuild->mbytes_per_sec != 0 && rebuild->remaining_bytes <= 0) {
+			break;
+		}
+
+		rebuild_req = TAILQ_FIRST(&rebuild->free_requests);
+		if (rebuild_req == NULL) {
+			break;
+		}
+		TAILQ_REMOVE(&rebuild->free_requests, rebuild_req, link);
+
+		rebuild_req->offset_blocks = rebuild->submit_offset;
+		rebuild_req->num_blocks = spdk_min(rebuild->unit_blocks,
+						   rebuild->lock_end - rebuild->submit_offset);
+		rebuild_req->base_bdev_io_remaining = 0;
+		rebuild_req->base_bdev_io_submitted = 0;
+		rebuild_req->base_bdev_io_status = 0;
+
+		rebuild->submit_offset += rebuild_req->num_blocks;
+		rebuild->remaining_bytes -= rebuild_req->num_blocks << raid_bdev->blocklen_shift;
+		rebuild->num_outstanding++;
+
+		rc = raid_bdev->module->submit_rebuild_request(rebuild_req);
+		if (rc != 0) {
+			SPDK_ERRLOG("Failed to submit rebuild request: %s\n", spdk_strerror(-rc));
+			rebuild->num_outstanding--;
+			TAILQ_INSERT_HEAD(&rebuild->free_requests, rebuild_req, link);
+			rebuild->status = rc;
+		}
+	}
+
+	rebuild->submitting = false;
+
+	raid_bdev_rebuild_check_done(rebuild);
+}
+
+/*
+ * brief:
+ * raid_bdev_rebuild_request_complete is called by the raid module when a
+ * rebuild request is done.
+ * params:
+ * rebuild_req - pointer to the rebuild request
+ * status - 0 on success, negative errno otherwise
+ * returns:
+ * none
+ */
+void
+raid_bdev_rebuild_request_complete(struct raid_bdev_rebuild_request *rebuild_req, int status)
+{
+	struct raid_bdev_rebuild *rebuild = rebuild_req->rebuild;
+	uint64_t blockcnt = rebuild->raid_bdev->bdev.blockcnt;
+	uint64_t window_blocks;
+	bool advanced = false;
+	int w;
+
+	assert(rebuild->num_outstanding > 0);
+	rebuild->num_outstanding--;
+
+	if (status != 0) {
+		SPDK_ERRLOG("Rebuild request at offset %" PRIu64 " failed: %s\n",
+			    rebuild_req->offset_blocks, spdk_strerror(-status));
+		if (rebuild->status == 0) {
+			rebuild->status = status;
+		}
+	} else {
+		w = (rebuild_req->offset_blocks / rebuild->window_blocks) & 1;
+		rebuild->window_completed[w] += rebuild_req->num_blocks;
+	}
+
+	TAILQ_INSERT_HEAD(&rebuild->free_requests, rebuild_req, link);
+
+	/* Move the rebuilt offset over the windows that are done */
+	while (rebuild->status == 0 && rebuild->rebuilt_offset < blockcnt) {
+		w = (rebuild->rebuilt_offset / rebuild->window_blocks) & 1;
+		window_blocks = spdk_min(rebuild->window_blocks, blockcnt - rebuild->rebuilt_offset);
+		if (rebuild->window_completed[w] < window_blocks) {
+			break;
+		}
+		rebuild->window_completed[w] = 0;
+		rebuild->rebuilt_offset += window_blocks;
+		advanced = true;
+	}
+
+	if (advanced) {
+		raid_bdev_rebuild_update_channels(rebuild);
+	}
+
+	raid_bdev_rebuild_submit(rebuild);
+}
+
+static int
+raid_bdev_rebuild_qos_poll(void *arg)
+{
+	struct raid_bdev_rebuild *rebuild = arg;
+
+	/* Overshoot of the previous timeslice is paid from this one */
+	if (rebuild->remaining_bytes < 0) {
+		rebuild->remaining_bytes += rebuild->bytes_per_timeslice;
+	} else {
+		rebuild->remaining_bytes = rebuild->bytes_per_timeslice;
+	}
+
+	if (rebuild->remaining_bytes <= 0 || rebuild->finishing) {
+		return SPDK_POLLER_IDLE;
+	}
+
+	raid_bdev_rebuild_submit(rebuild);
+
+	return SPDK_POLLER_BUSY;
+}
+
+/*
+ * brief:
+ * raid_bdev_rebuild_stop stops the rebuild. Outstanding rebuild requests are
+ * completed before the rebuild state is cleared and the replacement base bdev
+ * is closed.
+ * params:
+ * rebuild - pointer to raid bdev rebuild
+ * status - reason of the stop, negative errno
+ * returns:
+ * none
+ */
+static void
+raid_bdev_rebuild_stop(struct raid_bdev_rebuild *rebuild, int status)
+{
+	assert(status != 0);
+
+	if (rebuild->finishing) {
+		return;
+	}
+
+	if (rebuild->status == 0) {
+		rebuild->status = status;
+	}
+
+	raid_bdev_rebuild_check_done(rebuild);
+}
+
+/*
+ * brief:
+ * raid_bdev_rebuild_dump_info_json writes the progress of the rebuild.
+ * params:
+ * rebuild - pointer to raid bdev rebuild
+ * w - pointer to json context
+ * returns:
+ * none
+ */
+static void
+raid_bdev_rebuild_dump_info_json(struct raid_bdev_rebuild *rebuild, struct spdk_json_write_ctx *w)
+{
+	struct raid_bdev *raid_bdev = rebuild->raid_bdev;
+	struct raid_base_bdev_info *base_info = raid_bdev_rebuild_target(raid_bdev);
+
+	spdk_json_write_named_object_begin(w, "rebuild");
+	spdk_json_write_named_string(w, "base_bdev", base_info->bdev->name);
+	spdk_json_write_named_uint64(w, "rebuilt_blocks", rebuild->rebuilt_offset);
+	spdk_json_write_named_uint64(w, "total_blocks", raid_bdev->bdev.blockcnt);
+	spdk_json_write_named_uint32(w, "progress_percent",
+				     rebuild->rebuilt_offset * 100 / raid_bdev->bdev.blockcnt);
+	spdk_json_write_named_uint64(w, "rebuild_mbytes_per_sec", rebuild->mbytes_per_sec);
+	spdk_json_write_object_end(w);
+}
+
+/*
+ * brief:
+ * raid_bdev_rebuild_alloc allocates the rebuild of a base bdev of the raid
+ * bdev and its requests.
+ * params:
+ * raid_bdev - pointer to raid bdev
+ * slot - index of the rebuilt base bdev
+ * buf_align - alignment of the rebuild request buffers
+ * rebuild_mbytes_per_sec - bandwidth limit, 0 for no limit
+ * returns:
+ * pointer to raid bdev rebuild, NULL on allocation failure
+ */
+static struct raid_bdev_rebuild *
+raid_bdev_rebuild_alloc(struct raid_bdev *raid_bdev, uint8_t slot, size_t buf_align,
+			uint64_t rebuild_mbytes_per_sec)
+{
+	struct raid_bdev_rebuild *rebuild;
+	struct raid_bdev_rebuild_request *rebuild_req;
+	uint64_t align_blocks;
+	uint32_t i;
+
+	rebuild = calloc(1, sizeof(*rebuild));
+	if (rebuild == NULL) {
+		return NULL;
+	}
+
+	rebuild->raid_bdev = raid_bdev;
+	rebuild->target_idx = slot;
+	rebuild->mbytes_per_sec = rebuild_mbytes_per_sec;
+	rebuild->bytes_per_timeslice = rebuild_mbytes_per_sec * 1024 * 1024 *
+				       RAID_BDEV_REBUILD_QOS_TIMESLICE_US / SPDK_SEC_TO_USEC;
+	rebuild->remaining_bytes = rebuild->bytes_per_timeslice;
+
+	/*
+	 * Rebuild requests cover whole rows of optimal_io_boundary sized strips,
+	 * so the raid module can rebuild each of them with contiguous base bdev ios.
+	 */
+	rebuild->unit_blocks = SPDK_CEIL_DIV(RAID_BDEV_REBUILD_UNIT_SIZE, raid_bdev->bdev.blocklen);
+	if (raid_bdev->bdev.split_on_optimal_io_boundary) {
+		align_blocks = (uint64_t)raid_bdev->bdev.optimal_io_boundary * raid_bdev->num_base_bdevs;
+		rebuild->unit_blocks = SPDK_CEIL_DIV(rebuild->unit_blocks, align_blocks) * align_blocks;
+	}
+	rebuild->window_blocks = rebuild->unit_blocks * RAID_BDEV_REBUILD_WINDOW_UNITS;
+
+	TAILQ_INIT(&rebuild->free_requests);
+	rebuild->requests = calloc(RAID_BDEV_REBUILD_MAX_REQUESTS, sizeof(*rebuild->requests));
+	if (rebuild->requests == NULL) {
+		raid_bdev_rebuild_free(rebuild);
+		return NULL;
+	}
+
+	for (i = 0; i < RAID_BDEV_REBUILD_MAX_REQUESTS; i++) {
+		rebuild_req = &rebuild->requests[i];
+		rebuild_req->buf = spdk_dma_malloc(rebuild->unit_blocks << raid_bdev->blocklen_shift,
+						   buf_align, NULL);
+		if (rebuild_req->buf == NULL) {
+			raid_bdev_rebuild_free(rebuild);
+			return NULL;
+		}
+		rebuild_req->raid_bdev = raid_bdev;
+		rebuild_req->target_idx = slot;
+		rebuild_req->rebuild = rebuild;
+		TAILQ_INSERT_TAIL(&rebuild->free_requests, rebuild_req, link);
+	}
+
+	return rebuild;
+}
+
+/*
+ * brief:
+ * raid_bdev_start_rebuild adds the bdev to the empty slot of the degraded
+ * online raid bdev and starts rebuilding it in the background.
+ * params:
+ * raid_bdev - pointer to raid bdev
+ * bdev - pointer to the replacement base bdev
+ * slot - index of the missing base bdev
+ * rebuild_mbytes_per_sec - bandwidth limit of the rebuild, 0 for no limit
+ * returns:
+ * 0 - success
+ * non zero - failure
+ */
+static int
+raid_bdev_start_rebuild(struct raid_bdev *raid_bdev, struct spdk_bdev *bdev, uint8_t slot,
+			uint64_t rebuild_mbytes_per_sec)
+{
+	struct raid_bdev_rebuild *rebuild;
+	struct raid_base_bdev_info *base_info;
+	size_t buf_align;
+	uint32_t i;
+	int rc;
+
+	assert(slot < raid_bdev->num_base_bdevs);
+
+	if (raid_bdev->state != RAID_BDEV_STATE_ONLINE || raid_bdev->destroy_started ||
+	    raid_bdev->destruct_called) {
+		SPDK_ERRLOG("Raid bdev %s is not online\n", raid_bdev->bdev.name);
+		return -EINVAL;
+	}
+
+	if (raid_bdev->module->submit_rebuild_request == NULL) {
+		SPDK_ERRLOG("Raid level %s doesn't support rebuild\n",
+			    raid_bdev_level_to_str(raid_bdev->level));
+		return -ENOTSUP;
+	}
+
+	if (raid_bdev->rebuild != NULL) {
+		SPDK_ERRLOG("Rebuild of raid bdev %s is already running\n", raid_bdev->bdev.name);
+		return -EBUSY;
+	}
+
+	if (raid_bdev->base_bdev_info[slot].desc != NULL) {
+		SPDK_ERRLOG("Base bdev slot %u of raid bdev %s is not empty\n", slot,
+			    raid_bdev->bdev.name);
+		return -EEXIST;
+	}
+
+	if (bdev->blocklen != raid_bdev->bdev.blocklen) {
+		SPDK_ERRLOG("Blocklen of bdev %s doesn't match raid bdev %s\n", bdev->name,
+			    raid_bdev->bdev.name);
+		return -EINVAL;
+	}
+
+	if (bdev->blockcnt < raid_bdev->min_base_bdev_blockcnt) {
+		SPDK_ERRLOG("Bdev %s is smaller than the base bdevs of raid bdev %s\n", bdev->name,
+			    raid_bdev->bdev.name);
+		return -EINVAL;
+	}
+
+	buf_align = spdk_bdev_get_buf_align(bdev);
+	RAID_FOR_EACH_BASE_BDEV(raid_bdev, base_info) {
+		if (base_info->bdev != NULL) {
+			buf_align = spdk_max(buf_align, spdk_bdev_get_buf_align(base_info->bdev));
+		}
+	}
+
+	rebuild = raid_bdev_rebuild_alloc(raid_bdev, slot, buf_align, rebuild_mbytes_per_sec);
+	if (rebuild == NULL) {
+		SPDK_ERRLOG("Unable to allocate raid bdev rebuild\n");
+		return -ENOMEM;
+	}
+
+	raid_bdev->rebuild = rebuild;
+	base_info = &raid_bdev->base_bdev_info[slot];
+	base_info->remove_scheduled = false;
+
+	rc = raid_bdev_alloc_base_bdev_resource(raid_bdev, bdev, slot);
+	if (rc != 0) {
+		SPDK_ERRLOG("Failed to allocate resource for bdev '%s'\n", bdev->name);
+		raid_bdev->rebuild = NULL;
+		raid_bdev_rebuild_free(rebuild);
+		return rc;
+	}
+
+	rebuild->ch = spdk_get_io_channel(raid_bdev);
+	if (rebuild->ch == NULL) {
+		SPDK_ERRLOG("Unable to get io channel for raid bdev %s\n", raid_bdev->bdev.name);
+		raid_bdev->rebuild = NULL;
+		raid_bdev_free_base_bdev_resource(raid_bdev, base_info);
+		raid_bdev_rebuild_free(rebuild);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < RAID_BDEV_REBUILD_MAX_REQUESTS; i++) {
+		rebuild->requests[i].raid_ch = spdk_io_channel_get_ctx(rebuild->ch);
+	}
+
+	if (rebuild->mbytes_per_sec != 0) {
+		rebuild->qos_poller = SPDK_POLLER_REGISTER(raid_bdev_rebuild_qos_poll, rebuild,
+				      RAID_BDEV_REBUILD_QOS_TIMESLICE_US);
+	}
+
+	SPDK_NOTICELOG("rebuilding base bdev %s of raid bdev %s\n", bdev->name,
+		       raid_bdev->bdev.name);
+
+	raid_bdev_rebuild_update_channels(rebuild);
+
+	return 0;
+}
+
+/*
+ * brief:
+ * raid_bdev_add_replacement_base_bdev adds a bdev in place of a missing base
+ * bdev of a degraded raid bdev and rebuilds its data online.
+ * params:
+ * raid_bdev - pointer to raid bdev
+ * base_bdev_name - name of the replacement base bdev
+ * rebuild_mbytes_per_sec - bandwidth limit of the rebuild, 0 for no limit
+ * returns:
+ * 0 - success, the rebuild is started
+ * non zero - failure
+ */
+int
+raid_bdev_add_replacement_base_bdev(struct raid_bdev *raid_bdev, const char *base_bdev_name,
+				    uint64_t rebuild_mbytes_per_sec)
+{
+	struct raid_bdev_config *raid_cfg = raid_bdev->config;
+	struct raid_bdev_config *tmp;
+	struct spdk_bdev *bdev;
+	uint8_t slot, i;
+	char *name;
+	int rc;
+
+	bdev = spdk_bdev_get_by_name(base_bdev_name);
+	if (bdev == NULL) {
+		SPDK_ERRLOG("Bdev %s doesn't exist\n", base_bdev_name);
+		return -ENODEV;
+	}
+
+	TAILQ_FOREACH(tmp, &g_raid_config.raid_bdev_config_head, link) {
+		for (i = 0; i < tmp->num_base_bdevs; i++) {
+			if (tmp->base_bdev[i].name != NULL &&
+			    !strcmp(tmp->base_bdev[i].name, base_bdev_name)) {
+				SPDK_ERRLOG("Bdev %s is already a base bdev of raid bdev %s\n",
+					    base_bdev_name, tmp->name);
+				return -EEXIST;
+			}
+		}
+	}
+
+	for (slot = 0; slot < raid_bdev->num_base_bdevs; slot++) {
+		if (raid_bdev->base_bdev_info[slot].desc == NULL) {
+			break;
+		}
+	}
+	if (slot == raid_bdev->num_base_bdevs) {
+		SPDK_ERRLOG("Raid bdev %s has no missing base bdev\n", raid_bdev->bdev.name);
+		return -EINVAL;
+	}
+
+	name = strdup(base_bdev_name);
+	if (name == NULL) {
+		return -ENOMEM;
+	}
+
+	rc = raid_bdev_start_rebuild(raid_bdev, bdev, slot, rebuild_mbytes_per_sec);
+	if (rc != 0) {
+		free(name);
+		return rc;
+	}
+
+	/* The replacement takes over the slot in the configuration */
+	assert(raid_cfg != NULL);
+	free(raid_cfg->base_bdev[slot].name);
+	raid_cfg->base_bdev[slot].name = name;
+
+	return 0;
+}
+
+/*
+ * brief:
+ * raid_bdev_add_base_device function is the actual function which either adds
+ * the nvme base device to existing raid bdev or create a new raid bdev. It also claims
+ * the base device and keep the open descriptor.
+ * params:
+ * raid_cfg - pointer to raid bdev config
+ * bdev - pointer to base bdev
+ * base_bdev_slot - position to add base bdev
+ * returns:
+ * 0 - success
+ * non zero - failure
+ */
+static int
+raid_bdev_add_base_device(struct raid_bdev_config *raid_cfg, struct spdk_bdev *bdev,
+			  uint8_t base_bdev_slot)
+{
+	struct raid_bdev	*raid_bdev;
+	int			rc;
+
+	raid_bdev = raid_cfg->raid_bdev;
+	if (!raid_bdev) {
+		SPDK_ERRLOG("Raid bdev '%s' is not created yet\n", raid_cfg->name);
+		return -ENODEV;
+	}
+
+	if (raid_bdev->state == RAID_BDEV_STATE_ONLINE) {
+		/* A base bdev of a degraded raid bdev has come back, resync it */
+		return raid_bdev_start_rebuild(raid_bdev, bdev, base_bdev_slot, 0);
 	}
 
 	rc = raid_bdev_alloc_base_bdev_resource(raid_bdev, bdev, base_bdev_slot);
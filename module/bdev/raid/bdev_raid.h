@@ -39,7 +39,9 @@
 enum raid_level {
 	INVALID_RAID_LEVEL	= -1,
 	RAID0			= 0,
+	RAID1			= 1,
 	RAID5			= 5,
+	RAID10			= 10,
 };
 
 /*
@@ -106,9 +108,14 @@ struct raid_bdev_io {
 	/* Used for tracking progress on io requests sent to member disks. */
 	uint64_t			base_bdev_io_remaining;
 	uint8_t				base_bdev_io_submitted;
-	uint8_t				base_bdev_io_status;
+	enum spdk_bdev_io_status	base_bdev_io_status;
+
+	/* link in the submitted or rebuild waiting list of the raid bdev io channel */
+	TAILQ_ENTRY(raid_bdev_io)	link;
 };
 
+typedef void (*raid_bdev_destruct_cb)(void *cb_ctx, int rc);
+
 /*
  * raid_bdev is the single entity structure which contains SPDK block device
  * and the information related to any raid bdev either configured or
@@ -165,11 +172,114 @@ struct raid_bdev {
 
 	/* Private data for the raid module */
 	void				*module_private;
+
+	/* Block count of the smallest base bdev, replacement base bdevs can't be smaller */
+	uint64_t			min_base_bdev_blockcnt;
+
+	/* Rebuild of a replacement base bdev, NULL if no rebuild is running */
+	struct raid_bdev_rebuild	*rebuild;
+
+	/* Destruct and deconfigure requests waiting for the rebuild to stop */
+	bool				destruct_pending;
+	bool				deconfigure_pending;
+	raid_bdev_destruct_cb		deconfigure_cb_fn;
+	void				*deconfigure_cb_arg;
 };
 
 #define RAID_FOR_EACH_BASE_BDEV(r, i) \
 	for (i = r->base_bdev_info; i < r->base_bdev_info + r->num_base_bdevs; i++)
 
+/* IO range of a request striped across base bdevs, like in raid0 */
+struct raid_bdev_io_range {
+	uint64_t	strip_size;
+	uint64_t	start_strip_in_disk;
+	uint64_t	end_strip_in_disk;
+	uint64_t	start_offset_in_strip;
+	uint64_t	end_offset_in_strip;
+	uint8_t		start_disk;
+	uint8_t		end_disk;
+	uint8_t		n_disks_involved;
+};
+
+static inline void
+raid_bdev_get_io_range(struct raid_bdev_io_range *io_range,
+		       uint8_t num_base_bdevs, uint64_t strip_size, uint64_t strip_size_shift,
+		       uint64_t offset_blocks, uint64_t num_blocks)
+{
+	uint64_t	start_strip;
+	uint64_t	end_strip;
+
+	io_range->strip_size = strip_size;
+
+	/* The start and end strip index in raid bdev scope */
+	start_strip = offset_blocks >> strip_size_shift;
+	end_strip = (offset_blocks + num_blocks - 1) >> strip_size_shift;
+	io_range->start_strip_in_disk = start_strip / num_base_bdevs;
+	io_range->end_strip_in_disk = end_strip / num_base_bdevs;
+
+	/* The first strip may have unaligned start LBA offset.
+	 * The end strip may have unaligned end LBA offset.
+	 * Strips between them certainly have aligned offset and length to boundaries.
+	 */
+	io_range->start_offset_in_strip = offset_blocks % strip_size;
+	io_range->end_offset_in_strip = (offset_blocks + num_blocks - 1) % strip_size;
+
+	/* The base bdev indexes in which start and end strips are located */
+	io_range->start_disk = start_strip % num_base_bdevs;
+	io_range->end_disk = end_strip % num_base_bdevs;
+
+	/* Calculate how many base_bdevs are involved in io operation.
+	 * Number of base bdevs involved is between 1 and num_base_bdevs.
+	 * It will be 1 if the first strip and last strip are the same one.
+	 */
+	io_range->n_disks_involved = spdk_min((end_strip - start_strip + 1), num_base_bdevs);
+}
+
+static inline void
+raid_bdev_split_io_range(struct raid_bdev_io_range *io_range, uint8_t disk_idx,
+			 uint64_t *_offset_in_disk, uint64_t *_nblocks_in_disk)
+{
+	uint64_t n_strips_in_disk;
+	uint64_t start_offset_in_disk;
+	uint64_t end_offset_in_disk;
+	uint64_t offset_in_disk;
+	uint64_t nblocks_in_disk;
+	uint64_t start_strip_in_disk;
+	uint64_t end_strip_in_disk;
+
+	start_strip_in_disk = io_range->start_strip_in_disk;
+	if (disk_idx < io_range->start_disk) {
+		start_strip_in_disk += 1;
+	}
+
+	end_strip_in_disk = io_range->end_strip_in_disk;
+	if (disk_idx > io_range->end_disk) {
+		end_strip_in_disk -= 1;
+	}
+
+	assert(end_strip_in_disk >= start_strip_in_disk);
+	n_strips_in_disk = end_strip_in_disk - start_strip_in_disk + 1;
+
+	if (disk_idx == io_range->start_disk) {
+		start_offset_in_disk = io_range->start_offset_in_strip;
+	} else {
+		start_offset_in_disk = 0;
+	}
+
+	if (disk_idx == io_range->end_disk) {
+		end_offset_in_disk = io_range->end_offset_in_strip;
+	} else {
+		end_offset_in_disk = io_range->strip_size - 1;
+	}
+
+	offset_in_disk = start_offset_in_disk + start_strip_in_disk * io_range->strip_size;
+	nblocks_in_disk = (n_strips_in_disk - 1) * io_range->strip_size
+			  + end_offset_in_disk - start_offset_in_disk + 1;
+
+	*_offset_in_disk = offset_in_disk;
+	*_nblocks_in_disk = nblocks_in_disk;
+}
+
 /*
  * raid_base_bdev_config is the per base bdev data structure which contains
  * information w.r.t to per base bdev during parsing config
@@ -226,6 +336,85 @@ struct raid_bdev_io_channel {
 
 	/* Number of IO channels */
 	uint8_t			num_channels;
+
+	/* Private raid module IO channel */
+	struct spdk_io_channel	*module_channel;
+
+	/* Raid bdev IOs submitted on this channel and not completed yet */
+	TAILQ_HEAD(, raid_bdev_io) submitted_ios;
+
+	/*
+	 * Set while a base bdev is rebuilt. The data of the base bdev at
+	 * rebuild_idx is valid only below rebuild_offset. The range locked by the
+	 * rebuild is [rebuild_offset, rebuild_lock_end), IOs overlapping it are
+	 * queued on rebuild_waiting_ios. All offsets are in raid bdev blocks.
+	 */
+	bool			rebuild_active;
+	uint8_t			rebuild_idx;
+	uint64_t		rebuild_offset;
+	uint64_t		rebuild_lock_end;
+	TAILQ_HEAD(, raid_bdev_io) rebuild_waiting_ios;
+
+	/* Used to wait for submitted IOs overlapping the newly locked range */
+	struct spdk_poller	*rebuild_lock_poller;
+	struct spdk_io_channel_iter *rebuild_lock_iter;
+};
+
+/*
+ * brief:
+ * raid_bdev_channel_get_base_channel returns the io channel of a base bdev to
+ * be used for an IO to the given range of the raid bdev.
+ * params:
+ * raid_ch - pointer to raid bdev io channel
+ * idx - base bdev index
+ * offset_blocks - offset of the IO range in raid bdev blocks
+ * num_blocks - length of the IO range in raid bdev blocks
+ * returns:
+ * base bdev io channel, NULL if the base bdev is missing or if it is being
+ * rebuilt and its data in the given range is not rebuilt yet
+ */
+static inline struct spdk_io_channel *
+raid_bdev_channel_get_base_channel(struct raid_bdev_io_channel *raid_ch, uint8_t idx,
+				   uint64_t offset_blocks, uint64_t num_blocks)
+{
+	if (raid_ch->rebuild_active && idx == raid_ch->rebuild_idx &&
+	    offset_blocks + num_blocks > raid_ch->rebuild_offset) {
+		return NULL;
+	}
+
+	return raid_ch->base_channel[idx];
+}
+
+/*
+ * raid_bdev_rebuild_request describes a range of the raid bdev to be rebuilt
+ * on the replacement base bdev by the raid module.
+ */
+struct raid_bdev_rebuild_request {
+	/* The raid bdev being rebuilt */
+	struct raid_bdev		*raid_bdev;
+
+	/* Raid bdev io channel of the rebuild thread */
+	struct raid_bdev_io_channel	*raid_ch;
+
+	/* Index of the base bdev being rebuilt */
+	uint8_t				target_idx;
+
+	/* Range to rebuild in raid bdev blocks, aligned to optimal_io_boundary */
+	uint64_t			offset_blocks;
+	uint64_t			num_blocks;
+
+	/* DMA buffer of num_blocks blocks */
+	void				*buf;
+
+	/* Used by the raid module for tracking base bdev IOs and retries */
+	uint64_t			base_bdev_io_remaining;
+	uint8_t				base_bdev_io_submitted;
+	int				base_bdev_io_status;
+	struct spdk_bdev_io_wait_entry	waitq_entry;
+
+	/* Used by the rebuild engine */
+	struct raid_bdev_rebuild	*rebuild;
+	TAILQ_ENTRY(raid_bdev_rebuild_request) link;
 };
 
 /* TAIL heads for various raid bdev lists */
@@ -240,12 +429,13 @@ extern struct raid_all_tailq		g_raid_bdev_list;
 extern struct raid_offline_tailq	g_raid_bdev_offline_list;
 extern struct raid_config		g_raid_config;
 
-typedef void (*raid_bdev_destruct_cb)(void *cb_ctx, int rc);
-
 int raid_bdev_create(struct raid_bdev_config *raid_cfg);
 int raid_bdev_add_base_devices(struct raid_bdev_config *raid_cfg);
 void raid_bdev_remove_base_devices(struct raid_bdev_config *raid_cfg,
 				   raid_bdev_destruct_cb cb_fn, void *cb_ctx);
+int raid_bdev_add_replacement_base_bdev(struct raid_bdev *raid_bdev, const char *base_bdev_name,
+					uint64_t rebuild_mbytes_per_sec);
+void raid_bdev_write_info_json(struct raid_bdev *raid_bdev, struct spdk_json_write_ctx *w);
 int raid_bdev_config_add(const char *raid_name, uint32_t strip_size, uint8_t num_base_bdevs,
 			 enum raid_level level, struct raid_bdev_config **_raid_cfg);
 int raid_bdev_config_add_base_bdev(struct raid_bdev_config *raid_cfg,
@@ -267,7 +457,7 @@ struct raid_bdev_module {
 
 	/*
 	 * Maximum number of base bdevs that can be removed without failing
-	 * the array.
+	 * the array. The array always fails when all base bdevs are removed.
 	 */
 	uint8_t base_bdevs_max_degraded;
 
@@ -292,6 +482,23 @@ struct raid_bdev_module {
 	/* Handler for requests without payload (flush, unmap). Optional. */
 	void (*submit_null_payload_request)(struct raid_bdev_io *raid_io);
 
+	/*
+	 * Called when creating a raid bdev io channel to get the raid module's
+	 * private io channel. The returned channel is put when the raid bdev io
+	 * channel is destroyed. Optional.
+	 */
+	struct spdk_io_channel *(*get_io_channel)(struct raid_bdev *raid_bdev);
+
+	/*
+	 * Handler for rebuild requests. It should read the data needed to
+	 * reconstruct the given range of the base bdev being rebuilt from the
+	 * other base bdevs and write it to the rebuilt base bdev. Completion is
+	 * signalled with raid_bdev_rebuild_request_complete(). Non-zero return
+	 * value fails the rebuild. Optional, raid bdevs of modules without it
+	 * can't be rebuilt.
+	 */
+	int (*submit_rebuild_request)(struct raid_bdev_rebuild_request *rebuild_req);
+
 	TAILQ_ENTRY(raid_bdev_module) link;
 };
 
@@ -315,5 +522,7 @@ raid_bdev_queue_io_wait(struct raid_bdev_io *raid_io, struct spdk_bdev *bdev,
 			struct spdk_io_channel *ch, spdk_bdev_io_wait_cb cb_fn);
 void
 raid_bdev_io_complete(struct raid_bdev_io *raid_io, enum spdk_bdev_io_status status);
+void
+raid_bdev_rebuild_request_complete(struct raid_bdev_rebuild_request *rebuild_req, int status);
 
 #endif /* SPDK_BDEV_RAID_INTERNAL_H */
@@ -72,16 +72,36 @@ static const struct spdk_json_object_decoder rpc_bdev_raid_get_bdevs_decoders[]
 	{"category", offsetof(struct rpc_bdev_raid_get_bdevs, category), spdk_json_decode_string},
 };
 
+/*
+ * brief:
+ * rpc_bdev_raid_write_raid_bdev writes the name and the state of a raid bdev
+ * as an object of the bdev_raid_get_bdevs RPC result.
+ * params:
+ * w - pointer to json context
+ * raid_bdev - pointer to raid bdev
+ * returns:
+ * none
+ */
+static void
+rpc_bdev_raid_write_raid_bdev(struct spdk_json_write_ctx *w, struct raid_bdev *raid_bdev)
+{
+	spdk_json_write_object_begin(w);
+	spdk_json_write_named_string(w, "name", raid_bdev->bdev.name);
+	raid_bdev_write_info_json(raid_bdev, w);
+	spdk_json_write_object_end(w);
+}
+
 /*
  * brief:
  * rpc_bdev_raid_get_bdevs function is the RPC for rpc_bdev_raid_get_bdevs. This is used to list
- * all the raid bdev names based on the input category requested. Category should be
+ * all the raid bdevs based on the input category requested. Category should be
  * one of "all", "online", "configuring" or "offline". "all" means all the raids
  * whether they are online or configuring or offline. "online" is the raid bdev which
  * is registered with bdev layer. "configuring" is the raid bdev which does not have
  * full configuration discovered yet. "offline" is the raid bdev which is not
  * registered with bdev as of now and it has encountered any error or user has
- * requested to offline the raid.
+ * requested to offline the raid. Each raid bdev is reported with its state,
+ * base bdevs and the progress of the running rebuild, if any.
  * params:
  * request - pointer to json rpc request
  * params - pointer to request parameters
@@ -118,19 +138,19 @@ rpc_bdev_raid_get_bdevs(struct spdk_jsonrpc_request *request,
 	/* Get raid bdev list based on the category requested */
 	if (strcmp(req.category, "all") == 0) {
 		TAILQ_FOREACH(raid_bdev, &g_raid_bdev_list, global_link) {
-			spdk_json_write_string(w, raid_bdev->bdev.name);
+			rpc_bdev_raid_write_raid_bdev(w, raid_bdev);
 		}
 	} else if (strcmp(req.category, "online") == 0) {
 		TAILQ_FOREACH(raid_bdev, &g_raid_bdev_configured_list, state_link) {
-			spdk_json_write_string(w, raid_bdev->bdev.name);
+			rpc_bdev_raid_write_raid_bdev(w, raid_bdev);
 		}
 	} else if (strcmp(req.category, "configuring") == 0) {
 		TAILQ_FOREACH(raid_bdev, &g_raid_bdev_configuring_list, state_link) {
-			spdk_json_write_string(w, raid_bdev->bdev.name);
+			rpc_bdev_raid_write_raid_bdev(w, raid_bdev);
 		}
 	} else {
 		TAILQ_FOREACH(raid_bdev, &g_raid_bdev_offline_list, state_link) {
-			spdk_json_write_string(w, raid_bdev->bdev.name);
+			rpc_bdev_raid_write_raid_bdev(w, raid_bdev);
 		}
 	}
 	spdk_json_write_array_end(w);
@@ -450,3 +470,101 @@ cleanup:
 }
 SPDK_RPC_REGISTER("bdev_raid_delete", rpc_bdev_raid_delete, SPDK_RPC_RUNTIME)
 SPDK_RPC_REGISTER_ALIAS_DEPRECATED(bdev_raid_delete, destroy_raid_bdev)
+
+/*
+ * Input structure for RPC bdev_raid_add_base_bdev
+ */
+struct rpc_bdev_raid_add_base_bdev {
+	/* raid bdev name */
+	char *name;
+
+	/* name of the replacement base bdev */
+	char *base_bdev;
+
+	/* bandwidth limit of the rebuild in MiB/s, 0 means no limit */
+	uint64_t rebuild_mbytes_per_sec;
+};
+
+/*
+ * brief:
+ * free_rpc_bdev_raid_add_base_bdev function is used to free RPC bdev_raid_add_base_bdev
+ * related parameters
+ * params:
+ * req - pointer to RPC request
+ * returns:
+ * none
+ */
+static void
+free_rpc_bdev_raid_add_base_bdev(struct rpc_bdev_raid_add_base_bdev *req)
+{
+	free(req->name);
+	free(req->base_bdev);
+}
+
+/*
+ * Decoder object for RPC bdev_raid_add_base_bdev
+ */
+static const struct spdk_json_object_decoder rpc_bdev_raid_add_base_bdev_decoders[] = {
+	{"name", offsetof(struct rpc_bdev_raid_add_base_bdev, name), spdk_json_decode_string},
+	{"base_bdev", offsetof(struct rpc_bdev_raid_add_base_bdev, base_bdev), spdk_json_decode_string},
+	{
+		"rebuild_mbytes_per_sec", offsetof(struct rpc_bdev_raid_add_base_bdev, rebuild_mbytes_per_sec),
+		spdk_json_decode_uint64, true
+	},
+};
+
+/*
+ * brief:
+ * rpc_bdev_raid_add_base_bdev function is the RPC for adding a replacement base
+ * bdev to a degraded raid bdev. The base bdev takes the slot of a missing base
+ * bdev and its data is rebuilt in the background while the raid bdev keeps
+ * serving IO. The progress of the rebuild is reported by bdev_raid_get_bdevs.
+ * params:
+ * request - pointer to json rpc request
+ * params - pointer to request parameters
+ * returns:
+ * none
+ */
+static void
+rpc_bdev_raid_add_base_bdev(struct spdk_jsonrpc_request *request,
+			    const struct spdk_json_val *params)
+{
+	struct rpc_bdev_raid_add_base_bdev req = {};
+	struct raid_bdev_config *raid_cfg;
+	struct spdk_json_write_ctx *w;
+	int rc;
+
+	if (spdk_json_decode_object(params, rpc_bdev_raid_add_base_bdev_decoders,
+				    SPDK_COUNTOF(rpc_bdev_raid_add_base_bdev_decoders),
+				    &req)) {
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INTERNAL_ERROR,
+						 "spdk_json_decode_object failed");
+		goto cleanup;
+	}
+
+	raid_cfg = raid_bdev_config_find_by_name(req.name);
+	if (raid_cfg == NULL || raid_cfg->raid_bdev == NULL) {
+		spdk_jsonrpc_send_error_response_fmt(request, -ENODEV,
+						     "raid bdev %s is not found",
+						     req.name);
+		goto cleanup;
+	}
+
+	rc = raid_bdev_add_replacement_base_bdev(raid_cfg->raid_bdev, req.base_bdev,
+			req.rebuild_mbytes_per_sec);
+	if (rc != 0) {
+		spdk_jsonrpc_send_error_response_fmt(request, rc,
+						     "Failed to add base bdev %s to raid bdev %s: %s",
+						     req.base_bdev, req.name,
+						     spdk_strerror(-rc));
+		goto cleanup;
+	}
+
+	w = spdk_jsonrpc_begin_result(request);
+	spdk_json_write_bool(w, true);
+	spdk_jsonrpc_end_result(request, w);
+
+cleanup:
+	free_rpc_bdev_raid_add_base_bdev(&req);
+}
+SPDK_RPC_REGISTER("bdev_raid_add_base_bdev", rpc_bdev_raid_add_base_bdev, SPDK_RPC_RUNTIME)
@@ -0,0 +1,700 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "bdev_raid.h"
+
+#include "spdk/env.h"
+#include "spdk/likely.h"
+#include "spdk/thread.h"
+#include "spdk/string.h"
+#include "spdk/util.h"
+
+#include "spdk_internal/log.h"
+
+/*
+ * RAID1 mirrors the data on all base bdevs. RAID10 stripes the data across
+ * groups of mirrored base bdevs: consecutive base bdevs form a mirror group
+ * and the strips are distributed across the groups like in raid0. RAID1 is
+ * handled as RAID10 with a single mirror group.
+ */
+struct raid1_info {
+	/* The parent raid bdev */
+	struct raid_bdev *raid_bdev;
+
+	/* Number of base bdevs in a mirror group */
+	uint8_t num_mirrors;
+
+	/* Number of mirror groups */
+	uint8_t num_groups;
+};
+
+/* Context of a single base bdev IO, passed as its completion callback argument */
+struct raid1_base_io {
+	struct raid_bdev_io		*raid_io;
+
+	/* Base bdev slot the IO was submitted to */
+	uint8_t				idx;
+
+	STAILQ_ENTRY(raid1_base_io)	link;
+};
+
+struct raid1_slot {
+	/* Number of outstanding base bdev IOs on this channel */
+	uint64_t		outstanding;
+
+	/*
+	 * Base bdev the counter belongs to. When the slot gets a replacement base
+	 * bdev, the counter starts over and IOs of the previous one aren't counted.
+	 */
+	struct spdk_bdev	*bdev;
+};
+
+struct raid1_io_channel {
+	struct raid1_info *r1info;
+
+	/* Used to spread reads among mirrors with equal queue depth */
+	uint32_t next_read;
+
+	/* Base IO contexts, allocated on demand and reused */
+	STAILQ_HEAD(, raid1_base_io) free_base_ios;
+
+	/* Per base bdev slot */
+	struct raid1_slot slots[0];
+};
+
+static inline struct raid1_io_channel *
+raid1_get_io_channel_ctx(struct raid_bdev_io *raid_io)
+{
+	return spdk_io_channel_get_ctx(raid_io->raid_ch->module_channel);
+}
+
+/*
+ * brief:
+ * raid1_slot_get returns the channel's counters of a base bdev slot. The
+ * counter is reset if the slot got a new base bdev since it was last used.
+ * params:
+ * r1ch - pointer to raid1 io channel
+ * idx - base bdev index
+ * returns:
+ * pointer to the slot
+ */
+static inline struct raid1_slot *
+raid1_slot_get(struct raid1_io_channel *r1ch, uint8_t idx)
+{
+	struct raid1_slot *slot = &r1ch->slots[idx];
+	struct spdk_bdev *bdev = r1ch->r1info->raid_bdev->base_bdev_info[idx].bdev;
+
+	if (spdk_unlikely(slot->bdev != bdev)) {
+		slot->bdev = bdev;
+		slot->outstanding = 0;
+	}
+
+	return slot;
+}
+
+/*
+ * brief:
+ * raid1_map_io maps the raid bdev offset to the first base bdev of the mirror
+ * group holding it and the offset on the base bdevs of this group.
+ * params:
+ * raid_bdev - pointer to raid bdev
+ * offset_blocks - offset on the raid bdev
+ * _first_idx - index of the first base bdev of the mirror group
+ * _pd_lba - offset on the base bdevs
+ * returns:
+ * none
+ */
+static void
+raid1_map_io(struct raid_bdev *raid_bdev, uint64_t offset_blocks,
+	     uint8_t *_first_idx, uint64_t *_pd_lba)
+{
+	struct raid1_info *r1info = raid_bdev->module_private;
+	uint64_t strip = offset_blocks >> raid_bdev->strip_size_shift;
+	uint64_t pd_strip = strip / r1info->num_groups;
+	uint8_t group = strip % r1info->num_groups;
+
+	*_first_idx = group * r1info->num_mirrors;
+	*_pd_lba = (pd_strip << raid_bdev->strip_size_shift) +
+		   (offset_blocks & (raid_bdev->strip_size - 1));
+}
+
+static void
+raid1_base_io_complete(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct raid1_base_io *base_io = cb_arg;
+	struct raid_bdev_io *raid_io = base_io->raid_io;
+	struct raid1_io_channel *r1ch = raid1_get_io_channel_ctx(raid_io);
+	struct raid1_slot *slot = &r1ch->slots[base_io->idx];
+
+	/* IOs of a base bdev which was replaced in the meantime aren't counted anymore */
+	if (slot->bdev == bdev_io->bdev) {
+		assert(slot->outstanding > 0);
+		slot->outstanding--;
+	}
+
+	STAILQ_INSERT_HEAD(&r1ch->free_base_ios, base_io, link);
+	spdk_bdev_free_io(bdev_io);
+
+	raid_bdev_io_complete_part(raid_io, 1, success ?
+				   SPDK_BDEV_IO_STATUS_SUCCESS :
+				   SPDK_BDEV_IO_STATUS_FAILED);
+}
+
+/*
+ * brief:
+ * raid1_submit_base_io submits the part of the raid_io to a single base bdev
+ * and accounts it as outstanding on the channel.
+ * params:
+ * raid_io - pointer to raid_bdev_io
+ * idx - base bdev index
+ * offset_blocks - offset on the base bdev
+ * num_blocks - number of blocks
+ * returns:
+ * 0 on success, negative errno of the bdev submit function otherwise
+ */
+static int
+raid1_submit_base_io(struct raid_bdev_io *raid_io, uint8_t idx,
+		     uint64_t offset_blocks, uint64_t num_blocks)
+{
+	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(raid_io);
+	struct raid_base_bdev_info *base_info = &raid_io->raid_bdev->base_bdev_info[idx];
+	struct spdk_io_channel *base_ch = raid_io->raid_ch->base_channel[idx];
+	struct raid1_io_channel *r1ch = raid1_get_io_channel_ctx(raid_io);
+	struct raid1_base_io *base_io;
+	int ret;
+
+	base_io = STAILQ_FIRST(&r1ch->free_base_ios);
+	if (base_io != NULL) {
+		STAILQ_REMOVE_HEAD(&r1ch->free_base_ios, link);
+	} else {
+		base_io = calloc(1, sizeof(*base_io));
+		if (base_io == NULL) {
+			return -ENOMEM;
+		}
+	}
+	base_io->raid_io = raid_io;
+	base_io->idx = idx;
+
+	switch (bdev_io->type) {
+	case SPDK_BDEV_IO_TYPE_READ:
+		ret = spdk_bdev_readv_blocks(base_info->desc, base_ch,
+					     bdev_io->u.bdev.iovs, bdev_io->u.bdev.iovcnt,
+					     offset_blocks, num_blocks,
+					     raid1_base_io_complete, base_io);
+		break;
+
+	case SPDK_BDEV_IO_TYPE_WRITE:
+		ret = spdk_bdev_writev_blocks(base_info->desc, base_ch,
+					      bdev_io->u.bdev.iovs, bdev_io->u.bdev.iovcnt,
+					      offset_blocks, num_blocks,
+					      raid1_base_io_complete, base_io);
+		break;
+
+	case SPDK_BDEV_IO_TYPE_UNMAP:
+		ret = spdk_bdev_unmap_blocks(base_info->desc, base_ch,
+					     offset_blocks, num_blocks,
+					     raid1_base_io_complete, base_io);
+		break;
+
+	case SPDK_BDEV_IO_TYPE_FLUSH:
+		ret = spdk_bdev_flush_blocks(base_info->desc, base_ch,
+					     offset_blocks, num_blocks,
+					     raid1_base_io_complete, base_io);
+		break;
+
+	default:
+		SPDK_ERRLOG("Recvd not supported io type %u\n", bdev_io->type);
+		assert(false);
+		ret = -EINVAL;
+	}
+
+	if (ret == 0) {
+		raid1_slot_get(r1ch, idx)->outstanding++;
+	} else {
+		STAILQ_INSERT_HEAD(&r1ch->free_base_ios, base_io, link);
+	}
+
+	return ret;
+}
+
+/*
+ * brief:
+ * raid1_select_read_mirror selects the mirror with the least outstanding IOs
+ * on this channel. Mirrors with the same number of outstanding IOs are
+ * selected in turns. A mirror being rebuilt is used only if the range is
+ * already rebuilt.
+ * params:
+ * raid_io - pointer to raid_bdev_io
+ * first_idx - index of the first base bdev of the mirror group
+ * returns:
+ * index of the selected base bdev, UINT8_MAX if all mirrors are missing
+ */
+static uint8_t
+raid1_select_read_mirror(struct raid_bdev_io *raid_io, uint8_t first_idx)
+{
+	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(raid_io);
+	struct raid1_info *r1info = raid_io->raid_bdev->module_private;
+	struct raid1_io_channel *r1ch = raid1_get_io_channel_ctx(raid_io);
+	uint64_t min_outstanding = UINT64_MAX;
+	uint8_t selected = UINT8_MAX;
+	uint8_t start = r1ch->next_read++ % r1info->num_mirrors;
+	struct raid1_slot *slot;
+	uint8_t i, idx;
+
+	for (i = 0; i < r1info->num_mirrors; i++) {
+		idx = first_idx + (start + i) % r1info->num_mirrors;
+
+		if (raid_bdev_channel_get_base_channel(raid_io->raid_ch, idx,
+						       bdev_io->u.bdev.offset_blocks,
+						       bdev_io->u.bdev.num_blocks) == NULL) {
+			continue;
+		}
+
+		slot = raid1_slot_get(r1ch, idx);
+		if (slot->outstanding < min_outstanding) {
+			min_outstanding = slot->outstanding;
+			selected = idx;
+		}
+	}
+
+	return selected;
+}
+
+static void
+raid1_submit_rw_request(struct raid_bdev_io *raid_io);
+
+static void
+_raid1_submit_rw_request(void *_raid_io)
+{
+	struct raid_bdev_io *raid_io = _raid_io;
+
+	raid1_submit_rw_request(raid_io);
+}
+
+/*
+ * brief:
+ * raid1_submit_rw_request function is used to submit I/O to the mirrors.
+ * Reads are submitted to the mirror with the shortest queue, writes are
+ * submitted to all mirrors which are present.
+ * params:
+ * raid_io
+ * returns:
+ * none
+ */
+static void
+raid1_submit_rw_request(struct raid_bdev_io *raid_io)
+{
+	struct spdk_bdev_io		*bdev_io = spdk_bdev_io_from_ctx(raid_io);
+	struct raid_bdev		*raid_bdev = raid_io->raid_bdev;
+	struct raid1_info		*r1info = raid_bdev->module_private;
+	struct raid_bdev_io_channel	*raid_ch = raid_io->raid_ch;
+	uint64_t			pd_lba;
+	uint8_t				first_idx;
+	uint8_t				idx;
+	int				ret;
+
+	raid1_map_io(raid_bdev, bdev_io->u.bdev.offset_blocks, &first_idx, &pd_lba);
+
+	if (bdev_io->type == SPDK_BDEV_IO_TYPE_READ) {
+		idx = raid1_select_read_mirror(raid_io, first_idx);
+		if (idx == UINT8_MAX) {
+			SPDK_ERRLOG("No mirror available for read\n");
+			raid_bdev_io_complete(raid_io, SPDK_BDEV_IO_STATUS_FAILED);
+			return;
+		}
+
+		raid_io->base_bdev_io_remaining = 1;
+
+		ret = raid1_submit_base_io(raid_io, idx, pd_lba, bdev_io->u.bdev.num_blocks);
+		if (ret == -ENOMEM) {
+			raid_bdev_queue_io_wait(raid_io, raid_bdev->base_bdev_info[idx].bdev,
+						raid_ch->base_channel[idx], _raid1_submit_rw_request);
+		} else if (ret != 0) {
+			SPDK_ERRLOG("bdev io submit error not due to ENOMEM, it should not happen\n");
+			assert(false);
+			raid_bdev_io_complete(raid_io, SPDK_BDEV_IO_STATUS_FAILED);
+		}
+		return;
+	}
+
+	if (raid_io->base_bdev_io_remaining == 0) {
+		raid_io->base_bdev_io_remaining = r1info->num_mirrors;
+	}
+
+	while (raid_io->base_bdev_io_submitted < r1info->num_mirrors) {
+		idx = first_idx + raid_io->base_bdev_io_submitted;
+
+		if (raid_bdev_channel_get_base_channel(raid_ch, idx, bdev_io->u.bdev.offset_blocks,
+						       bdev_io->u.bdev.num_blocks) == NULL) {
+			/* Missing mirror of a degraded raid bdev or not rebuilt yet */
+			raid_io->base_bdev_io_submitted++;
+			if (raid_bdev_io_complete_part(raid_io, 1, SPDK_BDEV_IO_STATUS_SUCCESS)) {
+				return;
+			}
+			continue;
+		}
+
+		ret = raid1_submit_base_io(raid_io, idx, pd_lba, bdev_io->u.bdev.num_blocks);
+		if (ret == 0) {
+			raid_io->base_bdev_io_submitted++;
+		} else if (ret == -ENOMEM) {
+			raid_bdev_queue_io_wait(raid_io, raid_bdev->base_bdev_info[idx].bdev,
+						raid_ch->base_channel[idx], _raid1_submit_rw_request);
+			return;
+		} else {
+			SPDK_ERRLOG("bdev io submit error not due to ENOMEM, it should not happen\n");
+			assert(false);
+			raid_bdev_io_complete(raid_io, SPDK_BDEV_IO_STATUS_FAILED);
+			return;
+		}
+	}
+}
+
+static void
+raid1_submit_null_payload_request(struct raid_bdev_io *raid_io);
+
+static void
+_raid1_submit_null_payload_request(void *_raid_io)
+{
+	struct raid_bdev_io *raid_io = _raid_io;
+
+	raid1_submit_null_payload_request(raid_io);
+}
+
+/*
+ * brief:
+ * raid1_submit_null_payload_request function submits io requests with range
+ * but without payload, like FLUSH and UNMAP, to all mirrors of the involved
+ * mirror groups.
+ * params:
+ * raid_io - pointer to raid_bdev_io
+ * returns:
+ * none
+ */
+static void
+raid1_submit_null_payload_request(struct raid_bdev_io *raid_io)
+{
+	struct spdk_bdev_io		*bdev_io = spdk_bdev_io_from_ctx(raid_io);
+	struct raid_bdev		*raid_bdev = raid_io->raid_bdev;
+	struct raid1_info		*r1info = raid_bdev->module_private;
+	struct raid_bdev_io_channel	*raid_ch = raid_io->raid_ch;
+	struct raid_bdev_io_range	io_range;
+	uint8_t				num_base_ios;
+	int				ret;
+
+	raid_bdev_get_io_range(&io_range, r1info->num_groups,
+			       raid_bdev->strip_size, raid_bdev->strip_size_shift,
+			       bdev_io->u.bdev.offset_blocks, bdev_io->u.bdev.num_blocks);
+
+	num_base_ios = io_range.n_disks_involved * r1info->num_mirrors;
+
+	if (raid_io->base_bdev_io_remaining == 0) {
+		raid_io->base_bdev_io_remaining = num_base_ios;
+	}
+
+	while (raid_io->base_bdev_io_submitted < num_base_ios) {
+		uint8_t group;
+		uint8_t idx;
+		uint64_t offset_in_disk;
+		uint64_t nblocks_in_disk;
+
+		group = (io_range.start_disk + raid_io->base_bdev_io_submitted / r1info->num_mirrors) %
+			r1info->num_groups;
+		idx = group * r1info->num_mirrors + raid_io->base_bdev_io_submitted % r1info->num_mirrors;
+
+		if (raid_bdev_channel_get_base_channel(raid_ch, idx, bdev_io->u.bdev.offset_blocks,
+						       bdev_io->u.bdev.num_blocks) == NULL) {
+			raid_io->base_bdev_io_submitted++;
+			if (raid_bdev_io_complete_part(raid_io, 1, SPDK_BDEV_IO_STATUS_SUCCESS)) {
+				return;
+			}
+			continue;
+		}
+
+		raid_bdev_split_io_range(&io_range, group, &offset_in_disk, &nblocks_in_disk);
+
+		ret = raid1_submit_base_io(raid_io, idx, offset_in_disk, nblocks_in_disk);
+		if (ret == 0) {
+			raid_io->base_bdev_io_submitted++;
+		} else if (ret == -ENOMEM) {
+			raid_bdev_queue_io_wait(raid_io, raid_bdev->base_bdev_info[idx].bdev,
+						raid_ch->base_channel[idx], _raid1_submit_null_payload_request);
+			return;
+		} else {
+			SPDK_ERRLOG("bdev io submit error not due to ENOMEM, it should not happen\n");
+			assert(false);
+			raid_bdev_io_complete(raid_io, SPDK_BDEV_IO_STATUS_FAILED);
+			return;
+		}
+	}
+}
+
+static int raid1_submit_rebuild_request(struct raid_bdev_rebuild_request *rebuild_req);
+
+static void
+_raid1_submit_rebuild_request(void *_rebuild_req)
+{
+	struct raid_bdev_rebuild_request *rebuild_req = _rebuild_req;
+	int ret;
+
+	ret = raid1_submit_rebuild_request(rebuild_req);
+	if (ret != 0) {
+		raid_bdev_rebuild_request_complete(rebuild_req, ret);
+	}
+}
+
+static void
+raid1_rebuild_base_io_complete(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct raid_bdev_rebuild_request *rebuild_req = cb_arg;
+
+	spdk_bdev_free_io(bdev_io);
+
+	if (!success) {
+		raid_bdev_rebuild_request_complete(rebuild_req, -EIO);
+		return;
+	}
+
+	/* The read from the source mirror is done, write the data to the rebuilt one */
+	rebuild_req->base_bdev_io_submitted++;
+	if (rebuild_req->base_bdev_io_submitted == 2) {
+		raid_bdev_rebuild_request_complete(rebuild_req, 0);
+		return;
+	}
+
+	_raid1_submit_rebuild_request(rebuild_req);
+}
+
+/*
+ * brief:
+ * raid1_submit_rebuild_request copies a range from an in-sync mirror to the
+ * rebuilt base bdev. The rebuild request covers whole rows of strips, so the
+ * range of the rebuilt mirror group is contiguous on its base bdevs.
+ * base_bdev_io_submitted tracks the stage of the request: 0 - read from the
+ * source mirror, 1 - write to the rebuilt base bdev.
+ * params:
+ * rebuild_req - pointer to the rebuild request
+ * returns:
+ * 0 on success, negative errno otherwise
+ */
+static int
+raid1_submit_rebuild_request(struct raid_bdev_rebuild_request *rebuild_req)
+{
+	struct raid_bdev		*raid_bdev = rebuild_req->raid_bdev;
+	struct raid1_info		*r1info = raid_bdev->module_private;
+	struct raid_bdev_io_channel	*raid_ch = rebuild_req->raid_ch;
+	uint8_t				first_idx = rebuild_req->target_idx -
+					    rebuild_req->target_idx % r1info->num_mirrors;
+	uint64_t			pd_lba = rebuild_req->offset_blocks / r1info->num_groups;
+	uint64_t			pd_blocks = rebuild_req->num_blocks / r1info->num_groups;
+	struct raid_base_bdev_info	*base_info;
+	uint8_t				idx = rebuild_req->target_idx;
+	uint8_t				i;
+	int				ret;
+
+	if (rebuild_req->base_bdev_io_submitted == 0) {
+		for (i = 0; i < r1info->num_mirrors; i++) {
+			idx = first_idx + i;
+			if (idx != rebuild_req->target_idx && raid_ch->base_channel[idx] != NULL) {
+				break;
+			}
+		}
+		if (i == r1info->num_mirrors) {
+			SPDK_ERRLOG("No mirror available for rebuild\n");
+			return -ENODEV;
+		}
+
+		base_info = &raid_bdev->base_bdev_info[idx];
+		ret = spdk_bdev_read_blocks(base_info->desc, raid_ch->base_channel[idx],
+					    rebuild_req->buf, pd_lba, pd_blocks,
+					    raid1_rebuild_base_io_complete, rebuild_req);
+	} else {
+		base_info = &raid_bdev->base_bdev_info[idx];
+		ret = spdk_bdev_write_blocks(base_info->desc, raid_ch->base_channel[idx],
+					     rebuild_req->buf, pd_lba, pd_blocks,
+					     raid1_rebuild_base_io_complete, rebuild_req);
+	}
+
+	if (ret == -ENOMEM) {
+		rebuild_req->waitq_entry.bdev = base_info->bdev;
+		rebuild_req->waitq_entry.cb_fn = _raid1_submit_rebuild_request;
+		rebuild_req->waitq_entry.cb_arg = rebuild_req;
+		return spdk_bdev_queue_io_wait(base_info->bdev, raid_ch->base_channel[idx],
+					       &rebuild_req->waitq_entry);
+	}
+
+	return ret;
+}
+
+static int
+raid1_ioch_create(void *io_device, void *ctx_buf)
+{
+	struct raid1_io_channel *r1ch = ctx_buf;
+	struct raid1_info *r1info = io_device;
+	uint8_t i;
+
+	r1ch->r1info = r1info;
+	STAILQ_INIT(&r1ch->free_base_ios);
+
+	for (i = 0; i < r1info->raid_bdev->num_base_bdevs; i++) {
+		r1ch->slots[i].bdev = r1info->raid_bdev->base_bdev_info[i].bdev;
+	}
+
+	return 0;
+}
+
+static void
+raid1_ioch_destroy(void *io_device, void *ctx_buf)
+{
+	struct raid1_io_channel *r1ch = ctx_buf;
+	struct raid1_base_io *base_io;
+
+	while ((base_io = STAILQ_FIRST(&r1ch->free_base_ios))) {
+		STAILQ_REMOVE_HEAD(&r1ch->free_base_ios, link);
+		free(base_io);
+	}
+}
+
+static struct spdk_io_channel *
+raid1_get_io_channel(struct raid_bdev *raid_bdev)
+{
+	struct raid1_info *r1info = raid_bdev->module_private;
+
+	return spdk_get_io_channel(r1info);
+}
+
+static int
+raid1_start_common(struct raid_bdev *raid_bdev, uint8_t num_mirrors)
+{
+	uint64_t min_blockcnt = UINT64_MAX;
+	struct raid_base_bdev_info *base_info;
+	struct raid1_info *r1info;
+
+	if (raid_bdev->num_base_bdevs % num_mirrors != 0) {
+		SPDK_ERRLOG("Number of base bdevs must be a multiple of %u\n", num_mirrors);
+		return -EINVAL;
+	}
+
+	r1info = calloc(1, sizeof(*r1info));
+	if (!r1info) {
+		SPDK_ERRLOG("Failed to allocate r1info\n");
+		return -ENOMEM;
+	}
+	r1info->raid_bdev = raid_bdev;
+	r1info->num_mirrors = num_mirrors;
+	r1info->num_groups = raid_bdev->num_base_bdevs / num_mirrors;
+
+	RAID_FOR_EACH_BASE_BDEV(raid_bdev, base_info) {
+		min_blockcnt = spdk_min(min_blockcnt, base_info->bdev->blockcnt);
+	}
+
+	if (r1info->num_groups > 1) {
+		raid_bdev->bdev.blockcnt = ((min_blockcnt >> raid_bdev->strip_size_shift) <<
+					    raid_bdev->strip_size_shift) * r1info->num_groups;
+		raid_bdev->bdev.optimal_io_boundary = raid_bdev->strip_size;
+		raid_bdev->bdev.split_on_optimal_io_boundary = true;
+	} else {
+		raid_bdev->bdev.blockcnt = min_blockcnt;
+		raid_bdev->bdev.optimal_io_boundary = 0;
+		raid_bdev->bdev.split_on_optimal_io_boundary = false;
+	}
+
+	SPDK_DEBUGLOG(SPDK_LOG_BDEV_RAID1, "min blockcount %lu, mirrors %u, groups %u\n",
+		      min_blockcnt, r1info->num_mirrors, r1info->num_groups);
+
+	raid_bdev->module_private = r1info;
+
+	spdk_io_device_register(r1info, raid1_ioch_create, raid1_ioch_destroy,
+				sizeof(struct raid1_io_channel) +
+				raid_bdev->num_base_bdevs * sizeof(struct raid1_slot), NULL);
+
+	return 0;
+}
+
+static int
+raid1_start(struct raid_bdev *raid_bdev)
+{
+	return raid1_start_common(raid_bdev, raid_bdev->num_base_bdevs);
+}
+
+static int
+raid10_start(struct raid_bdev *raid_bdev)
+{
+	return raid1_start_common(raid_bdev, 2);
+}
+
+static void
+raid1_io_device_unregister_done(void *io_device)
+{
+	struct raid1_info *r1info = io_device;
+
+	free(r1info);
+}
+
+static void
+raid1_stop(struct raid_bdev *raid_bdev)
+{
+	struct raid1_info *r1info = raid_bdev->module_private;
+
+	spdk_io_device_unregister(r1info, raid1_io_device_unregister_done);
+}
+
+static struct raid_bdev_module g_raid1_module = {
+	.level = RAID1,
+	.base_bdevs_min = 2,
+	/* Any number of mirrors can be missing, except for the last one */
+	.base_bdevs_max_degraded = UINT8_MAX,
+	.start = raid1_start,
+	.stop = raid1_stop,
+	.submit_rw_request = raid1_submit_rw_request,
+	.submit_null_payload_request = raid1_submit_null_payload_request,
+	.get_io_channel = raid1_get_io_channel,
+	.submit_rebuild_request = raid1_submit_rebuild_request,
+};
+RAID_MODULE_REGISTER(&g_raid1_module)
+
+static struct raid_bdev_module g_raid10_module = {
+	.level = RAID10,
+	.base_bdevs_min = 4,
+	.base_bdevs_max_degraded = 1,
+	.start = raid10_start,
+	.stop = raid1_stop,
+	.submit_rw_request = raid1_submit_rw_request,
+	.submit_null_payload_request = raid1_submit_null_payload_request,
+	.get_io_channel = raid1_get_io_channel,
+	.submit_rebuild_request = raid1_submit_rebuild_request,
+};
+RAID_MODULE_REGISTER(&g_raid10_module)
+
+SPDK_LOG_REGISTER_COMPONENT("bdev_raid1", SPDK_LOG_BDEV_RAID1)
@@ -40,27 +40,1452 @@
 
 #include "spdk_internal/log.h"
 
+/* Maximum number of concurrently processed stripe requests per io channel */
+#define RAID5_MAX_STRIPE_REQUESTS 32
+
+/* Initial size of the per chunk I/O vector array */
+#define RAID5_CHUNK_IOVCNT_INIT 4
+
+/* Number of stripe locks shared by all io channels, must be a power of 2 */
+#define RAID5_STRIPE_LOCKS_NUM 4096
+
+/* Number of stripes with parity kept in memory per io channel */
+#define RAID5_PARITY_CACHE_SIZE 32
+
 struct raid5_info {
 	/* The parent raid bdev */
 	struct raid_bdev *raid_bdev;
 
-	/* Number of data blocks in a stripe (without parity) */
-	uint64_t stripe_blocks;
+	/* Number of data blocks in a stripe (without parity) */
+	uint64_t stripe_blocks;
+
+	/* Number of stripes on this array */
+	uint64_t total_stripes;
+
+	/* Alignment of the stripe request buffers */
+	size_t buf_align;
+
+	/*
+	 * Stripe locks shared by all io channels. Bit 0 is set while the lock is
+	 * held, the remaining bits count parity updates of the stripes hashed to
+	 * the lock and are used to validate cached parity.
+	 */
+	uint64_t *stripe_locks;
+};
+
+struct chunk {
+	/* Corresponds to base bdev index */
+	uint8_t index;
+
+	/* Request offset from chunk start */
+	uint64_t req_offset;
+
+	/* Request blocks count */
+	uint64_t req_blocks;
+
+	/* The part of the parent bdev_io payload mapped to this chunk */
+	struct iovec *iovs;
+	int iovcnt;
+	int iovcnt_max;
+
+	/* Buffer for old data or parity, strip_size blocks long */
+	void *buf;
+};
+
+enum stripe_request_type {
+	STRIPE_REQ_READ,
+	/* Read touching a missing base bdev, data is rebuilt from the rest of the stripe */
+	STRIPE_REQ_READ_DEGRADED,
+	/* Write of all data chunks, parity is generated from the new data only */
+	STRIPE_REQ_WRITE_FULL,
+	/* Read-modify-write, parity is updated with the old and new data of written chunks */
+	STRIPE_REQ_WRITE_RMW,
+	/* Reconstruct-write, parity is generated from the new data and the not written old data */
+	STRIPE_REQ_WRITE_RCW,
+	/* Like reconstruct-write, but the old data of the missing chunk is rebuilt first */
+	STRIPE_REQ_WRITE_RECONSTRUCT,
+	/* Write with the parity chunk missing, only data is written */
+	STRIPE_REQ_WRITE_NO_PARITY,
+};
+
+struct stripe_request_op {
+	/* Target chunk */
+	struct chunk *chunk;
+
+	/* Offset in blocks from the chunk start */
+	uint64_t offset;
+
+	/* Number of blocks */
+	uint64_t num_blocks;
+
+	bool is_write;
+
+	struct iovec *iovs;
+	int iovcnt;
+
+	/* Used when the operation targets the chunk buffer */
+	struct iovec buf_iov;
+};
+
+struct stripe_request {
+	struct raid5_io_channel *r5ch;
+
+	/* The associated raid_bdev_io */
+	struct raid_bdev_io *raid_io;
+
+	enum stripe_request_type type;
+
+	/* The stripe's index in the raid array */
+	uint64_t stripe_index;
+
+	/* Request offset from stripe start */
+	uint64_t req_offset;
+
+	/* Request blocks count */
+	uint64_t req_blocks;
+
+	/* The stripe's parity chunk */
+	struct chunk *parity_chunk;
+
+	/* Chunk of the missing base bdev, if any */
+	struct chunk *degraded_chunk;
+
+	/* Range of the strip (in blocks) in which parity is updated */
+	uint64_t parity_offset;
+	uint64_t parity_blocks;
+
+	/* Set if the request serializes with other requests to the same stripe */
+	bool locked;
+
+	/* Stripe lock generation at the time the lock was taken */
+	uint64_t generation;
+
+	/* Subsequent writes to the same stripe merged into this request */
+	TAILQ_HEAD(, stripe_request) merged_requests;
+
+	/* Base bdev I/O operations of the current processing phase */
+	struct stripe_request_op *ops;
+	uint8_t ops_count;
+	uint8_t ops_submitted;
+	uint8_t ops_remaining;
+
+	/* Called when all operations of the current phase completed successfully */
+	void (*phase_done)(struct stripe_request *stripe_req);
+
+	enum spdk_bdev_io_status status;
+
+	struct spdk_bdev_io_wait_entry waitq_entry;
+
+	TAILQ_ENTRY(stripe_request) link;
+
+	/* Array of chunks corresponding to base_bdevs, data chunks first, parity last */
+	struct chunk chunks[0];
+};
+
+struct raid5_parity_cache_entry {
+	/* Index of the cached stripe, UINT64_MAX if the entry is not used */
+	uint64_t stripe_index;
+
+	/* Stripe lock generation the parity is valid for */
+	uint64_t generation;
+
+	/* Parity of the whole strip */
+	void *parity;
+
+	TAILQ_ENTRY(raid5_parity_cache_entry) link;
+};
+
+struct raid5_io_channel {
+	struct raid5_info *r5info;
+
+	/* Stripe requests available for new I/O */
+	TAILQ_HEAD(, stripe_request) free_stripe_requests;
+
+	/* Stripe requests waiting for the stripe lock */
+	TAILQ_HEAD(, stripe_request) deferred_stripe_requests;
+
+	/*
+	 * Retries deferred stripe requests locked by other channels. Only registered
+	 * while there are deferred requests, so an idle channel doesn't keep the
+	 * thread busy.
+	 */
+	struct spdk_poller *deferred_poller;
+
+	/* Recently used parity, most recently used first */
+	TAILQ_HEAD(raid5_parity_cache_lru, raid5_parity_cache_entry) parity_cache_lru;
+	struct raid5_parity_cache_entry parity_cache[RAID5_PARITY_CACHE_SIZE];
+};
+
+#define __CHUNK_IN_RANGE(req, c) \
+	c < req->chunks + req->r5ch->r5info->raid_bdev->num_base_bdevs
+
+#define FOR_EACH_CHUNK_FROM(req, c, from) \
+	for (c = from; __CHUNK_IN_RANGE(req, c); c++)
+
+#define FOR_EACH_CHUNK(req, c) \
+	FOR_EACH_CHUNK_FROM(req, c, req->chunks)
+
+#define FOR_EACH_DATA_CHUNK(req, c) \
+	for (c = req->chunks; c < req->parity_chunk; c++)
+
+static inline uint8_t
+raid5_stripe_data_chunks_num(const struct raid_bdev *raid_bdev)
+{
+	return raid_bdev->num_base_bdevs - raid_bdev->module->base_bdevs_max_degraded;
+}
+
+/*
+ * Parity rotates over the base bdevs starting from the last one, data chunks
+ * follow the parity chunk (left-symmetric layout).
+ */
+static inline uint8_t
+raid5_stripe_parity_chunk_index(const struct raid_bdev *raid_bdev, uint64_t stripe_index)
+{
+	return raid5_stripe_data_chunks_num(raid_bdev) - stripe_index % raid_bdev->num_base_bdevs;
+}
+
+static inline uint8_t
+raid5_stripe_data_chunk_index(const struct raid_bdev *raid_bdev, uint64_t stripe_index,
+			      uint8_t data_chunk)
+{
+	return (raid5_stripe_parity_chunk_index(raid_bdev, stripe_index) + 1 + data_chunk) %
+	       raid_bdev->num_base_bdevs;
+}
+
+static void
+raid5_xor_buf(void *to, const void *from, size_t size)
+{
+	uint8_t *_to = to;
+	const uint8_t *_from = from;
+
+	if ((((uintptr_t)_to | (uintptr_t)_from) & (sizeof(uint64_t) - 1)) == 0) {
+		for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t)) {
+			*(uint64_t *)_to ^= *(const uint64_t *)_from;
+			_to += sizeof(uint64_t);
+			_from += sizeof(uint64_t);
+		}
+	}
+
+	while (size > 0) {
+		*_to++ ^= *_from++;
+		size--;
+	}
+}
+
+/* XOR size bytes of the iovs, starting offset bytes into them, into buf */
+static void
+raid5_xor_iovs_to_buf(void *buf, const struct iovec *iovs, int iovcnt, size_t offset, size_t size)
+{
+	uint8_t *_buf = buf;
+	size_t len;
+	int i;
+
+	for (i = 0; i < iovcnt && size > 0; i++) {
+		if (offset >= iovs[i].iov_len) {
+			offset -= iovs[i].iov_len;
+			continue;
+		}
+
+		len = spdk_min(iovs[i].iov_len - offset, size);
+		raid5_xor_buf(_buf, (uint8_t *)iovs[i].iov_base + offset, len);
+		_buf += len;
+		size -= len;
+		offset = 0;
+	}
+
+	assert(size == 0);
+}
+
+static inline void *
+raid5_chunk_buf(struct stripe_request *stripe_req, struct chunk *chunk, uint64_t offset)
+{
+	return (uint8_t *)chunk->buf + (offset << stripe_req->raid_io->raid_bdev->blocklen_shift);
+}
+
+static int
+raid5_chunk_reserve_iovs(struct chunk *chunk, int iovcnt)
+{
+	struct iovec *tmp;
+	int iovcnt_max;
+
+	if (iovcnt <= chunk->iovcnt_max) {
+		return 0;
+	}
+
+	iovcnt_max = spdk_max(iovcnt, chunk->iovcnt_max * 2);
+	tmp = realloc(chunk->iovs, iovcnt_max * sizeof(*tmp));
+	if (!tmp) {
+		return -ENOMEM;
+	}
+	chunk->iovs = tmp;
+	chunk->iovcnt_max = iovcnt_max;
+
+	return 0;
+}
+
+/*
+ * Map the part of the iovs starting at byte offset and len bytes long to the
+ * chunk's iovs.
+ */
+static int
+raid5_chunk_map_iovs(struct chunk *chunk, const struct iovec *iovs, int iovcnt,
+		     uint64_t offset, uint64_t len)
+{
+	size_t seg_len;
+	int ret;
+	int i;
+
+	chunk->iovcnt = 0;
+
+	for (i = 0; i < iovcnt && offset >= iovs[i].iov_len; i++) {
+		offset -= iovs[i].iov_len;
+	}
+
+	while (len > 0) {
+		if (i >= iovcnt) {
+			assert(false);
+			return -EINVAL;
+		}
+
+		ret = raid5_chunk_reserve_iovs(chunk, chunk->iovcnt + 1);
+		if (ret) {
+			return ret;
+		}
+
+		seg_len = spdk_min(iovs[i].iov_len - offset, len);
+		chunk->iovs[chunk->iovcnt].iov_base = (uint8_t *)iovs[i].iov_base + offset;
+		chunk->iovs[chunk->iovcnt].iov_len = seg_len;
+		chunk->iovcnt++;
+
+		len -= seg_len;
+		offset = 0;
+		i++;
+	}
+
+	return 0;
+}
+
+static inline uint64_t *
+raid5_stripe_lock_get(struct raid5_info *r5info, uint64_t stripe_index)
+{
+	return &r5info->stripe_locks[stripe_index & (RAID5_STRIPE_LOCKS_NUM - 1)];
+}
+
+static bool
+raid5_stripe_trylock(struct raid5_info *r5info, uint64_t stripe_index, uint64_t *generation)
+{
+	uint64_t *lock = raid5_stripe_lock_get(r5info, stripe_index);
+	uint64_t val = __atomic_load_n(lock, __ATOMIC_RELAXED);
+
+	if (val & 1) {
+		return false;
+	}
+
+	if (!__atomic_compare_exchange_n(lock, &val, val | 1, false, __ATOMIC_ACQUIRE,
+					 __ATOMIC_RELAXED)) {
+		return false;
+	}
+
+	*generation = val >> 1;
+
+	return true;
+}
+
+static void
+raid5_stripe_unlock(struct raid5_info *r5info, uint64_t stripe_index, bool modified)
+{
+	uint64_t *lock = raid5_stripe_lock_get(r5info, stripe_index);
+
+	if (modified) {
+		/* Clears the lock bit and carries into the generation */
+		__atomic_add_fetch(lock, 1, __ATOMIC_RELEASE);
+	} else {
+		__atomic_and_fetch(lock, ~1ULL, __ATOMIC_RELEASE);
+	}
+}
+
+static struct raid5_parity_cache_entry *
+raid5_parity_cache_lookup(struct raid5_io_channel *r5ch, uint64_t stripe_index)
+{
+	struct raid5_parity_cache_entry *entry;
+
+	TAILQ_FOREACH(entry, &r5ch->parity_cache_lru, link) {
+		if (entry->stripe_index == stripe_index) {
+			return entry;
+		}
+	}
+
+	return NULL;
+}
+
+static void
+raid5_parity_cache_invalidate(struct raid5_io_channel *r5ch, struct raid5_parity_cache_entry *entry)
+{
+	entry->stripe_index = UINT64_MAX;
+	TAILQ_REMOVE(&r5ch->parity_cache_lru, entry, link);
+	TAILQ_INSERT_TAIL(&r5ch->parity_cache_lru, entry, link);
+}
+
+/*
+ * Get the cached parity of the locked stripe. Parity cached by this channel
+ * is stale if any other channel updated the stripe since then.
+ */
+static struct raid5_parity_cache_entry *
+raid5_parity_cache_get(struct stripe_request *stripe_req)
+{
+	struct raid5_io_channel *r5ch = stripe_req->r5ch;
+	struct raid5_parity_cache_entry *entry;
+
+	entry = raid5_parity_cache_lookup(r5ch, stripe_req->stripe_index);
+	if (entry == NULL) {
+		return NULL;
+	}
+
+	if (entry->generation != stripe_req->generation) {
+		raid5_parity_cache_invalidate(r5ch, entry);
+		return NULL;
+	}
+
+	TAILQ_REMOVE(&r5ch->parity_cache_lru, entry, link);
+	TAILQ_INSERT_HEAD(&r5ch->parity_cache_lru, entry, link);
+
+	return entry;
+}
+
+/*
+ * Update the parity cache after a successful write. Parity of the whole strip
+ * is moved into the cache by swapping buffers, smaller updates are only applied
+ * to an already cached stripe.
+ */
+static void
+raid5_parity_cache_update(struct stripe_request *stripe_req)
+{
+	struct raid5_io_channel *r5ch = stripe_req->r5ch;
+	struct raid_bdev *raid_bdev = stripe_req->raid_io->raid_bdev;
+	struct chunk *parity_chunk = stripe_req->parity_chunk;
+	struct raid5_parity_cache_entry *entry;
+	uint64_t offset_bytes;
+	void *tmp;
+
+	entry = raid5_parity_cache_get(stripe_req);
+
+	if (stripe_req->type == STRIPE_REQ_WRITE_NO_PARITY) {
+		if (entry != NULL) {
+			raid5_parity_cache_invalidate(r5ch, entry);
+		}
+		return;
+	}
+
+	if (stripe_req->parity_blocks == raid_bdev->strip_size) {
+		if (entry == NULL) {
+			entry = TAILQ_LAST(&r5ch->parity_cache_lru, raid5_parity_cache_lru);
+			TAILQ_REMOVE(&r5ch->parity_cache_lru, entry, link);
+			TAILQ_INSERT_HEAD(&r5ch->parity_cache_lru, entry, link);
+			entry->stripe_index = stripe_req->stripe_index;
+		}
+
+		tmp = entry->parity;
+		entry->parity = parity_chunk->buf;
+		parity_chunk->buf = tmp;
+	} else if (entry != NULL) {
+		offset_bytes = stripe_req->parity_offset << raid_bdev->blocklen_shift;
+		memcpy((uint8_t *)entry->parity + offset_bytes,
+		       raid5_chunk_buf(stripe_req, parity_chunk, stripe_req->parity_offset),
+		       stripe_req->parity_blocks << raid_bdev->blocklen_shift);
+	} else {
+		return;
+	}
+
+	/* The stripe lock generation is incremented when the lock is released */
+	entry->generation = stripe_req->generation + 1;
+}
+
+static void raid5_stripe_request_submit_ops(struct stripe_request *stripe_req);
+static void raid5_stripe_request_complete(struct stripe_request *stripe_req);
+
+static void
+_raid5_stripe_request_submit_ops(void *_stripe_req)
+{
+	struct stripe_request *stripe_req = _stripe_req;
+
+	raid5_stripe_request_submit_ops(stripe_req);
+}
+
+static void
+raid5_stripe_request_ops_complete(struct stripe_request *stripe_req, uint8_t count,
+				  enum spdk_bdev_io_status status)
+{
+	assert(stripe_req->ops_remaining >= count);
+	stripe_req->ops_remaining -= count;
+
+	if (status != SPDK_BDEV_IO_STATUS_SUCCESS) {
+		stripe_req->status = status;
+	}
+
+	if (stripe_req->ops_remaining == 0) {
+		if (stripe_req->status == SPDK_BDEV_IO_STATUS_SUCCESS) {
+			stripe_req->phase_done(stripe_req);
+		} else {
+			raid5_stripe_request_complete(stripe_req);
+		}
+	}
+}
+
+static void
+raid5_base_io_complete(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct stripe_request *stripe_req = cb_arg;
+
+	spdk_bdev_free_io(bdev_io);
+
+	raid5_stripe_request_ops_complete(stripe_req, 1, success ?
+					  SPDK_BDEV_IO_STATUS_SUCCESS :
+					  SPDK_BDEV_IO_STATUS_FAILED);
+}
+
+static void
+raid5_stripe_request_submit_ops(struct stripe_request *stripe_req)
+{
+	struct raid_bdev_io *raid_io = stripe_req->raid_io;
+	struct raid_bdev *raid_bdev = raid_io->raid_bdev;
+	uint64_t base_offset_blocks = stripe_req->stripe_index << raid_bdev->strip_size_shift;
+	struct stripe_request_op *op;
+	struct raid_base_bdev_info *base_info;
+	struct spdk_io_channel *base_ch;
+	int ret;
+
+	while (stripe_req->ops_submitted < stripe_req->ops_count) {
+		op = &stripe_req->ops[stripe_req->ops_submitted];
+		base_info = &raid_bdev->base_bdev_info[op->chunk->index];
+		base_ch = raid_io->raid_ch->base_channel[op->chunk->index];
+
+		if (base_ch == NULL) {
+			/* The base bdev was removed after this request was started */
+			ret = -ENODEV;
+		} else if (op->is_write) {
+			ret = spdk_bdev_writev_blocks(base_info->desc, base_ch, op->iovs, op->iovcnt,
+						      base_offset_blocks + op->offset, op->num_blocks,
+						      raid5_base_io_complete, stripe_req);
+		} else {
+			ret = spdk_bdev_readv_blocks(base_info->desc, base_ch, op->iovs, op->iovcnt,
+						     base_offset_blocks + op->offset, op->num_blocks,
+						     raid5_base_io_complete, stripe_req);
+		}
+
+		if (ret == 0) {
+			stripe_req->ops_submitted++;
+		} else if (ret == -ENOMEM) {
+			stripe_req->waitq_entry.bdev = base_info->bdev;
+			stripe_req->waitq_entry.cb_fn = _raid5_stripe_request_submit_ops;
+			stripe_req->waitq_entry.cb_arg = stripe_req;
+			spdk_bdev_queue_io_wait(base_info->bdev, base_ch, &stripe_req->waitq_entry);
+			return;
+		} else {
+			uint8_t not_submitted = stripe_req->ops_count - stripe_req->ops_submitted;
+
+			SPDK_ERRLOG("base bdev io submit error: %s\n", spdk_strerror(-ret));
+			stripe_req->ops_submitted = stripe_req->ops_count;
+			raid5_stripe_request_ops_complete(stripe_req, not_submitted,
+							  SPDK_BDEV_IO_STATUS_FAILED);
+			return;
+		}
+	}
+}
+
+static void
+raid5_stripe_request_add_op(struct stripe_request *stripe_req, struct chunk *chunk, bool is_write,
+			    uint64_t offset, uint64_t num_blocks, bool use_buf)
+{
+	struct stripe_request_op *op;
+
+	if (num_blocks == 0) {
+		return;
+	}
+
+	assert(chunk != stripe_req->degraded_chunk);
+	assert(stripe_req->ops_count < stripe_req->r5ch->r5info->raid_bdev->num_base_bdevs * 2);
+
+	op = &stripe_req->ops[stripe_req->ops_count++];
+	op->chunk = chunk;
+	op->is_write = is_write;
+	op->offset = offset;
+	op->num_blocks = num_blocks;
+
+	if (use_buf) {
+		op->buf_iov.iov_base = raid5_chunk_buf(stripe_req, chunk, offset);
+		op->buf_iov.iov_len = num_blocks << stripe_req->raid_io->raid_bdev->blocklen_shift;
+		op->iovs = &op->buf_iov;
+		op->iovcnt = 1;
+	} else {
+		assert(offset == chunk->req_offset && num_blocks == chunk->req_blocks);
+		op->iovs = chunk->iovs;
+		op->iovcnt = chunk->iovcnt;
+	}
+}
+
+static void
+raid5_stripe_request_submit_phase(struct stripe_request *stripe_req,
+				  void (*phase_done)(struct stripe_request *stripe_req))
+{
+	stripe_req->phase_done = phase_done;
+
+	if (stripe_req->ops_count == 0) {
+		phase_done(stripe_req);
+		return;
+	}
+
+	stripe_req->ops_submitted = 0;
+	stripe_req->ops_remaining = stripe_req->ops_count;
+
+	raid5_stripe_request_submit_ops(stripe_req);
+}
+
+static void
+raid5_stripe_request_write_done(struct stripe_request *stripe_req)
+{
+	raid5_parity_cache_update(stripe_req);
+
+	raid5_stripe_request_complete(stripe_req);
+}
+
+/*
+ * XOR the contents of the chunk in the given range of blocks into buf. Blocks
+ * within the request range are taken from the request payload and the rest from
+ * the chunk buffer.
+ */
+static void
+raid5_xor_chunk_range(struct stripe_request *stripe_req, struct chunk *chunk, uint64_t offset,
+		      uint64_t num_blocks, uint8_t *buf)
+{
+	uint32_t blocklen_shift = stripe_req->raid_io->raid_bdev->blocklen_shift;
+	uint64_t end = offset + num_blocks;
+	uint64_t req_start = spdk_max(chunk->req_offset, offset);
+	uint64_t req_end = spdk_min(chunk->req_offset + chunk->req_blocks, end);
+
+	if (chunk->req_blocks == 0 || req_start >= req_end) {
+		raid5_xor_buf(buf, raid5_chunk_buf(stripe_req, chunk, offset), num_blocks << blocklen_shift);
+		return;
+	}
+
+	raid5_xor_buf(buf, raid5_chunk_buf(stripe_req, chunk, offset),
+		      (req_start - offset) << blocklen_shift);
+	buf += (req_start - offset) << blocklen_shift;
+
+	raid5_xor_iovs_to_buf(buf, chunk->iovs, chunk->iovcnt,
+			      (req_start - chunk->req_offset) << blocklen_shift,
+			      (req_end - req_start) << blocklen_shift);
+	buf += (req_end - req_start) << blocklen_shift;
+
+	raid5_xor_buf(buf, raid5_chunk_buf(stripe_req, chunk, req_end),
+		      (end - req_end) << blocklen_shift);
+}
+
+/* XOR the contents of the data chunk within the parity range into buf */
+static void
+raid5_xor_chunk_data(struct stripe_request *stripe_req, struct chunk *chunk, uint8_t *buf)
+{
+	assert(chunk->req_blocks == 0 ||
+	       (chunk->req_offset >= stripe_req->parity_offset &&
+		chunk->req_offset + chunk->req_blocks <= stripe_req->parity_offset + stripe_req->parity_blocks));
+
+	raid5_xor_chunk_range(stripe_req, chunk, stripe_req->parity_offset, stripe_req->parity_blocks,
+			      buf);
+}
+
+static void
+raid5_stripe_request_gen_parity(struct stripe_request *stripe_req)
+{
+	uint32_t blocklen_shift = stripe_req->raid_io->raid_bdev->blocklen_shift;
+	uint8_t *parity_buf = raid5_chunk_buf(stripe_req, stripe_req->parity_chunk,
+					      stripe_req->parity_offset);
+	size_t parity_len = stripe_req->parity_blocks << blocklen_shift;
+	struct chunk *degraded_chunk = stripe_req->degraded_chunk;
+	struct chunk *chunk;
+	uint8_t *buf;
+	size_t len;
+
+	switch (stripe_req->type) {
+	case STRIPE_REQ_WRITE_RMW:
+		/* New parity = old parity ^ old data ^ new data of each written chunk */
+		FOR_EACH_DATA_CHUNK(stripe_req, chunk) {
+			if (chunk->req_blocks == 0) {
+				continue;
+			}
+
+			buf = parity_buf + ((chunk->req_offset - stripe_req->parity_offset) << blocklen_shift);
+			len = chunk->req_blocks << blocklen_shift;
+			raid5_xor_buf(buf, raid5_chunk_buf(stripe_req, chunk, chunk->req_offset), len);
+			raid5_xor_iovs_to_buf(buf, chunk->iovs, chunk->iovcnt, 0, len);
+		}
+		break;
+
+	case STRIPE_REQ_WRITE_RECONSTRUCT:
+		/* Rebuild the old data of the missing chunk from the old parity and data */
+		buf = raid5_chunk_buf(stripe_req, degraded_chunk, stripe_req->parity_offset);
+		memcpy(buf, parity_buf, parity_len);
+		FOR_EACH_DATA_CHUNK(stripe_req, chunk) {
+			if (chunk != degraded_chunk) {
+				raid5_xor_buf(buf, raid5_chunk_buf(stripe_req, chunk, stripe_req->parity_offset),
+					      parity_len);
+			}
+		}
+	/* fallthrough */
+	case STRIPE_REQ_WRITE_FULL:
+	case STRIPE_REQ_WRITE_RCW:
+		memset(parity_buf, 0, parity_len);
+		FOR_EACH_DATA_CHUNK(stripe_req, chunk) {
+			raid5_xor_chunk_data(stripe_req, chunk, parity_buf);
+		}
+		break;
+
+	default:
+		assert(false);
+	}
+}
+
+static void
+raid5_stripe_request_write_reads_done(struct stripe_request *stripe_req)
+{
+	struct chunk *chunk;
+
+	if (stripe_req->type != STRIPE_REQ_WRITE_NO_PARITY) {
+		raid5_stripe_request_gen_parity(stripe_req);
+	}
+
+	stripe_req->ops_count = 0;
+
+	FOR_EACH_DATA_CHUNK(stripe_req, chunk) {
+		if (chunk != stripe_req->degraded_chunk) {
+			raid5_stripe_request_add_op(stripe_req, chunk, true, chunk->req_offset,
+						    chunk->req_blocks, false);
+		}
+	}
+
+	if (stripe_req->type != STRIPE_REQ_WRITE_NO_PARITY) {
+		raid5_stripe_request_add_op(stripe_req, stripe_req->parity_chunk, true,
+					    stripe_req->parity_offset, stripe_req->parity_blocks, true);
+	}
+
+	raid5_stripe_request_submit_phase(stripe_req, raid5_stripe_request_write_done);
+}
+
+static enum stripe_request_type
+raid5_stripe_request_write_type(struct stripe_request *stripe_req, bool parity_cached)
+{
+	struct raid_bdev *raid_bdev = stripe_req->raid_io->raid_bdev;
+	struct chunk *degraded_chunk = stripe_req->degraded_chunk;
+	uint64_t parity_end = stripe_req->parity_offset + stripe_req->parity_blocks;
+	uint64_t num_blocks = 0;
+	uint64_t rmw_blocks, rcw_blocks;
+	bool full_stripe = true;
+	struct chunk *chunk;
+
+	FOR_EACH_DATA_CHUNK(stripe_req, chunk) {
+		num_blocks += chunk->req_blocks;
+		if (chunk->req_blocks != raid_bdev->strip_size) {
+			full_stripe = false;
+		}
+	}
+
+	if (degraded_chunk == stripe_req->parity_chunk) {
+		return STRIPE_REQ_WRITE_NO_PARITY;
+	}
+
+	if (full_stripe) {
+		return STRIPE_REQ_WRITE_FULL;
+	}
+
+	if (degraded_chunk != NULL) {
+		if (degraded_chunk->req_blocks == 0) {
+			/* The missing chunk is not needed to update the parity */
+			return STRIPE_REQ_WRITE_RMW;
+		} else if (degraded_chunk->req_offset == stripe_req->parity_offset &&
+			   degraded_chunk->req_offset + degraded_chunk->req_blocks == parity_end) {
+			/* Nothing has to be read from the missing chunk */
+			return STRIPE_REQ_WRITE_RCW;
+		} else {
+			return STRIPE_REQ_WRITE_RECONSTRUCT;
+		}
+	}
+
+	/* Pick the method which reads less from the base bdevs */
+	rmw_blocks = num_blocks + (parity_cached ? 0 : stripe_req->parity_blocks);
+	rcw_blocks = raid5_stripe_data_chunks_num(raid_bdev) * stripe_req->parity_blocks - num_blocks;
+
+	return rmw_blocks < rcw_blocks ? STRIPE_REQ_WRITE_RMW : STRIPE_REQ_WRITE_RCW;
+}
+
+static void
+raid5_stripe_request_execute_write(struct stripe_request *stripe_req)
+{
+	struct raid_bdev *raid_bdev = stripe_req->raid_io->raid_bdev;
+	struct raid5_parity_cache_entry *entry;
+	struct chunk *first = NULL, *last = NULL;
+	uint64_t parity_end;
+	struct chunk *chunk;
+
+	FOR_EACH_DATA_CHUNK(stripe_req, chunk) {
+		if (chunk->req_blocks > 0) {
+			if (first == NULL) {
+				first = chunk;
+			}
+			last = chunk;
+		}
+	}
+	assert(first != NULL);
+
+	/* Parity is updated in the range covering the written blocks of all chunks */
+	if (first == last) {
+		stripe_req->parity_offset = first->req_offset;
+		stripe_req->parity_blocks = first->req_blocks;
+	} else {
+		stripe_req->parity_offset = 0;
+		stripe_req->parity_blocks = raid_bdev->strip_size;
+	}
+	parity_end = stripe_req->parity_offset + stripe_req->parity_blocks;
+
+	entry = raid5_parity_cache_get(stripe_req);
+
+	stripe_req->type = raid5_stripe_request_write_type(stripe_req, entry != NULL);
+	stripe_req->ops_count = 0;
+
+	switch (stripe_req->type) {
+	case STRIPE_REQ_WRITE_RMW:
+		FOR_EACH_DATA_CHUNK(stripe_req, chunk) {
+			raid5_stripe_request_add_op(stripe_req, chunk, false, chunk->req_offset,
+						    chunk->req_blocks, true);
+		}
+		if (entry != NULL) {
+			/* Take the old parity from the cache instead of reading it */
+			memcpy(raid5_chunk_buf(stripe_req, stripe_req->parity_chunk, stripe_req->parity_offset),
+			       (uint8_t *)entry->parity + (stripe_req->parity_offset << raid_bdev->blocklen_shift),
+			       stripe_req->parity_blocks << raid_bdev->blocklen_shift);
+		} else {
+			raid5_stripe_request_add_op(stripe_req, stripe_req->parity_chunk, false,
+						    stripe_req->parity_offset, stripe_req->parity_blocks, true);
+		}
+		break;
 
-	/* Number of stripes on this array */
-	uint64_t total_stripes;
-};
+	case STRIPE_REQ_WRITE_RCW:
+		FOR_EACH_DATA_CHUNK(stripe_req, chunk) {
+			if (chunk->req_blocks == 0) {
+				raid5_stripe_request_add_op(stripe_req, chunk, false, stripe_req->parity_offset,
+							    stripe_req->parity_blocks, true);
+			} else if (chunk != stripe_req->degraded_chunk) {
+				raid5_stripe_request_add_op(stripe_req, chunk, false, stripe_req->parity_offset,
+							    chunk->req_offset - stripe_req->parity_offset, true);
+				raid5_stripe_request_add_op(stripe_req, chunk, false,
+							    chunk->req_offset + chunk->req_blocks,
+							    parity_end - chunk->req_offset - chunk->req_blocks, true);
+			}
+		}
+		break;
 
-static inline uint8_t
-raid5_stripe_data_chunks_num(const struct raid_bdev *raid_bdev)
+	case STRIPE_REQ_WRITE_RECONSTRUCT:
+		FOR_EACH_CHUNK(stripe_req, chunk) {
+			if (chunk != stripe_req->degraded_chunk) {
+				raid5_stripe_request_add_op(stripe_req, chunk, false, stripe_req->parity_offset,
+							    stripe_req->parity_blocks, true);
+			}
+		}
+		break;
+
+	case STRIPE_REQ_WRITE_FULL:
+	case STRIPE_REQ_WRITE_NO_PARITY:
+		break;
+
+	default:
+		assert(false);
+	}
+
+	raid5_stripe_request_submit_phase(stripe_req, raid5_stripe_request_write_reads_done);
+}
+
+static void
+raid5_stripe_request_read_done(struct stripe_request *stripe_req)
 {
-	return raid_bdev->num_base_bdevs - raid_bdev->module->base_bdevs_max_degraded;
+	struct chunk *degraded_chunk = stripe_req->degraded_chunk;
+	struct iovec buf_iov;
+	struct chunk *chunk;
+
+	if (stripe_req->type == STRIPE_REQ_READ_DEGRADED) {
+		buf_iov.iov_base = raid5_chunk_buf(stripe_req, degraded_chunk, degraded_chunk->req_offset);
+		buf_iov.iov_len = degraded_chunk->req_blocks << stripe_req->raid_io->raid_bdev->blocklen_shift;
+
+		memset(buf_iov.iov_base, 0, buf_iov.iov_len);
+		FOR_EACH_CHUNK(stripe_req, chunk) {
+			if (chunk != degraded_chunk) {
+				raid5_xor_chunk_range(stripe_req, chunk, degraded_chunk->req_offset,
+						      degraded_chunk->req_blocks, buf_iov.iov_base);
+			}
+		}
+
+		spdk_iovcpy(&buf_iov, 1, degraded_chunk->iovs, degraded_chunk->iovcnt);
+	}
+
+	raid5_stripe_request_complete(stripe_req);
+}
+
+static void
+raid5_stripe_request_execute_read(struct stripe_request *stripe_req)
+{
+	struct chunk *degraded_chunk = stripe_req->degraded_chunk;
+	struct chunk *chunk;
+
+	stripe_req->ops_count = 0;
+
+	FOR_EACH_DATA_CHUNK(stripe_req, chunk) {
+		if (chunk != degraded_chunk) {
+			raid5_stripe_request_add_op(stripe_req, chunk, false, chunk->req_offset,
+						    chunk->req_blocks, false);
+		}
+	}
+
+	if (degraded_chunk != NULL && degraded_chunk->req_blocks > 0) {
+		stripe_req->type = STRIPE_REQ_READ_DEGRADED;
+
+		/*
+		 * Read the same range from all the other chunks to rebuild the missing data.
+		 * Blocks already read into the request payload are taken from there, so only
+		 * the rest of the range is read into the chunk buffers. Requested ranges are
+		 * contiguous across the stripe, so this adds at most one op per chunk.
+		 */
+		FOR_EACH_CHUNK(stripe_req, chunk) {
+			uint64_t start = degraded_chunk->req_offset;
+			uint64_t end = start + degraded_chunk->req_blocks;
+			uint64_t req_start = spdk_max(chunk->req_offset, start);
+			uint64_t req_end = spdk_min(chunk->req_offset + chunk->req_blocks, end);
+
+			if (chunk == degraded_chunk) {
+				continue;
+			}
+
+			if (chunk->req_blocks == 0 || req_start >= req_end) {
+				raid5_stripe_request_add_op(stripe_req, chunk, false, start, end - start, true);
+			} else {
+				raid5_stripe_request_add_op(stripe_req, chunk, false, start, req_start - start, true);
+				raid5_stripe_request_add_op(stripe_req, chunk, false, req_end, end - req_end, true);
+			}
+		}
+	} else {
+		stripe_req->type = STRIPE_REQ_READ;
+	}
+
+	raid5_stripe_request_submit_phase(stripe_req, raid5_stripe_request_read_done);
+}
+
+static void
+raid5_stripe_request_execute(struct stripe_request *stripe_req)
+{
+	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(stripe_req->raid_io);
+
+	if (bdev_io->type == SPDK_BDEV_IO_TYPE_WRITE) {
+		raid5_stripe_request_execute_write(stripe_req);
+	} else {
+		raid5_stripe_request_execute_read(stripe_req);
+	}
+}
+
+/*
+ * Check if the request has to wait for an earlier deferred request to the same
+ * stripe, to keep the order of requests to a stripe.
+ */
+static bool
+raid5_stripe_request_is_blocked(struct raid5_io_channel *r5ch, struct stripe_request *stripe_req)
+{
+	struct stripe_request *tmp;
+
+	TAILQ_FOREACH(tmp, &r5ch->deferred_stripe_requests, link) {
+		if (tmp == stripe_req) {
+			break;
+		}
+		if (tmp->stripe_index == stripe_req->stripe_index) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/*
+ * Append the next write to the same stripe to the request. Only a write
+ * starting right where the request ends can be merged.
+ */
+static bool
+raid5_stripe_request_merge(struct raid5_io_channel *r5ch, struct stripe_request *stripe_req,
+			   struct stripe_request *next)
+{
+	struct chunk *chunk, *next_chunk;
+
+	if (next->req_offset != stripe_req->req_offset + stripe_req->req_blocks ||
+	    spdk_bdev_io_from_ctx(next->raid_io)->type != SPDK_BDEV_IO_TYPE_WRITE) {
+		return false;
+	}
+
+	if ((next->degraded_chunk == NULL) != (stripe_req->degraded_chunk == NULL) ||
+	    (next->degraded_chunk != NULL &&
+	     next->degraded_chunk->index != stripe_req->degraded_chunk->index)) {
+		return false;
+	}
+
+	FOR_EACH_DATA_CHUNK(stripe_req, chunk) {
+		next_chunk = &next->chunks[chunk - stripe_req->chunks];
+		if (raid5_chunk_reserve_iovs(chunk, chunk->iovcnt + next_chunk->iovcnt)) {
+			return false;
+		}
+	}
+
+	FOR_EACH_DATA_CHUNK(stripe_req, chunk) {
+		next_chunk = &next->chunks[chunk - stripe_req->chunks];
+		if (next_chunk->req_blocks == 0) {
+			continue;
+		}
+
+		if (chunk->req_blocks == 0) {
+			chunk->req_offset = next_chunk->req_offset;
+		}
+		assert(chunk->req_offset + chunk->req_blocks == next_chunk->req_offset);
+		chunk->req_blocks += next_chunk->req_blocks;
+
+		memcpy(&chunk->iovs[chunk->iovcnt], next_chunk->iovs,
+		       next_chunk->iovcnt * sizeof(*next_chunk->iovs));
+		chunk->iovcnt += next_chunk->iovcnt;
+	}
+
+	stripe_req->req_blocks += next->req_blocks;
+	TAILQ_REMOVE(&r5ch->deferred_stripe_requests, next, link);
+	TAILQ_INSERT_TAIL(&stripe_req->merged_requests, next, link);
+
+	return true;
+}
+
+/*
+ * Merge the deferred writes following the request on the same stripe, so that
+ * sequential sub-stripe writes are written together, ideally as a full stripe.
+ */
+static void
+raid5_stripe_request_coalesce(struct raid5_io_channel *r5ch, struct stripe_request *stripe_req)
+{
+	struct stripe_request *next, *tmp;
+
+	if (spdk_bdev_io_from_ctx(stripe_req->raid_io)->type != SPDK_BDEV_IO_TYPE_WRITE) {
+		return;
+	}
+
+	TAILQ_FOREACH_SAFE(next, &r5ch->deferred_stripe_requests, link, tmp) {
+		if (next->stripe_index != stripe_req->stripe_index) {
+			continue;
+		}
+
+		/* Stop at the first request which can't be merged to keep the order */
+		if (!raid5_stripe_request_merge(r5ch, stripe_req, next)) {
+			break;
+		}
+	}
+}
+
+static bool
+raid5_process_deferred_stripe_requests(struct raid5_io_channel *r5ch)
+{
+	struct stripe_request *stripe_req;
+	bool started, any_started = false;
+
+	do {
+		started = false;
+		TAILQ_FOREACH(stripe_req, &r5ch->deferred_stripe_requests, link) {
+			if (raid5_stripe_request_is_blocked(r5ch, stripe_req) ||
+			    !raid5_stripe_trylock(r5ch->r5info, stripe_req->stripe_index,
+						  &stripe_req->generation)) {
+				continue;
+			}
+
+			TAILQ_REMOVE(&r5ch->deferred_stripe_requests, stripe_req, link);
+			raid5_stripe_request_coalesce(r5ch, stripe_req);
+			raid5_stripe_request_execute(stripe_req);
+			started = any_started = true;
+			break;
+		}
+	} while (started);
+
+	return any_started;
+}
+
+static int
+raid5_deferred_poll(void *arg)
+{
+	struct raid5_io_channel *r5ch = arg;
+
+	bool started;
+
+	started = raid5_process_deferred_stripe_requests(r5ch);
+	if (TAILQ_EMPTY(&r5ch->deferred_stripe_requests)) {
+		spdk_poller_unregister(&r5ch->deferred_poller);
+	}
+
+	return started ? SPDK_POLLER_BUSY : SPDK_POLLER_IDLE;
+}
+
+static void
+raid5_stripe_request_complete(struct stripe_request *stripe_req)
+{
+	struct raid5_io_channel *r5ch = stripe_req->r5ch;
+	struct raid_bdev_io *raid_io = stripe_req->raid_io;
+	enum spdk_bdev_io_status status = stripe_req->status;
+	bool locked = stripe_req->locked;
+	bool is_write = spdk_bdev_io_from_ctx(raid_io)->type == SPDK_BDEV_IO_TYPE_WRITE;
+	struct raid5_parity_cache_entry *entry;
+	struct stripe_request *merged;
+
+	if (locked) {
+		if (is_write && status != SPDK_BDEV_IO_STATUS_SUCCESS) {
+			entry = raid5_parity_cache_lookup(r5ch, stripe_req->stripe_index);
+			if (entry != NULL) {
+				raid5_parity_cache_invalidate(r5ch, entry);
+			}
+		}
+		raid5_stripe_unlock(r5ch->r5info, stripe_req->stripe_index, is_write);
+	}
+
+	while ((merged = TAILQ_FIRST(&stripe_req->merged_requests))) {
+		TAILQ_REMOVE(&stripe_req->merged_requests, merged, link);
+		TAILQ_INSERT_HEAD(&r5ch->free_stripe_requests, merged, link);
+		raid_bdev_io_complete(merged->raid_io, status);
+	}
+
+	TAILQ_INSERT_HEAD(&r5ch->free_stripe_requests, stripe_req, link);
+	raid_bdev_io_complete(raid_io, status);
+
+	if (locked) {
+		raid5_process_deferred_stripe_requests(r5ch);
+	}
+}
+
+static int
+raid5_stripe_request_init(struct stripe_request *stripe_req, struct raid_bdev_io *raid_io,
+			  uint64_t stripe_index, uint64_t stripe_offset, uint64_t num_blocks)
+{
+	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(raid_io);
+	struct raid_bdev *raid_bdev = raid_io->raid_bdev;
+	uint8_t data_chunks = raid5_stripe_data_chunks_num(raid_bdev);
+	uint64_t stripe_blocks = (uint64_t)data_chunks << raid_bdev->strip_size_shift;
+	uint64_t req_end = stripe_offset + num_blocks;
+	uint64_t chunk_start, chunk_end;
+	uint64_t iov_offset = 0;
+	struct chunk *chunk;
+	int ret;
+
+	stripe_req->raid_io = raid_io;
+	stripe_req->stripe_index = stripe_index;
+	stripe_req->req_offset = stripe_offset;
+	stripe_req->req_blocks = num_blocks;
+	TAILQ_INIT(&stripe_req->merged_requests);
+	stripe_req->parity_chunk = &stripe_req->chunks[data_chunks];
+	stripe_req->degraded_chunk = NULL;
+	stripe_req->status = SPDK_BDEV_IO_STATUS_SUCCESS;
+	stripe_req->ops_count = 0;
+
+	FOR_EACH_DATA_CHUNK(stripe_req, chunk) {
+		uint8_t i = chunk - stripe_req->chunks;
+
+		chunk->index = raid5_stripe_data_chunk_index(raid_bdev, stripe_index, i);
+
+		chunk_start = (uint64_t)i << raid_bdev->strip_size_shift;
+		chunk_end = chunk_start + raid_bdev->strip_size;
+		if (req_end <= chunk_start || stripe_offset >= chunk_end) {
+			chunk->req_offset = 0;
+			chunk->req_blocks = 0;
+			chunk->iovcnt = 0;
+			continue;
+		}
+
+		chunk->req_offset = spdk_max(stripe_offset, chunk_start) - chunk_start;
+		chunk->req_blocks = spdk_min(req_end, chunk_end) - chunk_start - chunk->req_offset;
+
+		ret = raid5_chunk_map_iovs(chunk, bdev_io->u.bdev.iovs, bdev_io->u.bdev.iovcnt,
+					   iov_offset << raid_bdev->blocklen_shift,
+					   chunk->req_blocks << raid_bdev->blocklen_shift);
+		if (ret) {
+			return ret;
+		}
+
+		iov_offset += chunk->req_blocks;
+	}
+
+	chunk = stripe_req->parity_chunk;
+	chunk->index = raid5_stripe_parity_chunk_index(raid_bdev, stripe_index);
+	chunk->req_offset = 0;
+	chunk->req_blocks = 0;
+	chunk->iovcnt = 0;
+
+	FOR_EACH_CHUNK(stripe_req, chunk) {
+		/* A base bdev being rebuilt is missing in the stripes not rebuilt yet */
+		if (raid_bdev_channel_get_base_channel(raid_io->raid_ch, chunk->index,
+						       stripe_index * stripe_blocks, stripe_blocks) == NULL) {
+			if (stripe_req->degraded_chunk != NULL) {
+				SPDK_ERRLOG("More than one base bdev missing in stripe %lu\n", stripe_index);
+				return -ENODEV;
+			}
+			stripe_req->degraded_chunk = chunk;
+		}
+	}
+
+	return 0;
+}
+
+static void raid5_submit_rw_request(struct raid_bdev_io *raid_io);
+
+static void
+_raid5_submit_rw_request(void *_raid_io)
+{
+	struct raid_bdev_io *raid_io = _raid_io;
+
+	raid5_submit_rw_request(raid_io);
+}
+
+static void
+raid5_bdev_io_completion(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct raid_bdev_io *raid_io = cb_arg;
+
+	spdk_bdev_free_io(bdev_io);
+
+	raid_bdev_io_complete(raid_io, success ? SPDK_BDEV_IO_STATUS_SUCCESS :
+			      SPDK_BDEV_IO_STATUS_FAILED);
+}
+
+/*
+ * Reads within a single chunk of a present base bdev don't need a stripe
+ * request and are passed straight to the base bdev.
+ */
+static bool
+raid5_submit_read_single_chunk(struct raid_bdev_io *raid_io, uint64_t stripe_index,
+			       uint64_t stripe_offset)
+{
+	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(raid_io);
+	struct raid_bdev *raid_bdev = raid_io->raid_bdev;
+	uint64_t data_chunk = stripe_offset >> raid_bdev->strip_size_shift;
+	uint64_t chunk_offset = stripe_offset & (raid_bdev->strip_size - 1);
+	struct raid_base_bdev_info *base_info;
+	struct spdk_io_channel *base_ch;
+	uint8_t idx;
+	int ret;
+
+	if (chunk_offset + bdev_io->u.bdev.num_blocks > raid_bdev->strip_size) {
+		return false;
+	}
+
+	idx = raid5_stripe_data_chunk_index(raid_bdev, stripe_index, data_chunk);
+	base_info = &raid_bdev->base_bdev_info[idx];
+	base_ch = raid_bdev_channel_get_base_channel(raid_io->raid_ch, idx,
+			bdev_io->u.bdev.offset_blocks,
+			bdev_io->u.bdev.num_blocks);
+	if (base_ch == NULL) {
+		return false;
+	}
+
+	ret = spdk_bdev_readv_blocks(base_info->desc, base_ch,
+				     bdev_io->u.bdev.iovs, bdev_io->u.bdev.iovcnt,
+				     (stripe_index << raid_bdev->strip_size_shift) + chunk_offset,
+				     bdev_io->u.bdev.num_blocks, raid5_bdev_io_completion, raid_io);
+	if (ret == -ENOMEM) {
+		raid_bdev_queue_io_wait(raid_io, base_info->bdev, base_ch,
+					_raid5_submit_rw_request);
+	} else if (ret != 0) {
+		SPDK_ERRLOG("bdev io submit error not due to ENOMEM, it should not happen\n");
+		assert(false);
+		raid_bdev_io_complete(raid_io, SPDK_BDEV_IO_STATUS_FAILED);
+	}
+
+	return true;
 }
 
 static void
 raid5_submit_rw_request(struct raid_bdev_io *raid_io)
 {
-	raid_bdev_io_complete(raid_io, SPDK_BDEV_IO_STATUS_FAILED);
+	struct spdk_bdev_io *bdev_io = spdk_bdev_io_from_ctx(raid_io);
+	struct raid5_info *r5info = raid_io->raid_bdev->module_private;
+	struct raid5_io_channel *r5ch = spdk_io_channel_get_ctx(raid_io->raid_ch->module_channel);
+	uint64_t stripe_index = bdev_io->u.bdev.offset_blocks / r5info->stripe_blocks;
+	uint64_t stripe_offset = bdev_io->u.bdev.offset_blocks % r5info->stripe_blocks;
+	struct stripe_request *stripe_req;
+	int ret;
+
+	if (stripe_offset + bdev_io->u.bdev.num_blocks > r5info->stripe_blocks) {
+		assert(false);
+		SPDK_ERRLOG("I/O spans stripe boundary!\n");
+		raid_bdev_io_complete(raid_io, SPDK_BDEV_IO_STATUS_FAILED);
+		return;
+	}
+
+	if (bdev_io->type == SPDK_BDEV_IO_TYPE_READ &&
+	    raid5_submit_read_single_chunk(raid_io, stripe_index, stripe_offset)) {
+		return;
+	}
+
+	stripe_req = TAILQ_FIRST(&r5ch->free_stripe_requests);
+	if (!stripe_req) {
+		/* The bdev layer will retry the I/O when some of the outstanding ones complete */
+		raid_bdev_io_complete(raid_io, SPDK_BDEV_IO_STATUS_NOMEM);
+		return;
+	}
+
+	ret = raid5_stripe_request_init(stripe_req, raid_io, stripe_index, stripe_offset,
+					bdev_io->u.bdev.num_blocks);
+	if (ret) {
+		raid_bdev_io_complete(raid_io, ret == -ENOMEM ? SPDK_BDEV_IO_STATUS_NOMEM :
+				      SPDK_BDEV_IO_STATUS_FAILED);
+		return;
+	}
+
+	TAILQ_REMOVE(&r5ch->free_stripe_requests, stripe_req, link);
+
+	/*
+	 * Requests which read or update parity must not run concurrently with
+	 * a parity update of the same stripe.
+	 */
+	stripe_req->locked = bdev_io->type == SPDK_BDEV_IO_TYPE_WRITE ||
+			     (stripe_req->degraded_chunk != NULL &&
+			      stripe_req->degraded_chunk->req_blocks > 0);
+	if (stripe_req->locked) {
+		TAILQ_INSERT_TAIL(&r5ch->deferred_stripe_requests, stripe_req, link);
+		if (raid5_stripe_request_is_blocked(r5ch, stripe_req) ||
+		    !raid5_stripe_trylock(r5info, stripe_index, &stripe_req->generation)) {
+			if (r5ch->deferred_poller == NULL) {
+				r5ch->deferred_poller = SPDK_POLLER_REGISTER(raid5_deferred_poll, r5ch, 0);
+			}
+			return;
+		}
+		TAILQ_REMOVE(&r5ch->deferred_stripe_requests, stripe_req, link);
+	}
+
+	raid5_stripe_request_execute(stripe_req);
+}
+
+static void
+raid5_stripe_request_free(struct stripe_request *stripe_req)
+{
+	struct chunk *chunk;
+
+	FOR_EACH_CHUNK(stripe_req, chunk) {
+		spdk_dma_free(chunk->buf);
+		free(chunk->iovs);
+	}
+
+	free(stripe_req->ops);
+	free(stripe_req);
+}
+
+static struct stripe_request *
+raid5_stripe_request_alloc(struct raid5_io_channel *r5ch)
+{
+	struct raid5_info *r5info = r5ch->r5info;
+	struct raid_bdev *raid_bdev = r5info->raid_bdev;
+	size_t chunk_len = raid_bdev->strip_size << raid_bdev->blocklen_shift;
+	struct stripe_request *stripe_req;
+	struct chunk *chunk;
+
+	stripe_req = calloc(1, sizeof(*stripe_req) +
+			    sizeof(struct chunk) * raid_bdev->num_base_bdevs);
+	if (!stripe_req) {
+		return NULL;
+	}
+
+	stripe_req->r5ch = r5ch;
+
+	stripe_req->ops = calloc(raid_bdev->num_base_bdevs * 2, sizeof(*stripe_req->ops));
+	if (!stripe_req->ops) {
+		goto err;
+	}
+
+	FOR_EACH_CHUNK(stripe_req, chunk) {
+		chunk->iovcnt_max = RAID5_CHUNK_IOVCNT_INIT;
+		chunk->iovs = calloc(chunk->iovcnt_max, sizeof(*chunk->iovs));
+		if (!chunk->iovs) {
+			goto err;
+		}
+
+		chunk->buf = spdk_dma_malloc(chunk_len, r5info->buf_align, NULL);
+		if (!chunk->buf) {
+			goto err;
+		}
+	}
+
+	return stripe_req;
+err:
+	raid5_stripe_request_free(stripe_req);
+	return NULL;
+}
+
+static void
+raid5_ioch_destroy(void *io_device, void *ctx_buf)
+{
+	struct raid5_io_channel *r5ch = ctx_buf;
+	struct stripe_request *stripe_req;
+
+	int i;
+
+	assert(TAILQ_EMPTY(&r5ch->deferred_stripe_requests));
+
+	spdk_poller_unregister(&r5ch->deferred_poller);
+
+	while ((stripe_req = TAILQ_FIRST(&r5ch->free_stripe_requests))) {
+		TAILQ_REMOVE(&r5ch->free_stripe_requests, stripe_req, link);
+		raid5_stripe_request_free(stripe_req);
+	}
+
+	for (i = 0; i < RAID5_PARITY_CACHE_SIZE; i++) {
+		spdk_dma_free(r5ch->parity_cache[i].parity);
+	}
+}
+
+static int
+raid5_ioch_create(void *io_device, void *ctx_buf)
+{
+	struct raid5_io_channel *r5ch = ctx_buf;
+	struct raid5_info *r5info = io_device;
+	struct raid_bdev *raid_bdev = r5info->raid_bdev;
+	struct raid5_parity_cache_entry *entry;
+	struct stripe_request *stripe_req;
+	int i;
+
+	r5ch->r5info = r5info;
+	TAILQ_INIT(&r5ch->free_stripe_requests);
+	TAILQ_INIT(&r5ch->deferred_stripe_requests);
+	TAILQ_INIT(&r5ch->parity_cache_lru);
+
+	for (i = 0; i < RAID5_PARITY_CACHE_SIZE; i++) {
+		entry = &r5ch->parity_cache[i];
+		entry->stripe_index = UINT64_MAX;
+		entry->parity = spdk_dma_malloc(raid_bdev->strip_size << raid_bdev->blocklen_shift,
+						r5info->buf_align, NULL);
+		if (!entry->parity) {
+			SPDK_ERRLOG("Failed to allocate parity cache\n");
+			raid5_ioch_destroy(io_device, ctx_buf);
+			return -ENOMEM;
+		}
+		TAILQ_INSERT_TAIL(&r5ch->parity_cache_lru, entry, link);
+	}
+
+	for (i = 0; i < RAID5_MAX_STRIPE_REQUESTS; i++) {
+		stripe_req = raid5_stripe_request_alloc(r5ch);
+		if (!stripe_req) {
+			SPDK_ERRLOG("Failed to allocate stripe request\n");
+			raid5_ioch_destroy(io_device, ctx_buf);
+			return -ENOMEM;
+		}
+
+		TAILQ_INSERT_TAIL(&r5ch->free_stripe_requests, stripe_req, link);
+	}
+
+	return 0;
+}
+
+static struct spdk_io_channel *
+raid5_get_io_channel(struct raid_bdev *raid_bdev)
+{
+	struct raid5_info *r5info = raid_bdev->module_private;
+
+	return spdk_get_io_channel(r5info);
 }
 
 static int
@@ -77,8 +1502,16 @@ raid5_start(struct raid_bdev *raid_bdev)
 	}
 	r5info->raid_bdev = raid_bdev;
 
+	r5info->stripe_locks = calloc(RAID5_STRIPE_LOCKS_NUM, sizeof(*r5info->stripe_locks));
+	if (!r5info->stripe_locks) {
+		SPDK_ERRLOG("Failed to allocate stripe locks\n");
+		free(r5info);
+		return -ENOMEM;
+	}
+
 	RAID_FOR_EACH_BASE_BDEV(raid_bdev, base_info) {
 		min_blockcnt = spdk_min(min_blockcnt, base_info->bdev->blockcnt);
+		r5info->buf_align = spdk_max(r5info->buf_align, spdk_bdev_get_buf_align(base_info->bdev));
 	}
 
 	r5info->total_stripes = min_blockcnt / raid_bdev->strip_size;
@@ -90,15 +1523,174 @@ raid5_start(struct raid_bdev *raid_bdev)
 
 	raid_bdev->module_private = r5info;
 
+	spdk_io_device_register(r5info, raid5_ioch_create, raid5_ioch_destroy,
+				sizeof(struct raid5_io_channel), NULL);
+
 	return 0;
 }
 
+static void
+raid5_io_device_unregister_done(void *io_device)
+{
+	struct raid5_info *r5info = io_device;
+
+	free(r5info->stripe_locks);
+	free(r5info);
+}
+
 static void
 raid5_stop(struct raid_bdev *raid_bdev)
 {
 	struct raid5_info *r5info = raid_bdev->module_private;
 
-	free(r5info);
+	spdk_io_device_unregister(r5info, raid5_io_device_unregister_done);
+}
+
+static void
+raid5_rebuild_write_complete(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct raid_bdev_rebuild_request *rebuild_req = cb_arg;
+
+	spdk_bdev_free_io(bdev_io);
+
+	raid_bdev_rebuild_request_complete(rebuild_req, success ? 0 : -EIO);
+}
+
+static void
+raid5_rebuild_write(void *_rebuild_req)
+{
+	struct raid_bdev_rebuild_request *rebuild_req = _rebuild_req;
+	struct raid_bdev *raid_bdev = rebuild_req->raid_bdev;
+	struct raid_base_bdev_info *base_info = &raid_bdev->base_bdev_info[rebuild_req->target_idx];
+	struct spdk_io_channel *base_ch = rebuild_req->raid_ch->base_channel[rebuild_req->target_idx];
+	uint64_t pd_blocks = rebuild_req->num_blocks / raid5_stripe_data_chunks_num(raid_bdev);
+	uint64_t pd_lba = rebuild_req->offset_blocks / raid5_stripe_data_chunks_num(raid_bdev);
+	int ret;
+
+	ret = spdk_bdev_write_blocks(base_info->desc, base_ch, rebuild_req->buf, pd_lba, pd_blocks,
+				     raid5_rebuild_write_complete, rebuild_req);
+	if (ret == -ENOMEM) {
+		rebuild_req->waitq_entry.bdev = base_info->bdev;
+		rebuild_req->waitq_entry.cb_fn = raid5_rebuild_write;
+		rebuild_req->waitq_entry.cb_arg = rebuild_req;
+		spdk_bdev_queue_io_wait(base_info->bdev, base_ch, &rebuild_req->waitq_entry);
+	} else if (ret != 0) {
+		raid_bdev_rebuild_request_complete(rebuild_req, ret);
+	}
+}
+
+static void
+raid5_rebuild_read_complete(struct spdk_bdev_io *bdev_io, bool success, void *cb_arg)
+{
+	struct raid_bdev_rebuild_request *rebuild_req = cb_arg;
+	struct raid_bdev *raid_bdev = rebuild_req->raid_bdev;
+	uint8_t data_chunks = raid5_stripe_data_chunks_num(raid_bdev);
+	size_t len = (rebuild_req->num_blocks / data_chunks) << raid_bdev->blocklen_shift;
+	uint8_t i;
+
+	spdk_bdev_free_io(bdev_io);
+
+	if (!success) {
+		rebuild_req->base_bdev_io_status = -EIO;
+	}
+
+	assert(rebuild_req->base_bdev_io_remaining > 0);
+	if (--rebuild_req->base_bdev_io_remaining > 0) {
+		return;
+	}
+
+	if (rebuild_req->base_bdev_io_status != 0) {
+		raid_bdev_rebuild_request_complete(rebuild_req, rebuild_req->base_bdev_io_status);
+		return;
+	}
+
+	/* The missing chunk is the xor of the other chunks, whether it is data or parity */
+	for (i = 1; i < data_chunks; i++) {
+		raid5_xor_buf(rebuild_req->buf, (uint8_t *)rebuild_req->buf + i * len, len);
+	}
+
+	raid5_rebuild_write(rebuild_req);
+}
+
+static int raid5_submit_rebuild_request(struct raid_bdev_rebuild_request *rebuild_req);
+
+static void
+_raid5_submit_rebuild_request(void *_rebuild_req)
+{
+	struct raid_bdev_rebuild_request *rebuild_req = _rebuild_req;
+	int ret;
+
+	ret = raid5_submit_rebuild_request(rebuild_req);
+	if (ret != 0) {
+		raid_bdev_rebuild_request_complete(rebuild_req, ret);
+	}
+}
+
+/*
+ * brief:
+ * raid5_submit_rebuild_request reconstructs whole stripes of the rebuilt base
+ * bdev. The chunks of the stripes on the other base bdevs are read into
+ * consecutive segments of the request buffer, xored into the first one and
+ * written to the rebuilt base bdev.
+ * params:
+ * rebuild_req - pointer to the rebuild request
+ * returns:
+ * 0 on success, negative errno otherwise
+ */
+static int
+raid5_submit_rebuild_request(struct raid_bdev_rebuild_request *rebuild_req)
+{
+	struct raid_bdev *raid_bdev = rebuild_req->raid_bdev;
+	struct raid_bdev_io_channel *raid_ch = rebuild_req->raid_ch;
+	uint8_t data_chunks = raid5_stripe_data_chunks_num(raid_bdev);
+	uint64_t pd_blocks = rebuild_req->num_blocks / data_chunks;
+	uint64_t pd_lba = rebuild_req->offset_blocks / data_chunks;
+	struct raid_base_bdev_info *base_info;
+	struct spdk_io_channel *base_ch;
+	uint8_t *buf;
+	uint8_t idx, i;
+	int ret;
+
+	assert(rebuild_req->num_blocks % data_chunks == 0);
+
+	if (rebuild_req->base_bdev_io_submitted == 0) {
+		for (idx = 0; idx < raid_bdev->num_base_bdevs; idx++) {
+			if (idx != rebuild_req->target_idx && raid_ch->base_channel[idx] == NULL) {
+				SPDK_ERRLOG("More than one base bdev missing, can't rebuild\n");
+				return -ENODEV;
+			}
+		}
+		rebuild_req->base_bdev_io_remaining = data_chunks;
+	}
+
+	while (rebuild_req->base_bdev_io_submitted < data_chunks) {
+		i = rebuild_req->base_bdev_io_submitted;
+		idx = i < rebuild_req->target_idx ? i : i + 1;
+		base_info = &raid_bdev->base_bdev_info[idx];
+		base_ch = raid_ch->base_channel[idx];
+
+		buf = (uint8_t *)rebuild_req->buf + ((i * pd_blocks) << raid_bdev->blocklen_shift);
+
+		ret = spdk_bdev_read_blocks(base_info->desc, base_ch, buf, pd_lba, pd_blocks,
+					    raid5_rebuild_read_complete, rebuild_req);
+		if (ret == 0) {
+			rebuild_req->base_bdev_io_submitted++;
+		} else if (ret == -ENOMEM) {
+			rebuild_req->waitq_entry.bdev = base_info->bdev;
+			rebuild_req->waitq_entry.cb_fn = _raid5_submit_rebuild_request;
+			rebuild_req->waitq_entry.cb_arg = rebuild_req;
+			return spdk_bdev_queue_io_wait(base_info->bdev, base_ch, &rebuild_req->waitq_entry);
+		} else if (i == 0) {
+			return ret;
+		} else {
+			/* Complete the request once the submitted reads are done */
+			rebuild_req->base_bdev_io_status = ret;
+			rebuild_req->base_bdev_io_remaining -= data_chunks - i;
+			rebuild_req->base_bdev_io_submitted = data_chunks;
+		}
+	}
+
+	return 0;
 }
 
 static struct raid_bdev_module g_raid5_module = {
@@ -108,6 +1700,8 @@ static struct raid_bdev_module g_raid5_module = {
 	.start = raid5_start,
 	.stop = raid5_stop,
 	.submit_rw_request = raid5_submit_rw_request,
+	.get_io_channel = raid5_get_io_channel,
+	.submit_rebuild_request = raid5_submit_rebuild_request,
 };
 RAID_MODULE_REGISTER(&g_raid5_module)
 
@@ -292,6 +292,8 @@ rpc_dump_bdev_info(struct spdk_json_write_ctx *w,
 				   spdk_bdev_io_type_supported(bdev, SPDK_BDEV_IO_TYPE_NVME_ADMIN));
 	spdk_json_write_named_bool(w, "nvme_io",
 				   spdk_bdev_io_type_supported(bdev, SPDK_BDEV_IO_TYPE_NVME_IO));
+	spdk_json_write_named_bool(w, "copy",
+				   spdk_bdev_io_type_supported(bdev, SPDK_BDEV_IO_TYPE_COPY));
 	spdk_json_write_object_end(w);
 
 	spdk_json_write_named_object_begin(w, "driver_specific");
@@ -674,3 +676,150 @@ cleanup:
 
 SPDK_RPC_REGISTER("bdev_get_histogram", rpc_bdev_get_histogram, SPDK_RPC_RUNTIME)
 SPDK_RPC_REGISTER_ALIAS_DEPRECATED(bdev_get_histogram, get_bdev_histogram)
+
+struct rpc_bdev_get_histogram_by_type_request {
+	char *name;
+	char *io_type;
+};
+
+static const struct spdk_json_object_decoder rpc_bdev_get_histogram_by_type_request_decoders[] = {
+	{"name", offsetof(struct rpc_bdev_get_histogram_by_type_request, name), spdk_json_decode_string},
+	{"io_type", offsetof(struct rpc_bdev_get_histogram_by_type_request, io_type), spdk_json_decode_string},
+};
+
+static void
+free_rpc_bdev_get_histogram_by_type_request(struct rpc_bdev_get_histogram_by_type_request *r)
+{
+	free(r->name);
+	free(r->io_type);
+}
+
+struct rpc_bdev_histogram_by_type_ctx {
+	struct spdk_jsonrpc_request *request;
+	struct spdk_histogram_data *histograms[SPDK_BDEV_HISTOGRAM_SIZE_BUCKETS];
+};
+
+static void
+free_rpc_bdev_histogram_by_type_ctx(struct rpc_bdev_histogram_by_type_ctx *ctx)
+{
+	uint32_t bucket;
+
+	for (bucket = 0; bucket < SPDK_BDEV_HISTOGRAM_SIZE_BUCKETS; bucket++) {
+		spdk_histogram_data_free(ctx->histograms[bucket]);
+	}
+	free(ctx);
+}
+
+static void
+_rpc_bdev_histogram_by_type_cb(void *cb_arg, int status, struct spdk_histogram_data **histograms)
+{
+	struct rpc_bdev_histogram_by_type_ctx *ctx = cb_arg;
+	struct spdk_jsonrpc_request *request = ctx->request;
+	struct spdk_json_write_ctx *w;
+	char *encoded_histogram;
+	size_t src_len, dst_len;
+	uint32_t bucket;
+	int rc;
+
+	if (status != 0) {
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INTERNAL_ERROR,
+						 spdk_strerror(-status));
+		goto invalid;
+	}
+
+	/* All size buckets share the same bucket_shift, so they encode to the same length */
+	src_len = SPDK_HISTOGRAM_NUM_BUCKETS(histograms[0]) * sizeof(uint64_t);
+	dst_len = spdk_base64_get_encoded_strlen(src_len) + 1;
+
+	encoded_histogram = malloc(dst_len);
+	if (encoded_histogram == NULL) {
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INTERNAL_ERROR,
+						 spdk_strerror(ENOMEM));
+		goto invalid;
+	}
+
+	w = spdk_jsonrpc_begin_result(request);
+	spdk_json_write_object_begin(w);
+	spdk_json_write_named_int64(w, "bucket_shift", histograms[0]->bucket_shift);
+	spdk_json_write_named_int64(w, "tsc_rate", spdk_get_ticks_hz());
+	spdk_json_write_named_array_begin(w, "size_buckets");
+	for (bucket = 0; bucket < SPDK_BDEV_HISTOGRAM_SIZE_BUCKETS; bucket++) {
+		rc = spdk_base64_encode(encoded_histogram, histograms[bucket]->bucket, src_len);
+		assert(rc == 0);
+		(void)rc;
+
+		spdk_json_write_object_begin(w);
+		spdk_json_write_named_uint64(w, "min_size", SPDK_BDEV_HISTOGRAM_SIZE_BUCKET_MIN(bucket));
+		spdk_json_write_named_string(w, "histogram", encoded_histogram);
+		spdk_json_write_object_end(w);
+	}
+	spdk_json_write_array_end(w);
+	spdk_json_write_object_end(w);
+	spdk_jsonrpc_end_result(request, w);
+
+	free(encoded_histogram);
+invalid:
+	free_rpc_bdev_histogram_by_type_ctx(ctx);
+}
+
+static void
+rpc_bdev_get_histogram_by_type(struct spdk_jsonrpc_request *request,
+			       const struct spdk_json_val *params)
+{
+	struct rpc_bdev_get_histogram_by_type_request req = {NULL};
+	struct rpc_bdev_histogram_by_type_ctx *ctx;
+	enum spdk_bdev_io_type io_type;
+	struct spdk_bdev *bdev;
+	uint32_t bucket;
+
+	if (spdk_json_decode_object(params, rpc_bdev_get_histogram_by_type_request_decoders,
+				    SPDK_COUNTOF(rpc_bdev_get_histogram_by_type_request_decoders),
+				    &req)) {
+		SPDK_ERRLOG("spdk_json_decode_object failed\n");
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INTERNAL_ERROR,
+						 "spdk_json_decode_object failed");
+		goto cleanup;
+	}
+
+	if (strcmp(req.io_type, "read") == 0) {
+		io_type = SPDK_BDEV_IO_TYPE_READ;
+	} else if (strcmp(req.io_type, "write") == 0) {
+		io_type = SPDK_BDEV_IO_TYPE_WRITE;
+	} else if (strcmp(req.io_type, "unmap") == 0) {
+		io_type = SPDK_BDEV_IO_TYPE_UNMAP;
+	} else {
+		spdk_jsonrpc_send_error_response_fmt(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS,
+						     "Invalid io_type: %s", req.io_type);
+		goto cleanup;
+	}
+
+	bdev = spdk_bdev_get_by_name(req.name);
+	if (bdev == NULL) {
+		spdk_jsonrpc_send_error_response(request, -ENODEV, spdk_strerror(ENODEV));
+		goto cleanup;
+	}
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (ctx == NULL) {
+		spdk_jsonrpc_send_error_response(request, -ENOMEM, spdk_strerror(ENOMEM));
+		goto cleanup;
+	}
+	ctx->request = request;
+
+	for (bucket = 0; bucket < SPDK_BDEV_HISTOGRAM_SIZE_BUCKETS; bucket++) {
+		ctx->histograms[bucket] = spdk_histogram_data_alloc_sized(SPDK_BDEV_HISTOGRAM_BY_TYPE_BUCKET_SHIFT);
+		if (ctx->histograms[bucket] == NULL) {
+			free_rpc_bdev_histogram_by_type_ctx(ctx);
+			spdk_jsonrpc_send_error_response(request, -ENOMEM, spdk_strerror(ENOMEM));
+			goto cleanup;
+		}
+	}
+
+	spdk_bdev_histogram_get_by_type(bdev, io_type, ctx->histograms,
+					_rpc_bdev_histogram_by_type_cb, ctx);
+
+cleanup:
+	free_rpc_bdev_get_histogram_by_type_request(&req);
+}
+
+SPDK_RPC_REGISTER("bdev_get_histogram_by_type", rpc_bdev_get_histogram_by_type, SPDK_RPC_RUNTIME)
@@ -202,15 +202,12 @@ _rpc_thread_get_stats(void *arg)
 	struct spdk_poller *poller;
 	struct spdk_thread_stats stats;
 	uint64_t active_pollers_count = 0;
-	uint64_t timed_pollers_count = 0;
+	uint64_t timed_pollers_count = thread->timed_pollers_count;
 	uint64_t paused_pollers_count = 0;
 
 	TAILQ_FOREACH(poller, &thread->active_pollers, tailq) {
 		active_pollers_count++;
 	}
-	TAILQ_FOREACH(poller, &thread->timed_pollers, tailq) {
-		timed_pollers_count++;
-	}
 	TAILQ_FOREACH(poller, &thread->paused_pollers, tailq) {
 		paused_pollers_count++;
 	}
@@ -265,6 +262,7 @@ _rpc_thread_get_pollers(void *arg)
 	struct rpc_get_stats_ctx *ctx = arg;
 	struct spdk_thread *thread = spdk_get_thread();
 	struct spdk_poller *poller;
+	uint32_t i;
 
 	spdk_json_write_object_begin(ctx->w);
 	spdk_json_write_named_string(ctx->w, "name", spdk_thread_get_name(thread));
@@ -277,8 +275,9 @@ _rpc_thread_get_pollers(void *arg)
 	spdk_json_write_array_end(ctx->w);
 
 	spdk_json_write_named_array_begin(ctx->w, "timed_pollers");
-	TAILQ_FOREACH(poller, &thread->timed_pollers, tailq) {
-		rpc_get_poller(poller, ctx->w);
+	/* The timed pollers are listed in the order of the timer heap. */
+	for (i = 0; i < thread->timed_pollers_count; i++) {
+		rpc_get_poller(thread->timed_pollers[i], ctx->w);
 	}
 	spdk_json_write_array_end(ctx->w);
 
@@ -540,4 +539,80 @@ err:
 	free(ctx);
 }
 SPDK_RPC_REGISTER("thread_set_cpumask", rpc_thread_set_cpumask, SPDK_RPC_RUNTIME)
+
+struct rpc_framework_set_scheduler {
+	char *name;
+	uint64_t period;
+};
+
+static void
+free_rpc_framework_set_scheduler(struct rpc_framework_set_scheduler *r)
+{
+	free(r->name);
+}
+
+static const struct spdk_json_object_decoder rpc_set_scheduler_decoders[] = {
+	{"name", offsetof(struct rpc_framework_set_scheduler, name), spdk_json_decode_string},
+	{"period", offsetof(struct rpc_framework_set_scheduler, period), spdk_json_decode_uint64, true},
+};
+
+static void
+rpc_framework_set_scheduler(struct spdk_jsonrpc_request *request,
+			    const struct spdk_json_val *params)
+{
+	struct rpc_framework_set_scheduler req = {};
+	struct spdk_json_write_ctx *w;
+	int rc;
+
+	if (spdk_json_decode_object(params, rpc_set_scheduler_decoders,
+				    SPDK_COUNTOF(rpc_set_scheduler_decoders),
+				    &req)) {
+		SPDK_ERRLOG("spdk_json_decode_object failed\n");
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS,
+						 "Invalid parameters");
+		goto end;
+	}
+
+	rc = spdk_scheduler_set(req.name);
+	if (rc != 0) {
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS,
+						 spdk_strerror(-rc));
+		goto end;
+	}
+
+	if (req.period != 0) {
+		spdk_scheduler_set_period(req.period);
+	}
+
+	w = spdk_jsonrpc_begin_result(request);
+	spdk_json_write_bool(w, true);
+	spdk_jsonrpc_end_result(request, w);
+
+end:
+	free_rpc_framework_set_scheduler(&req);
+}
+SPDK_RPC_REGISTER("framework_set_scheduler", rpc_framework_set_scheduler,
+		  SPDK_RPC_STARTUP | SPDK_RPC_RUNTIME)
+
+static void
+rpc_framework_get_scheduler(struct spdk_jsonrpc_request *request,
+			    const struct spdk_json_val *params)
+{
+	struct spdk_json_write_ctx *w;
+
+	if (params) {
+		spdk_jsonrpc_send_error_response(request, SPDK_JSONRPC_ERROR_INVALID_PARAMS,
+						 "`framework_get_scheduler` requires no arguments");
+		return;
+	}
+
+	w = spdk_jsonrpc_begin_result(request);
+	spdk_json_write_object_begin(w);
+	spdk_json_write_named_string(w, "scheduler_name", spdk_scheduler_get()->name);
+	spdk_json_write_named_uint64(w, "scheduler_period", spdk_scheduler_get_period());
+	spdk_json_write_object_end(w);
+	spdk_jsonrpc_end_result(request, w);
+}
+SPDK_RPC_REGISTER("framework_get_scheduler", rpc_framework_get_scheduler,
+		  SPDK_RPC_STARTUP | SPDK_RPC_RUNTIME)
 SPDK_LOG_REGISTER_COMPONENT("APP_RPC", SPDK_LOG_APP_RPC)
@@ -157,17 +157,43 @@ if __name__ == "__main__":
         'framework_get_reactors', help='Display list of all reactors')
     p.set_defaults(func=framework_get_reactors)
 
+    def framework_set_scheduler(args):
+        rpc.app.framework_set_scheduler(args.client,
+                                        name=args.name,
+                                        period=args.period)
+
+    p = subparsers.add_parser(
+        'framework_set_scheduler', help='Select thread scheduler that will be activated and its period (experimental)')
+    p.add_argument('name', help="Name of a scheduler: static, balanced or consolidate")
+    p.add_argument('-p', '--period', help="Scheduler period in microseconds", type=int)
+    p.set_defaults(func=framework_set_scheduler)
+
+    def framework_get_scheduler(args):
+        print_dict(rpc.app.framework_get_scheduler(args.client))
+
+    p = subparsers.add_parser(
+        'framework_get_scheduler', help='Display currently set scheduler and its period')
+    p.set_defaults(func=framework_get_scheduler)
+
     # bdev
     def bdev_set_options(args):
         rpc.bdev.bdev_set_options(args.client,
                                   bdev_io_pool_size=args.bdev_io_pool_size,
                                   bdev_io_cache_size=args.bdev_io_cache_size,
-                                  bdev_auto_examine=args.bdev_auto_examine)
+                                  bdev_auto_examine=args.bdev_auto_examine,
+                                  small_buf_pool_size=args.small_buf_pool_size,
+                                  large_buf_pool_size=args.large_buf_pool_size,
+                                  small_buf_cache_size=args.small_buf_cache_size,
+                                  large_buf_cache_size=args.large_buf_cache_size)
 
     p = subparsers.add_parser('bdev_set_options', aliases=['set_bdev_options'],
                               help="""Set options of bdev subsystem""")
     p.add_argument('-p', '--bdev-io-pool-size', help='Number of bdev_io structures in shared buffer pool', type=int)
     p.add_argument('-c', '--bdev-io-cache-size', help='Maximum number of bdev_io structures cached per thread', type=int)
+    p.add_argument('--small-buf-pool-size', help='Number of small data buffers in the shared pool', type=int)
+    p.add_argument('--large-buf-pool-size', help='Number of large data buffers in the shared pool', type=int)
+    p.add_argument('--small-buf-cache-size', help='Maximum number of small data buffers cached per thread', type=int)
+    p.add_argument('--large-buf-cache-size', help='Maximum number of large data buffers cached per thread', type=int)
     group = p.add_mutually_exclusive_group()
     group.add_argument('-e', '--enable-auto-examine', dest='bdev_auto_examine', help='Allow to auto examine', action='store_true')
     group.add_argument('-d', '--disable-auto-examine', dest='bdev_auto_examine', help='Not allow to auto examine', action='store_false')
@@ -445,7 +471,8 @@ if __name__ == "__main__":
                                                          hostaddr=args.hostaddr,
                                                          hostsvcid=args.hostsvcid,
                                                          prchk_reftag=args.prchk_reftag,
-                                                         prchk_guard=args.prchk_guard))
+                                                         prchk_guard=args.prchk_guard,
+                                                         multipath=args.multipath))
 
     p = subparsers.add_parser('bdev_nvme_attach_controller', aliases=['construct_nvme_bdev'],
                               help='Add bdevs with nvme backend')
@@ -470,6 +497,9 @@ if __name__ == "__main__":
                    help='Enable checking of PI reference tag for I/O processing.', action='store_true')
     p.add_argument('-g', '--prchk-guard',
                    help='Enable checking of PI guard for I/O processing.', action='store_true')
+    p.add_argument('-m', '--multipath',
+                   help='Add the controller as another path to the existing controller with the same name.',
+                   action='store_true')
     p.set_defaults(func=bdev_nvme_attach_controller)
 
     def bdev_nvme_get_controllers(args):
@@ -491,6 +521,18 @@ if __name__ == "__main__":
     p.add_argument('name', help="Name of the controller")
     p.set_defaults(func=bdev_nvme_detach_controller)
 
+    def bdev_nvme_set_multipath_policy(args):
+        rpc.bdev.bdev_nvme_set_multipath_policy(args.client,
+                                                name=args.name,
+                                                policy=args.policy)
+
+    p = subparsers.add_parser('bdev_nvme_set_multipath_policy',
+                              help='Set how I/O is spread over the paths of a multipath NVMe controller')
+    p.add_argument('-b', '--name', help='Name of the NVMe controller', required=True)
+    p.add_argument('-p', '--policy', help='I/O path selection policy',
+                   choices=['active_passive', 'round_robin', 'queue_depth'], required=True)
+    p.set_defaults(func=bdev_nvme_set_multipath_policy)
+
     def bdev_nvme_cuse_register(args):
         rpc.bdev.bdev_nvme_cuse_register(args.client,
                                          name=args.name)
@@ -744,6 +786,15 @@ if __name__ == "__main__":
     p.add_argument('name', help='bdev name')
     p.set_defaults(func=bdev_get_histogram)
 
+    def bdev_get_histogram_by_type(args):
+        print_dict(rpc.bdev.bdev_get_histogram_by_type(args.client, name=args.name, io_type=args.io_type))
+
+    p = subparsers.add_parser('bdev_get_histogram_by_type',
+                              help='Get histograms for one I/O type of specified bdev, split by I/O size')
+    p.add_argument('name', help='bdev name')
+    p.add_argument('io_type', help='I/O type', choices=['read', 'write', 'unmap'])
+    p.set_defaults(func=bdev_get_histogram_by_type)
+
     def bdev_set_qd_sampling_period(args):
         rpc.bdev.bdev_set_qd_sampling_period(args.client,
                                              name=args.name,
@@ -1445,6 +1496,58 @@ Format: 'user:u1 secret:s1 muser:mu1 msecret:ms1,user:u2 secret:s2 muser:mu2 mse
     p.add_argument('name', help='lvol bdev name')
     p.set_defaults(func=bdev_lvol_decouple_parent)
 
+    def bdev_lvol_flatten(args):
+        rpc.lvol.bdev_lvol_flatten(args.client,
+                                   name=args.name,
+                                   max_mbytes_per_sec=args.max_mbytes_per_sec)
+
+    p = subparsers.add_parser('bdev_lvol_flatten',
+                              help='Remove dependency of lvol on its whole snapshot chain')
+    p.add_argument('name', help='lvol bdev name')
+    p.add_argument('-m', '--max-mbytes-per-sec', help='Maximum rate of copying data in MiB/s', type=int)
+    p.set_defaults(func=bdev_lvol_flatten)
+
+    def bdev_lvol_shallow_copy(args):
+        rpc.lvol.bdev_lvol_shallow_copy(args.client,
+                                        name=args.name,
+                                        dst_bdev_name=args.dst_bdev_name,
+                                        base_snapshot=args.base_snapshot,
+                                        queue_depth=args.queue_depth)
+
+    p = subparsers.add_parser('bdev_lvol_shallow_copy',
+                              help='Copy clusters of a read only lvol that differ from a base snapshot to another bdev')
+    p.add_argument('name', help='read only lvol bdev name')
+    p.add_argument('dst_bdev_name', help='name of bdev to copy data to')
+    p.add_argument('-b', '--base-snapshot', help='snapshot in the chain of the lvol to compare with (default: its parent)')
+    p.add_argument('-q', '--queue-depth', help='number of chunks copied in parallel', type=int)
+    p.set_defaults(func=bdev_lvol_shallow_copy)
+
+    def bdev_lvol_migrate(args):
+        rpc.lvol.bdev_lvol_migrate(args.client,
+                                   name=args.name,
+                                   uuid=args.uuid,
+                                   lvs_name=args.lvs_name,
+                                   queue_depth=args.queue_depth)
+
+    p = subparsers.add_parser('bdev_lvol_migrate',
+                              help='Move an lvol to another lvol store while it stays online')
+    p.add_argument('name', help='lvol bdev name')
+    p.add_argument('-u', '--uuid', help='UUID of the destination lvol store')
+    p.add_argument('-l', '--lvs-name', help='name of the destination lvol store')
+    p.add_argument('-q', '--queue-depth', help='number of chunks copied in parallel', type=int)
+    p.set_defaults(func=bdev_lvol_migrate)
+
+    def bdev_lvol_get_heatmap(args):
+        print_dict(rpc.lvol.bdev_lvol_get_heatmap(args.client,
+                                                  name=args.name,
+                                                  reset=args.reset))
+
+    p = subparsers.add_parser('bdev_lvol_get_heatmap',
+                              help='Display sampled per cluster I/O counts of an lvol')
+    p.add_argument('name', help='lvol bdev name')
+    p.add_argument('-r', '--reset', help='clear the counters after reading them', action='store_true')
+    p.set_defaults(func=bdev_lvol_get_heatmap)
+
     def bdev_lvol_resize(args):
         rpc.lvol.bdev_lvol_resize(args.client,
                                   name=args.name,
@@ -1497,8 +1600,8 @@ Format: 'user:u1 secret:s1 muser:mu1 msecret:ms1,user:u2 secret:s2 muser:mu2 mse
     p.set_defaults(func=bdev_lvol_get_lvstores)
 
     def bdev_raid_get_bdevs(args):
-        print_array(rpc.bdev.bdev_raid_get_bdevs(args.client,
-                                                 category=args.category))
+        print_dict(rpc.bdev.bdev_raid_get_bdevs(args.client,
+                                                category=args.category))
 
     p = subparsers.add_parser('bdev_raid_get_bdevs', aliases=['get_raid_bdevs'],
                               help="""This is used to list all the raid bdev names based on the input category
@@ -1525,7 +1628,7 @@ Format: 'user:u1 secret:s1 muser:mu1 msecret:ms1,user:u2 secret:s2 muser:mu2 mse
     p.add_argument('-n', '--name', help='raid bdev name', required=True)
     p.add_argument('-s', '--strip-size', help='strip size in KB (deprecated)', type=int)
     p.add_argument('-z', '--strip-size_kb', help='strip size in KB', type=int)
-    p.add_argument('-r', '--raid-level', help='raid level, only raid level 0 is supported', required=True)
+    p.add_argument('-r', '--raid-level', help='raid level, supported values are 0, 1, 5 and 10', required=True)
     p.add_argument('-b', '--base-bdevs', help='base bdevs name, whitespace separated list in quotes', required=True)
     p.set_defaults(func=bdev_raid_create)
 
@@ -1537,6 +1640,19 @@ Format: 'user:u1 secret:s1 muser:mu1 msecret:ms1,user:u2 secret:s2 muser:mu2 mse
     p.add_argument('name', help='raid bdev name')
     p.set_defaults(func=bdev_raid_delete)
 
+    def bdev_raid_add_base_bdev(args):
+        print_json(rpc.bdev.bdev_raid_add_base_bdev(args.client,
+                                                    name=args.name,
+                                                    base_bdev=args.base_bdev,
+                                                    rebuild_mbytes_per_sec=args.rebuild_mbytes_per_sec))
+    p = subparsers.add_parser('bdev_raid_add_base_bdev',
+                              help='Add a replacement base bdev to a degraded raid bdev and rebuild it')
+    p.add_argument('name', help='raid bdev name')
+    p.add_argument('base_bdev', help='base bdev name')
+    p.add_argument('-r', '--rebuild-mbytes-per-sec', help='rebuild rate limit in MiB/s, 0 means unlimited',
+                   type=int)
+    p.set_defaults(func=bdev_raid_add_base_bdev)
+
     # split
     def bdev_split_create(args):
         print_array(rpc.bdev.bdev_split_create(args.client,
@@ -1777,7 +1893,8 @@ Format: 'user:u1 secret:s1 muser:mu1 msecret:ms1,user:u2 secret:s2 muser:mu2 mse
                                        serial_number=args.serial_number,
                                        model_number=args.model_number,
                                        allow_any_host=args.allow_any_host,
-                                       max_namespaces=args.max_namespaces)
+                                       max_namespaces=args.max_namespaces,
+                                       ana_reporting=args.ana_reporting)
 
     p = subparsers.add_parser('nvmf_create_subsystem', aliases=['nvmf_subsystem_create'],
                               help='Create an NVMe-oF subsystem')
@@ -1792,6 +1909,7 @@ Format: 'user:u1 secret:s1 muser:mu1 msecret:ms1,user:u2 secret:s2 muser:mu2 mse
     p.add_argument("-a", "--allow-any-host", action='store_true', help="Allow any host to connect (don't enforce host NQN whitelist)")
     p.add_argument("-m", "--max-namespaces", help="Maximum number of namespaces allowed",
                    type=int, default=0)
+    p.add_argument("-r", "--ana-reporting", action='store_true', help="Enable ANA reporting feature")
     p.set_defaults(func=nvmf_create_subsystem)
 
     def nvmf_delete_subsystem(args):
@@ -1842,6 +1960,26 @@ Format: 'user:u1 secret:s1 muser:mu1 msecret:ms1,user:u2 secret:s2 muser:mu2 mse
     p.add_argument('-s', '--trsvcid', help='NVMe-oF transport service id: e.g., a port number')
     p.set_defaults(func=nvmf_subsystem_remove_listener)
 
+    def nvmf_subsystem_listener_set_ana_state(args):
+        rpc.nvmf.nvmf_subsystem_listener_set_ana_state(args.client,
+                                                       nqn=args.nqn,
+                                                       ana_state=args.ana_state,
+                                                       trtype=args.trtype,
+                                                       traddr=args.traddr,
+                                                       tgt_name=args.tgt_name,
+                                                       adrfam=args.adrfam,
+                                                       trsvcid=args.trsvcid)
+
+    p = subparsers.add_parser('nvmf_subsystem_listener_set_ana_state', help='Set ANA state of a listener for an NVMe-oF subsystem')
+    p.add_argument('nqn', help='NVMe-oF subsystem NQN')
+    p.add_argument('-n', '--ana-state', help='ANA state to set: optimized, non_optimized, or inaccessible', required=True)
+    p.add_argument('-t', '--trtype', help='NVMe-oF transport type: e.g., rdma', required=True)
+    p.add_argument('-a', '--traddr', help='NVMe-oF transport address: e.g., an ip address', required=True)
+    p.add_argument('-p', '--tgt_name', help='The name of the parent NVMe-oF target (optional)', type=str)
+    p.add_argument('-f', '--adrfam', help='NVMe-oF transport adrfam: e.g., ipv4, ipv6, ib, fc, intra_host')
+    p.add_argument('-s', '--trsvcid', help='NVMe-oF transport service id: e.g., a port number')
+    p.set_defaults(func=nvmf_subsystem_listener_set_ana_state)
+
     def nvmf_subsystem_add_ns(args):
         rpc.nvmf.nvmf_subsystem_add_ns(args.client,
                                        nqn=args.nqn,
@@ -37,6 +37,30 @@ def framework_get_reactors(client):
     return client.call('framework_get_reactors')
 
 
+def framework_set_scheduler(client, name, period=None):
+    """Select thread scheduler that will be activated and its period.
+
+    Args:
+        name: Name of a scheduler
+        period: Scheduler period in microseconds (optional)
+    Returns:
+        True or False
+    """
+    params = {'name': name}
+    if period is not None:
+        params['period'] = period
+    return client.call('framework_set_scheduler', params)
+
+
+def framework_get_scheduler(client):
+    """Query currently set scheduler and its period.
+
+    Returns:
+        Name and period of the current scheduler.
+    """
+    return client.call('framework_get_scheduler')
+
+
 def thread_get_stats(client):
     """Query threads statistics.
 
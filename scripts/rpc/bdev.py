@@ -2,13 +2,19 @@ from .helpers import deprecated_alias
 
 
 @deprecated_alias('set_bdev_options')
-def bdev_set_options(client, bdev_io_pool_size=None, bdev_io_cache_size=None, bdev_auto_examine=None):
+def bdev_set_options(client, bdev_io_pool_size=None, bdev_io_cache_size=None, bdev_auto_examine=None,
+                     small_buf_pool_size=None, large_buf_pool_size=None,
+                     small_buf_cache_size=None, large_buf_cache_size=None):
     """Set parameters for the bdev subsystem.
 
     Args:
         bdev_io_pool_size: number of bdev_io structures in shared buffer pool (optional)
         bdev_io_cache_size: maximum number of bdev_io structures cached per thread (optional)
         bdev_auto_examine: if set to false, the bdev layer will not examine every disks automatically (optional)
+        small_buf_pool_size: number of small data buffers in the shared pool (optional)
+        large_buf_pool_size: number of large data buffers in the shared pool (optional)
+        small_buf_cache_size: maximum number of small data buffers cached per thread (optional)
+        large_buf_cache_size: maximum number of large data buffers cached per thread (optional)
     """
     params = {}
 
@@ -18,6 +24,14 @@ def bdev_set_options(client, bdev_io_pool_size=None, bdev_io_cache_size=None, bd
         params['bdev_io_cache_size'] = bdev_io_cache_size
     if bdev_auto_examine is not None:
         params["bdev_auto_examine"] = bdev_auto_examine
+    if small_buf_pool_size is not None:
+        params['small_buf_pool_size'] = small_buf_pool_size
+    if large_buf_pool_size is not None:
+        params['large_buf_pool_size'] = large_buf_pool_size
+    if small_buf_cache_size is not None:
+        params['small_buf_cache_size'] = small_buf_cache_size
+    if large_buf_cache_size is not None:
+        params['large_buf_cache_size'] = large_buf_cache_size
 
     return client.call('bdev_set_options', params)
 
@@ -252,7 +266,7 @@ def bdev_raid_get_bdevs(client, category):
         category: any one of all or online or configuring or offline
 
     Returns:
-        List of raid bdev names
+        List of raid bdev objects
     """
     params = {'category': category}
     return client.call('bdev_raid_get_bdevs', params)
@@ -266,7 +280,7 @@ def bdev_raid_create(client, name, raid_level, base_bdevs, strip_size=None, stri
         name: user defined raid bdev name
         strip_size (deprecated): strip size of raid bdev in KB, supported values like 8, 16, 32, 64, 128, 256, etc
         strip_size_kb: strip size of raid bdev in KB, supported values like 8, 16, 32, 64, 128, 256, etc
-        raid_level: raid level of raid bdev, supported values 0
+        raid_level: raid level of raid bdev, supported values 0, 1, 5 and 10
         base_bdevs: Space separated names of Nvme bdevs in double quotes, like "Nvme0n1 Nvme1n1 Nvme2n1"
 
     Returns:
@@ -297,6 +311,25 @@ def bdev_raid_delete(client, name):
     return client.call('bdev_raid_delete', params)
 
 
+def bdev_raid_add_base_bdev(client, name, base_bdev, rebuild_mbytes_per_sec=None):
+    """Add a replacement base bdev to a degraded raid bdev and start rebuilding it
+
+    Args:
+        name: raid bdev name
+        base_bdev: name of the base bdev to add
+        rebuild_mbytes_per_sec: rebuild rate limit in MiB/s, 0 means unlimited (optional)
+
+    Returns:
+        True or False
+    """
+    params = {'name': name, 'base_bdev': base_bdev}
+
+    if rebuild_mbytes_per_sec is not None:
+        params['rebuild_mbytes_per_sec'] = rebuild_mbytes_per_sec
+
+    return client.call('bdev_raid_add_base_bdev', params)
+
+
 @deprecated_alias('construct_aio_bdev')
 def bdev_aio_create(client, filename, name, block_size=None):
     """Construct a Linux AIO block device.
@@ -437,7 +470,7 @@ def bdev_nvme_set_hotplug(client, enable, period_us=None):
 @deprecated_alias('construct_nvme_bdev')
 def bdev_nvme_attach_controller(client, name, trtype, traddr, adrfam=None, trsvcid=None,
                                 priority=None, subnqn=None, hostnqn=None, hostaddr=None,
-                                hostsvcid=None, prchk_reftag=None, prchk_guard=None):
+                                hostsvcid=None, prchk_reftag=None, prchk_guard=None, multipath=None):
     """Construct block device for each NVMe namespace in the attached controller.
 
     Args:
@@ -453,6 +486,7 @@ def bdev_nvme_attach_controller(client, name, trtype, traddr, adrfam=None, trsvc
         hostsvcid: host transport service ID (port number for IP-based transports, NULL for PCIe or FC; optional)
         prchk_reftag: Enable checking of PI reference tag for I/O processing (optional)
         prchk_guard: Enable checking of PI guard for I/O processing (optional)
+        multipath: Add the controller as another path to the existing controller with the same name (optional)
 
     Returns:
         Names of created block devices.
@@ -488,6 +522,9 @@ def bdev_nvme_attach_controller(client, name, trtype, traddr, adrfam=None, trsvc
     if prchk_guard:
         params['prchk_guard'] = prchk_guard
 
+    if multipath:
+        params['multipath'] = multipath
+
     return client.call('bdev_nvme_attach_controller', params)
 
 
@@ -503,6 +540,19 @@ def bdev_nvme_detach_controller(client, name):
     return client.call('bdev_nvme_detach_controller', params)
 
 
+def bdev_nvme_set_multipath_policy(client, name, policy):
+    """Set how I/O is spread over the paths of a multipath NVMe controller.
+
+    Args:
+        name: controller name
+        policy: I/O path selection policy: active_passive, round_robin or queue_depth
+    """
+
+    params = {'name': name,
+              'policy': policy}
+    return client.call('bdev_nvme_set_multipath_policy', params)
+
+
 def bdev_nvme_cuse_register(client, name):
     """Register CUSE devices on NVMe controller.
 
@@ -1025,6 +1075,17 @@ def bdev_get_histogram(client, name):
     return client.call('bdev_get_histogram', params)
 
 
+def bdev_get_histogram_by_type(client, name, io_type):
+    """Get histograms for one I/O type of specified bdev, split by I/O size.
+
+    Args:
+        name: name of bdev
+        io_type: one of "read", "write" or "unmap"
+    """
+    params = {'name': name, 'io_type': io_type}
+    return client.call('bdev_get_histogram_by_type', params)
+
+
 @deprecated_alias('bdev_inject_error')
 def bdev_error_inject_error(client, name, io_type, error_type, num=1):
     """Inject an error via an error bdev.
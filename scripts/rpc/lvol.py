@@ -186,6 +186,81 @@ def bdev_lvol_decouple_parent(client, name):
     return client.call('bdev_lvol_decouple_parent', params)
 
 
+def bdev_lvol_flatten(client, name, max_mbytes_per_sec=None):
+    """Copy data from all snapshots of a logical volume and remove its dependency on them.
+
+    Args:
+        name: name of logical volume to flatten
+        max_mbytes_per_sec: maximum rate of copying data in MiB/s (optional)
+    """
+    params = {
+        'name': name,
+    }
+    if max_mbytes_per_sec:
+        params['max_mbytes_per_sec'] = max_mbytes_per_sec
+    return client.call('bdev_lvol_flatten', params)
+
+
+def bdev_lvol_shallow_copy(client, name, dst_bdev_name, base_snapshot=None, queue_depth=None):
+    """Copy clusters of a read only logical volume that differ from a base snapshot to another bdev.
+
+    Args:
+        name: name of read only logical volume to copy
+        dst_bdev_name: name of bdev to copy data to
+        base_snapshot: name of snapshot in the chain of the logical volume to compare with (optional)
+        queue_depth: number of chunks copied in parallel (optional)
+    """
+    params = {
+        'name': name,
+        'dst_bdev_name': dst_bdev_name,
+    }
+    if base_snapshot:
+        params['base_snapshot'] = base_snapshot
+    if queue_depth:
+        params['queue_depth'] = queue_depth
+    return client.call('bdev_lvol_shallow_copy', params)
+
+
+def bdev_lvol_migrate(client, name, uuid=None, lvs_name=None, queue_depth=None):
+    """Move a logical volume to another logical volume store while it stays online.
+
+    Args:
+        name: name of logical volume to move
+        uuid: UUID of destination logical volume store (optional)
+        lvs_name: name of destination logical volume store (optional)
+        queue_depth: number of chunks copied in parallel (optional)
+
+    Either uuid or lvs_name must be specified, but not both.
+    """
+    if (uuid and lvs_name) or (not uuid and not lvs_name):
+        raise ValueError("Either uuid or lvs_name must be specified, but not both")
+
+    params = {'name': name}
+    if uuid:
+        params['uuid'] = uuid
+    if lvs_name:
+        params['lvs_name'] = lvs_name
+    if queue_depth:
+        params['queue_depth'] = queue_depth
+    return client.call('bdev_lvol_migrate', params)
+
+
+def bdev_lvol_get_heatmap(client, name, reset=None):
+    """Get sampled per cluster read and write counts of a logical volume.
+
+    Args:
+        name: name of logical volume
+        reset: clear the counters after reading them (optional)
+
+    Returns:
+        Sample rate, cluster size and counts of clusters that were accessed.
+    """
+    params = {'name': name}
+    if reset:
+        params['reset'] = reset
+    return client.call('bdev_lvol_get_heatmap', params)
+
+
 @deprecated_alias('destroy_lvol_store')
 def bdev_lvol_delete_lvstore(client, uuid=None, lvs_name=None):
     """Destroy a logical volume store.
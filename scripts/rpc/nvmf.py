@@ -221,7 +221,8 @@ def nvmf_create_subsystem(client,
                           tgt_name=None,
                           model_number='SPDK bdev Controller',
                           allow_any_host=False,
-                          max_namespaces=0):
+                          max_namespaces=0,
+                          ana_reporting=False):
     """Construct an NVMe over Fabrics target subsystem.
 
     Args:
@@ -231,6 +232,7 @@ def nvmf_create_subsystem(client,
         model_number: Model number of virtual controller.
         allow_any_host: Allow any host (True) or enforce allowed host whitelist (False). Default: False.
         max_namespaces: Maximum number of namespaces that can be attached to the subsystem (optional). Default: 0 (Unlimited).
+        ana_reporting: Report ANA state to hosts (True) or not (False). Default: False.
 
     Returns:
         True or False
@@ -251,6 +253,9 @@ def nvmf_create_subsystem(client,
     if max_namespaces:
         params['max_namespaces'] = max_namespaces
 
+    if ana_reporting:
+        params['ana_reporting'] = True
+
     if tgt_name:
         params['tgt_name'] = tgt_name
 
@@ -324,6 +329,46 @@ def nvmf_subsystem_remove_listener(
     return client.call('nvmf_subsystem_remove_listener', params)
 
 
+def nvmf_subsystem_listener_set_ana_state(
+        client,
+        nqn,
+        ana_state,
+        trtype,
+        traddr,
+        trsvcid,
+        adrfam,
+        tgt_name=None):
+    """Set ANA state of a listener for an NVMe-oF subsystem.
+
+    Args:
+        nqn: Subsystem NQN.
+        ana_state: ANA state to set ("optimized", "non_optimized", or "inaccessible").
+        trtype: Transport type ("RDMA").
+        traddr: Transport address.
+        trsvcid: Transport service ID.
+        tgt_name: name of the parent NVMe-oF target (optional).
+        adrfam: Address family ("IPv4", "IPv6", "IB", or "FC").
+
+    Returns:
+            True or False
+    """
+    listen_address = {'trtype': trtype,
+                      'traddr': traddr,
+                      'trsvcid': trsvcid}
+
+    if adrfam:
+        listen_address['adrfam'] = adrfam
+
+    params = {'nqn': nqn,
+              'listen_address': listen_address,
+              'ana_state': ana_state}
+
+    if tgt_name:
+        params['tgt_name'] = tgt_name
+
+    return client.call('nvmf_subsystem_listener_set_ana_state', params)
+
+
 def nvmf_subsystem_add_ns(client, nqn, bdev_name, tgt_name=None, ptpl_file=None, nsid=None, nguid=None, eui64=None, uuid=None):
     """Add a namespace to a subsystem.
 
@@ -84,7 +84,7 @@ function raid_function_test() {
 		waitforlisten $raid_pid $rpc_server
 
 		configure_raid_bdev
-		raid_bdev=$($rpc_py bdev_raid_get_bdevs online | cut -d ' ' -f 1)
+		raid_bdev=$($rpc_py bdev_raid_get_bdevs online | jq -r '.[0]["name"] | select(.)')
 		if [ $raid_bdev = "" ]; then
 			echo "No raid0 device in SPDK app"
 			return 1
@@ -112,8 +112,60 @@ function raid_function_test() {
 	return 0
 }
 
+function raid_rebuild_test() {
+	if [ $(uname -s) = Linux ] && modprobe -n nbd; then
+		local nbd=/dev/nbd0
+		local blksize=512
+		local rw_blk_num=32768
+		local rw_len=$((blksize * rw_blk_num))
+
+		modprobe nbd
+		$rootdir/test/app/bdev_svc/bdev_svc -r $rpc_server -i 0 -L bdev_raid &
+		raid_pid=$!
+		echo "Process raid pid: $raid_pid"
+		waitforlisten $raid_pid $rpc_server
+
+		$rpc_py bdev_malloc_create 32 $blksize -b Base_1
+		$rpc_py bdev_malloc_create 32 $blksize -b Base_2
+		$rpc_py bdev_raid_create -z 64 -r 1 -b "Base_1 Base_2" -n raid1
+
+		nbd_start_disks $rpc_server raid1 $nbd
+		dd if=/dev/urandom of=$tmp_file bs=$blksize count=$rw_blk_num
+		dd if=$tmp_file of=$nbd bs=$blksize count=$rw_blk_num oflag=direct
+		blockdev --flushbufs $nbd
+
+		# Fail one mirror and replace it with a new bdev
+		$rpc_py bdev_malloc_delete Base_2
+		$rpc_py bdev_malloc_create 32 $blksize -b Base_3
+		$rpc_py bdev_raid_add_base_bdev -r 8 raid1 Base_3
+
+		# The rebuild runs in the background, the raid bdev stays usable meanwhile
+		cmp -b -n $rw_len $tmp_file $nbd
+		for ((i = 0; i < 100; i++)); do
+			if [ "$($rpc_py bdev_raid_get_bdevs online | jq -r '.[0].rebuild')" = "null" ]; then
+				break
+			fi
+			sleep 0.1
+		done
+		[ "$($rpc_py bdev_raid_get_bdevs online | jq -r '.[0].rebuild')" = "null" ]
+
+		# Only the rebuilt bdev is left to serve the data
+		$rpc_py bdev_malloc_delete Base_1
+		blockdev --flushbufs $nbd
+		cmp -b -n $rw_len $tmp_file $nbd
+
+		nbd_stop_disks $rpc_server $nbd
+		killprocess $raid_pid
+	else
+		echo "skipping bdev raid rebuild tests."
+	fi
+
+	return 0
+}
+
 trap 'on_error_exit;' ERR
 
 raid_function_test
+raid_rebuild_test
 
 rm -f $tmp_file
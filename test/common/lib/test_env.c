@@ -366,6 +366,8 @@ spdk_mempool_get_bulk(struct spdk_mempool *mp, void **ele_arr, size_t count)
 	for (size_t i = 0; i < count; i++) {
 		ele_arr[i] = spdk_mempool_get(mp);
 		if (ele_arr[i] == NULL) {
+			/* Like DPDK, either get all elements or none of them */
+			spdk_mempool_put_bulk(mp, ele_arr, i);
 			return -1;
 		}
 	}
@@ -38,6 +38,9 @@ function app_repeat_test() {
 run_test "event_perf" $testdir/event_perf/event_perf -m 0xF -t 1
 run_test "event_reactor" $testdir/reactor/reactor -t 1
 run_test "event_reactor_perf" $testdir/reactor_perf/reactor_perf -t 1
+run_test "event_msg_perf" $testdir/msg_perf/msg_perf -m 0x3 -t 1
+run_test "event_msg_perf_batch" $testdir/msg_perf/msg_perf -m 0x3 -b 16 -t 1
+run_test "event_poller_churn" $testdir/poller_churn/poller_churn -t 1
 
 if [ $(uname -s) = Linux ] && modprobe -n nbd; then
 	run_test "app_repeat" app_repeat_test
@@ -0,0 +1,330 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "spdk/stdinc.h"
+
+#include "spdk/env.h"
+#include "spdk/event.h"
+#include "spdk/string.h"
+#include "spdk/thread.h"
+#include "spdk/util.h"
+
+/*
+ * Measures cross-core message throughput. One thread runs on every core and
+ * the threads form a ring. Each thread starts with queue depth messages and
+ * forwards every message it receives to the next thread in the ring, either
+ * one by one or in batches with spdk_thread_send_msg_batch().
+ */
+
+struct msg_perf_thread {
+	struct spdk_thread	*thread;
+	struct spdk_poller	*poller;
+	struct msg_perf_thread	*next;
+
+	/* Messages received by this thread */
+	uint64_t		count;
+
+	/* Messages waiting to be forwarded to the next thread */
+	uint32_t		pending;
+};
+
+static struct msg_perf_thread *g_threads;
+static uint32_t g_num_threads;
+static uint32_t g_threads_done;
+static struct spdk_thread *g_app_thread;
+static struct spdk_poller *g_test_end_poller;
+static bool g_stop;
+
+static int g_time_in_sec;
+static uint32_t g_queue_depth = 32;
+static uint32_t g_batch_size = 1;
+
+static void msg_perf_recv(void *ctx);
+
+static void
+msg_perf_flush(struct msg_perf_thread *t)
+{
+	void *ctxs[SPDK_THREAD_MSG_BATCH_MAX];
+	uint32_t i, count;
+	int rc;
+
+	while (t->pending > 0) {
+		count = spdk_min(t->pending, g_batch_size);
+		if (count == 1) {
+			rc = spdk_thread_send_msg(t->next->thread, msg_perf_recv, t->next);
+		} else {
+			for (i = 0; i < count; i++) {
+				ctxs[i] = t->next;
+			}
+			rc = spdk_thread_send_msg_batch(t->next->thread, msg_perf_recv, ctxs, count);
+		}
+
+		if (rc != 0) {
+			/* The poller tries again. */
+			break;
+		}
+		t->pending -= count;
+	}
+}
+
+static void
+msg_perf_recv(void *ctx)
+{
+	struct msg_perf_thread *t = ctx;
+
+	t->count++;
+
+	if (__atomic_load_n(&g_stop, __ATOMIC_RELAXED)) {
+		return;
+	}
+
+	/* Partial batches are sent by the poller. */
+	if (++t->pending >= g_batch_size) {
+		msg_perf_flush(t);
+	}
+}
+
+static int
+msg_perf_poll(void *arg)
+{
+	struct msg_perf_thread *t = arg;
+
+	if (t->pending == 0 || __atomic_load_n(&g_stop, __ATOMIC_RELAXED)) {
+		return SPDK_POLLER_IDLE;
+	}
+
+	msg_perf_flush(t);
+
+	return SPDK_POLLER_BUSY;
+}
+
+static void
+msg_perf_thread_start(void *ctx)
+{
+	struct msg_perf_thread *t = ctx;
+
+	t->poller = SPDK_POLLER_REGISTER(msg_perf_poll, t, 0);
+	t->pending = g_queue_depth;
+	msg_perf_flush(t);
+}
+
+static void
+msg_perf_thread_done(void *ctx)
+{
+	if (++g_threads_done == g_num_threads) {
+		spdk_app_stop(0);
+	}
+}
+
+static void
+msg_perf_thread_stop(void *ctx)
+{
+	struct msg_perf_thread *t = ctx;
+
+	spdk_poller_unregister(&t->poller);
+	spdk_thread_exit(t->thread);
+
+	spdk_thread_send_msg(g_app_thread, msg_perf_thread_done, NULL);
+}
+
+static void
+msg_perf_stop_threads(void *ctx)
+{
+	uint32_t i;
+
+	/* Every thread has seen g_stop by now, so nothing is forwarded anymore. */
+	for (i = 0; i < g_num_threads; i++) {
+		spdk_thread_send_msg(g_threads[i].thread, msg_perf_thread_stop, &g_threads[i]);
+	}
+}
+
+static void
+msg_perf_nop(void *ctx)
+{
+}
+
+static int
+msg_perf_test_end(void *arg)
+{
+	spdk_poller_unregister(&g_test_end_poller);
+
+	__atomic_store_n(&g_stop, true, __ATOMIC_SEQ_CST);
+	spdk_for_each_thread(msg_perf_nop, NULL, msg_perf_stop_threads);
+
+	return SPDK_POLLER_BUSY;
+}
+
+static void
+msg_perf_start(void *arg1)
+{
+	struct spdk_cpuset cpumask;
+	char thread_name[32];
+	uint32_t i, core;
+
+	g_app_thread = spdk_get_thread();
+	g_num_threads = spdk_env_get_core_count();
+	g_threads = calloc(g_num_threads, sizeof(*g_threads));
+	if (g_threads == NULL) {
+		fprintf(stderr, "Unable to allocate threads\n");
+		spdk_app_stop(1);
+		return;
+	}
+
+	i = 0;
+	SPDK_ENV_FOREACH_CORE(core) {
+		snprintf(thread_name, sizeof(thread_name), "msg_perf_%u", core);
+		spdk_cpuset_zero(&cpumask);
+		spdk_cpuset_set_cpu(&cpumask, core, true);
+
+		g_threads[i].thread = spdk_thread_create(thread_name, &cpumask);
+		if (g_threads[i].thread == NULL) {
+			fprintf(stderr, "Unable to create thread on core %u\n", core);
+			/* The threads created so far are cleaned up by the framework. */
+			spdk_app_stop(1);
+			return;
+		}
+		i++;
+	}
+
+	for (i = 0; i < g_num_threads; i++) {
+		g_threads[i].next = &g_threads[(i + 1) % g_num_threads];
+	}
+
+	printf("Running %u threads with queue depth %u and batch size %u for %d seconds...\n",
+	       g_num_threads, g_queue_depth, g_batch_size, g_time_in_sec);
+	fflush(stdout);
+
+	g_test_end_poller = SPDK_POLLER_REGISTER(msg_perf_test_end, NULL,
+			    g_time_in_sec * 1000000ULL);
+
+	for (i = 0; i < g_num_threads; i++) {
+		spdk_thread_send_msg(g_threads[i].thread, msg_perf_thread_start, &g_threads[i]);
+	}
+}
+
+static void
+performance_dump(void)
+{
+	uint64_t total = 0;
+	uint32_t i;
+
+	if (g_threads == NULL) {
+		return;
+	}
+
+	for (i = 0; i < g_num_threads; i++) {
+		printf("thread %2u: %12ju messages per second\n", i, g_threads[i].count / g_time_in_sec);
+		total += g_threads[i].count;
+	}
+	printf("Performance: %12ju messages per second\n", total / g_time_in_sec);
+
+	free(g_threads);
+}
+
+static void
+usage(const char *program_name)
+{
+	printf("%s options\n", program_name);
+	printf("\t[-m core mask, one thread is created on each core (default: 0x1)]\n");
+	printf("\t[-q messages in flight per thread (default: 32)]\n");
+	printf("\t[-b messages sent at once, 1 to %d (default: 1)]\n", SPDK_THREAD_MSG_BATCH_MAX);
+	printf("\t[-t time in seconds]\n");
+}
+
+int
+main(int argc, char **argv)
+{
+	struct spdk_app_opts opts;
+	int op;
+	int rc;
+	long int val;
+
+	spdk_app_opts_init(&opts);
+	opts.name = "msg_perf";
+
+	while ((op = getopt(argc, argv, "b:m:q:t:")) != -1) {
+		if (op == 'm') {
+			opts.reactor_mask = optarg;
+			continue;
+		}
+
+		if (op == '?') {
+			usage(argv[0]);
+			exit(1);
+		}
+
+		val = spdk_strtol(optarg, 10);
+		if (val < 0) {
+			fprintf(stderr, "Converting a string to integer failed\n");
+			exit(1);
+		}
+
+		switch (op) {
+		case 'b':
+			if (val == 0 || val > SPDK_THREAD_MSG_BATCH_MAX) {
+				fprintf(stderr, "Batch size must be between 1 and %d\n", SPDK_THREAD_MSG_BATCH_MAX);
+				exit(1);
+			}
+			g_batch_size = val;
+			break;
+		case 'q':
+			if (val == 0) {
+				fprintf(stderr, "Queue depth must be at least 1\n");
+				exit(1);
+			}
+			g_queue_depth = val;
+			break;
+		case 't':
+			g_time_in_sec = val;
+			break;
+		default:
+			usage(argv[0]);
+			exit(1);
+		}
+	}
+
+	if (!g_time_in_sec) {
+		usage(argv[0]);
+		exit(1);
+	}
+
+	rc = spdk_app_start(&opts, msg_perf_start, NULL);
+
+	spdk_app_fini();
+
+	if (rc == 0) {
+		performance_dump();
+	}
+
+	return rc;
+}
@@ -0,0 +1,232 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "spdk/stdinc.h"
+
+#include "spdk/env.h"
+#include "spdk/event.h"
+#include "spdk/string.h"
+#include "spdk/thread.h"
+
+/*
+ * Measures the cost of timed poller bookkeeping. A set of timed pollers with
+ * varied periods is kept registered on the app thread while an active poller
+ * keeps unregistering random timed pollers and registering them again, the
+ * way short-lived timeouts are armed and cancelled on an I/O path.
+ */
+
+struct churn_poller {
+	struct spdk_poller	*poller;
+	uint64_t		period_us;
+};
+
+static struct churn_poller *g_pollers;
+static struct spdk_poller *g_churn_poller;
+static struct spdk_poller *g_test_end_poller;
+
+static int g_time_in_sec;
+static uint32_t g_num_pollers = 10000;
+static uint32_t g_churn_batch = 16;
+static uint64_t g_max_period_us = 100000;
+
+static uint64_t g_churn_count;
+static uint64_t g_expire_count;
+static unsigned int g_seed;
+
+static int
+churn_timed_poll(void *arg)
+{
+	g_expire_count++;
+
+	return SPDK_POLLER_BUSY;
+}
+
+static int
+churn_poll(void *arg)
+{
+	struct churn_poller *p;
+	uint32_t i;
+
+	for (i = 0; i < g_churn_batch; i++) {
+		p = &g_pollers[rand_r(&g_seed) % g_num_pollers];
+
+		spdk_poller_unregister(&p->poller);
+		p->poller = SPDK_POLLER_REGISTER(churn_timed_poll, p, p->period_us);
+		if (p->poller == NULL) {
+			fprintf(stderr, "Unable to register poller\n");
+			spdk_app_stop(1);
+			return SPDK_POLLER_IDLE;
+		}
+	}
+
+	g_churn_count += g_churn_batch;
+
+	return SPDK_POLLER_BUSY;
+}
+
+static int
+churn_test_end(void *arg)
+{
+	uint32_t i;
+
+	spdk_poller_unregister(&g_test_end_poller);
+	spdk_poller_unregister(&g_churn_poller);
+
+	for (i = 0; i < g_num_pollers; i++) {
+		spdk_poller_unregister(&g_pollers[i].poller);
+	}
+
+	spdk_app_stop(0);
+
+	return SPDK_POLLER_BUSY;
+}
+
+static void
+churn_start(void *arg1)
+{
+	uint32_t i;
+
+	g_pollers = calloc(g_num_pollers, sizeof(*g_pollers));
+	if (g_pollers == NULL) {
+		fprintf(stderr, "Unable to allocate pollers\n");
+		spdk_app_stop(1);
+		return;
+	}
+
+	g_seed = (unsigned int)spdk_get_ticks();
+
+	for (i = 0; i < g_num_pollers; i++) {
+		g_pollers[i].period_us = 1 + rand_r(&g_seed) % g_max_period_us;
+		g_pollers[i].poller = SPDK_POLLER_REGISTER(churn_timed_poll, &g_pollers[i],
+				      g_pollers[i].period_us);
+		if (g_pollers[i].poller == NULL) {
+			fprintf(stderr, "Unable to register poller\n");
+			churn_test_end(NULL);
+			spdk_app_stop(1);
+			return;
+		}
+	}
+
+	printf("Running %u timed pollers, churning %u per iteration for %d seconds...\n",
+	       g_num_pollers, g_churn_batch, g_time_in_sec);
+	fflush(stdout);
+
+	g_churn_poller = SPDK_POLLER_REGISTER(churn_poll, NULL, 0);
+	g_test_end_poller = SPDK_POLLER_REGISTER(churn_test_end, NULL,
+			    g_time_in_sec * 1000000ULL);
+}
+
+static void
+performance_dump(void)
+{
+	printf("Churn:       %12ju re-registrations per second\n", g_churn_count / g_time_in_sec);
+	printf("Expirations: %12ju timed poller runs per second\n", g_expire_count / g_time_in_sec);
+
+	free(g_pollers);
+}
+
+static void
+usage(const char *program_name)
+{
+	printf("%s options\n", program_name);
+	printf("\t[-n number of timed pollers (default: 10000)]\n");
+	printf("\t[-b pollers re-registered per churn iteration (default: 16)]\n");
+	printf("\t[-p maximum timed poller period in microseconds (default: 100000)]\n");
+	printf("\t[-t time in seconds]\n");
+}
+
+int
+main(int argc, char **argv)
+{
+	struct spdk_app_opts opts;
+	int op;
+	int rc;
+	long int val;
+
+	spdk_app_opts_init(&opts);
+	opts.name = "poller_churn";
+
+	while ((op = getopt(argc, argv, "b:n:p:t:")) != -1) {
+		if (op == '?') {
+			usage(argv[0]);
+			exit(1);
+		}
+
+		val = spdk_strtol(optarg, 10);
+		if (val < 0) {
+			fprintf(stderr, "Converting a string to integer failed\n");
+			exit(1);
+		}
+
+		switch (op) {
+		case 'b':
+			g_churn_batch = val;
+			break;
+		case 'n':
+			if (val == 0) {
+				fprintf(stderr, "At least one timed poller is required\n");
+				exit(1);
+			}
+			g_num_pollers = val;
+			break;
+		case 'p':
+			if (val == 0) {
+				fprintf(stderr, "Maximum period must be at least 1 microsecond\n");
+				exit(1);
+			}
+			g_max_period_us = val;
+			break;
+		case 't':
+			g_time_in_sec = val;
+			break;
+		default:
+			usage(argv[0]);
+			exit(1);
+		}
+	}
+
+	if (!g_time_in_sec) {
+		usage(argv[0]);
+		exit(1);
+	}
+
+	rc = spdk_app_start(&opts, churn_start, NULL);
+
+	spdk_app_fini();
+
+	if (rc == 0) {
+		performance_dump();
+	}
+
+	return rc;
+}
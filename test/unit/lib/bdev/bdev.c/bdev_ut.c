@@ -67,6 +67,7 @@ int g_count;
 enum spdk_bdev_event_type g_event_type1;
 enum spdk_bdev_event_type g_event_type2;
 struct spdk_histogram_data *g_histogram;
+struct spdk_histogram_data **g_histograms;
 void *g_unregister_arg;
 int g_unregister_rc;
 
@@ -254,6 +255,23 @@ stub_submit_request_get_buf(struct spdk_io_channel *_ch, struct spdk_bdev_io *bd
 			     bdev_io->u.bdev.num_blocks * bdev_io->bdev->blocklen);
 }
 
+static uint32_t g_batch_calls;
+static int g_batch_num_ios;
+
+static void
+stub_submit_request_batch(struct spdk_io_channel *_ch, struct spdk_bdev_io **bdev_ios, int num_ios)
+{
+	int i;
+
+	g_batch_calls++;
+	g_batch_num_ios = num_ios;
+
+	for (i = 0; i < num_ios; i++) {
+		CU_ASSERT(bdev_ios[i]->internal.in_submit_request == true);
+		stub_submit_request(_ch, bdev_ios[i]);
+	}
+}
+
 static uint32_t
 stub_complete_io(uint32_t num_to_complete)
 {
@@ -1789,6 +1807,312 @@ bdev_io_split_with_io_wait(void)
 	poll_threads();
 }
 
+static void
+bdev_io_batch(void)
+{
+	struct spdk_bdev *bdev;
+	struct spdk_bdev_desc *desc = NULL;
+	struct spdk_io_channel *io_ch;
+	struct spdk_bdev_opts bdev_opts = {
+		.bdev_io_pool_size = 64,
+		.bdev_io_cache_size = 8,
+	};
+	int i, rc;
+
+	rc = spdk_bdev_set_opts(&bdev_opts);
+	CU_ASSERT(rc == 0);
+	spdk_bdev_initialize(bdev_init_cb, NULL);
+
+	bdev = allocate_bdev("bdev0");
+
+	rc = spdk_bdev_open(bdev, true, NULL, NULL, &desc);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(desc != NULL);
+	io_ch = spdk_bdev_get_io_channel(desc);
+	CU_ASSERT(io_ch != NULL);
+
+	/* Without submit_request_batch the held I/O is submitted one by one on flush */
+	spdk_bdev_io_batch_start(io_ch);
+	for (i = 0; i < 3; i++) {
+		rc = spdk_bdev_read_blocks(desc, io_ch, (void *)0xF000, i, 1, io_done, NULL);
+		CU_ASSERT(rc == 0);
+	}
+	CU_ASSERT(g_bdev_ut_channel->outstanding_io_count == 0);
+
+	spdk_bdev_io_batch_flush(io_ch);
+	CU_ASSERT(g_bdev_ut_channel->outstanding_io_count == 3);
+	CU_ASSERT(stub_complete_io(3) == 3);
+
+	/* With submit_request_batch the module gets the whole batch in one call */
+	fn_table.submit_request_batch = stub_submit_request_batch;
+	g_batch_calls = 0;
+
+	spdk_bdev_io_batch_start(io_ch);
+	for (i = 0; i < 3; i++) {
+		rc = spdk_bdev_write_blocks(desc, io_ch, (void *)0xF000, i, 1, io_done, NULL);
+		CU_ASSERT(rc == 0);
+	}
+	CU_ASSERT(g_bdev_ut_channel->outstanding_io_count == 0);
+	CU_ASSERT(g_batch_calls == 0);
+
+	spdk_bdev_io_batch_flush(io_ch);
+	CU_ASSERT(g_batch_calls == 1);
+	CU_ASSERT(g_batch_num_ios == 3);
+	CU_ASSERT(g_bdev_ut_channel->outstanding_io_count == 3);
+	CU_ASSERT(stub_complete_io(3) == 3);
+
+	/* A full batch is flushed right away */
+	g_batch_calls = 0;
+	spdk_bdev_io_batch_start(io_ch);
+	for (i = 0; i < SPDK_BDEV_IO_BATCH_SIZE + 1; i++) {
+		rc = spdk_bdev_read_blocks(desc, io_ch, (void *)0xF000, i, 1, io_done, NULL);
+		CU_ASSERT(rc == 0);
+	}
+	CU_ASSERT(g_batch_calls == 1);
+	CU_ASSERT(g_batch_num_ios == SPDK_BDEV_IO_BATCH_SIZE);
+	CU_ASSERT(g_bdev_ut_channel->outstanding_io_count == SPDK_BDEV_IO_BATCH_SIZE);
+
+	spdk_bdev_io_batch_flush(io_ch);
+	CU_ASSERT(g_batch_calls == 2);
+	CU_ASSERT(g_batch_num_ios == 1);
+	CU_ASSERT(stub_complete_io(SPDK_BDEV_IO_BATCH_SIZE + 1) == SPDK_BDEV_IO_BATCH_SIZE + 1);
+
+	/* Flushing an empty batch doesn't call the module */
+	g_batch_calls = 0;
+	spdk_bdev_io_batch_start(io_ch);
+	spdk_bdev_io_batch_flush(io_ch);
+	CU_ASSERT(g_batch_calls == 0);
+
+	/* Children of a split I/O are submitted as one batch */
+	bdev->optimal_io_boundary = 16;
+	bdev->split_on_optimal_io_boundary = true;
+
+	g_io_done = false;
+	rc = spdk_bdev_write_blocks(desc, io_ch, (void *)0xF000, 0, 64, io_done, NULL);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_batch_calls == 1);
+	CU_ASSERT(g_batch_num_ios == 4);
+	CU_ASSERT(stub_complete_io(4) == 4);
+	CU_ASSERT(g_io_done == true);
+
+	fn_table.submit_request_batch = NULL;
+
+	/* A batch still held when the channel is destroyed is aborted */
+	spdk_bdev_io_batch_start(io_ch);
+	for (i = 0; i < 2; i++) {
+		rc = spdk_bdev_read_blocks(desc, io_ch, (void *)0xF000, i, 1, io_done, NULL);
+		CU_ASSERT(rc == 0);
+	}
+	g_io_done = false;
+	spdk_put_io_channel(io_ch);
+	poll_threads();
+	CU_ASSERT(g_io_done == true);
+	CU_ASSERT(g_io_status == SPDK_BDEV_IO_STATUS_ABORTED);
+
+	spdk_bdev_close(desc);
+	free_bdev(bdev);
+	spdk_bdev_finish(bdev_fini_cb, NULL);
+	poll_threads();
+}
+
+static void
+bdev_buf_cache(void)
+{
+	struct spdk_bdev *bdev;
+	struct spdk_bdev_desc *desc = NULL;
+	struct spdk_io_channel *io_ch;
+	struct spdk_bdev_channel *channel;
+	struct spdk_bdev_mgmt_channel *mgmt_ch;
+	struct spdk_bdev_opts bdev_opts = {
+		.bdev_io_pool_size = 64,
+		.bdev_io_cache_size = 8,
+		.small_buf_pool_size = 16,
+		.small_buf_cache_size = 16,
+	};
+	void *bufs[16];
+	int i, rc;
+
+	/* Zeroed data buffer options keep their defaults */
+	rc = spdk_bdev_set_opts(&bdev_opts);
+	CU_ASSERT(rc == 0);
+	spdk_bdev_get_opts(&bdev_opts);
+	CU_ASSERT(bdev_opts.large_buf_pool_size == 1023);
+	CU_ASSERT(bdev_opts.large_buf_cache_size == 16);
+	spdk_bdev_initialize(bdev_init_cb, NULL);
+
+	fn_table.submit_request = stub_submit_request_get_buf;
+	bdev = allocate_bdev("bdev0");
+
+	rc = spdk_bdev_open(bdev, true, NULL, NULL, &desc);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(desc != NULL);
+	io_ch = spdk_bdev_get_io_channel(desc);
+	CU_ASSERT(io_ch != NULL);
+	channel = spdk_io_channel_get_ctx(io_ch);
+	mgmt_ch = channel->shared_resource->mgmt_ch;
+
+	/*
+	 * The mempool's per core cache takes half of the pool, and the thread caches are
+	 *  capped to half of the rest.
+	 */
+	CU_ASSERT(mgmt_ch->buf_small_cache.size == 4);
+	CU_ASSERT(mgmt_ch->buf_small_cache.count == 0);
+	CU_ASSERT(spdk_mempool_count(g_bdev_mgr.buf_small_pool) == 16);
+
+	/* The first buffer refills the whole cache from the pool at once */
+	rc = spdk_bdev_read_blocks(desc, io_ch, NULL, 0, 1, io_done, NULL);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(mgmt_ch->buf_small_cache.count == 3);
+	CU_ASSERT(spdk_mempool_count(g_bdev_mgr.buf_small_pool) == 12);
+
+	/* Freed buffers go back to the cache */
+	CU_ASSERT(stub_complete_io(1) == 1);
+	CU_ASSERT(mgmt_ch->buf_small_cache.count == 4);
+	CU_ASSERT(spdk_mempool_count(g_bdev_mgr.buf_small_pool) == 12);
+
+	/* Once the cache is empty it is refilled again */
+	for (i = 0; i < 5; i++) {
+		rc = spdk_bdev_read_blocks(desc, io_ch, NULL, i, 1, io_done, NULL);
+		CU_ASSERT(rc == 0);
+	}
+	CU_ASSERT(mgmt_ch->buf_small_cache.count == 3);
+	CU_ASSERT(spdk_mempool_count(g_bdev_mgr.buf_small_pool) == 8);
+
+	/* An overfull cache returns buffers to the pool until it is half full */
+	CU_ASSERT(stub_complete_io(2) == 2);
+	CU_ASSERT(mgmt_ch->buf_small_cache.count == 2);
+	CU_ASSERT(spdk_mempool_count(g_bdev_mgr.buf_small_pool) == 11);
+
+	CU_ASSERT(stub_complete_io(3) == 3);
+	CU_ASSERT(mgmt_ch->buf_small_cache.count == 2);
+	CU_ASSERT(spdk_mempool_count(g_bdev_mgr.buf_small_pool) == 14);
+
+	/* Buffers aren't cached while another thread waits for one */
+	g_bdev_mgr.buf_small_waiting_threads++;
+	rc = spdk_bdev_read_blocks(desc, io_ch, NULL, 0, 1, io_done, NULL);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(mgmt_ch->buf_small_cache.count == 1);
+	CU_ASSERT(stub_complete_io(1) == 1);
+	CU_ASSERT(mgmt_ch->buf_small_cache.count == 0);
+	CU_ASSERT(spdk_mempool_count(g_bdev_mgr.buf_small_pool) == 16);
+	g_bdev_mgr.buf_small_waiting_threads--;
+
+	/* A bdev_io waiting for a buffer gets one freed to the pool by another thread */
+	for (i = 0; i < 16; i++) {
+		bufs[i] = spdk_mempool_get(g_bdev_mgr.buf_small_pool);
+		SPDK_CU_ASSERT_FATAL(bufs[i] != NULL);
+	}
+	rc = spdk_bdev_read_blocks(desc, io_ch, NULL, 0, 1, io_done, NULL);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(!STAILQ_EMPTY(&mgmt_ch->need_buf_small));
+	CU_ASSERT(g_bdev_mgr.buf_small_waiting_threads == 1);
+	CU_ASSERT(mgmt_ch->buf_retry_poller != NULL);
+	poll_threads();
+	CU_ASSERT(g_bdev_ut_channel->outstanding_io_count == 0);
+
+	spdk_mempool_put(g_bdev_mgr.buf_small_pool, bufs[0]);
+	poll_threads();
+	CU_ASSERT(STAILQ_EMPTY(&mgmt_ch->need_buf_small));
+	CU_ASSERT(g_bdev_ut_channel->outstanding_io_count == 1);
+	CU_ASSERT(g_bdev_mgr.buf_small_waiting_threads == 0);
+	CU_ASSERT(mgmt_ch->buf_retry_poller == NULL);
+
+	CU_ASSERT(stub_complete_io(1) == 1);
+	CU_ASSERT(mgmt_ch->buf_small_cache.count == 1);
+	spdk_mempool_put_bulk(g_bdev_mgr.buf_small_pool, &bufs[1], 15);
+
+	spdk_put_io_channel(io_ch);
+	spdk_bdev_close(desc);
+	free_bdev(bdev);
+	fn_table.submit_request = stub_submit_request;
+	spdk_bdev_finish(bdev_fini_cb, NULL);
+	poll_threads();
+
+	/*
+	 * Cached buffers went back to the pool with the mgmt channel, otherwise the pool
+	 *  count check in spdk_bdev_finish() would have failed.  Restore the defaults.
+	 */
+	bdev_opts.small_buf_pool_size = 0;
+	bdev_opts.small_buf_cache_size = 0;
+	rc = spdk_bdev_set_opts(&bdev_opts);
+	CU_ASSERT(rc == 0);
+	spdk_bdev_get_opts(&bdev_opts);
+	CU_ASSERT(bdev_opts.small_buf_pool_size == 8191);
+	CU_ASSERT(bdev_opts.small_buf_cache_size == 128);
+}
+
+static void
+bdev_io_split_batch(void)
+{
+	struct spdk_bdev *bdev;
+	struct spdk_bdev_desc *desc = NULL;
+	struct spdk_io_channel *io_ch;
+	struct spdk_bdev_channel *channel;
+	struct spdk_bdev_mgmt_channel *mgmt_ch;
+	struct spdk_bdev_opts bdev_opts = {
+		.bdev_io_pool_size = 20,
+		.bdev_io_cache_size = 4,
+	};
+	struct ut_expected_io *expected_io;
+	uint64_t i;
+	int rc;
+
+	rc = spdk_bdev_set_opts(&bdev_opts);
+	CU_ASSERT(rc == 0);
+	spdk_bdev_initialize(bdev_init_cb, NULL);
+
+	bdev = allocate_bdev("bdev0");
+
+	rc = spdk_bdev_open(bdev, true, NULL, NULL, &desc);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(desc != NULL);
+	io_ch = spdk_bdev_get_io_channel(desc);
+	CU_ASSERT(io_ch != NULL);
+	channel = spdk_io_channel_get_ctx(io_ch);
+	mgmt_ch = channel->shared_resource->mgmt_ch;
+
+	bdev->optimal_io_boundary = 16;
+	bdev->split_on_optimal_io_boundary = true;
+
+	/* Offset 0, length 512, payload 0xF000 splits into 32 children of 16 blocks */
+	for (i = 0; i < 32; i++) {
+		expected_io = ut_alloc_expected_io(SPDK_BDEV_IO_TYPE_WRITE, i * 16, 16, 1);
+		ut_expected_io_set_iov(expected_io, 0, (void *)(0xF000 + i * 16 * 512), 16 * 512);
+		TAILQ_INSERT_TAIL(&g_bdev_ut_channel->expected_io, expected_io, link);
+	}
+
+	/* The parent takes a bdev_io from the cache.  The first batch drains the remaining
+	 *  3 cached ones and cannot get the other 29 from the pool at once, so it takes the
+	 *  16 left in the pool one at a time.
+	 */
+	g_io_done = false;
+	rc = spdk_bdev_write_blocks(desc, io_ch, (void *)0xF000, 0, 512, io_done, NULL);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_bdev_ut_channel->outstanding_io_count == 19);
+	CU_ASSERT(mgmt_ch->per_thread_cache_count == 0);
+	CU_ASSERT(TAILQ_EMPTY(&mgmt_ch->io_wait_queue));
+
+	/* Completing the first batch submits the remaining 13 children at once */
+	CU_ASSERT(stub_complete_io(19) == 19);
+	CU_ASSERT(g_io_done == false);
+	CU_ASSERT(g_bdev_ut_channel->outstanding_io_count == 13);
+
+	CU_ASSERT(stub_complete_io(13) == 13);
+	CU_ASSERT(g_io_done == true);
+	CU_ASSERT(g_io_status == SPDK_BDEV_IO_STATUS_SUCCESS);
+	CU_ASSERT(g_bdev_ut_channel->outstanding_io_count == 0);
+	CU_ASSERT(TAILQ_EMPTY(&g_bdev_ut_channel->expected_io));
+
+	/* All bdev_ios went back to the cache and the pool */
+	CU_ASSERT(mgmt_ch->per_thread_cache_count == 4);
+
+	spdk_put_io_channel(io_ch);
+	spdk_bdev_close(desc);
+	free_bdev(bdev);
+	spdk_bdev_finish(bdev_fini_cb, NULL);
+	poll_threads();
+}
+
 static void
 bdev_io_alignment(void)
 {
@@ -2159,6 +2483,13 @@ histogram_data_cb(void *cb_arg, int status, struct spdk_histogram_data *histogra
 	g_histogram = histogram;
 }
 
+static void
+histogram_by_type_cb(void *cb_arg, int status, struct spdk_histogram_data **histograms)
+{
+	g_status = status;
+	g_histograms = histograms;
+}
+
 static void
 histogram_io_count(void *ctx, uint64_t start, uint64_t end, uint64_t count,
 		   uint64_t total, uint64_t so_far)
@@ -2173,7 +2504,9 @@ bdev_histograms(void)
 	struct spdk_bdev_desc *desc = NULL;
 	struct spdk_io_channel *ch;
 	struct spdk_histogram_data *histogram;
+	struct spdk_histogram_data *histograms[SPDK_BDEV_HISTOGRAM_SIZE_BUCKETS];
 	uint8_t buf[4096];
+	uint32_t i;
 	int rc;
 
 	spdk_bdev_initialize(bdev_init_cb, NULL);
@@ -2235,6 +2568,58 @@ bdev_histograms(void)
 	spdk_histogram_data_iterate(g_histogram, histogram_io_count, NULL);
 	CU_ASSERT(g_count == 2);
 
+	/* Check histograms by type and size */
+	for (i = 0; i < SPDK_BDEV_HISTOGRAM_SIZE_BUCKETS; i++) {
+		histograms[i] = spdk_histogram_data_alloc_sized(SPDK_BDEV_HISTOGRAM_BY_TYPE_BUCKET_SHIFT);
+		SPDK_CU_ASSERT_FATAL(histograms[i] != NULL);
+	}
+
+	/* 512 byte blocks, so 32 blocks go to the 16KiB bucket */
+	rc = spdk_bdev_write_blocks(desc, ch, buf, 0, 32, io_done, NULL);
+	CU_ASSERT(rc == 0);
+
+	spdk_delay_us(10);
+	stub_complete_io(1);
+	poll_threads();
+
+	/* 1024 blocks (512KiB) go to the last bucket */
+	rc = spdk_bdev_write_blocks(desc, ch, buf, 0, 1024, io_done, NULL);
+	CU_ASSERT(rc == 0);
+
+	spdk_delay_us(10);
+	stub_complete_io(1);
+	poll_threads();
+
+	g_histograms = NULL;
+	spdk_bdev_histogram_get_by_type(bdev, SPDK_BDEV_IO_TYPE_WRITE, histograms,
+					histogram_by_type_cb, NULL);
+	poll_threads();
+	CU_ASSERT(g_status == 0);
+	SPDK_CU_ASSERT_FATAL(g_histograms == histograms);
+
+	for (i = 0; i < SPDK_BDEV_HISTOGRAM_SIZE_BUCKETS; i++) {
+		g_count = 0;
+		spdk_histogram_data_iterate(histograms[i], histogram_io_count, NULL);
+		CU_ASSERT(g_count == (i == 0 || i == 2 || i == SPDK_BDEV_HISTOGRAM_SIZE_BUCKETS - 1 ? 1 : 0));
+		spdk_histogram_data_reset(histograms[i]);
+	}
+
+	spdk_bdev_histogram_get_by_type(bdev, SPDK_BDEV_IO_TYPE_READ, histograms,
+					histogram_by_type_cb, NULL);
+	poll_threads();
+	CU_ASSERT(g_status == 0);
+
+	for (i = 0; i < SPDK_BDEV_HISTOGRAM_SIZE_BUCKETS; i++) {
+		g_count = 0;
+		spdk_histogram_data_iterate(histograms[i], histogram_io_count, NULL);
+		CU_ASSERT(g_count == (i == 0 ? 1 : 0));
+	}
+
+	/* Only read, write and unmap are tracked */
+	spdk_bdev_histogram_get_by_type(bdev, SPDK_BDEV_IO_TYPE_FLUSH, histograms,
+					histogram_by_type_cb, NULL);
+	CU_ASSERT(g_status == -EINVAL);
+
 	/* Disable histogram */
 	spdk_bdev_histogram_enable(bdev, histogram_status_cb, NULL, false);
 	poll_threads();
@@ -2246,6 +2631,14 @@ bdev_histograms(void)
 	poll_threads();
 	CU_ASSERT(g_status == -EFAULT);
 
+	spdk_bdev_histogram_get_by_type(bdev, SPDK_BDEV_IO_TYPE_WRITE, histograms,
+					histogram_by_type_cb, NULL);
+	poll_threads();
+	CU_ASSERT(g_status == -EFAULT);
+
+	for (i = 0; i < SPDK_BDEV_HISTOGRAM_SIZE_BUCKETS; i++) {
+		spdk_histogram_data_free(histograms[i]);
+	}
 	spdk_histogram_data_free(histogram);
 	spdk_put_io_channel(ch);
 	spdk_bdev_close(desc);
@@ -2553,6 +2946,114 @@ bdev_write_zeroes(void)
 	poll_threads();
 }
 
+static void
+bdev_copy(void)
+{
+	struct spdk_bdev *bdev;
+	struct spdk_bdev_desc *desc = NULL;
+	struct spdk_io_channel *ioch;
+	struct ut_expected_io *expected_io;
+	struct spdk_bdev_io *read_io;
+	uint64_t num_io_blocks;
+	uint32_t num_completed;
+	int rc;
+
+	spdk_bdev_initialize(bdev_init_cb, NULL);
+	bdev = allocate_bdev("bdev");
+
+	rc = spdk_bdev_open(bdev, true, NULL, NULL, &desc);
+	CU_ASSERT_EQUAL(rc, 0);
+	SPDK_CU_ASSERT_FATAL(desc != NULL);
+	ioch = spdk_bdev_get_io_channel(desc);
+	SPDK_CU_ASSERT_FATAL(ioch != NULL);
+
+	fn_table.submit_request = stub_submit_request;
+	g_io_exp_status = SPDK_BDEV_IO_STATUS_SUCCESS;
+
+	/* Copy supported by the bdev is submitted as a single request */
+	ut_enable_io_type(SPDK_BDEV_IO_TYPE_COPY, true);
+	expected_io = ut_alloc_expected_io(SPDK_BDEV_IO_TYPE_COPY, 100, 200, 0);
+	TAILQ_INSERT_TAIL(&g_bdev_ut_channel->expected_io, expected_io, link);
+	g_io_done = false;
+	rc = spdk_bdev_copy_blocks(desc, ioch, 100, 400, 200, io_done, NULL);
+	CU_ASSERT_EQUAL(rc, 0);
+	SPDK_CU_ASSERT_FATAL(g_bdev_io != NULL);
+	CU_ASSERT(g_bdev_io->u.bdev.copy.src_offset_blocks == 400);
+	num_completed = stub_complete_io(1);
+	CU_ASSERT_EQUAL(num_completed, 1);
+	CU_ASSERT(g_io_done == true);
+	CU_ASSERT(g_io_status == SPDK_BDEV_IO_STATUS_SUCCESS);
+
+	/* Overlapping ranges, out of range and empty copies are rejected */
+	rc = spdk_bdev_copy_blocks(desc, ioch, 100, 250, 200, io_done, NULL);
+	CU_ASSERT_EQUAL(rc, -EINVAL);
+	rc = spdk_bdev_copy_blocks(desc, ioch, 100, bdev->blockcnt - 10, 20, io_done, NULL);
+	CU_ASSERT_EQUAL(rc, -EINVAL);
+	rc = spdk_bdev_copy_blocks(desc, ioch, 100, 400, 0, io_done, NULL);
+	CU_ASSERT_EQUAL(rc, -EINVAL);
+
+	/* Without copy support the data goes through a read and a write per chunk, the
+	 * write using the buffer of the read */
+	ut_enable_io_type(SPDK_BDEV_IO_TYPE_COPY, false);
+	CU_ASSERT(spdk_bdev_io_type_supported(bdev, SPDK_BDEV_IO_TYPE_COPY) == true);
+	fn_table.submit_request = stub_submit_request_get_buf;
+	num_io_blocks = (SPDK_BDEV_LARGE_BUF_MAX_SIZE - spdk_bdev_get_buf_align(bdev)) / bdev->blocklen;
+
+	g_io_done = false;
+	expected_io = ut_alloc_expected_io(SPDK_BDEV_IO_TYPE_READ, 400, num_io_blocks, 0);
+	TAILQ_INSERT_TAIL(&g_bdev_ut_channel->expected_io, expected_io, link);
+	rc = spdk_bdev_copy_blocks(desc, ioch, 100, 400, num_io_blocks + 10, io_done, NULL);
+	CU_ASSERT_EQUAL(rc, 0);
+	CU_ASSERT(g_bdev_ut_channel->outstanding_io_count == 1);
+	read_io = g_bdev_io;
+	SPDK_CU_ASSERT_FATAL(read_io != NULL);
+	CU_ASSERT(read_io->u.bdev.iovs[0].iov_base != NULL);
+
+	expected_io = ut_alloc_expected_io(SPDK_BDEV_IO_TYPE_WRITE, 100, num_io_blocks, 1);
+	ut_expected_io_set_iov(expected_io, 0, read_io->u.bdev.iovs[0].iov_base,
+			       num_io_blocks * bdev->blocklen);
+	TAILQ_INSERT_TAIL(&g_bdev_ut_channel->expected_io, expected_io, link);
+	num_completed = stub_complete_io(1);
+	CU_ASSERT_EQUAL(num_completed, 1);
+	CU_ASSERT(g_bdev_ut_channel->outstanding_io_count == 1);
+
+	expected_io = ut_alloc_expected_io(SPDK_BDEV_IO_TYPE_READ, 400 + num_io_blocks, 10, 0);
+	TAILQ_INSERT_TAIL(&g_bdev_ut_channel->expected_io, expected_io, link);
+	expected_io = ut_alloc_expected_io(SPDK_BDEV_IO_TYPE_WRITE, 100 + num_io_blocks, 10, 0);
+	TAILQ_INSERT_TAIL(&g_bdev_ut_channel->expected_io, expected_io, link);
+	num_completed = stub_complete_io(3);
+	CU_ASSERT_EQUAL(num_completed, 3);
+	CU_ASSERT(g_io_done == true);
+	CU_ASSERT(g_io_status == SPDK_BDEV_IO_STATUS_SUCCESS);
+	CU_ASSERT(g_bdev_ut_channel->outstanding_io_count == 0);
+
+	/* A failed read fails the copy */
+	g_io_done = false;
+	rc = spdk_bdev_copy_blocks(desc, ioch, 100, 400, 20, io_done, NULL);
+	CU_ASSERT_EQUAL(rc, 0);
+	g_io_exp_status = SPDK_BDEV_IO_STATUS_FAILED;
+	num_completed = stub_complete_io(1);
+	CU_ASSERT_EQUAL(num_completed, 1);
+	CU_ASSERT(g_io_done == true);
+	CU_ASSERT(g_io_status == SPDK_BDEV_IO_STATUS_FAILED);
+	CU_ASSERT(g_bdev_ut_channel->outstanding_io_count == 0);
+	g_io_exp_status = SPDK_BDEV_IO_STATUS_SUCCESS;
+
+	/* Neither copy nor read/write support */
+	ut_enable_io_type(SPDK_BDEV_IO_TYPE_READ, false);
+	CU_ASSERT(spdk_bdev_io_type_supported(bdev, SPDK_BDEV_IO_TYPE_COPY) == false);
+	rc = spdk_bdev_copy_blocks(desc, ioch, 100, 400, 20, io_done, NULL);
+	CU_ASSERT_EQUAL(rc, -ENOTSUP);
+	ut_enable_io_type(SPDK_BDEV_IO_TYPE_READ, true);
+
+	fn_table.submit_request = stub_submit_request;
+	spdk_put_io_channel(ioch);
+	spdk_bdev_close(desc);
+	free_bdev(bdev);
+	spdk_bdev_finish(bdev_fini_cb, NULL);
+	poll_threads();
+}
+
 static void
 bdev_open_while_hotremove(void)
 {
@@ -3385,10 +3886,14 @@ main(int argc, char **argv)
 	CU_ADD_TEST(suite, bdev_io_spans_boundary_test);
 	CU_ADD_TEST(suite, bdev_io_split_test);
 	CU_ADD_TEST(suite, bdev_io_split_with_io_wait);
+	CU_ADD_TEST(suite, bdev_io_split_batch);
+	CU_ADD_TEST(suite, bdev_io_batch);
+	CU_ADD_TEST(suite, bdev_buf_cache);
 	CU_ADD_TEST(suite, bdev_io_alignment_with_boundary);
 	CU_ADD_TEST(suite, bdev_io_alignment);
 	CU_ADD_TEST(suite, bdev_histograms);
 	CU_ADD_TEST(suite, bdev_write_zeroes);
+	CU_ADD_TEST(suite, bdev_copy);
 	CU_ADD_TEST(suite, bdev_compare_and_write);
 	CU_ADD_TEST(suite, bdev_compare);
 	CU_ADD_TEST(suite, bdev_open_while_hotremove);
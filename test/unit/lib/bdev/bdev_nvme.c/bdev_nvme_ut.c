@@ -0,0 +1,902 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "spdk/stdinc.h"
+#include "spdk_cunit.h"
+#include "spdk/thread.h"
+#include "spdk/bdev_module.h"
+#include "spdk_internal/mock.h"
+
+#include "common/lib/ut_multithread.c"
+#include "bdev/nvme/bdev_nvme.c"
+#include "bdev/nvme/common.c"
+#include "unit/lib/json_mock.c"
+
+DEFINE_STUB(bdev_ocssd_create_io_channel, int, (struct nvme_io_channel *ioch), 0);
+DEFINE_STUB_V(bdev_ocssd_destroy_io_channel, (struct nvme_io_channel *ioch));
+DEFINE_STUB_V(bdev_ocssd_depopulate_namespace, (struct nvme_bdev_ns *ns));
+DEFINE_STUB_V(bdev_ocssd_fini_ctrlr, (struct nvme_bdev_ctrlr *nvme_bdev_ctrlr));
+DEFINE_STUB_V(bdev_ocssd_handle_chunk_notification, (struct nvme_bdev_ctrlr *nvme_bdev_ctrlr));
+DEFINE_STUB(bdev_ocssd_init_ctrlr, int, (struct nvme_bdev_ctrlr *nvme_bdev_ctrlr), 0);
+DEFINE_STUB_V(bdev_ocssd_namespace_config_json, (struct spdk_json_write_ctx *w,
+		struct nvme_bdev_ns *ns));
+DEFINE_STUB_V(bdev_ocssd_populate_namespace, (struct nvme_bdev_ctrlr *nvme_bdev_ctrlr,
+		struct nvme_bdev_ns *nvme_ns, struct nvme_async_probe_ctx *ctx));
+
+DEFINE_STUB_V(spdk_bdev_module_finish_done, (void));
+DEFINE_STUB_V(spdk_bdev_module_list_add, (struct spdk_bdev_module *bdev_module));
+DEFINE_STUB(spdk_bdev_notify_blockcnt_change, int, (struct spdk_bdev *bdev, uint64_t size), 0);
+DEFINE_STUB(spdk_bdev_register, int, (struct spdk_bdev *bdev), 0);
+DEFINE_STUB_V(spdk_bdev_unregister, (struct spdk_bdev *bdev, spdk_bdev_unregister_cb cb_fn,
+				     void *cb_arg));
+DEFINE_STUB(spdk_bdev_io_get_io_channel, struct spdk_io_channel *,
+	    (struct spdk_bdev_io *bdev_io), NULL);
+
+DEFINE_STUB(spdk_conf_find_section, struct spdk_conf_section *, (struct spdk_conf *cp,
+		const char *name), NULL);
+DEFINE_STUB(spdk_conf_section_get_boolval, bool, (struct spdk_conf_section *sp, const char *key,
+		bool default_val), false);
+DEFINE_STUB(spdk_conf_section_get_intval, int, (struct spdk_conf_section *sp, const char *key), -1);
+DEFINE_STUB(spdk_conf_section_get_nmval, char *, (struct spdk_conf_section *sp, const char *key,
+		int idx1, int idx2), NULL);
+DEFINE_STUB(spdk_conf_section_get_val, char *, (struct spdk_conf_section *sp, const char *key),
+	    NULL);
+DEFINE_STUB(spdk_json_write_string_fmt, int, (struct spdk_json_write_ctx *w, const char *fmt,
+		...), 0);
+
+DEFINE_STUB(spdk_nvme_connect, struct spdk_nvme_ctrlr *, (const struct spdk_nvme_transport_id *trid,
+		const struct spdk_nvme_ctrlr_opts *opts, size_t opts_size), NULL);
+DEFINE_STUB(spdk_nvme_connect_async, struct spdk_nvme_probe_ctx *,
+	    (const struct spdk_nvme_transport_id *trid, const struct spdk_nvme_ctrlr_opts *opts,
+	     spdk_nvme_attach_cb attach_cb), NULL);
+DEFINE_STUB(spdk_nvme_ctrlr_cmd_abort, int, (struct spdk_nvme_ctrlr *ctrlr,
+		struct spdk_nvme_qpair *qpair, uint16_t cid, spdk_nvme_cmd_cb cb_fn, void *cb_arg), 0);
+DEFINE_STUB(spdk_nvme_ctrlr_cmd_abort_ext, int, (struct spdk_nvme_ctrlr *ctrlr,
+		struct spdk_nvme_qpair *qpair, void *cmd_cb_arg, spdk_nvme_cmd_cb cb_fn, void *cb_arg), 0);
+DEFINE_STUB(spdk_nvme_ctrlr_cmd_admin_raw, int, (struct spdk_nvme_ctrlr *ctrlr,
+		struct spdk_nvme_cmd *cmd, void *buf, uint32_t len, spdk_nvme_cmd_cb cb_fn,
+		void *cb_arg), 0);
+DEFINE_STUB(spdk_nvme_ctrlr_cmd_get_log_page, int, (struct spdk_nvme_ctrlr *ctrlr,
+		uint8_t log_page, uint32_t nsid, void *payload, uint32_t payload_size, uint64_t offset,
+		spdk_nvme_cmd_cb cb_fn, void *cb_arg), 0);
+DEFINE_STUB(spdk_nvme_ctrlr_cmd_io_raw, int, (struct spdk_nvme_ctrlr *ctrlr,
+		struct spdk_nvme_qpair *qpair, struct spdk_nvme_cmd *cmd, void *buf, uint32_t len,
+		spdk_nvme_cmd_cb cb_fn, void *cb_arg), 0);
+DEFINE_STUB(spdk_nvme_ctrlr_cmd_io_raw_with_md, int, (struct spdk_nvme_ctrlr *ctrlr,
+		struct spdk_nvme_qpair *qpair, struct spdk_nvme_cmd *cmd, void *buf, uint32_t len,
+		void *md_buf, spdk_nvme_cmd_cb cb_fn, void *cb_arg), 0);
+DEFINE_STUB(spdk_nvme_ctrlr_connect_io_qpair, int, (struct spdk_nvme_ctrlr *ctrlr,
+		struct spdk_nvme_qpair *qpair), 0);
+DEFINE_STUB(spdk_nvme_ctrlr_get_data, const struct spdk_nvme_ctrlr_data *,
+	    (struct spdk_nvme_ctrlr *ctrlr), NULL);
+DEFINE_STUB_V(spdk_nvme_ctrlr_get_default_ctrlr_opts, (struct spdk_nvme_ctrlr_opts *opts,
+		size_t opts_size));
+DEFINE_STUB_V(spdk_nvme_ctrlr_get_default_io_qpair_opts, (struct spdk_nvme_ctrlr *ctrlr,
+		struct spdk_nvme_io_qpair_opts *opts, size_t opts_size));
+DEFINE_STUB(spdk_nvme_ctrlr_get_flags, uint64_t, (struct spdk_nvme_ctrlr *ctrlr), 0);
+DEFINE_STUB(spdk_nvme_ctrlr_get_max_xfer_size, uint32_t, (const struct spdk_nvme_ctrlr *ctrlr), 0);
+DEFINE_STUB(spdk_nvme_ctrlr_get_ns, struct spdk_nvme_ns *, (struct spdk_nvme_ctrlr *ctrlr,
+		uint32_t ns_id), NULL);
+DEFINE_STUB(spdk_nvme_ctrlr_get_num_ns, uint32_t, (struct spdk_nvme_ctrlr *ctrlr), 0);
+DEFINE_STUB(spdk_nvme_ctrlr_get_regs_csts, union spdk_nvme_csts_register,
+	    (struct spdk_nvme_ctrlr *ctrlr), {});
+DEFINE_STUB(spdk_nvme_ctrlr_get_regs_vs, union spdk_nvme_vs_register,
+	    (struct spdk_nvme_ctrlr *ctrlr), {});
+DEFINE_STUB(spdk_nvme_ctrlr_get_transport_id, const struct spdk_nvme_transport_id *,
+	    (struct spdk_nvme_ctrlr *ctrlr), NULL);
+DEFINE_STUB(spdk_nvme_ctrlr_is_active_ns, bool, (struct spdk_nvme_ctrlr *ctrlr, uint32_t nsid),
+	    true);
+DEFINE_STUB(spdk_nvme_ctrlr_is_ocssd_supported, bool, (struct spdk_nvme_ctrlr *ctrlr), false);
+DEFINE_STUB(spdk_nvme_ctrlr_process_admin_completions, int32_t, (struct spdk_nvme_ctrlr *ctrlr), 0);
+DEFINE_STUB(spdk_nvme_ctrlr_reconnect_io_qpair, int, (struct spdk_nvme_qpair *qpair), 0);
+DEFINE_STUB_V(spdk_nvme_ctrlr_register_aer_callback, (struct spdk_nvme_ctrlr *ctrlr,
+		spdk_nvme_aer_cb aer_cb_fn, void *aer_cb_arg));
+DEFINE_STUB_V(spdk_nvme_ctrlr_register_timeout_callback, (struct spdk_nvme_ctrlr *ctrlr,
+		uint64_t timeout_us, spdk_nvme_timeout_cb cb_fn, void *cb_arg));
+DEFINE_STUB(spdk_nvme_ctrlr_reset, int, (struct spdk_nvme_ctrlr *ctrlr), 0);
+DEFINE_STUB(spdk_nvme_host_id_parse, int, (struct spdk_nvme_host_id *hostid, const char *str), 0);
+DEFINE_STUB(spdk_nvme_ns_cmd_comparev_with_md, int, (struct spdk_nvme_ns *ns,
+		struct spdk_nvme_qpair *qpair, uint64_t lba, uint32_t lba_count, spdk_nvme_cmd_cb cb_fn,
+		void *cb_arg, uint32_t io_flags, spdk_nvme_req_reset_sgl_cb reset_sgl_fn,
+		spdk_nvme_req_next_sge_cb next_sge_fn, void *metadata, uint16_t apptag_mask,
+		uint16_t apptag), 0);
+DEFINE_STUB(spdk_nvme_ns_cmd_dataset_management, int, (struct spdk_nvme_ns *ns,
+		struct spdk_nvme_qpair *qpair, uint32_t type, const struct spdk_nvme_dsm_range *ranges,
+		uint16_t num_ranges, spdk_nvme_cmd_cb cb_fn, void *cb_arg), 0);
+DEFINE_STUB(spdk_nvme_ns_get_ctrlr, struct spdk_nvme_ctrlr *, (struct spdk_nvme_ns *ns), NULL);
+DEFINE_STUB(spdk_nvme_ns_get_data, const struct spdk_nvme_ns_data *, (struct spdk_nvme_ns *ns),
+	    NULL);
+DEFINE_STUB(spdk_nvme_ns_get_dealloc_logical_block_read_value,
+	    enum spdk_nvme_dealloc_logical_block_read_value, (struct spdk_nvme_ns *ns), 0);
+DEFINE_STUB(spdk_nvme_ns_get_extended_sector_size, uint32_t, (struct spdk_nvme_ns *ns), 512);
+DEFINE_STUB(spdk_nvme_ns_get_id, uint32_t, (struct spdk_nvme_ns *ns), 1);
+DEFINE_STUB(spdk_nvme_ns_get_md_size, uint32_t, (struct spdk_nvme_ns *ns), 0);
+DEFINE_STUB(spdk_nvme_ns_get_num_sectors, uint64_t, (struct spdk_nvme_ns *ns), 0);
+DEFINE_STUB(spdk_nvme_ns_get_optimal_io_boundary, uint32_t, (struct spdk_nvme_ns *ns), 0);
+DEFINE_STUB(spdk_nvme_ns_get_pi_type, enum spdk_nvme_pi_type, (struct spdk_nvme_ns *ns), 0);
+DEFINE_STUB(spdk_nvme_ns_get_uuid, const struct spdk_uuid *, (const struct spdk_nvme_ns *ns), NULL);
+DEFINE_STUB(spdk_nvme_ns_supports_compare, bool, (struct spdk_nvme_ns *ns), false);
+DEFINE_STUB(spdk_nvme_poll_group_add, int, (struct spdk_nvme_poll_group *group,
+		struct spdk_nvme_qpair *qpair), 0);
+DEFINE_STUB(spdk_nvme_poll_group_destroy, int, (struct spdk_nvme_poll_group *group), 0);
+DEFINE_STUB(spdk_nvme_poll_group_process_completions, int64_t, (struct spdk_nvme_poll_group *group,
+		uint32_t completions_per_qpair, spdk_nvme_disconnected_qpair_cb disconnected_qpair_cb), 0);
+DEFINE_STUB(spdk_nvme_poll_group_remove, int, (struct spdk_nvme_poll_group *group,
+		struct spdk_nvme_qpair *qpair), 0);
+DEFINE_STUB(spdk_nvme_prchk_flags_parse, int, (uint32_t *prchk_flags, const char *str), 0);
+DEFINE_STUB(spdk_nvme_prchk_flags_str, const char *, (uint32_t prchk_flags), NULL);
+DEFINE_STUB(spdk_nvme_probe, int, (const struct spdk_nvme_transport_id *trid, void *cb_ctx,
+				   spdk_nvme_probe_cb probe_cb, spdk_nvme_attach_cb attach_cb,
+				   spdk_nvme_remove_cb remove_cb), 0);
+DEFINE_STUB(spdk_nvme_probe_async, struct spdk_nvme_probe_ctx *,
+	    (const struct spdk_nvme_transport_id *trid, void *cb_ctx, spdk_nvme_probe_cb probe_cb,
+	     spdk_nvme_attach_cb attach_cb, spdk_nvme_remove_cb remove_cb), NULL);
+DEFINE_STUB(spdk_nvme_probe_poll_async, int, (struct spdk_nvme_probe_ctx *probe_ctx), 0);
+DEFINE_STUB(spdk_nvme_transport_id_adrfam_str, const char *, (enum spdk_nvmf_adrfam adrfam), NULL);
+DEFINE_STUB(spdk_nvme_transport_id_compare, int, (const struct spdk_nvme_transport_id *trid1,
+		const struct spdk_nvme_transport_id *trid2), 0);
+DEFINE_STUB(spdk_nvme_transport_id_parse, int, (struct spdk_nvme_transport_id *trid,
+		const char *str), 0);
+DEFINE_STUB(spdk_nvme_transport_id_trtype_str, const char *,
+	    (enum spdk_nvme_transport_type trtype), NULL);
+DEFINE_STUB_V(spdk_nvme_trid_populate_transport, (struct spdk_nvme_transport_id *trid,
+		enum spdk_nvme_transport_type trtype));
+DEFINE_STUB(spdk_opal_dev_construct, struct spdk_opal_dev *, (struct spdk_nvme_ctrlr *ctrlr), NULL);
+DEFINE_STUB_V(spdk_opal_dev_destruct, (struct spdk_opal_dev *dev));
+
+struct ut_nvme_req {
+	spdk_nvme_cmd_cb		cb_fn;
+	void				*cb_arg;
+	TAILQ_ENTRY(ut_nvme_req)	tailq;
+};
+
+struct spdk_nvme_qpair {
+	struct spdk_nvme_ctrlr		*ctrlr;
+	uint32_t			num_outstanding;
+	TAILQ_HEAD(, ut_nvme_req)	outstanding;
+};
+
+struct spdk_nvme_ctrlr {
+	uint32_t			unused;
+};
+
+struct spdk_nvme_ns {
+	uint32_t			unused;
+};
+
+struct spdk_nvme_poll_group {
+	uint32_t			unused;
+};
+
+static struct spdk_nvme_poll_group g_ut_poll_group;
+static struct spdk_nvme_ns g_ut_ns;
+static int g_ut_submit_rc;
+static enum spdk_bdev_io_status g_io_status;
+static int g_io_sct;
+static int g_io_sc;
+
+int
+spdk_nvme_detach(struct spdk_nvme_ctrlr *ctrlr)
+{
+	free(ctrlr);
+
+	return 0;
+}
+
+struct spdk_nvme_poll_group *
+spdk_nvme_poll_group_create(void *ctx)
+{
+	return &g_ut_poll_group;
+}
+
+struct spdk_nvme_qpair *
+spdk_nvme_ctrlr_alloc_io_qpair(struct spdk_nvme_ctrlr *ctrlr,
+			       const struct spdk_nvme_io_qpair_opts *opts, size_t opts_size)
+{
+	struct spdk_nvme_qpair *qpair;
+
+	qpair = calloc(1, sizeof(*qpair));
+	SPDK_CU_ASSERT_FATAL(qpair != NULL);
+
+	qpair->ctrlr = ctrlr;
+	TAILQ_INIT(&qpair->outstanding);
+
+	return qpair;
+}
+
+static void
+ut_complete_req(struct spdk_nvme_qpair *qpair, int sct, int sc, bool dnr)
+{
+	struct spdk_nvme_cpl cpl = {};
+	struct ut_nvme_req *req;
+
+	req = TAILQ_FIRST(&qpair->outstanding);
+	SPDK_CU_ASSERT_FATAL(req != NULL);
+	TAILQ_REMOVE(&qpair->outstanding, req, tailq);
+	qpair->num_outstanding--;
+
+	cpl.status.sct = sct;
+	cpl.status.sc = sc;
+	cpl.status.dnr = dnr;
+	req->cb_fn(req->cb_arg, &cpl);
+	free(req);
+}
+
+int
+spdk_nvme_ctrlr_free_io_qpair(struct spdk_nvme_qpair *qpair)
+{
+	if (qpair == NULL) {
+		return 0;
+	}
+
+	/* Like the NVMe driver, abort what is still outstanding on the qpair */
+	while (!TAILQ_EMPTY(&qpair->outstanding)) {
+		ut_complete_req(qpair, SPDK_NVME_SCT_GENERIC, SPDK_NVME_SC_ABORTED_SQ_DELETION, false);
+	}
+
+	free(qpair);
+
+	return 0;
+}
+
+static int
+ut_queue_req(struct spdk_nvme_qpair *qpair, spdk_nvme_cmd_cb cb_fn, void *cb_arg)
+{
+	struct ut_nvme_req *req;
+
+	if (g_ut_submit_rc != 0) {
+		return g_ut_submit_rc;
+	}
+
+	req = calloc(1, sizeof(*req));
+	SPDK_CU_ASSERT_FATAL(req != NULL);
+
+	req->cb_fn = cb_fn;
+	req->cb_arg = cb_arg;
+	TAILQ_INSERT_TAIL(&qpair->outstanding, req, tailq);
+	qpair->num_outstanding++;
+
+	return 0;
+}
+
+int
+spdk_nvme_ns_cmd_writev_with_md(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
+				uint64_t lba, uint32_t lba_count, spdk_nvme_cmd_cb cb_fn, void *cb_arg,
+				uint32_t io_flags, spdk_nvme_req_reset_sgl_cb reset_sgl_fn,
+				spdk_nvme_req_next_sge_cb next_sge_fn, void *metadata,
+				uint16_t apptag_mask, uint16_t apptag)
+{
+	return ut_queue_req(qpair, cb_fn, cb_arg);
+}
+
+int
+spdk_nvme_ns_cmd_readv_with_md(struct spdk_nvme_ns *ns, struct spdk_nvme_qpair *qpair,
+			       uint64_t lba, uint32_t lba_count, spdk_nvme_cmd_cb cb_fn, void *cb_arg,
+			       uint32_t io_flags, spdk_nvme_req_reset_sgl_cb reset_sgl_fn,
+			       spdk_nvme_req_next_sge_cb next_sge_fn, void *metadata,
+			       uint16_t apptag_mask, uint16_t apptag)
+{
+	return ut_queue_req(qpair, cb_fn, cb_arg);
+}
+
+void
+spdk_bdev_io_get_buf(struct spdk_bdev_io *bdev_io, spdk_bdev_io_get_buf_cb cb, uint64_t len)
+{
+	cb(spdk_bdev_io_get_io_channel(bdev_io), bdev_io, true);
+}
+
+void
+spdk_bdev_io_complete(struct spdk_bdev_io *bdev_io, enum spdk_bdev_io_status status)
+{
+	g_io_status = status;
+}
+
+void
+spdk_bdev_io_complete_nvme_status(struct spdk_bdev_io *bdev_io, uint32_t cdw0, int sct, int sc)
+{
+	g_io_sct = sct;
+	g_io_sc = sc;
+	g_io_status = (sct == SPDK_NVME_SCT_GENERIC && sc == SPDK_NVME_SC_SUCCESS) ?
+		      SPDK_BDEV_IO_STATUS_SUCCESS : SPDK_BDEV_IO_STATUS_NVME_ERROR;
+}
+
+static struct spdk_nvme_ana_page g_ut_ana_page;
+
+/*
+ * Create a controller with a single namespace that reports ANA. A secondary
+ * is added as a path to the primary, like attaching it with multipath does.
+ */
+static struct nvme_bdev_ctrlr *
+ut_create_ctrlr(const char *name, struct nvme_bdev_ctrlr *primary)
+{
+	struct nvme_bdev_ctrlr *nvme_bdev_ctrlr;
+	struct nvme_bdev_ns *nvme_ns;
+
+	nvme_bdev_ctrlr = calloc(1, sizeof(*nvme_bdev_ctrlr));
+	SPDK_CU_ASSERT_FATAL(nvme_bdev_ctrlr != NULL);
+	nvme_bdev_ctrlr->ctrlr = calloc(1, sizeof(struct spdk_nvme_ctrlr));
+	nvme_bdev_ctrlr->trid = calloc(1, sizeof(struct spdk_nvme_transport_id));
+	nvme_bdev_ctrlr->name = strdup(name);
+	nvme_bdev_ctrlr->namespaces = calloc(1, sizeof(struct nvme_bdev_ns *));
+	nvme_bdev_ctrlr->ana_log_page = calloc(1, sizeof(g_ut_ana_page));
+	nvme_ns = calloc(1, sizeof(*nvme_ns));
+	SPDK_CU_ASSERT_FATAL(nvme_bdev_ctrlr->ctrlr != NULL && nvme_bdev_ctrlr->trid != NULL &&
+			     nvme_bdev_ctrlr->name != NULL && nvme_bdev_ctrlr->namespaces != NULL &&
+			     nvme_bdev_ctrlr->ana_log_page != NULL && nvme_ns != NULL);
+
+	snprintf(nvme_bdev_ctrlr->trid->traddr, sizeof(nvme_bdev_ctrlr->trid->traddr), "%s", name);
+	nvme_ns->id = 1;
+	nvme_ns->ns = &g_ut_ns;
+	nvme_ns->ctrlr = nvme_bdev_ctrlr;
+	nvme_ns->populated = primary == NULL;
+	nvme_ns->ana_state = SPDK_NVME_ANA_OPTIMIZED_STATE;
+	TAILQ_INIT(&nvme_ns->bdevs);
+	nvme_bdev_ctrlr->namespaces[0] = nvme_ns;
+	nvme_bdev_ctrlr->num_ns = 1;
+	nvme_bdev_ctrlr->thread = spdk_get_thread();
+	TAILQ_INIT(&nvme_bdev_ctrlr->paths);
+
+	spdk_io_device_register(nvme_bdev_ctrlr, bdev_nvme_create_cb, bdev_nvme_destroy_cb,
+				sizeof(struct nvme_io_channel), name);
+
+	pthread_mutex_lock(&g_bdev_nvme_mutex);
+	TAILQ_INSERT_TAIL(&g_nvme_bdev_ctrlrs, nvme_bdev_ctrlr, tailq);
+	if (primary != NULL) {
+		nvme_bdev_ctrlr->secondary = true;
+		nvme_bdev_ctrlr->primary = primary;
+		TAILQ_INSERT_TAIL(&primary->paths, nvme_bdev_ctrlr, path_tailq);
+	}
+	pthread_mutex_unlock(&g_bdev_nvme_mutex);
+
+	return nvme_bdev_ctrlr;
+}
+
+/* Detach a controller like hot removal does once its bdevs are gone */
+static void
+ut_destruct_ctrlr(struct nvme_bdev_ctrlr *nvme_bdev_ctrlr)
+{
+	nvme_bdev_ctrlr->destruct = true;
+	nvme_bdev_ctrlr_destruct(nvme_bdev_ctrlr);
+	poll_threads();
+}
+
+static struct spdk_bdev_io *
+ut_alloc_bdev_io(struct nvme_bdev *nbdev)
+{
+	struct spdk_bdev_io *bdev_io;
+
+	bdev_io = calloc(1, sizeof(*bdev_io) + sizeof(struct nvme_bdev_io));
+	SPDK_CU_ASSERT_FATAL(bdev_io != NULL);
+
+	bdev_io->bdev = &nbdev->disk;
+	bdev_io->type = SPDK_BDEV_IO_TYPE_WRITE;
+	bdev_io->u.bdev.num_blocks = 1;
+
+	return bdev_io;
+}
+
+static void
+ut_submit_io(struct spdk_bdev_io *bdev_io, struct spdk_io_channel *ch)
+{
+	g_io_status = SPDK_BDEV_IO_STATUS_PENDING;
+	MOCK_SET(spdk_bdev_io_get_io_channel, ch);
+	bdev_nvme_submit_request(ch, bdev_io);
+}
+
+static struct nvme_io_path *
+ut_get_io_path(struct nvme_io_channel *nvme_ch, struct nvme_bdev_ctrlr *nvme_bdev_ctrlr)
+{
+	struct nvme_io_path *io_path;
+
+	TAILQ_FOREACH(io_path, &nvme_ch->io_paths, tailq) {
+		if (io_path->ctrlr == nvme_bdev_ctrlr) {
+			return io_path;
+		}
+	}
+
+	return NULL;
+}
+
+static void
+ut_init_nbdev(struct nvme_bdev *nbdev, struct nvme_bdev_ctrlr *primary)
+{
+	memset(nbdev, 0, sizeof(*nbdev));
+	nbdev->nvme_bdev_ctrlr = primary;
+	nbdev->nvme_ns = primary->namespaces[0];
+	nbdev->disk.ctxt = nbdev;
+	nbdev->disk.blocklen = 512;
+}
+
+static void
+ut_setup(void)
+{
+	allocate_threads(1);
+	set_thread(0);
+
+	spdk_io_device_register(&g_nvme_bdev_ctrlrs, bdev_nvme_poll_group_create_cb,
+				bdev_nvme_poll_group_destroy_cb,
+				sizeof(struct nvme_bdev_poll_group), "bdev_nvme_poll_groups");
+	g_ut_submit_rc = 0;
+}
+
+static void
+ut_teardown(void)
+{
+	CU_ASSERT(TAILQ_EMPTY(&g_nvme_bdev_ctrlrs));
+	spdk_io_device_unregister(&g_nvme_bdev_ctrlrs, NULL);
+	poll_threads();
+	MOCK_CLEAR(spdk_bdev_io_get_io_channel);
+
+	free_threads();
+}
+
+static void
+test_multipath_policy(void)
+{
+	struct nvme_bdev_ctrlr *primary, *secondary1, *secondary2;
+	struct nvme_io_path *local_path, *path1, *path2;
+	struct nvme_io_channel *nvme_ch;
+	struct spdk_io_channel *ch;
+	struct nvme_bdev nbdev;
+
+	ut_setup();
+
+	primary = ut_create_ctrlr("nvme0", NULL);
+	secondary1 = ut_create_ctrlr("nvme1", primary);
+	secondary2 = ut_create_ctrlr("nvme2", primary);
+	ut_init_nbdev(&nbdev, primary);
+
+	ch = spdk_get_io_channel(primary);
+	SPDK_CU_ASSERT_FATAL(ch != NULL);
+	nvme_ch = spdk_io_channel_get_ctx(ch);
+	CU_ASSERT(nvme_ch->num_io_paths == 3);
+	local_path = &nvme_ch->local_path;
+	path1 = ut_get_io_path(nvme_ch, secondary1);
+	path2 = ut_get_io_path(nvme_ch, secondary2);
+	SPDK_CU_ASSERT_FATAL(path1 != NULL && path2 != NULL);
+
+	/* Active/passive keeps using the first usable path */
+	primary->mp_policy = NVME_BDEV_MP_POLICY_ACTIVE_PASSIVE;
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev, nvme_ch, NULL) == local_path);
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev, nvme_ch, NULL) == local_path);
+
+	/* Round robin rotates through all the paths */
+	primary->mp_policy = NVME_BDEV_MP_POLICY_ROUND_ROBIN;
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev, nvme_ch, NULL) == local_path);
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev, nvme_ch, NULL) == path1);
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev, nvme_ch, NULL) == path2);
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev, nvme_ch, NULL) == local_path);
+
+	/* Queue depth picks the path with the fewest outstanding I/O */
+	primary->mp_policy = NVME_BDEV_MP_POLICY_QUEUE_DEPTH;
+	local_path->num_outstanding = 3;
+	path1->num_outstanding = 1;
+	path2->num_outstanding = 2;
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev, nvme_ch, NULL) == path1);
+	path1->num_outstanding = 4;
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev, nvme_ch, NULL) == path2);
+
+	/* Optimized paths win over non-optimized ones with any policy */
+	local_path->num_outstanding = 0;
+	primary->namespaces[0]->ana_state = SPDK_NVME_ANA_NON_OPTIMIZED_STATE;
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev, nvme_ch, NULL) == path2);
+
+	primary->mp_policy = NVME_BDEV_MP_POLICY_ACTIVE_PASSIVE;
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev, nvme_ch, NULL) == path1);
+
+	primary->mp_policy = NVME_BDEV_MP_POLICY_ROUND_ROBIN;
+	nvme_ch->last_path = NULL;
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev, nvme_ch, NULL) == path1);
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev, nvme_ch, NULL) == path2);
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev, nvme_ch, NULL) == path1);
+
+	/* Without optimized paths, the non-optimized ones are used */
+	secondary1->namespaces[0]->ana_state = SPDK_NVME_ANA_NON_OPTIMIZED_STATE;
+	secondary2->namespaces[0]->ana_state = SPDK_NVME_ANA_NON_OPTIMIZED_STATE;
+	primary->mp_policy = NVME_BDEV_MP_POLICY_ACTIVE_PASSIVE;
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev, nvme_ch, NULL) == local_path);
+
+	local_path->num_outstanding = 0;
+	path1->num_outstanding = 0;
+	path2->num_outstanding = 0;
+	spdk_put_io_channel(ch);
+	poll_threads();
+
+	ut_destruct_ctrlr(secondary1);
+	ut_destruct_ctrlr(secondary2);
+	ut_destruct_ctrlr(primary);
+
+	ut_teardown();
+}
+
+static void
+test_multipath_round_robin_io(void)
+{
+	struct nvme_bdev_ctrlr *primary, *secondary;
+	struct nvme_io_path *local_path, *path;
+	struct nvme_io_channel *nvme_ch;
+	struct spdk_io_channel *ch;
+	struct spdk_bdev_io *bdev_io[4];
+	struct nvme_bdev nbdev;
+	int i;
+
+	ut_setup();
+
+	primary = ut_create_ctrlr("nvme0", NULL);
+	secondary = ut_create_ctrlr("nvme1", primary);
+	ut_init_nbdev(&nbdev, primary);
+	primary->mp_policy = NVME_BDEV_MP_POLICY_ROUND_ROBIN;
+
+	ch = spdk_get_io_channel(primary);
+	SPDK_CU_ASSERT_FATAL(ch != NULL);
+	nvme_ch = spdk_io_channel_get_ctx(ch);
+	local_path = &nvme_ch->local_path;
+	path = ut_get_io_path(nvme_ch, secondary);
+	SPDK_CU_ASSERT_FATAL(path != NULL);
+
+	/* Reads, which wait for a data buffer first, alternate between the paths too */
+	for (i = 0; i < 4; i++) {
+		bdev_io[i] = ut_alloc_bdev_io(&nbdev);
+		bdev_io[i]->type = SPDK_BDEV_IO_TYPE_READ;
+		ut_submit_io(bdev_io[i], ch);
+		CU_ASSERT(local_path->num_outstanding == (uint32_t)(i / 2 + 1));
+		CU_ASSERT(path->num_outstanding == (uint32_t)((i + 1) / 2));
+	}
+	CU_ASSERT(local_path->nvme_ch->qpair->num_outstanding == 2);
+	CU_ASSERT(path->nvme_ch->qpair->num_outstanding == 2);
+
+	for (i = 0; i < 2; i++) {
+		ut_complete_req(local_path->nvme_ch->qpair, SPDK_NVME_SCT_GENERIC,
+				SPDK_NVME_SC_SUCCESS, false);
+		ut_complete_req(path->nvme_ch->qpair, SPDK_NVME_SCT_GENERIC,
+				SPDK_NVME_SC_SUCCESS, false);
+	}
+	CU_ASSERT(local_path->num_outstanding == 0);
+	CU_ASSERT(path->num_outstanding == 0);
+
+	/* Writes keep rotating from where the reads left off */
+	for (i = 0; i < 2; i++) {
+		bdev_io[i]->type = SPDK_BDEV_IO_TYPE_WRITE;
+		ut_submit_io(bdev_io[i], ch);
+	}
+	CU_ASSERT(local_path->num_outstanding == 1);
+	CU_ASSERT(path->num_outstanding == 1);
+	ut_complete_req(local_path->nvme_ch->qpair, SPDK_NVME_SCT_GENERIC, SPDK_NVME_SC_SUCCESS, false);
+	ut_complete_req(path->nvme_ch->qpair, SPDK_NVME_SCT_GENERIC, SPDK_NVME_SC_SUCCESS, false);
+
+	for (i = 0; i < 4; i++) {
+		free(bdev_io[i]);
+	}
+	spdk_put_io_channel(ch);
+	poll_threads();
+
+	ut_destruct_ctrlr(secondary);
+	ut_destruct_ctrlr(primary);
+
+	ut_teardown();
+}
+
+static void
+test_multipath_ana_filter(void)
+{
+	struct nvme_bdev_ctrlr *primary, *secondary;
+	struct nvme_io_path *local_path, *path;
+	struct nvme_io_channel *nvme_ch;
+	struct spdk_io_channel *ch;
+	struct nvme_bdev nbdev;
+	struct spdk_nvme_qpair *qpair;
+
+	ut_setup();
+
+	primary = ut_create_ctrlr("nvme0", NULL);
+	secondary = ut_create_ctrlr("nvme1", primary);
+	ut_init_nbdev(&nbdev, primary);
+	primary->mp_policy = NVME_BDEV_MP_POLICY_ROUND_ROBIN;
+
+	ch = spdk_get_io_channel(primary);
+	SPDK_CU_ASSERT_FATAL(ch != NULL);
+	nvme_ch = spdk_io_channel_get_ctx(ch);
+	local_path = &nvme_ch->local_path;
+	path = ut_get_io_path(nvme_ch, secondary);
+	SPDK_CU_ASSERT_FATAL(path != NULL);
+
+	/* Paths in the inaccessible, persistent loss and change states aren't used */
+	primary->namespaces[0]->ana_state = SPDK_NVME_ANA_INACCESSIBLE_STATE;
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev, nvme_ch, NULL) == path);
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev, nvme_ch, NULL) == path);
+
+	primary->namespaces[0]->ana_state = SPDK_NVME_ANA_PERSISTENT_LOSS_STATE;
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev, nvme_ch, NULL) == path);
+
+	primary->namespaces[0]->ana_state = SPDK_NVME_ANA_CHANGE_STATE;
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev, nvme_ch, NULL) == path);
+
+	/* No path is left once the last one becomes inaccessible too */
+	secondary->namespaces[0]->ana_state = SPDK_NVME_ANA_INACCESSIBLE_STATE;
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev, nvme_ch, NULL) == NULL);
+
+	/* Controllers not reporting ANA are always usable */
+	free(primary->ana_log_page);
+	primary->ana_log_page = NULL;
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev, nvme_ch, NULL) == local_path);
+
+	/* Neither is a path whose controller is resetting, nor an excluded one */
+	qpair = nvme_ch->qpair;
+	nvme_ch->qpair = NULL;
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev, nvme_ch, NULL) == NULL);
+	nvme_ch->qpair = qpair;
+
+	secondary->namespaces[0]->ana_state = SPDK_NVME_ANA_OPTIMIZED_STATE;
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev, nvme_ch, local_path) == path);
+	CU_ASSERT(bdev_nvme_find_io_path(&nbdev, nvme_ch, path) == local_path);
+
+	spdk_put_io_channel(ch);
+	poll_threads();
+
+	ut_destruct_ctrlr(secondary);
+	ut_destruct_ctrlr(primary);
+
+	ut_teardown();
+}
+
+static void
+test_multipath_failover(void)
+{
+	struct nvme_bdev_ctrlr *primary, *secondary;
+	struct nvme_io_path *local_path, *path;
+	struct nvme_io_channel *nvme_ch;
+	struct spdk_io_channel *ch;
+	struct spdk_bdev_io *bdev_io;
+	struct nvme_bdev nbdev;
+
+	ut_setup();
+
+	primary = ut_create_ctrlr("nvme0", NULL);
+	secondary = ut_create_ctrlr("nvme1", primary);
+	ut_init_nbdev(&nbdev, primary);
+
+	ch = spdk_get_io_channel(primary);
+	SPDK_CU_ASSERT_FATAL(ch != NULL);
+	nvme_ch = spdk_io_channel_get_ctx(ch);
+	local_path = &nvme_ch->local_path;
+	path = ut_get_io_path(nvme_ch, secondary);
+	SPDK_CU_ASSERT_FATAL(path != NULL);
+	bdev_io = ut_alloc_bdev_io(&nbdev);
+
+	/* An I/O failed with an ANA error is resubmitted through the other path */
+	ut_submit_io(bdev_io, ch);
+	CU_ASSERT(local_path->nvme_ch->qpair->num_outstanding == 1);
+	CU_ASSERT(local_path->num_outstanding == 1);
+
+	ut_complete_req(local_path->nvme_ch->qpair, SPDK_NVME_SCT_PATH,
+			SPDK_NVME_SC_ASYMMETRIC_ACCESS_INACCESSIBLE, false);
+	CU_ASSERT(g_io_status == SPDK_BDEV_IO_STATUS_PENDING);
+	CU_ASSERT(local_path->num_outstanding == 0);
+	CU_ASSERT(path->num_outstanding == 1);
+	CU_ASSERT(path->nvme_ch->qpair->num_outstanding == 1);
+	CU_ASSERT(primary->namespaces[0]->ana_state == SPDK_NVME_ANA_INACCESSIBLE_STATE);
+	CU_ASSERT(primary->ana_log_page_stale == true);
+
+	ut_complete_req(path->nvme_ch->qpair, SPDK_NVME_SCT_GENERIC, SPDK_NVME_SC_SUCCESS, false);
+	CU_ASSERT(g_io_status == SPDK_BDEV_IO_STATUS_SUCCESS);
+	CU_ASSERT(path->num_outstanding == 0);
+
+	/* The new I/O goes straight to the remaining path */
+	ut_submit_io(bdev_io, ch);
+	CU_ASSERT(path->num_outstanding == 1);
+
+	/* If no other path is usable, the I/O fails with the path error */
+	ut_complete_req(path->nvme_ch->qpair, SPDK_NVME_SCT_PATH,
+			SPDK_NVME_SC_ASYMMETRIC_ACCESS_TRANSITION, false);
+	CU_ASSERT(g_io_status == SPDK_BDEV_IO_STATUS_NVME_ERROR);
+	CU_ASSERT(g_io_sct == SPDK_NVME_SCT_PATH);
+	CU_ASSERT(g_io_sc == SPDK_NVME_SC_ASYMMETRIC_ACCESS_TRANSITION);
+	CU_ASSERT(path->num_outstanding == 0);
+
+	/* Errors with DNR set aren't retried on another path */
+	primary->namespaces[0]->ana_state = SPDK_NVME_ANA_OPTIMIZED_STATE;
+	secondary->namespaces[0]->ana_state = SPDK_NVME_ANA_OPTIMIZED_STATE;
+	ut_submit_io(bdev_io, ch);
+	CU_ASSERT(local_path->num_outstanding == 1);
+	ut_complete_req(local_path->nvme_ch->qpair, SPDK_NVME_SCT_PATH,
+			SPDK_NVME_SC_ASYMMETRIC_ACCESS_INACCESSIBLE, true);
+	CU_ASSERT(g_io_status == SPDK_BDEV_IO_STATUS_NVME_ERROR);
+	CU_ASSERT(path->num_outstanding == 0);
+
+	/* I/O aborted by SQ deletion is retried, each path is tried once at most */
+	primary->namespaces[0]->ana_state = SPDK_NVME_ANA_OPTIMIZED_STATE;
+	ut_submit_io(bdev_io, ch);
+	ut_complete_req(local_path->nvme_ch->qpair, SPDK_NVME_SCT_GENERIC,
+			SPDK_NVME_SC_ABORTED_SQ_DELETION, false);
+	CU_ASSERT(g_io_status == SPDK_BDEV_IO_STATUS_PENDING);
+	CU_ASSERT(path->num_outstanding == 1);
+	ut_complete_req(path->nvme_ch->qpair, SPDK_NVME_SCT_GENERIC,
+			SPDK_NVME_SC_ABORTED_SQ_DELETION, false);
+	CU_ASSERT(g_io_status == SPDK_BDEV_IO_STATUS_PENDING);
+	CU_ASSERT(local_path->num_outstanding == 1);
+	ut_complete_req(local_path->nvme_ch->qpair, SPDK_NVME_SCT_GENERIC,
+			SPDK_NVME_SC_ABORTED_SQ_DELETION, false);
+	CU_ASSERT(g_io_status == SPDK_BDEV_IO_STATUS_NVME_ERROR);
+	CU_ASSERT(g_io_sc == SPDK_NVME_SC_ABORTED_SQ_DELETION);
+
+	/* A resubmission that runs out of requests is retried by the bdev layer */
+	ut_submit_io(bdev_io, ch);
+	g_ut_submit_rc = -ENOMEM;
+	ut_complete_req(local_path->nvme_ch->qpair, SPDK_NVME_SCT_PATH,
+			SPDK_NVME_SC_ASYMMETRIC_ACCESS_TRANSITION, false);
+	g_ut_submit_rc = 0;
+	CU_ASSERT(g_io_status == SPDK_BDEV_IO_STATUS_NOMEM);
+	CU_ASSERT(local_path->num_outstanding == 0);
+	CU_ASSERT(path->num_outstanding == 0);
+
+	ut_submit_io(bdev_io, ch);
+	CU_ASSERT(path->num_outstanding == 1);
+	ut_complete_req(path->nvme_ch->qpair, SPDK_NVME_SCT_GENERIC, SPDK_NVME_SC_SUCCESS, false);
+	CU_ASSERT(g_io_status == SPDK_BDEV_IO_STATUS_SUCCESS);
+
+	free(bdev_io);
+	spdk_put_io_channel(ch);
+	poll_threads();
+
+	ut_destruct_ctrlr(secondary);
+	ut_destruct_ctrlr(primary);
+
+	ut_teardown();
+}
+
+static void
+test_multipath_add_remove_path(void)
+{
+	struct nvme_bdev_ctrlr *primary, *secondary;
+	struct nvme_io_path *local_path, *path;
+	struct nvme_io_channel *nvme_ch;
+	struct spdk_io_channel *ch;
+	struct spdk_bdev_io *bdev_io[2];
+	struct nvme_bdev nbdev;
+
+	ut_setup();
+
+	primary = ut_create_ctrlr("nvme0", NULL);
+	ut_init_nbdev(&nbdev, primary);
+	primary->mp_policy = NVME_BDEV_MP_POLICY_ROUND_ROBIN;
+
+	ch = spdk_get_io_channel(primary);
+	SPDK_CU_ASSERT_FATAL(ch != NULL);
+	nvme_ch = spdk_io_channel_get_ctx(ch);
+	local_path = &nvme_ch->local_path;
+	CU_ASSERT(nvme_ch->num_io_paths == 1);
+	bdev_io[0] = ut_alloc_bdev_io(&nbdev);
+	bdev_io[1] = ut_alloc_bdev_io(&nbdev);
+
+	ut_submit_io(bdev_io[0], ch);
+	CU_ASSERT(local_path->num_outstanding == 1);
+
+	/* A path added while I/O is outstanding is used by the next I/O */
+	secondary = ut_create_ctrlr("nvme1", primary);
+	CU_ASSERT(nvme_io_channel_add_path(nvme_ch, secondary) == 0);
+	CU_ASSERT(nvme_io_channel_add_path(nvme_ch, secondary) == 0);
+	CU_ASSERT(nvme_ch->num_io_paths == 2);
+	path = ut_get_io_path(nvme_ch, secondary);
+	SPDK_CU_ASSERT_FATAL(path != NULL);
+
+	ut_submit_io(bdev_io[1], ch);
+	CU_ASSERT(path->num_outstanding == 1);
+
+	ut_complete_req(local_path->nvme_ch->qpair, SPDK_NVME_SCT_GENERIC, SPDK_NVME_SC_SUCCESS, false);
+	CU_ASSERT(g_io_status == SPDK_BDEV_IO_STATUS_SUCCESS);
+
+	/*
+	 * Detaching the secondary removes its path from the primary's channels
+	 * while the primary is kept alive. The I/O it aborts is retried on the
+	 * remaining path.
+	 */
+	g_io_status = SPDK_BDEV_IO_STATUS_PENDING;
+	ut_destruct_ctrlr(secondary);
+	CU_ASSERT(nvme_ch->num_io_paths == 1);
+	CU_ASSERT(ut_get_io_path(nvme_ch, secondary) == NULL);
+	CU_ASSERT(nvme_ch->last_path == local_path);
+	CU_ASSERT(primary->ref == 0);
+	CU_ASSERT(TAILQ_EMPTY(&primary->paths));
+	CU_ASSERT(g_io_status == SPDK_BDEV_IO_STATUS_PENDING);
+	CU_ASSERT(local_path->num_outstanding == 1);
+
+	ut_complete_req(local_path->nvme_ch->qpair, SPDK_NVME_SCT_GENERIC, SPDK_NVME_SC_SUCCESS, false);
+	CU_ASSERT(g_io_status == SPDK_BDEV_IO_STATUS_SUCCESS);
+	CU_ASSERT(local_path->num_outstanding == 0);
+
+	free(bdev_io[0]);
+	free(bdev_io[1]);
+	spdk_put_io_channel(ch);
+	poll_threads();
+
+	ut_destruct_ctrlr(primary);
+
+	ut_teardown();
+}
+
+static void
+test_multipath_remove_primary(void)
+{
+	struct nvme_bdev_ctrlr *primary, *secondary;
+	struct spdk_io_channel *ch;
+
+	ut_setup();
+
+	primary = ut_create_ctrlr("nvme0", NULL);
+	secondary = ut_create_ctrlr("nvme1", primary);
+
+	ch = spdk_get_io_channel(primary);
+	SPDK_CU_ASSERT_FATAL(ch != NULL);
+
+	/*
+	 * The primary is destructed while the secondary's removal still walks its
+	 * channels, so it has to wait for the walk to finish.
+	 */
+	secondary->destruct = true;
+	nvme_bdev_ctrlr_destruct(secondary);
+	CU_ASSERT(primary->ref == 1);
+
+	primary->destruct = true;
+	spdk_put_io_channel(ch);
+	poll_threads();
+
+	CU_ASSERT(TAILQ_EMPTY(&g_nvme_bdev_ctrlrs));
+
+	ut_teardown();
+}
+
+int
+main(int argc, const char **argv)
+{
+	CU_pSuite	suite = NULL;
+	unsigned int	num_failures;
+
+	CU_set_error_action(CUEA_ABORT);
+	CU_initialize_registry();
+
+	suite = CU_add_suite("nvme", NULL, NULL);
+
+	CU_ADD_TEST(suite, test_multipath_policy);
+	CU_ADD_TEST(suite, test_multipath_round_robin_io);
+	CU_ADD_TEST(suite, test_multipath_ana_filter);
+	CU_ADD_TEST(suite, test_multipath_failover);
+	CU_ADD_TEST(suite, test_multipath_add_remove_path);
+	CU_ADD_TEST(suite, test_multipath_remove_primary);
+
+	CU_basic_set_mode(CU_BRM_VERBOSE);
+	CU_basic_run_tests();
+	num_failures = CU_get_number_of_failures();
+	CU_cleanup_registry();
+
+	return num_failures;
+}
@@ -102,6 +102,8 @@ DEFINE_STUB(spdk_bdev_register, int, (struct spdk_bdev *bdev), 0);
 DEFINE_STUB(spdk_bdev_io_type_supported, bool, (struct spdk_bdev *bdev,
 		enum spdk_bdev_io_type io_type), true);
 DEFINE_STUB_V(spdk_bdev_close, (struct spdk_bdev_desc *desc));
+DEFINE_STUB_V(spdk_bdev_destruct_done, (struct spdk_bdev *bdev, int bdeverrno));
+DEFINE_STUB(spdk_bdev_get_buf_align, size_t, (const struct spdk_bdev *bdev), 0);
 DEFINE_STUB(spdk_bdev_flush_blocks, int, (struct spdk_bdev_desc *desc, struct spdk_io_channel *ch,
 		uint64_t offset_blocks, uint64_t num_blocks, spdk_bdev_io_completion_cb cb,
 		void *cb_arg), 0);
@@ -114,6 +116,7 @@ DEFINE_STUB_V(spdk_jsonrpc_end_result, (struct spdk_jsonrpc_request *request,
 					struct spdk_json_write_ctx *w));
 DEFINE_STUB(spdk_json_decode_string, int, (const struct spdk_json_val *val, void *out), 0);
 DEFINE_STUB(spdk_json_decode_uint32, int, (const struct spdk_json_val *val, void *out), 0);
+DEFINE_STUB(spdk_json_decode_uint64, int, (const struct spdk_json_val *val, void *out), 0);
 DEFINE_STUB(spdk_json_decode_array, int, (const struct spdk_json_val *values,
 		spdk_json_decode_fn decode_func,
 		void *out, size_t max_size, size_t *out_size, size_t stride), 0);
@@ -126,6 +129,9 @@ DEFINE_STUB(spdk_json_write_array_begin, int, (struct spdk_json_write_ctx *w), 0
 DEFINE_STUB(spdk_json_write_array_end, int, (struct spdk_json_write_ctx *w), 0);
 DEFINE_STUB(spdk_json_write_named_array_begin, int, (struct spdk_json_write_ctx *w,
 		const char *name), 0);
+DEFINE_STUB(spdk_json_write_string, int, (struct spdk_json_write_ctx *w, const char *val), 0);
+DEFINE_STUB(spdk_json_write_named_uint64, int, (struct spdk_json_write_ctx *w, const char *name,
+		uint64_t val), 0);
 DEFINE_STUB(spdk_json_write_bool, int, (struct spdk_json_write_ctx *w, bool val), 0);
 DEFINE_STUB(spdk_json_write_null, int, (struct spdk_json_write_ctx *w), 0);
 DEFINE_STUB(spdk_strerror, const char *, (int errnum), NULL);
@@ -379,6 +385,11 @@ spdk_sprintf_alloc(const char *format, ...)
 int spdk_json_write_named_uint32(struct spdk_json_write_ctx *w, const char *name, uint32_t val)
 {
 	struct rpc_bdev_raid_create *req = g_rpc_req;
+
+	/* In the multi raid test the request is the one of bdev_raid_get_bdevs */
+	if (g_test_multi_raids) {
+		return 0;
+	}
 	if (strcmp(name, "strip_size_kb") == 0) {
 		CU_ASSERT(req->strip_size_kb == val);
 	} else if (strcmp(name, "blocklen_shift") == 0) {
@@ -398,6 +409,15 @@ int spdk_json_write_named_uint32(struct spdk_json_write_ctx *w, const char *name
 int spdk_json_write_named_string(struct spdk_json_write_ctx *w, const char *name, const char *val)
 {
 	struct rpc_bdev_raid_create *req = g_rpc_req;
+
+	if (g_test_multi_raids) {
+		if (strcmp(name, "name") == 0) {
+			g_get_raids_output[g_get_raids_count] = strdup(val);
+			SPDK_CU_ASSERT_FATAL(g_get_raids_output[g_get_raids_count] != NULL);
+			g_get_raids_count++;
+		}
+		return 0;
+	}
 	if (strcmp(name, "raid_level") == 0) {
 		CU_ASSERT(strcmp(val, raid_bdev_level_to_str(req->level)) == 0);
 	}
@@ -563,18 +583,6 @@ spdk_jsonrpc_begin_result(struct spdk_jsonrpc_request *request)
 	return (void *)1;
 }
 
-int
-spdk_json_write_string(struct spdk_json_write_ctx *w, const char *val)
-{
-	if (g_test_multi_raids) {
-		g_get_raids_output[g_get_raids_count] = strdup(val);
-		SPDK_CU_ASSERT_FATAL(g_get_raids_output[g_get_raids_count] != NULL);
-		g_get_raids_count++;
-	}
-
-	return 0;
-}
-
 void
 spdk_jsonrpc_send_error_response(struct spdk_jsonrpc_request *request,
 				 int error_code, const char *msg)
@@ -1939,7 +1947,7 @@ test_multi_raid_with_io(void)
 	char name[16];
 	uint8_t bbdev_idx = 0;
 	struct raid_bdev *pbdev;
-	struct spdk_io_channel *ch;
+	struct spdk_io_channel **ch;
 	struct raid_bdev_io_channel *ch_ctx = NULL;
 	struct spdk_bdev_io *bdev_io;
 	uint64_t io_len;
@@ -1952,13 +1960,16 @@ test_multi_raid_with_io(void)
 	construct_req = calloc(g_max_raids, sizeof(struct rpc_bdev_raid_create));
 	SPDK_CU_ASSERT_FATAL(construct_req != NULL);
 	CU_ASSERT(raid_bdev_init() == 0);
-	ch = calloc(g_max_raids, sizeof(struct spdk_io_channel) + sizeof(struct raid_bdev_io_channel));
+	ch = calloc(g_max_raids, sizeof(struct spdk_io_channel *));
 	SPDK_CU_ASSERT_FATAL(ch != NULL);
+	for (i = 0; i < g_max_raids; i++) {
+		ch[i] = calloc(1, sizeof(struct spdk_io_channel) + sizeof(struct raid_bdev_io_channel));
+		SPDK_CU_ASSERT_FATAL(ch[i] != NULL);
+	}
 
 	ch_b = calloc(1, sizeof(struct spdk_io_channel) + sizeof(struct spdk_bdev_channel));
 	SPDK_CU_ASSERT_FATAL(ch_b != NULL);
 	ch_b_ctx = spdk_io_channel_get_ctx(ch_b);
-	ch_b_ctx->channel = ch;
 
 	for (i = 0; i < g_max_raids; i++) {
 		snprintf(name, 16, "%s%u", "raid", i);
@@ -1976,7 +1987,7 @@ test_multi_raid_with_io(void)
 			}
 		}
 		CU_ASSERT(pbdev != NULL);
-		ch_ctx = spdk_io_channel_get_ctx(&ch[i]);
+		ch_ctx = spdk_io_channel_get_ctx(ch[i]);
 		SPDK_CU_ASSERT_FATAL(ch_ctx != NULL);
 		CU_ASSERT(raid_bdev_create_cb(pbdev, ch_ctx) == 0);
 		SPDK_CU_ASSERT_FATAL(ch_ctx->base_channel != NULL);
@@ -2001,9 +2012,11 @@ test_multi_raid_with_io(void)
 				break;
 			}
 		}
+		ch_b_ctx->channel = ch[i];
+		ch_ctx = spdk_io_channel_get_ctx(ch[i]);
 		bdev_io_initialize(bdev_io, ch_b, &pbdev->bdev, lba, io_len, iotype);
 		CU_ASSERT(pbdev != NULL);
-		raid_bdev_submit_request(ch, bdev_io);
+		raid_bdev_submit_request(ch[i], bdev_io);
 		verify_io(bdev_io, g_max_base_drives, ch_ctx, pbdev,
 			  g_child_io_status_flag);
 		bdev_io_cleanup(bdev_io);
@@ -2016,7 +2029,7 @@ test_multi_raid_with_io(void)
 			}
 		}
 		CU_ASSERT(pbdev != NULL);
-		ch_ctx = spdk_io_channel_get_ctx(&ch[i]);
+		ch_ctx = spdk_io_channel_get_ctx(ch[i]);
 		SPDK_CU_ASSERT_FATAL(ch_ctx != NULL);
 		raid_bdev_destroy_cb(pbdev, ch_ctx);
 		CU_ASSERT(ch_ctx->base_channel == NULL);
@@ -2032,6 +2045,9 @@ test_multi_raid_with_io(void)
 		free_test_req(&construct_req[i]);
 	}
 	free(construct_req);
+	for (i = 0; i < g_max_raids; i++) {
+		free(ch[i]);
+	}
 	free(ch);
 	free(ch_b);
 	base_bdevs_cleanup();
@@ -2205,6 +2221,8 @@ test_raid_level_conversions(void)
 	CU_ASSERT(raid_bdev_parse_raid_level("0") == RAID0);
 	CU_ASSERT(raid_bdev_parse_raid_level("raid0") == RAID0);
 	CU_ASSERT(raid_bdev_parse_raid_level("RAID0") == RAID0);
+	CU_ASSERT(raid_bdev_parse_raid_level("1") == RAID1);
+	CU_ASSERT(raid_bdev_parse_raid_level("raid10") == RAID10);
 
 	raid_str = raid_bdev_level_to_str(INVALID_RAID_LEVEL);
 	CU_ASSERT(raid_str != NULL && strlen(raid_str) == 0);
@@ -2212,6 +2230,8 @@ test_raid_level_conversions(void)
 	CU_ASSERT(raid_str != NULL && strlen(raid_str) == 0);
 	raid_str = raid_bdev_level_to_str(RAID0);
 	CU_ASSERT(raid_str != NULL && strcmp(raid_str, "raid0") == 0);
+	raid_str = raid_bdev_level_to_str(RAID10);
+	CU_ASSERT(raid_str != NULL && strcmp(raid_str, "raid10") == 0);
 }
 
 int main(int argc, char **argv)
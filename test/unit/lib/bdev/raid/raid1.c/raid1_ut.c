@@ -0,0 +1,738 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE AiRE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "spdk/stdinc.h"
+#include "spdk_cunit.h"
+#include "spdk/env.h"
+#include "spdk_internal/mock.h"
+
+#include "common/lib/ut_multithread.c"
+
+#include "bdev/raid/raid1.c"
+
+DEFINE_STUB_V(raid_bdev_module_list_add, (struct raid_bdev_module *raid_module));
+DEFINE_STUB_V(raid_bdev_queue_io_wait, (struct raid_bdev_io *raid_io, struct spdk_bdev *bdev,
+					struct spdk_io_channel *ch, spdk_bdev_io_wait_cb cb_fn));
+DEFINE_STUB(spdk_bdev_queue_io_wait, int, (struct spdk_bdev *bdev, struct spdk_io_channel *ch,
+		struct spdk_bdev_io_wait_entry *entry), 0);
+
+#define MAX_BASE_BDEVS 8
+
+struct base_io {
+	spdk_bdev_io_completion_cb cb;
+	void *cb_arg;
+	struct spdk_bdev_io *bdev_io;
+	TAILQ_ENTRY(base_io) link;
+};
+
+static TAILQ_HEAD(, base_io) g_base_ios = TAILQ_HEAD_INITIALIZER(g_base_ios);
+static struct spdk_bdev g_base_bdevs[MAX_BASE_BDEVS];
+static uint8_t *g_base_bdev_data[MAX_BASE_BDEVS];
+static uint32_t g_blocklen = 512;
+static enum spdk_bdev_io_status g_io_status;
+static int g_io_completions;
+static int g_base_reads[MAX_BASE_BDEVS];
+static int g_base_writes[MAX_BASE_BDEVS];
+static int g_base_unmaps[MAX_BASE_BDEVS];
+static bool g_fail_base_io;
+static int g_rebuild_completions;
+static int g_rebuild_status;
+
+void
+raid_bdev_io_complete(struct raid_bdev_io *raid_io, enum spdk_bdev_io_status status)
+{
+	g_io_completions++;
+	g_io_status = status;
+}
+
+bool
+raid_bdev_io_complete_part(struct raid_bdev_io *raid_io, uint64_t completed,
+			   enum spdk_bdev_io_status status)
+{
+	SPDK_CU_ASSERT_FATAL(raid_io->base_bdev_io_remaining >= completed);
+	raid_io->base_bdev_io_remaining -= completed;
+
+	if (status != SPDK_BDEV_IO_STATUS_SUCCESS) {
+		raid_io->base_bdev_io_status = status;
+	}
+
+	if (raid_io->base_bdev_io_remaining == 0) {
+		raid_bdev_io_complete(raid_io, raid_io->base_bdev_io_status);
+		return true;
+	}
+
+	return false;
+}
+
+void
+raid_bdev_rebuild_request_complete(struct raid_bdev_rebuild_request *rebuild_req, int status)
+{
+	g_rebuild_completions++;
+	if (status != 0) {
+		g_rebuild_status = status;
+	}
+}
+
+void
+spdk_bdev_free_io(struct spdk_bdev_io *bdev_io)
+{
+	free(bdev_io);
+}
+
+/* Base bdev descriptors are encoded as the base bdev index + 1 */
+static inline uint8_t
+desc_to_idx(struct spdk_bdev_desc *desc)
+{
+	return (uintptr_t)desc - 1;
+}
+
+static void
+queue_base_io(struct spdk_bdev_desc *desc, spdk_bdev_io_completion_cb cb, void *cb_arg)
+{
+	struct base_io *base_io = calloc(1, sizeof(*base_io));
+
+	SPDK_CU_ASSERT_FATAL(base_io != NULL);
+	base_io->bdev_io = calloc(1, sizeof(*base_io->bdev_io));
+	SPDK_CU_ASSERT_FATAL(base_io->bdev_io != NULL);
+	base_io->bdev_io->bdev = &g_base_bdevs[desc_to_idx(desc)];
+	base_io->cb = cb;
+	base_io->cb_arg = cb_arg;
+	TAILQ_INSERT_TAIL(&g_base_ios, base_io, link);
+}
+
+int
+spdk_bdev_readv_blocks(struct spdk_bdev_desc *desc, struct spdk_io_channel *ch,
+		       struct iovec *iov, int iovcnt,
+		       uint64_t offset_blocks, uint64_t num_blocks,
+		       spdk_bdev_io_completion_cb cb, void *cb_arg)
+{
+	struct iovec buf_iov = {
+		.iov_base = g_base_bdev_data[desc_to_idx(desc)] + offset_blocks * g_blocklen,
+		.iov_len = num_blocks * g_blocklen,
+	};
+
+	CU_ASSERT(ch != NULL);
+	CU_ASSERT(spdk_iovcpy(&buf_iov, 1, iov, iovcnt) == buf_iov.iov_len);
+	g_base_reads[desc_to_idx(desc)]++;
+	queue_base_io(desc, cb, cb_arg);
+
+	return 0;
+}
+
+int
+spdk_bdev_writev_blocks(struct spdk_bdev_desc *desc, struct spdk_io_channel *ch,
+			struct iovec *iov, int iovcnt,
+			uint64_t offset_blocks, uint64_t num_blocks,
+			spdk_bdev_io_completion_cb cb, void *cb_arg)
+{
+	struct iovec buf_iov = {
+		.iov_base = g_base_bdev_data[desc_to_idx(desc)] + offset_blocks * g_blocklen,
+		.iov_len = num_blocks * g_blocklen,
+	};
+
+	CU_ASSERT(ch != NULL);
+	CU_ASSERT(spdk_iovcpy(iov, iovcnt, &buf_iov, 1) == buf_iov.iov_len);
+	g_base_writes[desc_to_idx(desc)]++;
+	queue_base_io(desc, cb, cb_arg);
+
+	return 0;
+}
+
+int
+spdk_bdev_read_blocks(struct spdk_bdev_desc *desc, struct spdk_io_channel *ch, void *buf,
+		      uint64_t offset_blocks, uint64_t num_blocks,
+		      spdk_bdev_io_completion_cb cb, void *cb_arg)
+{
+	struct iovec iov = { .iov_base = buf, .iov_len = num_blocks * g_blocklen };
+
+	return spdk_bdev_readv_blocks(desc, ch, &iov, 1, offset_blocks, num_blocks, cb, cb_arg);
+}
+
+int
+spdk_bdev_write_blocks(struct spdk_bdev_desc *desc, struct spdk_io_channel *ch, void *buf,
+		       uint64_t offset_blocks, uint64_t num_blocks,
+		       spdk_bdev_io_completion_cb cb, void *cb_arg)
+{
+	struct iovec iov = { .iov_base = buf, .iov_len = num_blocks * g_blocklen };
+
+	return spdk_bdev_writev_blocks(desc, ch, &iov, 1, offset_blocks, num_blocks, cb, cb_arg);
+}
+
+int
+spdk_bdev_unmap_blocks(struct spdk_bdev_desc *desc, struct spdk_io_channel *ch,
+		       uint64_t offset_blocks, uint64_t num_blocks,
+		       spdk_bdev_io_completion_cb cb, void *cb_arg)
+{
+	CU_ASSERT(ch != NULL);
+	memset(g_base_bdev_data[desc_to_idx(desc)] + offset_blocks * g_blocklen, 0,
+	       num_blocks * g_blocklen);
+	g_base_unmaps[desc_to_idx(desc)]++;
+	queue_base_io(desc, cb, cb_arg);
+
+	return 0;
+}
+
+int
+spdk_bdev_flush_blocks(struct spdk_bdev_desc *desc, struct spdk_io_channel *ch,
+		       uint64_t offset_blocks, uint64_t num_blocks,
+		       spdk_bdev_io_completion_cb cb, void *cb_arg)
+{
+	CU_ASSERT(ch != NULL);
+	queue_base_io(desc, cb, cb_arg);
+
+	return 0;
+}
+
+static void
+complete_base_ios(void)
+{
+	struct base_io *base_io;
+
+	while ((base_io = TAILQ_FIRST(&g_base_ios))) {
+		TAILQ_REMOVE(&g_base_ios, base_io, link);
+		base_io->cb(base_io->bdev_io, !g_fail_base_io, base_io->cb_arg);
+		free(base_io);
+	}
+}
+
+static void
+reset_counters(void)
+{
+	memset(g_base_reads, 0, sizeof(g_base_reads));
+	memset(g_base_writes, 0, sizeof(g_base_writes));
+	memset(g_base_unmaps, 0, sizeof(g_base_unmaps));
+	g_io_completions = 0;
+}
+
+struct raid1_test_ctx {
+	struct raid_bdev raid_bdev;
+	struct raid_base_bdev_info base_bdev_info[MAX_BASE_BDEVS];
+	struct spdk_io_channel *base_channel[MAX_BASE_BDEVS];
+	struct raid_bdev_io_channel raid_ch;
+	uint8_t *image;
+};
+
+static void
+raid1_test_init(struct raid1_test_ctx *ctx, struct raid_bdev_module *module,
+		uint8_t num_base_bdevs, uint64_t base_bdev_blockcnt, uint32_t strip_size)
+{
+	struct raid_bdev *raid_bdev = &ctx->raid_bdev;
+	uint8_t i;
+
+	SPDK_CU_ASSERT_FATAL(num_base_bdevs <= MAX_BASE_BDEVS);
+	memset(ctx, 0, sizeof(*ctx));
+
+	raid_bdev->module = module;
+	raid_bdev->num_base_bdevs = num_base_bdevs;
+	raid_bdev->base_bdev_info = ctx->base_bdev_info;
+	raid_bdev->strip_size = strip_size;
+	raid_bdev->strip_size_shift = spdk_u32log2(strip_size);
+	raid_bdev->blocklen_shift = spdk_u32log2(g_blocklen);
+	raid_bdev->bdev.blocklen = g_blocklen;
+
+	for (i = 0; i < num_base_bdevs; i++) {
+		g_base_bdevs[i].blockcnt = base_bdev_blockcnt;
+		g_base_bdevs[i].blocklen = g_blocklen;
+		g_base_bdev_data[i] = calloc(base_bdev_blockcnt, g_blocklen);
+		SPDK_CU_ASSERT_FATAL(g_base_bdev_data[i] != NULL);
+		ctx->base_bdev_info[i].bdev = &g_base_bdevs[i];
+		ctx->base_bdev_info[i].desc = (struct spdk_bdev_desc *)(uintptr_t)(i + 1);
+		ctx->base_channel[i] = (struct spdk_io_channel *)(uintptr_t)(i + 1);
+	}
+
+	SPDK_CU_ASSERT_FATAL(module->start(raid_bdev) == 0);
+
+	ctx->raid_ch.base_channel = ctx->base_channel;
+	ctx->raid_ch.num_channels = num_base_bdevs;
+	ctx->raid_ch.module_channel = module->get_io_channel(raid_bdev);
+	SPDK_CU_ASSERT_FATAL(ctx->raid_ch.module_channel != NULL);
+
+	ctx->image = calloc(raid_bdev->bdev.blockcnt, g_blocklen);
+	SPDK_CU_ASSERT_FATAL(ctx->image != NULL);
+
+	reset_counters();
+}
+
+static void
+raid1_test_fini(struct raid1_test_ctx *ctx)
+{
+	uint8_t i;
+
+	spdk_put_io_channel(ctx->raid_ch.module_channel);
+	ctx->raid_bdev.module->stop(&ctx->raid_bdev);
+	poll_threads();
+
+	for (i = 0; i < ctx->raid_bdev.num_base_bdevs; i++) {
+		free(g_base_bdev_data[i]);
+		g_base_bdev_data[i] = NULL;
+	}
+	free(ctx->image);
+}
+
+static struct spdk_bdev_io *
+raid1_test_submit(struct raid1_test_ctx *ctx, enum spdk_bdev_io_type type,
+		  uint64_t offset_blocks, uint64_t num_blocks, void *buf)
+{
+	struct spdk_bdev_io *bdev_io;
+	struct raid_bdev_io *raid_io;
+
+	bdev_io = calloc(1, sizeof(*bdev_io) + sizeof(*raid_io) + sizeof(struct iovec));
+	SPDK_CU_ASSERT_FATAL(bdev_io != NULL);
+	raid_io = (struct raid_bdev_io *)bdev_io->driver_ctx;
+
+	bdev_io->type = type;
+	bdev_io->u.bdev.iovs = (struct iovec *)(raid_io + 1);
+	bdev_io->u.bdev.iovs[0].iov_base = buf;
+	bdev_io->u.bdev.iovs[0].iov_len = num_blocks * g_blocklen;
+	bdev_io->u.bdev.iovcnt = 1;
+	bdev_io->u.bdev.offset_blocks = offset_blocks;
+	bdev_io->u.bdev.num_blocks = num_blocks;
+	raid_io->raid_bdev = &ctx->raid_bdev;
+	raid_io->raid_ch = &ctx->raid_ch;
+	raid_io->base_bdev_io_status = SPDK_BDEV_IO_STATUS_SUCCESS;
+
+	if (type == SPDK_BDEV_IO_TYPE_READ || type == SPDK_BDEV_IO_TYPE_WRITE) {
+		raid1_submit_rw_request(raid_io);
+	} else {
+		raid1_submit_null_payload_request(raid_io);
+	}
+
+	return bdev_io;
+}
+
+static void
+raid1_test_io(struct raid1_test_ctx *ctx, enum spdk_bdev_io_type type,
+	      uint64_t offset_blocks, uint64_t num_blocks, void *buf)
+{
+	struct spdk_bdev_io *bdev_io;
+
+	g_io_completions = 0;
+	bdev_io = raid1_test_submit(ctx, type, offset_blocks, num_blocks, buf);
+	complete_base_ios();
+	CU_ASSERT(g_io_completions == 1);
+	free(bdev_io);
+}
+
+/* Write the whole raid bdev in strip sized chunks, with random data */
+static void
+raid1_test_fill(struct raid1_test_ctx *ctx)
+{
+	struct raid_bdev *raid_bdev = &ctx->raid_bdev;
+	uint64_t offset;
+	uint64_t i;
+
+	for (i = 0; i < raid_bdev->bdev.blockcnt * g_blocklen; i++) {
+		ctx->image[i] = rand();
+	}
+
+	for (offset = 0; offset < raid_bdev->bdev.blockcnt; offset += raid_bdev->strip_size) {
+		raid1_test_io(ctx, SPDK_BDEV_IO_TYPE_WRITE, offset, raid_bdev->strip_size,
+			      ctx->image + offset * g_blocklen);
+		CU_ASSERT(g_io_status == SPDK_BDEV_IO_STATUS_SUCCESS);
+	}
+}
+
+static void
+raid1_test_verify(struct raid1_test_ctx *ctx)
+{
+	struct raid_bdev *raid_bdev = &ctx->raid_bdev;
+	uint64_t strip_bytes = raid_bdev->strip_size * g_blocklen;
+	uint8_t *buf;
+	uint64_t offset;
+
+	buf = malloc(strip_bytes);
+	SPDK_CU_ASSERT_FATAL(buf != NULL);
+
+	for (offset = 0; offset < raid_bdev->bdev.blockcnt; offset += raid_bdev->strip_size) {
+		raid1_test_io(ctx, SPDK_BDEV_IO_TYPE_READ, offset, raid_bdev->strip_size, buf);
+		CU_ASSERT(g_io_status == SPDK_BDEV_IO_STATUS_SUCCESS);
+		CU_ASSERT(memcmp(buf, ctx->image + offset * g_blocklen, strip_bytes) == 0);
+	}
+
+	free(buf);
+}
+
+static void
+test_raid1_start(void)
+{
+	struct raid1_test_ctx ctx;
+	struct raid1_info *r1info;
+
+	raid1_test_init(&ctx, &g_raid1_module, 3, 100, 8);
+	r1info = ctx.raid_bdev.module_private;
+	CU_ASSERT(r1info->num_mirrors == 3);
+	CU_ASSERT(r1info->num_groups == 1);
+	CU_ASSERT(ctx.raid_bdev.bdev.blockcnt == 100);
+	CU_ASSERT(ctx.raid_bdev.bdev.split_on_optimal_io_boundary == false);
+	raid1_test_fini(&ctx);
+
+	raid1_test_init(&ctx, &g_raid10_module, 6, 100, 8);
+	r1info = ctx.raid_bdev.module_private;
+	CU_ASSERT(r1info->num_mirrors == 2);
+	CU_ASSERT(r1info->num_groups == 3);
+	CU_ASSERT(ctx.raid_bdev.bdev.blockcnt == 96 * 3);
+	CU_ASSERT(ctx.raid_bdev.bdev.optimal_io_boundary == 8);
+	CU_ASSERT(ctx.raid_bdev.bdev.split_on_optimal_io_boundary == true);
+	raid1_test_fini(&ctx);
+
+	/* RAID10 needs an even number of base bdevs */
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.raid_bdev.num_base_bdevs = 5;
+	CU_ASSERT(raid10_start(&ctx.raid_bdev) == -EINVAL);
+}
+
+static void
+test_raid1_io(void)
+{
+	struct {
+		struct raid_bdev_module *module;
+		uint8_t num_base_bdevs;
+	} configs[] = {
+		{ &g_raid1_module, 2 },
+		{ &g_raid1_module, 3 },
+		{ &g_raid10_module, 4 },
+		{ &g_raid10_module, 6 },
+	};
+	struct raid1_test_ctx ctx;
+	size_t c;
+	uint8_t i;
+
+	srand(0);
+
+	for (c = 0; c < SPDK_COUNTOF(configs); c++) {
+		struct raid1_info *r1info;
+
+		raid1_test_init(&ctx, configs[c].module, configs[c].num_base_bdevs, 64, 8);
+		r1info = ctx.raid_bdev.module_private;
+
+		raid1_test_fill(&ctx);
+
+		/* Each write goes to all mirrors, the mirrors hold identical data */
+		for (i = 0; i < configs[c].num_base_bdevs; i++) {
+			CU_ASSERT(g_base_writes[i] == g_base_writes[0]);
+			CU_ASSERT(memcmp(g_base_bdev_data[i],
+					 g_base_bdev_data[i - i % r1info->num_mirrors],
+					 64 * g_blocklen) == 0);
+		}
+		CU_ASSERT(g_base_writes[0] == 64 / 8);
+
+		raid1_test_verify(&ctx);
+
+		/* Each mirror can serve all the reads in degraded mode */
+		for (i = 0; i < configs[c].num_base_bdevs; i++) {
+			ctx.base_channel[i] = NULL;
+			reset_counters();
+			raid1_test_verify(&ctx);
+			CU_ASSERT(g_base_reads[i] == 0);
+			ctx.base_channel[i] = (struct spdk_io_channel *)(uintptr_t)(i + 1);
+		}
+
+		/* Writes in degraded mode skip the missing mirror */
+		ctx.base_channel[1] = NULL;
+		reset_counters();
+		raid1_test_fill(&ctx);
+		CU_ASSERT(g_base_writes[1] == 0);
+		CU_ASSERT(g_base_writes[0] > 0);
+		raid1_test_verify(&ctx);
+		ctx.base_channel[1] = (struct spdk_io_channel *)(uintptr_t)2;
+
+		raid1_test_fini(&ctx);
+	}
+}
+
+static void
+test_raid1_read_balancing(void)
+{
+	struct raid1_test_ctx ctx;
+	struct raid1_io_channel *r1ch;
+	struct spdk_bdev_io *bdev_io[12];
+	uint8_t buf[512];
+	int i;
+
+	raid1_test_init(&ctx, &g_raid1_module, 2, 64, 8);
+	r1ch = spdk_io_channel_get_ctx(ctx.raid_ch.module_channel);
+
+	/* Reads are spread evenly between idle mirrors */
+	for (i = 0; i < 8; i++) {
+		bdev_io[i] = raid1_test_submit(&ctx, SPDK_BDEV_IO_TYPE_READ, i, 1, buf);
+	}
+	CU_ASSERT(g_base_reads[0] == 4);
+	CU_ASSERT(g_base_reads[1] == 4);
+	CU_ASSERT(r1ch->slots[0].outstanding == 4);
+	CU_ASSERT(r1ch->slots[1].outstanding == 4);
+	complete_base_ios();
+	CU_ASSERT(g_io_completions == 8);
+	CU_ASSERT(r1ch->slots[0].outstanding == 0);
+	CU_ASSERT(r1ch->slots[1].outstanding == 0);
+	for (i = 0; i < 8; i++) {
+		free(bdev_io[i]);
+	}
+
+	/* Reads go to the mirror with the shorter queue */
+	reset_counters();
+	r1ch->slots[0].outstanding = 10;
+	for (i = 0; i < 8; i++) {
+		bdev_io[i] = raid1_test_submit(&ctx, SPDK_BDEV_IO_TYPE_READ, i, 1, buf);
+	}
+	CU_ASSERT(g_base_reads[0] == 0);
+	CU_ASSERT(g_base_reads[1] == 8);
+	CU_ASSERT(r1ch->slots[1].outstanding == 8);
+
+	/* Once the queues even out, both mirrors are used again */
+	for (i = 8; i < 12; i++) {
+		bdev_io[i] = raid1_test_submit(&ctx, SPDK_BDEV_IO_TYPE_READ, i, 1, buf);
+	}
+	CU_ASSERT(g_base_reads[0] == 1);
+	CU_ASSERT(g_base_reads[1] == 11);
+	r1ch->slots[0].outstanding -= 10;
+	complete_base_ios();
+	CU_ASSERT(r1ch->slots[0].outstanding == 0);
+	CU_ASSERT(r1ch->slots[1].outstanding == 0);
+	for (i = 0; i < 12; i++) {
+		free(bdev_io[i]);
+	}
+
+	/*
+	 * A replacement base bdev starts with an empty queue, IOs still outstanding
+	 * on the base bdev it replaced don't count anymore.
+	 */
+	reset_counters();
+	for (i = 0; i < 4; i++) {
+		bdev_io[i] = raid1_test_submit(&ctx, SPDK_BDEV_IO_TYPE_READ, i, 1, buf);
+	}
+	CU_ASSERT(r1ch->slots[0].outstanding == 2);
+	g_base_bdev_data[2] = g_base_bdev_data[0];
+	ctx.base_bdev_info[0].bdev = &g_base_bdevs[2];
+	ctx.base_bdev_info[0].desc = (struct spdk_bdev_desc *)(uintptr_t)3;
+	for (i = 4; i < 8; i++) {
+		bdev_io[i] = raid1_test_submit(&ctx, SPDK_BDEV_IO_TYPE_READ, i, 1, buf);
+	}
+	CU_ASSERT(g_base_reads[2] == 3);
+	CU_ASSERT(g_base_reads[1] == 3);
+	CU_ASSERT(r1ch->slots[0].outstanding == 3);
+	complete_base_ios();
+	CU_ASSERT(g_io_completions == 8);
+	CU_ASSERT(r1ch->slots[0].outstanding == 0);
+	CU_ASSERT(r1ch->slots[1].outstanding == 0);
+	for (i = 0; i < 8; i++) {
+		free(bdev_io[i]);
+	}
+	ctx.base_bdev_info[0].bdev = &g_base_bdevs[0];
+	ctx.base_bdev_info[0].desc = (struct spdk_bdev_desc *)(uintptr_t)1;
+	g_base_bdev_data[2] = NULL;
+
+	/* Failed base IO fails the read */
+	g_fail_base_io = true;
+	raid1_test_io(&ctx, SPDK_BDEV_IO_TYPE_READ, 0, 1, buf);
+	CU_ASSERT(g_io_status == SPDK_BDEV_IO_STATUS_FAILED);
+	g_fail_base_io = false;
+
+	raid1_test_fini(&ctx);
+}
+
+static void
+test_raid1_null_payload(void)
+{
+	struct raid1_test_ctx ctx;
+	uint8_t i;
+
+	/* Unmap spanning all mirror groups of a RAID10 */
+	raid1_test_init(&ctx, &g_raid10_module, 6, 64, 8);
+	raid1_test_fill(&ctx);
+
+	reset_counters();
+	raid1_test_io(&ctx, SPDK_BDEV_IO_TYPE_UNMAP, 4, 40, NULL);
+	CU_ASSERT(g_io_status == SPDK_BDEV_IO_STATUS_SUCCESS);
+	for (i = 0; i < 6; i++) {
+		CU_ASSERT(g_base_unmaps[i] == 1);
+	}
+	memset(ctx.image + 4 * g_blocklen, 0, 40 * g_blocklen);
+	raid1_test_verify(&ctx);
+
+	/* Unmap within a single strip goes to one mirror group only */
+	reset_counters();
+	raid1_test_io(&ctx, SPDK_BDEV_IO_TYPE_UNMAP, 58, 2, NULL);
+	CU_ASSERT(g_base_unmaps[2] == 1);
+	CU_ASSERT(g_base_unmaps[3] == 1);
+	CU_ASSERT(g_base_unmaps[0] + g_base_unmaps[1] + g_base_unmaps[4] + g_base_unmaps[5] == 0);
+	memset(ctx.image + 58 * g_blocklen, 0, 2 * g_blocklen);
+	raid1_test_verify(&ctx);
+
+	/* Flush with a missing mirror */
+	ctx.base_channel[4] = NULL;
+	raid1_test_io(&ctx, SPDK_BDEV_IO_TYPE_FLUSH, 0, ctx.raid_bdev.bdev.blockcnt, NULL);
+	CU_ASSERT(g_io_status == SPDK_BDEV_IO_STATUS_SUCCESS);
+
+	raid1_test_fini(&ctx);
+}
+
+static void
+raid1_test_rebuild(struct raid1_test_ctx *ctx, uint8_t target, uint64_t unit_blocks)
+{
+	struct raid_bdev_rebuild_request rebuild_req = {};
+	uint64_t offset;
+
+	rebuild_req.raid_bdev = &ctx->raid_bdev;
+	rebuild_req.raid_ch = &ctx->raid_ch;
+	rebuild_req.target_idx = target;
+	rebuild_req.buf = calloc(unit_blocks, g_blocklen);
+	SPDK_CU_ASSERT_FATAL(rebuild_req.buf != NULL);
+
+	g_rebuild_completions = 0;
+	g_rebuild_status = 0;
+
+	for (offset = 0; offset < ctx->raid_bdev.bdev.blockcnt; offset += unit_blocks) {
+		rebuild_req.offset_blocks = offset;
+		rebuild_req.num_blocks = spdk_min(unit_blocks, ctx->raid_bdev.bdev.blockcnt - offset);
+		rebuild_req.base_bdev_io_submitted = 0;
+		CU_ASSERT(raid1_submit_rebuild_request(&rebuild_req) == 0);
+		complete_base_ios();
+		ctx->raid_ch.rebuild_offset = offset + rebuild_req.num_blocks;
+	}
+
+	CU_ASSERT(g_rebuild_completions == (int)SPDK_CEIL_DIV(ctx->raid_bdev.bdev.blockcnt, unit_blocks));
+	CU_ASSERT(g_rebuild_status == 0);
+
+	free(rebuild_req.buf);
+}
+
+static void
+test_raid1_rebuild(void)
+{
+	struct {
+		struct raid_bdev_module *module;
+		uint8_t num_base_bdevs;
+		uint8_t target;
+	} configs[] = {
+		{ &g_raid1_module, 2, 0 },
+		{ &g_raid1_module, 3, 2 },
+		{ &g_raid10_module, 4, 1 },
+		{ &g_raid10_module, 6, 4 },
+	};
+	struct raid1_test_ctx ctx;
+	struct raid1_info *r1info;
+	uint64_t unit_blocks, base_bytes;
+	uint8_t target, mirror;
+	size_t c;
+
+	srand(0);
+
+	for (c = 0; c < SPDK_COUNTOF(configs); c++) {
+		raid1_test_init(&ctx, configs[c].module, configs[c].num_base_bdevs, 64, 8);
+		r1info = ctx.raid_bdev.module_private;
+		target = configs[c].target;
+		/* Another mirror of the same group */
+		mirror = target % r1info->num_mirrors == 0 ? target + 1 : target - 1;
+		base_bytes = ctx.raid_bdev.bdev.blockcnt / r1info->num_groups * g_blocklen;
+
+		/* The base bdev is replaced, nothing is read from it until it is rebuilt */
+		raid1_test_fill(&ctx);
+		memset(g_base_bdev_data[target], 0, base_bytes);
+		ctx.raid_ch.rebuild_active = true;
+		ctx.raid_ch.rebuild_idx = target;
+		ctx.raid_ch.rebuild_offset = 0;
+		reset_counters();
+		raid1_test_verify(&ctx);
+		CU_ASSERT(g_base_reads[target] == 0);
+
+		/* Writes above the rebuilt offset skip it */
+		raid1_test_fill(&ctx);
+		CU_ASSERT(g_base_writes[target] == 0);
+
+		/* Rebuild in rows of strips, like the rebuild engine does for RAID10 */
+		unit_blocks = ctx.raid_bdev.strip_size * ctx.raid_bdev.num_base_bdevs;
+		reset_counters();
+		raid1_test_rebuild(&ctx, target, unit_blocks);
+		CU_ASSERT(g_base_reads[target] == 0);
+		CU_ASSERT(g_base_writes[target] == g_rebuild_completions);
+		CU_ASSERT(memcmp(g_base_bdev_data[target], g_base_bdev_data[mirror], base_bytes) == 0);
+
+		/* Once rebuilt, the base bdev serves reads and writes again */
+		ctx.raid_ch.rebuild_active = false;
+		reset_counters();
+		raid1_test_fill(&ctx);
+		CU_ASSERT(g_base_writes[target] > 0);
+		ctx.base_channel[mirror] = NULL;
+		raid1_test_verify(&ctx);
+		CU_ASSERT(g_base_reads[target] > 0);
+		ctx.base_channel[mirror] = (struct spdk_io_channel *)(uintptr_t)(mirror + 1);
+
+		raid1_test_fini(&ctx);
+	}
+
+	/* Rebuild fails without an in-sync mirror */
+	raid1_test_init(&ctx, &g_raid1_module, 2, 64, 8);
+	ctx.base_channel[1] = NULL;
+	{
+		struct raid_bdev_rebuild_request rebuild_req = {
+			.raid_bdev = &ctx.raid_bdev,
+			.raid_ch = &ctx.raid_ch,
+			.target_idx = 0,
+			.offset_blocks = 0,
+			.num_blocks = 8,
+		};
+
+		CU_ASSERT(raid1_submit_rebuild_request(&rebuild_req) == -ENODEV);
+	}
+	raid1_test_fini(&ctx);
+}
+
+int
+main(int argc, char **argv)
+{
+	CU_pSuite suite = NULL;
+	unsigned int num_failures;
+
+	CU_set_error_action(CUEA_ABORT);
+	CU_initialize_registry();
+
+	suite = CU_add_suite("raid1", NULL, NULL);
+	CU_ADD_TEST(suite, test_raid1_start);
+	CU_ADD_TEST(suite, test_raid1_io);
+	CU_ADD_TEST(suite, test_raid1_read_balancing);
+	CU_ADD_TEST(suite, test_raid1_null_payload);
+	CU_ADD_TEST(suite, test_raid1_rebuild);
+
+	allocate_threads(1);
+	set_thread(0);
+
+	CU_basic_set_mode(CU_BRM_VERBOSE);
+	CU_basic_run_tests();
+	num_failures = CU_get_number_of_failures();
+	CU_cleanup_registry();
+
+	free_threads();
+
+	return num_failures;
+}
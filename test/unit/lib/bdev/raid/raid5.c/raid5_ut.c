@@ -36,11 +36,141 @@
 #include "spdk/env.h"
 #include "spdk_internal/mock.h"
 
+#include "common/lib/ut_multithread.c"
+
 #include "bdev/raid/raid5.c"
 
 DEFINE_STUB_V(raid_bdev_module_list_add, (struct raid_bdev_module *raid_module));
-DEFINE_STUB_V(raid_bdev_io_complete, (struct raid_bdev_io *raid_io,
-				      enum spdk_bdev_io_status status));
+DEFINE_STUB_V(raid_bdev_queue_io_wait, (struct raid_bdev_io *raid_io, struct spdk_bdev *bdev,
+					struct spdk_io_channel *ch, spdk_bdev_io_wait_cb cb_fn));
+DEFINE_STUB(spdk_bdev_queue_io_wait, int, (struct spdk_bdev *bdev, struct spdk_io_channel *ch,
+		struct spdk_bdev_io_wait_entry *entry), 0);
+DEFINE_STUB(spdk_bdev_get_buf_align, size_t, (const struct spdk_bdev *bdev), 0);
+DEFINE_STUB_V(spdk_bdev_free_io, (struct spdk_bdev_io *bdev_io));
+
+struct base_io {
+	spdk_bdev_io_completion_cb cb;
+	void *cb_arg;
+	TAILQ_ENTRY(base_io) link;
+};
+
+static TAILQ_HEAD(, base_io) g_base_ios = TAILQ_HEAD_INITIALIZER(g_base_ios);
+static uint8_t **g_base_bdev_data;
+static uint32_t g_blocklen;
+static enum spdk_bdev_io_status g_io_status;
+static bool g_io_completed;
+static int g_io_completions;
+static int g_base_reads[UINT8_MAX];
+static uint64_t g_base_read_blocks[UINT8_MAX];
+static int g_base_writes[UINT8_MAX];
+static int g_rebuild_completions;
+static int g_rebuild_status;
+
+void
+raid_bdev_io_complete(struct raid_bdev_io *raid_io, enum spdk_bdev_io_status status)
+{
+	g_io_completed = true;
+	g_io_completions++;
+	g_io_status = status;
+}
+
+void
+raid_bdev_rebuild_request_complete(struct raid_bdev_rebuild_request *rebuild_req, int status)
+{
+	g_rebuild_completions++;
+	if (status != 0) {
+		g_rebuild_status = status;
+	}
+}
+
+/* Base bdev descriptors are encoded as the base bdev index + 1 */
+static uint8_t *
+base_bdev_data(struct spdk_bdev_desc *desc, uint64_t offset_blocks)
+{
+	return g_base_bdev_data[(uintptr_t)desc - 1] + offset_blocks * g_blocklen;
+}
+
+static void
+queue_base_io(spdk_bdev_io_completion_cb cb, void *cb_arg)
+{
+	struct base_io *base_io = calloc(1, sizeof(*base_io));
+
+	SPDK_CU_ASSERT_FATAL(base_io != NULL);
+	base_io->cb = cb;
+	base_io->cb_arg = cb_arg;
+	TAILQ_INSERT_TAIL(&g_base_ios, base_io, link);
+}
+
+int
+spdk_bdev_readv_blocks(struct spdk_bdev_desc *desc, struct spdk_io_channel *ch,
+		       struct iovec *iov, int iovcnt,
+		       uint64_t offset_blocks, uint64_t num_blocks,
+		       spdk_bdev_io_completion_cb cb, void *cb_arg)
+{
+	struct iovec buf_iov = {
+		.iov_base = base_bdev_data(desc, offset_blocks),
+		.iov_len = num_blocks * g_blocklen,
+	};
+
+	CU_ASSERT(ch != NULL);
+	CU_ASSERT(spdk_iovcpy(&buf_iov, 1, iov, iovcnt) == buf_iov.iov_len);
+	g_base_reads[(uintptr_t)desc - 1]++;
+	g_base_read_blocks[(uintptr_t)desc - 1] += num_blocks;
+	queue_base_io(cb, cb_arg);
+
+	return 0;
+}
+
+int
+spdk_bdev_writev_blocks(struct spdk_bdev_desc *desc, struct spdk_io_channel *ch,
+			struct iovec *iov, int iovcnt,
+			uint64_t offset_blocks, uint64_t num_blocks,
+			spdk_bdev_io_completion_cb cb, void *cb_arg)
+{
+	struct iovec buf_iov = {
+		.iov_base = base_bdev_data(desc, offset_blocks),
+		.iov_len = num_blocks * g_blocklen,
+	};
+
+	CU_ASSERT(ch != NULL);
+	CU_ASSERT(spdk_iovcpy(iov, iovcnt, &buf_iov, 1) == buf_iov.iov_len);
+	g_base_writes[(uintptr_t)desc - 1]++;
+	queue_base_io(cb, cb_arg);
+
+	return 0;
+}
+
+int
+spdk_bdev_read_blocks(struct spdk_bdev_desc *desc, struct spdk_io_channel *ch, void *buf,
+		      uint64_t offset_blocks, uint64_t num_blocks,
+		      spdk_bdev_io_completion_cb cb, void *cb_arg)
+{
+	struct iovec iov = { .iov_base = buf, .iov_len = num_blocks * g_blocklen };
+
+	return spdk_bdev_readv_blocks(desc, ch, &iov, 1, offset_blocks, num_blocks, cb, cb_arg);
+}
+
+int
+spdk_bdev_write_blocks(struct spdk_bdev_desc *desc, struct spdk_io_channel *ch, void *buf,
+		       uint64_t offset_blocks, uint64_t num_blocks,
+		       spdk_bdev_io_completion_cb cb, void *cb_arg)
+{
+	struct iovec iov = { .iov_base = buf, .iov_len = num_blocks * g_blocklen };
+
+	return spdk_bdev_writev_blocks(desc, ch, &iov, 1, offset_blocks, num_blocks, cb, cb_arg);
+}
+
+static void
+complete_base_ios(void)
+{
+	struct base_io *base_io;
+
+	while ((base_io = TAILQ_FIRST(&g_base_ios))) {
+		TAILQ_REMOVE(&g_base_ios, base_io, link);
+		base_io->cb(NULL, true, base_io->cb_arg);
+		free(base_io);
+	}
+}
 
 struct raid5_params {
 	uint8_t num_base_bdevs;
@@ -136,6 +266,7 @@ create_raid_bdev(struct raid5_params *params)
 
 	raid_bdev->strip_size = params->strip_size;
 	raid_bdev->strip_size_shift = spdk_u32log2(raid_bdev->strip_size);
+	raid_bdev->blocklen_shift = spdk_u32log2(params->base_bdev_blocklen);
 	raid_bdev->bdev.blocklen = params->base_bdev_blocklen;
 
 	return raid_bdev;
@@ -169,6 +300,7 @@ delete_raid5(struct raid5_info *r5info)
 	struct raid_bdev *raid_bdev = r5info->raid_bdev;
 
 	raid5_stop(raid_bdev);
+	poll_threads();
 
 	delete_raid_bdev(raid_bdev);
 }
@@ -194,6 +326,632 @@ test_raid5_start(void)
 	}
 }
 
+static void
+test_raid5_chunk_mapping(void)
+{
+	struct raid5_params *params;
+
+	RAID5_PARAMS_FOR_EACH(params) {
+		struct raid5_info *r5info;
+		struct raid_bdev *raid_bdev;
+		uint64_t stripe_index;
+		uint8_t data_chunks;
+
+		r5info = create_raid5(params);
+		raid_bdev = r5info->raid_bdev;
+		data_chunks = raid5_stripe_data_chunks_num(raid_bdev);
+
+		for (stripe_index = 0; stripe_index < 2 * params->num_base_bdevs; stripe_index++) {
+			uint8_t parity_idx = raid5_stripe_parity_chunk_index(raid_bdev, stripe_index);
+			bool used[UINT8_MAX] = { false };
+			uint8_t i, idx;
+
+			CU_ASSERT(parity_idx < params->num_base_bdevs);
+			CU_ASSERT(parity_idx == params->num_base_bdevs - 1 -
+				  stripe_index % params->num_base_bdevs);
+			used[parity_idx] = true;
+
+			/* Each base bdev holds exactly one chunk of the stripe */
+			for (i = 0; i < data_chunks; i++) {
+				idx = raid5_stripe_data_chunk_index(raid_bdev, stripe_index, i);
+				CU_ASSERT(idx < params->num_base_bdevs);
+				CU_ASSERT(used[idx] == false);
+				used[idx] = true;
+			}
+		}
+
+		delete_raid5(r5info);
+	}
+}
+
+static void
+test_raid5_xor(void)
+{
+	uint8_t buf[67], expected[67], src[67];
+	struct iovec iovs[3];
+	size_t i;
+
+	for (i = 0; i < sizeof(buf); i++) {
+		buf[i] = i;
+		src[i] = i * 7 + 3;
+		expected[i] = buf[i] ^ src[i];
+	}
+
+	/* Aligned and unaligned buffers */
+	raid5_xor_buf(buf, src, 64);
+	raid5_xor_buf(buf + 64, src + 64, 3);
+	CU_ASSERT(memcmp(buf, expected, sizeof(buf)) == 0);
+
+	raid5_xor_buf(buf + 1, src + 1, sizeof(buf) - 1);
+	raid5_xor_buf(buf, src, 1);
+	for (i = 0; i < sizeof(buf); i++) {
+		CU_ASSERT(buf[i] == (uint8_t)i);
+	}
+
+	iovs[0].iov_base = src;
+	iovs[0].iov_len = 5;
+	iovs[1].iov_base = src + 5;
+	iovs[1].iov_len = 40;
+	iovs[2].iov_base = src + 45;
+	iovs[2].iov_len = 22;
+	raid5_xor_iovs_to_buf(buf, iovs, 3, 0, sizeof(buf));
+	CU_ASSERT(memcmp(buf, expected, sizeof(buf)) == 0);
+
+	/* Starting in the middle of the second iov */
+	raid5_xor_iovs_to_buf(buf + 10, iovs, 3, 10, sizeof(buf) - 10);
+	CU_ASSERT(memcmp(buf, expected, 10) == 0);
+	for (i = 10; i < sizeof(buf); i++) {
+		CU_ASSERT(buf[i] == (uint8_t)i);
+	}
+}
+
+struct raid5_io_test_ctx {
+	struct raid_bdev *raid_bdev;
+	struct raid_bdev_io_channel raid_ch;
+	uint8_t *image;
+	uint64_t blockcnt;
+};
+
+static void
+raid5_io_test_ch_init(struct raid5_io_test_ctx *ctx, struct raid_bdev_io_channel *raid_ch)
+{
+	uint8_t i;
+
+	raid_ch->num_channels = ctx->raid_bdev->num_base_bdevs;
+	raid_ch->base_channel = calloc(raid_ch->num_channels, sizeof(struct spdk_io_channel *));
+	SPDK_CU_ASSERT_FATAL(raid_ch->base_channel != NULL);
+	for (i = 0; i < raid_ch->num_channels; i++) {
+		raid_ch->base_channel[i] = (struct spdk_io_channel *)(uintptr_t)(i + 1);
+	}
+	raid_ch->module_channel = spdk_get_io_channel(ctx->raid_bdev->module_private);
+	SPDK_CU_ASSERT_FATAL(raid_ch->module_channel != NULL);
+}
+
+static void
+raid5_io_test_ch_fini(struct raid_bdev_io_channel *raid_ch)
+{
+	spdk_put_io_channel(raid_ch->module_channel);
+	poll_threads();
+	free(raid_ch->base_channel);
+}
+
+static void
+raid5_io_test_init(struct raid5_io_test_ctx *ctx, struct raid5_params *params)
+{
+	struct raid5_info *r5info;
+	uint8_t i;
+
+	g_blocklen = params->base_bdev_blocklen;
+
+	r5info = create_raid5(params);
+	ctx->raid_bdev = r5info->raid_bdev;
+	ctx->blockcnt = ctx->raid_bdev->bdev.blockcnt;
+
+	g_base_bdev_data = calloc(params->num_base_bdevs, sizeof(*g_base_bdev_data));
+	SPDK_CU_ASSERT_FATAL(g_base_bdev_data != NULL);
+	for (i = 0; i < params->num_base_bdevs; i++) {
+		g_base_bdev_data[i] = calloc(params->base_bdev_blockcnt, g_blocklen);
+		SPDK_CU_ASSERT_FATAL(g_base_bdev_data[i] != NULL);
+		ctx->raid_bdev->base_bdev_info[i].desc = (struct spdk_bdev_desc *)(uintptr_t)(i + 1);
+	}
+
+	raid5_io_test_ch_init(ctx, &ctx->raid_ch);
+
+	ctx->image = calloc(ctx->blockcnt, g_blocklen);
+	SPDK_CU_ASSERT_FATAL(ctx->image != NULL);
+}
+
+static void
+raid5_io_test_fini(struct raid5_io_test_ctx *ctx)
+{
+	uint8_t i;
+
+	raid5_io_test_ch_fini(&ctx->raid_ch);
+
+	for (i = 0; i < ctx->raid_bdev->num_base_bdevs; i++) {
+		free(g_base_bdev_data[i]);
+		ctx->raid_bdev->base_bdev_info[i].desc = NULL;
+	}
+	free(g_base_bdev_data);
+	free(ctx->image);
+
+	delete_raid5(ctx->raid_bdev->module_private);
+}
+
+#define IO_TEST_MAX_IOVS 64
+
+/*
+ * Submit the I/O to raid5, splitting it on stripe boundaries like the bdev layer
+ * does. The payload is scattered over small iovs of odd sizes.
+ */
+static enum spdk_bdev_io_status
+raid5_io_test_submit(struct raid5_io_test_ctx *ctx, enum spdk_bdev_io_type type,
+		     uint64_t offset_blocks, uint64_t num_blocks, uint8_t *buf)
+{
+	struct raid5_info *r5info = ctx->raid_bdev->module_private;
+	struct spdk_bdev_io *bdev_io;
+	struct raid_bdev_io *raid_io;
+	struct iovec iovs[IO_TEST_MAX_IOVS];
+
+	bdev_io = calloc(1, sizeof(*bdev_io) + sizeof(*raid_io));
+	SPDK_CU_ASSERT_FATAL(bdev_io != NULL);
+	raid_io = (struct raid_bdev_io *)bdev_io->driver_ctx;
+
+	while (num_blocks > 0) {
+		uint64_t blocks = spdk_min(num_blocks,
+					   r5info->stripe_blocks - offset_blocks % r5info->stripe_blocks);
+		size_t len = blocks * g_blocklen;
+		size_t iov_len = g_blocklen / 2 + 100;
+		int iovcnt = 0;
+
+		while (len > 0) {
+			SPDK_CU_ASSERT_FATAL(iovcnt < IO_TEST_MAX_IOVS);
+			iovs[iovcnt].iov_base = buf;
+			iovs[iovcnt].iov_len = spdk_min(len, iov_len);
+			buf += iovs[iovcnt].iov_len;
+			len -= iovs[iovcnt].iov_len;
+			iovcnt++;
+			iov_len *= 3;
+		}
+
+		bdev_io->type = type;
+		bdev_io->u.bdev.iovs = iovs;
+		bdev_io->u.bdev.iovcnt = iovcnt;
+		bdev_io->u.bdev.offset_blocks = offset_blocks;
+		bdev_io->u.bdev.num_blocks = blocks;
+		raid_io->raid_bdev = ctx->raid_bdev;
+		raid_io->raid_ch = &ctx->raid_ch;
+
+		g_io_completed = false;
+		raid5_submit_rw_request(raid_io);
+		complete_base_ios();
+		CU_ASSERT(g_io_completed == true);
+		if (g_io_status != SPDK_BDEV_IO_STATUS_SUCCESS) {
+			break;
+		}
+
+		offset_blocks += blocks;
+		num_blocks -= blocks;
+	}
+
+	free(bdev_io);
+
+	return g_io_status;
+}
+
+static void
+raid5_io_test_verify(struct raid5_io_test_ctx *ctx, bool verify_parity)
+{
+	struct raid_bdev *raid_bdev = ctx->raid_bdev;
+	uint64_t base_blocks = ctx->blockcnt / raid5_stripe_data_chunks_num(raid_bdev);
+	uint8_t *buf;
+	uint64_t i;
+	uint8_t j, x;
+
+	buf = calloc(ctx->blockcnt, g_blocklen);
+	SPDK_CU_ASSERT_FATAL(buf != NULL);
+
+	CU_ASSERT(raid5_io_test_submit(ctx, SPDK_BDEV_IO_TYPE_READ, 0, ctx->blockcnt,
+				       buf) == SPDK_BDEV_IO_STATUS_SUCCESS);
+	CU_ASSERT(memcmp(buf, ctx->image, ctx->blockcnt * g_blocklen) == 0);
+
+	if (verify_parity) {
+		for (i = 0; i < base_blocks * g_blocklen; i++) {
+			x = 0;
+			for (j = 0; j < raid_bdev->num_base_bdevs; j++) {
+				x ^= g_base_bdev_data[j][i];
+			}
+			CU_ASSERT(x == 0);
+			if (x != 0) {
+				break;
+			}
+		}
+	}
+
+	free(buf);
+}
+
+static void
+raid5_io_test_write(struct raid5_io_test_ctx *ctx, uint64_t offset_blocks, uint64_t num_blocks)
+{
+	uint8_t *data = ctx->image + offset_blocks * g_blocklen;
+	uint64_t i;
+
+	for (i = 0; i < num_blocks * g_blocklen; i++) {
+		data[i] = rand();
+	}
+
+	CU_ASSERT(raid5_io_test_submit(ctx, SPDK_BDEV_IO_TYPE_WRITE, offset_blocks, num_blocks,
+				       data) == SPDK_BDEV_IO_STATUS_SUCCESS);
+}
+
+static void
+raid5_io_test_random_writes(struct raid5_io_test_ctx *ctx, int count, bool verify_parity)
+{
+	uint64_t offset_blocks, num_blocks;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		offset_blocks = rand() % ctx->blockcnt;
+		num_blocks = 1 + rand() % spdk_min(ctx->blockcnt - offset_blocks,
+						    ctx->raid_bdev->strip_size * 3);
+		raid5_io_test_write(ctx, offset_blocks, num_blocks);
+	}
+
+	raid5_io_test_verify(ctx, verify_parity);
+}
+
+static void
+raid5_io_test_random_reads(struct raid5_io_test_ctx *ctx, int count)
+{
+	uint64_t offset_blocks, num_blocks;
+	uint8_t *buf;
+	int i;
+
+	buf = malloc(ctx->blockcnt * g_blocklen);
+	SPDK_CU_ASSERT_FATAL(buf != NULL);
+
+	for (i = 0; i < count; i++) {
+		offset_blocks = rand() % ctx->blockcnt;
+		num_blocks = 1 + rand() % spdk_min(ctx->blockcnt - offset_blocks,
+						    ctx->raid_bdev->strip_size * 3);
+		CU_ASSERT(raid5_io_test_submit(ctx, SPDK_BDEV_IO_TYPE_READ, offset_blocks, num_blocks,
+					       buf) == SPDK_BDEV_IO_STATUS_SUCCESS);
+		CU_ASSERT(memcmp(buf, ctx->image + offset_blocks * g_blocklen, num_blocks * g_blocklen) == 0);
+	}
+
+	free(buf);
+}
+
+/*
+ * Read the given range of the first stripe with a base bdev missing and check that
+ * no block of the other base bdevs was read more than once.
+ */
+static void
+raid5_io_test_degraded_read_blocks(struct raid5_io_test_ctx *ctx, uint8_t missing,
+				   uint64_t offset_blocks, uint64_t num_blocks)
+{
+	uint8_t *buf;
+	uint8_t i;
+
+	buf = malloc(num_blocks * g_blocklen);
+	SPDK_CU_ASSERT_FATAL(buf != NULL);
+
+	memset(g_base_read_blocks, 0, sizeof(g_base_read_blocks));
+	CU_ASSERT(raid5_io_test_submit(ctx, SPDK_BDEV_IO_TYPE_READ, offset_blocks, num_blocks,
+				       buf) == SPDK_BDEV_IO_STATUS_SUCCESS);
+	CU_ASSERT(memcmp(buf, ctx->image + offset_blocks * g_blocklen, num_blocks * g_blocklen) == 0);
+
+	for (i = 0; i < ctx->raid_bdev->num_base_bdevs; i++) {
+		if (i == missing) {
+			CU_ASSERT(g_base_read_blocks[i] == 0);
+		} else {
+			CU_ASSERT(g_base_read_blocks[i] <= ctx->raid_bdev->strip_size);
+		}
+	}
+
+	free(buf);
+}
+
+static void
+test_raid5_io(void)
+{
+	uint8_t num_base_bdevs_values[] = { 3, 4, 5 };
+	uint8_t *num_base_bdevs;
+	struct raid5_params params = {
+		.base_bdev_blockcnt = 64,
+		.base_bdev_blocklen = 512,
+		.strip_size = 8,
+	};
+
+	srand(0);
+
+	ARRAY_FOR_EACH(num_base_bdevs_values, num_base_bdevs) {
+		struct raid5_io_test_ctx ctx = {};
+		struct raid5_info *r5info;
+		uint8_t missing;
+
+		params.num_base_bdevs = *num_base_bdevs;
+		raid5_io_test_init(&ctx, &params);
+		r5info = ctx.raid_bdev->module_private;
+
+		/* Full stripe writes */
+		raid5_io_test_write(&ctx, 0, ctx.blockcnt);
+		raid5_io_test_verify(&ctx, true);
+
+		/* Partial stripe writes, both read-modify-write and reconstruct-write */
+		raid5_io_test_random_writes(&ctx, 200, true);
+
+		/* Degraded reads and writes with each of the base bdevs missing */
+		for (missing = 0; missing < params.num_base_bdevs; missing++) {
+			ctx.raid_ch.base_channel[missing] = NULL;
+			raid5_io_test_verify(&ctx, false);
+			raid5_io_test_random_reads(&ctx, 100);
+			raid5_io_test_degraded_read_blocks(&ctx, missing, 0, r5info->stripe_blocks);
+			raid5_io_test_degraded_read_blocks(&ctx, missing, params.strip_size / 2,
+							   r5info->stripe_blocks - params.strip_size);
+			raid5_io_test_random_writes(&ctx, 100, false);
+
+			/* Bring the base bdev back in sync by rewriting the whole array */
+			ctx.raid_ch.base_channel[missing] = (struct spdk_io_channel *)(uintptr_t)(missing + 1);
+			raid5_io_test_write(&ctx, 0, ctx.blockcnt);
+			raid5_io_test_verify(&ctx, true);
+		}
+
+		raid5_io_test_fini(&ctx);
+	}
+}
+
+static struct spdk_bdev_io *
+raid5_io_test_submit_nowait(struct raid5_io_test_ctx *ctx, struct raid_bdev_io_channel *raid_ch,
+			    uint64_t offset_blocks, uint64_t num_blocks)
+{
+	struct spdk_bdev_io *bdev_io;
+	struct raid_bdev_io *raid_io;
+	uint64_t i;
+
+	bdev_io = calloc(1, sizeof(*bdev_io) + sizeof(*raid_io) + sizeof(struct iovec));
+	SPDK_CU_ASSERT_FATAL(bdev_io != NULL);
+	raid_io = (struct raid_bdev_io *)bdev_io->driver_ctx;
+
+	for (i = 0; i < num_blocks * g_blocklen; i++) {
+		ctx->image[offset_blocks * g_blocklen + i] = rand();
+	}
+
+	bdev_io->type = SPDK_BDEV_IO_TYPE_WRITE;
+	bdev_io->u.bdev.iovs = (struct iovec *)(raid_io + 1);
+	bdev_io->u.bdev.iovs[0].iov_base = ctx->image + offset_blocks * g_blocklen;
+	bdev_io->u.bdev.iovs[0].iov_len = num_blocks * g_blocklen;
+	bdev_io->u.bdev.iovcnt = 1;
+	bdev_io->u.bdev.offset_blocks = offset_blocks;
+	bdev_io->u.bdev.num_blocks = num_blocks;
+	raid_io->raid_bdev = ctx->raid_bdev;
+	raid_io->raid_ch = raid_ch;
+
+	raid5_submit_rw_request(raid_io);
+
+	return bdev_io;
+}
+
+static void
+reset_base_io_counters(void)
+{
+	memset(g_base_reads, 0, sizeof(g_base_reads));
+	memset(g_base_writes, 0, sizeof(g_base_writes));
+	g_io_completions = 0;
+}
+
+static int
+sum_counters(int *counters, uint8_t num)
+{
+	int sum = 0;
+	uint8_t i;
+
+	for (i = 0; i < num; i++) {
+		sum += counters[i];
+	}
+
+	return sum;
+}
+
+static void
+test_raid5_write_coalescing(void)
+{
+	struct raid5_params params = {
+		.num_base_bdevs = 4,
+		.base_bdev_blockcnt = 64,
+		.base_bdev_blocklen = 512,
+		.strip_size = 8,
+	};
+	struct raid5_io_test_ctx ctx = {};
+	struct spdk_bdev_io *bdev_io[6];
+	int i;
+
+	raid5_io_test_init(&ctx, &params);
+	reset_base_io_counters();
+
+	/* Sequential sub-stripe writes to the first stripe, submitted at once */
+	for (i = 0; i < 6; i++) {
+		bdev_io[i] = raid5_io_test_submit_nowait(&ctx, &ctx.raid_ch, i * 4, 4);
+	}
+
+	/* Only the first write is running, the others wait for the stripe lock */
+	CU_ASSERT(sum_counters(g_base_writes, params.num_base_bdevs) == 0);
+	complete_base_ios();
+	CU_ASSERT(g_io_completions == 6);
+	CU_ASSERT(g_io_status == SPDK_BDEV_IO_STATUS_SUCCESS);
+
+	/*
+	 * The first write updates one chunk and parity, the rest is merged into
+	 * one write of three chunks and parity.
+	 */
+	CU_ASSERT(sum_counters(g_base_writes, params.num_base_bdevs) == 2 + 4);
+
+	for (i = 0; i < 6; i++) {
+		free(bdev_io[i]);
+	}
+
+	raid5_io_test_verify(&ctx, true);
+	raid5_io_test_fini(&ctx);
+}
+
+static void
+test_raid5_parity_cache(void)
+{
+	struct raid5_params params = {
+		.num_base_bdevs = 4,
+		.base_bdev_blockcnt = 64,
+		.base_bdev_blocklen = 512,
+		.strip_size = 8,
+	};
+	struct raid5_io_test_ctx ctx = {};
+	struct raid_bdev_io_channel raid_ch2 = {};
+	struct raid_bdev *raid_bdev;
+	struct spdk_bdev_io *bdev_io, *bdev_io2;
+	uint8_t parity_idx;
+
+	raid5_io_test_init(&ctx, &params);
+	raid_bdev = ctx.raid_bdev;
+	parity_idx = raid5_stripe_parity_chunk_index(raid_bdev, 1);
+
+	set_thread(1);
+	raid5_io_test_ch_init(&ctx, &raid_ch2);
+	set_thread(0);
+
+	/* Full stripe write puts the parity of stripe 1 to the cache */
+	raid5_io_test_write(&ctx, 24, 24);
+
+	/* Read-modify-write doesn't need to read the cached parity */
+	reset_base_io_counters();
+	raid5_io_test_write(&ctx, 25, 1);
+	CU_ASSERT(sum_counters(g_base_reads, params.num_base_bdevs) == 1);
+	CU_ASSERT(g_base_reads[parity_idx] == 0);
+	raid5_io_test_verify(&ctx, true);
+
+	/* A write from another channel invalidates the cached parity */
+	set_thread(1);
+	bdev_io = raid5_io_test_submit_nowait(&ctx, &raid_ch2, 40, 1);
+	complete_base_ios();
+	CU_ASSERT(g_io_status == SPDK_BDEV_IO_STATUS_SUCCESS);
+	free(bdev_io);
+	set_thread(0);
+
+	/* Without the cached parity reconstruct-write is used, reading the other data chunks */
+	reset_base_io_counters();
+	raid5_io_test_write(&ctx, 26, 1);
+	CU_ASSERT(sum_counters(g_base_reads, params.num_base_bdevs) == 2);
+	CU_ASSERT(g_base_reads[parity_idx] == 0);
+	raid5_io_test_verify(&ctx, true);
+
+	/* Writes to the same stripe from different channels are serialized */
+	reset_base_io_counters();
+	bdev_io = raid5_io_test_submit_nowait(&ctx, &ctx.raid_ch, 27, 1);
+	set_thread(1);
+	bdev_io2 = raid5_io_test_submit_nowait(&ctx, &raid_ch2, 28, 1);
+	CU_ASSERT(sum_counters(g_base_reads, params.num_base_bdevs) == 2);
+	set_thread(0);
+	complete_base_ios();
+	CU_ASSERT(g_io_completions == 1);
+
+	/* The deferred write is started by the poller of the second channel */
+	poll_threads();
+	complete_base_ios();
+	CU_ASSERT(g_io_completions == 2);
+	CU_ASSERT(g_io_status == SPDK_BDEV_IO_STATUS_SUCCESS);
+	free(bdev_io);
+	free(bdev_io2);
+
+	raid5_io_test_verify(&ctx, true);
+
+	set_thread(1);
+	raid5_io_test_ch_fini(&raid_ch2);
+	set_thread(0);
+	raid5_io_test_fini(&ctx);
+}
+
+static void
+test_raid5_rebuild(void)
+{
+	uint8_t num_base_bdevs_values[] = { 3, 4, 5 };
+	uint8_t *num_base_bdevs;
+	struct raid5_params params = {
+		.base_bdev_blockcnt = 64,
+		.base_bdev_blocklen = 512,
+		.strip_size = 8,
+	};
+
+	srand(0);
+
+	ARRAY_FOR_EACH(num_base_bdevs_values, num_base_bdevs) {
+		struct raid5_io_test_ctx ctx = {};
+		struct raid_bdev_rebuild_request rebuild_req = {};
+		struct raid5_info *r5info;
+		uint64_t unit_blocks, offset;
+		uint8_t target;
+
+		params.num_base_bdevs = *num_base_bdevs;
+		raid5_io_test_init(&ctx, &params);
+		r5info = ctx.raid_bdev->module_private;
+		raid5_io_test_write(&ctx, 0, ctx.blockcnt);
+
+		/* Replace a base bdev, it is used only below the rebuilt offset */
+		target = params.num_base_bdevs / 2;
+		memset(g_base_bdev_data[target], 0, params.base_bdev_blockcnt * g_blocklen);
+		ctx.raid_ch.rebuild_active = true;
+		ctx.raid_ch.rebuild_idx = target;
+		ctx.raid_ch.rebuild_offset = 0;
+		reset_base_io_counters();
+		raid5_io_test_random_writes(&ctx, 50, false);
+		CU_ASSERT(g_base_reads[target] == 0);
+		CU_ASSERT(g_base_writes[target] == 0);
+
+		/* Rebuild two stripes per request, reading all the other base bdevs */
+		unit_blocks = r5info->stripe_blocks * 2;
+		rebuild_req.raid_bdev = ctx.raid_bdev;
+		rebuild_req.raid_ch = &ctx.raid_ch;
+		rebuild_req.target_idx = target;
+		rebuild_req.buf = calloc(unit_blocks, g_blocklen);
+		SPDK_CU_ASSERT_FATAL(rebuild_req.buf != NULL);
+		g_rebuild_completions = 0;
+		g_rebuild_status = 0;
+
+		for (offset = 0; offset < ctx.blockcnt; offset += unit_blocks) {
+			rebuild_req.offset_blocks = offset;
+			rebuild_req.num_blocks = spdk_min(unit_blocks, ctx.blockcnt - offset);
+			rebuild_req.base_bdev_io_submitted = 0;
+			rebuild_req.base_bdev_io_remaining = 0;
+			rebuild_req.base_bdev_io_status = 0;
+			reset_base_io_counters();
+			CU_ASSERT(raid5_submit_rebuild_request(&rebuild_req) == 0);
+			CU_ASSERT(sum_counters(g_base_reads, params.num_base_bdevs) ==
+				  params.num_base_bdevs - 1);
+			CU_ASSERT(g_base_reads[target] == 0);
+			complete_base_ios();
+			CU_ASSERT(g_base_writes[target] == 1);
+			ctx.raid_ch.rebuild_offset = offset + rebuild_req.num_blocks;
+
+			/* Writes to the rebuilt stripes update the replacement base bdev */
+			raid5_io_test_random_writes(&ctx, 10, false);
+		}
+		CU_ASSERT(g_rebuild_completions == (int)SPDK_CEIL_DIV(ctx.blockcnt, unit_blocks));
+		CU_ASSERT(g_rebuild_status == 0);
+
+		ctx.raid_ch.rebuild_active = false;
+		raid5_io_test_verify(&ctx, true);
+
+		/* The rebuild fails if another base bdev is missing */
+		ctx.raid_ch.base_channel[(target + 1) % params.num_base_bdevs] = NULL;
+		rebuild_req.offset_blocks = 0;
+		rebuild_req.base_bdev_io_submitted = 0;
+		CU_ASSERT(raid5_submit_rebuild_request(&rebuild_req) == -ENODEV);
+		ctx.raid_ch.base_channel[(target + 1) % params.num_base_bdevs] =
+			(struct spdk_io_channel *)(uintptr_t)((target + 1) % params.num_base_bdevs + 1);
+
+		free(rebuild_req.buf);
+		raid5_io_test_fini(&ctx);
+	}
+}
+
 int
 main(int argc, char **argv)
 {
@@ -205,10 +963,22 @@ main(int argc, char **argv)
 
 	suite = CU_add_suite("raid5", test_setup, test_cleanup);
 	CU_ADD_TEST(suite, test_raid5_start);
+	CU_ADD_TEST(suite, test_raid5_chunk_mapping);
+	CU_ADD_TEST(suite, test_raid5_xor);
+	CU_ADD_TEST(suite, test_raid5_io);
+	CU_ADD_TEST(suite, test_raid5_write_coalescing);
+	CU_ADD_TEST(suite, test_raid5_parity_cache);
+	CU_ADD_TEST(suite, test_raid5_rebuild);
+
+	allocate_threads(2);
+	set_thread(0);
 
 	CU_basic_set_mode(CU_BRM_VERBOSE);
 	CU_basic_run_tests();
 	num_failures = CU_get_number_of_failures();
 	CU_cleanup_registry();
+
+	free_threads();
+
 	return num_failures;
 }
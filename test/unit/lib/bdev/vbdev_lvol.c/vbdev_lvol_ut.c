@@ -36,6 +36,7 @@
 
 #include "bdev/lvol/vbdev_lvol.c"
 
+#include "common/lib/test_env.c"
 #include "unit/lib/json_mock.c"
 
 #define SPDK_BS_PAGE_SIZE 0x1000
@@ -164,10 +165,12 @@ spdk_lvol_open(struct spdk_lvol *lvol, spdk_lvol_op_with_handle_complete cb_fn,
 	cb_fn(cb_arg, lvol, g_lvolerrno);
 }
 
+uint64_t g_blob_num_clusters;
+
 uint64_t
 spdk_blob_get_num_clusters(struct spdk_blob *b)
 {
-	return 0;
+	return g_blob_num_clusters;
 }
 
 int
@@ -204,10 +207,167 @@ spdk_blob_is_clone(struct spdk_blob *blob)
 	return false;
 }
 
+bool g_blob_is_thin_provisioned = false;
+
 bool
 spdk_blob_is_thin_provisioned(struct spdk_blob *blob)
 {
-	return false;
+	return g_blob_is_thin_provisioned;
+}
+
+bool g_changed_clusters[8];
+spdk_blob_id g_copy_base_not_in_chain = SPDK_BLOBID_INVALID;
+
+int
+spdk_blob_get_next_changed_cluster(struct spdk_blob *blob, spdk_blob_id base_id,
+				   uint64_t cluster, uint64_t *next)
+{
+	if (base_id != SPDK_BLOBID_INVALID && base_id == g_copy_base_not_in_chain) {
+		return -EINVAL;
+	}
+
+	for (; cluster < SPDK_COUNTOF(g_changed_clusters); cluster++) {
+		if (g_changed_clusters[cluster]) {
+			*next = cluster;
+			return 0;
+		}
+	}
+
+	*next = UINT64_MAX;
+	return 0;
+}
+
+static struct spdk_bdev g_copy_dst_bdev = {
+	.name = "copy_dst",
+	.blocklen = 512,
+	.blockcnt = 1024 * 1024,
+};
+static struct spdk_io_channel *g_copy_ch = (struct spdk_io_channel *)0xDEADBEEF;
+static struct spdk_bdev_io_wait_entry *g_copy_io_wait;
+int g_copy_open_descs;
+bool g_copy_dst_claimed;
+int g_copy_read_rc;
+bool g_copy_read_success = true;
+uint64_t g_copy_read_offsets[16];
+uint64_t g_copy_read_lengths[16];
+uint64_t g_copy_write_offsets[16];
+int g_copy_reads;
+int g_copy_writes;
+
+int
+spdk_bdev_open_ext(const char *bdev_name, bool write, spdk_bdev_event_cb_t event_cb,
+		   void *event_ctx, struct spdk_bdev_desc **desc)
+{
+	if (!strcmp(bdev_name, "test") && g_lvol != NULL) {
+		*desc = (struct spdk_bdev_desc *)g_lvol->bdev;
+	} else if (!strcmp(bdev_name, g_copy_dst_bdev.name)) {
+		*desc = (struct spdk_bdev_desc *)&g_copy_dst_bdev;
+	} else {
+		return -ENODEV;
+	}
+
+	g_copy_open_descs++;
+	return 0;
+}
+
+void
+spdk_bdev_close(struct spdk_bdev_desc *desc)
+{
+	g_copy_open_descs--;
+}
+
+struct spdk_bdev *
+spdk_bdev_desc_get_bdev(struct spdk_bdev_desc *desc)
+{
+	return (struct spdk_bdev *)desc;
+}
+
+int
+spdk_bdev_module_claim_bdev(struct spdk_bdev *bdev, struct spdk_bdev_desc *desc,
+			    struct spdk_bdev_module *module)
+{
+	CU_ASSERT(bdev == &g_copy_dst_bdev);
+	g_copy_dst_claimed = true;
+	return 0;
+}
+
+void
+spdk_bdev_module_release_bdev(struct spdk_bdev *bdev)
+{
+	CU_ASSERT(bdev == &g_copy_dst_bdev);
+	g_copy_dst_claimed = false;
+}
+
+uint32_t
+spdk_bdev_get_block_size(const struct spdk_bdev *bdev)
+{
+	return bdev->blocklen;
+}
+
+uint64_t
+spdk_bdev_get_num_blocks(const struct spdk_bdev *bdev)
+{
+	return bdev->blockcnt;
+}
+
+size_t
+spdk_bdev_get_buf_align(const struct spdk_bdev *bdev)
+{
+	return 8;
+}
+
+struct spdk_io_channel *
+spdk_bdev_get_io_channel(struct spdk_bdev_desc *desc)
+{
+	return g_copy_ch;
+}
+
+void
+spdk_put_io_channel(struct spdk_io_channel *ch)
+{
+	CU_ASSERT(ch == g_copy_ch || ch == g_ch);
+}
+
+int
+spdk_bdev_read(struct spdk_bdev_desc *desc, struct spdk_io_channel *ch,
+	       void *buf, uint64_t offset, uint64_t nbytes,
+	       spdk_bdev_io_completion_cb cb, void *cb_arg)
+{
+	if (g_copy_read_rc != 0) {
+		return g_copy_read_rc;
+	}
+
+	SPDK_CU_ASSERT_FATAL(g_copy_reads < (int)SPDK_COUNTOF(g_copy_read_offsets));
+	g_copy_read_lengths[g_copy_reads] = nbytes;
+	g_copy_read_offsets[g_copy_reads++] = offset;
+	cb((struct spdk_bdev_io *)0x1, g_copy_read_success, cb_arg);
+	return 0;
+}
+
+int
+spdk_bdev_write(struct spdk_bdev_desc *desc, struct spdk_io_channel *ch,
+		void *buf, uint64_t offset, uint64_t nbytes,
+		spdk_bdev_io_completion_cb cb, void *cb_arg)
+{
+	CU_ASSERT(desc == (struct spdk_bdev_desc *)&g_copy_dst_bdev);
+	SPDK_CU_ASSERT_FATAL(g_copy_writes < (int)SPDK_COUNTOF(g_copy_write_offsets));
+	g_copy_write_offsets[g_copy_writes++] = offset;
+	cb((struct spdk_bdev_io *)0x1, true, cb_arg);
+	return 0;
+}
+
+void
+spdk_bdev_free_io(struct spdk_bdev_io *bdev_io)
+{
+}
+
+int
+spdk_bdev_queue_io_wait(struct spdk_bdev *bdev, struct spdk_io_channel *ch,
+			struct spdk_bdev_io_wait_entry *entry)
+{
+	CU_ASSERT(g_copy_io_wait == NULL);
+	g_copy_io_wait = entry;
+	return 0;
 }
 
 static struct spdk_lvol *_lvol_create(struct spdk_lvol_store *lvs);
@@ -469,23 +629,143 @@ spdk_bdev_io_complete(struct spdk_bdev_io *bdev_io, enum spdk_bdev_io_status sta
 	bdev_io->internal.status = status;
 }
 
+struct spdk_lvol_store *g_migrate_dst_lvs;
+
 struct spdk_io_channel *spdk_lvol_get_io_channel(struct spdk_lvol *lvol)
 {
-	CU_ASSERT(lvol == g_lvol);
+	CU_ASSERT(lvol == g_lvol || lvol->lvol_store == g_migrate_dst_lvs);
+	return g_ch;
+}
+
+int g_blob_set_xattr_rc;
+char g_blob_xattr_uuid[SPDK_UUID_STRING_LEN];
+int g_blob_xattr_sets;
+int g_blob_xattr_removes;
+
+int
+spdk_blob_set_xattr(struct spdk_blob *blob, const char *name, const void *value,
+		    uint16_t value_len)
+{
+	CU_ASSERT(strcmp(name, "uuid") == 0);
+	CU_ASSERT(value_len == sizeof(g_blob_xattr_uuid));
+	if (g_blob_set_xattr_rc == 0) {
+		memcpy(g_blob_xattr_uuid, value, sizeof(g_blob_xattr_uuid));
+		g_blob_xattr_sets++;
+	}
+	return g_blob_set_xattr_rc;
+}
+
+int
+spdk_blob_remove_xattr(struct spdk_blob *blob, const char *name)
+{
+	CU_ASSERT(strcmp(name, "uuid") == 0);
+	g_blob_xattr_removes++;
+	return 0;
+}
+
+/* Called while a migration is frozen, before it cuts over */
+void (*g_blob_sync_md_hook)(void);
+int g_blob_sync_md_rc;
+
+void
+spdk_blob_sync_md(struct spdk_blob *blob, spdk_blob_op_complete cb_fn, void *cb_arg)
+{
+	if (g_blob_sync_md_hook != NULL) {
+		g_blob_sync_md_hook();
+	}
+	cb_fn(cb_arg, g_blob_sync_md_rc);
+}
+
+void
+spdk_io_device_register(void *io_device, spdk_io_channel_create_cb create_cb,
+			spdk_io_channel_destroy_cb destroy_cb, uint32_t ctx_size,
+			const char *name)
+{
+}
+
+void
+spdk_io_device_unregister(void *io_device, spdk_io_device_unregister_cb unregister_cb)
+{
+}
+
+struct spdk_io_channel *
+spdk_get_io_channel(void *io_device)
+{
 	return g_ch;
 }
 
+/* Channels of the lvol io_device visited by spdk_for_each_channel() */
+struct spdk_io_channel *g_lvol_chs[2];
+
+struct spdk_io_channel_iter {
+	void *ctx;
+	struct spdk_io_channel *ch;
+	int status;
+};
+
+void
+spdk_for_each_channel(void *io_device, spdk_channel_msg fn, void *ctx,
+		      spdk_channel_for_each_cpl cpl)
+{
+	struct spdk_io_channel_iter i = { .ctx = ctx };
+	size_t idx;
+
+	for (idx = 0; idx < SPDK_COUNTOF(g_lvol_chs) && g_lvol_chs[idx] != NULL; idx++) {
+		i.ch = g_lvol_chs[idx];
+		fn(&i);
+		CU_ASSERT(i.status == 0);
+	}
+
+	cpl(&i, 0);
+}
+
+void *
+spdk_io_channel_iter_get_ctx(struct spdk_io_channel_iter *i)
+{
+	return i->ctx;
+}
+
+struct spdk_io_channel *
+spdk_io_channel_iter_get_channel(struct spdk_io_channel_iter *i)
+{
+	return i->ch;
+}
+
+void
+spdk_for_each_channel_continue(struct spdk_io_channel_iter *i, int status)
+{
+	i->status = status;
+}
+
 void
 spdk_bdev_io_get_buf(struct spdk_bdev_io *bdev_io, spdk_bdev_io_get_buf_cb cb, uint64_t len)
 {
 	CU_ASSERT(cb == lvol_get_buf_cb);
 }
 
+/* Copies done by a migration are recorded instead of checked against g_io */
+bool g_blob_io_record;
+uint64_t g_blob_io_read_offsets[16];
+uint64_t g_blob_io_write_offsets[16];
+int g_blob_io_reads;
+int g_blob_io_writes;
+void (*g_blob_io_read_hook)(void);
+
 void
 spdk_blob_io_read(struct spdk_blob *blob, struct spdk_io_channel *channel,
 		  void *payload, uint64_t offset, uint64_t length,
 		  spdk_blob_op_complete cb_fn, void *cb_arg)
 {
+	if (g_blob_io_record) {
+		SPDK_CU_ASSERT_FATAL(g_blob_io_reads < (int)SPDK_COUNTOF(g_blob_io_read_offsets));
+		g_blob_io_read_offsets[g_blob_io_reads++] = offset;
+		if (g_blob_io_read_hook != NULL) {
+			g_blob_io_read_hook();
+		}
+		cb_fn(cb_arg, 0);
+		return;
+	}
+
 	CU_ASSERT(blob == NULL);
 	CU_ASSERT(channel == g_ch);
 	CU_ASSERT(offset == g_io->u.bdev.offset_blocks);
@@ -498,6 +778,13 @@ spdk_blob_io_write(struct spdk_blob *blob, struct spdk_io_channel *channel,
 		   void *payload, uint64_t offset, uint64_t length,
 		   spdk_blob_op_complete cb_fn, void *cb_arg)
 {
+	if (g_blob_io_record) {
+		SPDK_CU_ASSERT_FATAL(g_blob_io_writes < (int)SPDK_COUNTOF(g_blob_io_write_offsets));
+		g_blob_io_write_offsets[g_blob_io_writes++] = offset;
+		cb_fn(cb_arg, 0);
+		return;
+	}
+
 	CU_ASSERT(blob == NULL);
 	CU_ASSERT(channel == g_ch);
 	CU_ASSERT(offset == g_io->u.bdev.offset_blocks);
@@ -594,6 +881,8 @@ _lvol_create(struct spdk_lvol_store *lvs)
 	return lvol;
 }
 
+bool g_lvol_create_thin_provision;
+
 int
 spdk_lvol_create(struct spdk_lvol_store *lvs, const char *name, size_t sz,
 		 bool thin_provision, enum lvol_clear_method clear_method, spdk_lvol_op_with_handle_complete cb_fn,
@@ -603,6 +892,8 @@ spdk_lvol_create(struct spdk_lvol_store *lvs, const char *name, size_t sz,
 
 	lvol = _lvol_create(lvs);
 	snprintf(lvol->name, sizeof(lvol->name), "%s", name);
+	lvol->thin_provision = thin_provision;
+	g_lvol_create_thin_provision = thin_provision;
 	cb_fn(cb_arg, lvol, 0);
 
 	return 0;
@@ -1148,6 +1439,157 @@ ut_lvol_set_read_only(void)
 	CU_ASSERT(g_lvol_store == NULL);
 }
 
+static void
+vbdev_lvol_shallow_copy_complete(void *cb_arg, int lvolerrno)
+{
+	g_lvolerrno = lvolerrno;
+}
+
+static void
+ut_lvol_shallow_copy_reset(void)
+{
+	g_copy_reads = 0;
+	g_copy_writes = 0;
+	memset(g_copy_read_offsets, 0, sizeof(g_copy_read_offsets));
+	memset(g_copy_read_lengths, 0, sizeof(g_copy_read_lengths));
+	memset(g_copy_write_offsets, 0, sizeof(g_copy_write_offsets));
+	g_lvolerrno = -1;
+}
+
+static void
+ut_lvol_shallow_copy(void)
+{
+	struct spdk_lvol_store *lvs;
+	struct spdk_bdev_io_wait_entry *entry;
+	struct spdk_lvol *lvol;
+	uint64_t mb = 1024 * 1024;
+	int sz = 10;
+	int rc, i;
+
+	g_cluster_size = 2 * mb;
+
+	rc = vbdev_lvs_create(&g_bdev, "lvs", 0, LVS_CLEAR_WITH_UNMAP, lvol_store_op_with_handle_complete,
+			      NULL);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_lvserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_lvol_store != NULL);
+	lvs = g_lvol_store;
+
+	g_lvolerrno = -1;
+	rc = vbdev_lvol_create(lvs, "lvol", sz, false, LVOL_CLEAR_WITH_DEFAULT, vbdev_lvol_create_complete,
+			       NULL);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_lvolerrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_lvol != NULL);
+	lvol = g_lvol;
+
+	memset(g_changed_clusters, 0, sizeof(g_changed_clusters));
+	g_changed_clusters[1] = true;
+	g_changed_clusters[3] = true;
+
+	/* Only read only lvols can be copied */
+	ut_lvol_shallow_copy_reset();
+	g_blob_is_read_only = false;
+	vbdev_lvol_shallow_copy(lvol, NULL, "copy_dst", 0, vbdev_lvol_shallow_copy_complete, NULL);
+	CU_ASSERT(g_lvolerrno == -EPERM);
+	CU_ASSERT(g_copy_reads == 0);
+
+	g_blob_is_read_only = true;
+
+	/* Each changed cluster is copied in two 1 MiB chunks to the same offset */
+	ut_lvol_shallow_copy_reset();
+	vbdev_lvol_shallow_copy(lvol, NULL, "copy_dst", 3, vbdev_lvol_shallow_copy_complete, NULL);
+	CU_ASSERT(g_lvolerrno == 0);
+	CU_ASSERT(g_copy_reads == 4);
+	CU_ASSERT(g_copy_writes == 4);
+	CU_ASSERT(g_copy_read_offsets[0] == 2 * mb);
+	CU_ASSERT(g_copy_read_offsets[1] == 3 * mb);
+	CU_ASSERT(g_copy_read_offsets[2] == 6 * mb);
+	CU_ASSERT(g_copy_read_offsets[3] == 7 * mb);
+	for (i = 0; i < 4; i++) {
+		CU_ASSERT(g_copy_write_offsets[i] == g_copy_read_offsets[i]);
+	}
+	CU_ASSERT(g_copy_open_descs == 0);
+	CU_ASSERT(g_copy_dst_claimed == false);
+
+	/* A cluster size that isn't a multiple of the chunk size ends with a short chunk */
+	ut_lvol_shallow_copy_reset();
+	g_cluster_size = 3 * mb / 2;
+	vbdev_lvol_shallow_copy(lvol, NULL, "copy_dst", 3, vbdev_lvol_shallow_copy_complete, NULL);
+	CU_ASSERT(g_lvolerrno == 0);
+	CU_ASSERT(g_copy_reads == 4);
+	CU_ASSERT(g_copy_writes == 4);
+	CU_ASSERT(g_copy_read_offsets[0] == 3 * mb / 2);
+	CU_ASSERT(g_copy_read_lengths[0] == mb);
+	CU_ASSERT(g_copy_read_offsets[1] == 5 * mb / 2);
+	CU_ASSERT(g_copy_read_lengths[1] == mb / 2);
+	CU_ASSERT(g_copy_read_offsets[2] == 9 * mb / 2);
+	CU_ASSERT(g_copy_read_lengths[2] == mb);
+	CU_ASSERT(g_copy_read_offsets[3] == 11 * mb / 2);
+	CU_ASSERT(g_copy_read_lengths[3] == mb / 2);
+	CU_ASSERT(g_copy_open_descs == 0);
+	g_cluster_size = 2 * mb;
+
+	/* Destination bdev does not exist */
+	ut_lvol_shallow_copy_reset();
+	vbdev_lvol_shallow_copy(lvol, NULL, "nonexistent", 0, vbdev_lvol_shallow_copy_complete, NULL);
+	CU_ASSERT(g_lvolerrno == -ENODEV);
+	CU_ASSERT(g_copy_reads == 0);
+	CU_ASSERT(g_copy_open_descs == 0);
+
+	/* Base is not a snapshot in the chain of the lvol */
+	ut_lvol_shallow_copy_reset();
+	g_copy_base_not_in_chain = lvol->blob_id = 0x10;
+	vbdev_lvol_shallow_copy(lvol, lvol, "copy_dst", 0, vbdev_lvol_shallow_copy_complete, NULL);
+	CU_ASSERT(g_lvolerrno == -EINVAL);
+	CU_ASSERT(g_copy_reads == 0);
+	CU_ASSERT(g_copy_open_descs == 0);
+	g_copy_base_not_in_chain = SPDK_BLOBID_INVALID;
+
+	/* Queue depth above the maximum */
+	ut_lvol_shallow_copy_reset();
+	vbdev_lvol_shallow_copy(lvol, NULL, "copy_dst", 1000, vbdev_lvol_shallow_copy_complete, NULL);
+	CU_ASSERT(g_lvolerrno == -EINVAL);
+
+	/* Reads that can't get a bdev_io wait for one */
+	ut_lvol_shallow_copy_reset();
+	g_copy_read_rc = -ENOMEM;
+	vbdev_lvol_shallow_copy(lvol, NULL, "copy_dst", 1, vbdev_lvol_shallow_copy_complete, NULL);
+	CU_ASSERT(g_lvolerrno == -1);
+	SPDK_CU_ASSERT_FATAL(g_copy_io_wait != NULL);
+	CU_ASSERT(g_copy_io_wait->bdev == lvol->bdev);
+	g_copy_read_rc = 0;
+	entry = g_copy_io_wait;
+	g_copy_io_wait = NULL;
+	entry->cb_fn(entry->cb_arg);
+	CU_ASSERT(g_lvolerrno == 0);
+	CU_ASSERT(g_copy_reads == 4);
+	CU_ASSERT(g_copy_writes == 4);
+	CU_ASSERT(g_copy_open_descs == 0);
+
+	/* A failed read stops the copy */
+	ut_lvol_shallow_copy_reset();
+	g_copy_read_success = false;
+	vbdev_lvol_shallow_copy(lvol, NULL, "copy_dst", 2, vbdev_lvol_shallow_copy_complete, NULL);
+	CU_ASSERT(g_lvolerrno == -EIO);
+	CU_ASSERT(g_copy_reads == 1);
+	CU_ASSERT(g_copy_writes == 0);
+	CU_ASSERT(g_copy_open_descs == 0);
+	CU_ASSERT(g_copy_dst_claimed == false);
+	g_copy_read_success = true;
+
+	g_blob_is_read_only = false;
+
+	vbdev_lvol_destroy(lvol, lvol_store_op_complete, NULL);
+	CU_ASSERT(g_lvol == NULL);
+
+	vbdev_lvs_destruct(lvs, lvol_store_op_complete, NULL);
+	CU_ASSERT(g_lvserrno == 0);
+	CU_ASSERT(g_lvol_store == NULL);
+
+	g_cluster_size = 0;
+}
+
 static void
 ut_lvs_unload(void)
 {
@@ -1305,27 +1747,73 @@ ut_vbdev_lvol_io_type_supported(void)
 	free(lvol);
 }
 
+static struct spdk_io_channel *
+ut_lvol_alloc_channel(struct spdk_lvol *lvol)
+{
+	struct spdk_io_channel *ch;
+	struct vbdev_lvol_io_channel *lvol_ch;
+
+	ch = calloc(1, sizeof(*ch) + sizeof(*lvol_ch));
+	SPDK_CU_ASSERT_FATAL(ch != NULL);
+	lvol_ch = spdk_io_channel_get_ctx(ch);
+	lvol_ch->lvol = lvol;
+	lvol_ch->bs_ch = g_ch;
+	TAILQ_INIT(&lvol_ch->frozen_ios);
+
+	return ch;
+}
+
+static void
+ut_lvol_free_channel(struct spdk_io_channel *ch)
+{
+	struct vbdev_lvol_io_channel *lvol_ch = spdk_io_channel_get_ctx(ch);
+
+	free(lvol_ch->heatmap_reads);
+	free(lvol_ch->heatmap_writes);
+	spdk_bit_array_free(&lvol_ch->dirty);
+	free(ch);
+}
+
+static struct spdk_bdev_io *
+ut_lvol_alloc_bdev_io(void)
+{
+	struct spdk_bdev_io *bdev_io;
+
+	bdev_io = calloc(1, sizeof(*bdev_io) + vbdev_lvs_get_ctx_size());
+	SPDK_CU_ASSERT_FATAL(bdev_io != NULL);
+
+	return bdev_io;
+}
+
 static void
 ut_lvol_read_write(void)
 {
-	g_io = calloc(1, sizeof(struct spdk_bdev_io));
-	SPDK_CU_ASSERT_FATAL(g_io != NULL);
+	struct spdk_io_channel *ch;
+	struct vbdev_lvol_io_channel *lvol_ch;
+
+	g_io = ut_lvol_alloc_bdev_io();
 	g_base_bdev = calloc(1, sizeof(struct spdk_bdev));
 	SPDK_CU_ASSERT_FATAL(g_base_bdev != NULL);
 	g_lvol = calloc(1, sizeof(struct spdk_lvol));
 	SPDK_CU_ASSERT_FATAL(g_lvol != NULL);
+	ch = ut_lvol_alloc_channel(g_lvol);
+	lvol_ch = spdk_io_channel_get_ctx(ch);
 
 	g_io->bdev = g_base_bdev;
 	g_io->bdev->ctxt = g_lvol;
 	g_io->u.bdev.offset_blocks = 20;
 	g_io->u.bdev.num_blocks = 20;
 
-	lvol_read(g_ch, g_io);
+	/* Normally counted on submission */
+	lvol_ch->io_outstanding = 2;
+
+	lvol_read(lvol_ch, g_io);
 	CU_ASSERT(g_io->internal.status = SPDK_BDEV_IO_STATUS_SUCCESS);
 
-	lvol_write(g_lvol, g_ch, g_io);
+	lvol_write(lvol_ch, g_io);
 	CU_ASSERT(g_io->internal.status = SPDK_BDEV_IO_STATUS_SUCCESS);
 
+	ut_lvol_free_channel(ch);
 	free(g_io);
 	free(g_base_bdev);
 	free(g_lvol);
@@ -1335,20 +1823,346 @@ static void
 ut_vbdev_lvol_submit_request(void)
 {
 	struct spdk_lvol request_lvol = {};
-	g_io = calloc(1, sizeof(struct spdk_bdev_io));
-	SPDK_CU_ASSERT_FATAL(g_io != NULL);
+	struct spdk_io_channel *ch;
+	struct vbdev_lvol_io_channel *lvol_ch;
+
+	g_io = ut_lvol_alloc_bdev_io();
 	g_base_bdev = calloc(1, sizeof(struct spdk_bdev));
 	SPDK_CU_ASSERT_FATAL(g_base_bdev != NULL);
 	g_io->bdev = g_base_bdev;
+	ch = ut_lvol_alloc_channel(&request_lvol);
+	lvol_ch = spdk_io_channel_get_ctx(ch);
 
 	g_io->type = SPDK_BDEV_IO_TYPE_READ;
 	g_base_bdev->ctxt = &request_lvol;
-	vbdev_lvol_submit_request(g_ch, g_io);
+	vbdev_lvol_submit_request(ch, g_io);
 
+	/* The read waits for a buffer, the stub never provides one */
+	CU_ASSERT(lvol_ch->io_outstanding == 1);
+	lvol_get_buf_cb(ch, g_io, false);
+	CU_ASSERT(lvol_ch->io_outstanding == 0);
+	CU_ASSERT(g_io->internal.status == SPDK_BDEV_IO_STATUS_FAILED);
+
+	ut_lvol_free_channel(ch);
 	free(g_io);
 	free(g_base_bdev);
 }
 
+static const struct vbdev_lvol_heatmap *g_heatmap;
+static uint64_t g_heatmap_reads[8];
+static uint64_t g_heatmap_writes[8];
+
+static void
+ut_lvol_heatmap_cb(void *cb_arg, const struct vbdev_lvol_heatmap *heatmap, int rc)
+{
+	g_lvolerrno = rc;
+	g_heatmap = heatmap;
+	if (heatmap != NULL) {
+		CU_ASSERT(heatmap->num_clusters == SPDK_COUNTOF(g_heatmap_reads));
+		memcpy(g_heatmap_reads, heatmap->reads, sizeof(g_heatmap_reads));
+		memcpy(g_heatmap_writes, heatmap->writes, sizeof(g_heatmap_writes));
+	}
+}
+
+static void
+ut_lvol_heatmap(void)
+{
+	struct spdk_bdev bdev = { .blocklen = 512, .blockcnt = 64, .optimal_io_boundary = 8 };
+	struct spdk_bdev_io *bdev_io;
+	int i;
+
+	g_lvol = calloc(1, sizeof(struct spdk_lvol));
+	SPDK_CU_ASSERT_FATAL(g_lvol != NULL);
+	g_lvol->bdev = &bdev;
+	bdev.ctxt = g_lvol;
+	g_blob_num_clusters = 8;
+	g_lvol_chs[0] = ut_lvol_alloc_channel(g_lvol);
+	g_lvol_chs[1] = ut_lvol_alloc_channel(g_lvol);
+	g_io = bdev_io = ut_lvol_alloc_bdev_io();
+	bdev_io->bdev = &bdev;
+
+	/* Writes to cluster 2 on the first channel, one in sample rate is counted */
+	bdev_io->type = SPDK_BDEV_IO_TYPE_WRITE;
+	bdev_io->u.bdev.offset_blocks = 17;
+	bdev_io->u.bdev.num_blocks = 1;
+	for (i = 0; i < 3 * VBDEV_LVOL_HEATMAP_SAMPLE_RATE; i++) {
+		vbdev_lvol_submit_request(g_lvol_chs[0], bdev_io);
+	}
+
+	/* Unmap of cluster 2 and reads of cluster 7 on the second channel */
+	bdev_io->type = SPDK_BDEV_IO_TYPE_UNMAP;
+	bdev_io->u.bdev.offset_blocks = 16;
+	bdev_io->u.bdev.num_blocks = 8;
+	for (i = 0; i < VBDEV_LVOL_HEATMAP_SAMPLE_RATE; i++) {
+		vbdev_lvol_submit_request(g_lvol_chs[1], bdev_io);
+	}
+	bdev_io->type = SPDK_BDEV_IO_TYPE_READ;
+	bdev_io->u.bdev.offset_blocks = 63;
+	bdev_io->u.bdev.num_blocks = 1;
+	for (i = 0; i < 2 * VBDEV_LVOL_HEATMAP_SAMPLE_RATE; i++) {
+		vbdev_lvol_submit_request(g_lvol_chs[1], bdev_io);
+	}
+
+	/* Counts of both channels are summed up */
+	g_lvolerrno = -1;
+	vbdev_lvol_get_heatmap(g_lvol, false, ut_lvol_heatmap_cb, NULL);
+	CU_ASSERT(g_lvolerrno == 0);
+	CU_ASSERT(g_heatmap != NULL);
+	CU_ASSERT(g_copy_open_descs == 0);
+	for (i = 0; i < 8; i++) {
+		CU_ASSERT(g_heatmap_reads[i] == (i == 7 ? 2 : 0));
+		CU_ASSERT(g_heatmap_writes[i] == (i == 2 ? 4 : 0));
+	}
+
+	/* Reading without reset keeps the counts, reset clears them afterwards */
+	vbdev_lvol_get_heatmap(g_lvol, true, ut_lvol_heatmap_cb, NULL);
+	CU_ASSERT(g_lvolerrno == 0);
+	CU_ASSERT(g_heatmap_reads[7] == 2);
+	CU_ASSERT(g_heatmap_writes[2] == 4);
+
+	vbdev_lvol_get_heatmap(g_lvol, false, ut_lvol_heatmap_cb, NULL);
+	CU_ASSERT(g_lvolerrno == 0);
+	for (i = 0; i < 8; i++) {
+		CU_ASSERT(g_heatmap_reads[i] == 0);
+		CU_ASSERT(g_heatmap_writes[i] == 0);
+	}
+
+	/* No heatmap for missing lvol */
+	vbdev_lvol_get_heatmap(NULL, false, ut_lvol_heatmap_cb, NULL);
+	CU_ASSERT(g_lvolerrno == -EINVAL);
+	CU_ASSERT(g_heatmap == NULL);
+
+	ut_lvol_free_channel(g_lvol_chs[0]);
+	ut_lvol_free_channel(g_lvol_chs[1]);
+	g_lvol_chs[0] = NULL;
+	g_lvol_chs[1] = NULL;
+	g_blob_num_clusters = 0;
+	free(bdev_io);
+	g_io = NULL;
+	free(g_lvol);
+	g_lvol = NULL;
+}
+
+static struct spdk_io_channel *g_migrate_ch;
+static struct spdk_bdev_io *g_migrate_write_io;
+static struct spdk_lvol *g_migrate_lvol;
+static int g_migrate_busy_rc;
+
+static void
+ut_lvol_migrate_submit_write(uint64_t offset_blocks)
+{
+	struct spdk_bdev_io *bdev_io = g_migrate_write_io;
+
+	bdev_io->type = SPDK_BDEV_IO_TYPE_WRITE;
+	bdev_io->u.bdev.offset_blocks = offset_blocks;
+	bdev_io->u.bdev.num_blocks = 1;
+	bdev_io->internal.status = SPDK_BDEV_IO_STATUS_PENDING;
+	vbdev_lvol_submit_request(g_migrate_ch, bdev_io);
+}
+
+/* A write to cluster 5 lands on the source while the first pass copies */
+static void
+ut_lvol_migrate_read_hook(void)
+{
+	g_blob_io_read_hook = NULL;
+	ut_lvol_migrate_submit_write(5 * 512);
+	CU_ASSERT(g_migrate_write_io->internal.status == SPDK_BDEV_IO_STATUS_SUCCESS);
+
+	g_migrate_busy_rc = 0;
+	vbdev_lvol_destroy(g_migrate_lvol, lvol_store_op_complete, NULL);
+	g_migrate_busy_rc = g_lvserrno;
+}
+
+static int g_migrate_sync_md_calls;
+
+/* A write submitted while frozen waits for the cutover */
+static void
+ut_lvol_migrate_sync_md_hook(void)
+{
+	struct vbdev_lvol_io_channel *lvol_ch = spdk_io_channel_get_ctx(g_migrate_ch);
+
+	CU_ASSERT(lvol_ch->frozen == true);
+	/* The source drops its uuid before the destination takes it */
+	if (++g_migrate_sync_md_calls > 1) {
+		CU_ASSERT(g_blob_xattr_removes == 1);
+		return;
+	}
+	ut_lvol_migrate_submit_write(0);
+	CU_ASSERT(g_migrate_write_io->internal.status == SPDK_BDEV_IO_STATUS_PENDING);
+	CU_ASSERT(TAILQ_FIRST(&lvol_ch->frozen_ios) == g_migrate_write_io);
+}
+
+/* The destination fails to take the uuid, the source gets it back */
+static void
+ut_lvol_migrate_sync_md_fail_hook(void)
+{
+	ut_lvol_migrate_sync_md_hook();
+	g_blob_sync_md_rc = g_migrate_sync_md_calls == 2 ? -EIO : 0;
+}
+
+static void
+ut_lvol_migrate(void)
+{
+	struct spdk_lvol_store *lvs, *lvs2;
+	struct lvol_store_bdev *lvs_bdev2;
+	struct spdk_lvol *lvol, *dst;
+	struct spdk_bdev *bdev;
+	struct vbdev_lvol_io_channel *lvol_ch;
+	struct spdk_io_channel *ch_save = g_ch;
+	uint64_t expected[] = { 512, 768, 1536, 1792, 2560, 2816 };
+	int rc, i;
+
+	g_cluster_size = 2 * 1024 * 1024;
+	g_blob_num_clusters = 8;
+	g_ch = (struct spdk_io_channel *)0xFEEDBEEF;
+
+	rc = vbdev_lvs_create(&g_bdev, "lvs", 0, LVS_CLEAR_WITH_UNMAP, lvol_store_op_with_handle_complete,
+			      NULL);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_lvserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_lvol_store != NULL);
+	lvs = g_lvol_store;
+
+	g_lvolerrno = -1;
+	rc = vbdev_lvol_create(lvs, "lvol", 8 * g_cluster_size, false, LVOL_CLEAR_WITH_DEFAULT,
+			       vbdev_lvol_create_complete, NULL);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(g_lvolerrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_lvol != NULL);
+	lvol = g_migrate_lvol = g_lvol;
+	bdev = lvol->bdev;
+	snprintf(lvol->uuid_str, sizeof(lvol->uuid_str), "%s", "src-uuid");
+
+	/* Second lvol store, the base bdev is already claimed by the first one */
+	lvs2 = calloc(1, sizeof(*lvs2));
+	SPDK_CU_ASSERT_FATAL(lvs2 != NULL);
+	TAILQ_INIT(&lvs2->lvols);
+	TAILQ_INIT(&lvs2->pending_lvols);
+	snprintf(lvs2->name, sizeof(lvs2->name), "%s", "lvs2");
+	lvs_bdev2 = calloc(1, sizeof(*lvs_bdev2));
+	SPDK_CU_ASSERT_FATAL(lvs_bdev2 != NULL);
+	lvs_bdev2->lvs = lvs2;
+	lvs_bdev2->bdev = &g_bdev;
+	TAILQ_INSERT_TAIL(&g_spdk_lvol_pairs, lvs_bdev2, lvol_stores);
+	g_migrate_dst_lvs = lvs2;
+
+	g_migrate_ch = g_lvol_chs[0] = ut_lvol_alloc_channel(lvol);
+	lvol_ch = spdk_io_channel_get_ctx(g_migrate_ch);
+	g_io = g_migrate_write_io = ut_lvol_alloc_bdev_io();
+	g_migrate_write_io->bdev = bdev;
+
+	memset(g_changed_clusters, 0, sizeof(g_changed_clusters));
+	g_changed_clusters[1] = true;
+	g_changed_clusters[3] = true;
+	g_blob_io_record = true;
+
+	/* Allocated clusters are copied first, then the one written meanwhile. The bdev
+	 * keeps its name and moves to the new lvol, the old one is deleted. */
+	g_blob_io_read_hook = ut_lvol_migrate_read_hook;
+	g_blob_sync_md_hook = ut_lvol_migrate_sync_md_hook;
+	g_lvserrno = -1;
+	g_blob_xattr_sets = 0;
+	g_blob_xattr_removes = 0;
+	g_migrate_sync_md_calls = 0;
+	vbdev_lvol_migrate(lvol, lvs2, 1, lvol_store_op_complete, NULL);
+	CU_ASSERT(g_lvserrno == 0);
+	CU_ASSERT(g_migrate_busy_rc == -EBUSY);
+	CU_ASSERT(g_blob_xattr_removes == 1);
+	CU_ASSERT(g_blob_xattr_sets == 1);
+	CU_ASSERT(g_blob_io_reads == SPDK_COUNTOF(expected));
+	CU_ASSERT(g_blob_io_writes == SPDK_COUNTOF(expected));
+	for (i = 0; i < (int)SPDK_COUNTOF(expected); i++) {
+		CU_ASSERT(g_blob_io_read_offsets[i] == expected[i]);
+		CU_ASSERT(g_blob_io_write_offsets[i] == expected[i]);
+	}
+	CU_ASSERT(TAILQ_EMPTY(&lvs->lvols));
+	dst = TAILQ_FIRST(&lvs2->lvols);
+	SPDK_CU_ASSERT_FATAL(dst != NULL);
+	CU_ASSERT(bdev->ctxt == dst);
+	CU_ASSERT(dst->bdev == bdev);
+	/* The source is thick provisioned, so the destination is too */
+	CU_ASSERT(dst->thin_provision == false);
+	CU_ASSERT(strcmp(dst->uuid_str, "src-uuid") == 0);
+	CU_ASSERT(strcmp(g_blob_xattr_uuid, "src-uuid") == 0);
+	CU_ASSERT(strcmp(TAILQ_FIRST(&bdev->aliases)->alias, "lvs2/lvol") == 0);
+	CU_ASSERT(lvol_ch->lvol == dst);
+	CU_ASSERT(lvol_ch->frozen == false);
+	CU_ASSERT(lvol_ch->dirty == NULL);
+	CU_ASSERT(lvol_ch->dst_bs_ch == NULL);
+	CU_ASSERT(lvol_ch->io_outstanding == 0);
+	CU_ASSERT(TAILQ_EMPTY(&lvol_ch->frozen_ios));
+	CU_ASSERT(g_migrate_write_io->internal.status == SPDK_BDEV_IO_STATUS_SUCCESS);
+
+	/* Failing to persist the identity leaves the lvol where it was, with its uuid
+	 * given back. A thin provisioned source gets a thin provisioned destination. */
+	g_lvol = g_migrate_lvol = dst;
+	g_migrate_dst_lvs = lvs;
+	g_blob_io_reads = 0;
+	g_blob_io_writes = 0;
+	g_blob_xattr_sets = 0;
+	g_blob_xattr_removes = 0;
+	g_migrate_sync_md_calls = 0;
+	g_blob_sync_md_hook = ut_lvol_migrate_sync_md_fail_hook;
+	g_blob_is_thin_provisioned = true;
+	g_lvserrno = -1;
+	vbdev_lvol_migrate(dst, lvs, 0, lvol_store_op_complete, NULL);
+	CU_ASSERT(g_lvserrno == -EIO);
+	CU_ASSERT(g_migrate_sync_md_calls == 3);
+	CU_ASSERT(g_blob_xattr_removes == 1);
+	/* Set on the destination, then back on the source */
+	CU_ASSERT(g_blob_xattr_sets == 2);
+	CU_ASSERT(strcmp(g_blob_xattr_uuid, "src-uuid") == 0);
+	CU_ASSERT(g_lvol_create_thin_provision == true);
+	g_blob_is_thin_provisioned = false;
+	CU_ASSERT(g_blob_io_reads == 4);
+	CU_ASSERT(TAILQ_EMPTY(&lvs->lvols));
+	CU_ASSERT(TAILQ_FIRST(&lvs2->lvols) == dst);
+	CU_ASSERT(bdev->ctxt == dst);
+	CU_ASSERT(lvol_ch->lvol == dst);
+	CU_ASSERT(lvol_ch->frozen == false);
+	CU_ASSERT(lvol_ch->dirty == NULL);
+	CU_ASSERT(lvol_ch->dst_bs_ch == NULL);
+	CU_ASSERT(TAILQ_EMPTY(&lvol_ch->frozen_ios));
+	CU_ASSERT(g_migrate_write_io->internal.status == SPDK_BDEV_IO_STATUS_SUCCESS);
+	g_blob_sync_md_rc = 0;
+	g_blob_sync_md_hook = NULL;
+	g_lvol = dst;
+
+	/* Already in the destination lvol store */
+	g_lvserrno = -1;
+	vbdev_lvol_migrate(dst, lvs2, 0, lvol_store_op_complete, NULL);
+	CU_ASSERT(g_lvserrno == -EINVAL);
+
+	/* Queue depth above the maximum */
+	g_lvserrno = -1;
+	vbdev_lvol_migrate(dst, lvs, 1000, lvol_store_op_complete, NULL);
+	CU_ASSERT(g_lvserrno == -EINVAL);
+	CU_ASSERT(TAILQ_EMPTY(&lvs->lvols));
+
+	g_blob_io_record = false;
+	ut_lvol_free_channel(g_lvol_chs[0]);
+	g_lvol_chs[0] = g_migrate_ch = NULL;
+	free(g_migrate_write_io);
+	g_io = g_migrate_write_io = NULL;
+
+	vbdev_lvol_destroy(dst, lvol_store_op_complete, NULL);
+	CU_ASSERT(g_lvserrno == 0);
+	CU_ASSERT(TAILQ_EMPTY(&lvs2->lvols));
+
+	TAILQ_REMOVE(&g_spdk_lvol_pairs, lvs_bdev2, lvol_stores);
+	free(lvs_bdev2);
+	free(lvs2);
+	g_migrate_dst_lvs = NULL;
+
+	vbdev_lvs_destruct(lvs, lvol_store_op_complete, NULL);
+	CU_ASSERT(g_lvserrno == 0);
+	CU_ASSERT(g_lvol_store == NULL);
+
+	g_ch = ch_save;
+	g_blob_num_clusters = 0;
+	g_cluster_size = 0;
+}
+
 static void
 ut_lvs_rename(void)
 {
@@ -1422,11 +2236,14 @@ int main(int argc, char **argv)
 	CU_ADD_TEST(suite, ut_lvs_unload);
 	CU_ADD_TEST(suite, ut_lvol_resize);
 	CU_ADD_TEST(suite, ut_lvol_set_read_only);
+	CU_ADD_TEST(suite, ut_lvol_shallow_copy);
 	CU_ADD_TEST(suite, ut_lvol_hotremove);
 	CU_ADD_TEST(suite, ut_vbdev_lvol_get_io_channel);
 	CU_ADD_TEST(suite, ut_vbdev_lvol_io_type_supported);
 	CU_ADD_TEST(suite, ut_lvol_read_write);
 	CU_ADD_TEST(suite, ut_vbdev_lvol_submit_request);
+	CU_ADD_TEST(suite, ut_lvol_heatmap);
+	CU_ADD_TEST(suite, ut_lvol_migrate);
 	CU_ADD_TEST(suite, ut_lvol_examine);
 	CU_ADD_TEST(suite, ut_lvol_rename);
 	CU_ADD_TEST(suite, ut_lvol_destroy);
@@ -3238,6 +3238,241 @@ blob_dirty_shutdown(void)
 	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
 }
 
+static void
+blob_dirty_shutdown_many_blobs(void)
+{
+	struct spdk_blob_store *bs = g_bs;
+	struct spdk_blob *blob;
+	struct spdk_blob_opts blob_opts;
+	spdk_blob_id blobids[40];
+	uint64_t free_clusters;
+	uint32_t i;
+
+	/* Create enough blobs for the recovery to read the metadata in several
+	 *  windows. Every fourth blob is thin provisioned and every other one has a
+	 *  cluster allocated, so both extent descriptors and unallocated clusters
+	 *  are replayed. */
+	ut_spdk_blob_opts_init(&blob_opts);
+	for (i = 0; i < SPDK_COUNTOF(blobids); i++) {
+		blob_opts.thin_provision = (i % 4 == 3);
+		blob_opts.num_clusters = i % 2;
+		blob = ut_blob_create_and_open(bs, &blob_opts);
+		blobids[i] = spdk_blob_get_id(blob);
+
+		spdk_blob_close(blob, blob_op_complete, NULL);
+		poll_threads();
+		CU_ASSERT(g_bserrno == 0);
+	}
+	free_clusters = spdk_bs_free_cluster_count(bs);
+
+	ut_bs_dirty_load(&bs, NULL);
+
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == free_clusters);
+	for (i = 0; i < SPDK_COUNTOF(blobids); i++) {
+		CU_ASSERT(spdk_bit_array_get(bs->used_blobids, bs_blobid_to_page(blobids[i])) == true);
+
+		spdk_bs_open_blob(bs, blobids[i], blob_op_with_handle_complete, NULL);
+		poll_threads();
+		CU_ASSERT(g_bserrno == 0);
+		SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+		blob = g_blob;
+		CU_ASSERT(spdk_blob_get_num_clusters(blob) == i % 2);
+		CU_ASSERT(spdk_blob_is_thin_provisioned(blob) == (i % 4 == 3));
+
+		ut_blob_close_and_delete(bs, blob);
+	}
+
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == spdk_bs_total_data_cluster_count(bs));
+}
+
+static void
+blob_dirty_shutdown_journal(void)
+{
+	struct spdk_blob_store *bs = g_bs;
+	struct spdk_blob *blob;
+	struct spdk_io_channel *channel;
+	struct spdk_blob_opts blob_opts;
+	spdk_blob_id blobid, blobid2;
+	uint64_t free_clusters, read_bytes, pages_per_cluster;
+	uint8_t payload_write[4096], payload_read[4096];
+
+	pages_per_cluster = spdk_bs_get_cluster_size(bs) / spdk_bs_get_page_size(bs);
+	channel = spdk_bs_alloc_io_channel(bs);
+	SPDK_CU_ASSERT_FATAL(channel != NULL);
+
+	/* Thin provisioned blob with clusters allocated by writes */
+	ut_spdk_blob_opts_init(&blob_opts);
+	blob_opts.thin_provision = true;
+	blob_opts.num_clusters = 10;
+	blob = ut_blob_create_and_open(bs, &blob_opts);
+	blobid = spdk_blob_get_id(blob);
+
+	memset(payload_write, 0xE5, sizeof(payload_write));
+	spdk_blob_io_write(blob, channel, payload_write, 0, 1, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	spdk_blob_io_write(blob, channel, payload_write, pages_per_cluster * 5, 1, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+
+	spdk_blob_close(blob, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+
+	/* Blob that is shrunk and then deleted, releasing its clusters and md pages */
+	ut_spdk_blob_opts_init(&blob_opts);
+	blob_opts.num_clusters = 5;
+	blob = ut_blob_create_and_open(bs, &blob_opts);
+	blobid2 = spdk_blob_get_id(blob);
+
+	spdk_blob_resize(blob, 2, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	spdk_blob_sync_md(blob, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	ut_blob_close_and_delete(bs, blob);
+
+	spdk_bs_free_io_channel(channel);
+	poll_threads();
+
+	free_clusters = spdk_bs_free_cluster_count(bs);
+	CU_ASSERT(bs->journal.epoch == 1);
+
+	/* The recovery reads the journal and the md of the logged blobs only */
+	read_bytes = g_dev_read_bytes;
+	ut_bs_dirty_load(&bs, NULL);
+	CU_ASSERT(g_dev_read_bytes - read_bytes < (uint64_t)bs->md_len * SPDK_BS_PAGE_SIZE);
+	CU_ASSERT(bs->journal.epoch == 2);
+
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == free_clusters);
+	CU_ASSERT(spdk_bit_array_get(bs->used_blobids, bs_blobid_to_page(blobid)) == true);
+	CU_ASSERT(spdk_bit_array_get(bs->used_blobids, bs_blobid_to_page(blobid2)) == false);
+	CU_ASSERT(spdk_bit_array_get(bs->used_md_pages, bs_blobid_to_page(blobid2)) == false);
+
+	spdk_bs_open_blob(bs, blobid2, blob_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno != 0);
+
+	spdk_bs_open_blob(bs, blobid, blob_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	blob = g_blob;
+	CU_ASSERT(spdk_blob_get_num_clusters(blob) == 10);
+	CU_ASSERT(bs_cluster_to_lba(bs, spdk_bit_array_find_first_clear(bs->used_clusters, 0)) !=
+		  blob->active.clusters[0]);
+
+	channel = spdk_bs_alloc_io_channel(bs);
+	SPDK_CU_ASSERT_FATAL(channel != NULL);
+	spdk_blob_io_read(blob, channel, payload_read, pages_per_cluster * 5, 1, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(memcmp(payload_write, payload_read, sizeof(payload_read)) == 0);
+	spdk_bs_free_io_channel(channel);
+	poll_threads();
+
+	ut_blob_close_and_delete(bs, blob);
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == spdk_bs_total_data_cluster_count(bs));
+}
+
+static void
+blob_journal_checkpoint(void)
+{
+	struct spdk_blob_store *bs = g_bs;
+	struct spdk_bs_journal *journal = &bs->journal;
+	struct spdk_blob *blob;
+	struct spdk_blob_opts blob_opts;
+	spdk_blob_id blobid, blobid2;
+	uint64_t free_clusters, epoch;
+	uint32_t free_cluster, i;
+
+	epoch = journal->epoch;
+
+	/* An empty journal is not checkpointed */
+	spdk_delay_us(SPDK_BS_JOURNAL_CHECKPOINT_US);
+	poll_threads();
+	CU_ASSERT(journal->epoch == epoch);
+
+	ut_spdk_blob_opts_init(&blob_opts);
+	blob_opts.num_clusters = 2;
+	blob = ut_blob_create_and_open(bs, &blob_opts);
+	blobid = spdk_blob_get_id(blob);
+
+	/* Checkpoint the masks after the interval */
+	spdk_delay_us(SPDK_BS_JOURNAL_CHECKPOINT_US);
+	poll_threads();
+	CU_ASSERT(journal->epoch == epoch + 1);
+	CU_ASSERT(journal->masks_stale == false);
+	CU_ASSERT(journal->cur_page == 0);
+
+	/* The next md update logs the blob in the new epoch */
+	spdk_blob_resize(blob, 4, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	spdk_blob_sync_md(blob, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(blob->journal_epoch == epoch + 1);
+
+	/* Fill up the journal with releases of a cluster that stays free */
+	free_cluster = bs->total_clusters - 1;
+	CU_ASSERT(spdk_bit_array_get(bs->used_clusters, free_cluster) == false);
+	for (i = 0; i < journal->half_pages * SPDK_BS_JOURNAL_ENTRIES_PER_PAGE; i++) {
+		if (bs_journal_append(bs, SPDK_BS_JOURNAL_ENTRY_RELEASE_CLUSTERS, free_cluster, 1) == UINT64_MAX) {
+			break;
+		}
+	}
+	CU_ASSERT(journal->full == true);
+	CU_ASSERT(journal->cur_page == journal->half_pages);
+
+	/* The blob was logged in this epoch already */
+	spdk_blob_resize(blob, 6, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	spdk_blob_sync_md(blob, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(journal->epoch == epoch + 1);
+
+	spdk_blob_close(blob, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+
+	/* A new blob can't be logged in a full journal, so creating it waits for a checkpoint */
+	blob = ut_blob_create_and_open(bs, &blob_opts);
+	blobid2 = spdk_blob_get_id(blob);
+	CU_ASSERT(journal->epoch == epoch + 2);
+	CU_ASSERT(journal->full == false);
+
+	spdk_blob_close(blob, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	free_clusters = spdk_bs_free_cluster_count(bs);
+
+	ut_bs_dirty_load(&bs, NULL);
+	CU_ASSERT(bs->journal.epoch == epoch + 3);
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == free_clusters);
+
+	spdk_bs_open_blob(bs, blobid, blob_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	blob = g_blob;
+	CU_ASSERT(spdk_blob_get_num_clusters(blob) == 6);
+	ut_blob_close_and_delete(bs, blob);
+
+	spdk_bs_open_blob(bs, blobid2, blob_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	blob = g_blob;
+	CU_ASSERT(spdk_blob_get_num_clusters(blob) == 2);
+	ut_blob_close_and_delete(bs, blob);
+
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == spdk_bs_total_data_cluster_count(bs));
+}
+
 static void
 blob_flags(void)
 {
@@ -3641,7 +3876,7 @@ blob_insert_cluster_msg_test(void)
 	/* Specify cluster_num to allocate and new_cluster will be returned to insert on md_thread.
 	 * This is to simulate behaviour when cluster is allocated after blob creation.
 	 * Such as _spdk_bs_allocate_and_copy_cluster(). */
-	bs_allocate_cluster(blob, cluster_num, &new_cluster, &extent_page, false);
+	bs_allocate_cluster(blob, NULL, cluster_num, &new_cluster, &extent_page, false);
 	CU_ASSERT(blob->active.clusters[cluster_num] == 0);
 
 	blob_insert_cluster_on_md_thread(blob, cluster_num, new_cluster, extent_page,
@@ -3736,13 +3971,13 @@ blob_thin_prov_rw(void)
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	CU_ASSERT(free_clusters - 1 == spdk_bs_free_cluster_count(bs));
-	/* For thin-provisioned blob we need to write 20 pages plus one page metadata and
-	 * read 0 bytes */
+	/* For thin-provisioned blob we need to write 20 pages plus one page metadata,
+	 * one page of the allocation journal and read 0 bytes */
 	if (g_use_extent_table) {
 		/* Add one more page for EXTENT_PAGE write */
-		CU_ASSERT(g_dev_write_bytes - write_bytes == page_size * 22);
+		CU_ASSERT(g_dev_write_bytes - write_bytes == page_size * 23);
 	} else {
-		CU_ASSERT(g_dev_write_bytes - write_bytes == page_size * 21);
+		CU_ASSERT(g_dev_write_bytes - write_bytes == page_size * 22);
 	}
 	CU_ASSERT(g_dev_read_bytes - read_bytes == 0);
 
@@ -3763,6 +3998,254 @@ blob_thin_prov_rw(void)
 	g_blobid = 0;
 }
 
+static void
+blob_thin_prov_insert_cluster_batch(void)
+{
+	struct spdk_blob_store *bs = g_bs;
+	struct spdk_blob *blob;
+	struct spdk_io_channel *channel, *channel_thread1;
+	struct spdk_blob_opts opts;
+	uint64_t free_clusters;
+	uint64_t page_size;
+	uint64_t pages_per_cluster;
+	uint8_t payload[4096];
+	uint64_t write_bytes;
+
+	free_clusters = spdk_bs_free_cluster_count(bs);
+	page_size = spdk_bs_get_page_size(bs);
+	pages_per_cluster = spdk_bs_get_cluster_size(bs) / page_size;
+
+	set_thread(0);
+	channel = spdk_bs_alloc_io_channel(bs);
+	CU_ASSERT(channel != NULL);
+	set_thread(1);
+	channel_thread1 = spdk_bs_alloc_io_channel(bs);
+	CU_ASSERT(channel_thread1 != NULL);
+	set_thread(0);
+
+	ut_spdk_blob_opts_init(&opts);
+	opts.thin_provision = true;
+	opts.num_clusters = 4;
+
+	blob = ut_blob_create_and_open(bs, &opts);
+	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+	memset(payload, 0xE5, sizeof(payload));
+	g_bserrno = -1;
+
+	/* Allocate clusters 0 and 1 from two threads at once. Both insertions
+	 * reach the md thread before either is persisted, so they are committed
+	 * with a single md sync. */
+	write_bytes = g_dev_write_bytes;
+	set_thread(1);
+	spdk_blob_io_write(blob, channel_thread1, payload, 0, 1, blob_op_complete, NULL);
+	set_thread(0);
+	spdk_blob_io_write(blob, channel, payload, pages_per_cluster, 1,
+			   blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(free_clusters - 2 == spdk_bs_free_cluster_count(bs));
+	/* The blob is logged in the allocation journal on its first md update */
+	if (g_use_extent_table) {
+		/* Two data pages, the new extent page, the md page and the journal page */
+		CU_ASSERT(g_dev_write_bytes - write_bytes == page_size * 5);
+	} else {
+		/* Two data pages, the md page and the journal page */
+		CU_ASSERT(g_dev_write_bytes - write_bytes == page_size * 4);
+	}
+
+	/* Allocate clusters 2 and 3. With extent table their shared extent page
+	 * is already persisted, so it is written once and md is not synced. */
+	write_bytes = g_dev_write_bytes;
+	set_thread(1);
+	spdk_blob_io_write(blob, channel_thread1, payload, 2 * pages_per_cluster, 1,
+			   blob_op_complete, NULL);
+	set_thread(0);
+	spdk_blob_io_write(blob, channel, payload, 3 * pages_per_cluster, 1,
+			   blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(free_clusters - 4 == spdk_bs_free_cluster_count(bs));
+	CU_ASSERT(g_dev_write_bytes - write_bytes == page_size * 3);
+
+	/* Everything was persisted, so md sync has nothing left to write */
+	write_bytes = g_dev_write_bytes;
+	spdk_blob_sync_md(blob, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_dev_write_bytes == write_bytes);
+
+	ut_blob_close_and_delete(bs, blob);
+	CU_ASSERT(free_clusters == spdk_bs_free_cluster_count(bs));
+
+	set_thread(1);
+	spdk_bs_free_io_channel(channel_thread1);
+	set_thread(0);
+	spdk_bs_free_io_channel(channel);
+	poll_threads();
+	g_blob = NULL;
+	g_blobid = 0;
+}
+
+static void
+blob_thin_prov_reserved_clusters(void)
+{
+	struct spdk_blob_store *bs;
+	struct spdk_bs_dev *dev;
+	struct spdk_bs_opts bs_opts;
+	struct spdk_blob *blob;
+	struct spdk_blob_opts opts;
+	struct spdk_io_channel *channel, *channel_thread1;
+	struct spdk_bs_channel *bs_channel;
+	spdk_blob_id blobid;
+	uint64_t free_clusters, total_clusters;
+	uint32_t cluster1, i;
+	uint8_t payload[4096];
+
+	/* Use small clusters, so there are enough free ones for channels to reserve them */
+	dev = init_dev();
+	spdk_bs_opts_init(&bs_opts);
+	bs_opts.cluster_sz = 4 * SPDK_BS_PAGE_SIZE;
+	bs_opts.num_md_pages = 128;
+	spdk_bs_init(dev, &bs_opts, bs_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
+	bs = g_bs;
+
+	total_clusters = spdk_bs_total_data_cluster_count(bs);
+	free_clusters = spdk_bs_free_cluster_count(bs);
+	SPDK_CU_ASSERT_FATAL(free_clusters >= SPDK_BS_CLUSTER_RESERVE_MIN_FREE);
+	CU_ASSERT(spdk_bit_array_capacity(bs->full_cluster_groups) ==
+		  spdk_divide_round_up(bs->total_clusters, 1U << SPDK_BS_CLUSTER_GROUP_SHIFT));
+
+	ut_spdk_blob_opts_init(&opts);
+	opts.thin_provision = true;
+	opts.num_clusters = 4;
+	blob = ut_blob_create_and_open(bs, &opts);
+	blobid = spdk_blob_get_id(blob);
+
+	channel = spdk_bs_alloc_io_channel(bs);
+	SPDK_CU_ASSERT_FATAL(channel != NULL);
+	bs_channel = spdk_io_channel_get_ctx(channel);
+	set_thread(1);
+	channel_thread1 = spdk_bs_alloc_io_channel(bs);
+	SPDK_CU_ASSERT_FATAL(channel_thread1 != NULL);
+	set_thread(0);
+
+	/* The first write reserves clusters for the channel and uses one of them */
+	memset(payload, 0xE5, sizeof(payload));
+	spdk_blob_io_write(blob, channel, payload, 0, 1, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == free_clusters - 1);
+	CU_ASSERT(bs_channel->num_reserved_clusters == SPDK_BS_CHANNEL_RESERVED_CLUSTERS);
+	CU_ASSERT(bs_channel->next_reserved_cluster == 1);
+	CU_ASSERT(blob->active.clusters[0] ==
+		  bs_cluster_to_lba(bs, bs_channel->reserved_clusters[0]));
+
+	/* Channel on the other thread doesn't get any of the clusters reserved by the first one */
+	set_thread(1);
+	spdk_blob_io_write(blob, channel_thread1, payload, bs->pages_per_cluster, 1,
+			   blob_op_complete, NULL);
+	set_thread(0);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == free_clusters - 2);
+	SPDK_CU_ASSERT_FATAL(blob->active.clusters[1] != 0);
+	cluster1 = bs_lba_to_cluster(bs, blob->active.clusters[1]);
+	for (i = 0; i < bs_channel->num_reserved_clusters; i++) {
+		CU_ASSERT(bs_channel->reserved_clusters[i] != cluster1);
+	}
+
+	/* Freeing the channel gives back the clusters it didn't use */
+	set_thread(1);
+	spdk_bs_free_io_channel(channel_thread1);
+	set_thread(0);
+	poll_threads();
+	CU_ASSERT(spdk_bit_array_count_set(bs->used_clusters) ==
+		  bs->total_clusters - free_clusters + 2 + SPDK_BS_CHANNEL_RESERVED_CLUSTERS - 1);
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == free_clusters - 2);
+
+	spdk_blob_close(blob, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+
+	/* Unload with the channel still allocated - its reserved clusters mustn't be persisted */
+	spdk_bs_unload(bs, bs_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(bs_channel->next_reserved_cluster == bs_channel->num_reserved_clusters);
+	spdk_bs_free_io_channel(channel);
+	poll_threads();
+	g_bs = NULL;
+
+	dev = init_dev();
+	spdk_bs_load(dev, NULL, bs_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
+	bs = g_bs;
+
+	CU_ASSERT(spdk_bs_total_data_cluster_count(bs) == total_clusters);
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == free_clusters - 2);
+	CU_ASSERT(spdk_bit_array_count_set(bs->used_clusters) ==
+		  bs->total_clusters - free_clusters + 2);
+	/* The summary was rebuilt on load, so searching from the start finds the same cluster */
+	CU_ASSERT(bs_find_free_cluster(bs, 0) == spdk_bit_array_find_first_clear(bs->used_clusters, 0));
+
+	spdk_bs_open_blob(bs, blobid, blob_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	blob = g_blob;
+	CU_ASSERT(blob->active.clusters[0] != 0);
+	CU_ASSERT(blob->active.clusters[1] != 0);
+	CU_ASSERT(blob->active.clusters[2] == 0);
+
+	ut_blob_close_and_delete(bs, blob);
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == free_clusters);
+
+	spdk_bs_unload(bs, bs_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	g_bs = NULL;
+	g_blob = NULL;
+	g_blobid = 0;
+}
+
+static void
+bs_find_free_cluster_test(void)
+{
+	struct spdk_blob_store *bs = g_bs;
+	uint32_t first_clear, cluster, group_end;
+
+	group_end = spdk_min(1U << SPDK_BS_CLUSTER_GROUP_SHIFT, bs->total_clusters);
+
+	first_clear = spdk_bit_array_find_first_clear(bs->used_clusters, 0);
+	SPDK_CU_ASSERT_FATAL(first_clear < group_end);
+	CU_ASSERT(bs_find_free_cluster(bs, 0) == first_clear);
+
+	/* Fill up the first group of clusters, the summary has to mark it as full */
+	for (cluster = first_clear; cluster < group_end; cluster++) {
+		bs_claim_cluster(bs, cluster);
+	}
+	CU_ASSERT(spdk_bit_array_get(bs->full_cluster_groups, 0));
+	CU_ASSERT(bs_find_free_cluster(bs, 0) == spdk_bit_array_find_first_clear(bs->used_clusters, 0));
+	CU_ASSERT(bs_find_free_cluster(bs, 1) == spdk_bit_array_find_first_clear(bs->used_clusters, 1));
+
+	/* Releasing a cluster makes the group searchable again */
+	bs_release_cluster(bs, group_end - 1);
+	CU_ASSERT(!spdk_bit_array_get(bs->full_cluster_groups, 0));
+	CU_ASSERT(bs_find_free_cluster(bs, 0) == group_end - 1);
+	CU_ASSERT(bs_find_free_cluster(bs, group_end) ==
+		  spdk_bit_array_find_first_clear(bs->used_clusters, group_end));
+
+	for (cluster = first_clear; cluster < group_end - 1; cluster++) {
+		bs_release_cluster(bs, cluster);
+	}
+	CU_ASSERT(bs_find_free_cluster(bs, 0) == first_clear);
+}
+
 static void
 blob_thin_prov_rle(void)
 {
@@ -3813,13 +4296,13 @@ blob_thin_prov_rle(void)
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
 	CU_ASSERT(free_clusters - 1 == spdk_bs_free_cluster_count(bs));
-	/* For thin-provisioned blob we need to write 10 pages plus one page metadata and
-	 * read 0 bytes */
+	/* For thin-provisioned blob we need to write 10 pages plus one page metadata,
+	 * one page of the allocation journal and read 0 bytes */
 	if (g_use_extent_table) {
 		/* Add one more page for EXTENT_PAGE write */
-		CU_ASSERT(g_dev_write_bytes - write_bytes == page_size * 12);
+		CU_ASSERT(g_dev_write_bytes - write_bytes == page_size * 13);
 	} else {
-		CU_ASSERT(g_dev_write_bytes - write_bytes == page_size * 11);
+		CU_ASSERT(g_dev_write_bytes - write_bytes == page_size * 12);
 	}
 	CU_ASSERT(g_dev_read_bytes - read_bytes == 0);
 
@@ -4131,13 +4614,124 @@ blob_snapshot_rw(void)
 	spdk_blob_io_read(snapshot, channel, payload_read, 4, 10, blob_op_complete, NULL);
 	poll_threads();
 	CU_ASSERT(g_bserrno == 0);
-	CU_ASSERT(memcmp(payload_write, payload_read, 10 * 4096) == 0);
+	CU_ASSERT(memcmp(payload_write, payload_read, 10 * 4096) == 0);
+
+	ut_blob_close_and_delete(bs, blob);
+	ut_blob_close_and_delete(bs, snapshot);
+
+	spdk_bs_free_io_channel(channel);
+	poll_threads();
+	g_blob = NULL;
+	g_blobid = 0;
+}
+
+static void
+blob_snapshot_rw_full_cluster(void)
+{
+	struct spdk_blob_store *bs = g_bs;
+	struct spdk_blob *blob, *snapshot;
+	struct spdk_io_channel *channel;
+	struct spdk_blob_opts opts;
+	struct iovec iov;
+	spdk_blob_id blobid, snapshotid;
+	uint64_t cluster_size;
+	uint64_t page_size;
+	uint64_t pages_per_cluster;
+	uint8_t *payload_read;
+	uint8_t *payload_write;
+	uint64_t write_bytes;
+	uint64_t read_bytes;
+
+	cluster_size = spdk_bs_get_cluster_size(bs);
+	page_size = spdk_bs_get_page_size(bs);
+	pages_per_cluster = cluster_size / page_size;
+
+	payload_read = calloc(1, 2 * cluster_size);
+	payload_write = calloc(1, 2 * cluster_size);
+	SPDK_CU_ASSERT_FATAL(payload_read != NULL);
+	SPDK_CU_ASSERT_FATAL(payload_write != NULL);
+
+	channel = spdk_bs_alloc_io_channel(bs);
+	CU_ASSERT(channel != NULL);
+
+	ut_spdk_blob_opts_init(&opts);
+	opts.thin_provision = true;
+	opts.num_clusters = 5;
+
+	blob = ut_blob_create_and_open(bs, &opts);
+	blobid = spdk_blob_get_id(blob);
+
+	/* Fill first three clusters, so the snapshot holds data for them */
+	memset(payload_write, 0xE5, 2 * cluster_size);
+	spdk_blob_io_write(blob, channel, payload_write, 0, 2 * pages_per_cluster, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	spdk_blob_io_write(blob, channel, payload_write, 2 * pages_per_cluster, pages_per_cluster,
+			   blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+
+	spdk_bs_create_snapshot(bs, blobid, NULL, blob_op_with_id_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_blobid != SPDK_BLOBID_INVALID);
+	snapshotid = g_blobid;
+
+	spdk_bs_open_blob(bs, snapshotid, blob_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	snapshot = g_blob;
+
+	/* Aligned write covering two clusters must not read them from the snapshot */
+	write_bytes = g_dev_write_bytes;
+	read_bytes = g_dev_read_bytes;
+	memset(payload_write, 0xAA, 2 * cluster_size);
+	spdk_blob_io_write(blob, channel, payload_write, 0, 2 * pages_per_cluster, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_dev_read_bytes - read_bytes == 0);
+	/* Payload plus metadata, without a copy of either cluster */
+	CU_ASSERT(g_dev_write_bytes - write_bytes >= 2 * cluster_size);
+	CU_ASSERT(g_dev_write_bytes - write_bytes < 3 * cluster_size);
+
+	spdk_blob_io_read(blob, channel, payload_read, 0, 2 * pages_per_cluster, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(memcmp(payload_write, payload_read, 2 * cluster_size) == 0);
+
+	/* Same for a full cluster written with writev */
+	read_bytes = g_dev_read_bytes;
+	memset(payload_write, 0xBB, cluster_size);
+	iov.iov_base = payload_write;
+	iov.iov_len = cluster_size;
+	spdk_blob_io_writev(blob, channel, &iov, 1, 2 * pages_per_cluster, pages_per_cluster,
+			    blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(g_dev_read_bytes - read_bytes == 0);
+
+	spdk_blob_io_read(blob, channel, payload_read, 2 * pages_per_cluster, pages_per_cluster,
+			  blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(memcmp(payload_write, payload_read, cluster_size) == 0);
+
+	/* Snapshot data is unchanged */
+	memset(payload_write, 0xE5, 2 * cluster_size);
+	spdk_blob_io_read(snapshot, channel, payload_read, 0, 2 * pages_per_cluster, blob_op_complete,
+			  NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(memcmp(payload_write, payload_read, 2 * cluster_size) == 0);
 
 	ut_blob_close_and_delete(bs, blob);
 	ut_blob_close_and_delete(bs, snapshot);
 
 	spdk_bs_free_io_channel(channel);
 	poll_threads();
+	free(payload_read);
+	free(payload_write);
 	g_blob = NULL;
 	g_blobid = 0;
 }
@@ -4548,6 +5142,286 @@ blob_inflate_rw(void)
 	_blob_inflate_rw(true);
 }
 
+static void
+ut_blob_write_cluster(struct spdk_blob *blob, struct spdk_io_channel *channel, uint64_t cluster,
+		      uint8_t pattern, uint8_t *payload)
+{
+	uint64_t cluster_size = spdk_bs_get_cluster_size(blob->bs);
+	uint64_t pages_per_cluster = cluster_size / spdk_bs_get_page_size(blob->bs);
+
+	memset(payload, pattern, cluster_size);
+	spdk_blob_io_write(blob, channel, payload, cluster * pages_per_cluster, pages_per_cluster,
+			   blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+}
+
+static void
+ut_blob_check_clusters(struct spdk_blob *blob, struct spdk_io_channel *channel,
+		       const uint8_t *patterns, uint64_t num_clusters, uint8_t *payload)
+{
+	uint64_t cluster_size = spdk_bs_get_cluster_size(blob->bs);
+	uint64_t pages_per_cluster = cluster_size / spdk_bs_get_page_size(blob->bs);
+	uint64_t i, j;
+
+	memset(payload, 0xFF, cluster_size * num_clusters);
+	spdk_blob_io_read(blob, channel, payload, 0, pages_per_cluster * num_clusters,
+			  blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+
+	for (i = 0; i < num_clusters; i++) {
+		for (j = 0; j < cluster_size; j++) {
+			if (payload[i * cluster_size + j] != patterns[i]) {
+				CU_FAIL("Unexpected data in cluster");
+				return;
+			}
+		}
+	}
+}
+
+/*
+ * Snapshot chain used by blob_flatten_rw, 'A'..'D' denote the data pattern:
+ *
+ *                   ,---------+---------+---------+---------+---------.
+ *         snapshot  |AAAAAAAAA|    -    |AAAAAAAAA|    -    |    -    |
+ *                   +---------+---------+---------+---------+---------+
+ *         snapshot2 |    -    |    -    |BBBBBBBBB|BBBBBBBBB|    -    |
+ *                   +---------+---------+---------+---------+---------+
+ *         snapshot3 |    -    |CCCCCCCCC|    -    |    -    |    -    |
+ *                   +---------+---------+---------+---------+---------+
+ *         blob      |    -    |    -    |    -    |DDDDDDDDD|    -    |
+ *                   '---------+---------+---------+---------+---------'
+ *
+ * After snapshot2 is deleted and blob is flattened, three clusters are copied
+ * and the last one stays unallocated.
+ */
+static void
+blob_flatten_rw(void)
+{
+	struct spdk_blob_store *bs = g_bs;
+	struct spdk_blob *blob;
+	struct spdk_io_channel *channel;
+	struct spdk_blob_opts opts;
+	struct spdk_blob_bs_dev *back;
+	spdk_blob_id blobid, snapshotid, snapshot2id, snapshot3id;
+	const uint8_t patterns[5] = { 'A', 'C', 'B', 'D', 0 };
+	uint64_t cluster_size;
+	uint64_t free_clusters;
+	uint64_t depth_mask = 0xFF;
+	uint8_t *payload;
+	uint64_t i;
+
+	cluster_size = spdk_bs_get_cluster_size(bs);
+	payload = malloc(cluster_size * 5);
+	SPDK_CU_ASSERT_FATAL(payload != NULL);
+
+	channel = spdk_bs_alloc_io_channel(bs);
+	SPDK_CU_ASSERT_FATAL(channel != NULL);
+
+	ut_spdk_blob_opts_init(&opts);
+	opts.thin_provision = true;
+	opts.num_clusters = 5;
+
+	blob = ut_blob_create_and_open(bs, &opts);
+	blobid = spdk_blob_get_id(blob);
+
+	ut_blob_write_cluster(blob, channel, 0, 'A', payload);
+	ut_blob_write_cluster(blob, channel, 2, 'A', payload);
+	spdk_bs_create_snapshot(bs, blobid, NULL, blob_op_with_id_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	snapshotid = g_blobid;
+
+	ut_blob_write_cluster(blob, channel, 2, 'B', payload);
+	ut_blob_write_cluster(blob, channel, 3, 'B', payload);
+	spdk_bs_create_snapshot(bs, blobid, NULL, blob_op_with_id_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	snapshot2id = g_blobid;
+
+	ut_blob_write_cluster(blob, channel, 1, 'C', payload);
+	spdk_bs_create_snapshot(bs, blobid, NULL, blob_op_with_id_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	snapshot3id = g_blobid;
+
+	ut_blob_write_cluster(blob, channel, 3, 'D', payload);
+
+	/* Reads of clusters held deeper in the chain go straight to the snapshot
+	 * holding them. The number of levels is cached in the back bs_dev. */
+	ut_blob_check_clusters(blob, channel, patterns, 5, payload);
+	back = (struct spdk_blob_bs_dev *)blob->back_bs_dev;
+	CU_ASSERT(back->blob->id == snapshot3id);
+	SPDK_CU_ASSERT_FATAL(back->owner_cache != NULL);
+	CU_ASSERT((back->owner_cache[0] & depth_mask) == 2);
+	CU_ASSERT((back->owner_cache[1] & depth_mask) == 0);
+	CU_ASSERT((back->owner_cache[2] & depth_mask) == 1);
+	CU_ASSERT((back->owner_cache[4] & depth_mask) == 2);
+
+	/* Removing snapshot2 from the middle of the chain moves its clusters
+	 * to snapshot3, cached entries must not be used anymore. */
+	spdk_bs_delete_blob(bs, snapshot2id, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	ut_blob_check_clusters(blob, channel, patterns, 5, payload);
+	CU_ASSERT((back->owner_cache[0] & depth_mask) == 1);
+	CU_ASSERT((back->owner_cache[2] & depth_mask) == 0);
+
+	/* Flatten at one cluster per second */
+	free_clusters = spdk_bs_free_cluster_count(bs);
+	g_bserrno = -1;
+	spdk_bs_blob_flatten(bs, channel, blobid, cluster_size, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == -1);
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == free_clusters - 1);
+
+	spdk_delay_us(1000000);
+	poll_threads();
+	CU_ASSERT(g_bserrno == -1);
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == free_clusters - 2);
+
+	/* The blob stays usable while flattening */
+	ut_blob_check_clusters(blob, channel, patterns, 5, payload);
+
+	spdk_delay_us(1000000);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == free_clusters - 3);
+
+	CU_ASSERT(blob->parent_id == SPDK_BLOBID_INVALID);
+	CU_ASSERT(spdk_blob_is_thin_provisioned(blob) == true);
+	for (i = 0; i < 4; i++) {
+		CU_ASSERT(blob->active.clusters[i] != 0);
+	}
+	CU_ASSERT(blob->active.clusters[4] == 0);
+	ut_blob_check_clusters(blob, channel, patterns, 5, payload);
+
+	/* Flattening a blob without parent does nothing */
+	spdk_bs_blob_flatten(bs, channel, blobid, 0, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(spdk_bs_free_cluster_count(bs) == free_clusters - 3);
+
+	ut_blob_close_and_delete(bs, blob);
+
+	spdk_bs_delete_blob(bs, snapshot3id, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	spdk_bs_delete_blob(bs, snapshotid, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+
+	spdk_bs_free_io_channel(channel);
+	poll_threads();
+	free(payload);
+	g_blob = NULL;
+	g_blobid = 0;
+}
+static void
+blob_get_next_changed_cluster(void)
+{
+	struct spdk_blob_store *bs = g_bs;
+	struct spdk_blob *blob, *snapshot2;
+	struct spdk_io_channel *channel;
+	struct spdk_blob_opts opts;
+	spdk_blob_id blobid, snapshotid, snapshot2id;
+	uint64_t cluster_size, next;
+	uint8_t *payload;
+	int rc;
+
+	cluster_size = spdk_bs_get_cluster_size(bs);
+	payload = malloc(cluster_size);
+	SPDK_CU_ASSERT_FATAL(payload != NULL);
+
+	channel = spdk_bs_alloc_io_channel(bs);
+	SPDK_CU_ASSERT_FATAL(channel != NULL);
+
+	ut_spdk_blob_opts_init(&opts);
+	opts.thin_provision = true;
+	opts.num_clusters = 5;
+
+	blob = ut_blob_create_and_open(bs, &opts);
+	blobid = spdk_blob_get_id(blob);
+
+	/* snapshot holds cluster 1, snapshot2 cluster 3 and the blob cluster 4 */
+	ut_blob_write_cluster(blob, channel, 1, 'A', payload);
+	spdk_bs_create_snapshot(bs, blobid, NULL, blob_op_with_id_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	snapshotid = g_blobid;
+
+	ut_blob_write_cluster(blob, channel, 3, 'B', payload);
+	spdk_bs_create_snapshot(bs, blobid, NULL, blob_op_with_id_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	snapshot2id = g_blobid;
+
+	ut_blob_write_cluster(blob, channel, 4, 'C', payload);
+
+	spdk_bs_open_blob(bs, snapshot2id, blob_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_blob != NULL);
+	snapshot2 = g_blob;
+
+	/* Against the direct parent only the clusters of the blob itself */
+	rc = spdk_blob_get_next_changed_cluster(blob, snapshot2id, 0, &next);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(next == 4);
+
+	/* Against an older snapshot, clusters of the snapshots in between too */
+	rc = spdk_blob_get_next_changed_cluster(blob, snapshotid, 0, &next);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(next == 3);
+	rc = spdk_blob_get_next_changed_cluster(blob, snapshotid, 4, &next);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(next == 4);
+	rc = spdk_blob_get_next_changed_cluster(blob, snapshotid, 5, &next);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(next == UINT64_MAX);
+
+	rc = spdk_blob_get_next_changed_cluster(snapshot2, snapshotid, 0, &next);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(next == 3);
+	rc = spdk_blob_get_next_changed_cluster(snapshot2, snapshotid, 4, &next);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(next == UINT64_MAX);
+
+	/* Without a base, everything allocated in the chain */
+	rc = spdk_blob_get_next_changed_cluster(blob, SPDK_BLOBID_INVALID, 0, &next);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(next == 1);
+
+	/* Nothing differs from the blob itself */
+	rc = spdk_blob_get_next_changed_cluster(blob, blobid, 0, &next);
+	CU_ASSERT(rc == 0);
+	CU_ASSERT(next == UINT64_MAX);
+
+	/* A base that is not in the chain */
+	rc = spdk_blob_get_next_changed_cluster(snapshot2, blobid, 0, &next);
+	CU_ASSERT(rc == -EINVAL);
+
+	spdk_blob_close(snapshot2, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+
+	ut_blob_close_and_delete(bs, blob);
+
+	spdk_bs_delete_blob(bs, snapshot2id, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	spdk_bs_delete_blob(bs, snapshotid, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+
+	spdk_bs_free_io_channel(channel);
+	poll_threads();
+	free(payload);
+	g_blob = NULL;
+	g_blobid = 0;
+}
+
 /**
  * Snapshot-clones relation test
  *
@@ -6282,6 +7156,124 @@ blob_io_unit_compatiblity(void)
 	g_blobid = 0;
 }
 
+static void
+blob_io_unit_split_batch(void)
+{
+	struct spdk_bs_opts bsopts;
+	struct spdk_blob_opts opts;
+	struct spdk_blob_store *bs;
+	struct spdk_bs_dev *dev;
+	struct spdk_blob *blob;
+	struct spdk_io_channel *channel;
+	struct spdk_bs_channel *bs_channel;
+	struct iovec iov[40];
+	uint8_t payload_ff[40 * 512];
+	uint8_t payload_read[40 * 512];
+	uint64_t i;
+
+	/* Create dev with 512 bytes io unit size */
+	spdk_bs_opts_init(&bsopts);
+	bsopts.cluster_sz = SPDK_BS_PAGE_SIZE * 4;	/* 8 * 4 = 32 io_unit */
+	snprintf(bsopts.bstype.bstype, sizeof(bsopts.bstype.bstype), "TESTTYPE");
+
+	dev = init_dev();
+	dev->blocklen = 512;
+	dev->blockcnt =  DEV_BUFFER_SIZE / dev->blocklen;
+
+	spdk_bs_init(dev, &bsopts, bs_op_with_handle_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	SPDK_CU_ASSERT_FATAL(g_bs != NULL);
+	bs = g_bs;
+
+	channel = spdk_bs_alloc_io_channel(bs);
+	SPDK_CU_ASSERT_FATAL(channel != NULL);
+	bs_channel = spdk_io_channel_get_ctx(channel);
+
+	ut_spdk_blob_opts_init(&opts);
+	opts.thin_provision = false;
+	opts.num_clusters = 4;
+
+	blob = ut_blob_create_and_open(bs, &opts);
+
+	memset(payload_ff, 0xFF, sizeof(payload_ff));
+	for (i = 0; i < 40; i++) {
+		iov[i].iov_base = payload_ff + i * 512;
+		iov[i].iov_len = 512;
+	}
+
+	/* Writev of 40 io units crossing a cluster boundary, one io unit per iov. All of the
+	 * clusters are allocated, so both pieces are sent to the device before either completes. */
+	g_dev_write_bytes = 0;
+	spdk_blob_io_writev(blob, channel, iov, 40, 16, 40, blob_op_complete, NULL);
+	CU_ASSERT(g_dev_write_bytes == 40 * 512);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(memcmp(g_dev_buffer + (blob->active.clusters[0] + 16) * 512, payload_ff, 16 * 512) == 0);
+	CU_ASSERT(memcmp(g_dev_buffer + blob->active.clusters[1] * 512, payload_ff, 24 * 512) == 0);
+
+	/* More iovs than a cached context holds, so no context was returned to the channel */
+	CU_ASSERT(bs_channel->num_rw_iov_ctxs == 0);
+
+	/* Readv crossing the cluster boundary with the second iov straddling it */
+	memset(payload_read, 0, sizeof(payload_read));
+	iov[0].iov_base = payload_read;
+	iov[0].iov_len = 12 * 512;
+	iov[1].iov_base = payload_read + 12 * 512;
+	iov[1].iov_len = 28 * 512;
+	g_dev_read_bytes = 0;
+	spdk_blob_io_readv(blob, channel, iov, 2, 12, 40, blob_op_complete, NULL);
+	CU_ASSERT(g_dev_read_bytes == 40 * 512);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(memcmp(payload_read + 4 * 512, payload_ff, 36 * 512) == 0);
+
+	/* The split context was small enough to be cached on the channel and gets reused */
+	CU_ASSERT(bs_channel->num_rw_iov_ctxs == 1);
+	spdk_blob_io_readv(blob, channel, iov, 2, 12, 40, blob_op_complete, NULL);
+	CU_ASSERT(bs_channel->num_rw_iov_ctxs == 0);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(bs_channel->num_rw_iov_ctxs == 1);
+
+	ut_blob_close_and_delete(bs, blob);
+
+	/* Thin provisioned blob needs clusters allocated, so the pieces go in sequence */
+	ut_spdk_blob_opts_init(&opts);
+	opts.thin_provision = true;
+	opts.num_clusters = 4;
+
+	blob = ut_blob_create_and_open(bs, &opts);
+
+	iov[0].iov_base = payload_ff;
+	iov[0].iov_len = 40 * 512;
+	spdk_blob_io_writev(blob, channel, iov, 1, 16, 40, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(blob->active.clusters[0] != 0);
+	CU_ASSERT(blob->active.clusters[1] != 0);
+
+	memset(payload_read, 0, sizeof(payload_read));
+	iov[0].iov_base = payload_read;
+	iov[0].iov_len = 40 * 512;
+	spdk_blob_io_readv(blob, channel, iov, 1, 16, 40, blob_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	CU_ASSERT(memcmp(payload_read, payload_ff, 40 * 512) == 0);
+
+	ut_blob_close_and_delete(bs, blob);
+
+	spdk_bs_free_io_channel(channel);
+	poll_threads();
+
+	spdk_bs_unload(bs, bs_op_complete, NULL);
+	poll_threads();
+	CU_ASSERT(g_bserrno == 0);
+	g_bs = NULL;
+	g_blob = NULL;
+	g_blobid = 0;
+}
+
 static void
 blob_simultaneous_operations(void)
 {
@@ -6646,16 +7638,23 @@ int main(int argc, char **argv)
 	CU_ADD_TEST(suite_bs, blob_crc);
 	CU_ADD_TEST(suite, super_block_crc);
 	CU_ADD_TEST(suite_blob, blob_dirty_shutdown);
+	CU_ADD_TEST(suite_bs, blob_dirty_shutdown_many_blobs);
+	CU_ADD_TEST(suite_bs, blob_dirty_shutdown_journal);
+	CU_ADD_TEST(suite_bs, blob_journal_checkpoint);
 	CU_ADD_TEST(suite_bs, blob_flags);
 	CU_ADD_TEST(suite_bs, bs_version);
 	CU_ADD_TEST(suite_bs, blob_set_xattrs_test);
 	CU_ADD_TEST(suite_bs, blob_thin_prov_alloc);
 	CU_ADD_TEST(suite_bs, blob_insert_cluster_msg_test);
 	CU_ADD_TEST(suite_bs, blob_thin_prov_rw);
+	CU_ADD_TEST(suite_bs, blob_thin_prov_insert_cluster_batch);
+	CU_ADD_TEST(suite, blob_thin_prov_reserved_clusters);
+	CU_ADD_TEST(suite_bs, bs_find_free_cluster_test);
 	CU_ADD_TEST(suite_bs, blob_thin_prov_rle);
 	CU_ADD_TEST(suite_bs, blob_thin_prov_rw_iov);
 	CU_ADD_TEST(suite, bs_load_iter_test);
 	CU_ADD_TEST(suite_bs, blob_snapshot_rw);
+	CU_ADD_TEST(suite_bs, blob_snapshot_rw_full_cluster);
 	CU_ADD_TEST(suite_bs, blob_snapshot_rw_iov);
 	CU_ADD_TEST(suite, blob_relations);
 	CU_ADD_TEST(suite, blob_relations2);
@@ -6663,11 +7662,14 @@ int main(int argc, char **argv)
 	CU_ADD_TEST(suite, blob_delete_snapshot_power_failure);
 	CU_ADD_TEST(suite, blob_create_snapshot_power_failure);
 	CU_ADD_TEST(suite_bs, blob_inflate_rw);
+	CU_ADD_TEST(suite_bs, blob_flatten_rw);
+	CU_ADD_TEST(suite_bs, blob_get_next_changed_cluster);
 	CU_ADD_TEST(suite_bs, blob_snapshot_freeze_io);
 	CU_ADD_TEST(suite_bs, blob_operation_split_rw);
 	CU_ADD_TEST(suite_bs, blob_operation_split_rw_iov);
 	CU_ADD_TEST(suite, blob_io_unit);
 	CU_ADD_TEST(suite, blob_io_unit_compatiblity);
+	CU_ADD_TEST(suite, blob_io_unit_split_batch);
 	CU_ADD_TEST(suite_bs, blob_simultaneous_operations);
 	CU_ADD_TEST(suite_bs, blob_persist_test);
 
@@ -36,6 +36,9 @@
 #include "spdk_cunit.h"
 #include "common/lib/test_env.c"
 #include "event/reactor.c"
+#include "event/scheduler_dynamic.c"
+
+DEFINE_STUB(spdk_app_get_thread, struct spdk_thread *, (void), NULL);
 
 static void
 test_create_reactor(void)
@@ -427,6 +430,331 @@ test_reactor_stats(void)
 	free_cores();
 }
 
+static int
+poller_run_done(void *ctx)
+{
+	bool *done = ctx;
+
+	*done = true;
+
+	return -1;
+}
+
+static void
+test_reactor_interrupt(void)
+{
+#ifdef __linux__
+	struct spdk_cpuset cpuset = {};
+	struct spdk_thread *thread;
+	struct spdk_reactor *reactor;
+	struct spdk_lw_thread *lw_thread;
+	struct spdk_poller *timed, *active;
+	struct spdk_event *evt;
+	bool done = false;
+	uint8_t test1 = 0, test2 = 0;
+
+	allocate_cores(1);
+
+	CU_ASSERT(spdk_interrupt_mode_enable() == 0);
+	CU_ASSERT(spdk_reactors_init() == 0);
+
+	reactor = spdk_reactor_get(0);
+	SPDK_CU_ASSERT_FATAL(reactor != NULL);
+	CU_ASSERT(reactor->fgrp != NULL);
+	CU_ASSERT(reactor->events_fd >= 0);
+
+	spdk_cpuset_set_cpu(&cpuset, 0, true);
+
+	MOCK_SET(spdk_env_get_current_core, 0);
+	MOCK_SET(spdk_get_ticks, 100);
+
+	thread = spdk_thread_create(NULL, &cpuset);
+	SPDK_CU_ASSERT_FATAL(thread != NULL);
+
+	/* Scheduling the thread is work, so the reactor is busy at TSC = 100. */
+	reactor->tsc_last = 100;
+	_reactor_run(reactor);
+	CU_ASSERT(reactor->last_busy_tsc == 100);
+
+	lw_thread = spdk_thread_get_ctx(thread);
+	SPDK_CU_ASSERT_FATAL(lw_thread != NULL);
+	CU_ASSERT(lw_thread->intr_registered == true);
+
+	g_reactor_interrupt_idle_tsc = 1000;
+
+	spdk_set_thread(thread);
+	timed = spdk_poller_register(poller_run_done, &done, 2000);
+	CU_ASSERT(timed != NULL);
+	spdk_set_thread(NULL);
+
+	/* The reactor has not been idle long enough yet and keeps polling. */
+	reactor->tsc_last = 500;
+	reactor_interrupt_run(reactor);
+	CU_ASSERT(thread->intr_armed == false);
+
+	/* Idle long enough, the reactor sleeps until the timed poller expires 1ms later. */
+	MOCK_SET(spdk_get_ticks, 1100);
+	reactor->tsc_last = 1100;
+	reactor_interrupt_run(reactor);
+	CU_ASSERT(thread->intr_armed == true);
+	CU_ASSERT(reactor->in_interrupt == false);
+
+	/* The next poll takes the thread back to polling mode. */
+	MOCK_SET(spdk_get_ticks, 2100);
+	reactor->tsc_last = 2100;
+	_reactor_run(reactor);
+	CU_ASSERT(done == true);
+	CU_ASSERT(thread->intr_armed == false);
+
+	/* A pending event prevents the reactor from sleeping. */
+	evt = spdk_event_allocate(0, ut_event_fn, &test1, &test2);
+	SPDK_CU_ASSERT_FATAL(evt != NULL);
+	spdk_event_call(evt);
+
+	reactor_interrupt_run(reactor);
+	CU_ASSERT(thread->intr_armed == false);
+
+	_reactor_run(reactor);
+	CU_ASSERT(test1 == 1);
+	CU_ASSERT(test2 == 0xFF);
+
+	/* Active pollers keep the reactor in polling mode. */
+	spdk_set_thread(thread);
+	active = spdk_poller_register(poller_run_idle, (void *)0, 0);
+	CU_ASSERT(active != NULL);
+	spdk_set_thread(NULL);
+
+	reactor_interrupt_run(reactor);
+	CU_ASSERT(thread->intr_armed == false);
+
+	spdk_set_thread(thread);
+	spdk_poller_unregister(&timed);
+	spdk_poller_unregister(&active);
+	spdk_thread_exit(thread);
+
+	_reactor_run(reactor);
+
+	CU_ASSERT(TAILQ_EMPTY(&reactor->threads));
+
+	spdk_reactors_fini();
+
+	CU_ASSERT(spdk_interrupt_mode_is_enabled() == false);
+
+	MOCK_CLEAR(spdk_env_get_current_core);
+
+	free_cores();
+#endif
+}
+
+static uint64_t g_sched_ticks;
+
+static void
+sched_run(uint32_t count)
+{
+	struct spdk_reactor *reactor;
+	uint32_t i, j;
+
+	/* Let the period expire, then gather metrics, balance and move threads. */
+	g_sched_ticks += g_scheduler_period;
+	MOCK_SET(spdk_get_ticks, g_sched_ticks);
+	for (i = 0; i < count; i++) {
+		reactor = spdk_reactor_get(i);
+		reactor->tsc_last = g_sched_ticks;
+		reactor->idle_tsc += g_scheduler_period;
+	}
+
+	reactor_scheduler_poll(g_scheduling_reactor);
+	CU_ASSERT(g_scheduling_in_progress == true);
+
+	for (j = 0; j < 4 && g_scheduling_in_progress; j++) {
+		for (i = 0; i < count; i++) {
+			MOCK_SET(spdk_env_get_current_core, i);
+			event_queue_run_batch(spdk_reactor_get(i));
+		}
+	}
+	CU_ASSERT(g_scheduling_in_progress == false);
+
+	/* The first round reschedules the threads, the second one adds them to the new reactors. */
+	for (j = 0; j < 2; j++) {
+		for (i = 0; i < count; i++) {
+			MOCK_SET(spdk_env_get_current_core, i);
+			_reactor_run(spdk_reactor_get(i));
+		}
+	}
+	MOCK_SET(spdk_env_get_current_core, 0);
+}
+
+static uint32_t
+sched_thread_core(struct spdk_thread *thread, uint32_t count)
+{
+	struct spdk_reactor *reactor;
+	struct spdk_lw_thread *lw_thread;
+	uint32_t i;
+
+	for (i = 0; i < count; i++) {
+		reactor = spdk_reactor_get(i);
+		TAILQ_FOREACH(lw_thread, &reactor->threads, link) {
+			if (spdk_thread_get_from_ctx(lw_thread) == thread) {
+				return i;
+			}
+		}
+	}
+
+	return UINT32_MAX;
+}
+
+static void
+sched_set_load(struct spdk_thread **threads, uint32_t count, uint64_t busy_pct)
+{
+	uint32_t i;
+
+	for (i = 0; i < count; i++) {
+		threads[i]->stats.busy_tsc += g_scheduler_period * busy_pct / 100;
+		threads[i]->stats.idle_tsc += g_scheduler_period * (100 - busy_pct) / 100;
+	}
+}
+
+static void
+test_scheduler(void)
+{
+	struct spdk_cpuset cpuset = {};
+	struct spdk_thread *threads[3];
+	struct spdk_reactor *reactor;
+	uint32_t i;
+
+	allocate_cores(3);
+
+	CU_ASSERT(spdk_reactors_init() == 0);
+
+	CU_ASSERT(strcmp(spdk_scheduler_get()->name, "static") == 0);
+	CU_ASSERT(spdk_scheduler_set("nonexistent") == -ENOENT);
+	CU_ASSERT(spdk_scheduler_set("balanced") == 0);
+	CU_ASSERT(spdk_scheduler_get() == &scheduler_balanced);
+
+	spdk_scheduler_set_period(100);
+	CU_ASSERT(spdk_scheduler_get_period() == 100);
+
+	g_sched_ticks = 100;
+	MOCK_SET(spdk_get_ticks, g_sched_ticks);
+	MOCK_SET(spdk_env_get_current_core, 0);
+	g_reactor_state = SPDK_REACTOR_STATE_RUNNING;
+	g_scheduling_reactor = spdk_reactor_get(0);
+	g_scheduler_last_tsc = g_sched_ticks;
+
+	for (i = 0; i < 3; i++) {
+		spdk_cpuset_set_cpu(&cpuset, i, true);
+	}
+
+	/* Round robin places the threads on different cores. */
+	for (i = 0; i < 3; i++) {
+		threads[i] = spdk_thread_create(NULL, &cpuset);
+		SPDK_CU_ASSERT_FATAL(threads[i] != NULL);
+	}
+
+	for (i = 0; i < 3; i++) {
+		reactor = spdk_reactor_get(i);
+		reactor->tsc_last = g_sched_ticks;
+		MOCK_SET(spdk_env_get_current_core, i);
+		_reactor_run(reactor);
+		CU_ASSERT(reactor->thread_count == 1);
+	}
+
+	/* Idle threads are packed on the first core. */
+	sched_set_load(threads, 3, 0);
+	sched_run(3);
+	for (i = 0; i < 3; i++) {
+		CU_ASSERT(sched_thread_core(threads[i], 3) == 0);
+	}
+
+	/* Busy threads are spread across all cores. */
+	sched_set_load(threads, 3, 40);
+	sched_run(3);
+	CU_ASSERT(sched_thread_core(threads[0], 3) == 0);
+	CU_ASSERT(sched_thread_core(threads[1], 3) == 1);
+	CU_ASSERT(sched_thread_core(threads[2], 3) == 2);
+
+	/* The threads stay where they are as long as the load doesn't change. */
+	sched_set_load(threads, 3, 40);
+	sched_run(3);
+	CU_ASSERT(sched_thread_core(threads[0], 3) == 0);
+	CU_ASSERT(sched_thread_core(threads[1], 3) == 1);
+	CU_ASSERT(sched_thread_core(threads[2], 3) == 2);
+
+	/* The consolidating scheduler packs the threads on as few cores as possible. */
+	CU_ASSERT(spdk_scheduler_set("consolidate") == 0);
+	sched_set_load(threads, 3, 40);
+	sched_run(3);
+	CU_ASSERT(sched_thread_core(threads[0], 3) == 0);
+	CU_ASSERT(sched_thread_core(threads[1], 3) == 0);
+	CU_ASSERT(sched_thread_core(threads[2], 3) == 1);
+
+	/* Threads are only moved within their cpumask. */
+	CU_ASSERT(spdk_scheduler_set("balanced") == 0);
+	spdk_cpuset_zero(&cpuset);
+	spdk_cpuset_set_cpu(&cpuset, 1, true);
+	spdk_cpuset_copy(spdk_thread_get_cpumask(threads[2]), &cpuset);
+	sched_set_load(threads, 3, 0);
+	sched_run(3);
+	CU_ASSERT(sched_thread_core(threads[0], 3) == 0);
+	CU_ASSERT(sched_thread_core(threads[1], 3) == 0);
+	CU_ASSERT(sched_thread_core(threads[2], 3) == 1);
+
+	/* The app thread isn't moved, even if it's idle. */
+	for (i = 0; i < 3; i++) {
+		spdk_cpuset_set_cpu(&cpuset, i, true);
+	}
+	spdk_cpuset_copy(spdk_thread_get_cpumask(threads[2]), &cpuset);
+	MOCK_SET(spdk_app_get_thread, threads[2]);
+	sched_set_load(threads, 3, 0);
+	sched_run(3);
+	CU_ASSERT(sched_thread_core(threads[0], 3) == 0);
+	CU_ASSERT(sched_thread_core(threads[1], 3) == 0);
+	CU_ASSERT(sched_thread_core(threads[2], 3) == 1);
+
+	CU_ASSERT(spdk_scheduler_set("consolidate") == 0);
+	sched_set_load(threads, 3, 0);
+	sched_run(3);
+	CU_ASSERT(sched_thread_core(threads[2], 3) == 1);
+	MOCK_CLEAR(spdk_app_get_thread);
+
+	/* The scheduling reactor only sleeps until the next scheduler period. */
+	g_scheduler_last_tsc = g_sched_ticks;
+	g_scheduling_reactor->tsc_last = g_sched_ticks + 50;
+	CU_ASSERT(reactor_scheduler_timeout(g_scheduling_reactor) == 1);
+	g_scheduling_reactor->tsc_last = g_sched_ticks + g_scheduler_period;
+	CU_ASSERT(reactor_scheduler_timeout(g_scheduling_reactor) == 0);
+	CU_ASSERT(reactor_scheduler_timeout(spdk_reactor_get(1)) == -1);
+
+	/* The static scheduler doesn't gather metrics at all. */
+	CU_ASSERT(spdk_scheduler_set("static") == 0);
+	g_sched_ticks += g_scheduler_period;
+	g_scheduling_reactor->tsc_last = g_sched_ticks;
+	reactor_scheduler_poll(g_scheduling_reactor);
+	CU_ASSERT(g_scheduling_in_progress == false);
+	CU_ASSERT(reactor_scheduler_timeout(g_scheduling_reactor) == -1);
+
+	for (i = 0; i < 3; i++) {
+		spdk_set_thread(threads[i]);
+		spdk_thread_exit(threads[i]);
+	}
+	spdk_set_thread(NULL);
+
+	for (i = 0; i < 3; i++) {
+		MOCK_SET(spdk_env_get_current_core, i);
+		_reactor_run(spdk_reactor_get(i));
+		CU_ASSERT(TAILQ_EMPTY(&spdk_reactor_get(i)->threads));
+	}
+
+	g_scheduling_reactor = NULL;
+	spdk_scheduler_set_period(SPDK_SCHEDULER_PERIOD_USEC_DEFAULT);
+
+	spdk_reactors_fini();
+
+	MOCK_CLEAR(spdk_env_get_current_core);
+
+	free_cores();
+}
+
 int
 main(int argc, char **argv)
 {
@@ -445,6 +773,8 @@ main(int argc, char **argv)
 	CU_ADD_TEST(suite, test_reschedule_thread);
 	CU_ADD_TEST(suite, test_for_each_reactor);
 	CU_ADD_TEST(suite, test_reactor_stats);
+	CU_ADD_TEST(suite, test_reactor_interrupt);
+	CU_ADD_TEST(suite, test_scheduler);
 
 	CU_basic_set_mode(CU_BRM_VERBOSE);
 	CU_basic_run_tests();
@@ -119,6 +119,11 @@ DEFINE_STUB(spdk_nvmf_subsystem_listener_allowed,
 	    (struct spdk_nvmf_subsystem *subsystem, const struct spdk_nvme_transport_id *trid),
 	    true);
 
+DEFINE_STUB(nvmf_subsystem_find_listener,
+	    struct spdk_nvmf_subsystem_listener *,
+	    (struct spdk_nvmf_subsystem *subsystem, const struct spdk_nvme_transport_id *trid),
+	    NULL);
+
 DEFINE_STUB(nvmf_bdev_ctrlr_read_cmd,
 	    int,
 	    (struct spdk_bdev *bdev, struct spdk_bdev_desc *desc, struct spdk_io_channel *ch,
@@ -1671,6 +1676,168 @@ test_multi_async_event_reqs(void)
 	TAILQ_REMOVE(&qpair.outstanding, &req[1], link);
 }
 
+static void
+test_ana_reporting(void)
+{
+	struct spdk_nvmf_subsystem subsystem = {};
+	struct spdk_nvmf_subsystem_listener listener = {};
+	struct spdk_nvmf_transport_ops tops = {};
+	struct spdk_nvmf_transport transport = { .ops = &tops };
+	struct spdk_nvmf_poll_group group = {};
+	struct spdk_nvmf_qpair qpair = {};
+	struct spdk_nvmf_ctrlr ctrlr = {};
+	struct spdk_nvmf_ns *ns_ptrs[2] = {};
+	struct spdk_nvmf_ns ns = {};
+	struct spdk_nvmf_request req = {};
+	struct spdk_nvme_ctrlr_data cdata = {};
+	struct spdk_nvme_ana_page *ana_hdr;
+	struct spdk_nvme_ana_group_descriptor *ana_desc;
+	union nvmf_h2c_msg cmd = {};
+	union nvmf_c2h_msg rsp = {};
+	uint32_t *nsid;
+	char data[4096];
+
+	/* One active namespace with NSID 2 */
+	ns.opts.nsid = 2;
+	ns.bdev = (struct spdk_bdev *)0xDEADBEEF;
+	ns_ptrs[1] = &ns;
+	subsystem.ns = ns_ptrs;
+	subsystem.max_nsid = 2;
+	subsystem.subtype = SPDK_NVMF_SUBTYPE_NVME;
+	subsystem.ana_reporting = true;
+	MOCK_SET(spdk_nvmf_subsystem_get_first_ns, &ns);
+
+	listener.subsystem = &subsystem;
+	listener.ana_state = SPDK_NVME_ANA_NON_OPTIMIZED_STATE;
+	listener.ana_state_change_count = 3;
+
+	qpair.ctrlr = &ctrlr;
+	qpair.group = &group;
+	qpair.transport = &transport;
+
+	ctrlr.subsys = &subsystem;
+	ctrlr.admin_qpair = &qpair;
+	ctrlr.listener = &listener;
+	ctrlr.vcprop.cc.bits.en = 1;
+	ctrlr.feat.async_event_configuration.bits.ana_change_notice = 1;
+
+	req.qpair = &qpair;
+	req.cmd = &cmd;
+	req.rsp = &rsp;
+	req.data = data;
+	req.length = sizeof(data);
+
+	/* Identify controller reports ANA support */
+	CU_ASSERT(spdk_nvmf_ctrlr_identify_ctrlr(&ctrlr, &cdata) == SPDK_NVMF_REQUEST_EXEC_STATUS_COMPLETE);
+	CU_ASSERT(cdata.cmic.ana_reporting == 1);
+	CU_ASSERT(cdata.oaes.ana_change_notices == 1);
+	CU_ASSERT(cdata.anacap.ana_optimized_state == 1);
+	CU_ASSERT(cdata.anacap.ana_non_optimized_state == 1);
+	CU_ASSERT(cdata.anacap.ana_inaccessible_state == 1);
+	CU_ASSERT(cdata.anagrpmax == 2);
+	CU_ASSERT(cdata.nanagrpid == 2);
+
+	/* ANA log page has one descriptor per namespace */
+	memset(data, 0xFF, sizeof(data));
+	cmd.nvme_cmd.opc = SPDK_NVME_OPC_GET_LOG_PAGE;
+	cmd.nvme_cmd.cdw10_bits.get_log_page.lid = SPDK_NVME_LOG_ASYMMETRIC_NAMESPACE_ACCESS;
+	cmd.nvme_cmd.cdw10_bits.get_log_page.numdl = (req.length / 4 - 1);
+	CU_ASSERT(nvmf_ctrlr_get_log_page(&req) == SPDK_NVMF_REQUEST_EXEC_STATUS_COMPLETE);
+	CU_ASSERT(rsp.nvme_cpl.status.sct == SPDK_NVME_SCT_GENERIC);
+	CU_ASSERT(rsp.nvme_cpl.status.sc == SPDK_NVME_SC_SUCCESS);
+	ana_hdr = (struct spdk_nvme_ana_page *)data;
+	CU_ASSERT(ana_hdr->change_count == 3);
+	CU_ASSERT(ana_hdr->num_ana_group_desc == 1);
+	ana_desc = (struct spdk_nvme_ana_group_descriptor *)(data + sizeof(*ana_hdr));
+	CU_ASSERT(ana_desc->ana_group_id == 2);
+	CU_ASSERT(ana_desc->num_of_nsid == 1);
+	CU_ASSERT(ana_desc->change_count == 3);
+	CU_ASSERT(ana_desc->ana_state == SPDK_NVME_ANA_NON_OPTIMIZED_STATE);
+	nsid = (uint32_t *)(data + sizeof(*ana_hdr) + sizeof(*ana_desc));
+	CU_ASSERT(nsid[0] == 2);
+	/* The rest of the buffer is left untouched */
+	CU_ASSERT(nsid[1] == 0xFFFFFFFF);
+
+	/* Read the log page starting at the descriptor, without namespace lists */
+	memset(data, 0xFF, sizeof(data));
+	memset(&rsp, 0, sizeof(rsp));
+	cmd.nvme_cmd.cdw10_bits.get_log_page.lsp = 0x1;
+	cmd.nvme_cmd.cdw12 = sizeof(*ana_hdr);
+	CU_ASSERT(nvmf_ctrlr_get_log_page(&req) == SPDK_NVMF_REQUEST_EXEC_STATUS_COMPLETE);
+	CU_ASSERT(rsp.nvme_cpl.status.sc == SPDK_NVME_SC_SUCCESS);
+	ana_desc = (struct spdk_nvme_ana_group_descriptor *)data;
+	CU_ASSERT(ana_desc->ana_group_id == 2);
+	CU_ASSERT(ana_desc->num_of_nsid == 0);
+	CU_ASSERT(*(uint32_t *)(data + sizeof(*ana_desc)) == 0xFFFFFFFF);
+
+	/* ANA change notice is queued until an AER is submitted */
+	CU_ASSERT(nvmf_ctrlr_async_event_ana_change_notice(&ctrlr) == 0);
+	CU_ASSERT(ctrlr.nr_pending_notices == 1);
+	CU_ASSERT(ctrlr.pending_notices[0].bits.async_event_type == SPDK_NVME_ASYNC_EVENT_TYPE_NOTICE);
+	CU_ASSERT(ctrlr.pending_notices[0].bits.async_event_info == SPDK_NVME_ASYNC_EVENT_ANA_CHANGE);
+	CU_ASSERT(ctrlr.pending_notices[0].bits.log_page_identifier ==
+		  SPDK_NVME_LOG_ASYMMETRIC_NAMESPACE_ACCESS);
+
+	/* A notice of the same kind is only pending once */
+	CU_ASSERT(nvmf_ctrlr_async_event_ana_change_notice(&ctrlr) == 0);
+	CU_ASSERT(ctrlr.nr_pending_notices == 1);
+
+	/* Another notice isn't dropped while the ANA change notice is pending */
+	ctrlr.feat.async_event_configuration.bits.ns_attr_notice = 1;
+	CU_ASSERT(nvmf_ctrlr_async_event_ns_notice(&ctrlr) == 0);
+	CU_ASSERT(ctrlr.nr_pending_notices == 2);
+
+	/* Each AER completes right away with the oldest pending notice */
+	memset(&cmd, 0, sizeof(cmd));
+	memset(&rsp, 0, sizeof(rsp));
+	cmd.nvme_cmd.opc = SPDK_NVME_OPC_ASYNC_EVENT_REQUEST;
+	CU_ASSERT(nvmf_ctrlr_process_admin_cmd(&req) == SPDK_NVMF_REQUEST_EXEC_STATUS_COMPLETE);
+	CU_ASSERT(((union spdk_nvme_async_event_completion)rsp.nvme_cpl.cdw0).bits.async_event_info ==
+		  SPDK_NVME_ASYNC_EVENT_ANA_CHANGE);
+	memset(&rsp, 0, sizeof(rsp));
+	CU_ASSERT(nvmf_ctrlr_process_admin_cmd(&req) == SPDK_NVMF_REQUEST_EXEC_STATUS_COMPLETE);
+	CU_ASSERT(((union spdk_nvme_async_event_completion)rsp.nvme_cpl.cdw0).bits.async_event_info ==
+		  SPDK_NVME_ASYNC_EVENT_NS_ATTR_CHANGED);
+	CU_ASSERT(ctrlr.nr_pending_notices == 0);
+	ctrlr.feat.async_event_configuration.bits.ns_attr_notice = 0;
+
+	/* The host may disable the notice */
+	ctrlr.feat.async_event_configuration.bits.ana_change_notice = 0;
+	CU_ASSERT(nvmf_ctrlr_async_event_ana_change_notice(&ctrlr) == 0);
+	CU_ASSERT(ctrlr.nr_pending_notices == 0);
+
+	/* I/O is failed with a path error while the listener is inaccessible */
+	listener.ana_state = SPDK_NVME_ANA_INACCESSIBLE_STATE;
+	memset(&cmd, 0, sizeof(cmd));
+	memset(&rsp, 0, sizeof(rsp));
+	cmd.nvme_cmd.opc = SPDK_NVME_OPC_READ;
+	cmd.nvme_cmd.nsid = 2;
+	CU_ASSERT(nvmf_ctrlr_process_io_cmd(&req) == SPDK_NVMF_REQUEST_EXEC_STATUS_COMPLETE);
+	CU_ASSERT(rsp.nvme_cpl.status.sct == SPDK_NVME_SCT_PATH);
+	CU_ASSERT(rsp.nvme_cpl.status.sc == SPDK_NVME_SC_ASYMMETRIC_ACCESS_INACCESSIBLE);
+
+	/* A removed listener makes the path inaccessible as well */
+	listener.ana_state = SPDK_NVME_ANA_OPTIMIZED_STATE;
+	ctrlr.listener = NULL;
+	memset(&rsp, 0, sizeof(rsp));
+	CU_ASSERT(nvmf_ctrlr_process_io_cmd(&req) == SPDK_NVMF_REQUEST_EXEC_STATUS_COMPLETE);
+	CU_ASSERT(rsp.nvme_cpl.status.sct == SPDK_NVME_SCT_PATH);
+	CU_ASSERT(rsp.nvme_cpl.status.sc == SPDK_NVME_SC_ASYMMETRIC_ACCESS_INACCESSIBLE);
+
+	/* Without ANA reporting the log page is not supported */
+	subsystem.ana_reporting = false;
+	memset(&cmd, 0, sizeof(cmd));
+	memset(&rsp, 0, sizeof(rsp));
+	cmd.nvme_cmd.opc = SPDK_NVME_OPC_GET_LOG_PAGE;
+	cmd.nvme_cmd.cdw10_bits.get_log_page.lid = SPDK_NVME_LOG_ASYMMETRIC_NAMESPACE_ACCESS;
+	cmd.nvme_cmd.cdw10_bits.get_log_page.numdl = (req.length / 4 - 1);
+	CU_ASSERT(nvmf_ctrlr_get_log_page(&req) == SPDK_NVMF_REQUEST_EXEC_STATUS_COMPLETE);
+	CU_ASSERT(rsp.nvme_cpl.status.sct == SPDK_NVME_SCT_GENERIC);
+	CU_ASSERT(rsp.nvme_cpl.status.sc == SPDK_NVME_SC_INVALID_FIELD);
+
+	MOCK_CLEAR(spdk_nvmf_subsystem_get_first_ns);
+}
+
 int main(int argc, char **argv)
 {
 	CU_pSuite	suite = NULL;
@@ -1696,6 +1863,7 @@ int main(int argc, char **argv)
 	CU_ADD_TEST(suite, test_custom_admin_cmd);
 	CU_ADD_TEST(suite, test_fused_compare_and_write);
 	CU_ADD_TEST(suite, test_multi_async_event_reqs);
+	CU_ADD_TEST(suite, test_ana_reporting);
 
 	allocate_threads(1);
 	set_thread(0);
@@ -59,6 +59,9 @@ DEFINE_STUB(spdk_bdev_get_md_size, uint32_t,
 DEFINE_STUB(spdk_bdev_is_md_interleaved, bool,
 	    (const struct spdk_bdev *bdev), false);
 
+DEFINE_STUB(nvmf_ctrlr_async_event_ana_change_notice, int,
+	    (struct spdk_nvmf_ctrlr *ctrlr), 0);
+
 DEFINE_STUB(spdk_nvmf_transport_stop_listen,
 	    int,
 	    (struct spdk_nvmf_transport *transport,
@@ -1302,6 +1305,96 @@ test_spdk_nvmf_ns_event(void)
 	free(tgt.subsystems);
 }
 
+static int g_ana_state_status;
+
+static void
+ut_set_ana_state_done(void *cb_arg, int status)
+{
+	g_ana_state_status = status;
+}
+
+static void
+test_spdk_nvmf_subsystem_set_ana_state(void)
+{
+	struct spdk_nvmf_tgt tgt = {};
+	struct spdk_nvmf_subsystem subsystem = {
+		.tgt = &tgt,
+		.state = SPDK_NVMF_SUBSYSTEM_INACTIVE,
+	};
+	struct spdk_nvme_transport_id trid = {};
+	struct spdk_nvmf_subsystem_listener *listener;
+	struct spdk_nvmf_ctrlr ctrlr = {};
+
+	TAILQ_INIT(&subsystem.listeners);
+	TAILQ_INIT(&subsystem.ctrlrs);
+
+	listener = calloc(1, sizeof(*listener));
+	SPDK_CU_ASSERT_FATAL(listener != NULL);
+	listener->subsystem = &subsystem;
+	listener->trid = &trid;
+	listener->ana_state = SPDK_NVME_ANA_OPTIMIZED_STATE;
+	TAILQ_INSERT_TAIL(&subsystem.listeners, listener, link);
+
+	ctrlr.subsys = &subsystem;
+	ctrlr.listener = listener;
+	TAILQ_INSERT_TAIL(&subsystem.ctrlrs, &ctrlr, link);
+
+	/* ANA reporting is disabled */
+	g_ana_state_status = 1;
+	spdk_nvmf_subsystem_set_ana_state(&subsystem, &trid, SPDK_NVME_ANA_INACCESSIBLE_STATE,
+					  ut_set_ana_state_done, NULL);
+	CU_ASSERT(g_ana_state_status == -EINVAL);
+	CU_ASSERT(listener->ana_state == SPDK_NVME_ANA_OPTIMIZED_STATE);
+
+	CU_ASSERT(spdk_nvmf_subsystem_set_ana_reporting(&subsystem, true) == 0);
+	CU_ASSERT(spdk_nvmf_subsystem_get_ana_reporting(&subsystem) == true);
+
+	/* ANA reporting can't be changed while the subsystem is active */
+	subsystem.state = SPDK_NVMF_SUBSYSTEM_ACTIVE;
+	CU_ASSERT(spdk_nvmf_subsystem_set_ana_reporting(&subsystem, false) == -EAGAIN);
+	CU_ASSERT(spdk_nvmf_subsystem_get_ana_reporting(&subsystem) == true);
+
+	/* Unsupported ANA state */
+	g_ana_state_status = 1;
+	spdk_nvmf_subsystem_set_ana_state(&subsystem, &trid, SPDK_NVME_ANA_CHANGE_STATE,
+					  ut_set_ana_state_done, NULL);
+	CU_ASSERT(g_ana_state_status == -EINVAL);
+	CU_ASSERT(listener->ana_state == SPDK_NVME_ANA_OPTIMIZED_STATE);
+
+	/* The callback is optional, also when the state can't be set */
+	spdk_nvmf_subsystem_set_ana_state(&subsystem, &trid, SPDK_NVME_ANA_CHANGE_STATE, NULL, NULL);
+	CU_ASSERT(listener->ana_state == SPDK_NVME_ANA_OPTIMIZED_STATE);
+
+	/* Change the ANA state of the listener */
+	g_ana_state_status = 1;
+	spdk_nvmf_subsystem_set_ana_state(&subsystem, &trid, SPDK_NVME_ANA_INACCESSIBLE_STATE,
+					  ut_set_ana_state_done, NULL);
+	poll_threads();
+	CU_ASSERT(g_ana_state_status == 0);
+	CU_ASSERT(spdk_nvmf_subsystem_listener_get_ana_state(listener) ==
+		  SPDK_NVME_ANA_INACCESSIBLE_STATE);
+	CU_ASSERT(listener->ana_state_change_count == 1);
+
+	/* Setting the same state again is not a change */
+	g_ana_state_status = 1;
+	spdk_nvmf_subsystem_set_ana_state(&subsystem, &trid, SPDK_NVME_ANA_INACCESSIBLE_STATE,
+					  ut_set_ana_state_done, NULL);
+	poll_threads();
+	CU_ASSERT(g_ana_state_status == 0);
+	CU_ASSERT(listener->ana_state_change_count == 1);
+
+	/* Controllers lose their listener when it is removed */
+	subsystem.state = SPDK_NVMF_SUBSYSTEM_PAUSED;
+	CU_ASSERT(spdk_nvmf_subsystem_remove_listener(&subsystem, &trid) == 0);
+	CU_ASSERT(ctrlr.listener == NULL);
+	CU_ASSERT(TAILQ_EMPTY(&subsystem.listeners));
+
+	/* The listener is gone */
+	g_ana_state_status = 1;
+	spdk_nvmf_subsystem_set_ana_state(&subsystem, &trid, SPDK_NVME_ANA_OPTIMIZED_STATE,
+					  ut_set_ana_state_done, NULL);
+	CU_ASSERT(g_ana_state_status == -EINVAL);
+}
 
 int main(int argc, char **argv)
 {
@@ -1327,6 +1420,7 @@ int main(int argc, char **argv)
 	CU_ADD_TEST(suite, test_reservation_clear_notification);
 	CU_ADD_TEST(suite, test_reservation_preempt_notification);
 	CU_ADD_TEST(suite, test_spdk_nvmf_ns_event);
+	CU_ADD_TEST(suite, test_spdk_nvmf_subsystem_set_ana_state);
 
 	allocate_threads(1);
 	set_thread(0);
@@ -172,6 +172,82 @@ thread_send_msg(void)
 	free_threads();
 }
 
+static void
+send_msg_batch_cb(void *ctx)
+{
+	int *order = ctx;
+	static int next;
+
+	if (*order == 0) {
+		next = 0;
+	}
+
+	/* Messages are executed in the order of the batch. */
+	CU_ASSERT(*order == next);
+	next++;
+	*order = -1;
+}
+
+static void
+thread_send_msg_batch(void)
+{
+	struct spdk_thread *thread0, *thread1;
+	int order[SPDK_THREAD_MSG_BATCH_MAX];
+	void *ctxs[SPDK_THREAD_MSG_BATCH_MAX];
+	bool done = false;
+	size_t cache_count;
+	int i;
+
+	allocate_threads(2);
+	set_thread(0);
+	thread0 = spdk_get_thread();
+
+	set_thread(1);
+	thread1 = spdk_get_thread();
+
+	for (i = 0; i < SPDK_THREAD_MSG_BATCH_MAX; i++) {
+		order[i] = i;
+		ctxs[i] = &order[i];
+	}
+
+	CU_ASSERT(spdk_thread_send_msg_batch(thread0, send_msg_batch_cb, ctxs, 0) == -EINVAL);
+	CU_ASSERT(spdk_thread_send_msg_batch(thread0, send_msg_batch_cb, ctxs,
+					     SPDK_THREAD_MSG_BATCH_MAX + 1) == -EINVAL);
+
+	/* Simulate thread 1 sending a batch of messages to thread 0. */
+	cache_count = thread1->msg_cache_count;
+	CU_ASSERT(spdk_thread_send_msg_batch(thread0, send_msg_batch_cb, ctxs,
+					     SPDK_THREAD_MSG_BATCH_MAX) == 0);
+	CU_ASSERT(thread1->msg_cache_count == cache_count - SPDK_THREAD_MSG_BATCH_MAX);
+	CU_ASSERT(spdk_ring_count(thread0->messages) == SPDK_THREAD_MSG_BATCH_MAX);
+	CU_ASSERT(order[0] == 0);
+
+	poll_thread(0);
+	for (i = 0; i < SPDK_THREAD_MSG_BATCH_MAX; i++) {
+		CU_ASSERT(order[i] == -1);
+	}
+
+	/* Executed messages are kept in the cache of thread 0, up to its size. */
+	CU_ASSERT(thread0->msg_cache_count == SPDK_MSG_MEMPOOL_CACHE_SIZE);
+
+	/* An empty message cache is refilled in bulk. */
+	while (thread1->msg_cache_count > 0) {
+		struct spdk_msg *msg = SLIST_FIRST(&thread1->msg_cache);
+
+		SLIST_REMOVE_HEAD(&thread1->msg_cache, link);
+		thread1->msg_cache_count--;
+		spdk_mempool_put(g_spdk_msg_mempool, msg);
+	}
+
+	spdk_thread_send_msg(thread0, send_msg_cb, &done);
+	CU_ASSERT(thread1->msg_cache_count == SPDK_MSG_CACHE_REFILL_SIZE - 1);
+
+	poll_thread(0);
+	CU_ASSERT(done == true);
+
+	free_threads();
+}
+
 static int
 poller_run_done(void *ctx)
 {
@@ -391,6 +467,125 @@ poller_pause(void)
 	free_threads();
 }
 
+#define UT_TIMED_POLLERS	100
+
+struct ut_timed_poller {
+	struct spdk_poller	*poller;
+	int			index;
+	uint64_t		period_us;
+	uint64_t		run_count;
+	uint64_t		last_run;
+};
+
+static int g_timed_poller_order[UT_TIMED_POLLERS];
+static int g_timed_poller_order_count;
+
+static int
+timed_poller_run(void *ctx)
+{
+	struct ut_timed_poller *p = ctx;
+
+	p->run_count++;
+	p->last_run = spdk_get_ticks();
+	if (g_timed_poller_order_count < UT_TIMED_POLLERS) {
+		g_timed_poller_order[g_timed_poller_order_count++] = p->index;
+	}
+
+	return 0;
+}
+
+static void
+timed_poller_heap(void)
+{
+	struct ut_timed_poller pollers[UT_TIMED_POLLERS] = {};
+	struct spdk_thread *thread;
+	uint64_t expected;
+	int i, us;
+
+	allocate_threads(1);
+	set_thread(0);
+	thread = spdk_get_thread();
+	MOCK_SET(spdk_get_ticks, 0);
+
+	/* Register pollers with scattered periods between 1us and 50us. */
+	for (i = 0; i < UT_TIMED_POLLERS; i++) {
+		pollers[i].index = i;
+		pollers[i].period_us = (i * 37) % 50 + 1;
+		pollers[i].poller = spdk_poller_register(timed_poller_run, &pollers[i],
+				    pollers[i].period_us);
+		SPDK_CU_ASSERT_FATAL(pollers[i].poller != NULL);
+	}
+	CU_ASSERT(thread->timed_pollers_count == UT_TIMED_POLLERS);
+	CU_ASSERT(thread->timed_pollers_reserved == UT_TIMED_POLLERS);
+
+	/* The heap always yields the poller that expires first. */
+	for (us = 1; us <= 200; us++) {
+		spdk_delay_us(1);
+		poll_threads();
+		CU_ASSERT(spdk_thread_next_poller_expiration(thread) > spdk_get_ticks());
+	}
+
+	for (i = 0; i < UT_TIMED_POLLERS; i++) {
+		CU_ASSERT(pollers[i].run_count == 200 / pollers[i].period_us);
+		CU_ASSERT(pollers[i].last_run == (200 / pollers[i].period_us) * pollers[i].period_us);
+	}
+
+	/* Unregistering a waiting timed poller removes it from the heap right away. */
+	for (i = 0; i < UT_TIMED_POLLERS; i += 2) {
+		spdk_poller_unregister(&pollers[i].poller);
+		pollers[i].run_count = 0;
+	}
+	CU_ASSERT(thread->timed_pollers_count == UT_TIMED_POLLERS / 2);
+	CU_ASSERT(thread->timed_pollers_reserved == UT_TIMED_POLLERS / 2);
+
+	/* Paused timed pollers leave the heap but keep their slot. */
+	for (i = 1; i < UT_TIMED_POLLERS; i += 4) {
+		spdk_poller_pause(pollers[i].poller);
+	}
+	CU_ASSERT(thread->timed_pollers_count == UT_TIMED_POLLERS / 4);
+	CU_ASSERT(thread->timed_pollers_reserved == UT_TIMED_POLLERS / 2);
+
+	for (i = 1; i < UT_TIMED_POLLERS; i += 2) {
+		pollers[i].run_count = 0;
+	}
+
+	spdk_delay_us(100);
+	poll_threads();
+
+	for (i = 0; i < UT_TIMED_POLLERS; i++) {
+		expected = (i % 2 == 0 || i % 4 == 1) ? 0 : 1;
+		CU_ASSERT(pollers[i].run_count == expected);
+	}
+
+	for (i = 1; i < UT_TIMED_POLLERS; i += 4) {
+		spdk_poller_resume(pollers[i].poller);
+	}
+	CU_ASSERT(thread->timed_pollers_count == UT_TIMED_POLLERS / 2);
+
+	for (i = 1; i < UT_TIMED_POLLERS; i += 2) {
+		spdk_poller_unregister(&pollers[i].poller);
+	}
+	CU_ASSERT(thread->timed_pollers_count == 0);
+	CU_ASSERT(thread->timed_pollers_reserved == 0);
+
+	/* Pollers expiring at the same time run in the order they were registered. */
+	for (i = 0; i < 10; i++) {
+		pollers[i].poller = spdk_poller_register(timed_poller_run, &pollers[i], 10);
+		SPDK_CU_ASSERT_FATAL(pollers[i].poller != NULL);
+	}
+
+	g_timed_poller_order_count = 0;
+	spdk_delay_us(10);
+	poll_threads();
+	CU_ASSERT(g_timed_poller_order_count == 10);
+	for (i = 0; i < 10; i++) {
+		CU_ASSERT(g_timed_poller_order[i] == i);
+		spdk_poller_unregister(&pollers[i].poller);
+	}
+
+	free_threads();
+}
+
 static void
 for_each_cb(void *ctx)
 {
@@ -1237,6 +1432,126 @@ nested_channel(void)
 	CU_ASSERT(TAILQ_EMPTY(&g_threads));
 }
 
+static int g_intr_calls;
+
+static int
+intr_fn(void *ctx)
+{
+	int *efd = ctx;
+	uint64_t val;
+
+	g_intr_calls++;
+	CU_ASSERT(read(*efd, &val, sizeof(val)) == sizeof(val));
+
+	return 1;
+}
+
+static bool
+fd_is_readable(int fd, int timeout_ms)
+{
+	struct pollfd pfd = { .fd = fd, .events = POLLIN };
+
+	return poll(&pfd, 1, timeout_ms) == 1;
+}
+
+static void
+thread_interrupt(void)
+{
+#ifdef __linux__
+	struct spdk_thread *thread;
+	struct spdk_poller *poller;
+	struct spdk_interrupt *intr;
+	bool done = false;
+	uint64_t val = 1;
+	int fd, efd;
+
+	CU_ASSERT(spdk_interrupt_mode_enable() == 0);
+	spdk_thread_lib_init(NULL, 0);
+	CU_ASSERT(spdk_interrupt_mode_is_enabled());
+	/* It's too late once the library is initialized */
+	CU_ASSERT(spdk_interrupt_mode_enable() == -EBUSY);
+
+	thread = spdk_thread_create(NULL, NULL);
+	SPDK_CU_ASSERT_FATAL(thread != NULL);
+	spdk_set_thread(thread);
+	fd = spdk_thread_get_interrupt_fd(thread);
+	SPDK_CU_ASSERT_FATAL(fd >= 0);
+
+	/* An idle thread can be waited on */
+	CU_ASSERT(spdk_thread_arm_interrupt(thread) == true);
+	CU_ASSERT(!fd_is_readable(fd, 0));
+
+	/* A message wakes it up, the next poll runs it and goes back to polling */
+	spdk_thread_send_msg(thread, send_msg_cb, &done);
+	CU_ASSERT(fd_is_readable(fd, 0));
+	spdk_thread_poll(thread, 0, 0);
+	CU_ASSERT(done == true);
+	CU_ASSERT(thread->intr_armed == false);
+	CU_ASSERT(!fd_is_readable(fd, 0));
+
+	/* Messages sent to a polled thread don't signal the fd, but prevent waiting */
+	done = false;
+	spdk_thread_send_msg(thread, send_msg_cb, &done);
+	CU_ASSERT(!fd_is_readable(fd, 0));
+	CU_ASSERT(spdk_thread_arm_interrupt(thread) == false);
+	spdk_thread_poll(thread, 0, 0);
+	CU_ASSERT(done == true);
+
+	/* The expiration of a timed poller wakes up the thread */
+	done = false;
+	poller = spdk_poller_register(poller_run_done, &done, 1000);
+	SPDK_CU_ASSERT_FATAL(poller != NULL);
+	CU_ASSERT(spdk_thread_arm_interrupt(thread) == true);
+	CU_ASSERT(fd_is_readable(fd, 1000));
+	spdk_delay_us(1000);
+	spdk_thread_poll(thread, 0, 0);
+	CU_ASSERT(done == true);
+	CU_ASSERT(!fd_is_readable(fd, 0));
+	spdk_poller_unregister(&poller);
+	spdk_thread_poll(thread, 0, 0);
+
+	/* Active pollers keep the thread polling */
+	poller = spdk_poller_register(poller_run_done, &done, 0);
+	SPDK_CU_ASSERT_FATAL(poller != NULL);
+	CU_ASSERT(spdk_thread_arm_interrupt(thread) == false);
+	spdk_poller_unregister(&poller);
+	spdk_thread_poll(thread, 0, 0);
+	CU_ASSERT(spdk_thread_arm_interrupt(thread) == true);
+	spdk_thread_poll(thread, 0, 0);
+
+	/* Registered interrupts are processed both when polled and when waited on */
+	efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	SPDK_CU_ASSERT_FATAL(efd >= 0);
+	intr = spdk_interrupt_register(efd, intr_fn, &efd, "ut_intr");
+	SPDK_CU_ASSERT_FATAL(intr != NULL);
+
+	g_intr_calls = 0;
+	CU_ASSERT(write(efd, &val, sizeof(val)) == sizeof(val));
+	spdk_thread_poll(thread, 0, 0);
+	CU_ASSERT(g_intr_calls == 1);
+
+	CU_ASSERT(spdk_thread_arm_interrupt(thread) == true);
+	CU_ASSERT(write(efd, &val, sizeof(val)) == sizeof(val));
+	CU_ASSERT(fd_is_readable(fd, 0));
+	spdk_thread_poll(thread, 0, 0);
+	CU_ASSERT(g_intr_calls == 2);
+	CU_ASSERT(!fd_is_readable(fd, 0));
+
+	spdk_interrupt_unregister(&intr);
+	CU_ASSERT(intr == NULL);
+	CU_ASSERT(thread->num_interrupts == 0);
+	close(efd);
+
+	spdk_thread_exit(thread);
+	while (!spdk_thread_is_exited(thread)) {
+		spdk_thread_poll(thread, 0, 0);
+	}
+	spdk_thread_destroy(thread);
+	spdk_thread_lib_fini();
+	CU_ASSERT(spdk_interrupt_mode_is_enabled() == false);
+#endif
+}
+
 int
 main(int argc, char **argv)
 {
@@ -1250,8 +1565,10 @@ main(int argc, char **argv)
 
 	CU_ADD_TEST(suite, thread_alloc);
 	CU_ADD_TEST(suite, thread_send_msg);
+	CU_ADD_TEST(suite, thread_send_msg_batch);
 	CU_ADD_TEST(suite, thread_poller);
 	CU_ADD_TEST(suite, poller_pause);
+	CU_ADD_TEST(suite, timed_poller_heap);
 	CU_ADD_TEST(suite, thread_for_each);
 	CU_ADD_TEST(suite, for_each_channel_remove);
 	CU_ADD_TEST(suite, for_each_channel_unreg);
@@ -1261,6 +1578,7 @@ main(int argc, char **argv)
 	CU_ADD_TEST(suite, thread_exit_test);
 	CU_ADD_TEST(suite, thread_update_stats_test);
 	CU_ADD_TEST(suite, nested_channel);
+	CU_ADD_TEST(suite, thread_interrupt);
 
 	CU_basic_set_mode(CU_BRM_VERBOSE);
 	CU_basic_run_tests();
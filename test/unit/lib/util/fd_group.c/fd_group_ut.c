@@ -0,0 +1,247 @@
+/*-
+ *   BSD LICENSE
+ *
+ *   Copyright (c) Intel Corporation.
+ *   All rights reserved.
+ *
+ *   Redistribution and use in source and binary forms, with or without
+ *   modification, are permitted provided that the following conditions
+ *   are met:
+ *
+ *     * Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *     * Redistributions in binary form must reproduce the above copyright
+ *       notice, this list of conditions and the following disclaimer in
+ *       the documentation and/or other materials provided with the
+ *       distribution.
+ *     * Neither the name of Intel Corporation nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ *   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ *   "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ *   LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ *   A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT
+ *   OWNER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ *   SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ *   LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE,
+ *   DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY
+ *   THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ *   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE
+ *   OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "spdk/stdinc.h"
+
+#include "spdk_cunit.h"
+
+#include "util/fd_group.c"
+
+#include <sys/eventfd.h>
+
+struct ut_efd {
+	int			fd;
+	int			calls;
+	/* fd to remove from the group when the handler is called */
+	int			remove_fd;
+	struct spdk_fd_group	*fgrp;
+};
+
+static void
+ut_efd_init(struct ut_efd *efd, struct spdk_fd_group *fgrp)
+{
+	memset(efd, 0, sizeof(*efd));
+	efd->fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	SPDK_CU_ASSERT_FATAL(efd->fd >= 0);
+	efd->remove_fd = -1;
+	efd->fgrp = fgrp;
+}
+
+static void
+ut_efd_signal(struct ut_efd *efd)
+{
+	uint64_t val = 1;
+
+	SPDK_CU_ASSERT_FATAL(write(efd->fd, &val, sizeof(val)) == sizeof(val));
+}
+
+static int
+ut_efd_handler(void *arg)
+{
+	struct ut_efd *efd = arg;
+	uint64_t val;
+
+	efd->calls++;
+	if (read(efd->fd, &val, sizeof(val)) != sizeof(val)) {
+		return -errno;
+	}
+
+	if (efd->remove_fd >= 0) {
+		spdk_fd_group_remove(efd->fgrp, efd->remove_fd);
+		efd->remove_fd = -1;
+	}
+
+	return 1;
+}
+
+static void
+test_fd_group_add_remove(void)
+{
+	struct spdk_fd_group *fgrp = NULL;
+	struct ut_efd efd[2];
+	int rc;
+
+	rc = spdk_fd_group_create(&fgrp);
+	SPDK_CU_ASSERT_FATAL(rc == 0);
+	CU_ASSERT(spdk_fd_group_get_fd(fgrp) >= 0);
+
+	ut_efd_init(&efd[0], fgrp);
+	ut_efd_init(&efd[1], fgrp);
+
+	CU_ASSERT(spdk_fd_group_add(fgrp, efd[0].fd, ut_efd_handler, &efd[0], "efd0") == 0);
+	CU_ASSERT(spdk_fd_group_add(fgrp, efd[0].fd, ut_efd_handler, &efd[0], "efd0") == -EEXIST);
+	CU_ASSERT(spdk_fd_group_add(fgrp, efd[1].fd, ut_efd_handler, &efd[1], NULL) == 0);
+	CU_ASSERT(spdk_fd_group_add(fgrp, -1, ut_efd_handler, NULL, NULL) == -EINVAL);
+	CU_ASSERT(fgrp->num_fds == 2);
+
+	/* Nothing is ready */
+	CU_ASSERT(spdk_fd_group_wait(fgrp, 0) == 0);
+	CU_ASSERT(efd[0].calls == 0);
+	CU_ASSERT(efd[1].calls == 0);
+
+	/* Only the handler of the ready fd is called */
+	ut_efd_signal(&efd[1]);
+	CU_ASSERT(spdk_fd_group_wait(fgrp, 0) == 1);
+	CU_ASSERT(efd[0].calls == 0);
+	CU_ASSERT(efd[1].calls == 1);
+
+	ut_efd_signal(&efd[0]);
+	ut_efd_signal(&efd[1]);
+	CU_ASSERT(spdk_fd_group_wait(fgrp, -1) == 2);
+	CU_ASSERT(efd[0].calls == 1);
+	CU_ASSERT(efd[1].calls == 2);
+
+	/* A removed fd isn't waited for anymore */
+	spdk_fd_group_remove(fgrp, efd[0].fd);
+	CU_ASSERT(fgrp->num_fds == 1);
+	ut_efd_signal(&efd[0]);
+	CU_ASSERT(spdk_fd_group_wait(fgrp, 0) == 0);
+	CU_ASSERT(efd[0].calls == 1);
+
+	spdk_fd_group_remove(fgrp, efd[1].fd);
+	CU_ASSERT(fgrp->num_fds == 0);
+	CU_ASSERT(TAILQ_EMPTY(&fgrp->event_handlers));
+
+	spdk_fd_group_destroy(fgrp);
+	close(efd[0].fd);
+	close(efd[1].fd);
+}
+
+static void
+test_fd_group_remove_in_handler(void)
+{
+	struct spdk_fd_group *fgrp = NULL;
+	struct ut_efd efd[2];
+	int rc;
+
+	rc = spdk_fd_group_create(&fgrp);
+	SPDK_CU_ASSERT_FATAL(rc == 0);
+
+	ut_efd_init(&efd[0], fgrp);
+	ut_efd_init(&efd[1], fgrp);
+
+	CU_ASSERT(spdk_fd_group_add(fgrp, efd[0].fd, ut_efd_handler, &efd[0], "efd0") == 0);
+	CU_ASSERT(spdk_fd_group_add(fgrp, efd[1].fd, ut_efd_handler, &efd[1], "efd1") == 0);
+
+	/*
+	 * Both fds are ready and each handler removes the other fd. Whichever
+	 * handler runs first, the other one must not be called anymore.
+	 */
+	efd[0].remove_fd = efd[1].fd;
+	efd[1].remove_fd = efd[0].fd;
+	ut_efd_signal(&efd[0]);
+	ut_efd_signal(&efd[1]);
+	CU_ASSERT(spdk_fd_group_wait(fgrp, 0) == 2);
+	CU_ASSERT(efd[0].calls + efd[1].calls == 1);
+	CU_ASSERT(fgrp->num_fds == 1);
+
+	/* The removed handler is freed when the wait is done */
+	SPDK_CU_ASSERT_FATAL(!TAILQ_EMPTY(&fgrp->event_handlers));
+	CU_ASSERT(TAILQ_NEXT(TAILQ_FIRST(&fgrp->event_handlers), link) == NULL);
+
+	/* The fd can be added again */
+	if (efd[0].calls == 1) {
+		CU_ASSERT(spdk_fd_group_add(fgrp, efd[1].fd, ut_efd_handler, &efd[1], "efd1") == 0);
+	} else {
+		CU_ASSERT(spdk_fd_group_add(fgrp, efd[0].fd, ut_efd_handler, &efd[0], "efd0") == 0);
+	}
+	CU_ASSERT(fgrp->num_fds == 2);
+
+	spdk_fd_group_remove(fgrp, efd[0].fd);
+	spdk_fd_group_remove(fgrp, efd[1].fd);
+	spdk_fd_group_destroy(fgrp);
+	close(efd[0].fd);
+	close(efd[1].fd);
+}
+
+static int
+ut_inner_group_wait(void *arg)
+{
+	return spdk_fd_group_wait(arg, 0);
+}
+
+static void
+test_fd_group_nested(void)
+{
+	struct spdk_fd_group *outer = NULL, *inner = NULL;
+	struct ut_efd efd;
+	int rc;
+
+	rc = spdk_fd_group_create(&outer);
+	SPDK_CU_ASSERT_FATAL(rc == 0);
+	rc = spdk_fd_group_create(&inner);
+	SPDK_CU_ASSERT_FATAL(rc == 0);
+
+	ut_efd_init(&efd, inner);
+	CU_ASSERT(spdk_fd_group_add(inner, efd.fd, ut_efd_handler, &efd, "efd") == 0);
+	CU_ASSERT(spdk_fd_group_add(outer, spdk_fd_group_get_fd(inner),
+				    ut_inner_group_wait, inner, "inner") == 0);
+
+	/* An fd ready in the inner group makes the outer group ready */
+	CU_ASSERT(spdk_fd_group_wait(outer, 0) == 0);
+	ut_efd_signal(&efd);
+	CU_ASSERT(spdk_fd_group_wait(outer, -1) == 1);
+	CU_ASSERT(efd.calls == 1);
+	CU_ASSERT(spdk_fd_group_wait(outer, 0) == 0);
+
+	spdk_fd_group_remove(outer, spdk_fd_group_get_fd(inner));
+	spdk_fd_group_remove(inner, efd.fd);
+	spdk_fd_group_destroy(inner);
+	spdk_fd_group_destroy(outer);
+	close(efd.fd);
+}
+
+int
+main(int argc, char **argv)
+{
+	CU_pSuite	suite = NULL;
+	unsigned int	num_failures;
+
+	CU_set_error_action(CUEA_ABORT);
+	CU_initialize_registry();
+
+	suite = CU_add_suite("fd_group", NULL, NULL);
+
+	CU_ADD_TEST(suite, test_fd_group_add_remove);
+	CU_ADD_TEST(suite, test_fd_group_remove_in_handler);
+	CU_ADD_TEST(suite, test_fd_group_nested);
+
+	CU_basic_set_mode(CU_BRM_VERBOSE);
+
+	CU_basic_run_tests();
+
+	num_failures = CU_get_number_of_failures();
+	CU_cleanup_registry();
+
+	return num_failures;
+}
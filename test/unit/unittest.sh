@@ -15,7 +15,9 @@ cd "$rootdir"
 function unittest_bdev() {
 	$valgrind $testdir/lib/bdev/bdev.c/bdev_ut
 	$valgrind $testdir/lib/bdev/bdev_ocssd.c/bdev_ocssd_ut
+	$valgrind $testdir/lib/bdev/bdev_nvme.c/bdev_nvme_ut
 	$valgrind $testdir/lib/bdev/raid/bdev_raid.c/bdev_raid_ut
+	$valgrind $testdir/lib/bdev/raid/raid1.c/raid1_ut
 	$valgrind $testdir/lib/bdev/bdev_zone.c/bdev_zone_ut
 	$valgrind $testdir/lib/bdev/gpt/gpt.c/gpt_ut
 	$valgrind $testdir/lib/bdev/part.c/part_ut
@@ -118,6 +120,9 @@ function unittest_util() {
 	$valgrind $testdir/lib/util/iov.c/iov_ut
 	$valgrind $testdir/lib/util/math.c/math_ut
 	$valgrind $testdir/lib/util/pipe.c/pipe_ut
+	if [ $(uname -s) = Linux ]; then
+		$valgrind $testdir/lib/util/fd_group.c/fd_group_ut
+	fi
 }
 
 # if ASAN is enabled, use it.  If not use valgrind if installed but allow